@@ -16,6 +16,7 @@ LOCAL_CFLAGS	+= -Wno-missing-field-initializers	# warns on this: SwipeAction	ret
 LOCAL_CFLAGS	+= -Wno-multichar	# used in internal Android headers:  DISPLAY_EVENT_VSYNC = 'vsyn',
 LOCAL_CFLAGS	+= -Wno-invalid-source-encoding
 #LOCAL_CFLAGS	+= -pg -DNDK_PROFILE # compile with profiling
+#LOCAL_CFLAGS	+= -DOVR_ENABLE_PROFILER	# scoped CPU profiling in release builds, see Profiler.h
 #LOCAL_CFLAGS	+= -mfpu=neon		# ARM NEON support
 LOCAL_CPPFLAGS	:= -Wno-type-limits
 LOCAL_CPPFLAGS	+= -Wno-invalid-offsetof
@@ -43,7 +43,7 @@ LOCAL_SRC_FILES  := LibOVR/Src/Kernel/OVR_Alg.cpp \
                     LibOVR/Src/Kernel/OVR_FileFILE.cpp \
                     LibOVR/Src/Kernel/OVR_Log.cpp \
                     LibOVR/Src/Kernel/OVR_Lockless.cpp \
-                    LibOVR/Src/Kernel/OVR_Math.cpp \
+                    LibOVR/Src/Kernel/OVR_Math.cpp.neon \
                     LibOVR/Src/Kernel/OVR_RefCount.cpp \
                     LibOVR/Src/Kernel/OVR_Std.cpp \
                     LibOVR/Src/Kernel/OVR_String.cpp \
@@ -51,8 +51,10 @@ LOCAL_SRC_FILES  := LibOVR/Src/Kernel/OVR_Alg.cpp \
                     LibOVR/Src/Kernel/OVR_String_PathUtil.cpp \
                     LibOVR/Src/Kernel/OVR_SysFile.cpp \
                     LibOVR/Src/Kernel/OVR_System.cpp \
+                    LibOVR/Src/Kernel/OVR_ThreadRings.cpp \
                     LibOVR/Src/Kernel/OVR_ThreadsPthread.cpp \
                     LibOVR/Src/Kernel/OVR_Timer.cpp \
+                    LibOVR/Src/Kernel/OVR_Trace.cpp \
                     LibOVR/Src/Kernel/OVR_UTF8Util.cpp \
                     LibOVR/Src/Util/Util_LatencyTest.cpp \
                     LibOVR/Src/CAPI/CAPI_GlobalState.cpp \
@@ -69,15 +71,17 @@ LOCAL_SRC_FILES  := LibOVR/Src/Kernel/OVR_Alg.cpp \
                     LibOVR/Src/OVR_SensorCalibration.cpp \
                     LibOVR/Src/OVR_GyroTempCalibration.cpp \
                     LibOVR/Src/OVR_SensorFusion.cpp \
+                    LibOVR/Src/OVR_PoseHistory.cpp \
                     LibOVR/Src/OVR_SensorTimeFilter.cpp \
                     LibOVR/Src/OVR_SensorImpl.cpp \
+                    LibOVR/Src/OVR_SensorRecorder.cpp \
                     LibOVR/Src/OVR_ThreadCommandQueue.cpp \
                     LibOVR/Src/OVR_Android_DeviceManager.cpp \
                     LibOVR/Src/OVR_Android_HIDDevice.cpp \
                     LibOVR/Src/OVR_Android_HMDDevice.cpp \
                     LibOVR/Src/OVR_Android_SensorDevice.cpp \
                     LibOVR/Src/OVR_Android_PhoneSensors.cpp \
-                    LibOVR/Src/OVR_Stereo.cpp \
+                    LibOVR/Src/OVR_Stereo.cpp.neon \
 					RayTracer/RtIntersect.cpp \
 					RayTracer/RtTrace.cpp \
 					VRMenu/VRMenuComponent.cpp \
@@ -104,6 +108,8 @@ LOCAL_SRC_FILES  := LibOVR/Src/Kernel/OVR_Alg.cpp \
                     VrApi/HmdInfo.cpp \
                     VrApi/Distortion.cpp \
                     VrApi/TimeWarp.cpp \
+                    VrApi/FramePacing.cpp \
+                    VrApi/WarpLayers.cpp \
                     VrApi/ImageServer.cpp \
                     VrApi/LocalPreferences.cpp \
                     VrApi/NativeBuildStrings.cpp \
@@ -114,6 +120,7 @@ LOCAL_SRC_FILES  := LibOVR/Src/Kernel/OVR_Alg.cpp \
                     GlTexture.cpp \
                     GlProgram.cpp \
                     GlGeometry.cpp \
+                    GlStreamingBuffer.cpp \
                     Log.cpp \
                     PackageFiles.cpp \
                     SurfaceTexture.cpp \
@@ -130,11 +137,19 @@ LOCAL_SRC_FILES  := LibOVR/Src/Kernel/OVR_Alg.cpp \
                     ModelRender.cpp \
                     ModelFile.cpp \
 					ModelCollision.cpp \
+					ModelAnimation.cpp.neon \
+					MeshOptimizer.cpp \
+					DynamicResolution.cpp \
+					FrameCapture.cpp \
+					Profiler.cpp \
+					GpuProfiler.cpp \
+					SelfTest.cpp \
                     ModelView.cpp \
                     DebugLines.cpp \
 					GazeCursor.cpp \
 					SwipeView.cpp \
 					SwipeDir.cpp \
+					ThumbnailLoader.cpp \
 					SearchPaths.cpp \
 					SoundManager.cpp
 					
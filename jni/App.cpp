@@ -24,11 +24,13 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "Kernel/OVR_System.h"
 #include "Kernel/OVR_Math.h"
 #include "Kernel/OVR_TypesafeNumber.h"
+#include "Kernel/OVR_Trace.h"
 
 #include "3rdParty/stb/stb_image_write.h"
 
 #include "GlUtils.h"
 #include "GlTexture.h"
+#include "GlStreamingBuffer.h"
 #include "VrCommon.h"
 
 #include "AppLocal.h"
@@ -43,6 +45,8 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "VrApi/TimeWarp.h"		// for tid needed by CreateSChedulingReport
 #include "VrApi/JniUtils.h"
 #include "PackageFiles.h"
+#include "Profiler.h"
+#include "SelfTest.h"
 
 #define DELAYED_ONE_TIME_INIT
 //#define TEST_TIMEWARP_WATCHDOG
@@ -476,9 +480,12 @@ AppLocal::AppLocal( JNIEnv & jni_, jobject activityObject_, VrAppInterface & int
 			VrThreadTid( 0 ),
 			PassThroughCameraEnabled( false ),
 			EnablePassThroughCameraOnResume( false ),
+			GpuProfile( "GPU" ),
 			BatteryLevel( 0 ),
 			BatteryStatus( BATTERY_STATUS_UNKNOWN ),
 			ShowFPS( false ),
+			ShowProfiler( false ),
+			RecordingSensor( false ),
 			ShowVolumePopup( true ),
 			InfoTextEndFrame( -1 ),
 			touchpadTimer( 0.0f ),
@@ -494,6 +501,7 @@ AppLocal::AppLocal( JNIEnv & jni_, jobject activityObject_, VrAppInterface & int
 			VRMenuMgr( NULL ),
 			VolumePopup( NULL ),
 			DebugLines( NULL ),
+			StreamingBuffer( NULL ),
 			BackKeyState( 0.25f, 0.75f )
 {
 	LOG( "----------------- AppLocal::AppLocal() -----------------");
@@ -779,6 +787,29 @@ void AppLocal::OpenApplicationPackage()
 	UiJni->ReleaseStringUTFChars(( jstring)result, cpath );
 
 	ovr_OpenApplicationPackage( packageCodePath );
+
+	// Linked shader programs are cached in the application's private cache
+	// directory, which the system may clear, but never while we are running.
+	// The self tests keep their scratch files there as well.
+	jmethodID getCacheDirId = GetMethodID( "getCacheDir", "()Ljava/io/File;" );
+	jobject cacheDir = UiJni->CallObjectMethod( javaObject, getCacheDirId );
+	if ( cacheDir != NULL )
+	{
+		jclass fileClass = UiJni->GetObjectClass( cacheDir );
+		jmethodID getAbsolutePathId = GetMethodID( fileClass, "getAbsolutePath", "()Ljava/lang/String;" );
+		jstring cacheDirPath = (jstring)UiJni->CallObjectMethod( cacheDir, getAbsolutePathId );
+		const char * cacheDirChars = UiJni->GetStringUTFChars( cacheDirPath, NULL );
+		char programCachePath[1024];
+		snprintf( programCachePath, sizeof( programCachePath ), "%s/programs", cacheDirChars );
+		SetProgramCacheDirectory( programCachePath );
+		char selfTestPath[1024];
+		snprintf( selfTestPath, sizeof( selfTestPath ), "%s/selftest/", cacheDirChars );
+		SetSelfTestDirectory( selfTestPath );
+		UiJni->ReleaseStringUTFChars( cacheDirPath, cacheDirChars );
+		UiJni->DeleteLocalRef( cacheDirPath );
+		UiJni->DeleteLocalRef( fileClass );
+		UiJni->DeleteLocalRef( cacheDir );
+	}
 }
 
 // Error checks and exits on failure
@@ -901,6 +932,9 @@ void AppLocal::InitVrThread()
 	cameraTexture = new SurfaceTexture( VrJni );
 	activityPanel.Texture = new SurfaceTexture( VrJni );
 
+	// Geometry that is rebuilt every frame is streamed through this.
+	StreamingBuffer = GlStreamingBuffer::AcquireShared();
+
 	InitFonts();
 
 	SoundManager.LoadSoundAssets();
@@ -921,6 +955,7 @@ void AppLocal::InitVrThread()
 	LOG( "launchIntent: %s", launchIntent );
 	appInterface->OneTimeInit( launchIntent );
 	OneTimeInitCalled = true;
+	LogProgramCacheStats( "after OneTimeInit" );
 #endif
 }
 
@@ -962,6 +997,9 @@ void AppLocal::ShutdownVrThread()
 	OvrVRMenuMgr::Free( VRMenuMgr );
 	OvrDebugLines::Free( DebugLines );
 
+	GlStreamingBuffer::ReleaseShared();
+	StreamingBuffer = NULL;
+
 	ShutdownGlObjects();
 
 	EglShutdown( eglr );
@@ -1086,6 +1124,8 @@ void AppLocal::ShutdownGlObjects()
 	unitCubeLines.Free();
 
 	EyeDecorations.Shutdown();
+
+	GpuProfile.Free();
 }
 
 bool App::MatchesHead( const char * head, const char * check )
@@ -1195,6 +1235,31 @@ void AppLocal::Resume()
 
 		const char * enableDebugOptionsStr = ovr_GetLocalPreferenceValueForKey( LOCAL_PREF_DEV_DEBUG_OPTIONS, "0" );
 		enableDebugOptions =  ( atoi( enableDebugOptionsStr ) > 0 );
+
+		// Once per process, for comparing eye buffer configurations.
+		static bool loggedEyeBufferMemory = false;
+		if ( enableDebugOptions && !loggedEyeBufferMemory )
+		{
+			LogEyeBufferMemoryTable();
+			loggedEyeBufferMemory = true;
+		}
+
+		const char * enableTraceStr = ovr_GetLocalPreferenceValueForKey( LOCAL_PREF_DEV_TRACE, "0" );
+		if ( atoi( enableTraceStr ) > 0 )
+		{
+			LOG( "Local Preferences: Tracing enabled" );
+			Trace::SetEnabled( true );
+		}
+
+		// Only once per process, the benchmarks take several seconds.
+		static bool ranSelfTests = false;
+		const int selfTests = atoi( ovr_GetLocalPreferenceValueForKey( LOCAL_PREF_DEV_SELF_TESTS, "0" ) );
+		if ( selfTests > 0 && !ranSelfTests )
+		{
+			ranSelfTests = true;
+			const int failed = RunSelfTests( this, selfTests > 1 );
+			CreateToast( failed == 0 ? "self tests passed" : "%i self tests FAILED", failed );
+		}
 	}
 
 	// Clear cursor trails
@@ -1876,6 +1941,8 @@ void AppLocal::VrThreadFunction()
 {
 	// Set the name that will show up in systrace
 	pthread_setname_np( pthread_self(), "OVR::VrThread" );
+	// and in traces and profiles.
+	Trace::SetThreadName( "OVR::VrThread" );
 
 	InitVrThread();
 
@@ -1910,6 +1977,12 @@ void AppLocal::VrThreadFunction()
 			continue;
 		}
 
+		// Aggregate the previous frame before this one opens its scope.
+		GpuProfile.EndFrame();
+		Profiler::EndFrame();
+
+		OVR_PROFILE_TRACE_SCOPE( TRACE_FRAME, "Frame" );
+
 #if defined( DELAYED_ONE_TIME_INIT )
 		// Let the client app initialize only once by calling OneTimeInit() when the windowSurface is valid.
 		if ( !OneTimeInitCalled )
@@ -1921,6 +1994,7 @@ void AppLocal::VrThreadFunction()
 			LOG( "launchIntent: %s", launchIntent );
 			appInterface->OneTimeInit( launchIntent );
 			OneTimeInitCalled = true;
+			LogProgramCacheStats( "after OneTimeInit" );
 		}
 #endif
 
@@ -1935,7 +2009,7 @@ void AppLocal::VrThreadFunction()
 				break;
 			}
 			lastCameraUpdateTime = cameraTexture->timestamp;
-			// this would be better as an interpolation from history instead of a prediction
+			// times this far back are interpolated from the sensor history
 			cameraFramePose[0] = ovrHmd_GetSensorState( OvrHmd,
 									lastCameraUpdateTime * 0.000000001 - cameraLatency, true );
 			cameraFramePose[1] = ovrHmd_GetSensorState( OvrHmd,
@@ -1996,6 +2070,9 @@ void AppLocal::VrThreadFunction()
 		// resend any debug lines that have expired
 		GetDebugLines().BeginFrame( vrFrame.FrameNumber );
 
+		// move on to buffer space the GPU is done with
+		StreamingBuffer->BeginFrame();
+
 		// reset any VR menu submissions from previous frame
 		GetVRMenuMgr().BeginFrame();
 
@@ -2110,6 +2187,7 @@ void AppLocal::VrThreadFunction()
 		// Main loop logic / draw code
 		if ( !ReadyToExit )
 		{
+			OVR_PROFILE_SCOPE( "AppFrame" );
 			this->lastViewMatrix = appInterface->Frame( vrFrame );
 		}
 
@@ -2124,6 +2202,11 @@ void AppLocal::VrThreadFunction()
 		if ( timeNow > lastReportTime )
 		{
 			LOG( "FPS: %i GPU time: %3.1f ms ", countApplicationFrames, EyeTargets->LogEyeSceneGpuTime.GetTotalTime() );
+			if ( vrParms.dynamicRenderScale )
+			{
+				LogDynamicResolutionStats( RenderScaleControl.GetStats() );
+				RenderScaleControl.ResetStats();
+			}
 			countApplicationFrames = 0;
 			lastReportTime = timeNow;
 		}
@@ -2250,6 +2333,32 @@ void LaunchDemoIntent( AppLocal * apl, int index )
 static float test = 0.0f;
 #endif
 
+// Writes everything traced so far to the first unused trace%03i number, as
+// JSON for chrome://tracing and in the binary form for long captures.
+static bool ExportTrace( char * jsonPath, const int jsonPathSize )
+{
+	int index;
+	for ( index = 0; index < 999; index++ )
+	{
+		OVR_sprintf( jsonPath, jsonPathSize, "/sdcard/Oculus/trace%03i.json", index );
+		FILE * f = fopen( jsonPath, "r" );
+		if ( f == NULL )
+		{
+			break;
+		}
+		fclose( f );
+	}
+	char binaryPath[1024];
+	OVR_sprintf( binaryPath, sizeof( binaryPath ), "/sdcard/Oculus/trace%03i.bin", index );
+
+	const double start = ovr_GetTimeInSeconds();
+	const int binaryEvents = Trace::ExportBinary( binaryPath );
+	const int jsonEvents = Trace::ExportChromeJson( jsonPath );
+	LOG( "Exported %i events to %s and %i to %s in %4.2f seconds", binaryEvents, binaryPath,
+			jsonEvents, jsonPath, ovr_GetTimeInSeconds() - start );
+	return binaryEvents >= 0 && jsonEvents >= 0;
+}
+
 void AppLocal::KeyEvent( const int keyCode, const bool down, const int repeatCount )
 {
 	// the back key is special because it has to handle long-press and double-tap
@@ -2312,11 +2421,84 @@ void AppLocal::KeyEvent( const int keyCode, const bool down, const int repeatCou
 				return;
 			}
 		}
+		else if ( keyCode == AKEYCODE_V && down && repeatCount == 0 )
+		{
+			// about five seconds of frames
+			EyeTargets->CaptureSequence( 300 );
+			CreateToast( "capturing 300 frames" );
+			return;
+		}
 		else if ( keyCode == AKEYCODE_F && down && repeatCount == 0 )
 		{
 			SetShowFPS( !GetShowFPS() );
 			return;
 		}
+		else if ( keyCode == AKEYCODE_P && down && repeatCount == 0 )
+		{
+			ShowProfiler = !ShowProfiler;
+			return;
+		}
+		else if ( keyCode == AKEYCODE_O && down && repeatCount == 0 )
+		{
+			const char * fmt = "/sdcard/Oculus/profile%03i.txt";
+			char path[1024];
+			for ( int i = 0; i < 999; i++ )
+			{
+				OVR_sprintf( path, sizeof( path ), fmt, i );
+				if ( !FileExists( path ) )
+				{
+					break;
+				}
+			}
+			CreateToast( Profiler::Dump( path ) ? "%s" : "couldn't write %s", path );
+			return;
+		}
+		else if ( keyCode == AKEYCODE_R && down && repeatCount == 0 )
+		{
+			// Toggles recording the raw sensor reports for SensorReplay.
+			if ( RecordingSensor )
+			{
+				ovrHmd_StopSensorRecording( OvrHmd );
+				RecordingSensor = false;
+				CreateToast( "sensor recording stopped" );
+				return;
+			}
+			char path[1024];
+			for ( int i = 0; i < 999; i++ )
+			{
+				OVR_sprintf( path, sizeof( path ), "/sdcard/Oculus/sensor%03i.log", i );
+				if ( !FileExists( path ) )
+				{
+					break;
+				}
+			}
+			RecordingSensor = ovrHmd_StartSensorRecording( OvrHmd, path );
+			CreateToast( RecordingSensor ? "recording %s" : "couldn't record %s", path );
+			return;
+		}
+		else if ( keyCode == AKEYCODE_X && down && repeatCount == 0 )
+		{
+			// The first press starts tracing, every press after
+			// that exports what the rings currently hold.
+			if ( !Trace::IsEnabled() )
+			{
+				Trace::SetEnabled( true );
+				CreateToast( "tracing" );
+			}
+			else
+			{
+				char path[1024];
+				if ( ExportTrace( path, sizeof( path ) ) )
+				{
+					CreateToast( "%s", path );
+				}
+				else
+				{
+					CreateToast( "trace export failed" );
+				}
+			}
+			return;
+		}
 		else if ( keyCode == AKEYCODE_COMMA && down && repeatCount == 0 )
 		{
 			float const IPD_MIN_CM = 0.0f;
@@ -13,12 +13,15 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 #include "App.h"
 #include "SoundManager.h"
+#include "DynamicResolution.h"
+#include "GpuProfiler.h"
 
 namespace OVR {
 
 class OvrGuiSys;
 class GazeCursor;
 class OvrVolumePopup;
+class GlStreamingBuffer;
 
 //==============================================================
 // AppLocal
@@ -308,6 +311,8 @@ public:
 	VrFrame			lastVrFrame;
 
 	EyeParms		vrParms;
+	DynamicResolution	RenderScaleControl;	// picks vrParms.renderScale when dynamicRenderScale is set
+	GpuProfiler		GpuProfile;			// GPU time of eye rendering passes, reported with the profiler
 	ovrModeParms	VrModeParms;
 
 	TimeWarpParms	SwapParms;			// passed to TimeWarp->WarpSwap()
@@ -339,6 +344,8 @@ public:
 	eBatteryStatus	BatteryStatus;		// battery status as reported from Java
 
 	bool			ShowFPS;			// true to show FPS on screen
+	bool			ShowProfiler;		// true to show the CPU and GPU profile on screen
+	bool			RecordingSensor;	// true while sensor input reports are written to a log
 	bool			ShowVolumePopup;	// true to show volume popup when volume changes
 
 	VrViewParms		ViewParms;
@@ -437,6 +444,7 @@ public:
     OvrVRMenuMgr *      VRMenuMgr;
     OvrVolumePopup *	VolumePopup;
     OvrDebugLines *     DebugLines;
+    GlStreamingBuffer *	StreamingBuffer;	// shared by the debug lines and font surfaces
     KeyState            BackKeyState;
 
 private:
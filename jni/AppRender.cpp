@@ -25,6 +25,8 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "VRMenu/VRMenuMgr.h"
 #include "VRMenu/GuiSys.h"
 #include "DebugLines.h"
+#include "Profiler.h"
+#include "VrApi/Vsync.h"
 
 
 
@@ -179,6 +181,8 @@ void AppLocal::DrawPassThroughCamera( const float bufferFov, const Quatf &orient
 
 void AppLocal::DrawEyeViewsPostDistorted( Matrix4f const & centerViewMatrix, const int numPresents )
 {
+	OVR_PROFILE_SCOPE( "DrawEyeViews" );
+
 	// update vr lib systems after the app frame, but before rendering anything
 	GetGuiSys().Frame( this, vrFrame, GetVRMenuMgr(), GetDefaultFont(), GetMenuFontSurface() );
 	GetGazeCursor().Frame( this->lastViewMatrix, vrFrame.DeltaSeconds );
@@ -212,6 +216,53 @@ void AppLocal::DrawEyeViewsPostDistorted( Matrix4f const & centerViewMatrix, con
 		LastFrameTime = currentFrameTime;
 	}
 
+	if ( ShowProfiler )
+	{
+		StringBuffer text;
+		Profiler::FormatReport( text, 0.05f, 32 );
+		if ( text.GetSize() == 0 )
+		{
+			text = Profiler::HasData() ? "profiling..." : "no profile markers, build with OVR_ENABLE_PROFILER";
+		}
+		fontParms_t fontParms;
+		fontParms.Billboard = true;
+		fontParms.TrackRoll = true;
+		const Vector3f viewPos( GetViewMatrixPosition( centerViewMatrix ) );
+		const Vector3f viewFwd( GetViewMatrixForward( centerViewMatrix ) );
+		const Vector3f viewRight( centerViewMatrix.M[0][0], centerViewMatrix.M[0][1], centerViewMatrix.M[0][2] );
+		const Vector3f viewUp( centerViewMatrix.M[1][0], centerViewMatrix.M[1][1], centerViewMatrix.M[1][2] );
+		const Vector3f textPos( viewPos + viewFwd * 1.5f - viewRight * 0.5f + viewUp * 0.4f );
+		GetWorldFontSurface().DrawTextBillboarded3D( GetDefaultFont(), fontParms, textPos, 0.0015f,
+				Vector4f( 1.0f, 1.0f, 0.0f, 1.0f ), text.ToCStr() );
+
+		// Bars above the text for the CPU frame, and the GPU time of the
+		// eyes under it, against the 60 Hz budget, with a tick at the end
+		// of the budget.
+		ProfileStats frameStats;
+		if ( Profiler::GetStats( "Frame", frameStats, "OVR::VrThread" ) )
+		{
+			const float budgetMs = 1000.0f / 60.0f;
+			const float metersPerMs = 0.5f / budgetMs;
+			const Vector3f barStart( textPos + viewUp * 0.05f );
+			const Vector4f barColor = ( frameStats.MaxMs < budgetMs ) ? Vector4f( 0.0f, 1.0f, 0.0f, 1.0f ) : Vector4f( 1.0f, 0.0f, 0.0f, 1.0f );
+			const Vector4f tickColor( 1.0f, 1.0f, 1.0f, 1.0f );
+			GetDebugLines().AddLine( barStart, barStart + viewRight * ( frameStats.AvgMs * metersPerMs ),
+					barColor, barColor, vrFrame.FrameNumber + 1, false );
+			const Vector3f tick( barStart + viewRight * ( budgetMs * metersPerMs ) );
+			GetDebugLines().AddLine( tick - viewUp * 0.02f, tick + viewUp * 0.02f,
+					tickColor, tickColor, vrFrame.FrameNumber + 1, false );
+
+			ProfileStats gpuStats;
+			if ( Profiler::GetStats( "Eye", gpuStats, "GPU" ) )
+			{
+				const Vector3f gpuBarStart( barStart - viewUp * 0.01f );
+				const Vector4f gpuBarColor( 0.0f, 0.5f, 1.0f, 1.0f );
+				GetDebugLines().AddLine( gpuBarStart, gpuBarStart + viewRight * ( gpuStats.AvgMs * metersPerMs ),
+						gpuBarColor, gpuBarColor, vrFrame.FrameNumber + 1, false );
+			}
+		}
+	}
+
 	if ( InfoTextEndFrame >= vrFrame.FrameNumber )
 	{
 		fontParms_t fontParms;
@@ -252,23 +303,43 @@ void AppLocal::DrawEyeViewsPostDistorted( Matrix4f const & centerViewMatrix, con
 	}
 	else
 	{
+		// Pick the render scale from the GPU time of recent eye rendering,
+		// allowing MinimumVsyncs vsyncs of the measured display period.
+		if ( vrParms.dynamicRenderScale )
+		{
+			DynamicResolutionParms scaleParms = RenderScaleControl.GetParms();
+			scaleParms.MinScale = vrParms.minRenderScale;
+			RenderScaleControl.SetParms( scaleParms );
+			const double vsyncPeriodNano = GetSystemVsyncClock().GetVsyncState().vsyncPeriodNano;
+			const float vsyncSeconds = ( vsyncPeriodNano > 0.0 ) ? (float)( vsyncPeriodNano * 0.000000001 ) : 1.0f / 60.0f;
+			vrParms.renderScale = RenderScaleControl.Update( EyeTargets->LogEyeSceneGpuTime.GetTotalTime() * 0.001f,
+					SwapParms.MinimumVsyncs * vsyncSeconds );
+		}
+
 		// possibly change the buffer parameters
 		EyeTargets->BeginFrame( vrParms );
 
 		for (int eye = 0; eye < numEyes; eye++)
 		{
+			OVR_PROFILE_SCOPE( "Eye" );
+			GpuProfile.Begin( "Eye" );
+
 			EyeTargets->BeginRenderingEye( eye );
 
 			// Call back to the app for drawing.
+			GpuProfile.Begin( "Scene" );
 			const Matrix4f mvp = appInterface->DrawEyeView( eye, fovDegrees );
+			GpuProfile.End();
 
 			DrawActivity( mvp );
 
 			DrawPassThroughCamera( fovDegrees, vrFrame.PoseState.Pose.Orientation );
 
+			GpuProfile.Begin( "Menus" );
 			GetVRMenuMgr().RenderSubmitted( mvp.Transposed() );
 			GetMenuFontSurface().Render3D( GetDefaultFont(), mvp.Transposed() );
 			GetWorldFontSurface().Render3D( GetDefaultFont(), mvp.Transposed() );
+			GpuProfile.End();
 
 			glDisable( GL_DEPTH_TEST );
 			glDisable( GL_CULL_FACE );
@@ -298,10 +369,12 @@ void AppLocal::DrawEyeViewsPostDistorted( Matrix4f const & centerViewMatrix, con
 				// This will not be reflected correctly in overlay planes.
 				// EyeDecorations.DrawEyeVignette();
 
-				EyeDecorations.FillEdge( vrParms.resolution, vrParms.resolution );
+				EyeDecorations.FillEdge( EyeTargets->GetRenderResolution(), EyeTargets->GetRenderResolution() );
 			}
 
 			EyeTargets->EndRenderingEye( eye );
+
+			GpuProfile.End();
 		}
 	}
 
@@ -313,7 +386,8 @@ void AppLocal::DrawEyeViewsPostDistorted( Matrix4f const & centerViewMatrix, con
 		for ( int eye = 0 ; eye < TimeWarpParms::MAX_WARP_EYES ; eye++ )
 		{
 			const Matrix4f proj = Matrix4f::PerspectiveRH( DegreeToRad(fovDegrees), 1.0f, 1, 100);
-			SwapParms.Images[eye][0].TexCoordsFromTanAngles = TanAngleMatrixFromProjection( proj );
+			SwapParms.Images[eye][0].TexCoordsFromTanAngles = Matrix4f::Scaling( eyes.RenderScale, eyes.RenderScale, 1.0f ) *
+					Matrix4f( TanAngleMatrixFromProjection( proj ) );
 
 			SwapParms.Images[eye][0].TexId = eyes.Textures[renderMonoMode ? 0 : eye ];
 			SwapParms.Images[eye][0].Pose = SensorForNextWarp.Predicted;
@@ -35,6 +35,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "GlProgram.h"
 #include "GlTexture.h"
 #include "GlGeometry.h"
+#include "GlStreamingBuffer.h"
 #include "VrCommon.h"
 #include "Log.h"
 #include "OVR_JSON.h"
@@ -247,6 +248,7 @@ public:
 
 private:
     GlGeometry      Geo;		// font glyphs
+    GlStreamingBuffer * StreamBuffer;	// Vertices are streamed through this each frame
     fontVertex_t *  Vertices;	// vertices that are written to the VBO
     int             MaxVertices;
     int             MaxIndices;
@@ -687,7 +689,7 @@ bool BitmapFontLocal::Load( char const * fontInfoFileName )
 	}
 
     // create the shaders for font rendering if not already created
-    if ( FontProgram.vertexShader == 0 || FontProgram.fragmentShader == 0 )
+    if ( FontProgram.program == 0 )
     {
         FontProgram = BuildProgram( FontSingleTextureVertexShaderSrc, SDFFontFragmentShaderSrc );//SingleTextureFragmentShaderSrc );
     }
@@ -712,7 +714,7 @@ bool BitmapFontLocal::LoadFromBuffers( unsigned char const * fontInfoBuffer, siz
 	}
 
     // create the shaders for font rendering if not already created
-    if ( FontProgram.vertexShader == 0 || FontProgram.fragmentShader == 0 )
+    if ( FontProgram.program == 0 )
     {
         FontProgram = BuildProgram( FontSingleTextureVertexShaderSrc, SDFFontFragmentShaderSrc );//SingleTextureFragmentShaderSrc );
     }
@@ -918,6 +920,7 @@ void BitmapFontLocal::CalcTextMetrics( char const * text, size_t & len, float &
 //==============================
 // BitmapFontSurfaceLocal::BitmapFontSurface
 BitmapFontSurfaceLocal::BitmapFontSurfaceLocal() :
+    StreamBuffer( NULL ),
     Vertices( NULL ),
     MaxVertices( 0 ),
     MaxIndices( 0 ),
@@ -933,6 +936,11 @@ BitmapFontSurfaceLocal::BitmapFontSurfaceLocal() :
     Geo.Free();
 	delete [] Vertices;
 	Vertices = NULL;
+	if ( StreamBuffer != NULL )
+	{
+		GlStreamingBuffer::ReleaseShared();
+		StreamBuffer = NULL;
+	}
 }
 
 //==============================
@@ -953,30 +961,19 @@ void BitmapFontSurfaceLocal::Init( const int maxVertices )
     MaxIndices = ( maxVertices / 4 ) * 6;
 
     Vertices = new fontVertex_t[ maxVertices ];
-    const int vertexByteCount = maxVertices * sizeof( fontVertex_t );
+    StreamBuffer = GlStreamingBuffer::AcquireShared();
 
 	// font VAO
     glGenVertexArraysOES_( 1, &Geo.vertexArrayObject );
     glBindVertexArrayOES_( Geo.vertexArrayObject );
 
-    // vertex buffer
-    glGenBuffers( 1, &Geo.vertexBuffer );
-    glBindBuffer( GL_ARRAY_BUFFER, Geo.vertexBuffer );
-    glBufferData( GL_ARRAY_BUFFER, vertexByteCount, (void*)Vertices, GL_DYNAMIC_DRAW );   
-   
+    // There is no vertex buffer of our own, the attribute pointers are set to
+    // wherever the vertices land in the streaming buffer in Finish().
     glEnableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_POSITION ); // x, y and z
-    glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof( fontVertex_t ), (void*)0 );
-    
     glEnableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_UV0 ); // s and t
-    glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_UV0, 2, GL_FLOAT, GL_FALSE, sizeof( fontVertex_t ), (void*)offsetof( fontVertex_t, s ) );
-    
     glEnableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_COLOR ); // color
-    glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( fontVertex_t ), (void*)offsetof( fontVertex_t, rgba ) );
-
 	glDisableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_UV1 );
-
 	glEnableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_FONT_PARMS );	// outline parms
-	glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_FONT_PARMS, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( fontVertex_t ), (void*)offsetof( fontVertex_t, fontParms ) );
 
 	fontIndex_t * indices = new fontIndex_t[ MaxIndices ];
     const int indexByteCount = MaxIndices * sizeof( fontIndex_t );
@@ -1288,9 +1285,24 @@ void BitmapFontSurfaceLocal::Finish( Matrix4f const & viewMatrix )
 	// needed on the next frame.
 	VertexBlocks.Clear();
 
+	if ( CurVertex == 0 )
+	{
+		return;
+	}
+
 	glBindVertexArrayOES_( Geo.vertexArrayObject );
-	glBindBuffer( GL_ARRAY_BUFFER, Geo.vertexBuffer );
-	glBufferSubData( GL_ARRAY_BUFFER, 0, CurVertex * sizeof( fontVertex_t ), (void *)Vertices );
+	const int offset = StreamBuffer->Stream( Vertices, CurVertex * sizeof( fontVertex_t ) );
+	if ( offset < 0 )
+	{
+		CurIndex = 0;
+	}
+	else
+	{
+		glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof( fontVertex_t ), (void*)( offset + 0 ) );
+		glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_UV0, 2, GL_FLOAT, GL_FALSE, sizeof( fontVertex_t ), (void*)( offset + offsetof( fontVertex_t, s ) ) );
+		glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( fontVertex_t ), (void*)( offset + offsetof( fontVertex_t, rgba ) ) );
+		glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_FONT_PARMS, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( fontVertex_t ), (void*)( offset + offsetof( fontVertex_t, fontParms ) ) );
+	}
 	glBindVertexArrayOES_( 0 );
 
 }
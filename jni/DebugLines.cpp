@@ -18,6 +18,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "GlUtils.h"
 #include "GlGeometry.h"
 #include "GlProgram.h"
+#include "GlStreamingBuffer.h"
 #include "Log.h"
 
 
@@ -123,6 +124,7 @@ private:
 	OVR::ArrayPOD< DebugLine_t >	DepthTestedLines;
 	OVR::ArrayPOD< DebugLine_t >	NonDepthTestedLines;
 	LineVertex_t *					Vertices;
+	GlStreamingBuffer *				StreamBuffer;
 	
 	bool							Initialized;
 	GlProgram						LineProgram;
@@ -139,6 +141,7 @@ private:
 // OvrDebugLinesLocal::OvrDebugLinesLocal
 OvrDebugLinesLocal::OvrDebugLinesLocal() :
 	Vertices( NULL ),
+	StreamBuffer( NULL ),
 	Initialized( false )
 {
 }
@@ -161,13 +164,14 @@ void OvrDebugLinesLocal::Init()
 	}
 
 	// this is only freed by the OS when the program exits
-	if ( LineProgram.vertexShader == 0 || LineProgram.fragmentShader == 0 )
+	if ( LineProgram.program == 0 )
 	{
 		LineProgram = BuildProgram( DebugLineVertexSrc, DebugLineFragmentSrc );
 	}
 
 	const int MAX_VERTS = MAX_DEBUG_LINES * 2;
 	Vertices = new LineVertex_t[ MAX_VERTS ];
+	StreamBuffer = GlStreamingBuffer::AcquireShared();
 	
 	// the indices will never change once we've set them up, we just won't necessarily
 	// use all of the index buffer to render.
@@ -194,22 +198,16 @@ void OvrDebugLinesLocal::Init()
 void OvrDebugLinesLocal::InitVBO( GlGeometry & geo, LineVertex_t * vertices, const int maxVerts, 
 		LineIndex_t * indices, const int maxIndices )
 {
-	const int numVertexBytes = maxVerts * sizeof( LineVertex_t );
-
 	// create vertex array object
     glGenVertexArraysOES_( 1, &geo.vertexArrayObject );
     glBindVertexArrayOES_( geo.vertexArrayObject );
 
-	// create the vertex buffer
-	glGenBuffers( 1, &geo.vertexBuffer );
-	glBindBuffer( GL_ARRAY_BUFFER, geo.vertexBuffer );
-	glBufferData( GL_ARRAY_BUFFER, numVertexBytes, (void*)vertices, GL_DYNAMIC_DRAW );
+	// The vertices are streamed through the shared buffer each frame, and the
+	// attribute pointers are set to wherever they land in Render().
+	geo.vertexBuffer = 0;
 
 	glEnableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_POSITION ); // x, y and z
-    glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_POSITION, 3, GL_FLOAT, false, sizeof( LineVertex_t ), (void*)0 );
-
     glEnableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_COLOR ); // color
-    glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_COLOR, 4, GL_FLOAT, true, sizeof( LineVertex_t ), (void*)12 );
 
 	const int numIndexBytes = maxIndices * sizeof( LineIndex_t );
 	glGenBuffers( 1, &geo.indexBuffer );
@@ -232,6 +230,8 @@ void OvrDebugLinesLocal::Shutdown()
 	NonDepthGeo.Free();
 	delete [] Vertices;
 	Vertices = NULL;
+	GlStreamingBuffer::ReleaseShared();
+	StreamBuffer = NULL;
 	Initialized = false;
 }
 
@@ -285,10 +285,15 @@ void OvrDebugLinesLocal::Render( Matrix4f const & mvp, GlGeometry & geo,
 
 	int numVertices = numLines * 2;
 	int numVertexBytes = numVertices * sizeof( LineVertex_t );
-	glBindBuffer( GL_ARRAY_BUFFER, geo.vertexBuffer );
-	glBufferSubData( GL_ARRAY_BUFFER, 0, numVertexBytes, (void*)Vertices );
+	const int offset = StreamBuffer->Stream( Vertices, numVertexBytes );
+	if ( offset < 0 )
+	{
+		glBindVertexArrayOES_( 0 );
+		return;
+	}
+    glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_POSITION, 3, GL_FLOAT, false, sizeof( LineVertex_t ), (void*)( offset + 0 ) );
+    glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_COLOR, 4, GL_FLOAT, true, sizeof( LineVertex_t ), (void*)( offset + 12 ) );
 
-	glBindVertexArrayOES_( geo.vertexArrayObject );
 	geo.indexCount = numLines * 2;
 
 	if ( depthTest )
@@ -0,0 +1,240 @@
+/************************************************************************************
+
+Filename    :   DynamicResolution.cpp
+Content     :   Picks the eye buffer render scale from the measured GPU time.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "DynamicResolution.h"
+
+#include <math.h>
+
+#include "Kernel/OVR_Alg.h"
+#include "Log.h"
+
+namespace OVR
+{
+
+DynamicResolution::DynamicResolution() :
+	SettleCount( 0 ),
+	LowCount( 0 )
+{
+}
+
+void DynamicResolution::SetParms( const DynamicResolutionParms & parms )
+{
+	Parms = parms;
+	Stats.Scale = Alg::Clamp( Stats.Scale, Parms.MinScale, Parms.MaxScale );
+}
+
+void DynamicResolution::ResetStats()
+{
+	const float scale = Stats.Scale;
+	Stats = DynamicResolutionStats();
+	Stats.Scale = scale;
+	Stats.MinScale = scale;
+	Stats.MaxScale = scale;
+}
+
+float DynamicResolution::QuantizeScale( const float scale ) const
+{
+	// Round down, with a little slack so exact multiples don't fall to the next step.
+	const float quantized = floorf( scale / Parms.ScaleStep + 0.001f ) * Parms.ScaleStep;
+	return Alg::Clamp( quantized, Parms.MinScale, Parms.MaxScale );
+}
+
+void DynamicResolution::ChangeScale( const float scale )
+{
+	Stats.Scale = scale;
+	SettleCount = Parms.SettleFrames;
+	LowCount = 0;
+}
+
+float DynamicResolution::Update( const float gpuSeconds, const float budgetSeconds )
+{
+	if ( gpuSeconds > 0.0f && budgetSeconds > 0.0f )
+	{
+		const float load = gpuSeconds / budgetSeconds;
+		Stats.NumMeasured++;
+		Stats.LoadSum += load;
+		Stats.PeakLoad = Alg::Max( Stats.PeakLoad, load );
+
+		if ( SettleCount > 0 )
+		{
+			// The measurement still includes frames from before the change.
+			SettleCount--;
+		}
+		else
+		{
+			// The scale that would bring the load to the target, with
+			// the GPU time following the number of pixels.
+			const float ideal = Stats.Scale * sqrtf( Parms.TargetLoad / load );
+			if ( load > Parms.HighLoad )
+			{
+				LowCount = 0;
+				const float scale = QuantizeScale( ideal );
+				if ( scale < Stats.Scale )
+				{
+					ChangeScale( scale );
+					Stats.NumDrops++;
+				}
+			}
+			else if ( load < Parms.LowLoad )
+			{
+				if ( ++LowCount >= Parms.RaiseFrames )
+				{
+					LowCount = 0;
+					const float scale = QuantizeScale( Alg::Min( ideal, Stats.Scale + Parms.MaxRaiseStep ) );
+					if ( scale > Stats.Scale )
+					{
+						ChangeScale( scale );
+						Stats.NumRaises++;
+					}
+				}
+			}
+			else
+			{
+				LowCount = 0;
+			}
+		}
+	}
+
+	Stats.NumFrames++;
+	Stats.ScaleSum += Stats.Scale;
+	Stats.MinScale = Alg::Min( Stats.MinScale, Stats.Scale );
+	Stats.MaxScale = Alg::Max( Stats.MaxScale, Stats.Scale );
+	return Stats.Scale;
+}
+
+void LogDynamicResolutionStats( const DynamicResolutionStats & stats )
+{
+	LOG( "DynamicResolution: scale %4.2f (%4.2f to %4.2f, mean %4.2f), load mean %3.0f%% peak %3.0f%%, %i drops, %i raises, %i of %i frames measured",
+			stats.Scale, stats.MinScale, stats.MaxScale,
+			stats.NumFrames > 0 ? stats.ScaleSum / stats.NumFrames : stats.Scale,
+			stats.NumMeasured > 0 ? stats.LoadSum / stats.NumMeasured * 100.0 : 0.0, stats.PeakLoad * 100.0f,
+			stats.NumDrops, stats.NumRaises, stats.NumMeasured, stats.NumFrames );
+}
+
+// GPU time of a frame: a fixed part plus a part that follows the pixels,
+// with some noise.
+static float SimulatedGpuSeconds( const float fixedSeconds, const float fullScaleSeconds, const float scale, unsigned & seed )
+{
+	seed = seed * 1103515245 + 12345;
+	const float noise = 1.0f + 0.1f * ( ( ( seed >> 8 ) & 0xFFFF ) / 65535.0f - 0.5f );
+	return ( fixedSeconds + fullScaleSeconds * scale * scale ) * noise;
+}
+
+static const float SimulatedBudgetSeconds = 1.0f / 60.0f;
+static const int SimulatedFramesPerPhase = 300;
+// Full scale pixel cost of each phase, as a fraction of the budget.
+static const float SimulatedPhaseLoads[] = { 0.5f, 1.3f, 0.8f, 0.5f };
+static const int NUM_SIMULATED_PHASES = sizeof( SimulatedPhaseLoads ) / sizeof( SimulatedPhaseLoads[0] );
+
+struct SimulatedPhase
+{
+	int						OverBudget;		// frames
+	DynamicResolutionStats	Stats;
+};
+
+static void SimulatePhases( const bool dynamic, SimulatedPhase phases[NUM_SIMULATED_PHASES] )
+{
+	static const int AVERAGE_FRAMES = 10;	// like LogGpuTime
+
+	DynamicResolution control;
+	unsigned seed = 1;
+	float history[AVERAGE_FRAMES] = {};
+	int frame = 0;
+	float scale = 1.0f;
+
+	for ( int phase = 0; phase < NUM_SIMULATED_PHASES; phase++ )
+	{
+		control.ResetStats();
+		phases[phase].OverBudget = 0;
+		for ( int i = 0; i < SimulatedFramesPerPhase; i++, frame++ )
+		{
+			const float gpuSeconds = SimulatedGpuSeconds( 0.1f * SimulatedBudgetSeconds,
+					SimulatedPhaseLoads[phase] * SimulatedBudgetSeconds, scale, seed );
+			if ( gpuSeconds > SimulatedBudgetSeconds )
+			{
+				phases[phase].OverBudget++;
+			}
+
+			// The controller sees the average of recent frames.
+			history[frame % AVERAGE_FRAMES] = gpuSeconds;
+			float average = 0.0f;
+			for ( int j = 0; j < AVERAGE_FRAMES; j++ )
+			{
+				average += history[j];
+			}
+			average *= 1.0f / AVERAGE_FRAMES;
+
+			const float next = control.Update( average, SimulatedBudgetSeconds );
+			scale = dynamic ? next : 1.0f;
+		}
+		phases[phase].Stats = control.GetStats();
+		if ( !dynamic )
+		{
+			phases[phase].Stats = DynamicResolutionStats();
+		}
+	}
+}
+
+void SimulateDynamicResolution()
+{
+	for ( int dynamic = 0; dynamic <= 1; dynamic++ )
+	{
+		SimulatedPhase phases[NUM_SIMULATED_PHASES];
+		SimulatePhases( dynamic != 0, phases );
+		for ( int phase = 0; phase < NUM_SIMULATED_PHASES; phase++ )
+		{
+			const DynamicResolutionStats & stats = phases[phase].Stats;
+			LOG( "SimulateDynamicResolution( %s ) phase %i, full scale load %3.0f%%: %3i of %i frames over budget, scale %4.2f to %4.2f mean %4.2f, %i drops %i raises",
+					dynamic ? "dynamic" : "fixed", phase, SimulatedPhaseLoads[phase] * 100.0f,
+					phases[phase].OverBudget, SimulatedFramesPerPhase,
+					stats.MinScale, stats.MaxScale, stats.NumFrames > 0 ? stats.ScaleSum / stats.NumFrames : stats.Scale,
+					stats.NumDrops, stats.NumRaises );
+		}
+	}
+}
+
+static void CheckDynamicResolution( const int phase, const char * what, const bool passed, int & numErrors )
+{
+	if ( !passed )
+	{
+		LOG( "TestDynamicResolution: phase %i, full scale load %3.0f%%: %s failed",
+				phase, SimulatedPhaseLoads[phase] * 100.0f, what );
+		numErrors++;
+	}
+}
+
+bool TestDynamicResolution()
+{
+	SimulatedPhase fixed[NUM_SIMULATED_PHASES];
+	SimulatedPhase dynamic[NUM_SIMULATED_PHASES];
+	SimulatePhases( false, fixed );
+	SimulatePhases( true, dynamic );
+
+	int numErrors = 0;
+	CheckDynamicResolution( 0, "full scale while under budget", dynamic[0].Stats.MinScale == 1.0f && dynamic[0].Stats.NumDrops == 0, numErrors );
+	CheckDynamicResolution( 1, "fixed scale over budget", fixed[1].OverBudget == SimulatedFramesPerPhase, numErrors );
+	CheckDynamicResolution( 1, "scale dropped", dynamic[1].Stats.NumDrops > 0 && dynamic[1].Stats.Scale < 1.0f, numErrors );
+	CheckDynamicResolution( 1, "under budget after a few frames", dynamic[1].OverBudget < SimulatedFramesPerPhase / 10, numErrors );
+	CheckDynamicResolution( 2, "no drops within the hysteresis", dynamic[2].Stats.NumDrops == 0 && dynamic[2].OverBudget == 0, numErrors );
+	CheckDynamicResolution( 3, "back to full scale", dynamic[3].Stats.Scale == 1.0f && dynamic[3].OverBudget == 0, numErrors );
+
+	DynamicResolutionParms parms;
+	for ( int phase = 0; phase < NUM_SIMULATED_PHASES; phase++ )
+	{
+		const DynamicResolutionStats & stats = dynamic[phase].Stats;
+		const float steps = stats.Scale / parms.ScaleStep;
+		CheckDynamicResolution( phase, "scale in range and quantized", stats.MinScale >= parms.MinScale &&
+				stats.MaxScale <= parms.MaxScale && fabsf( steps - floorf( steps + 0.5f ) ) < 0.001f, numErrors );
+	}
+
+	return numErrors == 0;
+}
+
+}	// namespace OVR
@@ -0,0 +1,114 @@
+/************************************************************************************
+
+Filename    :   DynamicResolution.h
+Content     :   Picks the eye buffer render scale from the measured GPU time.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#ifndef OVR_DynamicResolution_h
+#define OVR_DynamicResolution_h
+
+namespace OVR
+{
+
+// The eye buffers stay allocated at EyeParms::resolution, only the viewport
+// changes, so a new scale costs nothing but the GPU time of the next frame.
+// GPU time is taken to be proportional to the rendered pixels, which is close
+// enough for fragment bound scenes, and the controller corrects for the rest
+// on the following measurements.
+struct DynamicResolutionParms
+{
+	DynamicResolutionParms() :
+		MinScale( 0.5f ),
+		MaxScale( 1.0f ),
+		TargetLoad( 0.75f ),
+		HighLoad( 0.9f ),
+		LowLoad( 0.6f ),
+		RaiseFrames( 90 ),
+		SettleFrames( 12 ),
+		MaxRaiseStep( 0.0625f ),
+		ScaleStep( 1.0f / 32.0f ) {}
+
+	float	MinScale;
+	float	MaxScale;
+	float	TargetLoad;		// fraction of the frame budget to aim for after a change
+	float	HighLoad;		// above this the scale drops on the next frame
+	float	LowLoad;		// below this for RaiseFrames frames the scale rises
+	int		RaiseFrames;
+	int		SettleFrames;	// measurements ignored after a change, covers LogGpuTime's average
+	float	MaxRaiseStep;	// raising is slow, so a misestimate doesn't cost a frame
+	float	ScaleStep;		// scales are multiples of this
+};
+
+struct DynamicResolutionStats
+{
+	DynamicResolutionStats() :
+		NumFrames( 0 ),
+		NumMeasured( 0 ),
+		NumRaises( 0 ),
+		NumDrops( 0 ),
+		Scale( 1.0f ),
+		MinScale( 1.0f ),
+		MaxScale( 1.0f ),
+		ScaleSum( 0.0 ),
+		LoadSum( 0.0 ),
+		PeakLoad( 0.0f ) {}
+
+	int		NumFrames;
+	int		NumMeasured;	// frames with a GPU time
+	int		NumRaises;
+	int		NumDrops;
+	float	Scale;			// the current choice
+	float	MinScale;		// range used over the frames
+	float	MaxScale;
+	double	ScaleSum;		// over NumFrames
+	double	LoadSum;		// GPU time over budget, over NumMeasured
+	float	PeakLoad;
+};
+
+class DynamicResolution
+{
+public:
+						DynamicResolution();
+
+	void				SetParms( const DynamicResolutionParms & parms );
+	const DynamicResolutionParms &	GetParms() const { return Parms; }
+
+	// Called once a frame with the GPU time of recent eye rendering, or 0 if
+	// there is no measurement, and the time available for it, normally
+	// MinimumVsyncs vsync periods. Returns the scale to render the next frame
+	// at. Without measurements the scale stays where it is.
+	float				Update( const float gpuSeconds, const float budgetSeconds );
+
+	float				GetScale() const { return Stats.Scale; }
+
+	// The stats accumulate until reset, except for the current scale.
+	const DynamicResolutionStats &	GetStats() const { return Stats; }
+	void				ResetStats();
+
+private:
+	DynamicResolutionParms	Parms;
+	DynamicResolutionStats	Stats;
+	int						SettleCount;
+	int						LowCount;
+
+	float				QuantizeScale( const float scale ) const;
+	void				ChangeScale( const float scale );
+};
+
+void	LogDynamicResolutionStats( const DynamicResolutionStats & stats );
+
+// Runs the controller against a GPU cost model with load changes, like a heavy
+// scene coming into view, and LOGs how the scale and the load respond. Uses no GL.
+void	SimulateDynamicResolution();
+
+// Checks on the same model that the scale drops quickly enough to get back
+// under budget, stays put within the hysteresis and comes back to full scale.
+bool	TestDynamicResolution();
+
+}	// namespace OVR
+
+#endif	// OVR_DynamicResolution_h
@@ -19,20 +19,42 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "3rdParty/stb/stb_image_write.h"
-
+#include "Kernel/OVR_Alg.h"
 #include "GlUtils.h"
 #include "GlTexture.h"
 #include "Log.h"
-#include "ImageData.h"
+#include "Profiler.h"
 
 using namespace OVR;
 
 EyeBuffers::EyeBuffers() :
-	LogEyeSceneGpuTime(),
+	LogEyeSceneGpuTime( "EyeSceneGpuTime" ),
 	DiscardInsteadOfClear( true ),
-	SwapCount( 0 )
+	RenderResolution( 0 ),
+	SwapCount( 0 ),
+	SharedMultisampleMode( MSAA_OFF ),
+	SharedDepthBuffer( 0 ),
+	SharedMultisampleColorBuffer( 0 )
+{
+}
+
+EyeBuffers::~EyeBuffers()
 {
+	DeleteSharedBuffers();
+}
+
+void EyeBuffers::DeleteSharedBuffers()
+{
+	if ( SharedDepthBuffer )
+	{
+		glDeleteRenderbuffers( 1, &SharedDepthBuffer );
+		SharedDepthBuffer = 0;
+	}
+	if ( SharedMultisampleColorBuffer )
+	{
+		glDeleteRenderbuffers( 1, &SharedMultisampleColorBuffer );
+		SharedMultisampleColorBuffer = 0;
+	}
 }
 
 void EyeBuffer::Delete()
@@ -64,7 +86,51 @@ void EyeBuffer::Delete()
 	}
 }
 
-void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampleMode )
+static GLenum DepthFormat( const EyeParms & bufferParms )
+{
+	// GL_DEPTH_COMPONENT16 is the only strictly legal thing in unextended GL ES 2.0
+	// The GL_OES_depth24 extension allows GL_DEPTH_COMPONENT24_OES.
+	// The GL_OES_packed_depth_stencil extension allows GL_DEPTH24_STENCIL8_OES.
+	return ( bufferParms.depthFormat == DEPTH_24 ) ? GL_DEPTH_COMPONENT24_OES : GL_DEPTH_COMPONENT16;
+}
+
+static GLuint CreateDepthBuffer( const EyeParms & bufferParms, const multisample_t multisampleMode )
+{
+	GLuint depthBuffer = 0;
+	glGenRenderbuffers( 1, &depthBuffer );
+	glBindRenderbuffer( GL_RENDERBUFFER, depthBuffer );
+	if ( multisampleMode == MSAA_RENDER_TO_TEXTURE )
+	{
+		glRenderbufferStorageMultisampleIMG_( GL_RENDERBUFFER, bufferParms.multisamples,
+				DepthFormat( bufferParms ), bufferParms.resolution, bufferParms.resolution );
+	}
+	else if ( multisampleMode == MSAA_BLIT )
+	{
+		glRenderbufferStorageMultisample_( GL_RENDERBUFFER, bufferParms.multisamples,
+				DepthFormat( bufferParms ), bufferParms.resolution, bufferParms.resolution );
+	}
+	else
+	{
+		glRenderbufferStorage( GL_RENDERBUFFER, DepthFormat( bufferParms ), bufferParms.resolution, bufferParms.resolution );
+	}
+	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+	return depthBuffer;
+}
+
+// Only for MSAA_BLIT.
+static GLuint CreateMultisampleColorBuffer( const EyeParms & bufferParms )
+{
+	GLuint colorBuffer = 0;
+	glGenRenderbuffers( 1, &colorBuffer );
+	glBindRenderbuffer( GL_RENDERBUFFER, colorBuffer );
+	const GLuint fmt = ( bufferParms.colorFormat == COLOR_565 ) ?  GL_RGB565 : GL_RGBA8;
+	glRenderbufferStorageMultisample_( GL_RENDERBUFFER, bufferParms.multisamples, fmt, bufferParms.resolution, bufferParms.resolution );
+	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+	return colorBuffer;
+}
+
+void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampleMode,
+		const GLuint sharedDepthBuffer, const GLuint sharedMultisampleColorBuffer )
 {
 	Delete();
 
@@ -122,10 +188,11 @@ void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampl
 			break;
 	}
 
-	// GL_DEPTH_COMPONENT16 is the only strictly legal thing in unextended GL ES 2.0
-	// The GL_OES_depth24 extension allows GL_DEPTH_COMPONENT24_OES.
-	// The GL_OES_packed_depth_stencil extension allows GL_DEPTH24_STENCIL8_OES.
-	const GLenum depthFormat = ( bufferParms.depthFormat == DEPTH_24 ) ? GL_DEPTH_COMPONENT24_OES : GL_DEPTH_COMPONENT16;
+	if ( sharedDepthBuffer == 0 )
+	{
+		DepthBuffer = CreateDepthBuffer( bufferParms, multisampleMode );
+	}
+	const GLuint depthBuffer = sharedDepthBuffer ? sharedDepthBuffer : DepthBuffer;
 
 	if ( multisampleMode == MSAA_RENDER_TO_TEXTURE )
 	{
@@ -133,12 +200,6 @@ void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampl
 		// basis, without needing to draw to a full size multisample buffer, then blit resolve to a
 		// normal texture.
 		LOG( "Making a %i sample buffer with glFramebufferTexture2DMultisample", bufferParms.multisamples );
-		glGenRenderbuffers( 1, &DepthBuffer );
-		glBindRenderbuffer( GL_RENDERBUFFER, DepthBuffer );
-		glRenderbufferStorageMultisampleIMG_( GL_RENDERBUFFER,bufferParms. multisamples,
-    			depthFormat, bufferParms.resolution, bufferParms.resolution );
-
-		glBindRenderbuffer( GL_RENDERBUFFER, 0 );
 
 		// Allocate a new frame buffer and attach the two buffers.
 		glGenFramebuffers( 1, &RenderFrameBuffer );
@@ -148,7 +209,7 @@ void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampl
 				GL_TEXTURE_2D, Texture, 0, bufferParms.multisamples );
 
 		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
-				DepthBuffer );
+				depthBuffer );
 
 		GL_CheckErrors( "glRenderbufferStorageMultisampleIMG MSAA");
 	}
@@ -156,26 +217,21 @@ void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampl
 	{
 		// standard OpenGL ES 3 path for Adreno
 		LOG( "Making a %i sample %i res depth buffer with GL ES 3", bufferParms.multisamples, bufferParms.resolution );
-		glGenRenderbuffers( 1, &DepthBuffer );
-		glBindRenderbuffer( GL_RENDERBUFFER, DepthBuffer );
-		glRenderbufferStorageMultisample_( GL_RENDERBUFFER, bufferParms.multisamples, depthFormat, bufferParms.resolution, bufferParms.resolution );
 
 		// We also need to make a multisample color buffer here
-		glGenRenderbuffers( 1, &MultisampleColorBuffer );
-		glBindRenderbuffer( GL_RENDERBUFFER, MultisampleColorBuffer );
-		const GLuint fmt = ( bufferParms.colorFormat == COLOR_565 ) ?  GL_RGB565 : GL_RGBA8;
-		glRenderbufferStorageMultisample_( GL_RENDERBUFFER, bufferParms.multisamples, fmt, bufferParms.resolution, bufferParms.resolution );
-
-		glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+		if ( sharedMultisampleColorBuffer == 0 )
+		{
+			MultisampleColorBuffer = CreateMultisampleColorBuffer( bufferParms );
+		}
 
 		// Allocate a new frame buffer and attach the two buffers.
 		glGenFramebuffers( 1, &RenderFrameBuffer );
 		glBindFramebuffer( GL_FRAMEBUFFER, RenderFrameBuffer );
 
 		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
-				MultisampleColorBuffer );
+				sharedMultisampleColorBuffer ? sharedMultisampleColorBuffer : MultisampleColorBuffer );
 		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
-				DepthBuffer );
+				depthBuffer );
 
 		GL_CheckErrors( "ES 3 MSAA");
 	}
@@ -183,11 +239,6 @@ void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampl
 	{
 		// No MSAA, use ES 2 render targets
 		LOG( "Making a single sample buffer" );
-		glGenRenderbuffers( 1, &DepthBuffer );
-		glBindRenderbuffer( GL_RENDERBUFFER, DepthBuffer );
-		glRenderbufferStorage( GL_RENDERBUFFER, depthFormat, bufferParms.resolution, bufferParms.resolution );
-
-		glBindRenderbuffer( GL_RENDERBUFFER, 0 );
 
 		// Allocate a new frame buffer and attach the two buffers.
 		glGenFramebuffers( 1, &RenderFrameBuffer );
@@ -195,7 +246,7 @@ void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampl
 		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
 				Texture, 0 );
 		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
-				DepthBuffer );
+				depthBuffer );
 
 		GL_CheckErrors( "NO MSAA");
 	}
@@ -211,6 +262,7 @@ void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampl
 	glViewport( 0, 0, bufferParms.resolution, bufferParms.resolution );
 	glClearColor( 0, 1, 0, 1 );
 	glClear( GL_COLOR_BUFFER_BIT );
+	BlackOutside = bufferParms.resolution;
 
 	// Blit style MSAA needs to make a second FBO
 	if ( multisampleMode == MSAA_BLIT )
@@ -231,67 +283,6 @@ void EyeBuffer::Allocate( const EyeParms & bufferParms, multisample_t multisampl
 	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
 }
 
-// Call with a %i in the fmt string: "/sdcard/Oculus/screenshot%i.bmp"
-static int FindUnusedFilename( const char * fmt, int max )
-{
-	for ( int i = 0 ; i <= max ; i++ )
-	{
-		char	buf[1024];
-		sprintf( buf, fmt, i );
-		FILE * f = fopen( buf, "r" );
-		if ( !f )
-		{
-			return i;
-		}
-		fclose( f );
-	}
-	return max;
-}
-
-static void ScreenShotTexture( const int eyeResolution, const GLuint texId )
-{
-	GLuint	fbo;
-	glGenFramebuffers( 1, &fbo );
-	glBindFramebuffer( GL_FRAMEBUFFER, fbo );
-	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texId, 0 );
-
-	unsigned char * buf = (unsigned char *)malloc( eyeResolution * eyeResolution * 8 );
-	glReadPixels( 0, 0, eyeResolution, eyeResolution, GL_RGBA, GL_UNSIGNED_BYTE, (void *)buf );
-	glDeleteFramebuffers( 1, &fbo );
-
-	for ( int y = 0 ; y < eyeResolution ; y++ )
-	{
-		const int iy = eyeResolution - 1 - y;
-		unsigned char * src = buf + y * eyeResolution * 4;
-		unsigned char * dest = buf + (eyeResolution + iy ) * eyeResolution * 4;
-		memcpy( dest, src, eyeResolution*4 );
-		for ( int x = 0 ; x < eyeResolution ; x++ )
-		{
-			dest[x*4+3] = 255;
-		}
-	}
-
-
-	const char * fmt = "/sdcard/Oculus/screenshot%03i.bmp";
-	const int v = FindUnusedFilename( fmt, 999 );
-	char	filename[1024];
-	sprintf( filename, fmt, v );
-
-	const unsigned char * flipped = (buf + eyeResolution*eyeResolution*4);
-	stbi_write_bmp( filename, eyeResolution, eyeResolution, 4, (void *)flipped );
-
-	// make a quarter size version for launcher thumbnails
-	unsigned char * shrunk1 = QuarterImageSize( flipped, eyeResolution, eyeResolution, true );
-	unsigned char * shrunk2 = QuarterImageSize( shrunk1, eyeResolution>>1, eyeResolution>>1, true );
-	char	filename2[1024];
-	sprintf( filename2, "/sdcard/Oculus/thumbnail%03i.pvr", v );
-	Write32BitPvrTexture( filename2, shrunk2, eyeResolution>>2, eyeResolution>>2 );
-
-	free( buf );
-	free( shrunk1 );
-	free( shrunk2 );
-}
-
 void EyeBuffers::BeginFrame( const EyeParms & bufferParms_ )
 {
 	SwapCount++;
@@ -301,12 +292,17 @@ void EyeBuffers::BeginFrame( const EyeParms & bufferParms_ )
 	// Save the current buffer parms
 	BufferParms = bufferParms_;
 
+	// The viewport for this frame, in whole pixels.
+	RenderResolution = Alg::Clamp( (int)( bufferParms_.resolution * bufferParms_.renderScale + 0.5f ),
+			Alg::Min( 16, bufferParms_.resolution ), bufferParms_.resolution );
+
 	// Update the buffers if parameters have changed
 	if ( buffers.Eyes[0].Texture == 0
 			|| buffers.BufferParms.resolution != bufferParms_.resolution
 			|| buffers.BufferParms.multisamples != bufferParms_.multisamples
 			|| buffers.BufferParms.colorFormat != bufferParms_.colorFormat
 			|| buffers.BufferParms.depthFormat != bufferParms_.depthFormat
+			|| buffers.BufferParms.shareDepthBuffers != bufferParms_.shareDepthBuffers
 			)
 	{
 		/*
@@ -340,23 +336,69 @@ void EyeBuffers::BeginFrame( const EyeParms & bufferParms_ )
 			buffers.MultisampleMode = MSAA_OFF;
 		}
 		GL_CheckErrors( "Before framebuffer creation");
+
+		// Replace the shared buffers if they don't match. Sets that are
+		// still attached to the old ones keep them until they are
+		// reallocated themselves.
+		if ( !bufferParms_.shareDepthBuffers
+				|| SharedDepthBuffer == 0
+				|| SharedMultisampleMode != buffers.MultisampleMode
+				|| SharedParms.resolution != bufferParms_.resolution
+				|| SharedParms.multisamples != bufferParms_.multisamples
+				|| SharedParms.colorFormat != bufferParms_.colorFormat
+				|| SharedParms.depthFormat != bufferParms_.depthFormat )
+		{
+			DeleteSharedBuffers();
+		}
+		if ( bufferParms_.shareDepthBuffers && SharedDepthBuffer == 0 )
+		{
+			LOG( "Allocating shared depth buffers" );
+			SharedParms = bufferParms_;
+			SharedMultisampleMode = buffers.MultisampleMode;
+			SharedDepthBuffer = CreateDepthBuffer( bufferParms_, buffers.MultisampleMode );
+			if ( buffers.MultisampleMode == MSAA_BLIT )
+			{
+				SharedMultisampleColorBuffer = CreateMultisampleColorBuffer( bufferParms_ );
+			}
+		}
+
 		for ( int eye = 0; eye < 2; eye++ ) {
-			buffers.Eyes[eye].Allocate( bufferParms_, buffers.MultisampleMode );
+			buffers.Eyes[eye].Allocate( bufferParms_, buffers.MultisampleMode,
+					SharedDepthBuffer, SharedMultisampleColorBuffer );
 		}
 
 		GL_CheckErrors( "after framebuffer creation" );
+
+		const EyeBufferMemory memory = EyeBufferMemoryForParms( bufferParms_, buffers.MultisampleMode, MAX_EYE_SETS );
+		LOG( "Eye buffer memory: %.1f MB color, %.1f MB depth, %.1f MB multisample color, %.1f MB total%s",
+				memory.ColorBytes / ( 1024.0 * 1024.0 ), memory.DepthBytes / ( 1024.0 * 1024.0 ),
+				memory.MultisampleColorBytes / ( 1024.0 * 1024.0 ), memory.TotalBytes() / ( 1024.0 * 1024.0 ),
+				bufferParms_.shareDepthBuffers ? " with shared depth" : "" );
 	}
 }
 
 void EyeBuffers::BeginRenderingEye( const int eyeNum )
 {
-	const int resolution = BufferParms.resolution;
+	const int resolution = RenderResolution;
 	EyePairs & pair = BufferData[ SwapCount % MAX_EYE_SETS ];
 	EyeBuffer & eye = pair.Eyes[eyeNum];
+	const bool scaled = ( resolution < BufferParms.resolution );
 
 	LogEyeSceneGpuTime.Begin( eyeNum );
 	LogEyeSceneGpuTime.PrintTime( eyeNum, "GPU time for eye render" );
 
+	// If this buffer was last rendered larger, or still has the allocation
+	// color, black out the whole texture so the time warp doesn't see old
+	// pixels past the rendered part. This only happens when the scale drops.
+	if ( resolution < eye.BlackOutside )
+	{
+		glBindFramebuffer( GL_FRAMEBUFFER, eye.ResolveFrameBuffer ? eye.ResolveFrameBuffer : eye.RenderFrameBuffer );
+		glScissor( 0, 0, BufferParms.resolution, BufferParms.resolution );
+		glClearColor( 0, 0, 0, 1 );
+		glClear( GL_COLOR_BUFFER_BIT );
+	}
+	eye.BlackOutside = resolution;
+
 	glBindFramebuffer( GL_FRAMEBUFFER, eye.RenderFrameBuffer );
 	glViewport( 0, 0, resolution, resolution );
 	glScissor( 0, 0, resolution, resolution );
@@ -364,13 +406,20 @@ void EyeBuffers::BeginRenderingEye( const int eyeNum )
 	glEnable( GL_DEPTH_TEST );
 	glDepthFunc( GL_LEQUAL );
 
-	if ( DiscardInsteadOfClear )
+	// Invalidating color would lose the black outside the viewport, so a
+	// scaled frame clears the scissored part instead. Depth is never kept,
+	// and a shared depth buffer was last written by another eye.
+	if ( DiscardInsteadOfClear && !scaled )
 	{
 		GL_InvalidateFramebuffer( INV_FBO, true, true );
 		glClear( GL_DEPTH_BUFFER_BIT );
 	}
 	else
 	{
+		if ( DiscardInsteadOfClear )
+		{
+			GL_InvalidateFramebuffer( INV_FBO, false, true );
+		}
 		glClearColor( 0, 0, 0, 1 );
 		glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 	}
@@ -378,11 +427,12 @@ void EyeBuffers::BeginRenderingEye( const int eyeNum )
 
 void EyeBuffers::EndRenderingEye( const int eyeNum )
 {
-	const int resolution = BufferParms.resolution;
+	const int resolution = RenderResolution;
 	EyePairs & pair = BufferData[ SwapCount % MAX_EYE_SETS ];
 	EyeBuffer & eye = pair.Eyes[eyeNum];
 
 	// Discard the depth buffer, so the tiler won't need to write it back out to memory
+	glBindFramebuffer( GL_FRAMEBUFFER, eye.RenderFrameBuffer );
 	GL_InvalidateFramebuffer( INV_FBO, false, true );
 
 	// Do a blit-MSAA-resolve if necessary.
@@ -394,12 +444,22 @@ void EyeBuffers::EndRenderingEye( const int eyeNum )
 				0, 0, resolution, resolution,
 				GL_COLOR_BUFFER_BIT, GL_NEAREST );
 		// Discard the multisample color buffer after we have resolved it,
-		// so the tiler won't need to write it back out to memory
+		// so the tiler won't need to write it back out to memory. The
+		// invalidate works on the draw framebuffer, which the blit left
+		// on the resolved texture.
+		glBindFramebuffer( GL_FRAMEBUFFER, eye.RenderFrameBuffer );
 		GL_InvalidateFramebuffer( INV_FBO, true, false );
 	}
 
 	LogEyeSceneGpuTime.End( eyeNum );
 
+	// Outside the GPU time, so captures don't move the render scale.
+	if ( eyeNum == 0 )
+	{
+		OVR_PROFILE_SCOPE( "FrameCapture" );
+		Capture.Update( eye.Texture, resolution );
+	}
+
 	// As of 4/24/2014, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR is still performing
 	// a full glFinish on i9506, but not in GS5
 #if 0
@@ -442,11 +502,80 @@ CompletedEyes EyeBuffers::GetCompletedEyes()
 		cmp.Textures[e] = buffers->Eyes[e].Texture;
 	}
 	cmp.ColorFormat = buffers->BufferParms.colorFormat;
+	cmp.RenderScale = (float)RenderResolution / buffers->BufferParms.resolution;
 
 	return cmp;
 }
 
 void EyeBuffers::ScreenShot()
 {
-	ScreenShotTexture( BufferParms.resolution, BufferData[0].Eyes[0].Texture );
+	Capture.RequestScreenShot();
+}
+
+void EyeBuffers::CaptureSequence( const int numFrames )
+{
+	Capture.RequestSequence( numFrames );
+}
+
+static size_t ColorBytesPerPixel( const EyeParms & bufferParms )
+{
+	return ( bufferParms.colorFormat == COLOR_565 ) ? 2 : 4;
+}
+
+static size_t DepthBytesPerPixel( const EyeParms & bufferParms )
+{
+	// 24 bit depth is padded to 32 bits.
+	return ( bufferParms.depthFormat == DEPTH_16 ) ? 2 : 4;
+}
+
+EyeBufferMemory OVR::EyeBufferMemoryForParms( const EyeParms & bufferParms, const multisample_t multisampleMode,
+		const int numEyeSets )
+{
+	const size_t pixels = (size_t)bufferParms.resolution * bufferParms.resolution;
+	const size_t samples = ( multisampleMode == MSAA_OFF ) ? 1 : bufferParms.multisamples;
+	const int numEyes = numEyeSets * 2;
+	const int numDepthBuffers = bufferParms.shareDepthBuffers ? 1 : numEyes;
+
+	EyeBufferMemory memory;
+	memory.ColorBytes = numEyes * pixels * ColorBytesPerPixel( bufferParms );
+	memory.DepthBytes = numDepthBuffers * pixels * samples * DepthBytesPerPixel( bufferParms );
+	memory.MultisampleColorBytes = ( multisampleMode == MSAA_BLIT ) ? numDepthBuffers * pixels * samples * ColorBytesPerPixel( bufferParms ) : 0;
+	return memory;
+}
+
+void OVR::LogEyeBufferMemoryTable()
+{
+	static const int resolutions[] = { 768, 1024, 1536 };
+	static const int multisamples[] = { 1, 2, 4 };
+	static const depthFormat_t depthFormats[] = { DEPTH_16, DEPTH_24 };
+
+	for ( int r = 0; r < (int)( sizeof( resolutions ) / sizeof( resolutions[0] ) ); r++ )
+	{
+		for ( int m = 0; m < (int)( sizeof( multisamples ) / sizeof( multisamples[0] ) ); m++ )
+		{
+			for ( int d = 0; d < (int)( sizeof( depthFormats ) / sizeof( depthFormats[0] ) ); d++ )
+			{
+				for ( int blit = 0; blit < ( multisamples[m] > 1 ? 2 : 1 ); blit++ )
+				{
+					EyeParms parms;
+					parms.resolution = resolutions[r];
+					parms.multisamples = multisamples[m];
+					parms.depthFormat = depthFormats[d];
+					const multisample_t mode = ( multisamples[m] == 1 ) ? MSAA_OFF : ( blit ? MSAA_BLIT : MSAA_RENDER_TO_TEXTURE );
+
+					parms.shareDepthBuffers = false;
+					const EyeBufferMemory separate = EyeBufferMemoryForParms( parms, mode, EyeBuffers::MAX_EYE_SETS );
+					parms.shareDepthBuffers = true;
+					const EyeBufferMemory shared = EyeBufferMemoryForParms( parms, mode, EyeBuffers::MAX_EYE_SETS );
+
+					LOG( "Eye buffers %4i %ix %-14s depth %i: %6.1f MB, %6.1f MB shared, %6.1f MB saved",
+							resolutions[r], multisamples[m],
+							( mode == MSAA_OFF ) ? "" : ( ( mode == MSAA_BLIT ) ? "blit" : "render to tex" ),
+							( depthFormats[d] == DEPTH_16 ) ? 16 : 24,
+							separate.TotalBytes() / ( 1024.0 * 1024.0 ), shared.TotalBytes() / ( 1024.0 * 1024.0 ),
+							( separate.TotalBytes() - shared.TotalBytes() ) / ( 1024.0 * 1024.0 ) );
+				}
+			}
+		}
+	}
 }
@@ -15,6 +15,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "GlUtils.h"	// GLuint
 #include "OVR_CAPI.h"		// OvrHMD
 #include "Log.h"
+#include "FrameCapture.h"
 
 namespace OVR {
 
@@ -61,7 +62,11 @@ struct EyeParms
 			multisamples( 2 ),
 			colorFormat( COLOR_8888 ),
 			depthFormat( DEPTH_24 ),
-			textureFilter( TEXTURE_FILTER_BILINEAR )
+			textureFilter( TEXTURE_FILTER_BILINEAR ),
+			renderScale( 1.0f ),
+			dynamicRenderScale( false ),
+			minRenderScale( 0.5f ),
+			shareDepthBuffers( false )
 		{
 		}
 
@@ -87,6 +92,25 @@ struct EyeParms
 	// Determines how the time warp samples the eye buffers.
 	// Defaults to TEXTURE_FILTER_BILINEAR.
 	textureFilter_t		textureFilter;
+
+	// Fraction of the resolution in each dimension that is actually rendered.
+	// The buffers stay allocated at the full resolution and only the viewport
+	// shrinks, so this can change every frame without reallocating anything,
+	// and the time warp samples the rendered part automatically.
+	float				renderScale;
+
+	// If set, the application picks renderScale every frame from the measured
+	// eye GPU time against the vsync budget, never going below minRenderScale.
+	// This needs GPU timer queries, enabled with dev_gpuTimings; without
+	// measurements the scale stays where it is.
+	bool				dynamicRenderScale;
+	float				minRenderScale;
+
+	// If set, both eyes of all the eye buffer sets render with a single depth
+	// buffer, and a single multisample color buffer for MSAA_BLIT, instead of
+	// one each. Both are invalidated at the end of every eye, so nothing is
+	// lost, but the driver can no longer overlap one eye with the next.
+	bool				shareDepthBuffers;
 };
 
 enum multisample_t
@@ -110,7 +134,8 @@ struct EyeBuffer
 			MultisampleColorBuffer( 0 ),
 			RenderFrameBuffer( 0 ),
 			ResolveFrameBuffer( 0 ),
-			SyncObject( 0 )
+			SyncObject( 0 ),
+			BlackOutside( 0 )
 		{
 		}
 		~EyeBuffer()
@@ -122,15 +147,21 @@ struct EyeBuffer
 	// Any background time warping from the buffers must be already stopped!
 	void				Delete();
 
+	// The shared buffers are attached instead of allocating new ones
+	// if they are not 0, and are not deleted with this.
 	void				Allocate( const EyeParms & bufferParms,
-									multisample_t multisampleMode );
+									multisample_t multisampleMode,
+									const GLuint sharedDepthBuffer,
+									const GLuint sharedMultisampleColorBuffer );
 
 	GLuint				Texture;
 
-	// This may be a normal or multisample buffer
+	// This may be a normal or multisample buffer.
+	// 0 if EyeBuffers::SharedDepthBuffer is attached instead.
 	GLuint				DepthBuffer;
 
 	// This is not used for single sample rendering or glFramebufferTexture2DMultisampleEXT
+	// 0 if EyeBuffers::SharedMultisampleColorBuffer is attached instead.
 	GLuint				MultisampleColorBuffer;
 
 	// For non-MSAA or glFramebufferTexture2DMultisampleEXT,
@@ -147,6 +178,10 @@ struct EyeBuffer
 	// drawing to start, and will allow us to check for
 	// completion next frame.
 	EGLSyncKHR			SyncObject;
+
+	// Everything in Texture outside of the square of this size at the origin
+	// is black, so the time warp can sample past the rendered part.
+	int					BlackOutside;
 };
 
 struct EyePairs
@@ -166,6 +201,24 @@ enum EyeIndex
 };
 
 
+// Bytes of GPU memory for all the eye buffer sets.
+struct EyeBufferMemory
+{
+	size_t			ColorBytes;
+	size_t			DepthBytes;
+	size_t			MultisampleColorBytes;
+
+	size_t			TotalBytes() const { return ColorBytes + DepthBytes + MultisampleColorBytes; }
+};
+
+// The nominal allocation, the driver may pad or compress it.
+EyeBufferMemory	EyeBufferMemoryForParms( const EyeParms & bufferParms, const multisample_t multisampleMode,
+						const int numEyeSets );
+
+// Logs the memory of common configurations, with and without shared depth buffers.
+// Called once when the developer debug options are enabled.
+void	LogEyeBufferMemoryTable();
+
 // This is handed off to TimeWarp
 struct CompletedEyes
 {
@@ -175,6 +228,9 @@ struct CompletedEyes
 	// For GPU time warp
 	// This will be the MSAA resolved buffer if a blit was done.
 	GLuint			Textures[2];
+
+	// The rendered part of the textures, for TexCoordsFromTanAngles.
+	float			RenderScale;
 };
 
 
@@ -182,11 +238,16 @@ class EyeBuffers
 {
 public:
 	EyeBuffers();
+	~EyeBuffers();
 
 	// Note the pose information for this frame and
 	// Possibly reconfigure the buffer.
 	void		BeginFrame( const EyeParms & 	bufferParms_ );
 
+	// The size of the rendered square this frame, from
+	// BufferParms.resolution and renderScale.
+	int			GetRenderResolution() const { return RenderResolution; }
+
 	// Handles binding the FBO or making the surface current,
 	// and setting up the viewport.
 	//
@@ -203,12 +264,20 @@ public:
 	// eye buffer set for TimeWarp to use.
 	CompletedEyes	GetCompletedEyes();
 
-	// Create a screenshot and a thumbnail from the undistorted left eye view
+	// Create a screenshot and a thumbnail from the undistorted left eye view.
+	// The read back and the file writing happen over the following frames
+	// without stalling rendering.
 	void 		ScreenShot();
 
+	// Write the undistorted left eye view of each of the next numFrames frames.
+	void		CaptureSequence( const int numFrames );
+
 	// GPU time queries around eye scene rendering.
 	LogGpuTime<2>	LogEyeSceneGpuTime;
 
+	// Read back for ScreenShot() and CaptureSequence().
+	FrameCapture	Capture;
+
 	// SGX wants a clear, Adreno wants a discard, not sure what Mali wants.
 	bool			DiscardInsteadOfClear;
 
@@ -216,6 +285,7 @@ public:
 	// If this just changed, not all eye buffers will
 	// necessarily have been reallocated yet.
 	EyeParms 		BufferParms;
+	int				RenderResolution;
 
 	// For asynchronous time warp, we need to
 	// triple buffer the eye pairs:
@@ -226,10 +296,21 @@ public:
 	// If we knew the driver wasn't going to do any interlocks,
 	// we could get by with two.
 	//
-	// We should consider sharing the depth buffers.
+	// EyeParms::shareDepthBuffers can share the depth buffers.
 	static const int MAX_EYE_SETS = 3;
 	long 			SwapCount;		// continuously increasing
 	EyePairs		BufferData[MAX_EYE_SETS];
+
+	// Attached to every set allocated with shareDepthBuffers.
+	// Sets allocated with different parameters keep the old ones
+	// alive through their attachments until they are reallocated.
+	EyeParms		SharedParms;
+	multisample_t	SharedMultisampleMode;
+	GLuint			SharedDepthBuffer;
+	GLuint			SharedMultisampleColorBuffer;
+
+private:
+	void			DeleteSharedBuffers();
 };
 
 }	// namespace OVR
@@ -0,0 +1,476 @@
+/************************************************************************************
+
+Filename    :   FrameCapture.cpp
+Content     :   Screenshots and frame sequences read back without stalling rendering.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "FrameCapture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Kernel/OVR_Timer.h"
+#include "Kernel/OVR_Trace.h"
+#include "Log.h"
+#include "Profiler.h"
+#include "ImageData.h"
+#include "VrCommon.h"		// WriteJpeg
+
+namespace OVR
+{
+
+// Call with a %i in the fmt string: "/sdcard/Oculus/screenshot%03i.jpg"
+static int FindUnusedFilename( const char * fmt, int max )
+{
+	for ( int i = 0 ; i <= max ; i++ )
+	{
+		char	buf[1024];
+		sprintf( buf, fmt, i );
+		FILE * f = fopen( buf, "r" );
+		if ( !f )
+		{
+			return i;
+		}
+		fclose( f );
+	}
+	return max;
+}
+
+FrameCapture::FrameCapture() :
+	FrameBufferObject( 0 ),
+	Display( EGL_NO_DISPLAY ),
+	ScreenShotRequested( false ),
+	SequenceRemaining( 0 ),
+	SequenceFrame( 0 ),
+	SkippedFrames( 0 ),
+	CaptureCount( 0 ),
+	Thread( 0 ),
+	Shutdown( false ),
+	SequenceFileIndex( 0 ),
+	SequenceFramesWritten( 0 ),
+	SequenceFramesSkipped( 0 ),
+	SequenceEncodeSeconds( 0.0 ),
+	SequenceReadBackSeconds( 0.0 )
+{
+	for ( int i = 0 ; i < NUM_SLOTS ; i++ )
+	{
+		CaptureSlot & slot = Slots[i];
+		slot.Buffer = 0;
+		slot.BufferBytes = 0;
+		slot.Sync = EGL_NO_SYNC_KHR;
+		slot.CountdownToMap = 0;
+		slot.MappedAddress = NULL;
+		slot.State = SLOT_FREE;
+		slot.CaptureNumber = 0;
+		slot.Resolution = 0;
+		slot.ScreenShot = false;
+		slot.SequenceFrame = 0;
+		slot.LastOfSequence = false;
+		slot.SkippedFrames = 0;
+		slot.ReadBackSeconds = 0.0;
+	}
+
+	pthread_mutex_init( &Mutex, NULL /* default attributes */ );
+	pthread_cond_init( &Condition, NULL /* default attributes */ );
+
+	const int createErr = pthread_create( &Thread, NULL /* default attributes */, &ThreadStarter, this );
+	if ( createErr != 0 )
+	{
+		FAIL( "pthread_create returned %i", createErr );
+	}
+}
+
+FrameCapture::~FrameCapture()
+{
+	// The worker empties the queue before it exits, so nothing
+	// that was already read back is lost.
+	pthread_mutex_lock( &Mutex );
+	Shutdown = true;
+	pthread_cond_signal( &Condition );
+	pthread_mutex_unlock( &Mutex );
+	pthread_join( Thread, NULL );
+
+	// Make sure no glReadPixels is still writing to a buffer.
+	glFinish();
+
+	for ( int i = 0 ; i < NUM_SLOTS ; i++ )
+	{
+		CaptureSlot & slot = Slots[i];
+		if ( slot.Sync != EGL_NO_SYNC_KHR )
+		{
+			eglDestroySyncKHR_( Display, slot.Sync );
+			slot.Sync = EGL_NO_SYNC_KHR;
+		}
+		if ( slot.Buffer )
+		{
+			if ( slot.State == SLOT_RELEASED )
+			{
+				glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
+				glUnmapBuffer_( GL_PIXEL_PACK_BUFFER );
+				glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+			}
+			glDeleteBuffers( 1, &slot.Buffer );
+			slot.Buffer = 0;
+		}
+	}
+	if ( FrameBufferObject )
+	{
+		glDeleteFramebuffers( 1, &FrameBufferObject );
+		FrameBufferObject = 0;
+	}
+
+	pthread_cond_destroy( &Condition );
+	pthread_mutex_destroy( &Mutex );
+}
+
+void FrameCapture::RequestScreenShot()
+{
+	ScreenShotRequested = true;
+}
+
+void FrameCapture::RequestSequence( const int numFrames )
+{
+	// A new request restarts the sequence, so frames are always numbered
+	// from zero in a new set of files.
+	SequenceRemaining = numFrames;
+	SequenceFrame = 0;
+	SkippedFrames = 0;
+}
+
+void * FrameCapture::ThreadStarter( void * parm )
+{
+	pthread_setname_np( pthread_self(), "FrameCapture" );
+	Trace::SetThreadName( "FrameCapture" );
+
+	( (FrameCapture *)parm )->WorkerThread();
+	return NULL;
+}
+
+void FrameCapture::WorkerThread()
+{
+	for ( ; ; )
+	{
+		pthread_mutex_lock( &Mutex );
+		while ( Queue.GetSizeI() == 0 && !Shutdown )
+		{
+			pthread_cond_wait( &Condition, &Mutex );
+		}
+		if ( Queue.GetSizeI() == 0 )
+		{
+			pthread_mutex_unlock( &Mutex );
+			break;
+		}
+		const int slotIndex = Queue[0];
+		Queue.RemoveAt( 0 );
+		pthread_mutex_unlock( &Mutex );
+
+		Encode( slotIndex );
+	}
+}
+
+// Called on the worker thread while it owns the slot.
+void FrameCapture::Encode( const int slotIndex )
+{
+	// The slot goes back to the render thread before the compression, so
+	// take everything needed from it first.
+	const CaptureSlot & slot = Slots[slotIndex];
+	const int resolution = slot.Resolution;
+	const bool screenShot = slot.ScreenShot;
+	const int sequenceFrame = slot.SequenceFrame;
+	const bool lastOfSequence = slot.LastOfSequence;
+	const int skippedFrames = slot.SkippedFrames;
+	const double readBackSeconds = slot.ReadBackSeconds;
+
+	const TraceScope traceEncode( TRACE_LOAD, "CaptureEncode" );
+	const double start = Timer::GetSeconds();
+
+	// GL rows are bottom first. The eye buffers can have any alpha,
+	// which would show through in image viewers.
+	unsigned char * pixels = (unsigned char *)malloc( resolution * resolution * 4 );
+	const unsigned char * src = (const unsigned char *)slot.MappedAddress;
+	for ( int y = 0 ; y < resolution ; y++ )
+	{
+		unsigned char * dest = pixels + ( resolution - 1 - y ) * resolution * 4;
+		memcpy( dest, src + y * resolution * 4, resolution * 4 );
+		for ( int x = 0 ; x < resolution ; x++ )
+		{
+			dest[x*4+3] = 255;
+		}
+	}
+
+	// The buffer can be reused while this one compresses.
+	pthread_mutex_lock( &Mutex );
+	Slots[slotIndex].State = SLOT_RELEASED;
+	pthread_mutex_unlock( &Mutex );
+
+	char	filename[1024];
+	if ( screenShot )
+	{
+		const int v = FindUnusedFilename( "/sdcard/Oculus/screenshot%03i.jpg", 999 );
+		sprintf( filename, "/sdcard/Oculus/screenshot%03i.jpg", v );
+		WriteJpeg( filename, pixels, resolution, resolution );
+
+		// make a quarter size version for launcher thumbnails
+		unsigned char * shrunk1 = QuarterImageSize( pixels, resolution, resolution, true );
+		unsigned char * shrunk2 = QuarterImageSize( shrunk1, resolution>>1, resolution>>1, true );
+		char	filename2[1024];
+		sprintf( filename2, "/sdcard/Oculus/thumbnail%03i.pvr", v );
+		Write32BitPvrTexture( filename2, shrunk2, resolution>>2, resolution>>2 );
+		free( shrunk1 );
+		free( shrunk2 );
+
+		LOG( "FrameCapture: wrote %s in %3.1f ms, read back in %3.2f ms on the render thread",
+				filename, ( Timer::GetSeconds() - start ) * 1000.0, readBackSeconds * 1000.0 );
+	}
+	else
+	{
+		if ( sequenceFrame == 0 )
+		{
+			SequenceFileIndex = FindUnusedFilename( "/sdcard/Oculus/capture%03i_0000.jpg", 999 );
+			SequenceFramesWritten = 0;
+			SequenceFramesSkipped = 0;
+			SequenceEncodeSeconds = 0.0;
+			SequenceReadBackSeconds = 0.0;
+		}
+		sprintf( filename, "/sdcard/Oculus/capture%03i_%04i.jpg", SequenceFileIndex, sequenceFrame );
+		WriteJpeg( filename, pixels, resolution, resolution );
+
+		SequenceFramesWritten++;
+		SequenceFramesSkipped += skippedFrames;
+		SequenceEncodeSeconds += Timer::GetSeconds() - start;
+		SequenceReadBackSeconds += readBackSeconds;
+		if ( lastOfSequence )
+		{
+			LOG( "FrameCapture: wrote %i frames to /sdcard/Oculus/capture%03i_*.jpg, %i frames skipped, "
+					"%3.1f ms per frame to encode, %3.2f ms per frame to read back on the render thread",
+					SequenceFramesWritten, SequenceFileIndex, SequenceFramesSkipped,
+					SequenceEncodeSeconds * 1000.0 / SequenceFramesWritten,
+					SequenceReadBackSeconds * 1000.0 / SequenceFramesWritten );
+		}
+	}
+
+	free( pixels );
+}
+
+// Called on the render thread.
+void FrameCapture::QueueSlot( const int slotIndex )
+{
+	pthread_mutex_lock( &Mutex );
+	Slots[slotIndex].State = SLOT_ENCODING;
+	Queue.PushBack( slotIndex );
+	pthread_cond_signal( &Condition );
+	pthread_mutex_unlock( &Mutex );
+}
+
+// Unmaps the buffers the worker has finished with so they can be reused.
+void FrameCapture::ReclaimSlots()
+{
+	for ( int i = 0 ; i < NUM_SLOTS ; i++ )
+	{
+		CaptureSlot & slot = Slots[i];
+		pthread_mutex_lock( &Mutex );
+		const bool released = ( slot.State == SLOT_RELEASED );
+		pthread_mutex_unlock( &Mutex );
+		if ( !released )
+		{
+			continue;
+		}
+		if ( slot.Buffer )
+		{
+			glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
+			glUnmapBuffer_( GL_PIXEL_PACK_BUFFER );
+			glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+		}
+		slot.MappedAddress = NULL;
+
+		pthread_mutex_lock( &Mutex );
+		slot.State = SLOT_FREE;
+		pthread_mutex_unlock( &Mutex );
+	}
+}
+
+// Maps the read backs whose fences have passed, oldest first, and hands
+// them to the worker. The GPU finishes them in order, so the first one
+// that isn't done ends the search.
+void FrameCapture::MapCompletedSlots()
+{
+	for ( ; ; )
+	{
+		int oldest = -1;
+		for ( int i = 0 ; i < NUM_SLOTS ; i++ )
+		{
+			if ( Slots[i].State == SLOT_READING &&
+					( oldest == -1 || Slots[i].CaptureNumber < Slots[oldest].CaptureNumber ) )
+			{
+				oldest = i;
+			}
+		}
+		if ( oldest == -1 )
+		{
+			return;
+		}
+
+		CaptureSlot & slot = Slots[oldest];
+		if ( slot.Sync != EGL_NO_SYNC_KHR )
+		{
+			const EGLint wait = eglClientWaitSyncKHR_( Display, slot.Sync, 0, 0 );
+			if ( wait == EGL_TIMEOUT_EXPIRED_KHR )
+			{
+				return;
+			}
+			if ( wait == EGL_FALSE )
+			{
+				LOG( "eglClientWaitSyncKHR returned EGL_FALSE" );
+			}
+			eglDestroySyncKHR_( Display, slot.Sync );
+			slot.Sync = EGL_NO_SYNC_KHR;
+		}
+		else if ( --slot.CountdownToMap > 0 )
+		{
+			// without a fence, we are only guaranteed the read back
+			// has completed on the second following frame
+			return;
+		}
+
+		const double mapStart = Timer::GetSeconds();
+		{
+			OVR_PROFILE_TRACE_SCOPE( TRACE_FRAME, "CaptureMap" );
+			glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
+			slot.MappedAddress = glMapBufferRange_( GL_PIXEL_PACK_BUFFER, 0,
+					slot.Resolution * slot.Resolution * 4, GL_MAP_READ_BIT );
+			glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+		}
+		slot.ReadBackSeconds += Timer::GetSeconds() - mapStart;
+		if ( slot.MappedAddress == NULL )
+		{
+			LOG( "FrameCapture: couldn't map PBO" );
+			slot.State = SLOT_FREE;
+			continue;
+		}
+
+		QueueSlot( oldest );
+	}
+}
+
+void FrameCapture::StartReadBack( CaptureSlot & slot, const GLuint texId, const int resolution )
+{
+	OVR_PROFILE_TRACE_SCOPE( TRACE_FRAME, "CaptureReadBack" );
+	const double start = Timer::GetSeconds();
+
+	const int bytes = resolution * resolution * 4;
+	bool synchronous = false;
+
+	if ( !FrameBufferObject )
+	{
+		glGenFramebuffers( 1, &FrameBufferObject );
+	}
+	glBindFramebuffer( GL_FRAMEBUFFER, FrameBufferObject );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texId, 0 );
+
+	slot.CaptureNumber = ++CaptureCount;
+	slot.Resolution = resolution;
+
+	if ( glMapBufferRange_ != NULL )
+	{
+		if ( slot.BufferBytes < bytes )
+		{
+			if ( !slot.Buffer )
+			{
+				glGenBuffers( 1, &slot.Buffer );
+			}
+			glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
+			glBufferData( GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_DYNAMIC_READ );
+			slot.BufferBytes = bytes;
+		}
+
+		// Issue an async read into the PBO
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
+		glReadPixels( 0, 0, resolution, resolution, GL_RGBA, GL_UNSIGNED_BYTE, 0 );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+		if ( eglCreateSyncKHR_ != NULL )
+		{
+			Display = eglGetCurrentDisplay();
+			slot.Sync = eglCreateSyncKHR_( Display, EGL_SYNC_FENCE_KHR, NULL );
+			if ( slot.Sync == EGL_NO_SYNC_KHR )
+			{
+				LOG( "eglCreateSyncKHR returned EGL_NO_SYNC_KHR" );
+			}
+		}
+		slot.CountdownToMap = 2;
+		slot.State = SLOT_READING;
+	}
+	else
+	{
+		slot.Copy.Resize( bytes );
+		glReadPixels( 0, 0, resolution, resolution, GL_RGBA, GL_UNSIGNED_BYTE, slot.Copy.GetDataPtr() );
+		slot.MappedAddress = slot.Copy.GetDataPtr();
+		synchronous = true;
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+	GL_CheckErrors( "FrameCapture" );
+
+	// Mapping adds to this when the read back is asynchronous.
+	slot.ReadBackSeconds = Timer::GetSeconds() - start;
+	if ( synchronous )
+	{
+		QueueSlot( &slot - Slots );
+	}
+}
+
+void FrameCapture::Update( const GLuint texId, const int resolution )
+{
+	ReclaimSlots();
+	MapCompletedSlots();
+
+	if ( !IsCapturing() )
+	{
+		return;
+	}
+
+	// Only the render thread moves a slot out of SLOT_FREE.
+	int freeSlot = -1;
+	for ( int i = 0 ; i < NUM_SLOTS && freeSlot == -1 ; i++ )
+	{
+		if ( Slots[i].State == SLOT_FREE )
+		{
+			freeSlot = i;
+		}
+	}
+
+	// Never wait - skip this frame and try again next frame.
+	if ( freeSlot == -1 )
+	{
+		SkippedFrames++;
+		return;
+	}
+
+	CaptureSlot & slot = Slots[freeSlot];
+	if ( ScreenShotRequested )
+	{
+		ScreenShotRequested = false;
+		slot.ScreenShot = true;
+		slot.SequenceFrame = 0;
+		slot.LastOfSequence = false;
+		slot.SkippedFrames = 0;
+	}
+	else
+	{
+		slot.ScreenShot = false;
+		slot.SequenceFrame = SequenceFrame++;
+		slot.LastOfSequence = ( --SequenceRemaining == 0 );
+		slot.SkippedFrames = SkippedFrames;
+		SkippedFrames = 0;
+	}
+
+	// The launcher thumbnail is a quarter size.
+	StartReadBack( slot, texId, resolution & ~3 );
+}
+
+}	// namespace OVR
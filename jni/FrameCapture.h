@@ -0,0 +1,123 @@
+/************************************************************************************
+
+Filename    :   FrameCapture.h
+Content     :   Screenshots and frame sequences read back without stalling rendering.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+#ifndef OVR_FrameCapture_h
+#define OVR_FrameCapture_h
+
+#include <pthread.h>
+
+#include "Kernel/OVR_Array.h"
+#include "GlUtils.h"
+
+namespace OVR
+{
+
+// The eye texture is read into a pixel buffer object with a fence after it,
+// and only mapped once the fence has passed, so the render thread never waits
+// on the GPU. The mapped pixels are flipped and compressed on a worker thread,
+// which also does all the file writing. If every buffer is still in flight,
+// the frame is skipped and counted rather than waited for.
+//
+// Without GL ES 3 pixel buffer objects, the read back is synchronous, but the
+// encoding still happens on the worker.
+class FrameCapture
+{
+public:
+					FrameCapture();
+
+	// Must be called with the GL context current. Captures that are
+	// already read back are still written out.
+					~FrameCapture();
+
+	// Writes the next left eye to /sdcard/Oculus/screenshotNNN.jpg, with a
+	// quarter size thumbnailNNN.pvr for the launcher.
+	void			RequestScreenShot();
+
+	// Writes each of the next numFrames left eyes to
+	// /sdcard/Oculus/captureNNN_FFFF.jpg, for looking at frame to
+	// frame problems.
+	void			RequestSequence( const int numFrames );
+
+	bool			IsCapturing() const { return ScreenShotRequested || SequenceRemaining > 0; }
+
+	// Called on the render thread once a frame, after the left eye has
+	// been resolved. Starts a read back if one is wanted, and hands finished
+	// ones to the worker.
+	void			Update( const GLuint texId, const int resolution );
+
+private:
+	static const int	NUM_SLOTS = 3;
+
+	enum eSlotState
+	{
+		SLOT_FREE,			// available for the next capture
+		SLOT_READING,		// glReadPixels issued, waiting for the fence
+		SLOT_ENCODING,		// mapped and owned by the worker
+		SLOT_RELEASED		// worker is done, the render thread needs to unmap it
+	};
+
+	struct CaptureSlot
+	{
+		GLuint					Buffer;
+		int						BufferBytes;
+		EGLSyncKHR				Sync;
+		int						CountdownToMap;		// used when there is no fence
+		const void *			MappedAddress;
+		Array< unsigned char >	Copy;				// synchronous read back without PBOs
+		eSlotState				State;
+		int						CaptureNumber;		// order of issue
+		int						Resolution;
+		bool					ScreenShot;
+		int						SequenceFrame;		// 0 starts a new sequence
+		bool					LastOfSequence;
+		int						SkippedFrames;		// sequence frames skipped since the last capture
+		double					ReadBackSeconds;	// render thread time to read back and map
+	};
+
+	static void *	ThreadStarter( void * parm );
+	void			WorkerThread();
+
+	// Worker thread
+	void			Encode( const int slotIndex );
+
+	// Render thread
+	void			ReclaimSlots();
+	void			MapCompletedSlots();
+	void			StartReadBack( CaptureSlot & slot, const GLuint texId, const int resolution );
+	void			QueueSlot( const int slotIndex );
+
+	// Render thread only, except for slots in SLOT_ENCODING
+	CaptureSlot		Slots[NUM_SLOTS];
+	GLuint			FrameBufferObject;
+	EGLDisplay		Display;
+	bool			ScreenShotRequested;
+	int				SequenceRemaining;
+	int				SequenceFrame;
+	int				SkippedFrames;
+	int				CaptureCount;
+
+	pthread_t		Thread;
+
+	// Guards Slots[].State, Queue and Shutdown
+	pthread_mutex_t	Mutex;
+	pthread_cond_t	Condition;
+	Array< int >	Queue;				// indices of SLOT_ENCODING slots, in capture order
+	bool			Shutdown;
+
+	// Worker thread only
+	int				SequenceFileIndex;
+	int				SequenceFramesWritten;
+	int				SequenceFramesSkipped;
+	double			SequenceEncodeSeconds;
+	double			SequenceReadBackSeconds;
+};
+
+}	// namespace OVR
+
+#endif	// OVR_FrameCapture_h
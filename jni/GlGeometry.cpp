@@ -54,10 +54,369 @@ void PackVertexAttribute( Array< uint8_t > & packed, const Array< _attrib_type_
 	}
 }
 
-void GlGeometry::Create( const VertexAttribs & attribs, const Array< TriangleIndex > & indices )
+/*
+	Packed vertex layout
+*/
+
+// Half floats are only used for texture coordinates when every value survives
+// the conversion to within a quarter texel of a 1024 texel texture.
+static const float HALF_FLOAT_UV_TOLERANCE = 1.0f / 4096.0f;
+
+struct PackedFormat
+{
+	PackedFormat() : type( 0 ), components( 0 ), normalized( false ), size( 0 ), offset( 0 ) {}
+	PackedFormat( const GLenum type_, const int components_, const bool normalized_, const int size_ ) :
+		type( type_ ), components( components_ ), normalized( normalized_ ), size( size_ ), offset( 0 ) {}
+
+	GLenum	type;			// 0 if the attribute is not present
+	int		components;
+	bool	normalized;
+	int		size;			// bytes per vertex, always a multiple of 4
+	int		offset;			// within the interleaved vertex
+};
+
+struct PackedVertexFormat
+{
+	PackedFormat	position;
+	PackedFormat	normal;
+	PackedFormat	tangent;
+	PackedFormat	binormal;
+	PackedFormat	color;
+	PackedFormat	uv0;
+	PackedFormat	uv1;
+	PackedFormat	jointIndices;
+	PackedFormat	jointWeights;
+	int				stride;
+};
+
+// GL_HALF_FLOAT and GL_INT_2_10_10_10_REV vertex attributes are core in ES 3,
+// while normalized bytes and shorts work everywhere.
+static bool PackedFormatsES3()
+{
+	const char * version = (const char *)glGetString( GL_VERSION );
+	return version != NULL && strstr( version, "OpenGL ES 3" ) != NULL;
+}
+
+static uint16_t FloatToHalf( const float value )
+{
+	union { float f; uint32_t u; } bits;
+	bits.f = value;
+
+	const uint32_t sign = ( bits.u >> 16 ) & 0x8000;
+	const int exponent = (int)( ( bits.u >> 23 ) & 0xFF ) - 127 + 15;
+	uint32_t mantissa = bits.u & 0x007FFFFF;
+
+	if ( exponent <= 0 )
+	{
+		// denormal or zero
+		if ( exponent < -10 )
+		{
+			return (uint16_t)sign;
+		}
+		mantissa |= 0x00800000;
+		const int shift = 14 - exponent;
+		return (uint16_t)( sign | ( ( mantissa + ( 1 << ( shift - 1 ) ) ) >> shift ) );
+	}
+	if ( exponent >= 31 )
+	{
+		// overflow to infinity, callers check the range first
+		return (uint16_t)( sign | 0x7C00 );
+	}
+	// round to nearest, a mantissa carry correctly bumps the exponent
+	return (uint16_t)( sign + ( ( ( exponent << 10 ) | ( mantissa >> 13 ) ) + ( ( mantissa >> 12 ) & 1 ) ) );
+}
+
+static float HalfToFloat( const uint16_t half )
+{
+	const int exponent = ( half >> 10 ) & 0x1F;
+	const int mantissa = half & 0x3FF;
+	const float sign = ( half & 0x8000 ) ? -1.0f : 1.0f;
+	if ( exponent == 0 )
+	{
+		return sign * ldexpf( (float)mantissa, -24 );
+	}
+	return sign * ldexpf( (float)( mantissa | 0x400 ), exponent - 25 );
+}
+
+static bool InRange( const float * values, const int count, const float minValue, const float maxValue )
+{
+	for ( int i = 0; i < count; i++ )
+	{
+		if ( !( values[i] >= minValue && values[i] <= maxValue ) )	// also rejects NaN
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static PackedFormat ChooseDirectionFormat( const Array< Vector3f > & values, const bool es3 )
+{
+	if ( values.GetSizeI() == 0 )
+	{
+		return PackedFormat();
+	}
+	if ( es3 && InRange( &values[0].x, values.GetSizeI() * 3, -1.0f, 1.0f ) )
+	{
+		return PackedFormat( GL_INT_2_10_10_10_REV, 4, true, 4 );
+	}
+	return PackedFormat( GL_FLOAT, 3, false, 12 );
+}
+
+static PackedFormat ChooseUnitFormat( const Array< Vector4f > & values )
+{
+	if ( values.GetSizeI() == 0 )
+	{
+		return PackedFormat();
+	}
+	if ( InRange( &values[0].x, values.GetSizeI() * 4, 0.0f, 1.0f ) )
+	{
+		return PackedFormat( GL_UNSIGNED_BYTE, 4, true, 4 );
+	}
+	return PackedFormat( GL_FLOAT, 4, false, 16 );
+}
+
+static PackedFormat ChooseUvFormat( const Array< Vector2f > & values, const bool es3 )
+{
+	if ( values.GetSizeI() == 0 )
+	{
+		return PackedFormat();
+	}
+	const float * v = &values[0].x;
+	const int count = values.GetSizeI() * 2;
+	if ( InRange( v, count, 0.0f, 1.0f ) )
+	{
+		return PackedFormat( GL_UNSIGNED_SHORT, 2, true, 4 );
+	}
+	if ( es3 && InRange( v, count, -65504.0f, 65504.0f ) )
+	{
+		bool precise = true;
+		for ( int i = 0; i < count && precise; i++ )
+		{
+			precise = fabsf( HalfToFloat( FloatToHalf( v[i] ) ) - v[i] ) <= HALF_FLOAT_UV_TOLERANCE;
+		}
+		if ( precise )
+		{
+			return PackedFormat( GL_HALF_FLOAT, 2, false, 4 );
+		}
+	}
+	return PackedFormat( GL_FLOAT, 2, false, 8 );
+}
+
+static PackedFormat ChooseJointIndexFormat( const Array< Vector4i > & values )
+{
+	if ( values.GetSizeI() == 0 )
+	{
+		return PackedFormat();
+	}
+	int minIndex = 0;
+	int maxIndex = 0;
+	for ( int i = 0; i < values.GetSizeI(); i++ )
+	{
+		for ( int j = 0; j < 4; j++ )
+		{
+			minIndex = Alg::Min( minIndex, values[i][j] );
+			maxIndex = Alg::Max( maxIndex, values[i][j] );
+		}
+	}
+	if ( minIndex >= 0 && maxIndex <= 255 )
+	{
+		return PackedFormat( GL_UNSIGNED_BYTE, 4, false, 4 );
+	}
+	if ( minIndex >= 0 && maxIndex <= 65535 )
+	{
+		return PackedFormat( GL_UNSIGNED_SHORT, 4, false, 8 );
+	}
+	return PackedFormat( GL_INT, 4, false, 16 );
+}
+
+static void ChoosePackedFormats( const VertexAttribs & attribs, PackedVertexFormat & format )
+{
+	const bool es3 = PackedFormatsES3();
+
+	format.position = ( attribs.position.GetSizeI() > 0 ) ? PackedFormat( GL_FLOAT, 3, false, 12 ) : PackedFormat();
+	format.normal = ChooseDirectionFormat( attribs.normal, es3 );
+	format.tangent = ChooseDirectionFormat( attribs.tangent, es3 );
+	format.binormal = ChooseDirectionFormat( attribs.binormal, es3 );
+	format.color = ChooseUnitFormat( attribs.color );
+	format.uv0 = ChooseUvFormat( attribs.uv0, es3 );
+	format.uv1 = ChooseUvFormat( attribs.uv1, es3 );
+	format.jointIndices = ChooseJointIndexFormat( attribs.jointIndices );
+	format.jointWeights = ChooseUnitFormat( attribs.jointWeights );
+
+	PackedFormat * formats[] = { &format.position, &format.normal, &format.tangent, &format.binormal,
+			&format.color, &format.uv0, &format.uv1, &format.jointIndices, &format.jointWeights };
+	format.stride = 0;
+	for ( int i = 0; i < (int)( sizeof( formats ) / sizeof( formats[0] ) ); i++ )
+	{
+		formats[i]->offset = format.stride;
+		format.stride += formats[i]->size;
+	}
+}
+
+// Writes count vertices of a float attribute in the chosen format.
+static void WritePackedFloats( uint8_t * packed, const int stride, const PackedFormat & format,
+		const float * src, const int srcComponents, const int count )
+{
+	uint8_t * dst = packed + format.offset;
+	for ( int i = 0; i < count; i++, dst += stride, src += srcComponents )
+	{
+		switch ( format.type )
+		{
+			case GL_FLOAT:
+			{
+				memcpy( dst, src, srcComponents * sizeof( float ) );
+				break;
+			}
+			case GL_INT_2_10_10_10_REV:
+			{
+				uint32_t bits = 0;
+				for ( int j = 0; j < 3; j++ )
+				{
+					const int32_t c = (int32_t)floorf( src[j] * 511.0f + 0.5f );
+					bits |= ( (uint32_t)c & 0x3FF ) << ( j * 10 );
+				}
+				memcpy( dst, &bits, sizeof( bits ) );
+				break;
+			}
+			case GL_UNSIGNED_BYTE:
+			{
+				for ( int j = 0; j < srcComponents; j++ )
+				{
+					dst[j] = (uint8_t)( src[j] * 255.0f + 0.5f );
+				}
+				break;
+			}
+			case GL_UNSIGNED_SHORT:
+			{
+				uint16_t * dst16 = (uint16_t *)dst;
+				for ( int j = 0; j < srcComponents; j++ )
+				{
+					dst16[j] = (uint16_t)( src[j] * 65535.0f + 0.5f );
+				}
+				break;
+			}
+			case GL_HALF_FLOAT:
+			{
+				uint16_t * dst16 = (uint16_t *)dst;
+				for ( int j = 0; j < srcComponents; j++ )
+				{
+					dst16[j] = FloatToHalf( src[j] );
+				}
+				break;
+			}
+		}
+	}
+}
+
+static void WritePackedJointIndices( uint8_t * packed, const int stride, const PackedFormat & format,
+		const Array< Vector4i > & indices )
+{
+	uint8_t * dst = packed + format.offset;
+	for ( int i = 0; i < indices.GetSizeI(); i++, dst += stride )
+	{
+		for ( int j = 0; j < 4; j++ )
+		{
+			switch ( format.type )
+			{
+				case GL_UNSIGNED_BYTE:	dst[j] = (uint8_t)indices[i][j]; break;
+				case GL_UNSIGNED_SHORT:	((uint16_t *)dst)[j] = (uint16_t)indices[i][j]; break;
+				default:				((int32_t *)dst)[j] = indices[i][j]; break;
+			}
+		}
+	}
+}
+
+static void SetPackedAttributePointer( const int glLocation, const PackedFormat & format, const int stride )
+{
+	if ( format.type != 0 )
+	{
+		glEnableVertexAttribArray( glLocation );
+		glVertexAttribPointer( glLocation, format.components, format.type, format.normalized, stride, (void *)(size_t)( format.offset ) );
+	}
+	else
+	{
+		glDisableVertexAttribArray( glLocation );
+	}
+}
+
+// Fills in the vertex buffer contents and points the attributes of the bound
+// VAO at them.
+static void PackVertexAttribs( const VertexAttribs & attribs, const VertexLayout layout, Array< uint8_t > & packed )
+{
+	if ( layout == VERTEX_LAYOUT_FLOAT_ARRAYS )
+	{
+		PackVertexAttribute( packed, attribs.position,		VERTEX_ATTRIBUTE_LOCATION_POSITION,			GL_FLOAT,	3 );
+		PackVertexAttribute( packed, attribs.normal,		VERTEX_ATTRIBUTE_LOCATION_NORMAL,			GL_FLOAT,	3 );
+		PackVertexAttribute( packed, attribs.tangent,		VERTEX_ATTRIBUTE_LOCATION_TANGENT,			GL_FLOAT,	3 );
+		PackVertexAttribute( packed, attribs.binormal,		VERTEX_ATTRIBUTE_LOCATION_BINORMAL,			GL_FLOAT,	3 );
+		PackVertexAttribute( packed, attribs.color,			VERTEX_ATTRIBUTE_LOCATION_COLOR,			GL_FLOAT,	4 );
+		PackVertexAttribute( packed, attribs.uv0,			VERTEX_ATTRIBUTE_LOCATION_UV0,				GL_FLOAT,	2 );
+		PackVertexAttribute( packed, attribs.uv1,			VERTEX_ATTRIBUTE_LOCATION_UV1,				GL_FLOAT,	2 );
+		PackVertexAttribute( packed, attribs.jointIndices,	VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES,	GL_INT,		4 );
+		PackVertexAttribute( packed, attribs.jointWeights,	VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS,	GL_FLOAT,	4 );
+		return;
+	}
+
+	PackedVertexFormat format;
+	ChoosePackedFormats( attribs, format );
+
+	// Every attribute array is either empty or has one element per position.
+	const int count = attribs.position.GetSizeI();
+	packed.Resize( count * format.stride );
+	if ( count == 0 )
+	{
+		return;
+	}
+	uint8_t * dst = &packed[0];
+	const int stride = format.stride;
+
+	WritePackedFloats( dst, stride, format.position, &attribs.position[0].x, 3, count );
+	if ( format.normal.type != 0 )			{ WritePackedFloats( dst, stride, format.normal, &attribs.normal[0].x, 3, count ); }
+	if ( format.tangent.type != 0 )			{ WritePackedFloats( dst, stride, format.tangent, &attribs.tangent[0].x, 3, count ); }
+	if ( format.binormal.type != 0 )		{ WritePackedFloats( dst, stride, format.binormal, &attribs.binormal[0].x, 3, count ); }
+	if ( format.color.type != 0 )			{ WritePackedFloats( dst, stride, format.color, &attribs.color[0].x, 4, count ); }
+	if ( format.uv0.type != 0 )				{ WritePackedFloats( dst, stride, format.uv0, &attribs.uv0[0].x, 2, count ); }
+	if ( format.uv1.type != 0 )				{ WritePackedFloats( dst, stride, format.uv1, &attribs.uv1[0].x, 2, count ); }
+	if ( format.jointIndices.type != 0 )	{ WritePackedJointIndices( dst, stride, format.jointIndices, attribs.jointIndices ); }
+	if ( format.jointWeights.type != 0 )	{ WritePackedFloats( dst, stride, format.jointWeights, &attribs.jointWeights[0].x, 4, count ); }
+
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_POSITION,		format.position,		stride );
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_NORMAL,		format.normal,			stride );
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_TANGENT,		format.tangent,			stride );
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_BINORMAL,		format.binormal,		stride );
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_COLOR,			format.color,			stride );
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_UV0,			format.uv0,				stride );
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_UV1,			format.uv1,				stride );
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES,	format.jointIndices,	stride );
+	SetPackedAttributePointer( VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS,	format.jointWeights,	stride );
+}
+
+int GetVertexBufferSize( const VertexAttribs & attribs, const VertexLayout layout )
+{
+	if ( layout == VERTEX_LAYOUT_FLOAT_ARRAYS )
+	{
+		return attribs.position.GetSizeI() * sizeof( Vector3f ) +
+				attribs.normal.GetSizeI() * sizeof( Vector3f ) +
+				attribs.tangent.GetSizeI() * sizeof( Vector3f ) +
+				attribs.binormal.GetSizeI() * sizeof( Vector3f ) +
+				attribs.color.GetSizeI() * sizeof( Vector4f ) +
+				attribs.uv0.GetSizeI() * sizeof( Vector2f ) +
+				attribs.uv1.GetSizeI() * sizeof( Vector2f ) +
+				attribs.jointIndices.GetSizeI() * sizeof( Vector4i ) +
+				attribs.jointWeights.GetSizeI() * sizeof( Vector4f );
+	}
+	PackedVertexFormat format;
+	ChoosePackedFormats( attribs, format );
+	return attribs.position.GetSizeI() * format.stride;
+}
+
+void GlGeometry::Create( const VertexAttribs & attribs, const Array< TriangleIndex > & indices,
+		const VertexLayout layout_ )
 {
 	vertexCount = attribs.position.GetSizeI();
 	indexCount = indices.GetSizeI();
+	layout = layout_;
 
 	glGenBuffers( 1, &vertexBuffer );
 	glGenBuffers( 1, &indexBuffer );
@@ -66,15 +425,8 @@ void GlGeometry::Create( const VertexAttribs & attribs, const Array< TriangleInd
 	glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
 
 	Array< uint8_t > packed;
-	PackVertexAttribute( packed, attribs.position,		VERTEX_ATTRIBUTE_LOCATION_POSITION,			GL_FLOAT,	3 );
-	PackVertexAttribute( packed, attribs.normal,		VERTEX_ATTRIBUTE_LOCATION_NORMAL,			GL_FLOAT,	3 );
-	PackVertexAttribute( packed, attribs.tangent,		VERTEX_ATTRIBUTE_LOCATION_TANGENT,			GL_FLOAT,	3 );
-	PackVertexAttribute( packed, attribs.binormal,		VERTEX_ATTRIBUTE_LOCATION_BINORMAL,			GL_FLOAT,	3 );
-	PackVertexAttribute( packed, attribs.color,			VERTEX_ATTRIBUTE_LOCATION_COLOR,			GL_FLOAT,	4 );
-	PackVertexAttribute( packed, attribs.uv0,			VERTEX_ATTRIBUTE_LOCATION_UV0,				GL_FLOAT,	2 );
-	PackVertexAttribute( packed, attribs.uv1,			VERTEX_ATTRIBUTE_LOCATION_UV1,				GL_FLOAT,	2 );
-	PackVertexAttribute( packed, attribs.jointIndices,	VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES,	GL_INT,		4 );
-	PackVertexAttribute( packed, attribs.jointWeights,	VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS,	GL_FLOAT,	4 );
+	PackVertexAttribs( attribs, layout, packed );
+	vertexBytes = packed.GetSizeI();
 
 	glBufferData( GL_ARRAY_BUFFER, packed.GetSize() * sizeof( packed[0] ), packed.GetDataPtr(), GL_STATIC_DRAW );
 
@@ -103,15 +455,8 @@ void GlGeometry::Update( const VertexAttribs & attribs )
 	glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
 
 	Array< uint8_t > packed;
-	PackVertexAttribute( packed, attribs.position,		VERTEX_ATTRIBUTE_LOCATION_POSITION,			GL_FLOAT,	3 );
-	PackVertexAttribute( packed, attribs.normal,		VERTEX_ATTRIBUTE_LOCATION_NORMAL,			GL_FLOAT,	3 );
-	PackVertexAttribute( packed, attribs.tangent,		VERTEX_ATTRIBUTE_LOCATION_TANGENT,			GL_FLOAT,	3 );
-	PackVertexAttribute( packed, attribs.binormal,		VERTEX_ATTRIBUTE_LOCATION_BINORMAL,			GL_FLOAT,	3 );
-	PackVertexAttribute( packed, attribs.color,			VERTEX_ATTRIBUTE_LOCATION_COLOR,			GL_FLOAT,	4 );
-	PackVertexAttribute( packed, attribs.uv0,			VERTEX_ATTRIBUTE_LOCATION_UV0,				GL_FLOAT,	2 );
-	PackVertexAttribute( packed, attribs.uv1,			VERTEX_ATTRIBUTE_LOCATION_UV1,				GL_FLOAT,	2 );
-	PackVertexAttribute( packed, attribs.jointIndices,	VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES,	GL_INT,		4 );
-	PackVertexAttribute( packed, attribs.jointWeights,	VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS,	GL_FLOAT,	4 );
+	PackVertexAttribs( attribs, layout, packed );
+	vertexBytes = packed.GetSizeI();
 
 	glBufferData( GL_ARRAY_BUFFER, packed.GetSize() * sizeof( packed[0] ), packed.GetDataPtr(), GL_STATIC_DRAW );
 }
@@ -133,6 +478,7 @@ void GlGeometry::Free()
 	vertexArrayObject = 0;
 	vertexCount = 0;
 	indexCount = 0;
+	vertexBytes = 0;
 }
 
 GlGeometry BuildTesselatedQuad( const int horizontal, const int vertical )
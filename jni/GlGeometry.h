@@ -36,6 +36,24 @@ typedef unsigned short TriangleIndex;
 static const int MAX_GEOMETRY_VERTICES	= 1 << ( sizeof( TriangleIndex ) * 8 );
 static const int MAX_GEOMETRY_INDICES	= 1024 * 1024 * 3;
 
+enum VertexLayout
+{
+	// Each attribute is a separate array of full floats, exactly as in VertexAttribs.
+	VERTEX_LAYOUT_FLOAT_ARRAYS,
+
+	// All attributes of a vertex are interleaved, and each attribute is stored
+	// in the smallest format that holds its values without visible loss:
+	//	normal, tangent, binormal	signed normalized 10:10:10:2 (ES 3)
+	//	color						unsigned normalized bytes when in [0,1]
+	//	uv0, uv1					unsigned normalized shorts when in [0,1],
+	//								otherwise half floats when precise enough (ES 3)
+	//	joint indices				unsigned bytes when less than 256
+	//	joint weights				unsigned normalized bytes when in [0,1]
+	// Positions are always floats. The GL expands everything back to floats
+	// before the vertex shader, so no program needs to change.
+	VERTEX_LAYOUT_PACKED
+};
+
 class GlGeometry
 {
 public:
@@ -44,17 +62,25 @@ public:
 				indexBuffer( 0 ),
 				vertexArrayObject( 0 ),
 				vertexCount( 0 ),
-				indexCount( 0 ) {}
+				indexCount( 0 ),
+				layout( VERTEX_LAYOUT_FLOAT_ARRAYS ),
+				vertexBytes( 0 ) {}
 
-			GlGeometry( const VertexAttribs & attribs, const Array< TriangleIndex > & indices ) :
+			GlGeometry( const VertexAttribs & attribs, const Array< TriangleIndex > & indices,
+						const VertexLayout layout_ = VERTEX_LAYOUT_FLOAT_ARRAYS ) :
 				vertexBuffer( 0 ),
 				indexBuffer( 0 ),
 				vertexArrayObject( 0 ),
 				vertexCount( 0 ),
-				indexCount( 0 ) { Create( attribs, indices ); }
+				indexCount( 0 ),
+				layout( VERTEX_LAYOUT_FLOAT_ARRAYS ),
+				vertexBytes( 0 ) { Create( attribs, indices, layout_ ); }
 
 	// Create the VAO and vertex and index buffers from arrays of data.
-	void	Create( const VertexAttribs & attribs, const Array< TriangleIndex > & indices );
+	void	Create( const VertexAttribs & attribs, const Array< TriangleIndex > & indices,
+					const VertexLayout layout_ = VERTEX_LAYOUT_FLOAT_ARRAYS );
+
+	// Replaces the vertices, keeping the layout given to Create.
 	void	Update( const VertexAttribs & attribs );
 
 	// Assumes the correct program, uniforms, textures, etc, are all bound.
@@ -76,8 +102,14 @@ public:
 	unsigned 	vertexArrayObject;
 	int			vertexCount;
 	int 		indexCount;
+	VertexLayout layout;
+	int			vertexBytes;		// size of the vertex buffer
 };
 
+// Size of the vertex buffer the attributes would need in the given layout,
+// for reporting memory use without creating any GL objects.
+int			GetVertexBufferSize( const VertexAttribs & attribs, const VertexLayout layout );
+
 // Build it in a -1 to 1 range, which will be scaled to the appropriate
 // aspect ratio for each usage.
 //
@@ -14,8 +14,12 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
+#include "Kernel/OVR_Atomic.h"
 #include "Log.h"
+#include "VrApi/VrApi.h"	// ovr_GetTimeInSeconds
 
 using namespace OVR;
 
@@ -329,11 +333,311 @@ bool CompileShader( const GLuint shader, const char * src )
 	return true;
 }
 
+static const struct
+{
+	int				location;
+	const char *	name;
+} ProgramAttributes[] =
+{
+	{ VERTEX_ATTRIBUTE_LOCATION_POSITION,		"Position" },
+	{ VERTEX_ATTRIBUTE_LOCATION_NORMAL,			"Normal" },
+	{ VERTEX_ATTRIBUTE_LOCATION_TANGENT,		"Tangent" },
+	{ VERTEX_ATTRIBUTE_LOCATION_BINORMAL,		"Binormal" },
+	{ VERTEX_ATTRIBUTE_LOCATION_COLOR,			"VertexColor" },
+	{ VERTEX_ATTRIBUTE_LOCATION_UV0,			"TexCoord" },
+	{ VERTEX_ATTRIBUTE_LOCATION_UV1,			"TexCoord1" },
+	{ VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS,	"JointWeights" },
+	{ VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES,	"JointIndices" },
+	{ VERTEX_ATTRIBUTE_LOCATION_FONT_PARMS,		"FontParms" }
+};
+
+/*
+	Program binary cache
+*/
+
+// Bump this whenever the cache file layout or the key changes.
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x42505650;	// "PVPB"
+
+struct ProgramBinaryHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	key;
+	uint32_t	binaryFormat;
+	uint32_t	binaryLength;
+	uint32_t	binaryChecksum;	// catches files truncated by a crash while writing
+	uint32_t	pad;
+};
+
+// Programs are built on both the application and the time warp threads.
+static Lock					ProgramCacheLock;
+static char					ProgramCacheDirectory[256];
+static ProgramCacheStats	ProgramCacheCounters;
+
+static uint64_t HashBytes( uint64_t hash, const void * data, const size_t length )
+{
+	// 64 bit FNV-1a
+	const unsigned char * bytes = (const unsigned char *)data;
+	for ( size_t i = 0; i < length; i++ )
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static uint64_t HashString( const uint64_t hash, const char * string )
+{
+	// include the terminator, so "ab" + "c" differs from "a" + "bc"
+	return ( string != NULL ) ? HashBytes( hash, string, strlen( string ) + 1 ) : HashBytes( hash, "", 1 );
+}
+
+static uint32_t ChecksumBytes( const void * data, const size_t length )
+{
+	const uint64_t hash = HashBytes( 14695981039346656037ULL, data, length );
+	return (uint32_t)( hash ^ ( hash >> 32 ) );
+}
+
+// Returns false if the cache can't be used with the current context.
+static bool GetProgramCachePath( const char * vertexSrc, const char * fragmentSrc,
+		uint64_t & key, char * path, const int pathSize )
+{
+	char directory[sizeof( ProgramCacheDirectory )];
+	{
+		Lock::Locker locker( &ProgramCacheLock );
+		strcpy( directory, ProgramCacheDirectory );
+	}
+	if ( directory[0] == '\0' )
+	{
+		return false;
+	}
+
+	const char * vendor = (const char *)glGetString( GL_VENDOR );
+	const char * renderer = (const char *)glGetString( GL_RENDERER );
+	const char * version = (const char *)glGetString( GL_VERSION );
+	if ( version == NULL || strstr( version, "OpenGL ES 3" ) == NULL )
+	{
+		return false;
+	}
+	GLint numFormats = 0;
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats );
+	if ( numFormats <= 0 )
+	{
+		return false;
+	}
+
+	uint64_t hash = 14695981039346656037ULL;
+	hash = HashBytes( hash, &PROGRAM_CACHE_VERSION, sizeof( PROGRAM_CACHE_VERSION ) );
+	hash = HashString( hash, vertexSrc );
+	hash = HashString( hash, fragmentSrc );
+	for ( int i = 0; i < (int)( sizeof( ProgramAttributes ) / sizeof( ProgramAttributes[0] ) ); i++ )
+	{
+		hash = HashBytes( hash, &ProgramAttributes[i].location, sizeof( ProgramAttributes[i].location ) );
+		hash = HashString( hash, ProgramAttributes[i].name );
+	}
+	hash = HashString( hash, vendor );
+	hash = HashString( hash, renderer );
+	hash = HashString( hash, version );
+
+	key = hash;
+	snprintf( path, pathSize, "%s/%016llx.bin", directory, (unsigned long long)key );
+	return true;
+}
+
+// Returns 0 if there is no usable binary for the key.
+static GLuint LoadProgramBinary( const char * path, const uint64_t key )
+{
+	FILE * f = fopen( path, "rb" );
+	if ( f == NULL )
+	{
+		return 0;
+	}
+
+	// The length in the header is only trusted if the file is exactly that
+	// much longer than the header, so a corrupt file can't ask for a huge
+	// allocation. Anything that doesn't check out is discarded and recompiled.
+	struct stat st;
+	ProgramBinaryHeader header;
+	void * binary = NULL;
+	bool valid = fstat( fileno( f ), &st ) == 0 &&
+			fread( &header, sizeof( header ), 1, f ) == 1 &&
+			header.magic == PROGRAM_CACHE_MAGIC &&
+			header.version == PROGRAM_CACHE_VERSION &&
+			header.key == key &&
+			header.binaryLength > 0 &&
+			(uint64_t)st.st_size == sizeof( header ) + (uint64_t)header.binaryLength;
+	if ( valid )
+	{
+		binary = malloc( header.binaryLength );
+		valid = binary != NULL &&
+				fread( binary, header.binaryLength, 1, f ) == 1 &&
+				ChecksumBytes( binary, header.binaryLength ) == header.binaryChecksum;
+	}
+	fclose( f );
+
+	GLuint program = 0;
+	if ( valid )
+	{
+		program = glCreateProgram();
+		glProgramBinary( program, header.binaryFormat, binary, header.binaryLength );
+
+		// The driver is allowed to refuse any binary, even one it wrote itself.
+		GLint r = GL_FALSE;
+		glGetProgramiv( program, GL_LINK_STATUS, &r );
+		if ( r == GL_FALSE )
+		{
+			glDeleteProgram( program );
+			program = 0;
+		}
+	}
+	free( binary );
+
+	if ( program == 0 )
+	{
+		LOG( "Discarding program binary %s", path );
+		unlink( path );
+		Lock::Locker locker( &ProgramCacheLock );
+		ProgramCacheCounters.NumRejected++;
+	}
+	return program;
+}
+
+static void StoreProgramBinary( const char * path, const uint64_t key, const GLuint program )
+{
+	GLint length = 0;
+	glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &length );
+	if ( length <= 0 )
+	{
+		return;
+	}
+
+	void * binary = malloc( length );
+	if ( binary == NULL )
+	{
+		return;
+	}
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary( program, length, &written, &format, binary );
+	if ( written <= 0 )
+	{
+		free( binary );
+		return;
+	}
+
+	ProgramBinaryHeader header;
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.binaryFormat = format;
+	header.binaryLength = written;
+	header.binaryChecksum = ChecksumBytes( binary, written );
+	header.pad = 0;
+
+	// Write to a temporary file and rename it, so a reader never sees a partial file.
+	char tempPath[1024];
+	snprintf( tempPath, sizeof( tempPath ), "%s.%i.tmp", path, gettid() );
+	FILE * f = fopen( tempPath, "wb" );
+	if ( f != NULL )
+	{
+		const bool ok = fwrite( &header, sizeof( header ), 1, f ) == 1 &&
+						fwrite( binary, written, 1, f ) == 1;
+		if ( fclose( f ) == 0 && ok && rename( tempPath, path ) == 0 )
+		{
+			Lock::Locker locker( &ProgramCacheLock );
+			ProgramCacheCounters.NumStored++;
+		}
+		else
+		{
+			unlink( tempPath );
+		}
+	}
+	free( binary );
+}
+
+void SetProgramCacheDirectory( const char * path )
+{
+	Lock::Locker locker( &ProgramCacheLock );
+	if ( path == NULL || path[0] == '\0' || strlen( path ) >= sizeof( ProgramCacheDirectory ) )
+	{
+		ProgramCacheDirectory[0] = '\0';
+		return;
+	}
+	strcpy( ProgramCacheDirectory, path );
+	mkdir( ProgramCacheDirectory, S_IRWXU );
+	LOG( "Program cache: %s", ProgramCacheDirectory );
+}
+
+ProgramCacheStats GetProgramCacheStats()
+{
+	Lock::Locker locker( &ProgramCacheLock );
+	return ProgramCacheCounters;
+}
+
+void LogProgramCacheStats( const char * when )
+{
+	const ProgramCacheStats stats = GetProgramCacheStats();
+	LOG( "Program cache %s: %i hits in %5.1f ms, %i compiled in %5.1f ms, %i rejected, %i stored",
+			when, stats.NumHits, stats.LoadSeconds * 1000.0,
+			stats.NumMisses, stats.CompileSeconds * 1000.0,
+			stats.NumRejected, stats.NumStored );
+}
+
+// Looks up the uniforms and binds the samplers, which a binary load resets.
+static void InitProgramUniforms( GlProgram & prog )
+{
+	prog.uMvp = glGetUniformLocation( prog.program, "Mvpm" );
+	prog.uModel = glGetUniformLocation( prog.program, "Modelm" );
+	prog.uView = glGetUniformLocation( prog.program, "Viewm" );
+	prog.uColor = glGetUniformLocation( prog.program, "UniformColor" );
+	prog.uFadeDirection = glGetUniformLocation( prog.program, "UniformFadeDirection" );
+	prog.uTexm = glGetUniformLocation( prog.program, "Texm" );
+    prog.uTexm2 = glGetUniformLocation( prog.program, "Texm2" );
+    prog.uJoints = glGetUniformLocation( prog.program, "Joints" );
+	prog.uColorTableOffset = glGetUniformLocation( prog.program, "ColorTableOffset" );
+
+	glUseProgram( prog.program );
+
+	// texture and image_external bindings
+	for ( int i = 0; i < 8; i++ )
+	{
+		char name[32];
+		sprintf( name, "Texture%i", i );
+		const GLint uTex = glGetUniformLocation( prog.program, name );
+		if ( uTex != -1 )
+		{
+			glUniform1i( uTex, i );
+		}
+	}
+
+	glUseProgram( 0 );
+}
+
 GlProgram BuildProgram( const char * vertexSrc,
 		const char * fragmentSrc )
 {
+	const double start = ovr_GetTimeInSeconds();
+
 	GlProgram prog;
 
+	uint64_t cacheKey = 0;
+	char cachePath[1024];
+	const bool useCache = GetProgramCachePath( vertexSrc, fragmentSrc, cacheKey, cachePath, sizeof( cachePath ) );
+	if ( useCache )
+	{
+		prog.program = LoadProgramBinary( cachePath, cacheKey );
+		if ( prog.program != 0 )
+		{
+			InitProgramUniforms( prog );
+
+			Lock::Locker locker( &ProgramCacheLock );
+			ProgramCacheCounters.NumHits++;
+			ProgramCacheCounters.LoadSeconds += ovr_GetTimeInSeconds() - start;
+			return prog;
+		}
+	}
+
 	prog.vertexShader = glCreateShader( GL_VERTEX_SHADER );
 	if ( !CompileShader( prog.vertexShader, vertexSrc ) )
 	{
@@ -350,16 +654,15 @@ GlProgram BuildProgram( const char * vertexSrc,
 	glAttachShader( prog.program, prog.fragmentShader );
 
 	// set attributes before linking
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_POSITION,			"Position" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_NORMAL,			"Normal" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_TANGENT,			"Tangent" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_BINORMAL,			"Binormal" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_COLOR,			"VertexColor" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_UV0,				"TexCoord" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_UV1,				"TexCoord1" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS,	"JointWeights" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES,	"JointIndices" );
-	glBindAttribLocation( prog.program, VERTEX_ATTRIBUTE_LOCATION_FONT_PARMS,		"FontParms" );
+	for ( int i = 0; i < (int)( sizeof( ProgramAttributes ) / sizeof( ProgramAttributes[0] ) ); i++ )
+	{
+		glBindAttribLocation( prog.program, ProgramAttributes[i].location, ProgramAttributes[i].name );
+	}
+
+	if ( useCache )
+	{
+		glProgramParameteri( prog.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+	}
 
 	// link and error check
 	glLinkProgram( prog.program );
@@ -371,31 +674,17 @@ GlProgram BuildProgram( const char * vertexSrc,
 		glGetProgramInfoLog( prog.program, sizeof( msg ), 0, msg );
 		FAIL( "Linking program failed: %s\n", msg );
 	}
-	prog.uMvp = glGetUniformLocation( prog.program, "Mvpm" );
-	prog.uModel = glGetUniformLocation( prog.program, "Modelm" );
-	prog.uView = glGetUniformLocation( prog.program, "Viewm" );
-	prog.uColor = glGetUniformLocation( prog.program, "UniformColor" );
-	prog.uFadeDirection = glGetUniformLocation( prog.program, "UniformFadeDirection" );
-	prog.uTexm = glGetUniformLocation( prog.program, "Texm" );
-    prog.uTexm2 = glGetUniformLocation( prog.program, "Texm2" );
-    prog.uJoints = glGetUniformLocation( prog.program, "Joints" );
-	prog.uColorTableOffset = glGetUniformLocation( prog.program, "ColorTableOffset" );
 
-	glUseProgram( prog.program );
+	InitProgramUniforms( prog );
 
-	// texture and image_external bindings
-	for ( int i = 0; i < 8; i++ )
+	if ( useCache )
 	{
-		char name[32];
-		sprintf( name, "Texture%i", i );
-		const GLint uTex = glGetUniformLocation( prog.program, name );
-		if ( uTex != -1 )
-		{
-			glUniform1i( uTex, i );
-		}
+		StoreProgramBinary( cachePath, cacheKey, prog.program );
 	}
 
-	glUseProgram( 0 );
+	Lock::Locker locker( &ProgramCacheLock );
+	ProgramCacheCounters.NumMisses++;
+	ProgramCacheCounters.CompileSeconds += ovr_GetTimeInSeconds() - start;
 
 	return prog;
 }
@@ -419,4 +708,94 @@ void DeleteProgram( GlProgram & prog )
 	prog.fragmentShader = 0;
 }
 
+// Builds and deletes the program, and returns what the build added to the stats.
+static ProgramCacheStats BuildCacheTestProgram( const char * vertexSrc, const char * fragmentSrc )
+{
+	const ProgramCacheStats before = GetProgramCacheStats();
+	GlProgram prog = BuildProgram( vertexSrc, fragmentSrc );
+	DeleteProgram( prog );
+	const ProgramCacheStats after = GetProgramCacheStats();
+
+	ProgramCacheStats added;
+	added.NumHits = after.NumHits - before.NumHits;
+	added.NumMisses = after.NumMisses - before.NumMisses;
+	added.NumRejected = after.NumRejected - before.NumRejected;
+	added.NumStored = after.NumStored - before.NumStored;
+	return added;
+}
+
+static bool CheckCacheTestBuild( const char * step, const ProgramCacheStats & added,
+		const int hits, const int misses, const int rejected, const int stored )
+{
+	if ( added.NumHits != hits || added.NumMisses != misses || added.NumRejected != rejected || added.NumStored != stored )
+	{
+		LOG( "TestProgramCache: %s: %i hits, %i misses, %i rejected, %i stored instead of %i, %i, %i, %i",
+				step, added.NumHits, added.NumMisses, added.NumRejected, added.NumStored,
+				hits, misses, rejected, stored );
+		return false;
+	}
+	return true;
+}
+
+bool TestProgramCache()
+{
+	// A comment that no earlier run has seen, so the first build misses.
+	char fragmentSrc[1024];
+	snprintf( fragmentSrc, sizeof( fragmentSrc ), "// program cache test %f\n%s",
+			ovr_GetTimeInSeconds(), VertexColorFragmentShaderSrc );
+	const char * vertexSrc = VertexColorVertexShaderSrc;
+
+	uint64_t key = 0;
+	char path[1024];
+	if ( !GetProgramCachePath( vertexSrc, fragmentSrc, key, path, sizeof( path ) ) )
+	{
+		LOG( "TestProgramCache: no program cache, skipped" );
+		return true;
+	}
+
+	int numErrors = 0;
+
+	// Compiled and stored, then loaded.
+	numErrors += !CheckCacheTestBuild( "first build", BuildCacheTestProgram( vertexSrc, fragmentSrc ), 0, 1, 0, 1 );
+	numErrors += !CheckCacheTestBuild( "second build", BuildCacheTestProgram( vertexSrc, fragmentSrc ), 1, 0, 0, 0 );
+
+	// A file cut short, as by a crash while writing, is rejected, and the
+	// relinked program stored again.
+	struct stat st;
+	if ( stat( path, &st ) != 0 || truncate( path, st.st_size / 2 ) != 0 )
+	{
+		LOG( "TestProgramCache: failed to truncate %s", path );
+		numErrors++;
+	}
+	numErrors += !CheckCacheTestBuild( "truncated file", BuildCacheTestProgram( vertexSrc, fragmentSrc ), 0, 1, 1, 1 );
+
+	// The same for a flipped byte in the binary, which only the checksum catches.
+	FILE * f = fopen( path, "r+b" );
+	ProgramBinaryHeader header;
+	if ( f != NULL && fread( &header, sizeof( header ), 1, f ) == 1 &&
+			fseek( f, sizeof( header ) + header.binaryLength / 2, SEEK_SET ) == 0 )
+	{
+		const int c = fgetc( f );
+		fseek( f, sizeof( header ) + header.binaryLength / 2, SEEK_SET );
+		fputc( c ^ 0xFF, f );
+	}
+	else
+	{
+		LOG( "TestProgramCache: failed to corrupt %s", path );
+		numErrors++;
+	}
+	if ( f != NULL )
+	{
+		fclose( f );
+	}
+	numErrors += !CheckCacheTestBuild( "corrupt file", BuildCacheTestProgram( vertexSrc, fragmentSrc ), 0, 1, 1, 1 );
+
+	// And the rewritten file is good.
+	numErrors += !CheckCacheTestBuild( "rebuilt file", BuildCacheTestProgram( vertexSrc, fragmentSrc ), 1, 0, 0, 0 );
+
+	unlink( path );
+
+	return numErrors == 0;
+}
+
 }	// namespace OVR
@@ -60,7 +60,8 @@ struct GlProgram
 			uJoints( 0 ),
 			uColorTableOffset( 0 ) {};
 
-	// These will always be > 0 after a build, any errors will abort()
+	// The program will always be > 0 after a build, any errors will abort().
+	// The shaders are 0 when the program was loaded from the program cache.
 	unsigned	program;
 	unsigned	vertexShader;
 	unsigned	fragmentShader;
@@ -106,6 +107,43 @@ GlProgram	BuildProgram( const char * vertexSrc, const char * fragmentSrc );
 
 void		DeleteProgram( GlProgram & prog );
 
+// When a cache directory is set, BuildProgram saves the driver's binary for
+// every program it links, and later builds of the same source on the same
+// driver load that binary instead of compiling. Files are keyed by a hash of
+// the shader source, the attribute bindings and the GL vendor, renderer and
+// version strings, so a driver update simply misses and rebuilds. A binary the
+// driver rejects is deleted and the program is compiled from source.
+//
+// Only used on OpenGL ES 3 contexts, which is where glProgramBinary is core.
+// Pass NULL to disable the cache.
+void		SetProgramCacheDirectory( const char * path );
+
+struct ProgramCacheStats
+{
+	ProgramCacheStats() :
+		NumHits( 0 ),
+		NumMisses( 0 ),
+		NumRejected( 0 ),
+		NumStored( 0 ),
+		LoadSeconds( 0.0 ),
+		CompileSeconds( 0.0 ) {}
+
+	int		NumHits;			// programs loaded from a binary
+	int		NumMisses;			// programs compiled from source
+	int		NumRejected;		// binaries the driver refused to load
+	int		NumStored;
+	double	LoadSeconds;		// total time in BuildProgram for hits
+	double	CompileSeconds;		// total time in BuildProgram for misses, including storing the binary
+};
+
+ProgramCacheStats	GetProgramCacheStats();
+void				LogProgramCacheStats( const char * when );
+
+// Builds a program twice through the cache, then damages its cache file and
+// checks the next build rejects it and relinks. Needs a current GL context,
+// and passes without checking anything if the cache can't be used.
+bool				TestProgramCache();
+
 }	// namespace OVR
 
 #endif	// OVR_GlProgram_h
@@ -0,0 +1,302 @@
+/************************************************************************************
+
+Filename    :   GlStreamingBuffer.cpp
+Content     :   Ring of vertex buffer space for geometry that is rebuilt every frame.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "GlStreamingBuffer.h"
+
+#include <string.h>
+
+#include "Kernel/OVR_Types.h"
+#include "Kernel/OVR_Alg.h"
+#include "Log.h"
+#include "VrApi/VrApi.h"	// ovr_GetTimeInSeconds
+
+namespace OVR
+{
+
+// Enough for the debug lines and several full font surfaces in a frame.
+static const int SHARED_REGION_BYTES = 512 * 1024;
+
+static GlStreamingBuffer *	SharedBuffer = NULL;
+static int					SharedRefCount = 0;
+
+GlStreamingBuffer::GlStreamingBuffer( const int regionBytes, const int numRegions ) :
+	Buffer( 0 ),
+	RegionBytes( regionBytes ),
+	MaxRegionBytes( regionBytes * MAX_GROWTH ),
+	NumRegions( numRegions < 2 ? 2 : ( numRegions > MAX_REGIONS ? MAX_REGIONS : numRegions ) ),
+	CurrentRegion( 0 ),
+	RegionOffset( 0 ),
+	FrameBytesWanted( 0 ),
+	UseFences( eglCreateSyncKHR_ != NULL ),
+	UseMapping( false )
+{
+	for ( int i = 0; i < MAX_REGIONS; i++ )
+	{
+		Fences[i] = EGL_NO_SYNC_KHR;
+	}
+
+	// glMapBufferRange may be exported on an ES 2 context, but is only usable on ES 3.
+	const char * version = (const char *)glGetString( GL_VERSION );
+	UseMapping = glMapBufferRange_ != NULL && glUnmapBuffer_ != NULL &&
+			version != NULL && strstr( version, "OpenGL ES 3" ) != NULL;
+
+	glGenBuffers( 1, &Buffer );
+	glBindBuffer( GL_ARRAY_BUFFER, Buffer );
+	glBufferData( GL_ARRAY_BUFFER, RegionBytes * NumRegions, NULL, GL_STREAM_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	LOG( "GlStreamingBuffer: %i x %i bytes, %s, %s", NumRegions, RegionBytes,
+			UseFences ? "fenced" : "orphaned", UseMapping ? "mapped" : "glBufferSubData" );
+}
+
+GlStreamingBuffer::~GlStreamingBuffer()
+{
+	for ( int i = 0; i < MAX_REGIONS; i++ )
+	{
+		GL_DestroySync( Fences[i] );
+		Fences[i] = EGL_NO_SYNC_KHR;
+	}
+	if ( Buffer != 0 )
+	{
+		glDeleteBuffers( 1, &Buffer );
+		Buffer = 0;
+	}
+}
+
+void GlStreamingBuffer::NextRegion()
+{
+	// Everything drawn from the region we are leaving has been issued by now.
+	if ( UseFences && RegionOffset > 0 )
+	{
+		GL_DestroySync( Fences[CurrentRegion] );
+		Fences[CurrentRegion] = GL_AddSync();
+	}
+
+	CurrentRegion = ( CurrentRegion + 1 ) % NumRegions;
+	RegionOffset = 0;
+
+	EGLSyncKHR & fence = Fences[CurrentRegion];
+	if ( fence != EGL_NO_SYNC_KHR )
+	{
+		const EGLDisplay display = eglGetCurrentDisplay();
+
+		// Poll first, so only real stalls are counted.
+		if ( eglClientWaitSyncKHR_( display, fence, 0, 0 ) == EGL_TIMEOUT_EXPIRED_KHR )
+		{
+			const double start = ovr_GetTimeInSeconds();
+			const EGLint wait = eglClientWaitSyncKHR_( display, fence,
+					EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 100000000 );	// 100 milliseconds
+			if ( wait == EGL_TIMEOUT_EXPIRED_KHR )
+			{
+				LOG( "GlStreamingBuffer: EGL_TIMEOUT_EXPIRED_KHR" );
+			}
+			BufferStats.NumFenceWaits++;
+			BufferStats.FenceWaitSeconds += ovr_GetTimeInSeconds() - start;
+		}
+		GL_DestroySync( fence );
+		fence = EGL_NO_SYNC_KHR;
+	}
+	else if ( !UseFences && CurrentRegion == 0 )
+	{
+		// Let the driver hand us new storage while the GPU finishes with the old.
+		glBindBuffer( GL_ARRAY_BUFFER, Buffer );
+		glBufferData( GL_ARRAY_BUFFER, RegionBytes * NumRegions, NULL, GL_STREAM_DRAW );
+		BufferStats.NumOrphans++;
+	}
+}
+
+void GlStreamingBuffer::Grow( const int regionBytes )
+{
+	LOG( "GlStreamingBuffer: growing regions from %i to %i bytes", RegionBytes, regionBytes );
+
+	// New storage, so nothing needs to wait for the GPU to finish with the old.
+	for ( int i = 0; i < MAX_REGIONS; i++ )
+	{
+		GL_DestroySync( Fences[i] );
+		Fences[i] = EGL_NO_SYNC_KHR;
+	}
+
+	RegionBytes = regionBytes;
+	CurrentRegion = 0;
+	RegionOffset = 0;
+
+	glBindBuffer( GL_ARRAY_BUFFER, Buffer );
+	glBufferData( GL_ARRAY_BUFFER, RegionBytes * NumRegions, NULL, GL_STREAM_DRAW );
+	BufferStats.NumGrows++;
+}
+
+void GlStreamingBuffer::BeginFrame()
+{
+	if ( FrameBytesWanted > RegionBytes )
+	{
+		BufferStats.NumOverflows++;
+		if ( RegionBytes < MaxRegionBytes )
+		{
+			int regionBytes = RegionBytes;
+			while ( regionBytes < FrameBytesWanted && regionBytes < MaxRegionBytes )
+			{
+				regionBytes *= 2;
+			}
+			FrameBytesWanted = 0;
+			Grow( Alg::Min( regionBytes, MaxRegionBytes ) );
+			return;
+		}
+	}
+	FrameBytesWanted = 0;
+
+	NextRegion();
+}
+
+int GlStreamingBuffer::Stream( const void * data, const int bytes )
+{
+	if ( bytes <= 0 )
+	{
+		return -1;
+	}
+
+	const int alignedBytes = ( bytes + 15 ) & ~15;
+	FrameBytesWanted += alignedBytes;
+
+	// Moving to another region here could let the GPU overwrite, or the driver
+	// orphan, data that was streamed earlier in the frame but isn't drawn yet.
+	if ( bytes > RegionBytes - RegionOffset )
+	{
+		BufferStats.NumFailed++;
+		return -1;
+	}
+
+	const int offset = CurrentRegion * RegionBytes + RegionOffset;
+	RegionOffset += alignedBytes;
+
+	glBindBuffer( GL_ARRAY_BUFFER, Buffer );
+
+	// The region is known to be idle, so the driver doesn't need to synchronize.
+	void * mapped = NULL;
+	if ( UseMapping )
+	{
+		mapped = glMapBufferRange_( GL_ARRAY_BUFFER, offset, bytes,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+	}
+	if ( mapped != NULL )
+	{
+		memcpy( mapped, data, bytes );
+		glUnmapBuffer_( GL_ARRAY_BUFFER );
+	}
+	else
+	{
+		glBufferSubData( GL_ARRAY_BUFFER, offset, bytes, data );
+	}
+
+	BufferStats.BytesStreamed += bytes;
+	BufferStats.NumAllocations++;
+
+	return offset;
+}
+
+bool GlStreamingBuffer::Test()
+{
+	static const int REGION_BYTES = 1024;
+	static UByte data[REGION_BYTES * MAX_GROWTH * 2];
+	memset( data, 0x55, sizeof( data ) );
+
+	GlStreamingBuffer buffer( REGION_BYTES, 3 );
+	int numErrors = 0;
+
+	// Two allocations fit, the third doesn't, and the first one stays valid.
+	buffer.BeginFrame();
+	const int first = buffer.Stream( data, 600 );
+	const int second = buffer.Stream( data, 400 );
+	const int third = buffer.Stream( data, 600 );
+	if ( first < 0 || second < first + 600 || second + 400 > first + REGION_BYTES || third != -1 )
+	{
+		LOG( "GlStreamingBuffer::Test: offsets %i %i %i in a %i byte region", first, second, third, REGION_BYTES );
+		numErrors++;
+	}
+	if ( buffer.GetStats().NumFailed != 1 || buffer.GetStats().NumOrphans != 0 )
+	{
+		LOG( "GlStreamingBuffer::Test: %i failed and %i orphans mid-frame instead of 1 and 0",
+				buffer.GetStats().NumFailed, buffer.GetStats().NumOrphans );
+		numErrors++;
+	}
+
+	// The next frame grows the regions to fit all three.
+	buffer.BeginFrame();
+	if ( buffer.GetRegionBytes() < 600 + 400 + 600 || buffer.GetStats().NumGrows != 1 )
+	{
+		LOG( "GlStreamingBuffer::Test: regions of %i bytes after %i grows", buffer.GetRegionBytes(), buffer.GetStats().NumGrows );
+		numErrors++;
+	}
+	for ( int i = 0; i < 3; i++ )
+	{
+		if ( buffer.Stream( data, 600 - i * 100 ) < 0 )
+		{
+			LOG( "GlStreamingBuffer::Test: allocation %i failed after growing", i );
+			numErrors++;
+		}
+	}
+
+	// Growth is capped, and a frame that fits moves on to the next region.
+	buffer.BeginFrame();
+	for ( int i = 0; i < 2 * MAX_GROWTH; i++ )
+	{
+		buffer.Stream( data, sizeof( data ) );
+		buffer.BeginFrame();
+	}
+	if ( buffer.GetRegionBytes() != REGION_BYTES * MAX_GROWTH )
+	{
+		LOG( "GlStreamingBuffer::Test: regions of %i bytes instead of the %i cap", buffer.GetRegionBytes(), REGION_BYTES * MAX_GROWTH );
+		numErrors++;
+	}
+	const int frame0 = buffer.Stream( data, 16 );
+	buffer.BeginFrame();
+	const int frame1 = buffer.Stream( data, 16 );
+	if ( frame1 - frame0 != buffer.GetRegionBytes() && frame0 - frame1 != buffer.GetRegionBytes() * 2 )
+	{
+		LOG( "GlStreamingBuffer::Test: consecutive frames at %i and %i", frame0, frame1 );
+		numErrors++;
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	return numErrors == 0;
+}
+
+void GlStreamingBuffer::LogStats( const char * name ) const
+{
+	LOG( "%s: %lli bytes in %i allocations, %i fence waits (%5.2f ms), %i orphans, %i overflows, %i failed, %i grows to %i bytes",
+			name, BufferStats.BytesStreamed, BufferStats.NumAllocations,
+			BufferStats.NumFenceWaits, BufferStats.FenceWaitSeconds * 1000.0,
+			BufferStats.NumOrphans, BufferStats.NumOverflows, BufferStats.NumFailed,
+			BufferStats.NumGrows, RegionBytes );
+}
+
+GlStreamingBuffer * GlStreamingBuffer::AcquireShared()
+{
+	if ( SharedRefCount++ == 0 )
+	{
+		SharedBuffer = new GlStreamingBuffer( SHARED_REGION_BYTES );
+	}
+	return SharedBuffer;
+}
+
+void GlStreamingBuffer::ReleaseShared()
+{
+	if ( SharedRefCount <= 0 )
+	{
+		return;
+	}
+	if ( --SharedRefCount == 0 )
+	{
+		SharedBuffer->LogStats( "Shared GlStreamingBuffer" );
+		delete SharedBuffer;
+		SharedBuffer = NULL;
+	}
+}
+
+}	// namespace OVR
@@ -0,0 +1,119 @@
+/************************************************************************************
+
+Filename    :   GlStreamingBuffer.h
+Content     :   Ring of vertex buffer space for geometry that is rebuilt every frame.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#ifndef OVR_GlStreamingBuffer_h
+#define OVR_GlStreamingBuffer_h
+
+#include "GlUtils.h"
+
+namespace OVR
+{
+
+// Rewriting the same vertex buffer with glBufferSubData every frame makes the
+// driver either stall until the GPU has finished drawing the previous contents,
+// or silently copy the whole buffer. Instead, the buffer is split into a few
+// regions that are used in turn, one frame at a time, and each region is fenced
+// when the frame moves past it, so it is only written again once the GPU is done
+// with it.
+//
+// Without the KHR_fence_sync extension there is nothing to wait on, so the
+// buffer is orphaned every time the ring wraps around.
+//
+// Data is often streamed well before it is drawn, so the regions only change at
+// frame boundaries, when everything streamed in the previous frame has been
+// drawn. An allocation that doesn't fit in what is left of the frame's region
+// fails, and the regions are grown at the start of the next frame, up to
+// MAX_GROWTH times their initial size.
+class GlStreamingBuffer
+{
+public:
+	static const int MAX_REGIONS = 4;
+	static const int MAX_GROWTH = 4;
+
+	struct Stats
+	{
+		Stats() :
+			BytesStreamed( 0 ),
+			NumAllocations( 0 ),
+			NumFenceWaits( 0 ),
+			FenceWaitSeconds( 0.0 ),
+			NumOrphans( 0 ),
+			NumOverflows( 0 ),
+			NumFailed( 0 ),
+			NumGrows( 0 ) {}
+
+		long long	BytesStreamed;
+		int			NumAllocations;
+		int			NumFenceWaits;		// regions the GPU was still reading when we got back to them
+		double		FenceWaitSeconds;
+		int			NumOrphans;
+		int			NumOverflows;		// frames that wanted more than a region
+		int			NumFailed;			// allocations that didn't fit in the frame's region
+		int			NumGrows;
+	};
+
+	// Must be created and destroyed with the GL context that will use it current.
+				GlStreamingBuffer( const int regionBytes, const int numRegions = 3 );
+				~GlStreamingBuffer();
+
+	// Fences everything drawn from the current region and moves to the next one,
+	// waiting for the GPU if it is still reading it. Call once a frame, before
+	// anything is streamed for the frame, and after everything streamed in the
+	// previous frame has been drawn. Grows the regions if the previous frame
+	// didn't fit.
+	void		BeginFrame();
+
+	// Copies the data into the buffer and returns its byte offset, or -1 if it
+	// doesn't fit in what is left of the frame's region. The buffer is left
+	// bound to GL_ARRAY_BUFFER, so the caller can point its vertex attributes
+	// at the returned offset. Offsets are 16 byte aligned.
+	int			Stream( const void * data, const int bytes );
+
+	// Checks that allocations that don't fit fail without moving to another
+	// region, that earlier offsets stay valid, and that the next frame grows
+	// the regions to fit. Needs a current GL context.
+	static bool	Test();
+
+	GLuint		GetBuffer() const { return Buffer; }
+	int			GetRegionBytes() const { return RegionBytes; }
+	const Stats & GetStats() const { return BufferStats; }
+	void		ResetStats() { BufferStats = Stats(); }
+	void		LogStats( const char * name ) const;
+
+	// One buffer shared by everything that streams geometry on the application's
+	// GL context. The first acquire creates it on the current context, and the
+	// last release frees it.
+	static GlStreamingBuffer *	AcquireShared();
+	static void					ReleaseShared();
+
+private:
+	// not copyable
+				GlStreamingBuffer( const GlStreamingBuffer & );
+	GlStreamingBuffer & operator = ( const GlStreamingBuffer & );
+
+	void		NextRegion();
+	void		Grow( const int regionBytes );
+
+	GLuint		Buffer;
+	int			RegionBytes;
+	int			MaxRegionBytes;
+	int			NumRegions;
+	int			CurrentRegion;
+	int			RegionOffset;			// next free byte in the current region
+	int			FrameBytesWanted;		// including the allocations that failed
+	bool		UseFences;
+	bool		UseMapping;
+	EGLSyncKHR	Fences[MAX_REGIONS];
+	Stats		BufferStats;
+};
+
+}	// namespace OVR
+
+#endif	// OVR_GlStreamingBuffer_h
@@ -14,6 +14,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 
 #include "Kernel/OVR_SysFile.h"
+#include "Kernel/OVR_Trace.h"
 
 #include "OVR.h"
 
@@ -21,6 +22,7 @@ using namespace OVR;
 
 #include "GlUtils.h"
 #include "Log.h"
+#include "Profiler.h"
 
 #include "3rdParty/stb/stb_image.h"
 
@@ -946,6 +948,8 @@ GlTexture LoadTextureKTX( const char * fileName, const unsigned char * buffer, c
 GlTexture LoadTextureFromBuffer( const char * fileName, const MemBuffer & buffer,
 		const TextureFlags_t & flags, int & width, int & height )
 {
+	OVR_PROFILE_TRACE_SCOPE( TRACE_LOAD, "LoadTextureFromBuffer" );
+
 	const String ext = String( fileName ).GetExtension().ToLower();
 
 	// LOG( "Loading texture buffer %s (%s), length %i", fileName, ext.ToCStr(), buffer.Length );
@@ -85,6 +85,13 @@ void GL_TimedFlush( const char * title );
 // Uses a KHR_Sync object if available, so drivers don't "optimze" it away.
 void GL_Flush();
 
+// Returns EGL_NO_SYNC_KHR if the KHR_Sync extension is not available.
+EGLSyncKHR GL_AddSync();
+void GL_DestroySync( EGLSyncKHR sync );
+
+// Waits up to 100 milliseconds, then destroys the sync.
+void GL_WaitSync( EGLSyncKHR sync );
+
 // Dumps information on all the available configs for the display to the log.
 void DumpEglConfigs( const EGLDisplay display );
 
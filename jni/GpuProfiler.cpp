@@ -0,0 +1,237 @@
+/************************************************************************************
+
+Filename    :   GpuProfiler.cpp
+Content     :   Nested GPU timing scopes collected without stalling.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "GpuProfiler.h"
+
+#include <string.h>
+
+#include "Log.h"
+
+namespace OVR
+{
+
+GpuProfiler::GpuProfiler( const char * timelineName ) :
+	TimelineName( timelineName ),
+	Timeline( NULL ),
+	Initialized( false ),
+	Enabled( false ),
+	FlushQueries( false ),
+	Written( 0 ),
+	Collected( 0 ),
+	FrameHead( 0 ),
+	FrameTail( 0 ),
+	Dropping( false ),
+	DroppedScopes( 0 ),
+	DisjointFrames( 0 ),
+	DiscardUntil( 0 )
+{
+	// Query indices wrap with a mask.
+	OVR_COMPILER_ASSERT( ( NUM_QUERIES & ( NUM_QUERIES - 1 ) ) == 0 );
+
+	memset( Queries, 0, sizeof( Queries ) );
+	memset( Names, 0, sizeof( Names ) );
+	memset( FrameEnds, 0, sizeof( FrameEnds ) );
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	if ( Enabled )
+	{
+		LOG( "GpuProfiler %s: destroyed without Free(), leaking queries", TimelineName );
+	}
+}
+
+bool GpuProfiler::Init()
+{
+	Initialized = true;
+#if defined( OVR_ENABLE_PROFILER )
+	if ( !EXT_disjoint_timer_query || glQueryCounterEXT_ == NULL )
+	{
+		LOG( "GpuProfiler %s: no timestamp queries", TimelineName );
+		return false;
+	}
+	Timeline = Profiler::CreateTimeline( TimelineName );
+	if ( Timeline == NULL )
+	{
+		return false;
+	}
+
+	glGenQueriesEXT_( NUM_QUERIES, Queries );
+
+	// Mali needs an availability check after each timestamp, see LogGpuTime.
+	FlushQueries = ( ( EglGetGpuType() & GPU_TYPE_MALI ) != 0 );
+
+	// Reading the flag clears it, so only disjoint operations from now on count.
+	GLint disjoint = 0;
+	glGetIntegerv( GL_GPU_DISJOINT_EXT, &disjoint );
+	return true;
+#else
+	return false;
+#endif
+}
+
+void GpuProfiler::Free()
+{
+	if ( Enabled )
+	{
+		glDeleteQueriesEXT_( NUM_QUERIES, Queries );
+		memset( Queries, 0, sizeof( Queries ) );
+		if ( DroppedScopes > 0 || DisjointFrames > 0 )
+		{
+			LOG( "GpuProfiler %s: %i scopes dropped, %i frames disjoint", TimelineName, DroppedScopes, DisjointFrames );
+		}
+	}
+
+	// Start over if it is used again on a new context.
+	Initialized = false;
+	Enabled = false;
+	Written = 0;
+	Collected = 0;
+	FrameHead = 0;
+	FrameTail = 0;
+	Nesting = ProfileNesting();
+	Dropping = false;
+	DroppedScopes = 0;
+	DisjointFrames = 0;
+	DiscardUntil = 0;
+}
+
+void GpuProfiler::Issue( const char * name )
+{
+	const int index = Written & ( NUM_QUERIES - 1 );
+	glQueryCounterEXT_( Queries[index], GL_TIMESTAMP_EXT );
+	if ( FlushQueries )
+	{
+		GLint available = 0;
+		glGetQueryObjectivEXT_( Queries[index], GL_QUERY_RESULT_AVAILABLE_EXT, &available );
+	}
+	Names[index] = name;
+	Written++;
+}
+
+void GpuProfiler::Begin( const char * name )
+{
+	if ( !Initialized )
+	{
+		Enabled = Init();
+	}
+	if ( !Enabled )
+	{
+		return;
+	}
+
+	if ( !Nesting.Begin() )
+	{
+		return;
+	}
+
+	// Keep room for the ends of all the scopes that are still open,
+	// including this one, so an end is never dropped.
+	if ( Written - Collected + Nesting.GetRecordedOpen() + 2 > (UInt32)NUM_QUERIES )
+	{
+		Nesting.Drop();
+		DroppedScopes++;
+		if ( !Dropping )
+		{
+			LOG( "GpuProfiler %s: GPU results are more than %i frames behind, dropping scopes", TimelineName, MAX_FRAMES_IN_FLIGHT );
+			Dropping = true;
+		}
+		return;
+	}
+
+	Nesting.Record();
+	Dropping = false;
+	Issue( name );
+}
+
+void GpuProfiler::End()
+{
+	if ( !Enabled || !Nesting.End() )
+	{
+		return;
+	}
+	Issue( NULL );
+}
+
+void GpuProfiler::Collect()
+{
+	while ( FrameTail != FrameHead )
+	{
+		const UInt32 frameEnd = FrameEnds[FrameTail % MAX_FRAMES_IN_FLIGHT];
+
+		// The last timestamp of the frame is usually the last to be
+		// available, so check it first.
+		for ( UInt32 q = frameEnd; q != Collected; q-- )
+		{
+			GLint available = 0;
+			glGetQueryObjectivEXT_( Queries[( q - 1 ) & ( NUM_QUERIES - 1 )], GL_QUERY_RESULT_AVAILABLE_EXT, &available );
+			if ( available == 0 )
+			{
+				return;
+			}
+		}
+
+		// A disjoint operation, like a frequency change, makes every
+		// timestamp issued before it was noticed unreliable.
+		GLint disjoint = 0;
+		glGetIntegerv( GL_GPU_DISJOINT_EXT, &disjoint );
+		if ( disjoint )
+		{
+			DiscardUntil = Written;
+		}
+
+		if ( (int)( DiscardUntil - frameEnd ) >= 0 )
+		{
+			DisjointFrames++;
+		}
+		else
+		{
+			for ( UInt32 q = Collected; q != frameEnd; q++ )
+			{
+				const int index = q & ( NUM_QUERIES - 1 );
+				GLuint64 timestamp = 0;
+				glGetQueryObjectui64vEXT_( Queries[index], GL_QUERY_RESULT_EXT, &timestamp );
+				if ( Names[index] != NULL )
+				{
+					Profiler::BeginAt( Timeline, Names[index], timestamp );
+				}
+				else
+				{
+					Profiler::EndAt( Timeline, timestamp );
+				}
+			}
+		}
+
+		Collected = frameEnd;
+		FrameTail++;
+	}
+}
+
+void GpuProfiler::EndFrame()
+{
+	if ( !Enabled )
+	{
+		return;
+	}
+
+	Collect();
+
+	// Frames are only closed between scopes, so each one has whole scopes.
+	// If every frame is still waiting for results, or a scope is open, the
+	// queries so far are collected with the next frame.
+	const UInt32 lastEnd = ( FrameHead != FrameTail ) ? FrameEnds[( FrameHead - 1 ) % MAX_FRAMES_IN_FLIGHT] : Collected;
+	if ( Written != lastEnd && Nesting.GetDepth() == 0 && FrameHead - FrameTail < (UInt32)MAX_FRAMES_IN_FLIGHT )
+	{
+		FrameEnds[FrameHead % MAX_FRAMES_IN_FLIGHT] = Written;
+		FrameHead++;
+	}
+}
+
+}	// namespace OVR
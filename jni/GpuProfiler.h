@@ -0,0 +1,103 @@
+/************************************************************************************
+
+Filename    :   GpuProfiler.h
+Content     :   Nested GPU timing scopes collected without stalling.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+#ifndef OVR_GpuProfiler_h
+#define OVR_GpuProfiler_h
+
+#include "GlUtils.h"
+#include "Profiler.h"
+
+#if defined( OVR_ENABLE_PROFILER )
+#define OVR_GPU_PROFILE_SCOPE( profiler, name ) const OVR::GpuProfileScope OVR_PROFILE_JOIN( gpuProfileScope_, __LINE__ )( profiler, name )
+#else
+#define OVR_GPU_PROFILE_SCOPE( profiler, name )
+#endif
+
+namespace OVR
+{
+
+// Each Begin() and End() writes a GPU timestamp query, so scopes can nest,
+// unlike LogGpuTime, which can only have one time elapsed query active. The
+// queries come from a ring with room for MAX_FRAMES_IN_FLIGHT frames, and
+// EndFrame() only reads the results of frames that report them available, so
+// the CPU never waits on the GPU. If the GPU falls further behind than the
+// ring, new scopes are dropped whole until it catches up.
+//
+// The results are recorded into a Profiler timeline, so they show up in the
+// profiler report and dump with the CPU scopes, and Profiler::GetStats() works
+// on them with the timeline name as the thread name.
+//
+// Queries belong to a GL context, so an instance must only be used with one
+// context, and Free() must be called on it before it is destroyed. Nothing
+// is recorded unless the profiler is compiled in and EXT_disjoint_timer_query
+// is available.
+class GpuProfiler
+{
+public:
+	static const int MAX_FRAMES_IN_FLIGHT = 4;
+	static const int MAX_QUERIES_PER_FRAME = 64;	// two per scope
+	static const int NUM_QUERIES = MAX_FRAMES_IN_FLIGHT * MAX_QUERIES_PER_FRAME;
+
+	explicit		GpuProfiler( const char * timelineName );
+					~GpuProfiler();
+
+	void			Begin( const char * name );
+	void			End();
+
+	// Called once a frame with the context current. Records the results of
+	// any earlier frames that are complete, without waiting for the rest.
+	void			EndFrame();
+
+	// Deletes the queries. Must be called with the context current.
+	void			Free();
+
+private:
+	bool			Init();
+	void			Issue( const char * name );
+	void			Collect();
+
+	const char *	TimelineName;
+	ProfileRing *	Timeline;
+	bool			Initialized;
+	bool			Enabled;
+	bool			FlushQueries;		// Mali needs a query read to flush the timestamp
+
+	// One timestamp query per scope begin or end, in issue order.
+	GLuint			Queries[NUM_QUERIES];
+	const char *	Names[NUM_QUERIES];	// NULL for the end of the innermost scope
+	UInt32			Written;
+	UInt32			Collected;
+
+	// Query counts at the ends of frames waiting for results.
+	UInt32			FrameEnds[MAX_FRAMES_IN_FLIGHT];
+	UInt32			FrameHead;
+	UInt32			FrameTail;
+
+	ProfileNesting	Nesting;
+	bool			Dropping;			// a drop was logged and no scope has been recorded since
+	int				DroppedScopes;
+	int				DisjointFrames;
+	UInt32			DiscardUntil;		// frames ending at or before this query are unreliable
+};
+
+class GpuProfileScope
+{
+public:
+	GpuProfileScope( GpuProfiler & profiler, const char * name ) : Target( profiler ) { Target.Begin( name ); }
+	~GpuProfileScope() { Target.End(); }
+
+private:
+	GpuProfiler &	Target;
+
+	GpuProfileScope & operator = ( const GpuProfileScope & );
+};
+
+}	// namespace OVR
+
+#endif	// OVR_GpuProfiler_h
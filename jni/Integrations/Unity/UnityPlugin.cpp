@@ -51,7 +51,7 @@ public:
 						fbHeight( 1024 ),
 						monoscopic( false ),
 						showVignette( true ),
-						LogEyeSceneGpuTime(),
+						LogEyeSceneGpuTime( "EyeSceneGpuTime" ),
 						countApplicationFrames( 0 ),
 						lastReportTime( 0.0 ),
 						eventData()
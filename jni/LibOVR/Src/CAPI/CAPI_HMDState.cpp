@@ -132,14 +132,34 @@ void HMDState::RecenterYaw()
 	SFusion.RecenterYaw();
 }
 
-// Returns prediction for time.
+bool HMDState::StartSensorRecording(const char* path)
+{
+	if (!pSensor)
+	{
+		LogText("StartSensorRecording: no sensor.\n");
+		return false;
+	}
+	return pSensor->StartRecording(path);
+}
+
+void HMDState::StopSensorRecording()
+{
+	if (pSensor)
+	{
+		pSensor->StopRecording();
+	}
+}
+
+// Returns prediction for time, or the pose from the history for times
+// before the most recent sensor message.
 ovrSensorState HMDState::PredictedSensorState(double absTime, bool allowSensorCreate)
 {
 	SensorState ss;
 
 	if (pSensor || (allowSensorCreate && checkCreateSensor()))
 	{
-		ss = SFusion.GetPredictionForTime(absTime);
+		// An absTime of 0 asks for the most recent reading, not the oldest one.
+		ss = (absTime > 0.0) ? SFusion.GetStateForTime(absTime) : SFusion.GetPredictionForTime(absTime);
 
 		if (allowSensorCreate && !(ss.Status & ovrStatus_OrientationTracked))
 		{
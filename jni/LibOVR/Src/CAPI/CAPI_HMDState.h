@@ -43,6 +43,8 @@ public:
 	void            StopSensor();
 	void            ResetSensor();
 	void			RecenterYaw();
+	bool            StartSensorRecording(const char* path);
+	void            StopSensorRecording();
 	ovrSensorState  PredictedSensorState(double absTime, bool allowSensorCreate);
 
 	bool            ProcessLatencyTest(unsigned char rgbColorOut[3]);
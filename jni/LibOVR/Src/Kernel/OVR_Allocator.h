@@ -213,6 +213,25 @@ public:
         pInstance = palloc;
     }
 
+    // Replaces the installed allocator without a moment where there is none,
+    // for wrapping it with one that counts or tracks allocations. The wrapper
+    // must forward to the previous allocator, which is returned, and be
+    // swapped back out before it is destroyed.
+    static  Allocator* swapInstance(Allocator* palloc)
+    {
+        OVR_ASSERT(pInstance != 0 && palloc != 0);
+        Allocator* previous = pInstance;
+        pInstance = palloc;
+        return previous;
+    }
+
+protected:
+    // A wrapper that is still installed at System::Destroy must pass the
+    // shutdown on to the allocator it wraps.
+    static  void    forwardSystemShutdown(Allocator* wrapped) { wrapped->onSystemShutdown(); }
+
+public:
+
 private:
 
     static Allocator* pInstance;
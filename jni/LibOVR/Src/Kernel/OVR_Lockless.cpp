@@ -2,7 +2,7 @@
 
 PublicHeader:   OVR.h
 Filename    :   OVR_Lockless.cpp
-Content     :   Test logic for lock-less classes
+Content     :   Test and benchmark logic for lock-less classes
 Created     :   December 27, 2013
 Authors     :   Michael Antonov
 
@@ -12,8 +12,6 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 #include "OVR_Lockless.h"
 
-#ifdef OVR_LOCKLESS_TEST
-
 #include "OVR_Threads.h"
 #include "OVR_Timer.h"
 #include "OVR_Log.h"
@@ -22,7 +20,10 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 namespace OVR { namespace LocklessTest {
 
 
-const int TestIterations = 10000000;
+// Set for each run; the test itself is short enough to build everywhere.
+int       TestIterations = 10000000;
+const int NumConsumers   = 3;
+AtomicInt<int> NumFailures;
 
 // Use volatile dummys to force compiler to do spinning.
 volatile int Dummy1;
@@ -61,6 +62,7 @@ struct TestData
                 // Only complain once per same-value entry
                 if (prevValue != val / 100) 
                 {
+                    NumFailures++;
                     LogText("LocklessTest Fail - corruption at %d inside block %d\n",
                             i, val/100);
                     // OVR_ASSERT(Data[i] == val + i);
@@ -75,8 +77,12 @@ struct TestData
 
 
 
-volatile bool              FirstItemWritten = false;
-LocklessUpdater<TestData>  TestDataUpdater;
+// New for each run, so no states are left over from the previous one.
+volatile bool               FirstItemWritten = false;
+LocklessUpdater<TestData>*  TestDataUpdater;
+
+const int                      HistoryDepth = 4;
+LocklessUpdater<TestData, 4>*  TestHistoryUpdater;
 
 // Use this lock to verify that testing algorithm is otherwise correct...
 Lock                       TestLock;   
@@ -100,14 +106,17 @@ class Consumer : public Thread
         }
 
         TestData d;
+        TestData history[HistoryDepth];
         int      oldValue = 0;
         int      newValue;
+        int      numHistoryReads = 0;
+        int      numHistoryStates = 0;
 
         do 
         {
             {
                 //Lock::Locker scope(&TestLock);
-                d = TestDataUpdater.GetState();
+                d = TestDataUpdater->GetState();
             }
             
             newValue = d.ReadAndCheckConsistency(oldValue);
@@ -115,12 +124,33 @@ class Consumer : public Thread
             // Values should increase or stay the same!
             if (newValue < oldValue)
             {
+                NumFailures++;
                 LogText("LocklessTest Fail - %d after %d;  delta = %d\n",
                         newValue, oldValue, newValue - oldValue);
          //       OVR_ASSERT(0);
             }
             
 
+            // The history must be consecutive states, newest first, and
+            // must not be older than the state read before it.
+            const int count = TestHistoryUpdater->GetHistory(history, HistoryDepth);
+            numHistoryReads++;
+            numHistoryStates += count;
+            int prevHistoryValue = 0;
+            for (int i = 0; i < count; i++)
+            {
+                const int historyValue = history[i].ReadAndCheckConsistency(-1);
+                if ((i == 0 && historyValue < newValue) ||
+                    (i > 0 && historyValue != prevHistoryValue - 1))
+                {
+                    NumFailures++;
+                    LogText("LocklessTest Fail - history %d at %d after %d\n",
+                            historyValue, i, i == 0 ? newValue : prevHistoryValue);
+                    break;
+                }
+                prevHistoryValue = historyValue;
+            }
+
             if (oldValue != newValue)
             {
                 oldValue = newValue;
@@ -141,6 +171,8 @@ class Consumer : public Thread
 
         } while (oldValue < (TestIterations * 99 / 100));
 
+        LogText("LocklessTest::Consumer - %.2f states per history read\n",
+                numHistoryReads ? (double)numHistoryStates / numHistoryReads : 0.0);
         LogText("LocklessTest::Consumer::Run exiting.\n");
         return 0;
     }
@@ -164,7 +196,8 @@ class Producer : public Thread
 
             {
                 //Lock::Locker scope(&TestLock);
-                TestDataUpdater.SetState(d);
+                TestHistoryUpdater->SetState(d);
+                TestDataUpdater->SetState(d);
             }
 
             FirstItemWritten = true;
@@ -188,29 +221,198 @@ class Producer : public Thread
 };
 
 
+//-------------------------------------------------------------------------------------
+
+// Starts a producer and the consumers on fresh updaters.
+void StartThreads(int iterations, Ptr<Thread>* threads)
+{
+    TestIterations   = iterations;
+    NumFailures      = 0;
+    FirstItemWritten = false;
+    delete TestDataUpdater;
+    delete TestHistoryUpdater;
+    TestDataUpdater    = new LocklessUpdater<TestData>;
+    TestHistoryUpdater = new LocklessUpdater<TestData, 4>;
+
+    threads[0] = *new Producer;
+    for (int i = 1; i <= NumConsumers; i++)
+    {
+        threads[i] = *new Consumer;
+    }
+    for (int i = 0; i <= NumConsumers; i++)
+    {
+        threads[i]->Start();
+    }
+}
+
 } // namespace LocklessTest
 
 
+bool TestLockless(int iterations)
+{
+    Ptr<Thread> threads[LocklessTest::NumConsumers + 1];
+    LocklessTest::StartThreads(iterations, threads);
+    for (int i = 0; i <= LocklessTest::NumConsumers; i++)
+    {
+        while (!threads[i]->IsFinished())
+        {
+            Thread::MSleep(1);
+        }
+    }
+    return LocklessTest::NumFailures == 0;
+}
 
-void StartLocklessTest()
+
+#ifdef OVR_LOCKLESS_TEST
+
+namespace LocklessTest {
+
+//-------------------------------------------------------------------------------------
+
+// The previous two slot LocklessUpdater, kept to benchmark against.
+template<class T>
+class TwoSlotUpdater
 {
-    // These threads will release themselves once done
-    Ptr<LocklessTest::Producer> producerThread = *new LocklessTest::Producer;
-    Ptr<LocklessTest::Consumer> consumerThread = *new LocklessTest::Consumer;
+public:
+    TwoSlotUpdater() : UpdateBegin( 0 ), UpdateEnd( 0 ) {}
+
+    T GetState() const
+    {
+        T   state;
+        int begin, end, final;
+
+        for(;;)
+        {
+            end   = UpdateEnd.ExchangeAdd_Sync(0);
+            state = Slots[ end & 1 ];
+            begin = UpdateBegin.ExchangeAdd_Sync(0);
+            if ( begin == end ) {
+                return state;
+            }
+
+            state = Slots[ (begin & 1) ^ 1 ];
+            final = UpdateBegin.ExchangeAdd_NoSync(0);
+            if ( final == begin ) {
+                return state;
+            }
+        }
+    }
+
+    void SetState( const T & state )
+    {
+        const int slot = UpdateBegin.ExchangeAdd_Sync(1) & 1;
+        Slots[slot ^ 1] = state;
+        UpdateEnd.ExchangeAdd_Sync(1);
+    }
+
+    mutable AtomicInt<int> UpdateBegin;
+    mutable AtomicInt<int> UpdateEnd;
+    T                      Slots[2];
+};
 
-    producerThread->Start();
-    consumerThread->Start();
+const int BenchmarkIterations = 1000000;
 
-    /*
-    while (!producerThread->IsFinished() && consumerThread->IsFinished())
+// Writes as fast as it can, with a little spin between writes, so the
+// readers keep racing it.
+template<class Updater>
+class BenchmarkWriter : public Thread
+{
+public:
+    BenchmarkWriter(Updater* updater, volatile bool* stop) : TestUpdater(updater), Stop(stop) {}
+
+    virtual int Run()
     {
-        Thread::MSleep(500);
-    } */
+        TestData d;
+        for (int testVal = 0; !*Stop; testVal++)
+        {
+            d.Set(testVal);
+            TestUpdater->SetState(d);
+            for (int j = 0; j < 50; j++)
+            {
+                Dummy2 = j;
+            }
+        }
+        return 0;
+    }
+
+private:
+    Updater*        TestUpdater;
+    volatile bool*  Stop;
+};
+
+template<class Updater>
+void BenchmarkUpdater(const char* name)
+{
+    Updater* updater = new Updater;
+    TestData d;
+    d.Set(0);
+
+    UInt64 start = Timer::GetTicksNanos();
+    for (int i = 0; i < BenchmarkIterations; i++)
+    {
+        updater->SetState(d);
+    }
+    const double writeNanos = (double)(Timer::GetTicksNanos() - start) / BenchmarkIterations;
+
+    start = Timer::GetTicksNanos();
+    for (int i = 0; i < BenchmarkIterations; i++)
+    {
+        Dummy1 = updater->GetState().Data[0];
+    }
+    const double readNanos = (double)(Timer::GetTicksNanos() - start) / BenchmarkIterations;
+
+    // Reads while another thread keeps writing, timed one by one for the worst case.
+    volatile bool stop = false;
+    Ptr< BenchmarkWriter<Updater> > writer = *new BenchmarkWriter<Updater>(updater, &stop);
+    writer->Start();
+
+    UInt64 totalNanos = 0;
+    UInt64 maxNanos   = 0;
+    int    oldValue   = 0;
+    for (int i = 0; i < BenchmarkIterations; i++)
+    {
+        const UInt64 readStart = Timer::GetTicksNanos();
+        const TestData r = updater->GetState();
+        const UInt64 nanos = Timer::GetTicksNanos() - readStart;
+        totalNanos += nanos;
+        maxNanos    = Alg::Max(maxNanos, nanos);
+        oldValue    = r.ReadAndCheckConsistency(oldValue);
+    }
+
+    stop = true;
+    while (!writer->IsFinished())
+    {
+        Thread::MSleep(1);
+    }
+    delete updater;
+
+    LogText("LocklessBenchmark %-16s write %6.1f ns, read %6.1f ns, contended read %6.1f ns avg %8.1f ns max\n",
+            name, writeNanos, readNanos, (double)totalNanos / BenchmarkIterations, (double)maxNanos);
+}
+
+} // namespace LocklessTest
+
+
+
+void StartLocklessTest()
+{
+    // These threads will release themselves once done
+    Ptr<Thread> threads[LocklessTest::NumConsumers + 1];
+    LocklessTest::StartThreads(10000000, threads);
 
     // TBD: Cleanup
 }
 
 
-} // namespace OVR
+// Runs on the calling thread for a few seconds and logs the results.
+void StartLocklessBenchmark()
+{
+    LocklessTest::BenchmarkUpdater< LocklessTest::TwoSlotUpdater<LocklessTest::TestData> >("two slot");
+    LocklessTest::BenchmarkUpdater< LocklessUpdater<LocklessTest::TestData> >("seqlock depth 2");
+    LocklessTest::BenchmarkUpdater< LocklessUpdater<LocklessTest::TestData, 4> >("seqlock depth 4");
+}
 
 #endif // OVR_LOCKLESS_TEST
+
+
+} // namespace OVR
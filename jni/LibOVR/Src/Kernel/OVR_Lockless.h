@@ -14,77 +14,180 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #define OVR_Lockless_h
 
 #include "OVR_Atomic.h"
+#include "OVR_Alg.h"
 
-// Define this to compile-in Lockless test logic
+#if defined(OVR_CC_MSVC)
+#include <intrin.h>		// _ReadWriteBarrier
+#endif
+
+// Define this to compile-in the long Lockless stress test and benchmark
 //#define OVR_LOCKLESS_TEST
 
 namespace OVR {
 
 
+// ***** LocklessBarrier
+
+// Keeps the loads before it ahead of the loads after it, and the stores before
+// it ahead of the stores after it, for both the compiler and the CPU. Unlike
+// the AtomicOps syncs, this also orders plain, non-volatile data. X86 keeps
+// loads in order and stores in order by itself, so it only needs the compiler.
+inline void LocklessBarrier()
+{
+#if defined(OVR_CPU_X86) || defined(OVR_CPU_X86_64)
+#if defined(OVR_CC_MSVC)
+	_ReadWriteBarrier();
+#else
+	asm volatile( "" ::: "memory" );
+#endif
+#elif defined(OVR_CPU_ARM)
+	asm volatile( "dmb" ::: "memory" );
+#else
+	__sync_synchronize();
+#endif
+}
+
+
 // ***** LocklessUpdater
 
 // For single producer cases where you only care about the most recent update, not
 // necessarily getting every one that happens (vsync timing, SensorFusion updates).
 //
-// This is multiple consumer safe, but is currently only used with a single consumer.
+// This is multiple consumer safe.
 //
-// TODO: This is Android specific
-
-template<class T>
+// Update n is written to Slots[n % Depth], between setting the sequence of the
+// slot to an odd number and to 2n, and is published by setting UpdateCount to
+// n. A reader copies the slot of the latest update and checks that its
+// sequence is still 2n, so the producer never waits, and a reader only has to
+// retry if the producer went all the way around the ring during its copy.
+// A deeper ring makes that less likely, and keeps more history for GetHistory().
+//
+// Reads and writes cost a few barriers instead of the full barrier atomic adds
+// of the previous two slot version, see StartLocklessBenchmark().
+template<class T, int Depth = 2>
 class LocklessUpdater
 {
 public:
-	LocklessUpdater() : UpdateBegin( 0 ), UpdateEnd( 0 ) {}
+	LocklessUpdater() : UpdateCount( 0 ), Written( 0 )
+	{
+		OVR_COMPILER_ASSERT( Depth >= 2 );
+		for ( int i = 0; i < Depth; i++ )
+		{
+			Slots[i].Sequence = 0;
+		}
+	}
 
+	// Before the first SetState() this returns a default constructed T.
 	T		GetState() const
 	{
-		// Copy the state out, then retry with the alternate slot
-		// if we determine that our copy may have been partially
-		// stepped on by a new update.
-		T	state;
-		int	begin, end, final;
-
 		for(;;)
 		{
-			// We are adding 0, only using these as atomic memory barriers, so it
-			// is ok to cast off the const, allowing GetState() to remain const.
-            end   = UpdateEnd.ExchangeAdd_Sync(0);
-            state = Slots[ end & 1 ];
-            begin = UpdateBegin.ExchangeAdd_Sync(0);
-			if ( begin == end ) {
+			const UInt32 count = UpdateCount;
+			LocklessBarrier();
+			const Slot & slot = Slots[count % Depth];
+			T state = slot.State;
+			LocklessBarrier();
+			if ( slot.Sequence == count * 2 )
+			{
 				return state;
 			}
+			// The producer went around the ring while we were copying.
+		}
+	}
 
-			// The producer is potentially blocked while only having partially
-			// written the update, so copy out the other slot.
-            state = Slots[ (begin & 1) ^ 1 ];
-            final = UpdateBegin.ExchangeAdd_NoSync(0);
-			if ( final == begin ) {
-				return state;
+	// Copies up to maxStates of the latest states, newest first, and
+	// returns how many were copied. Only states that were set are
+	// returned, and never more than Depth - 1, because the oldest slot
+	// is the next to be written.
+	int		GetHistory( T * states, const int maxStates ) const
+	{
+		for(;;)
+		{
+			const UInt32 count = UpdateCount;
+			LocklessBarrier();
+			const int available = (int)Alg::Min( count, (UInt32)( Depth - 1 ) );
+			const int wanted = Alg::Min( maxStates, available );
+			for ( int i = 0; i < wanted; i++ )
+			{
+				states[i] = Slots[( count - i ) % Depth].State;
 			}
+			LocklessBarrier();
+
+			// States that were overwritten during the copy are older
+			// than the ones that weren't, so keep the newest valid ones.
+			int valid = 0;
+			while ( valid < wanted && Slots[( count - valid ) % Depth].Sequence == ( count - valid ) * 2 )
+			{
+				valid++;
+			}
+			if ( valid > 0 || wanted == 0 )
+			{
+				return valid;
+			}
+		}
+	}
 
-			// The producer completed the last update and started a new one before
-			// we got it copied out, so try fetching the current buffer again.
+	// Copies the state set by SetState() call number update, counting from 1
+	// like GetUpdateCount(), which has to have been at least update before
+	// this was called. Returns false if the state has been overwritten since,
+	// which can only be avoided by reading states at least a few updates
+	// newer than GetUpdateCount() - Depth.
+	bool	GetStateFromUpdate( const UInt32 update, T * state ) const
+	{
+		if ( update == 0 )
+		{
+			return false;
 		}
-		return state;
+		const Slot & slot = Slots[update % Depth];
+		*state = slot.State;
+		LocklessBarrier();
+		return slot.Sequence == update * 2;
+	}
+
+	// The number of SetState() calls so far, so a consumer can tell
+	// if there is a new state since it last looked.
+	UInt32	GetUpdateCount() const
+	{
+		return UpdateCount.Load_Acquire();
 	}
 
-	void	SetState( T state )
+	// Only one thread may call this.
+	void	SetState( const T & state )
 	{
-        const int slot = UpdateBegin.ExchangeAdd_Sync(1) & 1;
-        // Write to (slot ^ 1) because ExchangeAdd returns 'previous' value before add.
-        Slots[slot ^ 1] = state;
-        UpdateEnd.ExchangeAdd_Sync(1);
+		const UInt32 count = Written + 1;
+		Slot & slot = Slots[count % Depth];
+
+		// An odd sequence tells readers the slot is being written.
+		slot.Sequence.Value = count * 2 - 1;
+		LocklessBarrier();
+		slot.State = state;
+		LocklessBarrier();
+		slot.Sequence.Value = count * 2;
+		LocklessBarrier();
+		UpdateCount.Value = count;
+		Written = count;
 	}
 
-    mutable AtomicInt<int> UpdateBegin;
-    mutable AtomicInt<int> UpdateEnd;
-    T		               Slots[2];
+private:
+	struct Slot
+	{
+		AtomicInt<UInt32>	Sequence;
+		T					State;
+	};
+
+	AtomicInt<UInt32>	UpdateCount;
+	UInt32				Written;		// only used by the producer
+	Slot				Slots[Depth];
 };
 
 
+// Runs the stress test for iterations states and waits for it. Returns
+// false if a reader saw a torn state, or states out of order.
+bool TestLockless(int iterations);
+
 #ifdef OVR_LOCKLESS_TEST
 void StartLocklessTest();
+void StartLocklessBenchmark();
 #endif
 
 
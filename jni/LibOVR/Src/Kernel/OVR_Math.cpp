@@ -14,6 +14,12 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 #include <float.h>
 
+#if defined(OVR_CPU_ARM_NEON)
+#include <arm_neon.h>
+#elif defined(OVR_CPU_SSE)
+#include <xmmintrin.h>
+#endif
+
 
 namespace OVR {
 
@@ -83,5 +89,334 @@ const Matrix4<double> Matrix4<double>::IdentityValue = Matrix4<double>(1.0, 0.0,
                                                                        0.0, 0.0, 0.0, 1.0);
 
 
+//-------------------------------------------------------------------------------------
+// ***** Matrix4f
+
+// The products are summed in the same order as the scalar code, and neither NEON
+// VMLA nor SSE fuse the multiply and add, so the results are identical (apart
+// from NEON flushing denormals to zero).
+template<>
+Matrix4<float>& Matrix4<float>::Multiply(Matrix4<float>* d, const Matrix4<float>& a, const Matrix4<float>& b)
+{
+    OVR_ASSERT((d != &a) && (d != &b));
+
+#if defined(OVR_CPU_ARM_NEON)
+    const float32x4_t b0 = vld1q_f32(b.M[0]);
+    const float32x4_t b1 = vld1q_f32(b.M[1]);
+    const float32x4_t b2 = vld1q_f32(b.M[2]);
+    const float32x4_t b3 = vld1q_f32(b.M[3]);
+    for (int i = 0; i < 4; i++)
+    {
+        float32x4_t r = vmulq_n_f32(b0, a.M[i][0]);
+        r = vmlaq_n_f32(r, b1, a.M[i][1]);
+        r = vmlaq_n_f32(r, b2, a.M[i][2]);
+        r = vmlaq_n_f32(r, b3, a.M[i][3]);
+        vst1q_f32(d->M[i], r);
+    }
+#elif defined(OVR_CPU_SSE)
+    const __m128 b0 = _mm_loadu_ps(b.M[0]);
+    const __m128 b1 = _mm_loadu_ps(b.M[1]);
+    const __m128 b2 = _mm_loadu_ps(b.M[2]);
+    const __m128 b3 = _mm_loadu_ps(b.M[3]);
+    for (int i = 0; i < 4; i++)
+    {
+        __m128 r =          _mm_mul_ps(b0, _mm_set1_ps(a.M[i][0]));
+        r = _mm_add_ps(r, _mm_mul_ps(b1, _mm_set1_ps(a.M[i][1])));
+        r = _mm_add_ps(r, _mm_mul_ps(b2, _mm_set1_ps(a.M[i][2])));
+        r = _mm_add_ps(r, _mm_mul_ps(b3, _mm_set1_ps(a.M[i][3])));
+        _mm_storeu_ps(d->M[i], r);
+    }
+#else
+    int i = 0;
+    do {
+        d->M[i][0] = a.M[i][0] * b.M[0][0] + a.M[i][1] * b.M[1][0] + a.M[i][2] * b.M[2][0] + a.M[i][3] * b.M[3][0];
+        d->M[i][1] = a.M[i][0] * b.M[0][1] + a.M[i][1] * b.M[1][1] + a.M[i][2] * b.M[2][1] + a.M[i][3] * b.M[3][1];
+        d->M[i][2] = a.M[i][0] * b.M[0][2] + a.M[i][1] * b.M[1][2] + a.M[i][2] * b.M[2][2] + a.M[i][3] * b.M[3][2];
+        d->M[i][3] = a.M[i][0] * b.M[0][3] + a.M[i][1] * b.M[1][3] + a.M[i][2] * b.M[2][3] + a.M[i][3] * b.M[3][3];
+    } while((++i) < 4);
+#endif
+
+    return *d;
+}
+
+template<>
+Vector4<float> Matrix4<float>::Transform(const Vector4<float>& v) const
+{
+#if defined(OVR_CPU_ARM_NEON)
+    // De-interleaving load, so each register holds a column.
+    const float32x4x4_t c = vld4q_f32(&M[0][0]);
+    float32x4_t r = vmulq_n_f32(c.val[0], v.x);
+    r = vmlaq_n_f32(r, c.val[1], v.y);
+    r = vmlaq_n_f32(r, c.val[2], v.z);
+    r = vmlaq_n_f32(r, c.val[3], v.w);
+    Vector4<float> result;
+    vst1q_f32(&result.x, r);
+    return result;
+#elif defined(OVR_CPU_SSE)
+    __m128 c0 = _mm_loadu_ps(M[0]);
+    __m128 c1 = _mm_loadu_ps(M[1]);
+    __m128 c2 = _mm_loadu_ps(M[2]);
+    __m128 c3 = _mm_loadu_ps(M[3]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    __m128 r =          _mm_mul_ps(c0, _mm_set1_ps(v.x));
+    r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(v.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(v.z)));
+    r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(v.w)));
+    Vector4<float> result;
+    _mm_storeu_ps(&result.x, r);
+    return result;
+#else
+    return Vector4<float>(M[0][0] * v.x + M[0][1] * v.y + M[0][2] * v.z + M[0][3] * v.w,
+                          M[1][0] * v.x + M[1][1] * v.y + M[1][2] * v.z + M[1][3] * v.w,
+                          M[2][0] * v.x + M[2][1] * v.y + M[2][2] * v.z + M[2][3] * v.w,
+                          M[3][0] * v.x + M[3][1] * v.y + M[3][2] * v.z + M[3][3] * v.w);
+#endif
+}
+
+// Expands along pairs of rows, so the twelve 2x2 determinants are shared
+// between all the cofactors instead of each cofactor recomputing its own
+// 3x3 determinant. About half the multiplies of Cofactor() and Adjugated().
+template<>
+Matrix4<float> Matrix4<float>::Inverted() const
+{
+    const float s0 = M[0][0] * M[1][1] - M[1][0] * M[0][1];
+    const float s1 = M[0][0] * M[1][2] - M[1][0] * M[0][2];
+    const float s2 = M[0][0] * M[1][3] - M[1][0] * M[0][3];
+    const float s3 = M[0][1] * M[1][2] - M[1][1] * M[0][2];
+    const float s4 = M[0][1] * M[1][3] - M[1][1] * M[0][3];
+    const float s5 = M[0][2] * M[1][3] - M[1][2] * M[0][3];
+
+    const float c5 = M[2][2] * M[3][3] - M[3][2] * M[2][3];
+    const float c4 = M[2][1] * M[3][3] - M[3][1] * M[2][3];
+    const float c3 = M[2][1] * M[3][2] - M[3][1] * M[2][2];
+    const float c2 = M[2][0] * M[3][3] - M[3][0] * M[2][3];
+    const float c1 = M[2][0] * M[3][2] - M[3][0] * M[2][2];
+    const float c0 = M[2][0] * M[3][1] - M[3][0] * M[2][1];
+
+    const float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    assert(det != 0);
+    const float rcpDet = 1.0f / det;
+
+    return Matrix4<float>(
+        ( M[1][1] * c5 - M[1][2] * c4 + M[1][3] * c3) * rcpDet,
+        (-M[0][1] * c5 + M[0][2] * c4 - M[0][3] * c3) * rcpDet,
+        ( M[3][1] * s5 - M[3][2] * s4 + M[3][3] * s3) * rcpDet,
+        (-M[2][1] * s5 + M[2][2] * s4 - M[2][3] * s3) * rcpDet,
+
+        (-M[1][0] * c5 + M[1][2] * c2 - M[1][3] * c1) * rcpDet,
+        ( M[0][0] * c5 - M[0][2] * c2 + M[0][3] * c1) * rcpDet,
+        (-M[3][0] * s5 + M[3][2] * s2 - M[3][3] * s1) * rcpDet,
+        ( M[2][0] * s5 - M[2][2] * s2 + M[2][3] * s1) * rcpDet,
+
+        ( M[1][0] * c4 - M[1][1] * c2 + M[1][3] * c0) * rcpDet,
+        (-M[0][0] * c4 + M[0][1] * c2 - M[0][3] * c0) * rcpDet,
+        ( M[3][0] * s4 - M[3][1] * s2 + M[3][3] * s0) * rcpDet,
+        (-M[2][0] * s4 + M[2][1] * s2 - M[2][3] * s0) * rcpDet,
+
+        (-M[1][0] * c3 + M[1][1] * c1 - M[1][2] * c0) * rcpDet,
+        ( M[0][0] * c3 - M[0][1] * c1 + M[0][2] * c0) * rcpDet,
+        (-M[3][0] * s3 + M[3][1] * s1 - M[3][2] * s0) * rcpDet,
+        ( M[2][0] * s3 - M[2][1] * s1 + M[2][2] * s0) * rcpDet);
+}
+
+
+} // Namespace OVR
+
+
+#include <string.h>
+#include "OVR_Timer.h"
+
+namespace OVR { namespace MathTest {
+
+// The generic versions, as they were before the float specializations.
+static void ScalarMultiply(Matrix4f* d, const Matrix4f& a, const Matrix4f& b)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            d->M[i][j] = a.M[i][0] * b.M[0][j] + a.M[i][1] * b.M[1][j] + a.M[i][2] * b.M[2][j] + a.M[i][3] * b.M[3][j];
+}
+
+static Vector4f ScalarTransform(const Matrix4f& m, const Vector4f& v)
+{
+    return Vector4f(m.M[0][0] * v.x + m.M[0][1] * v.y + m.M[0][2] * v.z + m.M[0][3] * v.w,
+                    m.M[1][0] * v.x + m.M[1][1] * v.y + m.M[1][2] * v.z + m.M[1][3] * v.w,
+                    m.M[2][0] * v.x + m.M[2][1] * v.y + m.M[2][2] * v.z + m.M[2][3] * v.w,
+                    m.M[3][0] * v.x + m.M[3][1] * v.y + m.M[3][2] * v.z + m.M[3][3] * v.w);
+}
+
+static Matrix4f ScalarInverted(const Matrix4f& m)
+{
+    // Matrix4f::Adjugated() and Determinant() are still the generic code.
+    return m.Adjugated() * (1.0f / m.Determinant());
+}
+
+static UInt32 Seed = 12345;
+static float RandomFloat()
+{
+    Seed = Seed * 1664525 + 1013904223;
+    return (float)(Seed >> 8) / (float)(1 << 24) * 2.0f - 1.0f;
+}
+
+// Random rotation, translation and scale, like the model and view matrices
+// these are used with.
+static Matrix4f RandomTransform()
+{
+    Matrix4f m = Matrix4f::RotationY(RandomFloat() * 3.0f) * Matrix4f::RotationX(RandomFloat() * 3.0f) *
+                 Matrix4f::Scaling(1.5f + RandomFloat());
+    m.SetTranslation(Vector3f(RandomFloat() * 10.0f, RandomFloat() * 10.0f, RandomFloat() * 10.0f));
+    return m;
+}
+
+static double Elapsed(UInt64 start, int count)
+{
+    return (double)(Timer::GetTicksNanos() - start) / count;
+}
+
+static const int Count = 1024;
+
+static void RandomInputs(Matrix4f* a, Matrix4f* b, Vector4f* v)
+{
+    Seed = 12345;
+    for (int i = 0; i < Count; i++)
+    {
+        a[i] = RandomTransform();
+        b[i] = RandomTransform();
+        v[i] = Vector4f(RandomFloat(), RandomFloat(), RandomFloat(), 1.0f);
+    }
+}
+
+}   // namespace MathTest
+
+bool TestMatrix4f()
+{
+    using namespace MathTest;
+
+    // The scalar inverse is off by about 1e-6 on these, so this only catches
+    // real mistakes.
+    const float MaxInverseError = 1e-4f;
+
+    Matrix4f* a = new Matrix4f[Count];
+    Matrix4f* b = new Matrix4f[Count];
+    Matrix4f* d = new Matrix4f[Count];
+    Vector4f* v = new Vector4f[Count];
+    RandomInputs(a, b, v);
+
+    int multiplyMismatches = 0;
+    int transformMismatches = 0;
+    float maxInverseError = 0.0f;
+    float maxScalarInverseError = 0.0f;
+    for (int i = 0; i < Count; i++)
+    {
+        Matrix4f expected;
+        ScalarMultiply(&expected, a[i], b[i]);
+        Matrix4f::Multiply(&d[i], a[i], b[i]);
+        multiplyMismatches += memcmp(&expected, &d[i], sizeof(Matrix4f)) != 0;
+
+        const Vector4f expectedV = ScalarTransform(a[i], v[i]);
+        const Vector4f resultV = a[i].Transform(v[i]);
+        transformMismatches += memcmp(&expectedV, &resultV, sizeof(Vector4f)) != 0;
+
+        // How far m * m^-1 is from identity.
+        const Matrix4f inv = a[i].Inverted();
+        const Matrix4f scalarInv = ScalarInverted(a[i]);
+        Matrix4f identity;
+        Matrix4f fast;
+        Matrix4f scalar;
+        ScalarMultiply(&fast, a[i], inv);
+        ScalarMultiply(&scalar, a[i], scalarInv);
+        for (int r = 0; r < 4; r++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                maxInverseError       = Alg::Max(maxInverseError, fabsf(fast.M[r][c] - identity.M[r][c]));
+                maxScalarInverseError = Alg::Max(maxScalarInverseError, fabsf(scalar.M[r][c] - identity.M[r][c]));
+            }
+        }
+    }
+
+    LogText("TestMatrix4f - %s, %d multiply mismatches, %d transform mismatches, inverse error %g (scalar %g)\n",
+#if defined(OVR_CPU_ARM_NEON)
+            "NEON",
+#elif defined(OVR_CPU_SSE)
+            "SSE",
+#else
+            "scalar",
+#endif
+            multiplyMismatches, transformMismatches, maxInverseError, maxScalarInverseError);
+
+    delete [] a;
+    delete [] b;
+    delete [] d;
+    delete [] v;
+
+    return multiplyMismatches == 0 && transformMismatches == 0 && maxInverseError <= MaxInverseError;
+}
+
+void BenchmarkMatrix4f()
+{
+    using namespace MathTest;
+
+    const int Iterations = 100;
+
+    Matrix4f* a = new Matrix4f[Count];
+    Matrix4f* b = new Matrix4f[Count];
+    Matrix4f* d = new Matrix4f[Count];
+    Vector4f* v = new Vector4f[Count];
+    RandomInputs(a, b, v);
+
+    UInt64 start = Timer::GetTicksNanos();
+    for (int iter = 0; iter < Iterations; iter++)
+        for (int i = 0; i < Count; i++)
+            ScalarMultiply(&d[i], a[i], b[(i + iter) & (Count - 1)]);
+    const double scalarMultiply = Elapsed(start, Count * Iterations);
+
+    start = Timer::GetTicksNanos();
+    for (int iter = 0; iter < Iterations; iter++)
+        for (int i = 0; i < Count; i++)
+            Matrix4f::Multiply(&d[i], a[i], b[(i + iter) & (Count - 1)]);
+    const double multiply = Elapsed(start, Count * Iterations);
+
+    start = Timer::GetTicksNanos();
+    for (int iter = 0; iter < Iterations; iter++)
+        Matrix4f::MultiplyArray(d, a[iter], b, Count);
+    const double multiplyArray = Elapsed(start, Count * Iterations);
+
+    Vector4f* out = new Vector4f[Count];
+    start = Timer::GetTicksNanos();
+    for (int iter = 0; iter < Iterations; iter++)
+        for (int i = 0; i < Count; i++)
+            out[i] = ScalarTransform(a[(i + iter) & (Count - 1)], v[i]);
+    const double scalarTransform = Elapsed(start, Count * Iterations);
+
+    start = Timer::GetTicksNanos();
+    for (int iter = 0; iter < Iterations; iter++)
+        for (int i = 0; i < Count; i++)
+            out[i] = a[(i + iter) & (Count - 1)].Transform(v[i]);
+    const double transform = Elapsed(start, Count * Iterations);
+
+    start = Timer::GetTicksNanos();
+    for (int iter = 0; iter < Iterations; iter++)
+        for (int i = 0; i < Count; i++)
+            d[i] = ScalarInverted(a[(i + iter) & (Count - 1)]);
+    const double scalarInverted = Elapsed(start, Count * Iterations);
+
+    start = Timer::GetTicksNanos();
+    for (int iter = 0; iter < Iterations; iter++)
+        for (int i = 0; i < Count; i++)
+            d[i] = a[(i + iter) & (Count - 1)].Inverted();
+    const double inverted = Elapsed(start, Count * Iterations);
+
+    LogText("TestMatrix4f - Multiply %.1f ns (scalar %.1f ns, array %.1f ns)\n", multiply, scalarMultiply, multiplyArray);
+    LogText("TestMatrix4f - Transform %.1f ns (scalar %.1f ns)\n", transform, scalarTransform);
+    LogText("TestMatrix4f - Inverted %.1f ns (scalar %.1f ns)\n", inverted, scalarInverted);
+    // Keep the results live.
+    LogText("TestMatrix4f - %f %f\n", d[Count / 2].M[1][2], out[Count / 2].y);
+
+    delete [] a;
+    delete [] b;
+    delete [] d;
+    delete [] v;
+    delete [] out;
+}
 
 } // Namespace OVR
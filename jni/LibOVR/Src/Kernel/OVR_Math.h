@@ -1781,6 +1781,19 @@ public:
         return result;
     }
 
+    // Array versions, for when many matrices share one side of the product.
+    static void MultiplyArray(Matrix4* d, const Matrix4& a, const Matrix4* b, int count)
+    {
+        for (int i = 0; i < count; i++)
+            Multiply(&d[i], a, b[i]);
+    }
+
+    static void MultiplyArray(Matrix4* d, const Matrix4* a, const Matrix4& b, int count)
+    {
+        for (int i = 0; i < count; i++)
+            Multiply(&d[i], a[i], b);
+    }
+
     Matrix4& operator*= (const Matrix4& b)
     {
         return Multiply(this, Matrix4(*this), b);
@@ -1846,6 +1859,18 @@ public:
         *this = Transposed();
     }
 
+    static void TransposeArray(Matrix4* d, const Matrix4* a, int count)
+    {
+        for (int i = 0; i < count; i++)
+            d[i] = a[i].Transposed();
+    }
+
+    static void TransformArray(Vector4<T>* d, const Matrix4& m, const Vector4<T>* v, int count)
+    {
+        for (int i = 0; i < count; i++)
+            d[i] = m.Transform(v[i]);
+    }
+
 
     T SubDet (const UPInt* rows, const UPInt* cols) const
     {
@@ -2281,6 +2306,20 @@ public:
     }
 };
 
+// The float versions of the hottest operations are implemented in OVR_Math.cpp,
+// with NEON or SSE when the compiler targets them, so only that one file needs
+// to be built with NEON enabled (Android.mk lists it as OVR_Math.cpp.neon).
+// Multiply and Transform give exactly the same results as the scalar code,
+// Inverted uses fewer operations than the cofactor expansion so it can differ
+// in the last bit.
+template<> Matrix4<float>& Matrix4<float>::Multiply(Matrix4<float>* d, const Matrix4<float>& a, const Matrix4<float>& b);
+template<> Vector4<float>  Matrix4<float>::Transform(const Vector4<float>& v) const;
+template<> Matrix4<float>  Matrix4<float>::Inverted() const;
+
+// Checks the float versions against the generic scalar code, and times them.
+bool TestMatrix4f();
+void BenchmarkMatrix4f();
+
 typedef Matrix4<float>  Matrix4f;
 typedef Matrix4<double> Matrix4d;
 
@@ -0,0 +1,139 @@
+/************************************************************************************
+
+Filename    :   OVR_ThreadRings.cpp
+Content     :   Per-thread event rings shared by the trace and the profiler
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "OVR_ThreadRings.h"
+
+#include <string.h>
+
+#if defined(OVR_OS_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "OVR_Allocator.h"
+#include "OVR_Log.h"
+
+namespace OVR {
+
+OVR_THREAD_LOCAL ThreadRingLocals	CurrentThreadRings;
+
+// Set up during static initialization, before any thread is named.
+static ThreadRings *	RingSets[THREAD_RING_KIND_MAX];
+
+ThreadRings::ThreadRings( const ThreadRingKind kind, const UPInt ringBytes, const char * owner ) :
+	Kind( kind ),
+	RingBytes( ringBytes ),
+	Owner( owner ),
+	NumRings( 0 )
+{
+	OVR_ASSERT( ringBytes >= sizeof( ThreadRingHeader ) );
+	OVR_ASSERT( RingSets[kind] == NULL );
+	memset( Rings, 0, sizeof( Rings ) );
+	RingSets[kind] = this;
+}
+
+int ThreadRings::GetCurrentThreadId()
+{
+#if defined(OVR_OS_WIN32)
+	return (int)::GetCurrentThreadId();
+#else
+	return (int)syscall( SYS_gettid );
+#endif
+}
+
+ThreadRingHeader * ThreadRings::AddRing( const char * name, const int threadId )
+{
+	const int index = NumRings;
+	if ( index >= MAX_RINGS )
+	{
+		LogText( "%s: more than %i threads, not recording %s\n", Owner, MAX_RINGS, ( name[0] != '\0' ) ? name : "a thread" );
+		return NULL;
+	}
+
+	ThreadRingHeader * ring = (ThreadRingHeader *)OVR_ALLOC( RingBytes );
+	if ( ring == NULL )
+	{
+		return NULL;
+	}
+	// The rings hold atomics, which are fine zeroed.
+	memset( (void *)ring, 0, RingBytes );
+	ring->ThreadId = threadId;
+	strncpy( ring->ThreadName, name, sizeof( ring->ThreadName ) - 1 );
+
+	Rings[index] = ring;
+	NumRings.Store_Release( index + 1 );
+	return ring;
+}
+
+ThreadRingHeader * ThreadRings::AllocCurrent()
+{
+	ThreadRingLocals & locals = CurrentThreadRings;
+	if ( locals.Failed[Kind] )
+	{
+		return NULL;
+	}
+
+	Lock::Locker locker( &RingLock );
+
+	ThreadRingHeader * ring = AddRing( locals.ThreadName, GetCurrentThreadId() );
+	if ( ring == NULL )
+	{
+		locals.Failed[Kind] = true;
+		return NULL;
+	}
+	locals.Rings[Kind] = ring;
+	return ring;
+}
+
+ThreadRingHeader * ThreadRings::FindOrAddNamed( const char * name )
+{
+	Lock::Locker locker( &RingLock );
+
+	const int numRings = NumRings;
+	for ( int i = 0; i < numRings; i++ )
+	{
+		if ( Rings[i]->ThreadId == 0 && strncmp( Rings[i]->ThreadName, name, MAX_THREAD_NAME - 1 ) == 0 )
+		{
+			return Rings[i];
+		}
+	}
+	return AddRing( name, 0 );
+}
+
+String ThreadRings::GetRingName( const int index ) const
+{
+	Lock::Locker locker( &RingLock );
+	return String( Rings[index]->ThreadName );
+}
+
+void ThreadRings::SetRingName( ThreadRingHeader * ring, const char * name )
+{
+	Lock::Locker locker( &RingLock );
+	memcpy( ring->ThreadName, name, sizeof( ring->ThreadName ) );
+}
+
+void ThreadRings::SetCurrentThreadName( const char * name )
+{
+	ThreadRingLocals & locals = CurrentThreadRings;
+	strncpy( locals.ThreadName, name, sizeof( locals.ThreadName ) - 1 );
+	locals.ThreadName[sizeof( locals.ThreadName ) - 1] = '\0';
+
+	for ( int kind = 0; kind < THREAD_RING_KIND_MAX; kind++ )
+	{
+		if ( locals.Rings[kind] != NULL && RingSets[kind] != NULL )
+		{
+			RingSets[kind]->SetRingName( locals.Rings[kind], locals.ThreadName );
+		}
+	}
+}
+
+} // namespace OVR
@@ -0,0 +1,116 @@
+/************************************************************************************
+
+Filename    :   OVR_ThreadRings.h
+Content     :   Per-thread event rings shared by the trace and the profiler
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#ifndef OVR_ThreadRings_h
+#define OVR_ThreadRings_h
+
+#include "OVR_Types.h"
+#include "OVR_Atomic.h"
+#include "OVR_String.h"
+
+#if defined(OVR_CC_MSVC)
+#define OVR_THREAD_LOCAL __declspec(thread)
+#else
+#define OVR_THREAD_LOCAL __thread
+#endif
+
+namespace OVR {
+
+
+// ***** ThreadRings
+
+// The recording side of Trace and Profiler: a set of rings, one per thread
+// that recorded anything, plus named rings that don't belong to a thread. A
+// thread finds its own ring through a thread local, so recording takes no
+// locks. Rings are never freed, so readers can walk them without locks as
+// well; only the names need RingLock.
+//
+// Each kind of ring has its own set, but the thread names are shared, so a
+// thread only has to be named once for all of them.
+
+static const int MAX_THREAD_NAME = 32;
+
+enum ThreadRingKind
+{
+	THREAD_RING_TRACE,
+	THREAD_RING_PROFILE,
+	THREAD_RING_KIND_MAX
+};
+
+// Every ring starts with this. The rest of the ring is cleared when it is
+// allocated.
+struct ThreadRingHeader
+{
+	int		ThreadId;						// 0 for named rings
+	char	ThreadName[MAX_THREAD_NAME];	// guarded by the lock of the set
+};
+
+// The rings of the calling thread, one per kind. Only used by ThreadRings.
+struct ThreadRingLocals
+{
+	ThreadRingHeader *	Rings[THREAD_RING_KIND_MAX];
+	bool				Failed[THREAD_RING_KIND_MAX];
+	char				ThreadName[MAX_THREAD_NAME];
+};
+
+extern OVR_THREAD_LOCAL ThreadRingLocals	CurrentThreadRings;
+
+class ThreadRings
+{
+public:
+	static const int MAX_RINGS = 32;
+
+	// There must be only one set of each kind, normally a static.
+						ThreadRings( const ThreadRingKind kind, const UPInt ringBytes, const char * owner );
+
+	// The ring of the calling thread, or NULL if it doesn't have one yet.
+	ThreadRingHeader *	PeekCurrent() const { return CurrentThreadRings.Rings[Kind]; }
+
+	// The ring of the calling thread, allocated on the first call. Returns
+	// NULL if there is no room left, and keeps doing so on that thread
+	// without taking the lock again.
+	ThreadRingHeader *	GetCurrent()
+	{
+		ThreadRingHeader * ring = CurrentThreadRings.Rings[Kind];
+		return ( ring != NULL ) ? ring : AllocCurrent();
+	}
+
+	// Returns the named ring with this name, adding it if there is none.
+	// Returns NULL if there is no room left.
+	ThreadRingHeader *	FindOrAddNamed( const char * name );
+
+	// Rings are only ever added, with a release after they are set up.
+	int					GetNumRings() const { return NumRings.Load_Acquire(); }
+	ThreadRingHeader *	GetRing( const int index ) const { return Rings[index]; }
+
+	// Copies the current name of a ring, which may be empty.
+	String				GetRingName( const int index ) const;
+
+	// Names the calling thread in the rings of every kind. The name is copied.
+	static void			SetCurrentThreadName( const char * name );
+
+	static int			GetCurrentThreadId();
+
+private:
+	const ThreadRingKind	Kind;
+	const UPInt				RingBytes;
+	const char *			Owner;			// for the log
+	mutable Lock			RingLock;
+	ThreadRingHeader *		Rings[MAX_RINGS];
+	AtomicInt<int>			NumRings;
+
+	ThreadRingHeader *	AllocCurrent();
+	ThreadRingHeader *	AddRing( const char * name, const int threadId );	// with RingLock held
+	void				SetRingName( ThreadRingHeader * ring, const char * name );
+};
+
+} // namespace OVR
+
+#endif // OVR_ThreadRings_h
@@ -0,0 +1,586 @@
+/************************************************************************************
+
+Filename    :   OVR_Trace.cpp
+Content     :   Low overhead per-thread event tracing with Chrome trace export
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "OVR_Trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(OVR_OS_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "OVR_Atomic.h"
+#include "OVR_Alg.h"
+#include "OVR_Array.h"
+#include "OVR_Hash.h"
+#include "OVR_String.h"
+#include "OVR_ThreadRings.h"
+
+namespace OVR {
+
+// The owning thread writes an event, then publishes it by storing Head. A
+// reader copies the published events out and afterwards discards the ones the
+// owner may have started overwriting in the meantime.
+struct TraceRing : public ThreadRingHeader
+{
+	AtomicInt<UInt32>	Head;			// number of events written, wraps
+	AtomicInt<UInt32>	Start;			// Head when Clear() was last called
+	UInt32				Written;		// only touched by the owning thread
+	TraceEvent			Events[Trace::RING_SIZE];
+};
+
+volatile bool Trace::Enabled = false;
+
+static ThreadRings		TraceRings( THREAD_RING_TRACE, sizeof( TraceRing ), "Trace" );
+
+static const char * CategoryNames[TRACE_CATEGORY_MAX] =
+{
+	"frame",
+	"warp",
+	"sensor",
+	"load",
+	"gpu"
+};
+
+static int GetCurrentProcessIdForTrace()
+{
+#if defined(OVR_OS_WIN32)
+	return (int)::GetCurrentProcessId();
+#else
+	return (int)getpid();
+#endif
+}
+
+void Trace::SetEnabled( const bool enabled )
+{
+	Enabled = enabled;
+}
+
+void Trace::RecordAt( const SInt64 timeNanos, const TraceEventType type, const TraceCategory category,
+						const char * name, const SInt64 value, const int index )
+{
+	TraceRing * ring = static_cast< TraceRing * >( TraceRings.PeekCurrent() );
+	if ( ring == NULL )
+	{
+		// Only start tracing a thread while enabled, so a stray end
+		// doesn't allocate a ring.
+		if ( !Enabled || ( ring = static_cast< TraceRing * >( TraceRings.GetCurrent() ) ) == NULL )
+		{
+			return;
+		}
+	}
+
+	const UInt32 written = ring->Written;
+	TraceEvent & event = ring->Events[written & ( RING_SIZE - 1 )];
+	event.TimeNanos = timeNanos;
+	event.Value = value;
+	event.Name = name;
+	event.Index = (UInt16)index;
+	event.Type = (UByte)type;
+	event.Category = (UByte)category;
+
+	ring->Written = written + 1;
+	ring->Head.Store_Release( written + 1 );
+}
+
+void Trace::SetThreadName( const char * name )
+{
+	ThreadRings::SetCurrentThreadName( name );
+}
+
+void Trace::Clear()
+{
+	const int numRings = TraceRings.GetNumRings();
+	for ( int i = 0; i < numRings; i++ )
+	{
+		TraceRing * ring = static_cast< TraceRing * >( TraceRings.GetRing( i ) );
+		ring->Start.Store_Release( ring->Head.Load_Acquire() );
+	}
+}
+
+//-----------------------------------------------------------------------------------
+// ***** Snapshots
+
+struct TraceThread
+{
+	int						ThreadId;
+	String					Name;
+	Array< TraceEvent >		Events;
+};
+
+struct TraceSnapshot
+{
+	TraceSnapshot() : ProcessId( 0 ), BaseNanos( 0 ) {}
+
+	int						ProcessId;
+	SInt64					BaseNanos;		// the earliest event
+	Array< TraceThread >	Threads;
+	Array< String >			Names;			// storage for names read back from a binary file
+};
+
+// Ends without a begin on the thread can show up at the start of a ring that
+// wrapped or was cleared, and would close spans they don't belong to.
+static void DropUnmatchedEnds( Array< TraceEvent > & events )
+{
+	int depth = 0;
+	int out = 0;
+	for ( int i = 0; i < events.GetSizeI(); i++ )
+	{
+		if ( events[i].Type == TRACE_BEGIN )
+		{
+			depth++;
+		}
+		else if ( events[i].Type == TRACE_END )
+		{
+			if ( depth == 0 )
+			{
+				continue;
+			}
+			depth--;
+		}
+		events[out++] = events[i];
+	}
+	events.Resize( out );
+}
+
+static void TakeSnapshot( TraceSnapshot & snapshot )
+{
+	snapshot.ProcessId = GetCurrentProcessIdForTrace();
+	snapshot.BaseNanos = 0;
+	snapshot.Threads.Clear();
+
+	bool haveBase = false;
+	const int numRings = TraceRings.GetNumRings();
+	for ( int r = 0; r < numRings; r++ )
+	{
+		TraceRing * ring = static_cast< TraceRing * >( TraceRings.GetRing( r ) );
+
+		// Start first, so a Clear() in between can't put it past head.
+		UInt32 start = ring->Start.Load_Acquire();
+		const UInt32 head = ring->Head.Load_Acquire();
+		if ( head - start > (UInt32)Trace::RING_SIZE )
+		{
+			start = head - Trace::RING_SIZE;
+		}
+
+		TraceThread & thread = snapshot.Threads.PushDefault();
+		thread.ThreadId = ring->ThreadId;
+		thread.Name = TraceRings.GetRingName( r );
+
+		thread.Events.Resize( head - start );
+		for ( UInt32 i = start; i != head; i++ )
+		{
+			thread.Events[i - start] = ring->Events[i & ( Trace::RING_SIZE - 1 )];
+		}
+
+		// Adding 0 only to get a full barrier after the copies. The owner may
+		// be overwriting the oldest event of the ring that was published after
+		// the copy started.
+		const UInt32 after = ring->Head.ExchangeAdd_Sync( 0 );
+		if ( after - start >= (UInt32)Trace::RING_SIZE )
+		{
+			const int overwritten = Alg::Min( (int)( after - start - Trace::RING_SIZE + 1 ), thread.Events.GetSizeI() );
+			thread.Events.RemoveMultipleAt( 0, overwritten );
+		}
+
+		DropUnmatchedEnds( thread.Events );
+
+		for ( int i = 0; i < thread.Events.GetSizeI(); i++ )
+		{
+			if ( !haveBase || thread.Events[i].TimeNanos < snapshot.BaseNanos )
+			{
+				snapshot.BaseNanos = thread.Events[i].TimeNanos;
+				haveBase = true;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------
+// ***** Chrome trace event JSON
+
+static void WriteJsonString( FILE * f, const char * s )
+{
+	fputc( '"', f );
+	for ( ; *s != '\0'; s++ )
+	{
+		const unsigned char c = (unsigned char)*s;
+		if ( c == '"' || c == '\\' )
+		{
+			fputc( '\\', f );
+			fputc( c, f );
+		}
+		else if ( c < 0x20 )
+		{
+			fprintf( f, "\\u%04x", c );
+		}
+		else
+		{
+			fputc( c, f );
+		}
+	}
+	fputc( '"', f );
+}
+
+// Trace event times are in microseconds, written with nanosecond decimals.
+static void WriteJsonMicroseconds( FILE * f, const SInt64 nanos )
+{
+	const SInt64 absNanos = nanos < 0 ? -nanos : nanos;
+	fprintf( f, "%s%lld.%03d", nanos < 0 ? "-" : "", (long long)( absNanos / 1000 ), (int)( absNanos % 1000 ) );
+}
+
+static int WriteChromeJson( const TraceSnapshot & snapshot, const char * path )
+{
+	static const char * phases[] = { "B", "E", "i", "C", "X" };
+
+	FILE * f = fopen( path, "w" );
+	if ( f == NULL )
+	{
+		return -1;
+	}
+
+	fprintf( f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+
+	int numEvents = 0;
+	bool first = true;
+	for ( int t = 0; t < snapshot.Threads.GetSizeI(); t++ )
+	{
+		const TraceThread & thread = snapshot.Threads[t];
+		if ( !thread.Name.IsEmpty() )
+		{
+			fprintf( f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+					first ? "" : ",\n", snapshot.ProcessId, thread.ThreadId );
+			WriteJsonString( f, thread.Name.ToCStr() );
+			fprintf( f, "}}" );
+			first = false;
+		}
+
+		for ( int i = 0; i < thread.Events.GetSizeI(); i++ )
+		{
+			const TraceEvent & event = thread.Events[i];
+
+			fprintf( f, "%s{\"name\":", first ? "" : ",\n" );
+			WriteJsonString( f, event.Name != NULL ? event.Name : "" );
+			fprintf( f, ",\"cat\":\"%s\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":",
+					event.Category < TRACE_CATEGORY_MAX ? CategoryNames[event.Category] : "",
+					event.Type <= TRACE_COMPLETE ? phases[event.Type] : "i",
+					snapshot.ProcessId, thread.ThreadId );
+			WriteJsonMicroseconds( f, event.TimeNanos - snapshot.BaseNanos );
+
+			switch ( event.Type )
+			{
+				case TRACE_END:
+					break;
+				case TRACE_COUNTER:
+					fprintf( f, ",\"args\":{\"%d\":%lld}", event.Index, (long long)event.Value );
+					break;
+				case TRACE_COMPLETE:
+					fprintf( f, ",\"dur\":" );
+					WriteJsonMicroseconds( f, event.Value );
+					fprintf( f, ",\"args\":{\"index\":%d}", event.Index );
+					break;
+				case TRACE_INSTANT:
+					fprintf( f, ",\"s\":\"t\"" );
+					// fall through
+				default:
+					fprintf( f, ",\"args\":{\"index\":%d,\"value\":%lld}", event.Index, (long long)event.Value );
+					break;
+			}
+			fprintf( f, "}" );
+			first = false;
+			numEvents++;
+		}
+	}
+
+	fprintf( f, "\n]}\n" );
+	const bool failed = ( ferror( f ) != 0 );
+	if ( fclose( f ) != 0 || failed )
+	{
+		return -1;
+	}
+	return numEvents;
+}
+
+int Trace::ExportChromeJson( const char * path )
+{
+	TraceSnapshot snapshot;
+	TakeSnapshot( snapshot );
+	return WriteChromeJson( snapshot, path );
+}
+
+//-----------------------------------------------------------------------------------
+// ***** Binary
+
+// All integers are little endian varints, signed ones zigzag encoded.
+//
+// "OVRTRACE" version processId baseNanos
+// numNames { length bytes }
+// numThreads { threadId nameLength nameBytes numEvents { typeAndCategory nameIndex index timeDelta value } }
+//
+// Event times are deltas from the previous event of the thread, starting
+// from baseNanos, so most of them fit in two or three bytes.
+
+static const char	BinaryMagic[8] = { 'O', 'V', 'R', 'T', 'R', 'A', 'C', 'E' };
+static const int	BinaryVersion = 1;
+
+static void WriteVarint( Array< UByte > & buffer, UInt64 value )
+{
+	while ( value >= 0x80 )
+	{
+		buffer.PushBack( (UByte)( value | 0x80 ) );
+		value >>= 7;
+	}
+	buffer.PushBack( (UByte)value );
+}
+
+static void WriteSignedVarint( Array< UByte > & buffer, const SInt64 value )
+{
+	WriteVarint( buffer, ( (UInt64)value << 1 ) ^ (UInt64)( value >> 63 ) );
+}
+
+static void WriteBytes( Array< UByte > & buffer, const void * bytes, const int length )
+{
+	buffer.Append( (const UByte *)bytes, length );
+}
+
+int Trace::ExportBinary( const char * path )
+{
+	TraceSnapshot snapshot;
+	TakeSnapshot( snapshot );
+
+	// Intern the names by content, since the same literal may have a
+	// different address in every translation unit. Most lookups hit the
+	// address cache, which doesn't need to build a String.
+	Hash< const char *, int > addressIndices;
+	Hash< String, int, String::HashFunctor > nameIndices;
+	Array< const char * > names;
+	Array< UByte > events;
+	int numEvents = 0;
+
+	WriteVarint( events, snapshot.Threads.GetSize() );
+	for ( int t = 0; t < snapshot.Threads.GetSizeI(); t++ )
+	{
+		const TraceThread & thread = snapshot.Threads[t];
+		WriteVarint( events, (UInt32)thread.ThreadId );
+		WriteVarint( events, thread.Name.GetSize() );
+		WriteBytes( events, thread.Name.ToCStr(), (int)thread.Name.GetSize() );
+		WriteVarint( events, thread.Events.GetSize() );
+
+		SInt64 previousNanos = snapshot.BaseNanos;
+		for ( int i = 0; i < thread.Events.GetSizeI(); i++ )
+		{
+			const TraceEvent & event = thread.Events[i];
+			const char * name = event.Name != NULL ? event.Name : "";
+
+			int nameIndex;
+			if ( !addressIndices.Get( name, &nameIndex ) )
+			{
+				if ( !nameIndices.Get( name, &nameIndex ) )
+				{
+					nameIndex = names.GetSizeI();
+					nameIndices.Add( name, nameIndex );
+					names.PushBack( name );
+				}
+				addressIndices.Add( name, nameIndex );
+			}
+
+			events.PushBack( (UByte)( event.Type | ( event.Category << 3 ) ) );
+			WriteVarint( events, nameIndex );
+			WriteVarint( events, event.Index );
+			WriteSignedVarint( events, event.TimeNanos - previousNanos );
+			WriteSignedVarint( events, event.Value );
+			previousNanos = event.TimeNanos;
+			numEvents++;
+		}
+	}
+
+	Array< UByte > header;
+	WriteBytes( header, BinaryMagic, sizeof( BinaryMagic ) );
+	WriteVarint( header, BinaryVersion );
+	WriteVarint( header, (UInt32)snapshot.ProcessId );
+	WriteSignedVarint( header, snapshot.BaseNanos );
+	WriteVarint( header, names.GetSize() );
+	for ( int i = 0; i < names.GetSizeI(); i++ )
+	{
+		const int length = (int)strlen( names[i] );
+		WriteVarint( header, length );
+		WriteBytes( header, names[i], length );
+	}
+
+	FILE * f = fopen( path, "wb" );
+	if ( f == NULL )
+	{
+		return -1;
+	}
+	const bool written = fwrite( header.GetDataPtr(), 1, header.GetSize(), f ) == header.GetSize() &&
+						fwrite( events.GetDataPtr(), 1, events.GetSize(), f ) == events.GetSize();
+	if ( fclose( f ) != 0 || !written )
+	{
+		return -1;
+	}
+	return numEvents;
+}
+
+class TraceReader
+{
+public:
+	TraceReader( const UByte * data, const int size ) : Data( data ), Size( size ), Offset( 0 ), Failed( false ) {}
+
+	bool	HasFailed() const { return Failed; }
+
+	UInt64	ReadVarint()
+	{
+		UInt64 value = 0;
+		for ( int shift = 0; shift < 64; shift += 7 )
+		{
+			if ( Offset >= Size )
+			{
+				Failed = true;
+				return 0;
+			}
+			const UByte b = Data[Offset++];
+			value |= (UInt64)( b & 0x7F ) << shift;
+			if ( ( b & 0x80 ) == 0 )
+			{
+				return value;
+			}
+		}
+		Failed = true;
+		return 0;
+	}
+
+	SInt64	ReadSignedVarint()
+	{
+		const UInt64 value = ReadVarint();
+		return (SInt64)( value >> 1 ) ^ -(SInt64)( value & 1 );
+	}
+
+	UByte	ReadByte()
+	{
+		if ( Offset >= Size )
+		{
+			Failed = true;
+			return 0;
+		}
+		return Data[Offset++];
+	}
+
+	String	ReadString()
+	{
+		const UInt64 length = ReadVarint();
+		if ( Failed || length > (UInt64)( Size - Offset ) )
+		{
+			Failed = true;
+			return String();
+		}
+		String s( (const char *)Data + Offset, (UPInt)length );
+		Offset += (int)length;
+		return s;
+	}
+
+	// Guards the array sizes, every entry takes at least one byte.
+	int		ReadCount()
+	{
+		const UInt64 count = ReadVarint();
+		if ( Failed || count > (UInt64)( Size - Offset ) )
+		{
+			Failed = true;
+			return 0;
+		}
+		return (int)count;
+	}
+
+private:
+	const UByte *	Data;
+	int				Size;
+	int				Offset;
+	bool			Failed;
+};
+
+static bool ReadBinary( const Array< UByte > & data, TraceSnapshot & snapshot )
+{
+	if ( data.GetSize() < sizeof( BinaryMagic ) || memcmp( data.GetDataPtr(), BinaryMagic, sizeof( BinaryMagic ) ) != 0 )
+	{
+		return false;
+	}
+
+	TraceReader reader( data.GetDataPtr() + sizeof( BinaryMagic ), data.GetSizeI() - (int)sizeof( BinaryMagic ) );
+	if ( reader.ReadVarint() != BinaryVersion )
+	{
+		return false;
+	}
+	snapshot.ProcessId = (int)reader.ReadVarint();
+	snapshot.BaseNanos = reader.ReadSignedVarint();
+
+	const int numNames = reader.ReadCount();
+	snapshot.Names.Resize( numNames );
+	for ( int i = 0; i < numNames && !reader.HasFailed(); i++ )
+	{
+		snapshot.Names[i] = reader.ReadString();
+	}
+
+	const int numThreads = reader.ReadCount();
+	for ( int t = 0; t < numThreads && !reader.HasFailed(); t++ )
+	{
+		TraceThread & thread = snapshot.Threads.PushDefault();
+		thread.ThreadId = (int)reader.ReadVarint();
+		thread.Name = reader.ReadString();
+
+		const int numEvents = reader.ReadCount();
+		thread.Events.Resize( numEvents );
+		SInt64 previousNanos = snapshot.BaseNanos;
+		for ( int i = 0; i < numEvents && !reader.HasFailed(); i++ )
+		{
+			TraceEvent & event = thread.Events[i];
+			const UByte typeAndCategory = reader.ReadByte();
+			const UInt64 nameIndex = reader.ReadVarint();
+			if ( nameIndex >= (UInt64)numNames )
+			{
+				return false;
+			}
+			event.Type = typeAndCategory & 7;
+			event.Category = typeAndCategory >> 3;
+			event.Name = snapshot.Names[(int)nameIndex].ToCStr();
+			event.Index = (UInt16)reader.ReadVarint();
+			event.TimeNanos = previousNanos + reader.ReadSignedVarint();
+			event.Value = reader.ReadSignedVarint();
+			previousNanos = event.TimeNanos;
+		}
+	}
+	return !reader.HasFailed();
+}
+
+int Trace::ConvertBinaryToChromeJson( const char * binaryPath, const char * jsonPath )
+{
+	FILE * f = fopen( binaryPath, "rb" );
+	if ( f == NULL )
+	{
+		return -1;
+	}
+	Array< UByte > data;
+	UByte block[4096];
+	for ( size_t read; ( read = fread( block, 1, sizeof( block ), f ) ) > 0; )
+	{
+		WriteBytes( data, block, (int)read );
+	}
+	fclose( f );
+
+	TraceSnapshot snapshot;
+	if ( !ReadBinary( data, snapshot ) )
+	{
+		return -1;
+	}
+	return WriteChromeJson( snapshot, jsonPath );
+}
+
+} // namespace OVR
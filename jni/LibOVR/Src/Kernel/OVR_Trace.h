@@ -0,0 +1,182 @@
+/************************************************************************************
+
+Filename    :   OVR_Trace.h
+Content     :   Low overhead per-thread event tracing with Chrome trace export
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#ifndef OVR_Trace_h
+#define OVR_Trace_h
+
+#include "OVR_Types.h"
+#include "OVR_Timer.h"
+#include "OVR_ThreadRings.h"
+
+namespace OVR {
+
+
+// ***** Trace
+
+// Records timestamped events into a ring per thread, so long captures can be
+// taken in production sessions and inspected offline. Nothing is recorded, and
+// nothing is allocated, until tracing is enabled. After that, recording an
+// event is a thread local lookup, a clock read and a few stores; there are no
+// locks or atomic read-modify-writes on the recording path.
+//
+// Each ring keeps the most recent RING_SIZE events of its thread. Rings are
+// never freed, so at most MAX_THREADS threads are traced over the life of the
+// process; events from threads beyond that are dropped.
+//
+// Event names are stored as pointers and must stay valid for the life of the
+// process, normally string literals.
+
+enum TraceCategory
+{
+	TRACE_FRAME,		// application frames and WarpSwap()
+	TRACE_WARP,			// time warp eyes and slices
+	TRACE_SENSOR,		// sensor samples and pose predictions
+	TRACE_LOAD,			// file and resource loading
+	TRACE_GPU,			// GPU timer query results
+	TRACE_CATEGORY_MAX
+};
+
+enum TraceEventType
+{
+	TRACE_BEGIN,		// starts a nested span on the thread
+	TRACE_END,			// ends the innermost span
+	TRACE_INSTANT,		// Value is an optional argument
+	TRACE_COUNTER,		// Value is the counter value, Index selects the series
+	TRACE_COMPLETE		// a span that started at TimeNanos and lasted Value nanoseconds
+};
+
+struct TraceEvent
+{
+	SInt64			TimeNanos;		// Timer::GetTicksNanos()
+	SInt64			Value;
+	const char *	Name;
+	UInt16			Index;			// slice, eye or timer number
+	UByte			Type;			// TraceEventType
+	UByte			Category;		// TraceCategory
+};
+
+class Trace
+{
+public:
+	static const int RING_SIZE = 16384;		// must be a power of two
+	static const int MAX_THREADS = ThreadRings::MAX_RINGS;
+
+	static bool		IsEnabled() { return Enabled; }
+	static void		SetEnabled( const bool enabled );
+
+	static void		Record( const TraceEventType type, const TraceCategory category, const char * name,
+							const SInt64 value = 0, const int index = 0 )
+	{
+		RecordAt( (SInt64)Timer::GetTicksNanos(), type, category, name, value, index );
+	}
+	static void		RecordAt( const SInt64 timeNanos, const TraceEventType type, const TraceCategory category,
+							const char * name, const SInt64 value = 0, const int index = 0 );
+
+	// Names the calling thread in the exports, and in the other users of
+	// ThreadRings. The name is copied.
+	static void		SetThreadName( const char * name );
+
+	// Drops everything recorded so far.
+	static void		Clear();
+
+	// Writes a snapshot of all rings in the Chrome trace event format, which
+	// chrome://tracing and Perfetto load directly. Recording continues while
+	// this runs. Returns the number of events written, or -1 on failure.
+	static int		ExportChromeJson( const char * path );
+
+	// Writes the same snapshot in a compact binary form, typically under a
+	// tenth of the size of the JSON, for when a capture has to be copied off
+	// the device. Returns the number of events written, or -1 on failure.
+	static int		ExportBinary( const char * path );
+
+	// Turns an ExportBinary() file into an ExportChromeJson() file offline.
+	// Returns the number of events converted, or -1 on failure.
+	static int		ConvertBinaryToChromeJson( const char * binaryPath, const char * jsonPath );
+
+private:
+	static volatile bool	Enabled;
+};
+
+inline void TraceBegin( const TraceCategory category, const char * name, const int index = 0 )
+{
+	if ( Trace::IsEnabled() )
+	{
+		Trace::Record( TRACE_BEGIN, category, name, 0, index );
+	}
+}
+
+inline void TraceEnd( const TraceCategory category, const char * name, const int index = 0 )
+{
+	if ( Trace::IsEnabled() )
+	{
+		Trace::Record( TRACE_END, category, name, 0, index );
+	}
+}
+
+inline void TraceInstant( const TraceCategory category, const char * name, const SInt64 value = 0, const int index = 0 )
+{
+	if ( Trace::IsEnabled() )
+	{
+		Trace::Record( TRACE_INSTANT, category, name, value, index );
+	}
+}
+
+inline void TraceCounter( const TraceCategory category, const char * name, const SInt64 value, const int index = 0 )
+{
+	if ( Trace::IsEnabled() )
+	{
+		Trace::Record( TRACE_COUNTER, category, name, value, index );
+	}
+}
+
+inline void TraceComplete( const TraceCategory category, const char * name, const SInt64 startNanos,
+						const SInt64 durationNanos, const int index = 0 )
+{
+	if ( Trace::IsEnabled() )
+	{
+		Trace::RecordAt( startNanos, TRACE_COMPLETE, category, name, durationNanos, index );
+	}
+}
+
+// Declaring a variable with this class traces a span until it goes out of
+// scope. The end is recorded even if tracing was disabled in between, so
+// spans are never left open.
+class TraceScope
+{
+public:
+	TraceScope( const TraceCategory category, const char * name, const int index = 0 ) :
+		Category( category ),
+		Name( name ),
+		Index( index ),
+		Active( Trace::IsEnabled() )
+	{
+		if ( Active )
+		{
+			Trace::Record( TRACE_BEGIN, Category, Name, 0, Index );
+		}
+	}
+	~TraceScope()
+	{
+		if ( Active )
+		{
+			Trace::Record( TRACE_END, Category, Name, 0, Index );
+		}
+	}
+
+private:
+	const TraceCategory	Category;
+	const char *		Name;
+	const int			Index;
+	const bool			Active;
+};
+
+} // namespace OVR
+
+#endif // OVR_Trace_h
@@ -13,6 +13,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 #include "../Include/OVR.h"
 #include "Kernel/OVR_Timer.h"
+#include "Kernel/OVR_Trace.h"
 
 #include "OVR_PhoneSensors.h"
 
@@ -163,9 +164,24 @@ void ovrHmd_RecenterYaw(ovrHmd hmd)
 	p->RecenterYaw();
 }
 
+bool ovrHmd_StartSensorRecording(ovrHmd hmd, const char* path)
+{
+    OVR::CAPI::HMDState* p = (OVR::CAPI::HMDState*)hmd;
+    return p->StartSensorRecording(path);
+}
+
+void ovrHmd_StopSensorRecording(ovrHmd hmd)
+{
+    OVR::CAPI::HMDState* p = (OVR::CAPI::HMDState*)hmd;
+    p->StopSensorRecording();
+}
+
 ovrSensorState ovrHmd_GetSensorState(ovrHmd hmd, double absTime, bool allowSensorCreate)
 {
     OVR::CAPI::HMDState* p = (OVR::CAPI::HMDState*)hmd;
+    // Traced with how far ahead the prediction is.
+    OVR::TraceInstant(OVR::TRACE_SENSOR, "PredictSensorState",
+                      (OVR::SInt64)((absTime - OVR::Timer::GetSeconds()) * 1e9));
     return p->PredictedSensorState(absTime, allowSensorCreate );
 }
 
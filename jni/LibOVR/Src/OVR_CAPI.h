@@ -221,6 +221,12 @@ void        ovrHmd_ResetSensor(ovrHmd hmd);
 // Recenters the orientation on the yaw axis.
 void        ovrHmd_RecenterYaw(ovrHmd hmd);
 
+// Writes every raw sensor input report to a log that SensorReplay can play
+// back offline, until ovrHmd_StopSensorRecording is called. Returns false if
+// there is no sensor yet or the log couldn't be opened.
+bool        ovrHmd_StartSensorRecording(ovrHmd hmd, const char* path);
+void        ovrHmd_StopSensorRecording(ovrHmd hmd);
+
 // Returns sensor state reading based on the specified absolute system time.
 // Pass absTime value of 0.0 to request the most recent sensor reading; in this case
 // both PredictedPose and SamplePose will have the same value.
@@ -669,6 +669,11 @@ public:
     virtual bool        GetAllTemperatureReports(Array<Array<TemperatureReport> >*) { return false; }
 
     virtual bool        GetGyroOffsetReport(GyroOffsetReport*) { return false; }	
+
+    // Writes every raw input report to a log until StopRecording() is called,
+    // so the session can be replayed offline with SensorReplay.
+    virtual bool        StartRecording(const char*) { return false; }
+    virtual void        StopRecording() { }
 };
 
 //-------------------------------------------------------------------------------------
@@ -0,0 +1,352 @@
+/************************************************************************************
+
+Filename    :   OVR_PoseHistory.cpp
+Content     :   Lock-less history of timestamped poses for arbitrary time queries
+Created     :   October 19, 2026
+Notes       :
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+************************************************************************************/
+
+#include "OVR_PoseHistory.h"
+
+namespace OVR {
+
+//-------------------------------------------------------------------------------------
+// ***** PoseHistory
+
+PoseHistory::PoseHistory() : ValidFrom(0)
+{
+}
+
+void PoseHistory::Add(const PoseStatef& pose)
+{
+    Poses.SetState(pose);
+}
+
+void PoseHistory::Reset()
+{
+    const UInt32 numWritten = Poses.GetUpdateCount();
+    LocklessBarrier();
+    ValidFrom.Value = numWritten;
+}
+
+bool PoseHistory::GetLatest(PoseStatef* pose) const
+{
+    for (;;)
+    {
+        // ValidFrom is read first, so it can never be past numWritten.
+        const UInt32 validFrom  = ValidFrom;
+        LocklessBarrier();
+        const UInt32 numWritten = Poses.GetUpdateCount();
+        if (numWritten == validFrom)
+        {
+            return false;
+        }
+        if (Poses.GetStateFromUpdate(numWritten, pose))
+        {
+            return true;
+        }
+        // The writer went all the way around the ring while we were preempted.
+    }
+}
+
+bool PoseHistory::GetPoseAtTime(double absoluteTimeSeconds, PoseStatef* pose) const
+{
+    bool retry;
+    do
+    {
+        if (getPoseAtTime(absoluteTimeSeconds, pose, &retry))
+        {
+            return true;
+        }
+    } while (retry);
+
+    return false;
+}
+
+bool PoseHistory::getPoseAtTime(double absoluteTimeSeconds, PoseStatef* pose, bool* retry) const
+{
+    *retry = false;
+
+    // ValidFrom is read first, so it can never be past numWritten.
+    const UInt32 validFrom  = ValidFrom;
+    LocklessBarrier();
+    const UInt32 numWritten = Poses.GetUpdateCount();
+
+    // Unsigned differences keep this correct when the indices wrap.
+    UInt32 count = numWritten - validFrom;
+    if (count == 0)
+    {
+        return false;
+    }
+    if (count > Capacity - GuardSlots)
+    {
+        count = Capacity - GuardSlots;
+    }
+    const UInt32 first = numWritten - count + 1;
+
+    PoseStatef after;
+    if (!Poses.GetStateFromUpdate(numWritten, &after))
+    {
+        *retry = true;
+        return false;
+    }
+    if (absoluteTimeSeconds >= after.TimeInSeconds || count == 1)
+    {
+        *pose = after;
+        return true;
+    }
+
+    PoseStatef before;
+    if (!Poses.GetStateFromUpdate(first, &before))
+    {
+        *retry = true;
+        return false;
+    }
+    if (absoluteTimeSeconds <= before.TimeInSeconds)
+    {
+        *pose = before;
+        return true;
+    }
+
+    // Binary search for the pair of samples that bracket the requested time.
+    UInt32 lo = 0;
+    UInt32 hi = count - 1;
+    while (hi - lo > 1)
+    {
+        const UInt32 mid = lo + (hi - lo) / 2;
+        PoseStatef sample;
+        if (!Poses.GetStateFromUpdate(first + mid, &sample))
+        {
+            *retry = true;
+            return false;
+        }
+        if (sample.TimeInSeconds <= absoluteTimeSeconds)
+        {
+            lo     = mid;
+            before = sample;
+        }
+        else
+        {
+            hi    = mid;
+            after = sample;
+        }
+    }
+
+    const double span = after.TimeInSeconds - before.TimeInSeconds;
+    const float  f    = (span > 0.0) ? (float)((absoluteTimeSeconds - before.TimeInSeconds) / span) : 0.0f;
+
+    // Nlerp weights *this by its second argument.
+    pose->Transform.Orientation = before.Transform.Orientation.Nlerp(after.Transform.Orientation, 1.0f - f);
+    pose->Transform.Position    = before.Transform.Position.Lerp(after.Transform.Position, f);
+    pose->AngularVelocity       = before.AngularVelocity.Lerp(after.AngularVelocity, f);
+    pose->LinearVelocity        = before.LinearVelocity.Lerp(after.LinearVelocity, f);
+    pose->AngularAcceleration   = before.AngularAcceleration.Lerp(after.AngularAcceleration, f);
+    pose->LinearAcceleration    = before.LinearAcceleration.Lerp(after.LinearAcceleration, f);
+    pose->TimeInSeconds         = absoluteTimeSeconds;
+    return true;
+}
+
+} // namespace OVR
+
+
+#include "Kernel/OVR_Threads.h"
+#include "Kernel/OVR_Timer.h"
+#include "Kernel/OVR_Log.h"
+
+namespace OVR { namespace PoseHistoryTest {
+
+// Set for each run; the test itself is short enough to build everywhere.
+int            TestIterations = 10000000;
+const int      NumConsumers   = 3;
+const double   SampleSeconds  = 0.001;
+AtomicInt<int> NumFailures;
+
+volatile int Dummy1;
+int          Unused1[32];
+volatile int Dummy2;
+
+volatile bool  FirstItemWritten = false;
+volatile bool  ProducerDone = false;
+PoseHistory    TestHistory;
+
+// Every field of sample i is a linear function of i, so any interpolated
+// result can be checked exactly against the time it was asked for.
+PoseStatef MakeSample(int i)
+{
+    PoseStatef pose;
+    pose.TimeInSeconds             = i * SampleSeconds;
+    pose.Transform.Orientation     = Quatf(Vector3f(0, 1, 0), (i % 1000) * 0.0001f);
+    pose.Transform.Position        = Vector3f((float)(i % 1000), 0, 0);
+    pose.AngularVelocity           = Vector3f((float)(i % 1000), 1, 2);
+    pose.LinearVelocity            = pose.AngularVelocity;
+    pose.AngularAcceleration       = pose.AngularVelocity;
+    pose.LinearAcceleration        = pose.AngularVelocity;
+    return pose;
+}
+
+
+//-------------------------------------------------------------------------------------
+
+// Consumer threads query random times around the window the producer is writing
+// and check the interpolated result matches what was written.
+class Consumer : public Thread
+{
+    virtual int Run()
+    {
+        LogText("PoseHistoryTest::Consumer::Run started.\n");
+
+        while (!FirstItemWritten)
+        {
+            // spin until producer wrote first value...
+        }
+
+        UInt32 seed      = (UInt32)(UPInt)this;
+        int    numReads  = 0;
+        int    numErrors = 0;
+        UInt64 totalNanos = 0;
+        UInt64 maxNanos   = 0;
+
+        while (!ProducerDone)
+        {
+            PoseStatef latest;
+            if (!TestHistory.GetLatest(&latest))
+            {
+                continue;
+            }
+
+            // Anywhere from the latest sample to 3/4 of the history back.
+            seed = seed * 1664525 + 1013904223;
+            const double t = latest.TimeInSeconds -
+                             (seed >> 8) % (PoseHistory::Capacity * 3 / 4) * SampleSeconds * 0.37;
+
+            PoseStatef pose;
+            const UInt64 start = Timer::GetTicksNanos();
+            const bool   found = TestHistory.GetPoseAtTime(t, &pose);
+            const UInt64 nanos = Timer::GetTicksNanos() - start;
+
+            totalNanos += nanos;
+            maxNanos    = Alg::Max(maxNanos, nanos);
+            numReads++;
+
+            // Position wraps at 1000 samples, so only check inside a period.
+            const double i    = t / SampleSeconds;
+            const int    base = (int)i;
+            if (found && (base % 1000) != 999 && pose.TimeInSeconds == t)
+            {
+                const float expected = (float)(base % 1000) + (float)(i - base);
+                if (fabs(pose.Transform.Position.x - expected) > 0.01f ||
+                    fabs(pose.LinearVelocity.x - expected) > 0.01f ||
+                    fabs(pose.LinearVelocity.y - 1.0f) > 0.0001f)
+                {
+                    if (numErrors++ < 10)
+                    {
+                        LogText("PoseHistoryTest Fail - at %f got %f expected %f\n",
+                                t, pose.Transform.Position.x, expected);
+                    }
+                }
+            }
+            else if (!found && t >= 0.0)
+            {
+                numErrors++;
+            }
+
+            for (int j = 0; j < 100; j++)
+            {
+                Dummy1 = j;
+            }
+        }
+
+        NumFailures += numErrors;
+        LogText("PoseHistoryTest::Consumer - %d reads, %d errors, avg %.2f us, max %.2f us\n",
+                numReads, numErrors, numReads ? totalNanos * 1e-3 / numReads : 0.0, maxNanos * 1e-3);
+        LogText("PoseHistoryTest::Consumer::Run exiting.\n");
+        return 0;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------
+
+class Producer : public Thread
+{
+    virtual int Run()
+    {
+        LogText("PoseHistoryTest::Producer::Run started.\n");
+
+        for (int testVal = 0; testVal < TestIterations; testVal++)
+        {
+            TestHistory.Add(MakeSample(testVal));
+            FirstItemWritten = true;
+
+            // Spin a bit
+            for (int j = 0; j < 200; j++)
+            {
+                Dummy2 = j;
+            }
+
+            if (testVal % (TestIterations/30) == 0)
+            {
+                LogText("PoseHistoryTest::Producer - %5.2f%% done\n",
+                        100.0f * (float)testVal/(float)TestIterations);
+            }
+        }
+
+        ProducerDone = true;
+        LogText("PoseHistoryTest::Producer::Run exiting.\n");
+        return 0;
+    }
+};
+
+
+// Starts a producer and the consumers on an emptied history.
+void StartThreads(int iterations, Ptr<Thread>* threads)
+{
+    TestIterations   = iterations;
+    NumFailures      = 0;
+    FirstItemWritten = false;
+    ProducerDone     = false;
+    TestHistory.Reset();
+
+    threads[0] = *new Producer;
+    for (int i = 1; i <= NumConsumers; i++)
+    {
+        threads[i] = *new Consumer;
+    }
+    for (int i = 0; i <= NumConsumers; i++)
+    {
+        threads[i]->Start();
+    }
+}
+
+} // namespace PoseHistoryTest
+
+
+bool TestPoseHistory(int iterations)
+{
+    Ptr<Thread> threads[PoseHistoryTest::NumConsumers + 1];
+    PoseHistoryTest::StartThreads(iterations, threads);
+    for (int i = 0; i <= PoseHistoryTest::NumConsumers; i++)
+    {
+        while (!threads[i]->IsFinished())
+        {
+            Thread::MSleep(1);
+        }
+    }
+    return PoseHistoryTest::NumFailures == 0;
+}
+
+#ifdef OVR_POSE_HISTORY_TEST
+
+void StartPoseHistoryTest()
+{
+    // These threads will release themselves once done
+    Ptr<Thread> threads[PoseHistoryTest::NumConsumers + 1];
+    PoseHistoryTest::StartThreads(10000000, threads);
+}
+
+#endif // OVR_POSE_HISTORY_TEST
+
+} // namespace OVR
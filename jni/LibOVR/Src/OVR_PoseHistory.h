@@ -0,0 +1,82 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   OVR_PoseHistory.h
+Content     :   Lock-less history of timestamped poses for arbitrary time queries
+Created     :   October 19, 2026
+Notes       :
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+************************************************************************************/
+
+#ifndef OVR_PoseHistory_h
+#define OVR_PoseHistory_h
+
+#include "Kernel/OVR_Atomic.h"
+#include "Kernel/OVR_Allocator.h"
+#include "Kernel/OVR_Lockless.h"
+#include "OVR_SensorFusion.h"
+
+// Define this to compile-in the long PoseHistory stress test
+//#define OVR_POSE_HISTORY_TEST
+
+namespace OVR {
+
+//-------------------------------------------------------------------------------------
+// ***** PoseHistory
+
+// A fixed size ring of the most recent poses, written by a single producer
+// (the sensor thread at up to 1 kHz) and read by any number of consumers
+// without locks. The ring is a deep LocklessUpdater, so a reader that races
+// the writer around the ring simply retries instead of blocking it.
+//
+// Unlike the usual LocklessUpdater, which only keeps a few of the latest
+// states, this allows asking for the pose at the time an eye buffer was rendered.
+class PoseHistory : public NewOverrideBase
+{
+public:
+    enum
+    {
+        Capacity    = 1024,     // about one second of 1 kHz samples
+        // Slots this close to being overwritten are never read, so a reader
+        // only retries if it is preempted for a long time.
+        GuardSlots  = 16
+    };
+
+    PoseHistory();
+
+    // Writer only. Samples must be added in increasing time order.
+    void    Add(const PoseStatef& pose);
+
+    // Writer only. Forgets all samples.
+    void    Reset();
+
+    // Returns false if there are no samples yet.
+    bool    GetLatest(PoseStatef* pose) const;
+
+    // Interpolates between the two samples around absoluteTimeSeconds. Times
+    // older than the history get the oldest sample, and times newer than the
+    // latest sample get the latest sample, which the caller should extrapolate.
+    // Returns false if there are no samples yet.
+    bool    GetPoseAtTime(double absoluteTimeSeconds, PoseStatef* pose) const;
+
+private:
+    bool    getPoseAtTime(double absoluteTimeSeconds, PoseStatef* pose, bool* retry) const;
+
+    // Samples are numbered by their update count, starting from 1.
+    LocklessUpdater<PoseStatef, Capacity>   Poses;
+    AtomicInt<UInt32>                       ValidFrom;  // the update count at the last Reset()
+};
+
+// Runs the stress test for iterations samples and waits for it. Returns
+// false if a reader got a pose that doesn't match what was written.
+bool TestPoseHistory(int iterations);
+
+#ifdef OVR_POSE_HISTORY_TEST
+void StartPoseHistoryTest();
+#endif
+
+} // namespace OVR
+
+#endif // OVR_PoseHistory_h
@@ -11,8 +11,10 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 
 #include "OVR_SensorFusion.h"
+#include "OVR_PoseHistory.h"
 #include "Kernel/OVR_Log.h"
 #include "Kernel/OVR_System.h"
+#include "Kernel/OVR_Trace.h"
 #include "OVR_JSON.h"
 #include "OVR_Profile.h"
 
@@ -40,6 +42,7 @@ SensorFusion::SensorFusion(SensorDevice* sensor) :
    OVR_DEBUG_LOG(("SensorFusion::SensorFusion"));
 
    pHandler = new BodyFrameHandler(this);
+   pHistory = new PoseHistory;
 
    if (sensor) {
 	   AttachToSensor(sensor);
@@ -51,6 +54,7 @@ SensorFusion::SensorFusion(SensorDevice* sensor) :
 SensorFusion::~SensorFusion()
 {
 	delete pHandler;
+	delete pHistory;
 }
 
 
@@ -101,6 +105,7 @@ void SensorFusion::Reset()
     Lock::Locker lockScope(pHandler->GetHandlerLock());
 
     UpdatedState.SetState(StateForPrediction());
+    pHistory->Reset();
     State = PoseStatef();
     Stage = 0;
 
@@ -137,6 +142,8 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
     if (msg.Acceleration == Vector3f::ZERO)
     	return;
 
+    TraceInstant(TRACE_SENSOR, "SensorSample", (SInt64)(msg.TimeDelta * 1e9f));
+
     // Put the sensor readings into convenient local variables
     Vector3f gyro(msg.RotationRate);
     Vector3f accel(msg.Acceleration);
@@ -191,6 +198,7 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
     state.State = State;
     state.Temperature = msg.Temperature;
     UpdatedState.SetState(state);
+    pHistory->Add(State);
 }
 
 // These two functions need to be moved into Quat class
@@ -599,6 +607,30 @@ SensorState SensorFusion::GetPredictionForTime( const double absoluteTimeSeconds
     return sstate;
 }
 
+SensorState SensorFusion::GetStateForTime( const double absoluteTimeSeconds ) const
+{
+    // Anything newer than the last message is predicted as usual. Times older
+    // than the history get the oldest pose rather than a backwards extrapolation.
+    PoseStatef pose;
+    if ( !pHistory->GetLatest( &pose ) || absoluteTimeSeconds >= pose.TimeInSeconds ||
+         !pHistory->GetPoseAtTime( absoluteTimeSeconds, &pose ) )
+    {
+        return GetPredictionForTime( absoluteTimeSeconds );
+    }
+
+    SensorState	sstate;
+    sstate.Status = SensorDataAvailable ? Status_OrientationTracked : 0;
+
+    sstate.Recorded                = pose;
+    sstate.Temperature             = UpdatedState.GetState().Temperature;
+
+    sstate.Predicted               = pose;
+    sstate.Predicted.TimeInSeconds = absoluteTimeSeconds;
+    sstate.Predicted.Transform     = RecenterTransform * pose.Transform;
+
+    return sstate;
+}
+
 SensorFusion::BodyFrameHandler::~BodyFrameHandler()
 {
     RemoveHandlerFromDevices();
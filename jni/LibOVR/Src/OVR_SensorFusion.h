@@ -24,6 +24,8 @@ typedef struct ovrSensorState_ ovrSensorState;
 
 namespace OVR {
 
+class PoseHistory;
+
 double TimeInSeconds();	// JDC
 
 
@@ -170,6 +172,12 @@ public:
     // arrive right before processing, giving a small negative delta in rare cases.
     SensorState  GetPredictionForTime( double absoluteTimeSeconds ) const;
 
+    // Like GetPredictionForTime(), but times before the most recent message are
+    // interpolated from the last second of fused poses instead of extrapolated
+    // backwards, so the pose a frame was actually rendered with can be looked up.
+    // ovrHmd_GetSensorState() uses this.
+    SensorState  GetStateForTime( double absoluteTimeSeconds ) const;
+
     // Resets the current orientation.
     void        Reset();
 
@@ -281,6 +289,9 @@ private:
     // have to worry about being blocked by a sensor thread that got preempted.
     LocklessUpdater<StateForPrediction>	UpdatedState;
 
+    // Every fused pose from about the last second, also readable without locks.
+    PoseHistory*            pHistory;
+
     // The phase of the head as estimated by sensor fusion
 	PoseStatef              State;
     unsigned int            Stage;
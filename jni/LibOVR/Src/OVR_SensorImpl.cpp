@@ -812,7 +812,8 @@ SensorDeviceImpl::SensorDeviceImpl(SensorDeviceCreateDesc* createDesc)
       FullTimestamp(0),
       RealTimeDelta(0.0),
       MaxValidRange(SensorRangeImpl::GetMaxSensorRange()),
-	  pCalibration(NULL)
+	  pCalibration(NULL),
+      pRecorder(NULL)
 {
     SequenceValid  = false;
     LastSampleCount= 0;
@@ -857,6 +858,7 @@ SensorDeviceImpl::~SensorDeviceImpl()
     OVR_ASSERT(!pCreateDesc->pDevice);
 
 	delete pCalibration;
+    delete pRecorder;
 }
 
 // Internal creation APIs.
@@ -981,18 +983,62 @@ void SensorDeviceImpl::Shutdown()
 
 void SensorDeviceImpl::OnInputReport(UByte* pData, UInt32 length)
 {
+    const double now = TimeInSeconds();
 
-    bool processed = false;
-    if (!processed)
-    {
+    // Read once per report so a recording captures exactly what was used.
+    Vector3f phoneMag;
+    Vector3f phoneMagBias;
+    pPhoneSensors->GetLatestUncalibratedMagAndBiasValue(&phoneMag, &phoneMagBias);
+
+    processInputReport(pData, length, now, phoneMag, phoneMagBias);
+}
+
+void SensorDeviceImpl::ReplayInputReport(UByte* pData, UInt32 length, double time,
+                                         const Vector3f& phoneMag, const Vector3f& phoneMagBias)
+{
+    processInputReport(pData, length, time, phoneMag, phoneMagBias);
+}
 
-        TrackerMessage message;
-        if (DecodeTrackerMessage(&message, pData, length))
+void SensorDeviceImpl::processInputReport(UByte* pData, UInt32 length, double now,
+                                          const Vector3f& phoneMag, const Vector3f& phoneMagBias)
+{
+    // Replayed reports are recorded as well, which gives back the log
+    // being replayed.
+    {
+        Lock::Locker lockScope(&RecorderLock);
+        if (pRecorder != NULL)
         {
-            processed = true;
-            onTrackerMessage(&message);
+            pRecorder->WriteReport(now, phoneMag, phoneMagBias, pData, length);
         }
     }
+
+    TrackerMessage message;
+    if (DecodeTrackerMessage(&message, pData, length))
+    {
+        onTrackerMessage(&message, now, phoneMag, phoneMagBias);
+    }
+}
+
+bool SensorDeviceImpl::StartRecording(const char* path)
+{
+    SensorRecorder* recorder = new SensorRecorder();
+    if (!recorder->Open(path))
+    {
+        delete recorder;
+        return false;
+    }
+
+    Lock::Locker lockScope(&RecorderLock);
+    delete pRecorder;
+    pRecorder = recorder;
+    return true;
+}
+
+void SensorDeviceImpl::StopRecording()
+{
+    Lock::Locker lockScope(&RecorderLock);
+    delete pRecorder;
+    pRecorder = NULL;
 }
 
 double SensorDeviceImpl::OnTicks(double tickSeconds)
@@ -1446,7 +1492,8 @@ bool SensorDeviceImpl::getGyroOffsetReport(GyroOffsetReport* data)
 //#define OVR_OLD_TIMING_LOGIC
 
 
-void SensorDeviceImpl::onTrackerMessage(TrackerMessage* message)
+void SensorDeviceImpl::onTrackerMessage(TrackerMessage* message, double now,
+                                        const Vector3f& phoneMag, const Vector3f& phoneMagBias)
 {
     if (message->Type != TrackerMessage_Sensors)
         return;
@@ -1461,7 +1508,6 @@ void SensorDeviceImpl::onTrackerMessage(TrackerMessage* message)
     // Call OnMessage() within a lock to avoid conflicts with handlers.
     Lock::Locker scopeLock(HandlerRef.GetLock());
 
-    const double now                 = TimeInSeconds();    
     double       absoluteTimeSeconds = 0.0;
     
 
@@ -1590,7 +1636,7 @@ void SensorDeviceImpl::onTrackerMessage(TrackerMessage* message)
             sensors.Acceleration  = AccelFromBodyFrameUpdate(s, i, convertHMDToSensor);
             sensors.RotationRate  = EulerFromBodyFrameUpdate(s, i, convertHMDToSensor);
             sensors.MagneticField = MagFromBodyFrameUpdate(s, convertHMDToSensor);
-            replaceWithPhoneMag(&(sensors.MagneticField), &(sensors.MagneticBias));
+            replaceWithPhoneMag(&(sensors.MagneticField), &(sensors.MagneticBias), phoneMag, phoneMagBias);
             sensors.Temperature   = s.Temperature * 0.01f;
 
 			if (pCalibration != NULL)
@@ -1616,17 +1662,17 @@ void SensorDeviceImpl::onTrackerMessage(TrackerMessage* message)
         LastAcceleration  = AccelFromBodyFrameUpdate(s, i, convertHMDToSensor);
         LastRotationRate  = EulerFromBodyFrameUpdate(s, i, convertHMDToSensor);
         LastMagneticField = MagFromBodyFrameUpdate(s, convertHMDToSensor);
-        replaceWithPhoneMag(&LastMagneticField, &LastMagneticBias);
+        replaceWithPhoneMag(&LastMagneticField, &LastMagneticBias, phoneMag, phoneMagBias);
         LastTemperature   = s.Temperature * 0.01f;
     }
 }
 
-void SensorDeviceImpl::replaceWithPhoneMag(Vector3f* mag, Vector3f* bias)
+void SensorDeviceImpl::replaceWithPhoneMag(Vector3f* mag, Vector3f* bias,
+										   const Vector3f& phoneMag, const Vector3f& phoneMagBias)
 {
 
-	Vector3f magPhone;
-	Vector3f biasPhone;
-	pPhoneSensors->GetLatestUncalibratedMagAndBiasValue(&magPhone, &biasPhone);
+	Vector3f magPhone = phoneMag;
+	Vector3f biasPhone = phoneMagBias;
 
 
 	// Phone values are in micro-Tesla. Convert it to Gauss and flip axes.
@@ -14,6 +14,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 #include "OVR_HIDDeviceImpl.h"
 #include "OVR_SensorTimeFilter.h"
+#include "OVR_SensorRecorder.h"
 #include "OVR_SensorCalibration.h"
 
 #include "OVR_PhoneSensors.h"
@@ -227,6 +228,14 @@ public:
     virtual bool        GetAllTemperatureReports(Array<Array<TemperatureReport> >*);
 
     virtual bool        GetGyroOffsetReport(GyroOffsetReport* data);	
+
+    virtual bool        StartRecording(const char* path);
+    virtual void        StopRecording();
+
+    // Processes a recorded input report as if it had just arrived from the device,
+    // with the recorded time and phone magnetometer in place of the live ones.
+    void                ReplayInputReport(UByte* pData, UInt32 length, double time,
+                                          const Vector3f& phoneMag, const Vector3f& phoneMagBias);
 	
     // Hack to create HMD device from sensor display info.
     static void EnumerateHMDFromSensorDisplayInfo(const SensorDisplayInfoImpl& displayInfo, 
@@ -255,10 +264,16 @@ protected:
 
     bool    getGyroOffsetReport(GyroOffsetReport* data);	
 	
+    // Records an input report if recording, decodes it and passes it to onTrackerMessage.
+    void    processInputReport(UByte* pData, UInt32 length, double now,
+                               const Vector3f& phoneMag, const Vector3f& phoneMagBias);
+
     // Called for decoded messages
-    void    onTrackerMessage(TrackerMessage* message);
+    void    onTrackerMessage(TrackerMessage* message, double now,
+                             const Vector3f& phoneMag, const Vector3f& phoneMagBias);
 
-	void	replaceWithPhoneMag(Vector3f* mag, Vector3f* bias);
+	void	replaceWithPhoneMag(Vector3f* mag, Vector3f* bias,
+							const Vector3f& phoneMag, const Vector3f& phoneMagBias);
 
     // Helpers to reduce casting.
 /*
@@ -309,6 +324,11 @@ protected:
     PhoneSensors* 		pPhoneSensors;
 	
 	SensorCalibration* 	pCalibration;
+
+    // Set while recording; guarded by RecorderLock since recording is started
+    // and stopped from outside the device manager thread.
+    SensorRecorder*     pRecorder;
+    Lock                RecorderLock;
 };
 
 
@@ -0,0 +1,450 @@
+/************************************************************************************
+
+Filename    :   OVR_SensorRecorder.cpp
+Content     :   Recording raw tracker input reports and replaying them offline
+Created     :   October 19, 2026
+Notes       :
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+************************************************************************************/
+
+#include "OVR_SensorRecorder.h"
+#include "OVR_SensorImpl.h"
+#include "Kernel/OVR_Timer.h"
+#include "Kernel/OVR_Log.h"
+#include "Kernel/OVR_String.h"
+
+#include <stdio.h>
+
+namespace OVR {
+
+static const char SensorLogMagic[8] = "OVRSLOG";
+
+//-------------------------------------------------------------------------------------
+// ***** SensorRecorder
+
+SensorRecorder::SensorRecorder() :
+    Started(false),
+    StartTime(0.0),
+    LastMicros(0),
+    NumReports(0)
+{
+}
+
+SensorRecorder::~SensorRecorder()
+{
+    Close();
+}
+
+bool SensorRecorder::Open(const char* path)
+{
+    Close();
+
+    if (!LogFile.Open(path, File::Open_Write | File::Open_Create | File::Open_Truncate | File::Open_Buffered,
+                   File::Mode_ReadWrite))
+    {
+        LogText("OVR::SensorRecorder - failed to open '%s'\n", path);
+        return false;
+    }
+
+    Started    = false;
+    NumReports = 0;
+    LogText("OVR::SensorRecorder - recording to '%s'\n", path);
+    return true;
+}
+
+void SensorRecorder::Close()
+{
+    if (LogFile.IsValid())
+    {
+        LogFile.Close();
+        LogText("OVR::SensorRecorder - closed after %d reports\n", NumReports);
+    }
+}
+
+void SensorRecorder::WriteReport(double time, const Vector3f& phoneMag, const Vector3f& phoneMagBias,
+                                 const UByte* data, UInt32 length)
+{
+    if (!LogFile.IsValid() || length > 255)
+        return;
+
+    // The header is written with the first report so StartTime is the time of a
+    // real sample, and every later time is a positive delta from it.
+    if (!Started)
+    {
+        SensorLogHeader header;
+        memcpy(header.Magic, SensorLogMagic, sizeof(header.Magic));
+        header.Version   = SensorLog_Version;
+        header.Reserved  = 0;
+        header.StartTime = time;
+        LogFile.Write((const UByte*)&header, sizeof(header));
+
+        Started    = true;
+        StartTime  = time;
+        LastMicros = 0;
+        LastPhoneMag     = Vector3f(0.0f);
+        LastPhoneMagBias = Vector3f(0.0f);
+    }
+
+    // Deltas are taken between quantized times so rounding never accumulates.
+    const double seconds = time - StartTime;
+    UInt64 micros = (seconds > 0.0) ? (UInt64)(seconds * 1000000.0 + 0.5) : 0;
+    if (micros < LastMicros)
+        micros = LastMicros;
+    const UInt32 deltaMicros = (UInt32)(micros - LastMicros);
+    LastMicros = micros;
+
+    UByte flags = 0;
+    if (NumReports == 0 || phoneMag != LastPhoneMag || phoneMagBias != LastPhoneMagBias)
+    {
+        flags |= SensorLog_PhoneMag;
+        LastPhoneMag     = phoneMag;
+        LastPhoneMagBias = phoneMagBias;
+    }
+
+    UByte recordHeader[6];
+    recordHeader[0] = (UByte)length;
+    recordHeader[1] = flags;
+    memcpy(recordHeader + 2, &deltaMicros, sizeof(deltaMicros));
+    LogFile.Write(recordHeader, sizeof(recordHeader));
+
+    if (flags & SensorLog_PhoneMag)
+    {
+        const float mag[6] = { phoneMag.x, phoneMag.y, phoneMag.z,
+                               phoneMagBias.x, phoneMagBias.y, phoneMagBias.z };
+        LogFile.Write((const UByte*)mag, sizeof(mag));
+    }
+
+    LogFile.Write(data, length);
+    NumReports++;
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorLogReader
+
+SensorLogReader::SensorLogReader() :
+    Offset(0),
+    StartTime(0.0),
+    Micros(0)
+{
+}
+
+bool SensorLogReader::Open(const char* path)
+{
+    Data.Clear();
+    Offset = 0;
+
+    SysFile f;
+    if (!f.Open(path, File::Open_Read, File::Mode_Read))
+    {
+        LogText("OVR::SensorLogReader - failed to open '%s'\n", path);
+        return false;
+    }
+
+    const int size = f.GetLength();
+    if (size < (int)sizeof(SensorLogHeader))
+    {
+        LogText("OVR::SensorLogReader - '%s' is too short\n", path);
+        return false;
+    }
+    Data.Resize(size);
+    const int bytes = f.Read(&Data[0], size);
+    f.Close();
+    if (bytes != size)
+    {
+        LogText("OVR::SensorLogReader - failed to read '%s'\n", path);
+        Data.Clear();
+        return false;
+    }
+
+    SensorLogHeader header;
+    memcpy(&header, &Data[0], sizeof(header));
+    if (memcmp(header.Magic, SensorLogMagic, sizeof(header.Magic)) != 0 ||
+        header.Version != SensorLog_Version)
+    {
+        LogText("OVR::SensorLogReader - '%s' is not a version %d sensor log\n", path, SensorLog_Version);
+        Data.Clear();
+        return false;
+    }
+
+    StartTime = header.StartTime;
+    Rewind();
+    return true;
+}
+
+void SensorLogReader::Rewind()
+{
+    Offset       = sizeof(SensorLogHeader);
+    Micros       = 0;
+    PhoneMag     = Vector3f(0.0f);
+    PhoneMagBias = Vector3f(0.0f);
+}
+
+bool SensorLogReader::ReadRecord(SensorLogRecord* record)
+{
+    const int size = (int)Data.GetSize();
+    if (Offset + 6 > size)
+        return false;
+
+    const UByte* p     = &Data[Offset];
+    const UInt32 length = p[0];
+    const UByte  flags  = p[1];
+    UInt32 deltaMicros;
+    memcpy(&deltaMicros, p + 2, sizeof(deltaMicros));
+
+    const int magBytes = (flags & SensorLog_PhoneMag) ? 6 * sizeof(float) : 0;
+    if (Offset + 6 + magBytes + (int)length > size)
+        return false;
+
+    Offset += 6;
+    if (magBytes)
+    {
+        float mag[6];
+        memcpy(mag, &Data[Offset], sizeof(mag));
+        PhoneMag     = Vector3f(mag[0], mag[1], mag[2]);
+        PhoneMagBias = Vector3f(mag[3], mag[4], mag[5]);
+        Offset += magBytes;
+    }
+
+    Micros += deltaMicros;
+    record->Time         = StartTime + Micros * 0.000001;
+    record->PhoneMag     = PhoneMag;
+    record->PhoneMagBias = PhoneMagBias;
+    record->Length       = length;
+    memcpy(record->Data, &Data[Offset], length);
+    Offset += length;
+    return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorReplay
+
+// Counts the messages the sensor device emits on their way to fusion.
+class SensorReplayHandler : public MessageHandler
+{
+public:
+    SensorReplayHandler(SensorFusion* fusion) : pFusion(fusion), NumMessages(0) { }
+    ~SensorReplayHandler() { RemoveHandlerFromDevices(); }
+
+    virtual void OnMessage(const Message& msg)
+    {
+        if (msg.Type == Message_BodyFrame)
+        {
+            NumMessages++;
+            pFusion->OnMessage(static_cast<const MessageBodyFrame&>(msg));
+        }
+    }
+    virtual bool SupportsMessageType(MessageType type) const
+    {
+        return type == Message_BodyFrame;
+    }
+
+    SensorFusion*   pFusion;
+    int             NumMessages;
+};
+
+SensorReplay::SensorReplay() :
+    pDevice(NULL)
+{
+    // A sensor device that is never initialized, so it has no HID device
+    // behind it. The zero vendor / product id also leaves it without a
+    // temperature calibration, which needs feature reports from hardware.
+    HIDDeviceDesc hidDesc;
+    hidDesc.VendorId      = 0;
+    hidDesc.ProductId     = 0;
+    hidDesc.VersionNumber = 0;
+    hidDesc.Usage         = 0;
+    hidDesc.UsagePage     = 0;
+    hidDesc.Product       = "Sensor Replay";
+
+    // There is no manager to share a lock with, so the description gets its
+    // own. The device holds the only reference, and deletes the description
+    // along with itself.
+    SensorDeviceCreateDesc* createDesc = new SensorDeviceCreateDesc(&SensorDeviceFactory::GetInstance(), hidDesc);
+    createDesc->pLock = *new DeviceManagerLock;
+    pDevice = new SensorDeviceImpl(createDesc);
+}
+
+SensorReplay::~SensorReplay()
+{
+    pDevice->SetMessageHandler(NULL);
+    // Not Release()'d, since that hands the device to a manager thread it never had.
+    delete pDevice;
+}
+
+bool SensorReplay::Open(const char* path)
+{
+    return Reader.Open(path);
+}
+
+bool SensorReplay::Run(SensorFusion& fusion, Stats* stats, double poseIntervalSeconds)
+{
+    Stats runStats;
+
+    fusion.Reset();
+    SensorReplayHandler handler(&fusion);
+    pDevice->SetMessageHandler(&handler);
+
+    Reader.Rewind();
+
+    SensorLogRecord record;
+    double firstTime = 0.0;
+    double lastTime  = 0.0;
+    double nextPoseTime = 0.0;
+    const double start = Timer::GetSeconds();
+
+    while (Reader.ReadRecord(&record))
+    {
+        if (runStats.NumReports == 0)
+        {
+            firstTime    = record.Time;
+            nextPoseTime = record.Time;
+        }
+        lastTime = record.Time;
+
+        pDevice->ReplayInputReport(record.Data, record.Length, record.Time,
+                                   record.PhoneMag, record.PhoneMagBias);
+        runStats.NumReports++;
+
+        if (poseIntervalSeconds > 0.0 && record.Time >= nextPoseTime)
+        {
+            const SensorState state = fusion.GetPredictionForTime(record.Time);
+            const Quatf& q = state.Recorded.Transform.Orientation;
+            LogText("OVR::SensorReplay - %.4f %f %f %f %f\n", record.Time - firstTime, q.x, q.y, q.z, q.w);
+            nextPoseTime += poseIntervalSeconds;
+        }
+    }
+
+    runStats.ElapsedSeconds = Timer::GetSeconds() - start;
+    runStats.LogSeconds     = lastTime - firstTime;
+    runStats.NumMessages    = handler.NumMessages;
+    runStats.FinalPose      = fusion.GetPredictionForTime(lastTime).Recorded;
+
+    pDevice->SetMessageHandler(NULL);
+
+    LogText("OVR::SensorReplay - %d reports, %d messages, %.2f s of log in %.3f s (%.0f messages/s)\n",
+            runStats.NumReports, runStats.NumMessages, runStats.LogSeconds, runStats.ElapsedSeconds,
+            runStats.ElapsedSeconds > 0.0 ? runStats.NumMessages / runStats.ElapsedSeconds : 0.0);
+
+    if (stats != NULL)
+    {
+        *stats = runStats;
+    }
+    return runStats.NumReports > 0;
+}
+
+bool SensorReplay::StartRecording(const char* path)
+{
+    return pDevice->StartRecording(path);
+}
+
+void SensorReplay::StopRecording()
+{
+    pDevice->StopRecording();
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorReplay::Test
+
+void PackSensor(UByte* buffer, SInt32 x, SInt32 y, SInt32 z);
+
+// A tracker sensors report with one sample of a slow rotation, in the
+// layout DecodeTrackerMessage reads.
+static void SyntheticTrackerReport(UByte* report, int sample)
+{
+    memset(report, 0, 62);
+    report[0] = 1;      // TrackerMessage_Sensors
+    report[1] = 1;      // SampleCount
+    report[2] = UByte(sample);
+    report[3] = UByte(sample >> 8);
+    report[6] = UByte(2500);        // temperature, centidegrees
+    report[7] = UByte(2500 >> 8);
+    // Gravity along y and a slow rotation about it, in the tracker's units
+    // of 1e-4 m/s^2 and 1e-4 rad/s.
+    PackSensor(report + 8,  (sample % 7) - 3, 98000, (sample % 5) - 2);
+    PackSensor(report + 16, 0, 5000 + (sample % 100), 0);
+    const SInt16 mag[3] = { 300, SInt16(-200 + (sample % 11)), 100 };
+    memcpy(report + 56, mag, sizeof(mag));
+}
+
+static bool ReadWholeFile(const char* path, Array<UByte>& data)
+{
+    SysFile f;
+    if (!f.Open(path, File::Open_Read, File::Mode_Read))
+        return false;
+    data.Resize(f.GetLength());
+    const bool ok = data.GetSize() == 0 || f.Read(&data[0], (int)data.GetSize()) == (int)data.GetSize();
+    f.Close();
+    return ok;
+}
+
+bool SensorReplay::Test(const char* directory)
+{
+    const int numReports = 10000;
+    int numErrors = 0;
+
+    const String recordedPath = String(directory) + "sensor_test.log";
+    const String replayedPath = String(directory) + "sensor_test_replay.log";
+
+    // A 1 kHz sensor with some jitter in the arrival times, and a phone
+    // magnetometer that changes now and then.
+    {
+        SensorRecorder recorder;
+        if (!recorder.Open(recordedPath.ToCStr()))
+            return false;
+        UByte report[62];
+        for (int i = 0; i < numReports; i++)
+        {
+            SyntheticTrackerReport(report, i);
+            const double time = 1000.0 + i * 0.001 + (i % 3) * 0.0001;
+            const Vector3f phoneMag(20.0f, -(float)(i / 1000), 5.0f);
+            recorder.WriteReport(time, phoneMag, Vector3f(0.5f, 0.0f, 0.0f), report, sizeof(report));
+        }
+        recorder.Close();
+    }
+
+    SensorFusion fusion;
+    Stats stats;
+    {
+        SensorReplay replay;
+        if (!replay.Open(recordedPath.ToCStr()) || !replay.StartRecording(replayedPath.ToCStr()))
+            return false;
+        replay.Run(fusion, &stats);
+        replay.StopRecording();
+    }
+
+    if (stats.NumReports != numReports || stats.NumMessages != numReports)
+    {
+        LogText("SensorReplay::Test: %d reports and %d messages replayed, expected %d\n",
+                stats.NumReports, stats.NumMessages, numReports);
+        numErrors++;
+    }
+
+    Array<UByte> recorded;
+    Array<UByte> replayed;
+    if (!ReadWholeFile(recordedPath.ToCStr(), recorded) || !ReadWholeFile(replayedPath.ToCStr(), replayed))
+    {
+        LogText("SensorReplay::Test: couldn't read the logs back\n");
+        numErrors++;
+    }
+    else if (recorded.GetSize() != replayed.GetSize() ||
+             memcmp(&recorded[0], &replayed[0], recorded.GetSize()) != 0)
+    {
+        LogText("SensorReplay::Test: the replayed log (%d bytes) differs from the recorded one (%d bytes)\n",
+                (int)replayed.GetSize(), (int)recorded.GetSize());
+        numErrors++;
+    }
+
+    LogText("SensorReplay::Test: %d reports in %d bytes, %.0f messages/s\n", numReports, (int)recorded.GetSize(),
+            stats.ElapsedSeconds > 0.0 ? stats.NumMessages / stats.ElapsedSeconds : 0.0);
+
+    remove(recordedPath.ToCStr());
+    remove(replayedPath.ToCStr());
+    return numErrors == 0;
+}
+
+} // namespace OVR
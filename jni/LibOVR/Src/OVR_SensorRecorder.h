@@ -0,0 +1,168 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   OVR_SensorRecorder.h
+Content     :   Recording raw tracker input reports and replaying them offline
+Created     :   October 19, 2026
+Notes       :
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+************************************************************************************/
+
+#ifndef OVR_SensorRecorder_h
+#define OVR_SensorRecorder_h
+
+#include "Kernel/OVR_Types.h"
+#include "Kernel/OVR_Array.h"
+#include "Kernel/OVR_Math.h"
+#include "Kernel/OVR_SysFile.h"
+#include "OVR_SensorFusion.h"
+
+namespace OVR {
+
+class SensorDeviceImpl;
+
+//-------------------------------------------------------------------------------------
+// ***** Sensor log format
+//
+// A log starts with a SensorLogHeader, followed by one record per input report:
+//
+//   UByte   Length          - bytes of report data
+//   UByte   Flags           - SensorLog_PhoneMag if the phone magnetometer changed
+//   UInt32  DeltaMicros     - time since the previous record (or StartTime)
+//   float   PhoneMag[3]     - only present with SensorLog_PhoneMag
+//   float   PhoneMagBias[3] - only present with SensorLog_PhoneMag
+//   UByte   Data[Length]    - the raw HID input report
+//
+// Values are stored little endian, as written by the device.
+
+enum
+{
+    SensorLog_Version  = 1,
+    SensorLog_PhoneMag = 0x01
+};
+
+struct SensorLogHeader
+{
+    char    Magic[8];       // "OVRSLOG"
+    UInt32  Version;
+    UInt32  Reserved;
+    double  StartTime;      // system time of the first record
+};
+
+struct SensorLogRecord
+{
+    double      Time;
+    Vector3f    PhoneMag;       // uncalibrated, micro-Tesla, as read from the phone
+    Vector3f    PhoneMagBias;
+    UInt32      Length;
+    UByte       Data[256];
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorRecorder
+
+// Writes input reports to a log. Called on the device manager thread, so
+// the file is buffered and never flushed between reports.
+class SensorRecorder : public NewOverrideBase
+{
+public:
+    SensorRecorder();
+    ~SensorRecorder();
+
+    bool    Open(const char* path);
+    void    Close();
+
+    void    WriteReport(double time, const Vector3f& phoneMag, const Vector3f& phoneMagBias,
+                        const UByte* data, UInt32 length);
+
+    int     GetNumReports() const { return NumReports; }
+
+private:
+    SysFile     LogFile;
+    bool        Started;
+    double      StartTime;
+    UInt64      LastMicros;
+    Vector3f    LastPhoneMag;
+    Vector3f    LastPhoneMagBias;
+    int         NumReports;
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorLogReader
+
+// Loads a whole log into memory so replay speed isn't bound by file reads.
+class SensorLogReader : public NewOverrideBase
+{
+public:
+    SensorLogReader();
+
+    bool    Open(const char* path);
+
+    // Returns false at the end of the log, or if the rest of it is truncated.
+    bool    ReadRecord(SensorLogRecord* record);
+
+    void    Rewind();
+
+private:
+    Array<UByte>    Data;
+    int             Offset;
+    double          StartTime;
+    UInt64          Micros;
+    Vector3f        PhoneMag;
+    Vector3f        PhoneMagBias;
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorReplay
+
+// Pushes a recorded log through the same DecodeTrackerMessage / SensorTimeFilter /
+// SensorFusion path a live sensor uses, as fast as possible. The recorded report
+// times are used in place of the system clock, so a replay is deterministic and
+// can be compared between fusion changes.
+class SensorReplay : public NewOverrideBase
+{
+public:
+    struct Stats
+    {
+        Stats() : NumReports(0), NumMessages(0), ElapsedSeconds(0.0), LogSeconds(0.0) { }
+
+        int         NumReports;
+        int         NumMessages;        // MessageBodyFrame messages delivered to fusion
+        double      ElapsedSeconds;     // wall time spent replaying
+        double      LogSeconds;         // time covered by the log
+        PoseStatef  FinalPose;          // fusion output after the last report
+    };
+
+    SensorReplay();
+    ~SensorReplay();
+
+    bool    Open(const char* path);
+
+    // Replays the whole log into fusion, which is reset first and must not be
+    // attached to a sensor. If poseIntervalSeconds > 0, the fusion pose is logged
+    // at that interval of log time so the output can be diffed between runs.
+    bool    Run(SensorFusion& fusion, Stats* stats, double poseIntervalSeconds = 0.0);
+
+    // Records the reports as they are replayed, which should give back the
+    // log being replayed byte for byte.
+    bool    StartRecording(const char* path);
+    void    StopRecording();
+
+    // Records synthetic reports to a log in directory, which must end in a
+    // slash, replays it while recording the replay, and checks that the two
+    // logs are identical and every report reached fusion. Logs messages/s.
+    static bool Test(const char* directory);
+
+private:
+    SensorLogReader     Reader;
+    SensorDeviceImpl*   pDevice;
+};
+
+} // namespace OVR
+
+#endif // OVR_SensorRecorder_h
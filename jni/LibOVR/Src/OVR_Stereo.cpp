@@ -11,6 +11,14 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 #include "OVR_Stereo.h"
 #include "OVR_Profile.h"
+#include "Kernel/OVR_Timer.h"
+#include "Kernel/OVR_Log.h"
+
+#if defined(OVR_CPU_ARM_NEON)
+#include <arm_neon.h>
+#elif defined(OVR_CPU_SSE)
+#include <xmmintrin.h>
+#endif
 
 namespace OVR {
 
@@ -160,25 +168,153 @@ Vector3f LensConfig::DistortionFnScaleRadiusSquaredChroma (float rsq) const
     return scaleRGB;
 }
 
-// DistortionFnInverse computes the inverse of the distortion function on an argument.
-float LensConfig::DistortionFnInverse(float r) const
-{    
-    OVR_ASSERT((r <= 20.0f));
+// Batched DistortionFnScaleRadiusSquared.
+void LensConfig::DistortionFnScaleRadiusSquaredBatch (const float* rsq, float* scale, int count) const
+{
+    // Local copies, so the compiler knows writing scale[] can't change them.
+    const float k0 = K[0];
+    const float k1 = K[1];
+    const float k2 = K[2];
+    const float k3 = K[3];
+
+    switch ( Eqn )
+    {
+    case Distortion_Poly4:
+    case Distortion_RecipPoly4: {
+        const bool reciprocal = ( Eqn == Distortion_RecipPoly4 );
+        int i = 0;
+
+        // Four radii at a time. The polynomial is summed in the same order as the
+        // scalar code, and neither NEON VMLA nor SSE fuse the multiply and add, so
+        // it matches exactly. NEON has no divide, so its reciprocal is an estimate
+        // refined with two Newton-Raphson steps, good to about one ulp.
+#if defined(OVR_CPU_ARM_NEON)
+        const float32x4_t vk0 = vdupq_n_f32 ( k0 );
+        const float32x4_t vk1 = vdupq_n_f32 ( k1 );
+        const float32x4_t vk2 = vdupq_n_f32 ( k2 );
+        const float32x4_t vk3 = vdupq_n_f32 ( k3 );
+        for ( ; i + 4 <= count; i += 4 )
+        {
+            const float32x4_t r2 = vld1q_f32 ( rsq + i );
+            float32x4_t p = vmlaq_f32 ( vk2, r2, vk3 );
+            p = vmlaq_f32 ( vk1, r2, p );
+            p = vmlaq_f32 ( vk0, r2, p );
+            if ( reciprocal )
+            {
+                float32x4_t e = vrecpeq_f32 ( p );
+                e = vmulq_f32 ( e, vrecpsq_f32 ( p, e ) );
+                e = vmulq_f32 ( e, vrecpsq_f32 ( p, e ) );
+                p = e;
+            }
+            vst1q_f32 ( scale + i, p );
+        }
+#elif defined(OVR_CPU_SSE)
+        const __m128 vk0 = _mm_set1_ps ( k0 );
+        const __m128 vk1 = _mm_set1_ps ( k1 );
+        const __m128 vk2 = _mm_set1_ps ( k2 );
+        const __m128 vk3 = _mm_set1_ps ( k3 );
+        for ( ; i + 4 <= count; i += 4 )
+        {
+            const __m128 r2 = _mm_loadu_ps ( rsq + i );
+            __m128 p = _mm_add_ps ( vk2, _mm_mul_ps ( r2, vk3 ) );
+            p = _mm_add_ps ( vk1, _mm_mul_ps ( r2, p ) );
+            p = _mm_add_ps ( vk0, _mm_mul_ps ( r2, p ) );
+            if ( reciprocal )
+            {
+                p = _mm_div_ps ( _mm_set1_ps ( 1.0f ), p );
+            }
+            _mm_storeu_ps ( scale + i, p );
+        }
+#endif
+        for ( ; i < count; i++ )
+        {
+            const float r2 = rsq[i];
+            const float p = ( k0 + r2 * ( k1 + r2 * ( k2 + r2 * k3 ) ) );
+            scale[i] = reciprocal ? 1.0f / p : p;
+        }
+        } break;
+    case Distortion_CatmullRom10:
+    case Distortion_CatmullRom20: {
+        const int NumSegments = ( Eqn == Distortion_CatmullRom10 ) ? 11 : 21;
+        OVR_ASSERT ( NumSegments <= MaxCoefficients );
+        const float rsqToSegments = (float)(NumSegments-1) / ( MaxR * MaxR );
+        for ( int i = 0; i < count; i++ )
+        {
+            scale[i] = EvalCatmullRomSpline ( K, rsq[i] * rsqToSegments, NumSegments );
+        }
+        } break;
+
+    default:
+        OVR_ASSERT ( false );
+        for ( int i = 0; i < count; i++ )
+        {
+            scale[i] = 1.0f;
+        }
+        break;
+    }
+}
+
+// Batched DistortionFnScaleRadiusSquaredChroma.
+void LensConfig::DistortionFnScaleRadiusSquaredChromaBatch (const float* rsq, Vector3f* scaleRGB, int count) const
+{
+    const float redConstant  = 1.0f + ChromaticAberration[0];
+    const float redRsq       = ChromaticAberration[1];
+    const float blueConstant = 1.0f + ChromaticAberration[2];
+    const float blueRsq      = ChromaticAberration[3];
+
+    const int BlockSize = 64;
+    float scale[BlockSize];
+    for ( int base = 0; base < count; base += BlockSize )
+    {
+        const int n = Alg::Min ( count - base, BlockSize );
+        DistortionFnScaleRadiusSquaredBatch ( rsq + base, scale, n );
+        int i = 0;
+#if defined(OVR_CPU_ARM_NEON)
+        // VST3 interleaves the channels straight into the Vector3f array.
+        const float32x4_t vRedConstant  = vdupq_n_f32 ( redConstant );
+        const float32x4_t vRedRsq       = vdupq_n_f32 ( redRsq );
+        const float32x4_t vBlueConstant = vdupq_n_f32 ( blueConstant );
+        const float32x4_t vBlueRsq      = vdupq_n_f32 ( blueRsq );
+        for ( ; i + 4 <= n; i += 4 )
+        {
+            const float32x4_t r2 = vld1q_f32 ( rsq + base + i );
+            const float32x4_t s  = vld1q_f32 ( scale + i );
+            float32x4x3_t rgb;
+            rgb.val[0] = vmulq_f32 ( s, vmlaq_f32 ( vRedConstant, r2, vRedRsq ) );
+            rgb.val[1] = s;
+            rgb.val[2] = vmulq_f32 ( s, vmlaq_f32 ( vBlueConstant, r2, vBlueRsq ) );
+            vst3q_f32 ( &scaleRGB[base + i].x, rgb );
+        }
+#endif
+        for ( ; i < n; i++ )
+        {
+            const float r2 = rsq[base + i];
+            scaleRGB[base + i].x = scale[i] * ( redConstant + r2 * redRsq );     // Red
+            scaleRGB[base + i].y = scale[i];                                     // Green
+            scaleRGB[base + i].z = scale[i] * ( blueConstant + r2 * blueRsq );   // Blue
+        }
+    }
+}
 
+// The original step-halving search for the inverse. It makes no assumptions about
+// the shape of the curve, so it is kept for the rare lens that DistortionFnInverse
+// can't bracket.
+static float DistortionFnInverseSearch ( const LensConfig& lens, float r )
+{
     float s, d;
     float delta = r * 0.25f;
 
     // Better to start guessing too low & take longer to converge than too high
     // and hit singularities. Empirically, r * 0.5f is too high in some cases.
     s = r * 0.25f;
-    d = fabs(r - DistortionFn(s));
+    d = fabs(r - lens.DistortionFn(s));
 
     for (int i = 0; i < 20; i++)
     {
         float sUp   = s + delta;
         float sDown = s - delta;
-        float dUp   = fabs(r - DistortionFn(sUp));
-        float dDown = fabs(r - DistortionFn(sDown));
+        float dUp   = fabs(r - lens.DistortionFn(sUp));
+        float dDown = fabs(r - lens.DistortionFn(sDown));
 
         if (dUp < d)
         {
@@ -199,6 +335,86 @@ float LensConfig::DistortionFnInverse(float r) const
     return s;
 }
 
+// DistortionFnInverse computes the inverse of the distortion function on an argument.
+// The root is bracketed between zero and a radius that distorts past r, then refined
+// by false position, halving the weight of an end that is kept twice in a row (the
+// Illinois method). That converges in a handful of evaluations, where the search
+// above always takes 41.
+float LensConfig::DistortionFnInverse(float r) const
+{    
+    OVR_ASSERT((r <= 20.0f));
+
+    if ( r < 0.0f )
+    {
+        return -DistortionFnInverse ( -r );
+    }
+    if ( r == 0.0f )
+    {
+        return 0.0f;
+    }
+
+    // DistortionFn(0) is 0, so only the upper end needs to be found.
+    float lo  = 0.0f;
+    float fLo = -r;
+    float hi  = r;
+    float fHi = DistortionFn ( hi ) - r;
+    for ( int i = 0; i < 8 && fHi < 0.0f; i++ )
+    {
+        lo  = hi;
+        fLo = fHi;
+        hi *= 2.0f;
+        fHi = DistortionFn ( hi ) - r;
+    }
+    // Also catches NaN and infinity from a singular RecipPoly4.
+    if ( !( fHi >= 0.0f && fHi < 1e10f ) )
+    {
+        return DistortionFnInverseSearch ( *this, r );
+    }
+
+    const float tolerance = r * 1e-6f;
+    float s = hi;
+    int   side = 0;
+    for ( int i = 0; i < 32; i++ )
+    {
+        s = ( lo * fHi - hi * fLo ) / ( fHi - fLo );
+        const float fs = DistortionFn ( s ) - r;
+        if ( fabsf ( fs ) <= tolerance || hi - lo <= tolerance )
+        {
+            break;
+        }
+        if ( fs > 0.0f )
+        {
+            hi  = s;
+            fHi = fs;
+            if ( side > 0 )
+            {
+                fLo *= 0.5f;
+            }
+            side = 1;
+        }
+        else
+        {
+            lo  = s;
+            fLo = fs;
+            if ( side < 0 )
+            {
+                fHi *= 0.5f;
+            }
+            side = -1;
+        }
+    }
+
+    return s;
+}
+
+void LensConfig::DistortionFnInverseBatch (const float* r, float* inverse, int count) const
+{
+    for ( int i = 0; i < count; i++ )
+    {
+        inverse[i] = DistortionFnInverse ( r[i] );
+    }
+}
+
 
 
 float LensConfig::DistortionFnInverseApprox(float r) const
@@ -1771,12 +1987,23 @@ FovPort GetPhysicalScreenFov ( StereoEye eyeType, DistortionRenderDesc const &di
             result.LeftTan  = 0.0f;
             result.RightTan = 0.0f;
 
+            const int MaxSteps = 64;
+            OVR_ASSERT ( numSteps <= MaxSteps );
+            numSteps = Alg::Min ( numSteps, MaxSteps );
+
+            Vector2f samples[MaxSteps];
+            Vector2f tanEyeAngles[MaxSteps];
             float stepScale = 1.0f / ( numSteps - 1 );
             for ( int step = 0; step < numSteps; step++ )
             {
                 float    lerpFactor  = stepScale * (float)step;
-                Vector2f sample      = from + (to - from) * lerpFactor;
-                Vector2f tanEyeAngle = TransformScreenNDCToTanFovSpace ( distortion, sample );
+                samples[step]        = from + (to - from) * lerpFactor;
+            }
+            TransformScreenNDCToTanFovSpaceBatch ( tanEyeAngles, distortion, samples, numSteps );
+
+            for ( int step = 0; step < numSteps; step++ )
+            {
+                Vector2f const &tanEyeAngle = tanEyeAngles[step];
 
                 result.LeftTan  = Alg::Max ( result.LeftTan,  -tanEyeAngle.x );
                 result.RightTan = Alg::Max ( result.RightTan,  tanEyeAngle.x );
@@ -2033,6 +2260,34 @@ Vector2f TransformScreenNDCToTanFovSpace( DistortionRenderDesc const &distortion
     return tanEyeAngle;
 }
 
+// Same, for a whole array of points.
+void TransformScreenNDCToTanFovSpaceBatch ( Vector2f *tanEyeAngles, DistortionRenderDesc const &distortion,
+                                            const Vector2f *framebufferNDCs, int count )
+{
+    const int BlockSize = 64;
+    float radiusSquared[BlockSize];
+    float distortionScale[BlockSize];
+    for ( int base = 0; base < count; base += BlockSize )
+    {
+        const int n = Alg::Min ( count - base, BlockSize );
+        // Scale to TanHalfFov space, but still distorted.
+        for ( int i = 0; i < n; i++ )
+        {
+            Vector2f &tanEyeAngleDistorted = tanEyeAngles[base + i];
+            tanEyeAngleDistorted.x = ( framebufferNDCs[base + i].x - distortion.LensCenter.x ) * distortion.TanEyeAngleScale.x;
+            tanEyeAngleDistorted.y = ( framebufferNDCs[base + i].y - distortion.LensCenter.y ) * distortion.TanEyeAngleScale.y;
+            radiusSquared[i] = ( tanEyeAngleDistorted.x * tanEyeAngleDistorted.x )
+                             + ( tanEyeAngleDistorted.y * tanEyeAngleDistorted.y );
+        }
+        // Distort.
+        distortion.Lens.DistortionFnScaleRadiusSquaredBatch ( radiusSquared, distortionScale, n );
+        for ( int i = 0; i < n; i++ )
+        {
+            tanEyeAngles[base + i] *= distortionScale[i];
+        }
+    }
+}
+
 // Same, with chromatic aberration correction.
 void TransformScreenNDCToTanFovSpaceChroma ( Vector2f *resultR, Vector2f *resultG, Vector2f *resultB, 
                                              DistortionRenderDesc const &distortion,
@@ -2146,3 +2401,171 @@ Vector2f TransformRendertargetNDCToTanFovSpace( StereoEyeParams const &eyeParams
 
 
 
+
+
+namespace OVR {
+
+static const int LensTestSamples = 1022;     // not a multiple of four, so the batch tails are covered
+
+static void LensTestRadii( const LensConfig& lens, float* r, float* rsq )
+{
+    // A little past the range the curves are fit over. Lenses made from the
+    // eye cup coefficients leave MaxR at zero, and are used out to about one.
+    const float maxR = ( lens.MaxR > 0.0f ? lens.MaxR : 1.0f ) * 1.2f;
+    for ( int i = 0; i < LensTestSamples; i++ )
+    {
+        r[i]   = maxR * (float)i / (float)( LensTestSamples - 1 );
+        rsq[i] = r[i] * r[i];
+    }
+}
+
+bool TestLensConfig( const LensConfig& lens )
+{
+    float r[LensTestSamples];
+    float rsq[LensTestSamples];
+    float scale[LensTestSamples];
+    Vector3f scaleRGB[LensTestSamples];
+    float inverse[LensTestSamples];
+    LensTestRadii ( lens, r, rsq );
+
+    // The batched forward functions only differ from the scalar ones by the
+    // rounding of the NEON reciprocal.
+    lens.DistortionFnScaleRadiusSquaredBatch ( rsq, scale, LensTestSamples );
+    lens.DistortionFnScaleRadiusSquaredChromaBatch ( rsq, scaleRGB, LensTestSamples );
+    float maxScaleError = 0.0f;
+    float maxChromaError = 0.0f;
+    for ( int i = 0; i < LensTestSamples; i++ )
+    {
+        const float    expected       = lens.DistortionFnScaleRadiusSquared ( rsq[i] );
+        const Vector3f expectedChroma = lens.DistortionFnScaleRadiusSquaredChroma ( rsq[i] );
+        maxScaleError  = Alg::Max ( maxScaleError, fabsf ( scale[i] - expected ) / fabsf ( expected ) );
+        maxChromaError = Alg::Max ( maxChromaError, ( scaleRGB[i] - expectedChroma ).Length() / expectedChroma.Length() );
+    }
+
+    // The inverse should round trip, and be at least as close as the old search.
+    lens.DistortionFnInverseBatch ( r, inverse, LensTestSamples );
+    float maxRoundTripError = 0.0f;
+    float maxSearchRoundTripError = 0.0f;
+    for ( int i = 1; i < LensTestSamples; i++ )
+    {
+        const float searchInverse = DistortionFnInverseSearch ( lens, r[i] );
+        maxRoundTripError       = Alg::Max ( maxRoundTripError, fabsf ( lens.DistortionFn ( inverse[i] ) - r[i] ) / r[i] );
+        maxSearchRoundTripError = Alg::Max ( maxSearchRoundTripError, fabsf ( lens.DistortionFn ( searchInverse ) - r[i] ) / r[i] );
+    }
+
+    const bool passed = maxScaleError < 1e-5f && maxChromaError < 1e-5f &&
+                        maxRoundTripError <= Alg::Max ( maxSearchRoundTripError, 1e-5f );
+    if ( !passed )
+    {
+        LogText("TestLensConfig - equation %i: scale error %g, chroma error %g, inverse round trip error %g (search %g)\n",
+                lens.Eqn, maxScaleError, maxChromaError, maxRoundTripError, maxSearchRoundTripError);
+    }
+    return passed;
+}
+
+void BenchmarkLensConfig( const LensConfig& lens )
+{
+    float r[LensTestSamples];
+    float rsq[LensTestSamples];
+    Vector3f scaleRGB[LensTestSamples];
+    float inverse[LensTestSamples];
+    float searchInverse[LensTestSamples];
+    LensTestRadii ( lens, r, rsq );
+
+    const int Iterations = 100;
+    UInt64 start = Timer::GetTicksNanos();
+    for ( int iter = 0; iter < Iterations; iter++ )
+    {
+        for ( int i = 0; i < LensTestSamples; i++ )
+        {
+            scaleRGB[i] = lens.DistortionFnScaleRadiusSquaredChroma ( rsq[i] );
+        }
+    }
+    const UInt64 scalarChromaNanos = Timer::GetTicksNanos() - start;
+
+    start = Timer::GetTicksNanos();
+    for ( int iter = 0; iter < Iterations; iter++ )
+    {
+        lens.DistortionFnScaleRadiusSquaredChromaBatch ( rsq, scaleRGB, LensTestSamples );
+    }
+    const UInt64 batchChromaNanos = Timer::GetTicksNanos() - start;
+
+    start = Timer::GetTicksNanos();
+    for ( int i = 0; i < LensTestSamples; i++ )
+    {
+        searchInverse[i] = DistortionFnInverseSearch ( lens, r[i] );
+    }
+    const UInt64 searchNanos = Timer::GetTicksNanos() - start;
+
+    start = Timer::GetTicksNanos();
+    lens.DistortionFnInverseBatch ( r, inverse, LensTestSamples );
+    const UInt64 inverseNanos = Timer::GetTicksNanos() - start;
+
+    // Also keeps the search from being optimized away.
+    float maxInverseDifference = 0.0f;
+    for ( int i = 0; i < LensTestSamples; i++ )
+    {
+        maxInverseDifference = Alg::Max ( maxInverseDifference, fabsf ( inverse[i] - searchInverse[i] ) );
+    }
+
+    LogText("BenchmarkLensConfig - equation %i: chroma %.1f ns per radius (batch %.1f ns), inverse %.1f ns (search %.1f ns, differs by %g)\n",
+            lens.Eqn, (double)scalarChromaNanos / ( Iterations * LensTestSamples ),
+            (double)batchChromaNanos / ( Iterations * LensTestSamples ),
+            (double)inverseNanos / LensTestSamples, (double)searchNanos / LensTestSamples, maxInverseDifference);
+}
+
+// One lens of each equation the batch functions handle differently.
+static int GetTestLensConfigs( LensConfig* lenses )
+{
+    int numLenses = 0;
+
+    HmdRenderInfo hmd;
+    hmd.EyeCups = EyeCup_BlackA;
+    lenses[numLenses++] = GenerateLensConfigFromEyeRelief ( 0.012f, hmd );
+    hmd.EyeCups = EyeCup_OrangeA;
+    lenses[numLenses++] = GenerateLensConfigFromEyeRelief ( 0.018f, hmd );
+
+    LensConfig& poly = lenses[numLenses++];
+    poly.SetToIdentity();
+    poly.Eqn = Distortion_Poly4;
+    poly.K[1] = 0.22f;
+    poly.K[2] = 0.24f;
+    poly.ChromaticAberration[0] = -0.006f;
+    poly.ChromaticAberration[2] = 0.014f;
+
+    LensConfig& spline = lenses[numLenses++];
+    spline.SetToIdentity();
+    spline.Eqn = Distortion_CatmullRom10;
+    for ( int i = 1; i < 11; i++ )
+    {
+        spline.K[i] = 1.0f + 0.004f * i * i;
+    }
+    spline.ChromaticAberration[1] = -0.01f;
+    spline.ChromaticAberration[3] = 0.02f;
+
+    return numLenses;
+}
+
+bool TestLensConfigs()
+{
+    LensConfig lenses[4];
+    const int numLenses = GetTestLensConfigs ( lenses );
+    bool passed = true;
+    for ( int i = 0; i < numLenses; i++ )
+    {
+        passed &= TestLensConfig ( lenses[i] );
+    }
+    return passed;
+}
+
+void BenchmarkLensConfigs()
+{
+    LensConfig lenses[4];
+    const int numLenses = GetTestLensConfigs ( lenses );
+    for ( int i = 0; i < numLenses; i++ )
+    {
+        BenchmarkLensConfig ( lenses[i] );
+    }
+}
+
+} //namespace OVR
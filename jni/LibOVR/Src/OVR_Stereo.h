@@ -153,6 +153,14 @@ struct LensConfig
     // DistortionFnInverse computes the inverse of the distortion function on an argument.
     float DistortionFnInverse(float r) const;
 
+    // Batched versions of the above, for evaluating many radii at once, e.g. every
+    // vertex of a distortion mesh. The equation is only dispatched once per call,
+    // and the polynomial curves and chroma scales are done four at a time with
+    // NEON or SSE where available.
+    void DistortionFnScaleRadiusSquaredBatch (const float* rsq, float* scale, int count) const;
+    void DistortionFnScaleRadiusSquaredChromaBatch (const float* rsq, Vector3f* scaleRGB, int count) const;
+    void DistortionFnInverseBatch (const float* r, float* inverse, int count) const;
+
     // Also computes the inverse, but using a polynomial approximation. Warning - it's just an approximation!
     float DistortionFnInverseApprox(float r) const;
     // Sets up InvK[].
@@ -371,6 +379,8 @@ struct StereoEyeParams
 // A set of "forward-mapping" functions, mapping from framebuffer space to real-world and/or texture space.
 Vector2f TransformScreenNDCToTanFovSpace ( DistortionRenderDesc const &distortion,
                                            const Vector2f &framebufferNDC );
+void TransformScreenNDCToTanFovSpaceBatch ( Vector2f *tanEyeAngles, DistortionRenderDesc const &distortion,
+                                            const Vector2f *framebufferNDCs, int count );
 void TransformScreenNDCToTanFovSpaceChroma ( Vector2f *resultR, Vector2f *resultG, Vector2f *resultB, 
                                              DistortionRenderDesc const &distortion,
                                              const Vector2f &framebufferNDC );
@@ -399,6 +409,17 @@ Vector2f TransformRendertargetNDCToTanFovSpace( StereoEyeParams const &eyeParams
                                                 Vector2f const &textureUV );
 
 
+// Checks the batched and fast inverse functions against straightforward reference
+// implementations over the whole useful range of the lens, and logs the largest
+// errors if they are out of tolerance.
+bool TestLensConfig( const LensConfig& lens );
+// Logs the time taken by the scalar and batched functions for the lens.
+void BenchmarkLensConfig( const LensConfig& lens );
+
+// The above for a lens of each distortion equation.
+bool TestLensConfigs();
+void BenchmarkLensConfigs();
+
 } //namespace OVR
 
 #endif // OVR_Stereo_h
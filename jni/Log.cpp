@@ -18,6 +18,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include <assert.h>
 
 #include "GlUtils.h"
+#include "Kernel/OVR_Trace.h"
 
 static bool AllowGpuTimerQueries = false;
 
@@ -76,7 +77,8 @@ void LogWithFileTag( int prio, const char * fileTag, const char * fmt, ... )
 }
 
 template< int NumTimers, int NumFrames >
-LogGpuTime<NumTimers,NumFrames>::LogGpuTime() :
+LogGpuTime<NumTimers,NumFrames>::LogGpuTime( const char * traceName ) :
+	TraceName( traceName ),
 	UseTimerQuery( false ),
 	UseQueryCounter( false ),
 	TimerQuery(),
@@ -128,6 +130,7 @@ void LogGpuTime<NumTimers,NumFrames>::Begin( int index )
 			glGetQueryObjectui64vEXT_( TimerQuery[index], GL_QUERY_RESULT_EXT, &elapsedGpuTime );
 
 			TimeResultMilliseconds[index][TimeResultIndex[index]] = ( elapsedGpuTime - (GLuint64)BeginTimestamp[index] ) * 0.000001;
+			OVR::TraceCounter( OVR::TRACE_GPU, TraceName, (OVR::SInt64)( elapsedGpuTime - (GLuint64)BeginTimestamp[index] ), index );
 			TimeResultIndex[index] = ( TimeResultIndex[index] + 1 ) % NumFrames;
 		}
 		else
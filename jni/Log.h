@@ -85,13 +85,15 @@ private:
 };
 
 // Call LogGpuTime::Begin() and LogGpuTime::End() to log the GPU rendering time between begin and end.
-// Note that begin-end blocks cannot overlap.
+// Note that begin-end blocks cannot overlap, see GpuProfiler for nested scopes.
 // This seems to cause some stability problems, so don't do it automatically.
+// While tracing is enabled, every result is also traced as a counter with the
+// given name, in nanoseconds, with the timer index as the series.
 template< int NumTimers, int NumFrames = 10 >
 class LogGpuTime
 {
 public:
-					LogGpuTime();
+	explicit		LogGpuTime( const char * traceName = "GpuTime" );
 					~LogGpuTime();
 
 	void			Begin( int index );
@@ -101,6 +103,7 @@ public:
 	double			GetTotalTime() const;
 
 private:
+	const char *	TraceName;
 	bool			UseTimerQuery;
 	bool			UseQueryCounter;
 	uint32_t		TimerQuery[NumTimers];
@@ -0,0 +1,1432 @@
+/************************************************************************************
+
+Filename    :   MeshOptimizer.cpp
+Content     :   Load time optimization of triangle meshes for the GPU.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "MeshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "Kernel/OVR_Alg.h"
+#include "Log.h"
+#include "VrApi/VrApi.h"	// ovr_GetTimeInSeconds
+
+namespace OVR
+{
+
+// A FIFO post-transform cache, as found on most mobile GPUs. It stores the
+// miss count at which each vertex entered, so a vertex is still cached if
+// fewer than cacheSize misses happened since.
+class FifoCache
+{
+public:
+	FifoCache( const int vertexCount, const int cacheSize_ ) :
+		cacheSize( cacheSize_ ),
+		time( 0 )
+	{
+		insertedAt.Resize( vertexCount );
+		for ( int v = 0; v < vertexCount; v++ )
+		{
+			insertedAt[v] = -cacheSize - 1;
+		}
+	}
+
+	// Returns 1 on a miss, 0 on a hit.
+	int Access( const int v )
+	{
+		if ( time - insertedAt[v] > cacheSize )
+		{
+			insertedAt[v] = time++;
+			return 1;
+		}
+		return 0;
+	}
+
+	// Empties the cache without touching every vertex.
+	void Flush() { time += cacheSize + 1; }
+
+private:
+	int				cacheSize;
+	int				time;
+	Array< int >	insertedAt;
+};
+
+template< typename _attrib_type_ >
+static void RemapAttribute( Array< _attrib_type_ > & attrib, const Array< int > & newToOld, const int newCount )
+{
+	if ( attrib.GetSizeI() == 0 )
+	{
+		return;
+	}
+	Array< _attrib_type_ > remapped;
+	remapped.Resize( newCount );
+	for ( int i = 0; i < newCount; i++ )
+	{
+		remapped[i] = attrib[newToOld[i]];
+	}
+	attrib = remapped;
+}
+
+static void RemapAttributes( VertexAttribs & attribs, const Array< int > & newToOld, const int newCount )
+{
+	RemapAttribute( attribs.position, newToOld, newCount );
+	RemapAttribute( attribs.normal, newToOld, newCount );
+	RemapAttribute( attribs.tangent, newToOld, newCount );
+	RemapAttribute( attribs.binormal, newToOld, newCount );
+	RemapAttribute( attribs.color, newToOld, newCount );
+	RemapAttribute( attribs.uv0, newToOld, newCount );
+	RemapAttribute( attribs.uv1, newToOld, newCount );
+	RemapAttribute( attribs.jointIndices, newToOld, newCount );
+	RemapAttribute( attribs.jointWeights, newToOld, newCount );
+}
+
+/*
+	Vertex cache ordering
+
+	See "Linear-Speed Vertex Cache Optimisation", Tom Forsyth, 2006.
+	Every vertex gets a score from its position in a simulated LRU cache and
+	from the number of triangles that still need it, and the triangle with the
+	highest total score is emitted next.
+*/
+
+static const int	FORSYTH_CACHE_SIZE		= 32;
+static const float	FORSYTH_DECAY_POWER		= 1.5f;
+static const float	FORSYTH_LAST_TRI_SCORE	= 0.75f;
+static const float	FORSYTH_VALENCE_SCALE	= 2.0f;
+static const float	FORSYTH_VALENCE_POWER	= 0.5f;
+
+// Scores for each cache position and for small numbers of remaining triangles
+// are looked up, the powf calls would otherwise dominate.
+static const int	FORSYTH_MAX_VALENCE		= 64;
+
+struct ForsythScoreTables
+{
+	ForsythScoreTables()
+	{
+		for ( int i = 0; i < FORSYTH_CACHE_SIZE; i++ )
+		{
+			if ( i < 3 )
+			{
+				// The vertices of the last triangle get a fixed score, so the
+				// next triangle doesn't just reuse the same edge and make strips.
+				cacheScore[i] = FORSYTH_LAST_TRI_SCORE;
+			}
+			else
+			{
+				const float scale = 1.0f / ( FORSYTH_CACHE_SIZE - 3 );
+				cacheScore[i] = powf( 1.0f - ( i - 3 ) * scale, FORSYTH_DECAY_POWER );
+			}
+		}
+		valenceScore[0] = 0.0f;
+		for ( int i = 1; i < FORSYTH_MAX_VALENCE; i++ )
+		{
+			valenceScore[i] = ValenceScore( i );
+		}
+	}
+
+	// Favor vertices with few triangles left, to finish them off.
+	static float ValenceScore( const int remainingTriangles )
+	{
+		return FORSYTH_VALENCE_SCALE * powf( (float)remainingTriangles, -FORSYTH_VALENCE_POWER );
+	}
+
+	float	cacheScore[FORSYTH_CACHE_SIZE];
+	float	valenceScore[FORSYTH_MAX_VALENCE];
+};
+
+static const ForsythScoreTables ScoreTables;
+
+static float VertexScore( const ForsythScoreTables & tables, const int cachePosition, const int remainingTriangles )
+{
+	if ( remainingTriangles == 0 )
+	{
+		return -1.0f;
+	}
+	const float score = ( cachePosition >= 0 ) ? tables.cacheScore[cachePosition] : 0.0f;
+	return score + ( ( remainingTriangles < FORSYTH_MAX_VALENCE ) ?
+			tables.valenceScore[remainingTriangles] : ForsythScoreTables::ValenceScore( remainingTriangles ) );
+}
+
+void OptimizeVertexCache( Array< TriangleIndex > & indices, const int vertexCount )
+{
+	const int triangleCount = indices.GetSizeI() / 3;
+	if ( triangleCount == 0 || vertexCount == 0 )
+	{
+		return;
+	}
+
+	const ForsythScoreTables & tables = ScoreTables;
+
+	// Triangles that use each vertex.
+	Array< int > remaining;
+	Array< int > firstTriangle;
+	Array< int > vertexTriangles;
+	remaining.Resize( vertexCount );
+	firstTriangle.Resize( vertexCount + 1 );
+	vertexTriangles.Resize( triangleCount * 3 );
+	memset( &remaining[0], 0, vertexCount * sizeof( remaining[0] ) );
+	for ( int i = 0; i < triangleCount * 3; i++ )
+	{
+		remaining[indices[i]]++;
+	}
+	firstTriangle[0] = 0;
+	for ( int v = 0; v < vertexCount; v++ )
+	{
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+		remaining[v] = 0;
+	}
+	for ( int i = 0; i < triangleCount * 3; i++ )
+	{
+		const int v = indices[i];
+		vertexTriangles[firstTriangle[v] + remaining[v]++] = i / 3;
+	}
+
+	Array< int > cachePosition;
+	Array< float > vertexScore;
+	cachePosition.Resize( vertexCount );
+	vertexScore.Resize( vertexCount );
+	for ( int v = 0; v < vertexCount; v++ )
+	{
+		cachePosition[v] = -1;
+		vertexScore[v] = VertexScore( tables, -1, remaining[v] );
+	}
+
+	Array< float > triangleScore;
+	Array< bool > triangleAdded;
+	triangleScore.Resize( triangleCount );
+	triangleAdded.Resize( triangleCount );
+	for ( int t = 0; t < triangleCount; t++ )
+	{
+		triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		triangleAdded[t] = false;
+	}
+
+	Array< TriangleIndex > ordered;
+	ordered.Resize( triangleCount * 3 );
+
+	int cache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	int newCache[FORSYTH_CACHE_SIZE + 3];
+
+	int bestTriangle = -1;
+	int scanStart = 0;
+	for ( int emitted = 0; emitted < triangleCount; emitted++ )
+	{
+		if ( bestTriangle < 0 )
+		{
+			// Nothing in the cache is connected to anything left, so start over
+			// at the best triangle left. A full scan is rare enough to not matter.
+			float bestScore = -1.0f;
+			while ( triangleAdded[scanStart] )
+			{
+				scanStart++;
+			}
+			for ( int t = scanStart; t < triangleCount; t++ )
+			{
+				if ( !triangleAdded[t] && triangleScore[t] > bestScore )
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		int tri[3];
+		for ( int i = 0; i < 3; i++ )
+		{
+			tri[i] = indices[bestTriangle * 3 + i];
+			ordered[emitted * 3 + i] = (TriangleIndex)tri[i];
+		}
+		triangleAdded[bestTriangle] = true;
+
+		// Remove the triangle from the lists of its vertices.
+		for ( int i = 0; i < 3; i++ )
+		{
+			const int v = tri[i];
+			int * list = &vertexTriangles[firstTriangle[v]];
+			for ( int j = 0; j < remaining[v]; j++ )
+			{
+				if ( list[j] == bestTriangle )
+				{
+					list[j] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// The triangle's vertices move to the front of the cache.
+		int newCount = 0;
+		for ( int i = 0; i < 3; i++ )
+		{
+			newCache[newCount++] = tri[i];
+		}
+		for ( int i = 0; i < cacheCount; i++ )
+		{
+			const int v = cache[i];
+			if ( v != tri[0] && v != tri[1] && v != tri[2] && newCount < FORSYTH_CACHE_SIZE + 3 )
+			{
+				newCache[newCount++] = v;
+			}
+		}
+
+		// Rescore everything that was or is in the cache, and pick the best
+		// triangle touching it for the next round.
+		for ( int i = 0; i < cacheCount; i++ )
+		{
+			cachePosition[cache[i]] = -1;
+		}
+		for ( int i = 0; i < newCount; i++ )
+		{
+			cachePosition[newCache[i]] = ( i < FORSYTH_CACHE_SIZE ) ? i : -1;
+		}
+
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for ( int pass = 0; pass < 2; pass++ )
+		{
+			const int * list = ( pass == 0 ) ? cache : newCache;
+			const int count = ( pass == 0 ) ? cacheCount : newCount;
+			for ( int i = 0; i < count; i++ )
+			{
+				const int v = list[i];
+				const float score = VertexScore( tables, cachePosition[v], remaining[v] );
+				const float delta = score - vertexScore[v];
+				vertexScore[v] = score;
+
+				const int * triangles = &vertexTriangles[firstTriangle[v]];
+				for ( int j = 0; j < remaining[v]; j++ )
+				{
+					const int t = triangles[j];
+					triangleScore[t] += delta;
+					if ( pass == 1 && triangleScore[t] > bestScore )
+					{
+						bestScore = triangleScore[t];
+						bestTriangle = t;
+					}
+				}
+			}
+		}
+
+		memcpy( cache, newCache, Alg::Min( newCount, FORSYTH_CACHE_SIZE ) * sizeof( cache[0] ) );
+		cacheCount = Alg::Min( newCount, FORSYTH_CACHE_SIZE );
+	}
+
+	indices = ordered;
+}
+
+void OptimizeVertexFetch( VertexAttribs & attribs, Array< TriangleIndex > & indices )
+{
+	const int vertexCount = attribs.position.GetSizeI();
+	if ( vertexCount == 0 )
+	{
+		return;
+	}
+
+	Array< int > oldToNew;
+	Array< int > newToOld;
+	oldToNew.Resize( vertexCount );
+	newToOld.Resize( vertexCount );
+	for ( int v = 0; v < vertexCount; v++ )
+	{
+		oldToNew[v] = -1;
+	}
+
+	int newCount = 0;
+	for ( int i = 0; i < indices.GetSizeI(); i++ )
+	{
+		const int v = indices[i];
+		if ( oldToNew[v] < 0 )
+		{
+			oldToNew[v] = newCount;
+			newToOld[newCount] = v;
+			newCount++;
+		}
+		indices[i] = (TriangleIndex)oldToNew[v];
+	}
+
+	RemapAttributes( attribs, newToOld, newCount );
+}
+
+float CalculateAcmr( const Array< TriangleIndex > & indices, const int vertexCount, const int cacheSize )
+{
+	const int triangleCount = indices.GetSizeI() / 3;
+	if ( triangleCount == 0 || vertexCount == 0 )
+	{
+		return 0.0f;
+	}
+
+	FifoCache cache( vertexCount, cacheSize );
+	int misses = 0;
+	for ( int i = 0; i < triangleCount * 3; i++ )
+	{
+		misses += cache.Access( indices[i] );
+	}
+	return (float)misses / triangleCount;
+}
+
+float CalculateAtvr( const Array< TriangleIndex > & indices, const int vertexCount, const int cacheSize )
+{
+	if ( indices.GetSizeI() < 3 || vertexCount == 0 )
+	{
+		return 0.0f;
+	}
+
+	Array< bool > used;
+	used.Resize( vertexCount );
+	memset( &used[0], 0, vertexCount * sizeof( used[0] ) );
+
+	FifoCache cache( vertexCount, cacheSize );
+	int misses = 0;
+	int usedCount = 0;
+	for ( int i = 0; i < indices.GetSizeI() / 3 * 3; i++ )
+	{
+		const int v = indices[i];
+		misses += cache.Access( v );
+		if ( !used[v] )
+		{
+			used[v] = true;
+			usedCount++;
+		}
+	}
+	return (float)misses / usedCount;
+}
+
+/*
+	Vertex deduplication
+*/
+
+template< typename _attrib_type_ >
+static uint32_t HashAttribute( uint32_t hash, const Array< _attrib_type_ > & attrib, const int index )
+{
+	if ( attrib.GetSizeI() == 0 )
+	{
+		return hash;
+	}
+	// 32 bit FNV-1a
+	const unsigned char * bytes = (const unsigned char *)&attrib[index];
+	for ( size_t i = 0; i < sizeof( attrib[index] ); i++ )
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+template< typename _attrib_type_ >
+static bool SameAttribute( const Array< _attrib_type_ > & attrib, const int a, const int b )
+{
+	return attrib.GetSizeI() == 0 || memcmp( &attrib[a], &attrib[b], sizeof( attrib[a] ) ) == 0;
+}
+
+static uint32_t HashVertex( const VertexAttribs & attribs, const int v )
+{
+	uint32_t hash = 2166136261u;
+	hash = HashAttribute( hash, attribs.position, v );
+	hash = HashAttribute( hash, attribs.normal, v );
+	hash = HashAttribute( hash, attribs.tangent, v );
+	hash = HashAttribute( hash, attribs.binormal, v );
+	hash = HashAttribute( hash, attribs.color, v );
+	hash = HashAttribute( hash, attribs.uv0, v );
+	hash = HashAttribute( hash, attribs.uv1, v );
+	hash = HashAttribute( hash, attribs.jointIndices, v );
+	hash = HashAttribute( hash, attribs.jointWeights, v );
+	return hash;
+}
+
+static bool SameVertex( const VertexAttribs & attribs, const int a, const int b )
+{
+	return	SameAttribute( attribs.position, a, b ) &&
+			SameAttribute( attribs.normal, a, b ) &&
+			SameAttribute( attribs.tangent, a, b ) &&
+			SameAttribute( attribs.binormal, a, b ) &&
+			SameAttribute( attribs.color, a, b ) &&
+			SameAttribute( attribs.uv0, a, b ) &&
+			SameAttribute( attribs.uv1, a, b ) &&
+			SameAttribute( attribs.jointIndices, a, b ) &&
+			SameAttribute( attribs.jointWeights, a, b );
+}
+
+int DeduplicateVertices( VertexAttribs & attribs, Array< TriangleIndex > & indices )
+{
+	const int vertexCount = attribs.position.GetSizeI();
+	if ( vertexCount == 0 )
+	{
+		return 0;
+	}
+
+	// Open addressing, at most half full.
+	int tableSize = 1;
+	while ( tableSize < vertexCount * 2 )
+	{
+		tableSize <<= 1;
+	}
+	Array< int > table;
+	table.Resize( tableSize );
+	for ( int i = 0; i < tableSize; i++ )
+	{
+		table[i] = -1;
+	}
+
+	Array< int > oldToNew;
+	Array< int > newToOld;
+	oldToNew.Resize( vertexCount );
+	newToOld.Resize( vertexCount );
+
+	int newCount = 0;
+	for ( int v = 0; v < vertexCount; v++ )
+	{
+		int slot = HashVertex( attribs, v ) & ( tableSize - 1 );
+		for ( ; ; )
+		{
+			const int existing = table[slot];
+			if ( existing < 0 )
+			{
+				table[slot] = v;
+				oldToNew[v] = newCount;
+				newToOld[newCount] = v;
+				newCount++;
+				break;
+			}
+			if ( SameVertex( attribs, existing, v ) )
+			{
+				oldToNew[v] = oldToNew[existing];
+				break;
+			}
+			slot = ( slot + 1 ) & ( tableSize - 1 );
+		}
+	}
+
+	if ( newCount == vertexCount )
+	{
+		return 0;
+	}
+
+	for ( int i = 0; i < indices.GetSizeI(); i++ )
+	{
+		indices[i] = (TriangleIndex)oldToNew[indices[i]];
+	}
+	RemapAttributes( attribs, newToOld, newCount );
+
+	return vertexCount - newCount;
+}
+
+/*
+	Overdraw ordering
+*/
+
+struct OverdrawCluster
+{
+	int		firstTriangle;
+	int		triangleCount;
+	float	sortKey;
+
+	// Sorted with the largest key first, ties keep the cache order.
+	bool operator < ( const OverdrawCluster & other ) const
+	{
+		return ( sortKey != other.sortKey ) ? sortKey > other.sortKey : firstTriangle < other.firstTriangle;
+	}
+};
+
+void OptimizeOverdraw( Array< TriangleIndex > & indices, const Array< Vector3f > & positions, const float threshold )
+{
+	const int triangleCount = indices.GetSizeI() / 3;
+	const int vertexCount = positions.GetSizeI();
+	if ( triangleCount < 2 || vertexCount == 0 )
+	{
+		return;
+	}
+
+	const int cacheSize = 16;
+
+	// Hard boundaries are where the cache order already starts over, with
+	// all three vertices of a triangle missing the cache.
+	Array< int > hardStarts;
+	{
+		FifoCache cache( vertexCount, cacheSize );
+		for ( int t = 0; t < triangleCount; t++ )
+		{
+			const int misses = cache.Access( indices[t * 3 + 0] ) + cache.Access( indices[t * 3 + 1] ) + cache.Access( indices[t * 3 + 2] );
+			if ( misses == 3 )
+			{
+				hardStarts.PushBack( t );
+			}
+		}
+		hardStarts.PushBack( triangleCount );
+	}
+
+	// Soft boundaries split a hard cluster wherever the part so far is already
+	// about as cache efficient as the whole cluster, so restarting the cache
+	// costs little.
+	Array< OverdrawCluster > clusters;
+	{
+		FifoCache cache( vertexCount, cacheSize );
+		for ( int h = 0; h < hardStarts.GetSizeI() - 1; h++ )
+		{
+			const int start = hardStarts[h];
+			const int end = hardStarts[h + 1];
+
+			cache.Flush();
+			int clusterMisses = 0;
+			for ( int t = start; t < end; t++ )
+			{
+				clusterMisses += cache.Access( indices[t * 3 + 0] ) + cache.Access( indices[t * 3 + 1] ) + cache.Access( indices[t * 3 + 2] );
+			}
+			const float clusterAcmr = (float)clusterMisses / ( end - start );
+
+			cache.Flush();
+			int clusterStart = start;
+			int misses = 0;
+			for ( int t = start; t < end; t++ )
+			{
+				misses += cache.Access( indices[t * 3 + 0] ) + cache.Access( indices[t * 3 + 1] ) + cache.Access( indices[t * 3 + 2] );
+				if ( t + 1 < end && (float)misses / ( t + 1 - clusterStart ) <= clusterAcmr * threshold )
+				{
+					OverdrawCluster cluster;
+					cluster.firstTriangle = clusterStart;
+					cluster.triangleCount = t + 1 - clusterStart;
+					cluster.sortKey = 0.0f;
+					clusters.PushBack( cluster );
+
+					cache.Flush();
+					clusterStart = t + 1;
+					misses = 0;
+				}
+			}
+			OverdrawCluster cluster;
+			cluster.firstTriangle = clusterStart;
+			cluster.triangleCount = end - clusterStart;
+			cluster.sortKey = 0.0f;
+			clusters.PushBack( cluster );
+		}
+	}
+
+	if ( clusters.GetSizeI() < 2 )
+	{
+		return;
+	}
+
+	// Area weighted centroid of the whole mesh.
+	Vector3f meshCentroid( 0.0f );
+	float meshArea = 0.0f;
+	for ( int t = 0; t < triangleCount; t++ )
+	{
+		const Vector3f & p0 = positions[indices[t * 3 + 0]];
+		const Vector3f & p1 = positions[indices[t * 3 + 1]];
+		const Vector3f & p2 = positions[indices[t * 3 + 2]];
+		const float area = ( p1 - p0 ).Cross( p2 - p0 ).Length();
+		meshCentroid += ( p0 + p1 + p2 ) * ( area / 3.0f );
+		meshArea += area;
+	}
+	meshCentroid = ( meshArea > 0.0f ) ? meshCentroid / meshArea : Vector3f( 0.0f );
+
+	// Clusters that face away from the center are drawn first.
+	for ( int c = 0; c < clusters.GetSizeI(); c++ )
+	{
+		OverdrawCluster & cluster = clusters[c];
+		Vector3f centroid( 0.0f );
+		Vector3f normal( 0.0f );
+		float area = 0.0f;
+		for ( int t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++ )
+		{
+			const Vector3f & p0 = positions[indices[t * 3 + 0]];
+			const Vector3f & p1 = positions[indices[t * 3 + 1]];
+			const Vector3f & p2 = positions[indices[t * 3 + 2]];
+			const Vector3f cross = ( p1 - p0 ).Cross( p2 - p0 );
+			const float triangleArea = cross.Length();
+			centroid += ( p0 + p1 + p2 ) * ( triangleArea / 3.0f );
+			normal += cross;
+			area += triangleArea;
+		}
+		const float normalLength = normal.Length();
+		if ( area > 0.0f && normalLength > 0.0f )
+		{
+			cluster.sortKey = ( centroid / area - meshCentroid ).Dot( normal / normalLength );
+		}
+	}
+
+	Alg::QuickSort( clusters );
+
+	Array< TriangleIndex > ordered;
+	ordered.Resize( triangleCount * 3 );
+	int out = 0;
+	for ( int c = 0; c < clusters.GetSizeI(); c++ )
+	{
+		const int first = clusters[c].firstTriangle * 3;
+		const int count = clusters[c].triangleCount * 3;
+		memcpy( &ordered[out], &indices[first], count * sizeof( indices[0] ) );
+		out += count;
+	}
+	memcpy( &indices[0], &ordered[0], out * sizeof( indices[0] ) );
+}
+
+/*
+	Simplification
+
+	Greedy edge collapses ordered by the quadric error metric, see "Surface
+	Simplification Using Quadric Error Metrics", Garland and Heckbert, 1997.
+	Vertices only ever collapse onto other existing vertices, so the result
+	indexes the original vertices and no attributes need to be interpolated.
+	Vertices on open borders and on attribute seams, where several vertices
+	share a position, are never moved, which keeps the silhouette and the
+	texture mapping intact at the cost of less reduction on heavily seamed
+	meshes.
+*/
+
+struct Quadric
+{
+	Quadric() : a00( 0 ), a01( 0 ), a02( 0 ), a03( 0 ), a11( 0 ), a12( 0 ), a13( 0 ), a22( 0 ), a23( 0 ), a33( 0 ), weight( 0 ) {}
+
+	// The squared distance to the plane n.p + d = 0, weighted.
+	Quadric( const Vector3f & n, const float d, const float weight ) :
+		a00( weight * n.x * n.x ), a01( weight * n.x * n.y ), a02( weight * n.x * n.z ), a03( weight * n.x * d ),
+		a11( weight * n.y * n.y ), a12( weight * n.y * n.z ), a13( weight * n.y * d ),
+		a22( weight * n.z * n.z ), a23( weight * n.z * d ),
+		a33( weight * d * d ),
+		weight( weight ) {}
+
+	void operator += ( const Quadric & q )
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+		weight += q.weight;
+	}
+
+	double Error( const Vector3f & p ) const
+	{
+		const double x = p.x;
+		const double y = p.y;
+		const double z = p.z;
+		return	x * x * a00 + 2.0 * x * y * a01 + 2.0 * x * z * a02 + 2.0 * x * a03 +
+				y * y * a11 + 2.0 * y * z * a12 + 2.0 * y * a13 +
+				z * z * a22 + 2.0 * z * a23 +
+				a33;
+	}
+
+	// The error divided by the total weight, a mean squared distance.
+	double MeanError( const Vector3f & p ) const
+	{
+		return ( weight > 0.0 ) ? Error( p ) / weight : 0.0;
+	}
+
+	double	a00, a01, a02, a03;
+	double	a11, a12, a13;
+	double	a22, a23;
+	double	a33;
+	double	weight;
+};
+
+struct EdgeCollapse
+{
+	int		from;
+	int		to;
+	double	error;
+
+	bool operator < ( const EdgeCollapse & other ) const
+	{
+		return ( error != other.error ) ? error < other.error : ( from != other.from ? from < other.from : to < other.to );
+	}
+};
+
+// Open addressing set of directed edges.
+class EdgeSet
+{
+public:
+	EdgeSet( const int maxEdges )
+	{
+		int size = 1;
+		while ( size < maxEdges * 2 )
+		{
+			size <<= 1;
+		}
+		keys.Resize( size );
+		for ( int i = 0; i < size; i++ )
+		{
+			keys[i] = EMPTY;
+		}
+	}
+
+	void Add( const int a, const int b )
+	{
+		const uint32_t key = Key( a, b );
+		int slot = Slot( key );
+		while ( keys[slot] != EMPTY && keys[slot] != key )
+		{
+			slot = ( slot + 1 ) & ( keys.GetSizeI() - 1 );
+		}
+		keys[slot] = key;
+	}
+
+	bool Contains( const int a, const int b ) const
+	{
+		const uint32_t key = Key( a, b );
+		for ( int slot = Slot( key ); keys[slot] != EMPTY; slot = ( slot + 1 ) & ( keys.GetSizeI() - 1 ) )
+		{
+			if ( keys[slot] == key )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	static const uint32_t EMPTY = 0xFFFFFFFF;
+
+	static uint32_t Key( const int a, const int b ) { return ( (uint32_t)a << 16 ) | (uint32_t)b; }
+	int Slot( const uint32_t key ) const { return (int)( ( key * 2654435761u ) >> 8 ) & ( keys.GetSizeI() - 1 ); }
+
+	Array< uint32_t >	keys;
+};
+
+static Vector3f TriangleNormal( const Vector3f & p0, const Vector3f & p1, const Vector3f & p2 )
+{
+	return ( p1 - p0 ).Cross( p2 - p0 );
+}
+
+float SimplifyMesh( const Array< Vector3f > & positions, const Array< TriangleIndex > & indices,
+		const int targetTriangleCount, const float maxError, Array< TriangleIndex > & result )
+{
+	const int vertexCount = positions.GetSizeI();
+	result = indices;
+	if ( vertexCount == 0 || indices.GetSizeI() / 3 <= targetTriangleCount )
+	{
+		return 0.0f;
+	}
+
+	// Vertices that share a position are seams, and are locked.
+	Array< bool > locked;
+	locked.Resize( vertexCount );
+	{
+		int tableSize = 1;
+		while ( tableSize < vertexCount * 2 )
+		{
+			tableSize <<= 1;
+		}
+		Array< int > table;
+		table.Resize( tableSize );
+		for ( int i = 0; i < tableSize; i++ )
+		{
+			table[i] = -1;
+		}
+		for ( int v = 0; v < vertexCount; v++ )
+		{
+			locked[v] = false;
+			int slot = HashAttribute( 2166136261u, positions, v ) & ( tableSize - 1 );
+			while ( table[slot] >= 0 && !SameAttribute( positions, table[slot], v ) )
+			{
+				slot = ( slot + 1 ) & ( tableSize - 1 );
+			}
+			if ( table[slot] >= 0 )
+			{
+				locked[v] = true;
+				locked[table[slot]] = true;
+			}
+			else
+			{
+				table[slot] = v;
+			}
+		}
+	}
+
+	// Vertices on an edge without a matching opposite edge are on a border.
+	{
+		EdgeSet edges( indices.GetSizeI() );
+		for ( int i = 0; i < indices.GetSizeI() / 3 * 3; i += 3 )
+		{
+			edges.Add( indices[i + 0], indices[i + 1] );
+			edges.Add( indices[i + 1], indices[i + 2] );
+			edges.Add( indices[i + 2], indices[i + 0] );
+		}
+		for ( int i = 0; i < indices.GetSizeI() / 3 * 3; i++ )
+		{
+			const int a = indices[i];
+			const int b = indices[( i % 3 == 2 ) ? i - 2 : i + 1];
+			if ( !edges.Contains( b, a ) )
+			{
+				locked[a] = true;
+				locked[b] = true;
+			}
+		}
+	}
+
+	// Area weighted plane quadrics.
+	Array< Quadric > quadrics;
+	quadrics.Resize( vertexCount );
+	for ( int i = 0; i < indices.GetSizeI() / 3 * 3; i += 3 )
+	{
+		const Vector3f & p0 = positions[indices[i + 0]];
+		const Vector3f cross = TriangleNormal( p0, positions[indices[i + 1]], positions[indices[i + 2]] );
+		const float length = cross.Length();
+		if ( length <= 0.0f )
+		{
+			continue;
+		}
+		const Vector3f n = cross / length;
+		const Quadric q( n, -n.Dot( p0 ), length * 0.5f );
+		for ( int j = 0; j < 3; j++ )
+		{
+			quadrics[indices[i + j]] += q;
+		}
+	}
+
+	Array< int > remap;
+	remap.Resize( vertexCount );
+	for ( int v = 0; v < vertexCount; v++ )
+	{
+		remap[v] = v;
+	}
+
+	Array< int > firstTriangle;
+	Array< int > triangleCount;
+	Array< int > vertexTriangles;
+	Array< bool > touched;
+	Array< EdgeCollapse > collapses;
+	firstTriangle.Resize( vertexCount );
+	triangleCount.Resize( vertexCount );
+	touched.Resize( vertexCount );
+
+	const double maxErrorSquared = (double)maxError * maxError;
+	double resultError = 0.0;
+	for ( int pass = 0; pass < 100 && result.GetSizeI() / 3 > targetTriangleCount; pass++ )
+	{
+		const int numTriangles = result.GetSizeI() / 3;
+
+		// Triangles around every vertex.
+		memset( &triangleCount[0], 0, vertexCount * sizeof( triangleCount[0] ) );
+		for ( int i = 0; i < numTriangles * 3; i++ )
+		{
+			triangleCount[result[i]]++;
+		}
+		int offset = 0;
+		for ( int v = 0; v < vertexCount; v++ )
+		{
+			firstTriangle[v] = offset;
+			offset += triangleCount[v];
+			triangleCount[v] = 0;
+		}
+		vertexTriangles.Resize( offset );
+		for ( int i = 0; i < numTriangles * 3; i++ )
+		{
+			const int v = result[i];
+			vertexTriangles[firstTriangle[v] + triangleCount[v]++] = i / 3;
+		}
+
+		// Every edge can collapse either way, unless the vertex that would move is locked.
+		collapses.Clear();
+		for ( int i = 0; i < numTriangles * 3; i++ )
+		{
+			const int a = result[i];
+			const int b = result[( i % 3 == 2 ) ? i - 2 : i + 1];
+			for ( int k = 0; k < 2; k++ )
+			{
+				const int from = k ? b : a;
+				const int to = k ? a : b;
+				if ( locked[from] )
+				{
+					continue;
+				}
+				Quadric q = quadrics[from];
+				q += quadrics[to];
+				EdgeCollapse collapse;
+				collapse.from = from;
+				collapse.to = to;
+				collapse.error = q.Error( positions[to] );
+				if ( q.MeanError( positions[to] ) <= maxErrorSquared )
+				{
+					collapses.PushBack( collapse );
+				}
+			}
+		}
+		if ( collapses.GetSizeI() == 0 )
+		{
+			break;
+		}
+		Alg::QuickSort( collapses );
+
+		// Take the cheapest collapses that don't overlap, until enough triangles are gone.
+		memset( &touched[0], 0, vertexCount * sizeof( touched[0] ) );
+		int removed = 0;
+		const int toRemove = numTriangles - targetTriangleCount;
+		for ( int c = 0; c < collapses.GetSizeI() && removed < toRemove; c++ )
+		{
+			const EdgeCollapse & collapse = collapses[c];
+			const int from = collapse.from;
+			const int to = collapse.to;
+			if ( touched[from] || touched[to] )
+			{
+				continue;
+			}
+
+			// Reject collapses that flip a triangle.
+			bool flips = false;
+			int collapsing = 0;
+			for ( int j = 0; j < triangleCount[from] && !flips; j++ )
+			{
+				const int t = vertexTriangles[firstTriangle[from] + j];
+				const int v0 = result[t * 3 + 0];
+				const int v1 = result[t * 3 + 1];
+				const int v2 = result[t * 3 + 2];
+				if ( v0 == to || v1 == to || v2 == to )
+				{
+					collapsing++;
+					continue;
+				}
+				const Vector3f before = TriangleNormal( positions[v0], positions[v1], positions[v2] );
+				const Vector3f after = TriangleNormal( positions[v0 == from ? to : v0], positions[v1 == from ? to : v1], positions[v2 == from ? to : v2] );
+				flips = before.Dot( after ) <= 0.0f;
+			}
+			if ( flips || collapsing == 0 )
+			{
+				continue;
+			}
+
+			remap[from] = to;
+			quadrics[to] += quadrics[from];
+			resultError = Alg::Max( resultError, quadrics[to].MeanError( positions[to] ) );
+			removed += collapsing;
+
+			// Nothing else around the moved vertex changes in this pass.
+			for ( int j = 0; j < triangleCount[from]; j++ )
+			{
+				const int t = vertexTriangles[firstTriangle[from] + j];
+				touched[result[t * 3 + 0]] = true;
+				touched[result[t * 3 + 1]] = true;
+				touched[result[t * 3 + 2]] = true;
+			}
+		}
+		if ( removed == 0 )
+		{
+			break;
+		}
+
+		// Apply the collapses and drop the degenerate triangles.
+		int out = 0;
+		for ( int i = 0; i < numTriangles * 3; i += 3 )
+		{
+			const int v0 = remap[result[i + 0]];
+			const int v1 = remap[result[i + 1]];
+			const int v2 = remap[result[i + 2]];
+			if ( v0 != v1 && v1 != v2 && v2 != v0 )
+			{
+				result[out++] = (TriangleIndex)v0;
+				result[out++] = (TriangleIndex)v1;
+				result[out++] = (TriangleIndex)v2;
+			}
+		}
+		result.Resize( out );
+	}
+
+	return sqrtf( (float)resultError );
+}
+
+// Checks the result of a simplification and returns its triangle count, or -1
+// if it isn't a valid simplification of a mesh with that many vertices.
+static int CheckSimplifiedMesh( const char * name, const Array< TriangleIndex > & result, const int vertexCount )
+{
+	for ( int i = 0; i < result.GetSizeI() / 3 * 3; i += 3 )
+	{
+		const int v0 = result[i + 0];
+		const int v1 = result[i + 1];
+		const int v2 = result[i + 2];
+		if ( v0 >= vertexCount || v1 >= vertexCount || v2 >= vertexCount || v0 == v1 || v1 == v2 || v2 == v0 )
+		{
+			LOG( "TestSimplifyMesh: %s has a bad triangle %i %i %i", name, v0, v1, v2 );
+			return -1;
+		}
+	}
+	return result.GetSizeI() / 3;
+}
+
+// A closed sphere of rings, with one vertex at each pole and no seams.
+static void BuildSphere( const int rings, Array< Vector3f > & positions, Array< TriangleIndex > & indices )
+{
+	const int segments = rings * 2;
+	positions.PushBack( Vector3f( 0.0f, 1.0f, 0.0f ) );
+	for ( int r = 1; r < rings; r++ )
+	{
+		for ( int s = 0; s < segments; s++ )
+		{
+			const float theta = Mathf::Pi * r / rings;
+			const float phi = Mathf::Pi * 2.0f * s / segments;
+			positions.PushBack( Vector3f( sinf( theta ) * cosf( phi ), cosf( theta ), sinf( theta ) * sinf( phi ) ) );
+		}
+	}
+	positions.PushBack( Vector3f( 0.0f, -1.0f, 0.0f ) );
+
+	const int bottom = positions.GetSizeI() - 1;
+	for ( int s = 0; s < segments; s++ )
+	{
+		const int s1 = ( s + 1 ) % segments;
+		const TriangleIndex top[3] = { 0, (TriangleIndex)( 1 + s1 ), (TriangleIndex)( 1 + s ) };
+		indices.Append( top, 3 );
+		for ( int r = 1; r < rings - 1; r++ )
+		{
+			const int a = 1 + ( r - 1 ) * segments;
+			const int b = a + segments;
+			const TriangleIndex quad[6] =
+			{
+				(TriangleIndex)( a + s ), (TriangleIndex)( a + s1 ), (TriangleIndex)( b + s ),
+				(TriangleIndex)( b + s ), (TriangleIndex)( a + s1 ), (TriangleIndex)( b + s1 )
+			};
+			indices.Append( quad, 6 );
+		}
+		const int last = 1 + ( rings - 2 ) * segments;
+		const TriangleIndex end[3] = { (TriangleIndex)( last + s ), (TriangleIndex)( last + s1 ), (TriangleIndex)bottom };
+		indices.Append( end, 3 );
+	}
+}
+
+// A gridSize by gridSize grid of quads, flat if height is 0.
+static void BuildGrid( const int gridSize, const float height, Array< Vector3f > & positions, Array< TriangleIndex > & indices )
+{
+	for ( int y = 0; y <= gridSize; y++ )
+	{
+		for ( int x = 0; x <= gridSize; x++ )
+		{
+			positions.PushBack( Vector3f( (float)x, (float)y, height * sinf( x * 0.7f ) * cosf( y * 0.5f ) ) );
+		}
+	}
+	for ( int y = 0; y < gridSize; y++ )
+	{
+		for ( int x = 0; x < gridSize; x++ )
+		{
+			const int a = y * ( gridSize + 1 ) + x;
+			const int c = a + gridSize + 1;
+			const TriangleIndex quad[6] =
+			{
+				(TriangleIndex)a, (TriangleIndex)( a + 1 ), (TriangleIndex)c,
+				(TriangleIndex)c, (TriangleIndex)( a + 1 ), (TriangleIndex)( c + 1 )
+			};
+			indices.Append( quad, 6 );
+		}
+	}
+}
+
+bool TestSimplifyMesh()
+{
+	int numErrors = 0;
+
+	// A closed mesh with room to spare reaches the target. Every collapse
+	// removes two triangles, so it can overshoot by one.
+	{
+		Array< Vector3f > positions;
+		Array< TriangleIndex > indices;
+		Array< TriangleIndex > result;
+		BuildSphere( 16, positions, indices );
+		const int target = indices.GetSizeI() / 3 / 4;
+		const float error = SimplifyMesh( positions, indices, target, 1.0f, result );
+		const int triangles = CheckSimplifiedMesh( "sphere", result, positions.GetSizeI() );
+		LOG( "TestSimplifyMesh: sphere %i -> %i triangles for a target of %i, error %f",
+				indices.GetSizeI() / 3, triangles, target, error );
+		if ( triangles < target - 1 || triangles > target || error > 1.0f )
+		{
+			numErrors++;
+		}
+	}
+
+	// The border of an open mesh is locked, so a flat grid stops at the
+	// fewest triangles that can fill its outline.
+	{
+		const int gridSize = 8;
+		Array< Vector3f > positions;
+		Array< TriangleIndex > indices;
+		Array< TriangleIndex > result;
+		BuildGrid( gridSize, 0.0f, positions, indices );
+		const int target = indices.GetSizeI() / 3 / 8;
+		const float error = SimplifyMesh( positions, indices, target, 1.0f, result );
+		const int triangles = CheckSimplifiedMesh( "flat grid", result, positions.GetSizeI() );
+		const int outline = gridSize * 4 - 2;
+		LOG( "TestSimplifyMesh: flat grid %i -> %i triangles for a target of %i, error %f",
+				indices.GetSizeI() / 3, triangles, target, error );
+		if ( triangles != outline || error != 0.0f )
+		{
+			LOG( "TestSimplifyMesh: expected the flat grid to stop at %i triangles with no error", outline );
+			numErrors++;
+		}
+	}
+
+	// A bumpy grid with a tight error bound gets part of the way, within the bound.
+	{
+		Array< Vector3f > positions;
+		Array< TriangleIndex > indices;
+		Array< TriangleIndex > result;
+		BuildGrid( 16, 0.5f, positions, indices );
+		const int target = indices.GetSizeI() / 3 / 4;
+		const float maxError = 0.05f;
+		const float error = SimplifyMesh( positions, indices, target, maxError, result );
+		const int triangles = CheckSimplifiedMesh( "bumpy grid", result, positions.GetSizeI() );
+		LOG( "TestSimplifyMesh: bumpy grid %i -> %i triangles for a target of %i, error %f",
+				indices.GetSizeI() / 3, triangles, target, error );
+		if ( triangles <= target || triangles >= indices.GetSizeI() / 3 || error > maxError )
+		{
+			numErrors++;
+		}
+	}
+
+	return numErrors == 0;
+}
+
+/*
+	Everything together
+*/
+
+void OptimizeMesh( VertexAttribs & attribs, Array< TriangleIndex > & indices, const int flags,
+		MeshOptimizeReport * report )
+{
+	const double start = ovr_GetTimeInSeconds();
+
+	MeshOptimizeReport r;
+	r.triangles = indices.GetSizeI() / 3;
+	r.verticesBefore = attribs.position.GetSizeI();
+	if ( report != NULL )
+	{
+		r.acmrBefore = CalculateAcmr( indices, attribs.position.GetSizeI() );
+		r.atvrBefore = CalculateAtvr( indices, attribs.position.GetSizeI() );
+	}
+
+	if ( flags & MESH_OPTIMIZE_DEDUPLICATE )
+	{
+		DeduplicateVertices( attribs, indices );
+	}
+	if ( flags & MESH_OPTIMIZE_VERTEX_CACHE )
+	{
+		OptimizeVertexCache( indices, attribs.position.GetSizeI() );
+		if ( flags & MESH_OPTIMIZE_OVERDRAW )
+		{
+			OptimizeOverdraw( indices, attribs.position );
+		}
+	}
+	if ( flags & MESH_OPTIMIZE_VERTEX_FETCH )
+	{
+		OptimizeVertexFetch( attribs, indices );
+	}
+
+	if ( report != NULL )
+	{
+		r.verticesAfter = attribs.position.GetSizeI();
+		r.seconds = ovr_GetTimeInSeconds() - start;
+		r.acmrAfter = CalculateAcmr( indices, attribs.position.GetSizeI() );
+		r.atvrAfter = CalculateAtvr( indices, attribs.position.GetSizeI() );
+		*report = r;
+	}
+}
+
+void LogMeshOptimizeReport( const char * name, const MeshOptimizeReport & report )
+{
+	LOG( "%s: %i triangles, %i -> %i vertices, ACMR %4.2f -> %4.2f, ATVR %4.2f -> %4.2f, %5.2f ms",
+			name, report.triangles, report.verticesBefore, report.verticesAfter,
+			report.acmrBefore, report.acmrAfter, report.atvrBefore, report.atvrAfter,
+			report.seconds * 1000.0 );
+}
+
+// A grid with three vertices of its own for every triangle, and the triangles
+// in a pseudo random order. Returns the number of triangles.
+static int BuildShuffledGrid( const int gridSize, VertexAttribs & source, Array< TriangleIndex > & sourceIndices )
+{
+	const int triangleCount = Alg::Min( gridSize * gridSize * 2, MAX_GEOMETRY_VERTICES / 3 );
+	source.position.Resize( triangleCount * 3 );
+	source.uv0.Resize( triangleCount * 3 );
+	sourceIndices.Resize( triangleCount * 3 );
+
+	unsigned int random = 12345;
+	Array< int > order;
+	order.Resize( triangleCount );
+	for ( int t = 0; t < triangleCount; t++ )
+	{
+		order[t] = t;
+	}
+	for ( int t = triangleCount - 1; t > 0; t-- )
+	{
+		random = random * 1103515245 + 12345;
+		Alg::Swap( order[t], order[( random >> 8 ) % ( t + 1 )] );
+	}
+
+	for ( int t = 0; t < triangleCount; t++ )
+	{
+		const int quad = order[t] >> 1;
+		const int x = quad % gridSize;
+		const int y = quad / gridSize;
+		static const int corners[2][3][2] = { { { 0, 0 }, { 1, 0 }, { 0, 1 } }, { { 0, 1 }, { 1, 0 }, { 1, 1 } } };
+		for ( int i = 0; i < 3; i++ )
+		{
+			const int cx = x + corners[order[t] & 1][i][0];
+			const int cy = y + corners[order[t] & 1][i][1];
+			source.position[t * 3 + i] = Vector3f( (float)cx, (float)cy, 0.0f );
+			source.uv0[t * 3 + i] = Vector2f( (float)cx / gridSize, (float)cy / gridSize );
+			sourceIndices[t * 3 + i] = (TriangleIndex)( t * 3 + i );
+		}
+	}
+	return triangleCount;
+}
+
+// A triangle by its corner positions, starting at the smallest corner so the
+// same triangle with the same winding always compares equal.
+struct TrianglePositions
+{
+	Vector3f	p[3];
+
+	static bool LessPosition( const Vector3f & a, const Vector3f & b )
+	{
+		return ( a.x != b.x ) ? a.x < b.x : ( ( a.y != b.y ) ? a.y < b.y : a.z < b.z );
+	}
+
+	bool operator < ( const TrianglePositions & other ) const
+	{
+		for ( int i = 0; i < 3; i++ )
+		{
+			if ( LessPosition( p[i], other.p[i] ) )
+			{
+				return true;
+			}
+			if ( LessPosition( other.p[i], p[i] ) )
+			{
+				return false;
+			}
+		}
+		return false;
+	}
+};
+
+static void GetSortedTriangles( const VertexAttribs & attribs, const Array< TriangleIndex > & indices,
+		Array< TrianglePositions > & triangles )
+{
+	triangles.Resize( indices.GetSizeI() / 3 );
+	for ( int t = 0; t < triangles.GetSizeI(); t++ )
+	{
+		int first = 0;
+		for ( int i = 1; i < 3; i++ )
+		{
+			if ( TrianglePositions::LessPosition( attribs.position[indices[t * 3 + i]], attribs.position[indices[t * 3 + first]] ) )
+			{
+				first = i;
+			}
+		}
+		for ( int i = 0; i < 3; i++ )
+		{
+			triangles[t].p[i] = attribs.position[indices[t * 3 + ( first + i ) % 3]];
+		}
+	}
+	Alg::QuickSort( triangles );
+}
+
+bool TestMeshOptimizer()
+{
+	int numErrors = 0;
+
+	// Only identical vertices are merged, and their indices follow.
+	{
+		VertexAttribs attribs;
+		attribs.position.Resize( 4 );
+		attribs.uv0.Resize( 4 );
+		attribs.position[0] = Vector3f( 0.0f, 0.0f, 0.0f );
+		attribs.position[1] = Vector3f( 1.0f, 0.0f, 0.0f );
+		attribs.position[2] = Vector3f( 0.0f, 1.0f, 0.0f );
+		attribs.position[3] = attribs.position[0];
+		for ( int v = 0; v < 4; v++ )
+		{
+			attribs.uv0[v] = Vector2f( attribs.position[v].x, attribs.position[v].y );
+		}
+		attribs.uv0[3].x = 0.5f;
+		Array< TriangleIndex > indices;
+		const TriangleIndex triangles[6] = { 0, 1, 2, 3, 2, 1 };
+		indices.Append( triangles, 6 );
+
+		const int removedDifferent = DeduplicateVertices( attribs, indices );
+		attribs.uv0[3] = attribs.uv0[0];
+		const int removedSame = DeduplicateVertices( attribs, indices );
+		if ( removedDifferent != 0 || removedSame != 1 || attribs.position.GetSizeI() != 3 || indices[3] != 0 )
+		{
+			LOG( "TestMeshOptimizer: removed %i vertices with different uvs and %i identical, leaving %i, index %i",
+					removedDifferent, removedSame, attribs.position.GetSizeI(), indices[3] );
+			numErrors++;
+		}
+	}
+
+	// The whole pipeline on a shuffled grid.
+	const int gridSize = 32;
+	VertexAttribs attribs;
+	Array< TriangleIndex > indices;
+	const int triangleCount = BuildShuffledGrid( gridSize, attribs, indices );
+
+	Array< TrianglePositions > before;
+	GetSortedTriangles( attribs, indices, before );
+
+	MeshOptimizeReport report;
+	OptimizeMesh( attribs, indices, MESH_OPTIMIZE_ALL, &report );
+	LogMeshOptimizeReport( "TestMeshOptimizer", report );
+
+	// Every shared grid corner is welded into one vertex.
+	if ( attribs.position.GetSizeI() != ( gridSize + 1 ) * ( gridSize + 1 ) )
+	{
+		LOG( "TestMeshOptimizer: %i vertices instead of %i", attribs.position.GetSizeI(), ( gridSize + 1 ) * ( gridSize + 1 ) );
+		numErrors++;
+	}
+
+	int outOfRange = 0;
+	for ( int i = 0; i < indices.GetSizeI(); i++ )
+	{
+		outOfRange += ( indices[i] >= attribs.position.GetSizeI() );
+	}
+	if ( indices.GetSizeI() != triangleCount * 3 || outOfRange != 0 )
+	{
+		LOG( "TestMeshOptimizer: %i indices instead of %i, %i out of range", indices.GetSizeI(), triangleCount * 3, outOfRange );
+		numErrors++;
+	}
+	else
+	{
+		// Reordered and renumbered, but the same triangles with the same winding.
+		Array< TrianglePositions > after;
+		GetSortedTriangles( attribs, indices, after );
+		int changed = 0;
+		for ( int t = 0; t < triangleCount; t++ )
+		{
+			changed += ( before[t] < after[t] || after[t] < before[t] );
+		}
+		if ( changed != 0 )
+		{
+			LOG( "TestMeshOptimizer: %i of %i triangles changed", changed, triangleCount );
+			numErrors++;
+		}
+	}
+
+	if ( report.acmrAfter > report.acmrBefore )
+	{
+		LOG( "TestMeshOptimizer: ACMR went from %4.2f to %4.2f", report.acmrBefore, report.acmrAfter );
+		numErrors++;
+	}
+
+	return numErrors == 0;
+}
+
+void BenchmarkMeshOptimizer( const int gridSize, const int iterations )
+{
+	VertexAttribs source;
+	Array< TriangleIndex > sourceIndices;
+	const int triangleCount = BuildShuffledGrid( gridSize, source, sourceIndices );
+
+	MeshOptimizeReport report;
+	double seconds = 0.0;
+	for ( int iter = 0; iter < iterations; iter++ )
+	{
+		VertexAttribs attribs = source;
+		Array< TriangleIndex > indices = sourceIndices;
+		OptimizeMesh( attribs, indices, MESH_OPTIMIZE_ALL, &report );
+		seconds += report.seconds;
+	}
+
+	const double milliseconds = seconds * 1000.0;
+	LogMeshOptimizeReport( "BenchmarkMeshOptimizer", report );
+	LOG( "BenchmarkMeshOptimizer( %i triangles ): %5.3f ms per mesh, %5.1f triangles per ms",
+			triangleCount, milliseconds / iterations, milliseconds > 0.0 ? triangleCount * iterations / milliseconds : 0.0 );
+}
+
+}	// namespace OVR
@@ -0,0 +1,121 @@
+/************************************************************************************
+
+Filename    :   MeshOptimizer.h
+Content     :   Load time optimization of triangle meshes for the GPU.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#ifndef OVR_MeshOptimizer_h
+#define OVR_MeshOptimizer_h
+
+#include "GlGeometry.h"
+
+namespace OVR
+{
+
+// Merges vertices whose attributes are all bitwise identical and remaps the
+// indices to the remaining copy. Returns the number of vertices removed.
+int		DeduplicateVertices( VertexAttribs & attribs, Array< TriangleIndex > & indices );
+
+// Reorders the triangles so vertices are reused while they are still in the
+// post-transform cache, using Tom Forsyth's linear-speed vertex cache
+// optimization. The vertices themselves are not touched.
+//
+// This changes the order in which triangles are drawn, so it should not be
+// used on blended surfaces that rely on the authored order.
+void	OptimizeVertexCache( Array< TriangleIndex > & indices, const int vertexCount );
+
+// Reduces overdraw on a vertex cache ordered list. The triangles are split into
+// clusters wherever that costs less than threshold times the cluster's cache
+// efficiency, and the clusters are sorted so the ones facing away from the
+// center of the mesh, which are the likely occluders, are drawn first.
+// See "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw",
+// Sander, Nehab and Barczak, 2007.
+//
+// Like OptimizeVertexCache, this should not be used on blended surfaces.
+void	OptimizeOverdraw( Array< TriangleIndex > & indices, const Array< Vector3f > & positions,
+						const float threshold = 1.05f );
+
+// Renumbers the vertices in the order the triangles first use them, so the
+// vertex fetch walks the buffer mostly linearly. Vertices that no triangle
+// uses are dropped.
+void	OptimizeVertexFetch( VertexAttribs & attribs, Array< TriangleIndex > & indices );
+
+// Average cache miss ratio: the number of vertices transformed per triangle
+// with a FIFO post-transform cache of the given size. 0.5 is ideal for large
+// regular meshes and 3.0 is the worst case.
+float	CalculateAcmr( const Array< TriangleIndex > & indices, const int vertexCount, const int cacheSize = 16 );
+
+// Average transform to vertex ratio: the number of vertices transformed for
+// every vertex the triangles use. 1.0 is ideal and independent of the mesh.
+float	CalculateAtvr( const Array< TriangleIndex > & indices, const int vertexCount, const int cacheSize = 16 );
+
+// Reduces the triangle count towards targetTriangleCount with edge collapses
+// that keep the original vertices, so the result indexes the same vertex
+// arrays. Border and seam vertices never move, and no collapse may move the
+// surface further than maxError, in model units, from the planes it replaces.
+// Stops short of the target when nothing else can collapse. Returns the
+// largest error of the collapses that were made.
+float	SimplifyMesh( const Array< Vector3f > & positions, const Array< TriangleIndex > & indices,
+					const int targetTriangleCount, const float maxError, Array< TriangleIndex > & result );
+
+// Checks that SimplifyMesh reaches its target on a closed mesh, and stops where
+// expected on a mesh with a locked border and under a tight error bound.
+bool	TestSimplifyMesh();
+
+enum MeshOptimizeFlags
+{
+	MESH_OPTIMIZE_DEDUPLICATE	= 1 << 0,
+	MESH_OPTIMIZE_VERTEX_CACHE	= 1 << 1,
+	MESH_OPTIMIZE_OVERDRAW		= 1 << 2,	// only together with MESH_OPTIMIZE_VERTEX_CACHE
+	MESH_OPTIMIZE_VERTEX_FETCH	= 1 << 3,
+	MESH_OPTIMIZE_ALL			= 0xF
+};
+
+struct MeshOptimizeReport
+{
+	MeshOptimizeReport() :
+		triangles( 0 ),
+		verticesBefore( 0 ),
+		verticesAfter( 0 ),
+		acmrBefore( 0.0f ),
+		acmrAfter( 0.0f ),
+		atvrBefore( 0.0f ),
+		atvrAfter( 0.0f ),
+		seconds( 0.0 ) {}
+
+	int		triangles;
+	int		verticesBefore;
+	int		verticesAfter;
+	float	acmrBefore;
+	float	acmrAfter;
+	float	atvrBefore;
+	float	atvrAfter;
+	double	seconds;
+};
+
+// Runs the selected passes in the order that makes sense: deduplication,
+// vertex cache ordering, overdraw ordering and finally vertex fetch ordering.
+// Fills in the report if it isn't NULL.
+void	OptimizeMesh( VertexAttribs & attribs, Array< TriangleIndex > & indices, const int flags,
+					MeshOptimizeReport * report = NULL );
+
+void	LogMeshOptimizeReport( const char * name, const MeshOptimizeReport & report );
+
+// Runs OptimizeMesh on a shuffled, unwelded grid and checks that the same
+// triangles come out with every index in range, the shared corners welded and
+// the ACMR no worse than before. Also checks that only identical vertices are
+// merged. Uses no GL.
+bool	TestMeshOptimizer();
+
+// Times OptimizeMesh on a shuffled, unwelded grid of triangles and LOGs the
+// triangles processed per millisecond along with the resulting ACMR and ATVR.
+// Uses no GL.
+void	BenchmarkMeshOptimizer( const int gridSize, const int iterations );
+
+}	// namespace OVR
+
+#endif	// OVR_MeshOptimizer_h
@@ -0,0 +1,467 @@
+/************************************************************************************
+
+Filename    :   ModelAnimation.cpp
+Content     :   Keyframed skeletal animation clips for model joints.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "ModelAnimation.h"
+
+#include <math.h>
+
+#if defined(OVR_CPU_ARM_NEON)
+#include <arm_neon.h>
+#elif defined(OVR_CPU_SSE)
+#include <xmmintrin.h>
+#endif
+
+#include "ModelFile.h"		// ModelJoint
+#include "Log.h"
+#include "VrApi/VrApi.h"	// ovr_GetTimeInSeconds
+
+namespace OVR
+{
+
+// Normalized lerp written out per component, without the calls and temporaries
+// of Quat::Nlerp, so the compiler can keep the whole loop in registers.
+static inline Quatf LerpRotation( const Quatf & a, const Quatf & b, const float f )
+{
+	// take the shortest path
+	const float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	const float fa = 1.0f - f;
+	const float fb = ( dot < 0.0f ) ? -f : f;
+
+	Quatf q( a.x * fa + b.x * fb, a.y * fa + b.y * fb, a.z * fa + b.z * fb, a.w * fa + b.w * fb );
+	const float scale = 1.0f / sqrtf( q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w );
+	q.x *= scale;
+	q.y *= scale;
+	q.z *= scale;
+	q.w *= scale;
+	return q;
+}
+
+// LerpRotation for four pairs at once. The quaternions are transposed so each
+// register holds one component of all four, and the arithmetic follows
+// LerpRotation operation for operation, so SSE matches it exactly. NEON has no
+// square root or divide, so its reciprocal square root is an estimate refined
+// with two Newton-Raphson steps, good to about one ulp.
+#if defined(OVR_CPU_ARM_NEON)
+static inline void Transpose4( float32x4_t & r0, float32x4_t & r1, float32x4_t & r2, float32x4_t & r3 )
+{
+	const float32x4x2_t t01 = vtrnq_f32( r0, r1 );
+	const float32x4x2_t t23 = vtrnq_f32( r2, r3 );
+	r0 = vcombine_f32( vget_low_f32( t01.val[0] ), vget_low_f32( t23.val[0] ) );
+	r1 = vcombine_f32( vget_low_f32( t01.val[1] ), vget_low_f32( t23.val[1] ) );
+	r2 = vcombine_f32( vget_high_f32( t01.val[0] ), vget_high_f32( t23.val[0] ) );
+	r3 = vcombine_f32( vget_high_f32( t01.val[1] ), vget_high_f32( t23.val[1] ) );
+}
+
+static inline void LerpRotations4( const Quatf * const a[4], const Quatf * const b[4], const float f, Quatf * const out[4] )
+{
+	float32x4_t ax = vld1q_f32( &a[0]->x );
+	float32x4_t ay = vld1q_f32( &a[1]->x );
+	float32x4_t az = vld1q_f32( &a[2]->x );
+	float32x4_t aw = vld1q_f32( &a[3]->x );
+	Transpose4( ax, ay, az, aw );
+	float32x4_t bx = vld1q_f32( &b[0]->x );
+	float32x4_t by = vld1q_f32( &b[1]->x );
+	float32x4_t bz = vld1q_f32( &b[2]->x );
+	float32x4_t bw = vld1q_f32( &b[3]->x );
+	Transpose4( bx, by, bz, bw );
+
+	// take the shortest path
+	float32x4_t dot = vmulq_f32( ax, bx );
+	dot = vmlaq_f32( dot, ay, by );
+	dot = vmlaq_f32( dot, az, bz );
+	dot = vmlaq_f32( dot, aw, bw );
+	const float32x4_t fa = vdupq_n_f32( 1.0f - f );
+	const uint32x4_t negative = vandq_u32( vcltq_f32( dot, vdupq_n_f32( 0.0f ) ), vdupq_n_u32( 0x80000000 ) );
+	const float32x4_t fb = vreinterpretq_f32_u32( veorq_u32( vreinterpretq_u32_f32( vdupq_n_f32( f ) ), negative ) );
+
+	float32x4_t qx = vmlaq_f32( vmulq_f32( ax, fa ), bx, fb );
+	float32x4_t qy = vmlaq_f32( vmulq_f32( ay, fa ), by, fb );
+	float32x4_t qz = vmlaq_f32( vmulq_f32( az, fa ), bz, fb );
+	float32x4_t qw = vmlaq_f32( vmulq_f32( aw, fa ), bw, fb );
+
+	float32x4_t lengthSq = vmulq_f32( qx, qx );
+	lengthSq = vmlaq_f32( lengthSq, qy, qy );
+	lengthSq = vmlaq_f32( lengthSq, qz, qz );
+	lengthSq = vmlaq_f32( lengthSq, qw, qw );
+	float32x4_t scale = vrsqrteq_f32( lengthSq );
+	scale = vmulq_f32( scale, vrsqrtsq_f32( vmulq_f32( lengthSq, scale ), scale ) );
+	scale = vmulq_f32( scale, vrsqrtsq_f32( vmulq_f32( lengthSq, scale ), scale ) );
+
+	qx = vmulq_f32( qx, scale );
+	qy = vmulq_f32( qy, scale );
+	qz = vmulq_f32( qz, scale );
+	qw = vmulq_f32( qw, scale );
+	Transpose4( qx, qy, qz, qw );
+	vst1q_f32( &out[0]->x, qx );
+	vst1q_f32( &out[1]->x, qy );
+	vst1q_f32( &out[2]->x, qz );
+	vst1q_f32( &out[3]->x, qw );
+}
+#elif defined(OVR_CPU_SSE)
+static inline void LerpRotations4( const Quatf * const a[4], const Quatf * const b[4], const float f, Quatf * const out[4] )
+{
+	__m128 ax = _mm_loadu_ps( &a[0]->x );
+	__m128 ay = _mm_loadu_ps( &a[1]->x );
+	__m128 az = _mm_loadu_ps( &a[2]->x );
+	__m128 aw = _mm_loadu_ps( &a[3]->x );
+	_MM_TRANSPOSE4_PS( ax, ay, az, aw );
+	__m128 bx = _mm_loadu_ps( &b[0]->x );
+	__m128 by = _mm_loadu_ps( &b[1]->x );
+	__m128 bz = _mm_loadu_ps( &b[2]->x );
+	__m128 bw = _mm_loadu_ps( &b[3]->x );
+	_MM_TRANSPOSE4_PS( bx, by, bz, bw );
+
+	// take the shortest path
+	__m128 dot = _mm_mul_ps( ax, bx );
+	dot = _mm_add_ps( dot, _mm_mul_ps( ay, by ) );
+	dot = _mm_add_ps( dot, _mm_mul_ps( az, bz ) );
+	dot = _mm_add_ps( dot, _mm_mul_ps( aw, bw ) );
+	const __m128 fa = _mm_set1_ps( 1.0f - f );
+	const __m128 negative = _mm_and_ps( _mm_cmplt_ps( dot, _mm_setzero_ps() ), _mm_set1_ps( -0.0f ) );
+	const __m128 fb = _mm_xor_ps( _mm_set1_ps( f ), negative );
+
+	__m128 qx = _mm_add_ps( _mm_mul_ps( ax, fa ), _mm_mul_ps( bx, fb ) );
+	__m128 qy = _mm_add_ps( _mm_mul_ps( ay, fa ), _mm_mul_ps( by, fb ) );
+	__m128 qz = _mm_add_ps( _mm_mul_ps( az, fa ), _mm_mul_ps( bz, fb ) );
+	__m128 qw = _mm_add_ps( _mm_mul_ps( aw, fa ), _mm_mul_ps( bw, fb ) );
+
+	__m128 lengthSq = _mm_mul_ps( qx, qx );
+	lengthSq = _mm_add_ps( lengthSq, _mm_mul_ps( qy, qy ) );
+	lengthSq = _mm_add_ps( lengthSq, _mm_mul_ps( qz, qz ) );
+	lengthSq = _mm_add_ps( lengthSq, _mm_mul_ps( qw, qw ) );
+	const __m128 scale = _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_sqrt_ps( lengthSq ) );
+
+	qx = _mm_mul_ps( qx, scale );
+	qy = _mm_mul_ps( qy, scale );
+	qz = _mm_mul_ps( qz, scale );
+	qw = _mm_mul_ps( qw, scale );
+	_MM_TRANSPOSE4_PS( qx, qy, qz, qw );
+	_mm_storeu_ps( &out[0]->x, qx );
+	_mm_storeu_ps( &out[1]->x, qy );
+	_mm_storeu_ps( &out[2]->x, qz );
+	_mm_storeu_ps( &out[3]->x, qw );
+}
+#endif
+
+static inline Vector3f LerpVector( const Vector3f & a, const Vector3f & b, const float f )
+{
+	return Vector3f( a.x + ( b.x - a.x ) * f, a.y + ( b.y - a.y ) * f, a.z + ( b.z - a.z ) * f );
+}
+
+void ModelAnimationClip::Sample( const float timeInSeconds, ModelAnimationPose & pose ) const
+{
+	pose.joints.Resize( numJoints );
+	if ( numFrames <= 0 )
+	{
+		for ( int i = 0; i < numJoints; i++ )
+		{
+			pose.joints[i] = ModelJointPose();
+		}
+		return;
+	}
+
+	float frame = timeInSeconds * frameRate;
+	int frame0;
+	int frame1;
+	if ( loop )
+	{
+		frame = fmodf( frame, (float)numFrames );
+		if ( frame < 0.0f )
+		{
+			frame += numFrames;
+		}
+		frame0 = Alg::Min( (int)frame, numFrames - 1 );
+		frame1 = ( frame0 + 1 == numFrames ) ? 0 : frame0 + 1;
+	}
+	else
+	{
+		frame = Alg::Clamp( frame, 0.0f, (float)( numFrames - 1 ) );
+		frame0 = (int)frame;
+		frame1 = Alg::Min( frame0 + 1, numFrames - 1 );
+	}
+	const float fraction = frame - frame0;
+
+	const Quatf * rotation0 = &rotations[frame0 * numJoints];
+	const Quatf * rotation1 = &rotations[frame1 * numJoints];
+	const Vector3f * translation0 = &translations[frame0 * numJoints];
+	const Vector3f * translation1 = &translations[frame1 * numJoints];
+	ModelJointPose * out = &pose.joints[0];
+
+	int i = 0;
+#if defined(OVR_CPU_ARM_NEON) || defined(OVR_CPU_SSE)
+	for ( ; i + 4 <= numJoints; i += 4 )
+	{
+		const Quatf * const a[4] = { &rotation0[i], &rotation0[i + 1], &rotation0[i + 2], &rotation0[i + 3] };
+		const Quatf * const b[4] = { &rotation1[i], &rotation1[i + 1], &rotation1[i + 2], &rotation1[i + 3] };
+		Quatf * const o[4] = { &out[i].rotation, &out[i + 1].rotation, &out[i + 2].rotation, &out[i + 3].rotation };
+		LerpRotations4( a, b, fraction, o );
+	}
+#endif
+	for ( ; i < numJoints; i++ )
+	{
+		out[i].rotation = LerpRotation( rotation0[i], rotation1[i], fraction );
+	}
+	for ( i = 0; i < numJoints; i++ )
+	{
+		out[i].translation = LerpVector( translation0[i], translation1[i], fraction );
+	}
+
+	if ( scales.GetSizeI() > 0 )
+	{
+		const Vector3f * scale0 = &scales[frame0 * numJoints];
+		const Vector3f * scale1 = &scales[frame1 * numJoints];
+		for ( int i = 0; i < numJoints; i++ )
+		{
+			out[i].scale = LerpVector( scale0[i], scale1[i], fraction );
+		}
+	}
+	else
+	{
+		for ( int i = 0; i < numJoints; i++ )
+		{
+			out[i].scale = Vector3f( 1.0f );
+		}
+	}
+}
+
+void BlendAnimationPoses( const ModelAnimationPose & a, const ModelAnimationPose & b,
+						const float weight, ModelAnimationPose & out )
+{
+	const int numJoints = Alg::Min( a.joints.GetSizeI(), b.joints.GetSizeI() );
+	out.joints.Resize( numJoints );
+
+	int i = 0;
+#if defined(OVR_CPU_ARM_NEON) || defined(OVR_CPU_SSE)
+	for ( ; i + 4 <= numJoints; i += 4 )
+	{
+		const ModelJointPose * ja = &a.joints[i];
+		const ModelJointPose * jb = &b.joints[i];
+		ModelJointPose * jo = &out.joints[i];
+		const Quatf * const ra[4] = { &ja[0].rotation, &ja[1].rotation, &ja[2].rotation, &ja[3].rotation };
+		const Quatf * const rb[4] = { &jb[0].rotation, &jb[1].rotation, &jb[2].rotation, &jb[3].rotation };
+		Quatf * const ro[4] = { &jo[0].rotation, &jo[1].rotation, &jo[2].rotation, &jo[3].rotation };
+		LerpRotations4( ra, rb, weight, ro );
+	}
+#endif
+	for ( ; i < numJoints; i++ )
+	{
+		out.joints[i].rotation = LerpRotation( a.joints[i].rotation, b.joints[i].rotation, weight );
+	}
+	for ( i = 0; i < numJoints; i++ )
+	{
+		const ModelJointPose & ja = a.joints[i];
+		const ModelJointPose & jb = b.joints[i];
+		out.joints[i].translation = LerpVector( ja.translation, jb.translation, weight );
+		out.joints[i].scale = LerpVector( ja.scale, jb.scale, weight );
+	}
+}
+
+void EvaluateAnimationPose( const Array< ModelJoint > & modelJoints, ModelAnimationPose & pose,
+						Array< Matrix4f > & skinningMatrices )
+{
+	const int numJoints = Alg::Min( modelJoints.GetSizeI(), pose.joints.GetSizeI() );
+	pose.world.Resize( numJoints );
+	if ( skinningMatrices.GetSizeI() < numJoints )
+	{
+		skinningMatrices.Resize( numJoints );
+	}
+
+	for ( int i = 0; i < numJoints; i++ )
+	{
+		const ModelJointPose & local = pose.joints[i];
+
+		// translation * rotation * scale
+		Matrix4f localMatrix( local.rotation );
+		for ( int r = 0; r < 3; r++ )
+		{
+			localMatrix.M[r][0] *= local.scale.x;
+			localMatrix.M[r][1] *= local.scale.y;
+			localMatrix.M[r][2] *= local.scale.z;
+		}
+		localMatrix.M[0][3] = local.translation.x;
+		localMatrix.M[1][3] = local.translation.y;
+		localMatrix.M[2][3] = local.translation.z;
+
+		const int parent = modelJoints[i].parent;
+		pose.world[i] = ( parent >= 0 ) ? pose.world[parent] * localMatrix : localMatrix;
+
+		// The inverse bind pose takes the vertices into the joint's space.
+		skinningMatrices[i] = ( pose.world[i] * modelJoints[i].inverseTransform ).Transposed();
+	}
+}
+
+static bool VectorsMatch( const Vector3f & a, const Vector3f & b )
+{
+	return fabsf( a.x - b.x ) < 1e-4f && fabsf( a.y - b.y ) < 1e-4f && fabsf( a.z - b.z ) < 1e-4f;
+}
+
+bool TestJointAnimation()
+{
+	// Two joints a unit apart along X, the first one turning a quarter
+	// circle around Z over a looping clip of four frames.
+	Array< ModelJoint > joints;
+	joints.Resize( 2 );
+	for ( int i = 0; i < 2; i++ )
+	{
+		joints[i].index = i;
+		joints[i].parent = i - 1;
+		joints[i].transform = Matrix4f::Translation( (float)i, 0.0f, 0.0f );
+		joints[i].inverseTransform = joints[i].transform.Inverted();
+		joints[i].animation = MODEL_JOINT_ANIMATION_NONE;
+	}
+
+	ModelAnimationClip clip;
+	clip.frameRate = 4.0f;
+	clip.numFrames = 4;
+	clip.numJoints = 2;
+	for ( int f = 0; f < clip.numFrames; f++ )
+	{
+		clip.rotations.PushBack( Quatf( Vector3f( 0.0f, 0.0f, 1.0f ), f * Math<float>::PiOver2 / 3.0f ) );
+		clip.rotations.PushBack( Quatf() );
+		clip.translations.PushBack( Vector3f( 0.0f ) );
+		clip.translations.PushBack( Vector3f( 1.0f, 0.0f, 0.0f ) );
+	}
+
+	int numErrors = 0;
+	ModelAnimationPose poses[3];
+	Array< Matrix4f > skinningMatrices;
+
+	// At the last key the second joint has swung from ( 1, 0, 0 ) to ( 0, 1, 0 ),
+	// and a vertex bound to it at the joint moves with it.
+	clip.Sample( 0.75f, poses[0] );
+	EvaluateAnimationPose( joints, poses[0], skinningMatrices );
+	const Vector3f tip = skinningMatrices[1].Transposed().Transform( Vector3f( 1.0f, 0.0f, 0.0f ) );
+	if ( !VectorsMatch( tip, Vector3f( 0.0f, 1.0f, 0.0f ) ) )
+	{
+		LOG( "TestJointAnimation: tip at ( %f %f %f ) instead of ( 0 1 0 )", tip.x, tip.y, tip.z );
+		numErrors++;
+	}
+
+	// Looping wraps past the last key back to the first, and a whole clip
+	// later the pose is the same.
+	clip.Sample( 1.0f + 0.125f, poses[1] );
+	clip.Sample( 0.125f, poses[2] );
+	const Vector3f wrapped = poses[1].joints[0].rotation.Rotate( Vector3f( 1.0f, 0.0f, 0.0f ) );
+	const Vector3f first = poses[2].joints[0].rotation.Rotate( Vector3f( 1.0f, 0.0f, 0.0f ) );
+	if ( !VectorsMatch( wrapped, first ) )
+	{
+		LOG( "TestJointAnimation: the clip doesn't repeat after its duration" );
+		numErrors++;
+	}
+
+	// Without looping the last key is held.
+	clip.loop = false;
+	clip.Sample( 10.0f, poses[1] );
+	const Vector3f held = poses[1].joints[0].rotation.Rotate( Vector3f( 1.0f, 0.0f, 0.0f ) );
+	if ( !VectorsMatch( held, Vector3f( 0.0f, 1.0f, 0.0f ) ) )
+	{
+		LOG( "TestJointAnimation: held ( %f %f %f ) instead of ( 0 1 0 )", held.x, held.y, held.z );
+		numErrors++;
+	}
+
+	// Blending the first and last keys halfway gives 45 degrees.
+	clip.Sample( 0.0f, poses[0] );
+	BlendAnimationPoses( poses[0], poses[1], 0.5f, poses[2] );
+	const Vector3f blended = poses[2].joints[0].rotation.Rotate( Vector3f( 1.0f, 0.0f, 0.0f ) );
+	const float half = sqrtf( 0.5f );
+	if ( !VectorsMatch( blended, Vector3f( half, half, 0.0f ) ) )
+	{
+		LOG( "TestJointAnimation: blended ( %f %f %f ) instead of ( %f %f 0 )", blended.x, blended.y, blended.z, half, half );
+		numErrors++;
+	}
+
+	// Enough joints for the four-wide path and a remainder, some of them
+	// pairs more than 90 degrees apart, must match LerpRotation one by one.
+	ModelAnimationClip wide;
+	wide.numFrames = 2;
+	wide.numJoints = 11;
+	for ( int f = 0; f < wide.numFrames; f++ )
+	{
+		for ( int i = 0; i < wide.numJoints; i++ )
+		{
+			const Vector3f axis = Vector3f( 1.0f, (float)i, (float)f ).Normalized();
+			wide.rotations.PushBack( Quatf( axis, ( f == 0 ? 0.3f : -2.0f ) * i ) );
+			wide.translations.PushBack( Vector3f( 0.0f ) );
+		}
+	}
+	wide.Sample( 0.3f / wide.frameRate, poses[0] );
+	wide.Sample( 1.7f / wide.frameRate, poses[1] );
+	BlendAnimationPoses( poses[0], poses[1], 0.25f, poses[2] );
+	for ( int i = 0; i < wide.numJoints; i++ )
+	{
+		const Quatf & a = wide.rotations[i];
+		const Quatf & b = wide.rotations[wide.numJoints + i];
+		const Quatf sampled = LerpRotation( a, b, 0.3f );
+		const Quatf blend = LerpRotation( sampled, LerpRotation( b, a, 0.7f ), 0.25f );
+		const Quatf & got = poses[2].joints[i].rotation;
+		if ( fabsf( got.x - blend.x ) > 1e-5f || fabsf( got.y - blend.y ) > 1e-5f ||
+				fabsf( got.z - blend.z ) > 1e-5f || fabsf( got.w - blend.w ) > 1e-5f )
+		{
+			LOG( "TestJointAnimation: joint %i blended to ( %f %f %f %f ) instead of ( %f %f %f %f )", i,
+					got.x, got.y, got.z, got.w, blend.x, blend.y, blend.z, blend.w );
+			numErrors++;
+		}
+	}
+
+	return numErrors == 0;
+}
+
+void BenchmarkJointAnimation( const int numJoints, const int iterations )
+{
+	// A chain of joints, each a unit further along X than its parent.
+	Array< ModelJoint > joints;
+	joints.Resize( numJoints );
+	for ( int i = 0; i < numJoints; i++ )
+	{
+		joints[i].index = i;
+		joints[i].parent = i - 1;
+		joints[i].transform = Matrix4f::Translation( (float)i, 0.0f, 0.0f );
+		joints[i].inverseTransform = joints[i].transform.Inverted();
+		joints[i].animation = MODEL_JOINT_ANIMATION_NONE;
+	}
+
+	ModelAnimationClip clips[2];
+	for ( int c = 0; c < 2; c++ )
+	{
+		ModelAnimationClip & clip = clips[c];
+		clip.numFrames = 30;
+		clip.numJoints = numJoints;
+		clip.rotations.Resize( clip.numFrames * numJoints );
+		clip.translations.Resize( clip.numFrames * numJoints );
+		for ( int f = 0; f < clip.numFrames; f++ )
+		{
+			for ( int i = 0; i < numJoints; i++ )
+			{
+				clip.rotations[f * numJoints + i] = Quatf( Vector3f( 0.0f, 0.0f, 1.0f ), sinf( f * 0.2f + i + c ) * 0.3f );
+				clip.translations[f * numJoints + i] = Vector3f( i > 0 ? 1.0f : 0.0f, 0.0f, 0.0f );
+			}
+		}
+	}
+
+	ModelAnimationPose poses[3];
+	Array< Matrix4f > skinningMatrices;
+
+	const double start = ovr_GetTimeInSeconds();
+	for ( int iter = 0; iter < iterations; iter++ )
+	{
+		const float time = iter * ( 1.0f / 60.0f );
+		clips[0].Sample( time, poses[0] );
+		clips[1].Sample( time, poses[1] );
+		BlendAnimationPoses( poses[0], poses[1], 0.5f, poses[2] );
+		EvaluateAnimationPose( joints, poses[2], skinningMatrices );
+	}
+	const double end = ovr_GetTimeInSeconds();
+
+	const double milliseconds = ( end - start ) * 1000.0;
+	LOG( "BenchmarkJointAnimation( %i joints ): %5.3f ms per update, %5.1f joints per ms",
+			numJoints, milliseconds / iterations, milliseconds > 0.0 ? numJoints * iterations / milliseconds : 0.0 );
+}
+
+} // namespace OVR
@@ -0,0 +1,87 @@
+/************************************************************************************
+
+Filename    :   ModelAnimation.h
+Content     :   Keyframed skeletal animation clips for model joints.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#ifndef MODELANIMATION_H
+#define MODELANIMATION_H
+
+#include "Kernel/OVR_Math.h"
+#include "Kernel/OVR_String.h"
+#include "Kernel/OVR_Array.h"
+
+namespace OVR
+{
+
+struct ModelJoint;
+
+// The local transform of a joint relative to its parent.
+struct ModelJointPose
+{
+	ModelJointPose() : rotation(), translation( 0.0f ), scale( 1.0f ) {}
+
+	Quatf		rotation;
+	Vector3f	translation;
+	Vector3f	scale;
+};
+
+// One pose for every joint of a model, plus scratch space for evaluating it.
+struct ModelAnimationPose
+{
+	Array< ModelJointPose >	joints;
+	Array< Matrix4f >		world;		// model space joint transforms, row major
+};
+
+// A clip is a sequence of evenly spaced key frames for every joint of a model.
+// The keys are stored frame major, so sampling a frame walks memory linearly.
+class ModelAnimationClip
+{
+public:
+				ModelAnimationClip() : frameRate( 30.0f ), numFrames( 0 ), numJoints( 0 ), loop( true ) {}
+
+	float		GetDuration() const { return numFrames > 1 ? ( loop ? numFrames : numFrames - 1 ) / frameRate : 0.0f; }
+
+	// Interpolates the local joint poses for the given time since the clip started.
+	// Looping clips wrap from the last frame back to the first, other clips hold
+	// the last frame.
+	void		Sample( const float timeInSeconds, ModelAnimationPose & pose ) const;
+
+public:
+	String				name;
+	float				frameRate;
+	int					numFrames;
+	int					numJoints;
+	bool				loop;
+
+	// numFrames * numJoints each
+	Array< Quatf >		rotations;
+	Array< Vector3f >	translations;
+	Array< Vector3f >	scales;			// empty if the clip does not scale
+};
+
+// Cross fades between two poses, weight 0 gives a and weight 1 gives b.
+void	BlendAnimationPoses( const ModelAnimationPose & a, const ModelAnimationPose & b,
+							const float weight, ModelAnimationPose & out );
+
+// Concatenates the local poses down the joint hierarchy and writes the skinning
+// matrices, in the OpenGL column major layout the skinned programs expect.
+// Parents must come before their children in the joint array.
+void	EvaluateAnimationPose( const Array< ModelJoint > & modelJoints, ModelAnimationPose & pose,
+							Array< Matrix4f > & skinningMatrices );
+
+// Checks sampling, looping, blending and evaluating a small hierarchy against
+// known poses. Doesn't need GL.
+bool	TestJointAnimation();
+
+// Times sampling, blending and evaluating a synthetic chain of joints and LOGs
+// the number of joints evaluated per millisecond.
+void	BenchmarkJointAnimation( const int numJoints, const int iterations );
+
+} // namespace OVR
+
+#endif	// MODELANIMATION_H
@@ -19,14 +19,17 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "Kernel/OVR_Array.h"
 #include "Kernel/OVR_String.h"
 #include "Kernel/OVR_String_Utils.h"
+#include "Kernel/OVR_Trace.h"
 #include "OVR_JSON.h"
 #include "OVR_BinaryFile.h"
 #include "OVR_MappedFile.h"
+#include "Profiler.h"
 
 #include "unzip.h"
 #include "GlUtils.h"
 #include "GlTexture.h"
 #include "ModelRender.h"
+#include "MeshOptimizer.h"
 #include "Log.h"
 
 
@@ -59,6 +62,10 @@ ModelFile::~ModelFile()
 	for ( int j = 0; j < Def.surfaces.GetSizeI(); j++ )
 	{
 		const_cast<GlGeometry *>(&Def.surfaces[j].geo)->Free();
+		for ( int k = 0; k < Def.surfaces[j].lods.GetSizeI(); k++ )
+		{
+			Def.surfaces[j].lods[k].geo.Free();
+		}
 	}
 }
 
@@ -122,6 +129,21 @@ const ModelTag * ModelFile::FindNamedTag( const char *name ) const
 	return NULL;
 }
 
+const ModelAnimationClip * ModelFile::FindNamedAnimation( const char *name ) const
+{
+	for ( int i = 0; i < Animations.GetSizeI(); i++ )
+	{
+		const ModelAnimationClip & clip = Animations[i];
+		if ( clip.name.CompareNoCase( name ) == 0 )
+		{
+			LOG( "Found named animation %s", name );
+			return &clip;
+		}
+	}
+	LOG( "Did not find named animation %s", name );
+	return NULL;
+}
+
 Bounds3f ModelFile::GetBounds() const
 {
 	Bounds3f modelBounds;
@@ -175,6 +197,51 @@ void ReadModelArray( Array< _type_ > & out, const char * string, const BinaryRea
 	}
 }
 
+// The keys are read from the binary file, or parsed from the JSON strings
+// when there is no binary file. LOGs why a clip is dropped.
+static bool LoadAnimationClip( const JsonReader & animation, const BinaryReader & bin,
+						const int numModelJoints, ModelAnimationClip & clip )
+{
+	clip.name = animation.GetChildStringByName( "name" );
+	clip.frameRate = animation.GetChildFloatByName( "frameRate", 30.0f );
+	clip.numFrames = animation.GetChildInt32ByName( "frameCount" );
+	clip.numJoints = animation.GetChildInt32ByName( "jointCount" );
+	clip.loop = animation.GetChildBoolByName( "loop", true );
+
+	// Always read the keys so the binary file stays in step with the JSON.
+	const int keyCount = Alg::Max( clip.numFrames, 0 ) * Alg::Max( clip.numJoints, 0 );
+	ReadModelArray( clip.rotations, animation.GetChildStringByName( "rotations" ), bin, keyCount );
+	ReadModelArray( clip.translations, animation.GetChildStringByName( "translations" ), bin, keyCount );
+	ReadModelArray( clip.scales, animation.GetChildStringByName( "scales" ), bin, keyCount );
+
+	if ( clip.numJoints != numModelJoints )
+	{
+		LOG( "animation %s has %i joints, the model has %i", clip.name.ToCStr(), clip.numJoints, numModelJoints );
+		return false;
+	}
+	if ( clip.numFrames <= 0 || clip.frameRate <= 0.0f )
+	{
+		LOG( "animation %s has %i frames at %f frames per second", clip.name.ToCStr(), clip.numFrames, clip.frameRate );
+		return false;
+	}
+	if ( clip.rotations.GetSizeI() != keyCount )
+	{
+		LOG( "animation %s has %i rotations instead of %i", clip.name.ToCStr(), clip.rotations.GetSizeI(), keyCount );
+		return false;
+	}
+	if ( clip.translations.GetSizeI() != keyCount )
+	{
+		LOG( "animation %s has %i translations instead of %i", clip.name.ToCStr(), clip.translations.GetSizeI(), keyCount );
+		return false;
+	}
+	if ( clip.scales.GetSizeI() != 0 && clip.scales.GetSizeI() != keyCount )
+	{
+		LOG( "animation %s has %i scales instead of 0 or %i", clip.name.ToCStr(), clip.scales.GetSizeI(), keyCount );
+		return false;
+	}
+	return true;
+}
+
 void LoadModelFileJson( ModelFile & model,
 						const char * modelsJson, const int modelsJsonLength,
 						const char * modelsBin, const int modelsBinLength,
@@ -210,6 +277,15 @@ void LoadModelFileJson( ModelFile & model,
 		{
 			LOG( "loading render model.." );
 
+			// Totals over all surfaces, for reporting the vertex layout and ordering savings.
+			int floatVertexBytes = 0;
+			int loadedVertexBytes = 0;
+			int loadedTriangles = 0;
+			int lodTriangles = 0;
+			int lodVertexBytes = 0;
+			float authoredTransforms = 0.0f;
+			float loadedTransforms = 0.0f;
+
 			//
 			// Render Model Textures
 			//
@@ -297,6 +373,13 @@ void LoadModelFileJson( ModelFile & model,
 						model.Joints[index].index = index;
 						model.Joints[index].name = joint.GetChildStringByName( "name" );
 						StringUtils::StringTo( model.Joints[index].transform, joint.GetChildStringByName( "transform" ) );
+						model.Joints[index].inverseTransform = model.Joints[index].transform.Inverted();
+						model.Joints[index].parent = joint.GetChildInt32ByName( "parent", -1 );
+						if ( model.Joints[index].parent >= (int)index )
+						{
+							LOG( "joint %s parent %i must come before it", model.Joints[index].name.ToCStr(), model.Joints[index].parent );
+							model.Joints[index].parent = -1;
+						}
 						model.Joints[index].animation = MODEL_JOINT_ANIMATION_NONE;
 						const String animation = joint.GetChildStringByName( "animation" );
 						if ( animation == "none" )			{ model.Joints[index].animation = MODEL_JOINT_ANIMATION_NONE; }
@@ -447,11 +530,96 @@ void LoadModelFileJson( ModelFile & model,
 							ReadModelArray( indices, triangles.GetChildStringByName( "indices" ), bin, indexCount );
 						}
 
+						//
+						// Optionally optimize the mesh. Blended surfaces keep the authored
+						// triangle order, it may be sorted back to front.
+						//
+
+						const int triangleCount = indices.GetSizeI() / 3;
+						int optimizeFlags = 0;
+						if ( materialParms.DeduplicateVertices )
+						{
+							optimizeFlags |= MESH_OPTIMIZE_DEDUPLICATE;
+						}
+						if ( materialParms.OptimizeTriangleOrder && materialType == MATERIAL_TYPE_OPAQUE && !materialParms.Transparent )
+						{
+							optimizeFlags |= MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_OVERDRAW | MESH_OPTIMIZE_VERTEX_FETCH;
+						}
+						MeshOptimizeReport optimizeReport;
+						OptimizeMesh( attribs, indices, optimizeFlags, &optimizeReport );
+						if ( optimizeFlags != 0 )
+						{
+							LogMeshOptimizeReport( model.Def.surfaces[index].surfaceName.ToCStr(), optimizeReport );
+						}
+						const float authoredAcmr = optimizeReport.acmrBefore;
+						const float loadedAcmr = optimizeReport.acmrAfter;
+
 						//
 						// Setup geometry, textures and render programs now that the vertex attributes are known.
 						//
 
-						model.Def.surfaces[index].geo.Create( attribs, indices );
+						model.Def.surfaces[index].geo.Create( attribs, indices,
+								materialParms.PackVertices ? VERTEX_LAYOUT_PACKED : VERTEX_LAYOUT_FLOAT_ARRAYS );
+
+						floatVertexBytes += GetVertexBufferSize( attribs, VERTEX_LAYOUT_FLOAT_ARRAYS );
+						loadedVertexBytes += model.Def.surfaces[index].geo.vertexBytes;
+						loadedTriangles += triangleCount;
+						authoredTransforms += authoredAcmr * triangleCount;
+						loadedTransforms += loadedAcmr * triangleCount;
+
+						//
+						// Optionally generate levels of detail, each with half the triangles
+						// of the previous one. A level is used once the bounds cover less than
+						// its screen size, where an error of LodScreenError of the view height
+						// is an error of LodScreenError / screenSize of the bounds radius.
+						//
+
+						if ( materialParms.LodLevels > 0 && triangleCount > 0 )
+						{
+							const Bounds3f & bounds = model.Def.surfaces[index].cullingBounds;
+							const float radius = bounds.GetSize().Length() * 0.5f;
+							const int lodFlags = MESH_OPTIMIZE_VERTEX_FETCH | ( optimizeFlags & MESH_OPTIMIZE_VERTEX_CACHE );
+
+							int previousTriangles = triangleCount;
+							float screenSize = materialParms.LodScreenSize;
+							for ( int level = 0; level < materialParms.LodLevels; level++, screenSize *= 0.5f )
+							{
+								Array< TriangleIndex > lodIndices;
+								const int targetTriangles = previousTriangles / 2;
+								const float error = SimplifyMesh( attribs.position, indices, targetTriangles,
+										radius * materialParms.LodScreenError / screenSize, lodIndices );
+
+								// The simplifier stops short when borders, seams or the error
+								// bound leave nothing to collapse, which is worth knowing about
+								// when tuning LodScreenError or the art.
+								const int lodTriangleCount = lodIndices.GetSizeI() / 3;
+								if ( lodTriangleCount > targetTriangles + targetTriangles / 10 )
+								{
+									LOG( "%s lod %i: simplified to %i triangles instead of %i",
+											model.Def.surfaces[index].surfaceName.ToCStr(), level + 1, lodTriangleCount, targetTriangles );
+								}
+
+								// Not worth a level if the simplifier couldn't get far.
+								if ( lodTriangleCount == 0 || lodTriangleCount > previousTriangles * 9 / 10 )
+								{
+									break;
+								}
+
+								VertexAttribs lodAttribs = attribs;
+								OptimizeMesh( lodAttribs, lodIndices, lodFlags );
+
+								SurfaceLod & lod = model.Def.surfaces[index].lods.PushDefault();
+								lod.geo.Create( lodAttribs, lodIndices, model.Def.surfaces[index].geo.layout );
+								lod.screenSize = screenSize;
+
+								LOG( "%s lod %i: %i triangles, error %f, below %4.2f of the view",
+										model.Def.surfaces[index].surfaceName.ToCStr(), level + 1, lodTriangleCount, error, screenSize );
+
+								lodVertexBytes += lod.geo.vertexBytes;
+								lodTriangles += lodTriangleCount;
+								previousTriangles = lodTriangleCount;
+							}
+						}
 
 						const char * materialTypeString = "opaque";
 
@@ -603,6 +771,22 @@ void LoadModelFileJson( ModelFile & model,
 					}
 				}
 			}
+
+			// The vertex bytes fetched per draw are roughly the vertices transformed
+			// times the bytes per vertex, so report both.
+			if ( loadedTriangles > 0 && floatVertexBytes > 0 )
+			{
+				LOG( "%s: %i triangles, vertices %i KB as float arrays, %i KB loaded (%3.0f%%), ACMR %4.2f authored, %4.2f loaded, fetch %3.0f%% of authored",
+						model.FileName.ToCStr(), loadedTriangles,
+						floatVertexBytes >> 10, loadedVertexBytes >> 10, 100.0f * loadedVertexBytes / floatVertexBytes,
+						authoredTransforms / loadedTriangles, loadedTransforms / loadedTriangles,
+						authoredTransforms > 0.0f ? 100.0f * ( loadedTransforms * loadedVertexBytes ) / ( authoredTransforms * floatVertexBytes ) : 100.0f );
+			}
+			if ( lodTriangles > 0 )
+			{
+				LOG( "%s: %i triangles in levels of detail, %i KB of vertices",
+						model.FileName.ToCStr(), lodTriangles, lodVertexBytes >> 10 );
+			}
 		}
 
 		//
@@ -714,6 +898,31 @@ void LoadModelFileJson( ModelFile & model,
 
 			ReadModelArray( traceModel.overflow, raytrace_model.GetChildStringByName( "overflow" ), bin, traceModel.header.numOverflow );
 		}
+
+		//
+		// Animations
+		//
+
+		// The binary key data follows the ray-trace model, so older files
+		// without animations read exactly as before.
+		const JsonReader animation_array( models.GetChildByName( "animations" ) );
+		if ( animation_array.IsArray() )
+		{
+			LOGV( "loading animations.." );
+
+			while ( !animation_array.IsEndOfArray() )
+			{
+				const JsonReader animation( animation_array.GetNextArrayElement() );
+				if ( animation.IsObject() )
+				{
+					ModelAnimationClip clip;
+					if ( LoadAnimationClip( animation, bin, model.Joints.GetSizeI(), clip ) )
+					{
+						model.Animations.PushBack( clip );
+					}
+				}
+			}
+		}
 	}
 	json->Release();
 
@@ -723,12 +932,93 @@ void LoadModelFileJson( ModelFile & model,
 	}
 }
 
+bool TestAnimationClipLoading()
+{
+	// Two joints and two frames, with the keys as text the way a model file
+	// without a binary part stores them. Only the first clip is valid.
+	static const char * clipsJson =
+		"{ \"animations\" : ["
+		"{ \"name\" : \"turn\", \"frameRate\" : 10, \"frameCount\" : 2, \"jointCount\" : 2, \"loop\" : false,"
+		"  \"rotations\" : \"0 0 0 1  0 0 0 1  0 0 0.70710678 0.70710678  0 0 0 1\","
+		"  \"translations\" : \"0 0 0  1 0 0  0 0 0  1 0 0\","
+		"  \"scales\" : \"1 1 1  1 1 1  2 2 2  1 1 1\" },"
+		"{ \"name\" : \"joints\", \"frameCount\" : 2, \"jointCount\" : 3,"
+		"  \"rotations\" : \"0 0 0 1  0 0 0 1  0 0 0 1  0 0 0 1  0 0 0 1  0 0 0 1\","
+		"  \"translations\" : \"0 0 0  0 0 0  0 0 0  0 0 0  0 0 0  0 0 0\" },"
+		"{ \"name\" : \"short\", \"frameCount\" : 2, \"jointCount\" : 2,"
+		"  \"rotations\" : \"0 0 0 1  0 0 0 1  0 0 0 1\","
+		"  \"translations\" : \"0 0 0  0 0 0  0 0 0  0 0 0\" },"
+		"{ \"name\" : \"rate\", \"frameRate\" : 0, \"frameCount\" : 1, \"jointCount\" : 2,"
+		"  \"rotations\" : \"0 0 0 1  0 0 0 1\","
+		"  \"translations\" : \"0 0 0  0 0 0\" }"
+		"] }";
+
+	const char * error = NULL;
+	JSON * json = JSON::Parse( clipsJson, &error );
+	if ( json == NULL )
+	{
+		LOG( "TestAnimationClipLoading: %s", error );
+		return false;
+	}
+
+	const BinaryReader bin( NULL, 0 );
+	static const bool expectedLoaded[] = { true, false, false, false };
+	const int numExpected = sizeof( expectedLoaded ) / sizeof( expectedLoaded[0] );
+
+	int numErrors = 0;
+	ModelAnimationClip turn;
+	int numClips = 0;
+	const JsonReader animation_array( JsonReader( json ).GetChildByName( "animations" ) );
+	while ( animation_array.IsArray() && !animation_array.IsEndOfArray() && numClips < numExpected )
+	{
+		ModelAnimationClip clip;
+		const bool loaded = LoadAnimationClip( JsonReader( animation_array.GetNextArrayElement() ), bin, 2, clip );
+		if ( loaded != expectedLoaded[numClips] )
+		{
+			LOG( "TestAnimationClipLoading: clip %s %s", clip.name.ToCStr(), loaded ? "loaded" : "was dropped" );
+			numErrors++;
+		}
+		if ( numClips == 0 )
+		{
+			turn = clip;
+		}
+		numClips++;
+	}
+	json->Release();
+
+	if ( numClips != numExpected )
+	{
+		LOG( "TestAnimationClipLoading: %i clips instead of %i", numClips, numExpected );
+		return false;
+	}
+	if ( numErrors > 0 )
+	{
+		return false;
+	}
+
+	// Halfway through the clip the first joint is turned 45 degrees around Z.
+	ModelAnimationPose pose;
+	turn.Sample( 0.05f, pose );
+	const Quatf expected( Vector3f( 0.0f, 0.0f, 1.0f ), Math<float>::PiOver4 );
+	const Quatf & rotation = pose.joints[0].rotation;
+	if ( fabsf( rotation.x - expected.x ) > 1e-4f || fabsf( rotation.y - expected.y ) > 1e-4f ||
+			fabsf( rotation.z - expected.z ) > 1e-4f || fabsf( rotation.w - expected.w ) > 1e-4f ||
+			fabsf( pose.joints[0].scale.x - 1.5f ) > 1e-4f || fabsf( pose.joints[1].translation.x - 1.0f ) > 1e-4f )
+	{
+		LOG( "TestAnimationClipLoading: sampled ( %f %f %f %f ) scale %f instead of ( %f %f %f %f ) scale 1.5",
+				rotation.x, rotation.y, rotation.z, rotation.w, pose.joints[0].scale.x,
+				expected.x, expected.y, expected.z, expected.w );
+		return false;
+	}
+	return true;
+}
+
 static ModelFile * LoadModelFile( unzFile zfp, const char * fileName,
 								const char * fileData, const int fileDataLength,
 								const ModelGlPrograms & programs,
 								const MaterialParms & materialParms )
 {
-	const LogCpuTime logTime( "LoadModelFile" );
+	OVR_PROFILE_TRACE_SCOPE( TRACE_LOAD, "LoadModelFile" );
 
 	ModelFile * modelPtr = new ModelFile;
 	ModelFile & model = *modelPtr;
@@ -17,6 +17,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "GlProgram.h"			// GlProgram
 #include "ModelRender.h"		// ModelState
 #include "ModelCollision.h"
+#include "ModelAnimation.h"
 #include "RayTracer/RtTrace.h"
 
 namespace OVR {
@@ -28,13 +29,25 @@ struct MaterialParms
 		EnableDiffuseAniso( false ),
 		EnableEmissiveLodClamp( true ),
 		Transparent( false ),
-		PolygonOffset( false ) { }
+		PolygonOffset( false ),
+		PackVertices( false ),
+		OptimizeTriangleOrder( false ),
+		DeduplicateVertices( false ),
+		LodLevels( 0 ),
+		LodScreenSize( 0.25f ),
+		LodScreenError( 0.005f ) { }
 
 	bool	UseSrgbTextureFormats;		// use sRGB textures
 	bool	EnableDiffuseAniso;			// enable anisotropic filtering on the diffuse texture
 	bool	EnableEmissiveLodClamp;	// enable LOD clamp on the emissive texture to avoid light bleeding
 	bool	Transparent;				// surfaces with this material flag need to render in a transparent pass
 	bool	PolygonOffset;				// render with polygon offset enabled
+	bool	PackVertices;				// interleave and compress the vertices, see VERTEX_LAYOUT_PACKED
+	bool	OptimizeTriangleOrder;		// reorder the triangles and vertices of opaque surfaces for the vertex caches and overdraw
+	bool	DeduplicateVertices;		// merge identical vertices on all surfaces
+	int		LodLevels;					// generate up to this many simplified levels of detail for every surface
+	float	LodScreenSize;				// fraction of the view height below which the first level of detail is used, halved for every next level
+	float	LodScreenError;				// largest simplification error allowed, as a fraction of the view height
 };
 
 struct ModelTexture
@@ -54,8 +67,10 @@ enum ModelJointAnimation
 struct ModelJoint
 {
 	int					index;
+	int					parent;				// -1 for a root, otherwise less than index
 	String				name;
-	Matrix4f			transform;
+	Matrix4f			transform;			// bind pose in model space
+	Matrix4f			inverseTransform;	// calculated at load time
 	ModelJointAnimation	animation;
 	Vector3f			parameters;
 	float				timeOffset;
@@ -84,6 +99,7 @@ public:
 	const ModelTexture *		FindNamedTexture( const char * name ) const;
 	const ModelJoint *			FindNamedJoint( const char * name ) const;
 	const ModelTag *			FindNamedTag( const char * name ) const;
+	const ModelAnimationClip *	FindNamedAnimation( const char * name ) const;
 
 	int							GetJointCount() const { return Joints.GetSizeI(); }
 	const ModelJoint *			GetJoint( const int index ) const { return &Joints[index]; }
@@ -103,6 +119,9 @@ public:
 
 	Array< ModelTag >			Tags;
 
+	// Keyframed clips for the joints above.
+	Array< ModelAnimationClip >	Animations;
+
 	// This is used by the rendering code
 	ModelDef					Def;
 
@@ -165,6 +184,10 @@ ModelFile * LoadModelFile( const char * fileName,
 		const ModelGlPrograms & programs,
 		const MaterialParms & materialParms );
 
+// Checks that animation clips with text encoded keys load and sample, and
+// that clips that don't fit the model are dropped. Doesn't need GL.
+bool TestAnimationClipLoading();
+
 } // namespace OVR
 
 #endif	// MODELFILE_H
@@ -12,12 +12,15 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "ModelRender.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 
 #include "GlUtils.h"
 #include "GlTexture.h"
 #include "GlProgram.h"
 #include "Log.h"
+#include "Profiler.h"
+#include "VrApi/VrApi.h"		// ovr_GetTimeInSeconds
 
 
 
@@ -180,12 +183,82 @@ float BoundsSortCullKey( const Bounds3f & bounds, const Matrix4f & mvp ) {
 	return maxW;		// couldn't cull
 }
 
+// A level of detail is only left again once the projected size has moved this
+// far past its threshold, so a surface that hovers around a threshold doesn't
+// pop back and forth every frame.
+static const float LOD_HYSTERESIS = 0.1f;
+
+static float ModelLodBias = 1.0f;
+
+void SetModelLodBias( const float bias )
+{
+	ModelLodBias = bias;
+}
+
+float GetModelLodBias()
+{
+	return ModelLodBias;
+}
+
+void SurfaceLodHistory::Reset()
+{
+	if ( Lods.GetSizeI() > 0 )
+	{
+		memset( &Lods[0], 0, Lods.GetSizeI() * sizeof( UByte ) );
+	}
+}
+
+// Returns the level of detail for a surface that covers screenSize of the view
+// height, starting from the level it was drawn with last frame. Level 0 is the
+// full detail geometry and level N is lods[N-1].
+static int SelectSurfaceLod( const SurfaceDef & surfaceDef, const float screenSize, int lod )
+{
+	const int numLods = surfaceDef.lods.GetSizeI();
+	if ( lod > numLods )
+	{
+		lod = numLods;
+	}
+	while ( lod < numLods && screenSize < surfaceDef.lods[lod].screenSize * ( 1.0f - LOD_HYSTERESIS ) )
+	{
+		lod++;
+	}
+	while ( lod > 0 && screenSize > surfaceDef.lods[lod - 1].screenSize * ( 1.0f + LOD_HYSTERESIS ) )
+	{
+		lod--;
+	}
+	return lod;
+}
+
+// The largest scale of the model matrix, for scaling bounds radii.
+static float MaxModelScale( const Matrix4f & modelMatrix )
+{
+	float maxLengthSq = 0.0f;
+	for ( int i = 0; i < 3; i++ )
+	{
+		const float lengthSq = modelMatrix.M[0][i] * modelMatrix.M[0][i] +
+							modelMatrix.M[1][i] * modelMatrix.M[1][i] +
+							modelMatrix.M[2][i] * modelMatrix.M[2][i];
+		maxLengthSq = Alg::Max( maxLengthSq, lengthSq );
+	}
+	return sqrtf( maxLengthSq );
+}
+
+struct CullCounters
+{
+	CullCounters() : numCulled( 0 ), numTriangles( 0 ), numFullDetailTriangles( 0 ) {}
+
+	int		numCulled;
+	int		numTriangles;
+	int		numFullDetailTriangles;
+};
+
 struct bsort_t
 {
 	float						key;
-	const DrawMatrices * 		matrices;
+	int							matricesIndex;		// shared by every eye list
 	const Array< Matrix4f > *	joints;
 	const SurfaceDef *			surface;
+	const GlGeometry *			geo;
 	GLuint						textureOverload;	// if 0, there's no overload
 	bool						transparent;
 };
@@ -235,30 +308,72 @@ int bsortComp( const void * p1, const void * p2 )
 	return -1;
 }
 
-const DrawSurfaceList & BuildDrawSurfaceList( const OVR::Array<ModelState> & modelRenderList,
-			const Matrix4f & viewMatrix, const Matrix4f & projectionMatrix )
+// A mobile GPU will be in trouble if it draws more than this.
+static const int MAX_DRAW_SURFACES = 1024;
+static const int MAX_DRAW_MODELS = 128;
+
+// The surface lists can be built from either an array of ModelState or an array
+// of pointers to persistent ModelState, which avoids copying the joints.
+static inline const ModelState & GetModelState( const ModelState & modelState ) { return modelState; }
+static inline const ModelState & GetModelState( const ModelState * modelState ) { return *modelState; }
+
+// Culls every surface once against cullVpMatrix and sorts them once, then fills
+// in numEyes surface lists that are identical except for the matrices they point
+// to. The eye MVPs are only calculated for models with a visible surface, and
+// if eye0IsCull is set the culling MVP is used for eye 0 instead of calculated
+// again. The levels of detail are selected by the size of the surface bounds
+// in the culling projection, whose vertical scale is projectionScale, and
+// lodHistory is updated with them if it isn't NULL.
+// Returns the number of surfaces in each list.
+template< typename _modelList_ >
+static int CullAndSortSurfaces( const _modelList_ & modelRenderList,
+			const Matrix4f & cullVpMatrix, const float projectionScale, const int numEyes,
+			const Matrix4f * eyeVpMatrices, const bool eye0IsCull, DrawMatrices * const * eyeDrawMatrices,
+			DrawSurface * const * eyeDrawSurfaces, SurfaceLodHistory * lodHistory, CullCounters & counters )
 {
-	// A mobile GPU will be in trouble if it draws more than this.
-	static const int MAX_DRAW_SURFACES = 1024;
 	bsort_t	bsort[ MAX_DRAW_SURFACES ];
-	static const int MAX_DRAW_MODELS = 128;
-	static DrawMatrices drawMatrices[MAX_DRAW_MODELS];
-
-	const Matrix4f vpMatrix = ( projectionMatrix * viewMatrix ).Transposed();
 
 	int	numSurfaces = 0;
 	int	numDrawMatrices = 0;
-	int	cullCount = 0;
+	counters = CullCounters();
+
+	const float lodScale = projectionScale * ModelLodBias;
+
+	// A history that doesn't match the list any more starts over.
+	UByte * historyLods = NULL;
+	if ( lodHistory != NULL )
+	{
+		int numHistorySurfaces = 0;
+		for ( int modelNum = 0; modelNum < modelRenderList.GetSizeI(); modelNum++ )
+		{
+			const ModelState & modelState = GetModelState( modelRenderList[ modelNum ] );
+			if ( !modelState.Flags.Hide )
+			{
+				numHistorySurfaces += modelState.modelDef->surfaces.GetSizeI();
+			}
+		}
+		if ( lodHistory->Lods.GetSizeI() != numHistorySurfaces )
+		{
+			lodHistory->Lods.Resize( numHistorySurfaces );
+			lodHistory->Reset();
+		}
+		historyLods = lodHistory->Lods.GetDataPtr();
+	}
 
 	// Loop through all the models
 	for ( int modelNum = 0; modelNum < modelRenderList.GetSizeI(); modelNum++ )
 	{
-		const ModelState & modelState = modelRenderList[ modelNum ];
+		const ModelState & modelState = GetModelState( modelRenderList[ modelNum ] );
 		if ( modelState.Flags.Hide )
 		{
 			continue;
 		}
 		const ModelDef & modelDef = *modelState.modelDef;
+		UByte * const modelLods = historyLods;
+		if ( historyLods != NULL )
+		{
+			historyLods += modelDef.surfaces.GetSizeI();
+		}
 
 		// make a table of surface texture overloads so we are only doing table look ups per-surface
 		// most models will never have these
@@ -280,17 +395,17 @@ const DrawSurfaceList & BuildDrawSurfaceList( const OVR::Array<ModelState> & mod
 			break;
 		}
 
-		DrawMatrices & matrices = drawMatrices[numDrawMatrices++];
-
-		matrices.Model = modelState.modelMatrix.Transposed();
-		matrices.Mvp = matrices.Model * vpMatrix;
+		const Matrix4f modelMatrix = modelState.modelMatrix.Transposed();
+		const Matrix4f cullMvp = modelMatrix * cullVpMatrix;
+		int matricesIndex = -1;
+		float modelScale = -1.0f;	// only needed for surfaces with levels of detail
 
 		for ( int surfaceNum = 0; surfaceNum < modelDef.surfaces.GetSizeI(); surfaceNum++ ) {
 			const SurfaceDef & surfaceDef = modelDef.surfaces[ surfaceNum ];
-			const float sort = BoundsSortCullKey( surfaceDef.cullingBounds, matrices.Mvp );
+			const float sort = BoundsSortCullKey( surfaceDef.cullingBounds, cullMvp );
 			if ( sort == 0 ) 
 			{
-				cullCount++;
+				counters.numCulled++;
 				continue;
 			}
 
@@ -299,10 +414,51 @@ const DrawSurfaceList & BuildDrawSurfaceList( const OVR::Array<ModelState> & mod
 				break;
 			}
 
+			// build the per-eye matrices the first time a surface is visible
+			if ( matricesIndex == -1 )
+			{
+				matricesIndex = numDrawMatrices++;
+				for ( int eye = 0; eye < numEyes; eye++ )
+				{
+					DrawMatrices & matrices = eyeDrawMatrices[eye][matricesIndex];
+					matrices.Model = modelMatrix;
+					matrices.Mvp = ( eye == 0 && eye0IsCull ) ? cullMvp : modelMatrix * eyeVpMatrices[eye];
+				}
+			}
+
+			// pick the level of detail by the projected size of the bounding sphere
+			const GlGeometry * geo = &surfaceDef.geo;
+			if ( surfaceDef.lods.GetSizeI() > 0 )
+			{
+				if ( modelScale < 0.0f )
+				{
+					modelScale = MaxModelScale( modelState.modelMatrix );
+				}
+				const Vector3f center = surfaceDef.cullingBounds.GetCenter();
+				const float radius = surfaceDef.cullingBounds.GetSize().Length() * 0.5f * modelScale;
+				const float w = GLTransform( cullMvp, Vector4f( center.x, center.y, center.z, 1.0f ) ).w;
+				int lod = 0;
+				if ( w > radius )
+				{
+					lod = SelectSurfaceLod( surfaceDef, radius * lodScale / w, ( modelLods != NULL ) ? modelLods[surfaceNum] : 0 );
+				}
+				if ( modelLods != NULL )
+				{
+					modelLods[surfaceNum] = (UByte)lod;
+				}
+				if ( lod > 0 )
+				{
+					geo = &surfaceDef.lods[lod - 1].geo;
+				}
+			}
+			counters.numTriangles += geo->indexCount / 3;
+			counters.numFullDetailTriangles += surfaceDef.geo.indexCount / 3;
+
 			bsort[ numSurfaces ].key = sort;
-			bsort[ numSurfaces ].matrices = &matrices;
+			bsort[ numSurfaces ].matricesIndex = matricesIndex;
 			bsort[ numSurfaces ].joints = &modelState.Joints;
 			bsort[ numSurfaces ].surface = &surfaceDef;
+			bsort[ numSurfaces ].geo = geo;
 			bsort[ numSurfaces ].textureOverload = surfaceNum < MAX_TEXTURE_OVERLOADS_PER_MODEL ? surfaceOverloads[surfaceNum] : 0;
 			bsort[ numSurfaces ].transparent = surfaceDef.materialDef.gpuState.blendEnable;
 			if ( bsort[ numSurfaces ].textureOverload > 0 )
@@ -316,30 +472,404 @@ const DrawSurfaceList & BuildDrawSurfaceList( const OVR::Array<ModelState> & mod
 	// sort by the far W
 	qsort( bsort, numSurfaces, sizeof( bsort[0] ), bsortComp );
 
-	// extract the drawSurface_t info
-	static DrawSurface drawSurfaces[ MAX_DRAW_SURFACES ];
-	for ( int i = 0; i < numSurfaces; i++ ) 
+	// extract the drawSurface_t info for each eye
+	for ( int eye = 0; eye < numEyes; eye++ )
 	{
-		drawSurfaces[i].matrices = bsort[i].matrices;
-		drawSurfaces[i].joints = bsort[i].joints;
-		drawSurfaces[i].surface = bsort[i].surface;
-		drawSurfaces[i].textureOverload = bsort[i].textureOverload;
+		DrawSurface * drawSurfaces = eyeDrawSurfaces[eye];
+		for ( int i = 0; i < numSurfaces; i++ ) 
+		{
+			drawSurfaces[i].matrices = &eyeDrawMatrices[eye][bsort[i].matricesIndex];
+			drawSurfaces[i].joints = bsort[i].joints;
+			drawSurfaces[i].surface = bsort[i].surface;
+			drawSurfaces[i].geo = bsort[i].geo;
+			drawSurfaces[i].textureOverload = bsort[i].textureOverload;
+		}
 	}
 
-//	LOG( "Culled %i, draw %i", cullCount, numSurfaces );
-	static DrawSurfaceList surfaceList;
+	return numSurfaces;
+}
+
+static DrawMatrices			MonoDrawMatrices[MAX_DRAW_MODELS];
+static DrawSurface			MonoDrawSurfaces[ MAX_DRAW_SURFACES ];
+static DrawSurfaceList		MonoSurfaceList;
+
+static DrawMatrices			StereoDrawMatrices[2][MAX_DRAW_MODELS];
+static DrawSurface			StereoDrawSurfaces[2][ MAX_DRAW_SURFACES ];
+static StereoDrawSurfaceList	StereoSurfaceList;
+
+template< typename _modelList_ >
+static const DrawSurfaceList & BuildDrawSurfaceListInternal( const _modelList_ & modelRenderList,
+			const Matrix4f & viewMatrix, const Matrix4f & projectionMatrix, SurfaceLodHistory * lodHistory )
+{
+	OVR_PROFILE_SCOPE( "BuildDrawSurfaceList" );
+
+	DrawMatrices * drawMatrices = MonoDrawMatrices;
+	DrawSurface * drawSurfaces = MonoDrawSurfaces;
+
+	const Matrix4f vpMatrix = ( projectionMatrix * viewMatrix ).Transposed();
+
+	DrawMatrices * const eyeDrawMatrices[1] = { drawMatrices };
+	DrawSurface * const eyeDrawSurfaces[1] = { drawSurfaces };
+
+	CullCounters counters;
+	const int numSurfaces = CullAndSortSurfaces( modelRenderList, vpMatrix, projectionMatrix.M[1][1],
+			1, &vpMatrix, true, eyeDrawMatrices, eyeDrawSurfaces, lodHistory, counters );
+
+//	LOG( "Culled %i, draw %i", counters.numCulled, numSurfaces );
+	DrawSurfaceList & surfaceList = MonoSurfaceList;
 	surfaceList.viewMatrix = viewMatrix.Transposed();
 	surfaceList.projectionMatrix = projectionMatrix.Transposed();
 	surfaceList.numDrawSurfaces = numSurfaces;
 	surfaceList.drawSurfaces = drawSurfaces;
-	surfaceList.numCulledSurfaces = cullCount;
+	surfaceList.numCulledSurfaces = counters.numCulled;
+	surfaceList.numTriangles = counters.numTriangles;
+	surfaceList.numFullDetailTriangles = counters.numFullDetailTriangles;
 
 	return surfaceList;
 }
 
+template< typename _modelList_ >
+static const StereoDrawSurfaceList & BuildStereoDrawSurfaceListInternal( const _modelList_ & modelRenderList,
+			const Matrix4f & cullViewMatrix, const Matrix4f & cullProjectionMatrix,
+			const Matrix4f * viewMatrices, const Matrix4f * projectionMatrices, SurfaceLodHistory * lodHistory )
+{
+	DrawMatrices (*drawMatrices)[MAX_DRAW_MODELS] = StereoDrawMatrices;
+	DrawSurface (*drawSurfaces)[MAX_DRAW_SURFACES] = StereoDrawSurfaces;
+
+	const Matrix4f cullVpMatrix = ( cullProjectionMatrix * cullViewMatrix ).Transposed();
+	const Matrix4f eyeVpMatrices[2] =
+	{
+		( projectionMatrices[0] * viewMatrices[0] ).Transposed(),
+		( projectionMatrices[1] * viewMatrices[1] ).Transposed()
+	};
+
+	DrawMatrices * const eyeDrawMatrices[2] = { drawMatrices[0], drawMatrices[1] };
+	DrawSurface * const eyeDrawSurfaces[2] = { drawSurfaces[0], drawSurfaces[1] };
+
+	CullCounters counters;
+	const int numSurfaces = CullAndSortSurfaces( modelRenderList, cullVpMatrix, cullProjectionMatrix.M[1][1],
+			2, eyeVpMatrices, false, eyeDrawMatrices, eyeDrawSurfaces, lodHistory, counters );
+
+	StereoDrawSurfaceList & stereoList = StereoSurfaceList;
+	stereoList.generation++;
+	for ( int eye = 0; eye < 2; eye++ )
+	{
+		DrawSurfaceList & surfaceList = stereoList.eyes[eye];
+		surfaceList.viewMatrix = viewMatrices[eye].Transposed();
+		surfaceList.projectionMatrix = projectionMatrices[eye].Transposed();
+		surfaceList.numDrawSurfaces = numSurfaces;
+		surfaceList.drawSurfaces = drawSurfaces[eye];
+		surfaceList.numCulledSurfaces = counters.numCulled;
+		surfaceList.numTriangles = counters.numTriangles;
+		surfaceList.numFullDetailTriangles = counters.numFullDetailTriangles;
+	}
+
+	return stereoList;
+}
+
+const DrawSurfaceList & BuildDrawSurfaceList( const OVR::Array<ModelState> & modelRenderList,
+			const Matrix4f & viewMatrix, const Matrix4f & projectionMatrix, SurfaceLodHistory * lodHistory )
+{
+	return BuildDrawSurfaceListInternal( modelRenderList, viewMatrix, projectionMatrix, lodHistory );
+}
+
+const DrawSurfaceList & BuildDrawSurfaceList( const OVR::Array<const ModelState *> & modelRenderList,
+			const Matrix4f & viewMatrix, const Matrix4f & projectionMatrix, SurfaceLodHistory * lodHistory )
+{
+	return BuildDrawSurfaceListInternal( modelRenderList, viewMatrix, projectionMatrix, lodHistory );
+}
+
+const StereoDrawSurfaceList & BuildStereoDrawSurfaceList( const OVR::Array<ModelState> & modelRenderList,
+			const Matrix4f & cullViewMatrix, const Matrix4f & cullProjectionMatrix,
+			const Matrix4f * viewMatrices, const Matrix4f * projectionMatrices, SurfaceLodHistory * lodHistory )
+{
+	return BuildStereoDrawSurfaceListInternal( modelRenderList, cullViewMatrix, cullProjectionMatrix,
+			viewMatrices, projectionMatrices, lodHistory );
+}
+
+const StereoDrawSurfaceList & BuildStereoDrawSurfaceList( const OVR::Array<const ModelState *> & modelRenderList,
+			const Matrix4f & cullViewMatrix, const Matrix4f & cullProjectionMatrix,
+			const Matrix4f * viewMatrices, const Matrix4f * projectionMatrices, SurfaceLodHistory * lodHistory )
+{
+	return BuildStereoDrawSurfaceListInternal( modelRenderList, cullViewMatrix, cullProjectionMatrix,
+			viewMatrices, projectionMatrices, lodHistory );
+}
+
+// A grid of boxes around the viewer, so roughly a quarter of them are in view.
+static void BuildGridScene( const int numModels, const int surfacesPerModel, ModelDef & def, Array< ModelState > & models )
+{
+	def.surfaces.Resize( surfacesPerModel );
+	for ( int i = 0; i < surfacesPerModel; i++ )
+	{
+		def.surfaces[i].cullingBounds = Bounds3f( Vector3f( -0.5f, i * 0.1f, -0.5f ), Vector3f( 0.5f, i * 0.1f + 1.0f, 0.5f ) );
+	}
+
+	models.Resize( numModels );
+	const int side = (int)sqrtf( (float)numModels ) + 1;
+	for ( int i = 0; i < numModels; i++ )
+	{
+		models[i] = ModelState( def );
+		models[i].modelMatrix = Matrix4f::Translation( ( i % side - side / 2 ) * 2.0f, 0.0f, ( i / side - side / 2 ) * 2.0f );
+	}
+}
+
+// The matrices for frame iter of the scene, turning in place.
+struct GridSceneView
+{
+	GridSceneView( const int iter ) :
+		fov( DegreeToRad( 90.0f ) ),
+		halfIpd( 0.032f ),
+		pullBack( halfIpd / tanf( fov * 0.5f ) ),
+		view( Matrix4f::RotationY( iter * 0.01f ) ),
+		projection( Matrix4f::PerspectiveRH( fov, 1.0f, 0.1f, 1000.0f ) ),
+		cullView( Matrix4f::Translation( 0, 0, -pullBack ) * view ),
+		cullProjection( Matrix4f::PerspectiveRH( fov, 1.0f, 0.1f + pullBack, 1000.0f + pullBack ) )
+	{
+		views[0] = Matrix4f::Translation( halfIpd, 0, 0 ) * view;
+		views[1] = Matrix4f::Translation( -halfIpd, 0, 0 ) * view;
+		projections[0] = projection;
+		projections[1] = projection;
+	}
+
+	float		fov;
+	float		halfIpd;
+	float		pullBack;
+	Matrix4f	view;
+	Matrix4f	projection;
+	Matrix4f	cullView;
+	Matrix4f	cullProjection;
+	Matrix4f	views[2];
+	Matrix4f	projections[2];
+};
+
+static bool MatricesMatch( const Matrix4f & a, const Matrix4f & b )
+{
+	for ( int i = 0; i < 4; i++ )
+	{
+		for ( int j = 0; j < 4; j++ )
+		{
+			if ( fabsf( a.M[i][j] - b.M[i][j] ) > 1e-4f * ( 1.0f + fabsf( a.M[i][j] ) ) )
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool TestStereoDrawSurfaceLists()
+{
+	ModelDef def;
+	Array< ModelState > models;
+	BuildGridScene( 100, 4, def, models );
+
+	int numErrors = 0;
+	for ( int iter = 0; iter < 64 && numErrors == 0; iter++ )
+	{
+		const GridSceneView scene( iter * 10 );
+		const StereoDrawSurfaceList & stereo = BuildStereoDrawSurfaceList( models,
+				scene.cullView, scene.cullProjection, scene.views, scene.projections );
+
+		const DrawSurfaceList & left = stereo.eyes[0];
+		const DrawSurfaceList & right = stereo.eyes[1];
+		if ( left.numDrawSurfaces != right.numDrawSurfaces || left.numDrawSurfaces == 0 )
+		{
+			LOG( "TestStereoDrawSurfaceLists: %i left and %i right surfaces", left.numDrawSurfaces, right.numDrawSurfaces );
+			numErrors++;
+			continue;
+		}
+		for ( int i = 0; i < left.numDrawSurfaces; i++ )
+		{
+			if ( left.drawSurfaces[i].surface != right.drawSurfaces[i].surface
+					|| !MatricesMatch( left.drawSurfaces[i].matrices->Model, right.drawSurfaces[i].matrices->Model ) )
+			{
+				LOG( "TestStereoDrawSurfaceLists: surface %i differs between the eyes", i );
+				numErrors++;
+				break;
+			}
+		}
+
+		// The stereo list is culled against a frustum that contains both
+		// eyes, so it can have more surfaces than either eye, never fewer.
+		for ( int eye = 0; eye < 2; eye++ )
+		{
+			const DrawSurfaceList & stereoEye = stereo.eyes[eye];
+			const DrawSurfaceList & mono = BuildDrawSurfaceList( models, scene.views[eye], scene.projections[eye] );
+			for ( int i = 0; i < mono.numDrawSurfaces; i++ )
+			{
+				const DrawSurface & m = mono.drawSurfaces[i];
+				int found = -1;
+				for ( int j = 0; j < stereoEye.numDrawSurfaces && found < 0; j++ )
+				{
+					const DrawSurface & s = stereoEye.drawSurfaces[j];
+					if ( s.surface == m.surface && MatricesMatch( s.matrices->Model, m.matrices->Model ) )
+					{
+						found = j;
+					}
+				}
+				if ( found < 0 )
+				{
+					LOG( "TestStereoDrawSurfaceLists: eye %i surface %i is missing from the stereo list", eye, i );
+					numErrors++;
+					break;
+				}
+				if ( !MatricesMatch( stereoEye.drawSurfaces[found].matrices->Mvp, m.matrices->Mvp ) )
+				{
+					LOG( "TestStereoDrawSurfaceLists: eye %i surface %i has a different MVP", eye, i );
+					numErrors++;
+					break;
+				}
+			}
+		}
+	}
+
+	return numErrors == 0;
+}
+
+// The level a single model with levels of detail is drawn with when its bounds
+// cover screenSize of the view height, or -1 if it isn't drawn.
+static int DrawnSurfaceLod( Array< ModelState > & models, const float screenSize, SurfaceLodHistory * lodHistory )
+{
+	const SurfaceDef & surfaceDef = models[0].modelDef->surfaces[0];
+	const float radius = surfaceDef.cullingBounds.GetSize().Length() * 0.5f;
+	models[0].modelMatrix = Matrix4f::Translation( 0.0f, 0.0f, -radius / screenSize );
+
+	// A 90 degree field of view, so the vertical projection scale is 1.
+	const DrawSurfaceList & list = BuildDrawSurfaceList( models, Matrix4f(),
+			Matrix4f::PerspectiveRH( DegreeToRad( 90.0f ), 1.0f, 0.1f, 1000.0f ), lodHistory );
+	if ( list.numDrawSurfaces != 1 )
+	{
+		return -1;
+	}
+	for ( int lod = 0; lod < surfaceDef.lods.GetSizeI(); lod++ )
+	{
+		if ( list.drawSurfaces[0].geo == &surfaceDef.lods[lod].geo )
+		{
+			return lod + 1;
+		}
+	}
+	return ( list.drawSurfaces[0].geo == &surfaceDef.geo ) ? 0 : -1;
+}
+
+bool TestSurfaceLodSelection()
+{
+	ModelDef def;
+	def.surfaces.Resize( 1 );
+	SurfaceDef & surfaceDef = def.surfaces[0];
+	surfaceDef.cullingBounds = Bounds3f( Vector3f( -1.0f ), Vector3f( 1.0f ) );
+	surfaceDef.lods.Resize( 2 );
+	surfaceDef.lods[0].screenSize = 0.5f;
+	surfaceDef.lods[1].screenSize = 0.25f;
+
+	int numErrors = 0;
+
+	// A level is only left once the size is LOD_HYSTERESIS past its threshold.
+	static const struct { float screenSize; int previous; int expected; } cases[] =
+	{
+		{ 0.46f, 0, 0 },
+		{ 0.44f, 0, 1 },
+		{ 0.54f, 1, 1 },
+		{ 0.56f, 1, 0 },
+		{ 0.24f, 1, 1 },
+		{ 0.22f, 1, 2 },
+		{ 0.27f, 2, 2 },
+		{ 0.28f, 2, 1 },
+		{ 0.10f, 0, 2 },	// several levels in one step
+		{ 0.90f, 2, 0 },
+		{ 0.40f, 5, 1 }		// a stale level past the last one
+	};
+	for ( int i = 0; i < (int)( sizeof( cases ) / sizeof( cases[0] ) ); i++ )
+	{
+		const int lod = SelectSurfaceLod( surfaceDef, cases[i].screenSize, cases[i].previous );
+		if ( lod != cases[i].expected )
+		{
+			LOG( "TestSurfaceLodSelection: size %4.2f from level %i selected %i instead of %i",
+					cases[i].screenSize, cases[i].previous, lod, cases[i].expected );
+			numErrors++;
+		}
+	}
+
+	// The same through the surface lists. Moving in and out inside a band only
+	// keeps the level when the history is passed along.
+	const float lodBias = GetModelLodBias();
+	SetModelLodBias( 1.0f );
+
+	Array< ModelState > models;
+	models.PushBack( ModelState( def ) );
+	SurfaceLodHistory history;
+	static const struct { float screenSize; bool useHistory; int expected; } steps[] =
+	{
+		{ 0.60f, true, 0 },
+		{ 0.47f, true, 0 },
+		{ 0.40f, true, 1 },
+		{ 0.53f, true, 1 },
+		{ 0.53f, false, 0 },
+		{ 0.53f, true, 1 },
+		{ 0.20f, true, 2 },
+		{ 0.26f, true, 2 }
+	};
+	for ( int i = 0; i < (int)( sizeof( steps ) / sizeof( steps[0] ) ); i++ )
+	{
+		const int lod = DrawnSurfaceLod( models, steps[i].screenSize, steps[i].useHistory ? &history : NULL );
+		if ( lod != steps[i].expected )
+		{
+			LOG( "TestSurfaceLodSelection: step %i, size %4.2f %s history, drew level %i instead of %i",
+					i, steps[i].screenSize, steps[i].useHistory ? "with" : "without", lod, steps[i].expected );
+			numErrors++;
+		}
+	}
+	history.Reset();
+	if ( DrawnSurfaceLod( models, 0.27f, &history ) != 1 )
+	{
+		LOG( "TestSurfaceLodSelection: the history wasn't started over" );
+		numErrors++;
+	}
+
+	SetModelLodBias( lodBias );
+
+	return numErrors == 0;
+}
+
+void BenchmarkDrawSurfaceLists()
+{
+	static const int NUM_ITERATIONS = 200;
+
+	ModelDef def;
+	Array< ModelState > models;
+	BuildGridScene( 100, 8, def, models );
+
+	double monoSeconds = 0.0;
+	double stereoSeconds = 0.0;
+	int monoSurfaces = 0;
+	int stereoSurfaces = 0;
+	for ( int iter = 0; iter < NUM_ITERATIONS; iter++ )
+	{
+		const GridSceneView scene( iter );
+
+		const double start = ovr_GetTimeInSeconds();
+		for ( int eye = 0; eye < 2; eye++ )
+		{
+			monoSurfaces += BuildDrawSurfaceList( models, scene.views[eye], scene.projections[eye] ).numDrawSurfaces;
+		}
+		const double middle = ovr_GetTimeInSeconds();
+		const StereoDrawSurfaceList & stereo = BuildStereoDrawSurfaceList( models,
+				scene.cullView, scene.cullProjection, scene.views, scene.projections );
+		stereoSurfaces += stereo.eyes[0].numDrawSurfaces + stereo.eyes[1].numDrawSurfaces;
+		const double end = ovr_GetTimeInSeconds();
+
+		monoSeconds += middle - start;
+		stereoSeconds += end - middle;
+	}
+
+	LOG( "BenchmarkDrawSurfaceLists( %i models, %i surfaces ): per eye %5.3f ms, stereo %5.3f ms, %5.1f vs %5.1f surfaces per frame",
+			models.GetSizeI(), def.surfaces.GetSizeI(), monoSeconds * 1000.0 / NUM_ITERATIONS, stereoSeconds * 1000.0 / NUM_ITERATIONS,
+			(float)monoSurfaces / NUM_ITERATIONS, (float)stereoSurfaces / NUM_ITERATIONS );
+}
 
 // Renders a list of pointers to models in order.
 DrawCounters RenderSurfaceList( const DrawSurfaceList & drawSurfaceList ) {
+	OVR_PROFILE_SCOPE( "RenderSurfaceList" );
+
 	// This state could be made to persist across multiple calls to RenderModelList,
 	// but the benefit would be small.
 	GpuState			currentGpuState;
@@ -451,9 +981,10 @@ DrawCounters RenderSurfaceList( const DrawSurfaceList & drawSurfaceList ) {
 		}
 
 		counters.numDrawCalls++;
+		counters.numElements += drawSurface.geo->indexCount;
 
 		// Bind all the vertex and element arrays
-		surfaceDef.geo.Draw();
+		drawSurface.geo->Draw();
 	}
 
 	// set the gpu state back to the default
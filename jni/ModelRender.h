@@ -99,6 +99,16 @@ struct MaterialDef
 	GlTexture	textures[MAX_PROGRAM_TEXTURES];
 };
 
+// A cheaper version of a surface, drawn in place of it when the surface
+// covers less than screenSize of the view height.
+struct SurfaceLod
+{
+	SurfaceLod() : screenSize( 0.0f ) {}
+
+	GlGeometry		geo;
+	float			screenSize;
+};
+
 struct SurfaceDef
 {
 	SurfaceDef() {};
@@ -118,6 +128,12 @@ struct SurfaceDef
 	// so it might be worth trying.
 	GlGeometry		geo;
 
+	// Progressively coarser versions of geo, in order of decreasing
+	// screenSize. They are either authored or generated at load time, and
+	// must use the same material. The culling bounds of the full detail
+	// geometry are used for all of them.
+	Array< SurfaceLod >	lods;
+
 	// This could be a constant reference, but inline has some
 	// advantages for now while the definition is small.
 	MaterialDef		materialDef;
@@ -173,6 +189,20 @@ struct ModelState
 	OVR::ArrayPOD< SurfaceTextureOverload > SurfaceTextureOverloads;
 };
 
+// The level of detail each surface of a model list was last drawn with, 0
+// being full detail, so the selection can lag behind small changes in size
+// instead of flickering between levels. Kept by whoever culls the same list
+// every frame, and passed to the surface list builders. Lists built without
+// one select every level from scratch.
+struct SurfaceLodHistory
+{
+	// Starts every surface over from full detail, without freeing anything.
+	void	Reset();
+
+	// The surfaces of the visible models, in list order.
+	OVR::ArrayPOD< UByte >	Lods;
+};
+
 struct DrawCounters
 {
 	DrawCounters() : numElements( 0 ), numDrawCalls( 0 ), numProgramBinds( 0 ), numParameterUpdates( 0 ), numTextureBinds( 0 ) {}
@@ -200,6 +230,7 @@ struct DrawSurface
 	const DrawMatrices *		matrices;			// OpenGL column major
 	const Array< Matrix4f > *	joints;				// OpenGL column major
 	const SurfaceDef *			surface;
+	const GlGeometry *			geo;				// surface->geo or one of its levels of detail
 	GLuint						textureOverload;	// if != 0, overload with this texture handle
 };
 
@@ -208,17 +239,72 @@ struct DrawSurfaceList
 	Matrix4f				viewMatrix;				// OpenGL column major
 	Matrix4f				projectionMatrix;		// OpenGL column major
 	int						numCulledSurfaces;		// just for developer feedback
+	int						numTriangles;			// with the selected levels of detail
+	int						numFullDetailTriangles;	// if every surface were drawn at full detail
 	int						numDrawSurfaces;
 	const DrawSurface *		drawSurfaces;
 };
 
 
+// Scales the projected sizes that the levels of detail are selected by.
+// Values below 1.0 switch to coarser levels earlier, which can be used to
+// trade detail for speed when the scene is over its triangle budget.
+void	SetModelLodBias( const float bias );
+float	GetModelLodBias();
+
 // Culls the surfaces in the model list to the MVP matrix and sorts front to back.
+// Selects the level of detail of every visible surface by the size of its
+// bounds in the projection, relative to the levels in lodHistory if there is one.
 // Not thread safe, uses a static buffer for the surfaces.
 // Additional, application specific culling or surface insertion can be done on the
 // results of this call before calling DrawSurfaceList.
+// The pointer versions let the caller keep persistent ModelStates instead of
+// copying them, joints and all, into a new array every frame.
 const DrawSurfaceList & BuildDrawSurfaceList( const OVR::Array<ModelState> & modelRenderList,
-							const Matrix4f & viewMatrix, const Matrix4f & projectionMatrix );
+							const Matrix4f & viewMatrix, const Matrix4f & projectionMatrix,
+							SurfaceLodHistory * lodHistory = NULL );
+const DrawSurfaceList & BuildDrawSurfaceList( const OVR::Array<const ModelState *> & modelRenderList,
+							const Matrix4f & viewMatrix, const Matrix4f & projectionMatrix,
+							SurfaceLodHistory * lodHistory = NULL );
+
+// The same surfaces in the same order for both eyes, each with its own matrices.
+struct StereoDrawSurfaceList
+{
+	StereoDrawSurfaceList() : generation( 0 ) {}
+
+	DrawSurfaceList			eyes[2];
+
+	// Incremented by every build, so a holder of the list can tell if it
+	// was rebuilt for someone else.
+	unsigned				generation;
+};
+
+// Builds the lists for both eyes in a single pass. Each surface is culled once
+// against the cull matrices, which must see everything that either eye sees, and
+// the surfaces are only sorted once, so just the MVP multiplies are done per eye.
+// Not thread safe, uses a static buffer for the surfaces, which is separate
+// from the one used by BuildDrawSurfaceList.
+const StereoDrawSurfaceList & BuildStereoDrawSurfaceList( const OVR::Array<ModelState> & modelRenderList,
+							const Matrix4f & cullViewMatrix, const Matrix4f & cullProjectionMatrix,
+							const Matrix4f * viewMatrices, const Matrix4f * projectionMatrices,
+							SurfaceLodHistory * lodHistory = NULL );
+const StereoDrawSurfaceList & BuildStereoDrawSurfaceList( const OVR::Array<const ModelState *> & modelRenderList,
+							const Matrix4f & cullViewMatrix, const Matrix4f & cullProjectionMatrix,
+							const Matrix4f * viewMatrices, const Matrix4f * projectionMatrices,
+							SurfaceLodHistory * lodHistory = NULL );
+
+// Checks on a synthetic scene of boxes that BuildStereoDrawSurfaceList draws
+// every surface that BuildDrawSurfaceList draws for each eye, with the same
+// matrices, and the same surfaces in the same order for both eyes.
+bool TestStereoDrawSurfaceLists();
+
+// Checks the hysteresis bands of the level of detail selection, both on its
+// own and through a SurfaceLodHistory kept across BuildDrawSurfaceList calls.
+bool TestSurfaceLodSelection();
+
+// Times building both eye lists separately against BuildStereoDrawSurfaceList
+// on the same scene and LOGs the per-frame cost of each.
+void BenchmarkDrawSurfaceLists();
 
 // Draws a list of surfaces in order.
 // Any sorting or culling should be performed before calling.
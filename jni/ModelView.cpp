@@ -15,6 +15,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "Input.h"		// VrFrame, etc
 #include "BitmapFont.h"
 #include "DebugLines.h"
+#include "SelfTest.h"		// AllocationCounter
 
 namespace OVR
 {
@@ -24,10 +25,54 @@ void ModelInScene::SetModelFile( const ModelFile * mf )
 	Definition = mf;
 	State.modelDef = mf ? &mf->Def : NULL;
 	State.Joints.Resize( mf->GetJointCount() );
+	// Sized up front so starting or blending clips doesn't allocate mid-game.
+	for ( int i = 0; i < 3; i++ )
+	{
+		Poses[i].joints.Resize( mf->GetJointCount() );
+		Poses[i].world.Resize( mf->GetJointCount() );
+	}
+	Clip = NULL;
+	PrevClip = NULL;
 };
 
+void ModelInScene::PlayAnimation( const ModelAnimationClip * clip, const float timeInSeconds,
+								const float blendSeconds )
+{
+	PrevClip = ( blendSeconds > 0.0f ) ? Clip : NULL;
+	PrevClipStartTime = ClipStartTime;
+	BlendStartTime = timeInSeconds;
+	BlendSeconds = blendSeconds;
+
+	Clip = clip;
+	ClipStartTime = timeInSeconds;
+}
+
 void ModelInScene::AnimateJoints( const float timeInSeconds )
 {
+	if ( Clip != NULL )
+	{
+		Clip->Sample( timeInSeconds - ClipStartTime, Poses[0] );
+
+		ModelAnimationPose * pose = &Poses[0];
+		if ( PrevClip != NULL )
+		{
+			const float weight = ( timeInSeconds - BlendStartTime ) / BlendSeconds;
+			if ( weight >= 1.0f )
+			{
+				PrevClip = NULL;
+			}
+			else
+			{
+				PrevClip->Sample( timeInSeconds - PrevClipStartTime, Poses[1] );
+				BlendAnimationPoses( Poses[1], Poses[0], Alg::Max( weight, 0.0f ), Poses[2] );
+				pose = &Poses[2];
+			}
+		}
+
+		EvaluateAnimationPose( Definition->Joints, *pose, State.Joints );
+		return;
+	}
+
 	for ( int i = 0; i < Definition->GetJointCount(); i++ )
 	{
 		const ModelJoint * joint = Definition->GetJoint( i );
@@ -48,11 +93,12 @@ void ModelInScene::AnimateJoints( const float timeInSeconds )
 			case MODEL_JOINT_ANIMATION_ROTATE:
 			{
 				const Vector3f angles = joint->parameters * ( Math<float>::DegreeToRadFactor * time );
+				const Quatf rotation = Quatf( Vector3f( 0.0f, 1.0f, 0.0f ), angles.y ) *
+										Quatf( Vector3f( 1.0f, 0.0f, 0.0f ), angles.x ) *
+										Quatf( Vector3f( 0.0f, 0.0f, 1.0f ), angles.z );
 				const Matrix4f matrix = joint->transform *
-										Matrix4f::RotationY( angles.y ) *
-										Matrix4f::RotationX( angles.x ) *
-										Matrix4f::RotationZ( angles.z ) *
-										joint->transform.Inverted();
+										Matrix4f( rotation ) *
+										joint->inverseTransform;
 				State.Joints[i] = matrix.Transposed();
 				break;
 			}
@@ -62,7 +108,7 @@ void ModelInScene::AnimateJoints( const float timeInSeconds )
 				const Vector3f offset = joint->parameters * frac;
 				const Matrix4f matrix = joint->transform *
 										Matrix4f::Translation( offset ) *
-										joint->transform.Inverted();
+										joint->inverseTransform;
 				State.Joints[i] = matrix.Transposed();
 				break;
 			}
@@ -94,7 +140,10 @@ OvrSceneView::OvrSceneView() :
 	EyeYaw( 0.0f ),
 	EyePitch( 0.0f ),
 	EyeRoll( 0.0f ),
-	FootPos( 0.0f )
+	FootPos( 0.0f ),
+	RenderModelsDirty( true ),
+	StereoSurfaces( NULL ),
+	StereoSurfacesGeneration( 0 )
 {
 }
 
@@ -108,11 +157,13 @@ int OvrSceneView::AddModel( ModelInScene * model )
 		if ( Models[i] == NULL )
 		{
 			Models[i] = model;
+			RenderModelsDirty = true;
 			return i;
 		}
 	}
 
 	Models.PushBack( model );
+	RenderModelsDirty = true;
 
 	return Models.GetSizeI() - 1;
 }
@@ -120,6 +171,7 @@ int OvrSceneView::AddModel( ModelInScene * model )
 void OvrSceneView::RemoveModelIndex( int index )
 {
 	Models[index] = NULL;
+	RenderModelsDirty = true;
 }
 
 ModelGlPrograms OvrSceneView::GetDefaultGLPrograms()
@@ -178,6 +230,7 @@ void OvrSceneView::SetWorldModel( ModelFile & world )
 		FreeWorldModelOnChange = false;
 	}
 	Models.Clear();
+	RenderModelsDirty = true;
 
 	WorldModel.SetModelFile( &world );
 	AddModel( &WorldModel );
@@ -247,12 +300,258 @@ Matrix4f OvrSceneView::DrawEyeView( const int eye, const float fovDegrees ) cons
 	const Matrix4f projectionMatrix = ProjectionMatrixForEye( eye, fovDegrees );
 	const Matrix4f viewMatrix = ViewMatrixForEye( eye );
 
-	const DrawSurfaceList & surfs = BuildDrawSurfaceList( RenderModels, viewMatrix, projectionMatrix );
-	(void)RenderSurfaceList( surfs );
+	(void)RenderSurfaceList( GetStereoSurfaces( eye, fovDegrees ).eyes[eye] );
 
 	return ( projectionMatrix * viewMatrix );
 }
 
+bool OvrSceneView::StereoSurfacesKey::operator == ( const StereoSurfacesKey & other ) const
+{
+	return FovDegrees == other.FovDegrees
+		&& InterpupillaryDistance == other.InterpupillaryDistance
+		&& Znear == other.Znear
+		&& Zfar == other.Zfar
+		&& ViewMatrix == other.ViewMatrix
+		&& Models == other.Models
+		&& NumModels == other.NumModels
+		&& ModelsHash == other.ModelsHash;
+}
+
+OvrSceneView::StereoSurfacesKey OvrSceneView::CurrentStereoSurfacesKey( const float fovDegrees ) const
+{
+	StereoSurfacesKey key;
+	key.FovDegrees = fovDegrees;
+	key.InterpupillaryDistance = ViewParms.InterpupillaryDistance;
+	key.Znear = Znear;
+	key.Zfar = Zfar;
+	key.ViewMatrix = ViewMatrix;
+	key.Models = RenderModels.GetDataPtr();
+	key.NumModels = RenderModels.GetSizeI();
+
+	// FNV-1a over what culling reads from each model. Joints are referenced
+	// by the draw surfaces rather than copied, so they don't need to match.
+	UInt32 hash = 2166136261u;
+	for ( int i = 0; i < RenderModels.GetSizeI(); i++ )
+	{
+		const ModelState & state = *RenderModels[i];
+		const void * const defPointer = state.modelDef;
+		const int numOverloads = state.SurfaceTextureOverloads.GetSizeI();
+		const struct { const void * data; int bytes; } parts[] =
+		{
+			{ &defPointer, sizeof( defPointer ) },
+			{ &state.modelMatrix, sizeof( state.modelMatrix ) },
+			{ &state.Flags.Hide, sizeof( state.Flags.Hide ) },
+			{ &numOverloads, sizeof( numOverloads ) },
+			{ state.SurfaceTextureOverloads.GetDataPtr(), numOverloads * (int)sizeof( SurfaceTextureOverload ) }
+		};
+		for ( int p = 0; p < (int)( sizeof( parts ) / sizeof( parts[0] ) ); p++ )
+		{
+			const UByte * bytes = (const UByte *)parts[p].data;
+			for ( int b = 0; b < parts[p].bytes; b++ )
+			{
+				hash = ( hash ^ bytes[b] ) * 16777619u;
+			}
+		}
+	}
+	key.ModelsHash = hash;
+	return key;
+}
+
+const StereoDrawSurfaceList & OvrSceneView::GetStereoSurfaces( const int eye, const float fovDegrees ) const
+{
+	const StereoSurfacesKey key = CurrentStereoSurfacesKey( fovDegrees );
+	if ( eye == 0 || StereoSurfaces == NULL || StereoSurfaces->generation != StereoSurfacesGeneration
+			|| !( key == StereoSurfacesBuiltFor ) )
+	{
+		StereoSurfaces = &BuildStereoSurfaces( fovDegrees );
+		StereoSurfacesGeneration = StereoSurfaces->generation;
+		StereoSurfacesBuiltFor = key;
+	}
+	return *StereoSurfaces;
+}
+
+const StereoDrawSurfaceList & OvrSceneView::BuildStereoSurfaces( const float fovDegrees ) const
+{
+	// The eyes only differ by a translation along X, so a center eye pulled back
+	// along Z until its frustum edges pass through both eye positions sees
+	// everything either eye sees. The near and far planes move back with it.
+	const float halfIpd = 0.5f * ViewParms.InterpupillaryDistance;
+	const float pullBack = halfIpd / tanf( DegreeToRad( fovDegrees ) * 0.5f );
+	const Matrix4f cullViewMatrix = Matrix4f::Translation( 0.0f, 0.0f, -pullBack ) * ViewMatrix;
+	const Matrix4f cullProjectionMatrix = Matrix4f::PerspectiveRH( DegreeToRad( fovDegrees ), 1.0f,
+			Znear + pullBack, Zfar + pullBack );
+
+	const Matrix4f viewMatrices[2] = { ViewMatrixForEye( 0 ), ViewMatrixForEye( 1 ) };
+	const Matrix4f projectionMatrices[2] = { ProjectionMatrixForEye( 0, fovDegrees ), ProjectionMatrixForEye( 1, fovDegrees ) };
+
+	return BuildStereoDrawSurfaceList( RenderModels, cullViewMatrix, cullProjectionMatrix,
+			viewMatrices, projectionMatrices, &SurfaceLods );
+}
+
+bool OvrSceneView::TestStereoSurfaceCache()
+{
+	ModelDef def;
+	def.surfaces.Resize( 1 );
+	def.surfaces[0].cullingBounds = Bounds3f( Vector3f( -1.0f ), Vector3f( 1.0f ) );
+
+	ModelState states[2];
+	states[0] = ModelState( def );
+	states[0].modelMatrix = Matrix4f::Translation( 0.0f, 0.0f, -5.0f );
+	states[1] = ModelState( def );
+	states[1].modelMatrix = Matrix4f::Translation( 1.0f, 0.0f, -5.0f );
+
+	OvrSceneView scene;
+	scene.ViewParms.InterpupillaryDistance = 0.064f;
+	scene.ViewMatrix.Identity();
+	scene.RenderModels.PushBack( &states[0] );
+	scene.RenderModels.PushBack( &states[1] );
+
+	int numErrors = 0;
+
+	// The same state for both eyes.
+	unsigned generation = scene.GetStereoSurfaces( 0, 90.0f ).generation;
+	if ( scene.GetStereoSurfaces( 1, 90.0f ).generation != generation )
+	{
+		LOG( "TestStereoSurfaceCache: eye 1 rebuilt an unchanged scene" );
+		numErrors++;
+	}
+	if ( scene.GetStereoSurfaces( 1, 90.0f ).eyes[1].numDrawSurfaces != 2 )
+	{
+		LOG( "TestStereoSurfaceCache: %i surfaces instead of 2", scene.GetStereoSurfaces( 1, 90.0f ).eyes[1].numDrawSurfaces );
+		numErrors++;
+	}
+
+	// Everything that changes what is culled or how it is drawn, changed
+	// between the eyes, must make eye 1 build the lists again.
+	static const char * changes[] = { "fov", "view", "ipd", "znear", "model matrix", "hidden", "models", "shared list" };
+	for ( int c = 0; c < (int)( sizeof( changes ) / sizeof( changes[0] ) ); c++ )
+	{
+		float fov = 90.0f;
+		generation = scene.GetStereoSurfaces( 0, fov ).generation;
+		switch ( c )
+		{
+			case 0: fov = 80.0f; break;
+			case 1: scene.ViewMatrix = Matrix4f::RotationY( 0.1f ) * scene.ViewMatrix; break;
+			case 2: scene.ViewParms.InterpupillaryDistance += 0.001f; break;
+			case 3: scene.Znear *= 0.5f; break;
+			case 4: states[1].modelMatrix = Matrix4f::Translation( 0.0f, 0.1f, 0.0f ) * states[1].modelMatrix; break;
+			case 5: states[1].Flags.Hide = !states[1].Flags.Hide; break;
+			case 6: scene.RenderModels.PopBack(); break;
+			case 7:
+			{
+				Array< ModelState > other;
+				other.PushBack( states[0] );
+				const Matrix4f matrices[2] = { scene.ViewMatrix, scene.ViewMatrix };
+				BuildStereoDrawSurfaceList( other, scene.ViewMatrix, scene.ProjectionMatrixForEye( 0, fov ), matrices, matrices );
+				generation++;
+				break;
+			}
+		}
+		if ( scene.GetStereoSurfaces( 1, fov ).generation == generation )
+		{
+			LOG( "TestStereoSurfaceCache: eye 1 reused stale lists after a %s change", changes[c] );
+			numErrors++;
+		}
+		// And only once.
+		const unsigned rebuilt = scene.GetStereoSurfaces( 1, fov ).generation;
+		if ( scene.GetStereoSurfaces( 1, fov ).generation != rebuilt )
+		{
+			LOG( "TestStereoSurfaceCache: eye 1 rebuilt twice after a %s change", changes[c] );
+			numErrors++;
+		}
+	}
+
+	return numErrors == 0;
+}
+
+bool OvrSceneView::TestSteadyFrameAllocations()
+{
+	// A chain of joints with a looping clip, shared by all the models.
+	ModelFile file( "TestSteadyFrameAllocations" );
+	const int numJoints = 16;
+	file.Joints.Resize( numJoints );
+	for ( int i = 0; i < numJoints; i++ )
+	{
+		file.Joints[i].index = i;
+		file.Joints[i].parent = i - 1;
+		file.Joints[i].transform = Matrix4f::Translation( (float)i, 0.0f, 0.0f );
+		file.Joints[i].inverseTransform = file.Joints[i].transform.Inverted();
+		file.Joints[i].animation = ( i & 1 ) ? MODEL_JOINT_ANIMATION_SWAY : MODEL_JOINT_ANIMATION_NONE;
+		file.Joints[i].timeScale = 1.0f;
+		file.Joints[i].timeOffset = 0.0f;
+	}
+	file.Def.surfaces.Resize( 2 );
+	file.Def.surfaces[0].cullingBounds = Bounds3f( Vector3f( -1.0f ), Vector3f( 1.0f ) );
+	file.Def.surfaces[1].cullingBounds = Bounds3f( Vector3f( 0.0f ), Vector3f( 2.0f ) );
+
+	ModelAnimationClip clip;
+	clip.numFrames = 8;
+	clip.numJoints = numJoints;
+	for ( int f = 0; f < clip.numFrames * numJoints; f++ )
+	{
+		clip.rotations.PushBack( Quatf( Vector3f( 0.0f, 0.0f, 1.0f ), f * 0.01f ) );
+		clip.translations.PushBack( Vector3f( 1.0f, 0.0f, 0.0f ) );
+	}
+	file.Animations.PushBack( clip );
+
+	// Half of the models play the clip, the others use the procedural joint animation.
+	ModelInScene models[16];
+	OvrSceneView scene;
+	for ( int i = 0; i < 16; i++ )
+	{
+		models[i].SetModelFile( &file );
+		models[i].State.modelMatrix = Matrix4f::Translation( ( i % 4 ) * 3.0f - 6.0f, 0.0f, ( i / 4 ) * -3.0f - 2.0f );
+		if ( i & 1 )
+		{
+			models[i].PlayAnimation( &file.Animations[0], 0.0f );
+		}
+		scene.AddModel( &models[i] );
+	}
+
+	VrViewParms viewParms;
+	VrFrame vrFrame;
+	memset( &vrFrame.PoseState, 0, sizeof( vrFrame.PoseState ) );
+	vrFrame.PoseState.Pose.Orientation.w = 1.0f;
+	vrFrame.DeltaSeconds = 1.0f / 60.0f;
+	ovrMatrix4f velocity;
+
+	// The first frames size the arrays, after that nothing should allocate,
+	// even while a new clip is blended in or a model is swapped out in place.
+	int numErrors = 0;
+	for ( int frame = 0; frame < 30; frame++ )
+	{
+		if ( frame == 10 )
+		{
+			models[0].PlayAnimation( &file.Animations[0], vrFrame.PoseState.TimeInSeconds, 0.1f );
+		}
+		if ( frame == 20 )
+		{
+			scene.RemoveModelIndex( 5 );
+			scene.AddModel( &models[5] );
+		}
+
+		vrFrame.PoseState.TimeInSeconds = frame / 60.0;
+		vrFrame.FrameNumber = frame;
+
+		const AllocationCounter counter;
+		scene.Frame( viewParms, vrFrame, velocity );
+		scene.GetStereoSurfaces( 0, 90.0f );
+		scene.GetStereoSurfaces( 1, 90.0f );
+		if ( frame >= 2 && counter.GetCount() > 0 )
+		{
+			LOG( "TestSteadyFrameAllocations: %i allocations in frame %i", counter.GetCount(), frame );
+			numErrors++;
+		}
+	}
+	if ( scene.GetStereoSurfaces( 1, 90.0f ).eyes[1].numDrawSurfaces == 0 )
+	{
+		LOG( "TestSteadyFrameAllocations: no surfaces were drawn" );
+		numErrors++;
+	}
+
+	return numErrors == 0;
+}
+
 Vector3f OvrSceneView::Forward() const
 {
 	return Vector3f( -ViewMatrix.M[2][0], -ViewMatrix.M[2][1], -ViewMatrix.M[2][2] );
@@ -283,6 +582,8 @@ Vector3f OvrSceneView::HeadModelOffset( float EyeRoll, float EyePitch, float Eye
 
 void OvrSceneView::UpdateViewMatrix(const VrFrame vrFrame )
 {
+	StereoSurfaces = NULL;
+
 	// Delta time in seconds since last frame.
 	const float dt = vrFrame.DeltaSeconds;
 	const float yawSpeed = 1.5f;
@@ -401,16 +702,43 @@ void OvrSceneView::UpdateViewMatrix(const VrFrame vrFrame )
 
 void OvrSceneView::UpdateSceneModels( const VrFrame vrFrame )
 {
-	// Build the packed array of ModelState to pass to the renderer for both eyes
-	RenderModels.Resize( 0 );
+	StereoSurfaces = NULL;
 
-	for ( int i = 0; i < Models.GetSize(); ++i )
+	int numRenderModels = 0;
+	for ( int i = 0; i < Models.GetSizeI(); ++i )
 	{
 		if ( Models[i] != NULL )
 		{
 			Models[i]->AnimateJoints( vrFrame.PoseState.TimeInSeconds );
-			RenderModels.PushBack( Models[i]->State );
+
+			// Models is public, so entries can be replaced without AddModel().
+			if ( numRenderModels >= RenderModels.GetSizeI() || RenderModels[numRenderModels] != &Models[i]->State )
+			{
+				RenderModelsDirty = true;
+			}
+			numRenderModels++;
+		}
+	}
+	if ( numRenderModels != RenderModels.GetSizeI() )
+	{
+		RenderModelsDirty = true;
+	}
+
+	// Rebuild the packed array of ModelState pointers to pass to the renderer
+	// for both eyes. The states themselves aren't copied, so a steady frame
+	// doesn't touch the heap.
+	if ( RenderModelsDirty )
+	{
+		RenderModels.Resize( numRenderModels );
+		for ( int i = 0, renderIndex = 0; i < Models.GetSizeI(); ++i )
+		{
+			if ( Models[i] != NULL )
+			{
+				RenderModels[renderIndex++] = &Models[i]->State;
+			}
 		}
+		SurfaceLods.Reset();
+		RenderModelsDirty = false;
 	}
 }
 
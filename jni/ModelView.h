@@ -26,14 +26,35 @@ class ModelInScene
 {
 public:
 			ModelInScene() :
-				Definition( NULL )
+				Definition( NULL ),
+				Clip( NULL ),
+				ClipStartTime( 0.0f ),
+				PrevClip( NULL ),
+				PrevClipStartTime( 0.0f ),
+				BlendStartTime( 0.0f ),
+				BlendSeconds( 0.0f )
 				{}
 
 	void	SetModelFile( const ModelFile * mf );
 	void	AnimateJoints( const float timeInSeconds );
 
+	// Plays a keyframed clip from the model file starting at timeInSeconds,
+	// cross fading from the current clip over blendSeconds. While a clip is
+	// playing it replaces the procedural joint animation; a NULL clip stops it.
+	void	PlayAnimation( const ModelAnimationClip * clip, const float timeInSeconds,
+						const float blendSeconds = 0.0f );
+
 	ModelState			State;		// passed to rendering code
 	const ModelFile	*	Definition;	// will not be freed by OvrSceneView
+
+private:
+	const ModelAnimationClip *	Clip;
+	float						ClipStartTime;
+	const ModelAnimationClip *	PrevClip;		// being faded out
+	float						PrevClipStartTime;
+	float						BlendStartTime;
+	float						BlendSeconds;
+	ModelAnimationPose			Poses[3];		// current, previous and blended
 };
 
 //-----------------------------------------------------------------------------------
@@ -98,9 +119,13 @@ public:
 	// None of these will be directly freed by OvrSceneView.
 	Array<ModelInScene *>	Models;
 
-	// This is built up out of Models each frame, and used for
-	// rendering both eyes
-	Array<ModelState>		RenderModels;
+	// This is built up out of Models, and used for rendering both eyes.
+	// Points at the State of each model instead of copying it every frame,
+	// so it is only rebuilt when Models changes. It used to be an
+	// Array<ModelState>; code that appends its own models between Frame()
+	// and DrawEyeView() now has to append pointers to states that stay
+	// valid until the eyes are drawn.
+	Array<const ModelState *>	RenderModels;
 
 	// The only ModelInScene that OvrSceneView actually owns.
 	bool					FreeWorldModelOnChange;
@@ -152,6 +177,49 @@ public:
 
     // Modified by joypad movement and collision detection
     Vector3f				FootPos;
+
+	// Checks that eye 1 only reuses the surfaces culled for eye 0 when
+	// nothing they were built from has changed. Doesn't need GL.
+	static bool	TestStereoSurfaceCache();
+
+	// Checks that once the models are set, animated and static models can be
+	// updated, culled and sorted every frame without allocating. Doesn't need GL.
+	static bool	TestSteadyFrameAllocations();
+
+private:
+	// Set when models are added or removed. UpdateSceneModels also notices
+	// entries of Models changed directly.
+	bool		RenderModelsDirty;
+
+	// Everything the stereo surface lists are built from.
+	struct StereoSurfacesKey
+	{
+		float						FovDegrees;
+		float						InterpupillaryDistance;
+		float						Znear;
+		float						Zfar;
+		Matrix4f					ViewMatrix;
+		const ModelState * const *	Models;
+		int							NumModels;
+		UInt32						ModelsHash;		// model matrices, definitions and flags
+
+		bool	operator == ( const StereoSurfacesKey & other ) const;
+	};
+
+	// Both eyes are culled and sorted together when eye 0 is drawn, and eye 1
+	// reuses the result if the key still matches and the shared list hasn't
+	// been rebuilt by anyone else since. Otherwise eye 1 builds it again.
+	mutable const StereoDrawSurfaceList *	StereoSurfaces;
+	mutable unsigned						StereoSurfacesGeneration;
+	mutable StereoSurfacesKey				StereoSurfacesBuiltFor;
+
+	// Updated whenever the stereo surfaces are built, and started over when
+	// Models changes.
+	mutable SurfaceLodHistory				SurfaceLods;
+
+	StereoSurfacesKey				CurrentStereoSurfacesKey( const float fovDegrees ) const;
+	const StereoDrawSurfaceList &	GetStereoSurfaces( const int eye, const float fovDegrees ) const;
+	const StereoDrawSurfaceList &	BuildStereoSurfaces( const float fovDegrees ) const;
 };
 
 }	// namespace OVR
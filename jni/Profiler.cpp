@@ -0,0 +1,417 @@
+/************************************************************************************
+
+Filename    :   Profiler.cpp
+Content     :   Scoped CPU profiling aggregated into per-thread call trees.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Kernel/OVR_Alg.h"
+#include "Kernel/OVR_Array.h"
+#include "Kernel/OVR_Atomic.h"
+#include "Kernel/OVR_ThreadRings.h"
+#include "Kernel/OVR_Timer.h"
+#include "Log.h"
+
+namespace OVR
+{
+
+struct ProfileEvent
+{
+	UInt64			Nanos;
+	const char *	Name;		// NULL for the end of the innermost scope
+};
+
+// Single producer, single consumer: the owning thread, or whichever thread
+// records into a timeline, writes events and publishes Head, EndFrame() reads
+// them and publishes Tail.
+struct ProfileRing : public ThreadRingHeader
+{
+	AtomicInt<UInt32>	Head;
+	AtomicInt<UInt32>	Tail;
+	AtomicInt<int>		Dropped;		// scopes dropped for lack of room
+
+	// Only touched by the owning thread
+	UInt32				Written;
+	ProfileNesting		Nesting;
+	int					DroppedCount;
+
+	ProfileEvent		Events[Profiler::RING_SIZE];
+};
+
+struct ProfileNode
+{
+	const char *	Name;
+	int				Parent;
+	int				FirstChild;
+	int				NextSibling;
+	int				Depth;
+
+	// The current frame
+	UInt64			FrameNanos;
+	int				FrameCalls;
+
+	// The current window
+	int				WindowRunFrames;
+	int				WindowCalls;
+	UInt64			WindowNanos;
+	UInt64			WindowMinNanos;
+	UInt64			WindowMaxNanos;
+
+	// The last complete window
+	ProfileStats	Stats;
+};
+
+struct ProfileOpenScope
+{
+	int				Node;
+	UInt64			BeginNanos;
+};
+
+// EndFrame() thread only. Node 0 is the root of the thread.
+struct ProfileTree
+{
+	Array< ProfileNode >		Nodes;
+	Array< ProfileOpenScope >	Open;
+};
+
+static ThreadRings		ProfileRings( THREAD_RING_PROFILE, sizeof( ProfileRing ), "Profiler" );
+
+static ProfileTree		Trees[Profiler::MAX_THREADS];
+static int				WindowFrames = 0;
+
+static ProfileRing * GetRing( const int index )
+{
+	return static_cast< ProfileRing * >( ProfileRings.GetRing( index ) );
+}
+
+static void RingBegin( ProfileRing * ring, const char * name, const UInt64 nanos )
+{
+	if ( !ring->Nesting.Begin() )
+	{
+		return;
+	}
+
+	// Keep room for the ends of all the recorded scopes that are still
+	// open, including this one, so an end is never dropped.
+	const UInt32 written = ring->Written;
+	if ( written - ring->Tail.Load_Acquire() + ring->Nesting.GetRecordedOpen() + 2 > (UInt32)Profiler::RING_SIZE )
+	{
+		ring->Nesting.Drop();
+		ring->Dropped.Store_Release( ++ring->DroppedCount );
+		return;
+	}
+
+	ProfileEvent & event = ring->Events[written & ( Profiler::RING_SIZE - 1 )];
+	event.Nanos = nanos;
+	event.Name = name;
+
+	ring->Nesting.Record();
+	ring->Written = written + 1;
+	ring->Head.Store_Release( written + 1 );
+}
+
+static void RingEnd( ProfileRing * ring, const UInt64 nanos )
+{
+	if ( !ring->Nesting.End() )
+	{
+		return;
+	}
+
+	const UInt32 written = ring->Written;
+	ProfileEvent & event = ring->Events[written & ( Profiler::RING_SIZE - 1 )];
+	event.Nanos = nanos;
+	event.Name = NULL;
+
+	ring->Written = written + 1;
+	ring->Head.Store_Release( written + 1 );
+}
+
+void Profiler::Begin( const char * name )
+{
+	ProfileRing * ring = static_cast< ProfileRing * >( ProfileRings.GetCurrent() );
+	if ( ring == NULL )
+	{
+		return;
+	}
+	RingBegin( ring, name, Timer::GetTicksNanos() );
+}
+
+void Profiler::End()
+{
+	ProfileRing * ring = static_cast< ProfileRing * >( ProfileRings.PeekCurrent() );
+	if ( ring == NULL )
+	{
+		return;
+	}
+	RingEnd( ring, Timer::GetTicksNanos() );
+}
+
+ProfileRing * Profiler::CreateTimeline( const char * name )
+{
+	return static_cast< ProfileRing * >( ProfileRings.FindOrAddNamed( name ) );
+}
+
+void Profiler::BeginAt( ProfileRing * timeline, const char * name, const UInt64 nanos )
+{
+	RingBegin( timeline, name, nanos );
+}
+
+void Profiler::EndAt( ProfileRing * timeline, const UInt64 nanos )
+{
+	RingEnd( timeline, nanos );
+}
+
+void Profiler::SetThreadName( const char * name )
+{
+	ThreadRings::SetCurrentThreadName( name );
+}
+
+static String GetThreadName( const int ringIndex )
+{
+	const String name = ProfileRings.GetRingName( ringIndex );
+	if ( !name.IsEmpty() )
+	{
+		return name;
+	}
+	char fallback[MAX_THREAD_NAME];
+	OVR_sprintf( fallback, sizeof( fallback ), "thread %i", GetRing( ringIndex )->ThreadId );
+	return String( fallback );
+}
+
+static int FindOrAddChild( ProfileTree & tree, const int parent, const char * name )
+{
+	int last = -1;
+	for ( int child = tree.Nodes[parent].FirstChild; child != -1; child = tree.Nodes[child].NextSibling )
+	{
+		// The same literal can have different addresses in different files.
+		if ( tree.Nodes[child].Name == name || strcmp( tree.Nodes[child].Name, name ) == 0 )
+		{
+			return child;
+		}
+		last = child;
+	}
+
+	const int index = tree.Nodes.GetSizeI();
+	ProfileNode & node = tree.Nodes.PushDefault();
+	memset( &node, 0, sizeof( node ) );
+	node.Name = name;
+	node.Parent = parent;
+	node.FirstChild = -1;
+	node.NextSibling = -1;
+	node.Depth = tree.Nodes[parent].Depth + 1;
+	if ( last == -1 )
+	{
+		tree.Nodes[parent].FirstChild = index;
+	}
+	else
+	{
+		tree.Nodes[last].NextSibling = index;
+	}
+	return index;
+}
+
+void Profiler::EndFrame()
+{
+	const int numRings = ProfileRings.GetNumRings();
+	for ( int i = 0; i < numRings; i++ )
+	{
+		ProfileRing * ring = GetRing( i );
+		ProfileTree & tree = Trees[i];
+		if ( tree.Nodes.GetSizeI() == 0 )
+		{
+			ProfileNode & root = tree.Nodes.PushDefault();
+			memset( &root, 0, sizeof( root ) );
+			root.Name = "";
+			root.Parent = -1;
+			root.FirstChild = -1;
+			root.NextSibling = -1;
+		}
+
+		const UInt32 head = ring->Head.Load_Acquire();
+		for ( UInt32 e = ring->Tail.Load_Acquire(); e != head; e++ )
+		{
+			const ProfileEvent & event = ring->Events[e & ( RING_SIZE - 1 )];
+			if ( event.Name != NULL )
+			{
+				const int parent = ( tree.Open.GetSizeI() > 0 ) ? tree.Open.Back().Node : 0;
+				ProfileOpenScope open;
+				open.Node = FindOrAddChild( tree, parent, event.Name );
+				open.BeginNanos = event.Nanos;
+				tree.Open.PushBack( open );
+			}
+			else if ( tree.Open.GetSizeI() > 0 )
+			{
+				const ProfileOpenScope open = tree.Open.Pop();
+				ProfileNode & node = tree.Nodes[open.Node];
+				node.FrameNanos += event.Nanos - open.BeginNanos;
+				node.FrameCalls++;
+			}
+		}
+		ring->Tail.Store_Release( head );
+
+		for ( int n = 1; n < tree.Nodes.GetSizeI(); n++ )
+		{
+			ProfileNode & node = tree.Nodes[n];
+			if ( node.FrameCalls > 0 )
+			{
+				node.WindowMinNanos = ( node.WindowRunFrames == 0 ) ? node.FrameNanos : Alg::Min( node.WindowMinNanos, node.FrameNanos );
+				node.WindowMaxNanos = Alg::Max( node.WindowMaxNanos, node.FrameNanos );
+				node.WindowNanos += node.FrameNanos;
+				node.WindowCalls += node.FrameCalls;
+				node.WindowRunFrames++;
+			}
+			node.FrameNanos = 0;
+			node.FrameCalls = 0;
+		}
+	}
+
+	if ( ++WindowFrames < WINDOW_FRAMES )
+	{
+		return;
+	}
+
+	for ( int i = 0; i < numRings; i++ )
+	{
+		ProfileTree & tree = Trees[i];
+		for ( int n = 1; n < tree.Nodes.GetSizeI(); n++ )
+		{
+			ProfileNode & node = tree.Nodes[n];
+			node.Stats.AvgMs = (float)( node.WindowNanos * 1e-6 / WindowFrames );
+			node.Stats.MinMs = (float)( node.WindowMinNanos * 1e-6 );
+			node.Stats.MaxMs = (float)( node.WindowMaxNanos * 1e-6 );
+			node.Stats.CallsPerFrame = (float)node.WindowCalls / WindowFrames;
+			node.WindowRunFrames = 0;
+			node.WindowCalls = 0;
+			node.WindowNanos = 0;
+			node.WindowMinNanos = 0;
+			node.WindowMaxNanos = 0;
+		}
+	}
+	WindowFrames = 0;
+}
+
+bool Profiler::HasData()
+{
+	return ProfileRings.GetNumRings() > 0;
+}
+
+bool Profiler::GetStats( const char * name, ProfileStats & stats, const char * threadName )
+{
+	const int numRings = ProfileRings.GetNumRings();
+	for ( int i = 0; i < numRings; i++ )
+	{
+		if ( threadName != NULL && GetThreadName( i ) != threadName )
+		{
+			continue;
+		}
+		const ProfileTree & tree = Trees[i];
+		for ( int n = 1; n < tree.Nodes.GetSizeI(); n++ )
+		{
+			if ( strcmp( tree.Nodes[n].Name, name ) == 0 )
+			{
+				stats = tree.Nodes[n].Stats;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static void FormatNode( const ProfileTree & tree, const int nodeIndex, const float minMs, const int maxLines,
+		int & numLines, StringBuffer & text )
+{
+	for ( int child = tree.Nodes[nodeIndex].FirstChild; child != -1; child = tree.Nodes[child].NextSibling )
+	{
+		const ProfileNode & node = tree.Nodes[child];
+		if ( node.Stats.AvgMs < minMs )
+		{
+			continue;
+		}
+		if ( numLines >= maxLines )
+		{
+			return;
+		}
+		numLines++;
+		for ( int d = 0; d < node.Depth; d++ )
+		{
+			text += "  ";
+		}
+		text.AppendFormat( "%s %.2f (%.2f-%.2f)", node.Name, node.Stats.AvgMs, node.Stats.MinMs, node.Stats.MaxMs );
+		if ( node.Stats.CallsPerFrame < 0.95f || node.Stats.CallsPerFrame > 1.05f )
+		{
+			text.AppendFormat( " x%.1f", node.Stats.CallsPerFrame );
+		}
+		text += "\n";
+		FormatNode( tree, child, minMs, maxLines, numLines, text );
+	}
+}
+
+void Profiler::FormatReport( StringBuffer & text, const float minMs, const int maxLines )
+{
+	int numLines = 0;
+	const int numRings = ProfileRings.GetNumRings();
+	for ( int i = 0; i < numRings && numLines < maxLines; i++ )
+	{
+		const ProfileTree & tree = Trees[i];
+		if ( tree.Nodes.GetSizeI() <= 1 )
+		{
+			continue;
+		}
+		numLines++;
+		text += GetThreadName( i );
+		const int dropped = GetRing( i )->Dropped.Load_Acquire();
+		if ( dropped > 0 )
+		{
+			text.AppendFormat( " (ms, %i dropped)\n", dropped );
+		}
+		else
+		{
+			text += " (ms)\n";
+		}
+		FormatNode( tree, 0, minMs, maxLines, numLines, text );
+	}
+}
+
+static void DumpNode( FILE * f, const String & threadName, const ProfileTree & tree, const int nodeIndex, const String & path )
+{
+	for ( int child = tree.Nodes[nodeIndex].FirstChild; child != -1; child = tree.Nodes[child].NextSibling )
+	{
+		const ProfileNode & node = tree.Nodes[child];
+		const String childPath = ( nodeIndex == 0 ) ? String( node.Name ) : path + "/" + node.Name;
+		fprintf( f, "%s\t%s\t%.3f\t%.3f\t%.3f\t%.2f\n", threadName.ToCStr(), childPath.ToCStr(),
+				node.Stats.AvgMs, node.Stats.MinMs, node.Stats.MaxMs, node.Stats.CallsPerFrame );
+		DumpNode( f, threadName, tree, child, childPath );
+	}
+}
+
+bool Profiler::Dump( const char * path )
+{
+	FILE * f = fopen( path, "w" );
+	if ( f == NULL )
+	{
+		LOG( "Profiler: couldn't open %s", path );
+		return false;
+	}
+
+	fprintf( f, "thread\tscope\tavg_ms\tmin_ms\tmax_ms\tcalls_per_frame\n" );
+	const int numRings = ProfileRings.GetNumRings();
+	for ( int i = 0; i < numRings; i++ )
+	{
+		DumpNode( f, GetThreadName( i ), Trees[i], 0, String() );
+	}
+
+	const bool ok = ( ferror( f ) == 0 );
+	fclose( f );
+	LOG( "Profiler: wrote %s", path );
+	return ok;
+}
+
+}	// namespace OVR
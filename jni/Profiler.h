@@ -0,0 +1,192 @@
+/************************************************************************************
+
+Filename    :   Profiler.h
+Content     :   Scoped CPU profiling aggregated into per-thread call trees.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#ifndef OVR_Profiler_h
+#define OVR_Profiler_h
+
+#include "Kernel/OVR_Types.h"
+#include "Kernel/OVR_String.h"
+#include "Kernel/OVR_ThreadRings.h"
+#include "Kernel/OVR_Trace.h"
+
+// The OVR_PROFILE_SCOPE markers are only compiled in debug builds, or when
+// OVR_ENABLE_PROFILER is defined, so they cost nothing in release builds.
+#if defined( OVR_BUILD_DEBUG ) && !defined( OVR_ENABLE_PROFILER )
+#define OVR_ENABLE_PROFILER
+#endif
+
+#define OVR_PROFILE_JOIN2( a, b ) a##b
+#define OVR_PROFILE_JOIN( a, b ) OVR_PROFILE_JOIN2( a, b )
+
+// OVR_PROFILE_TRACE_SCOPE also traces the scope, and still does so when the
+// profiler is compiled out.
+#if defined( OVR_ENABLE_PROFILER )
+#define OVR_PROFILE_SCOPE( name ) const OVR::ProfileScope OVR_PROFILE_JOIN( profileScope_, __LINE__ )( name )
+#define OVR_PROFILE_TRACE_SCOPE( category, name ) const OVR::ProfileTraceScope OVR_PROFILE_JOIN( profileScope_, __LINE__ )( category, name )
+#else
+#define OVR_PROFILE_SCOPE( name )
+#define OVR_PROFILE_TRACE_SCOPE( category, name ) const OVR::TraceScope OVR_PROFILE_JOIN( traceScope_, __LINE__ )( category, name )
+#endif
+
+namespace OVR
+{
+
+// Each thread records the begin and end of its scopes into its own ring, which
+// only that thread writes and only EndFrame() reads, so recording takes no
+// locks. Once a frame, EndFrame() drains the rings into a call tree per thread,
+// where every distinct path of scope names is a node.
+//
+// A node's statistics cover a window of WINDOW_FRAMES frames and are replaced
+// when the next window completes. Scopes that span several frames, like
+// loads on background threads, count in the frame they end in.
+//
+// If a ring fills up between EndFrame() calls, new scopes are dropped whole,
+// along with everything under them, so the trees stay consistent.
+//
+// Scope names are stored as pointers and must stay valid for the life of the
+// process, normally string literals.
+struct ProfileRing;
+
+struct ProfileStats
+{
+	float	AvgMs;				// total time per frame, over all frames of the window
+	float	MinMs;				// total time in a frame, over the frames it ran in
+	float	MaxMs;
+	float	CallsPerFrame;
+};
+
+class Profiler
+{
+public:
+	static const int RING_SIZE = 4096;			// must be a power of two
+	static const int MAX_THREADS = ThreadRings::MAX_RINGS;
+	static const int MAX_DEPTH = 32;
+	static const int WINDOW_FRAMES = 60;
+
+	static void		Begin( const char * name );
+	static void		End();
+
+	// Names the calling thread in reports, and in traces, see
+	// ThreadRings::SetCurrentThreadName(). The name is copied.
+	static void		SetThreadName( const char * name );
+
+	// A timeline records scopes with times measured elsewhere, like GPU
+	// timestamps, and is reported like a thread with this name. Creating a
+	// timeline with the name of an existing one returns that one. Only one
+	// thread at a time may record into a timeline. Returns NULL if there is
+	// no room for another.
+	static ProfileRing *	CreateTimeline( const char * name );
+	static void		BeginAt( ProfileRing * timeline, const char * name, const UInt64 nanos );
+	static void		EndAt( ProfileRing * timeline, const UInt64 nanos );
+
+	// Aggregates everything recorded since the last call. The functions
+	// below must be called on the same thread as this.
+	static void		EndFrame();
+
+	// True once any thread has recorded a scope.
+	static bool		HasData();
+
+	// Looks up the first node with this name, in the thread or timeline with
+	// threadName, or in any of them if threadName is NULL.
+	static bool		GetStats( const char * name, ProfileStats & stats, const char * threadName = NULL );
+
+	// Appends an indented tree of the nodes that take at least minMs per
+	// frame, at most maxLines lines, for drawing in the view.
+	static void		FormatReport( StringBuffer & text, const float minMs, const int maxLines );
+
+	// Writes every node of every thread as tab separated text, for
+	// offline analysis. Returns false if the file can't be written.
+	static bool		Dump( const char * path );
+};
+
+// Tracks the nesting of the scopes recorded into a ring, the Profiler's or the
+// queries of a GpuProfiler, so that the ends of recorded scopes are recorded
+// and everything else is left out in matching pairs. Scopes deeper than
+// Profiler::MAX_DEPTH are left out, and when a ring is out of room a scope is
+// dropped along with everything under it. The ring has to keep room for the
+// ends of the recorded scopes that are still open.
+class ProfileNesting
+{
+public:
+	ProfileNesting() : Depth( 0 ), RecordedOpen( 0 ), RecordedMask( 0 ), DroppedDepth( 0 ) {}
+
+	// Opens a scope. Returns false if it is left out without asking for
+	// room, otherwise Record() or Drop() has to follow.
+	bool	Begin()
+	{
+		const int depth = Depth++;
+		return depth < Profiler::MAX_DEPTH && DroppedDepth == 0;
+	}
+	void	Record()
+	{
+		RecordedMask |= 1u << ( Depth - 1 );
+		RecordedOpen++;
+	}
+	void	Drop() { DroppedDepth = Depth; }
+
+	// Closes the innermost scope. Returns true if its begin was recorded,
+	// so its end has to be as well.
+	bool	End()
+	{
+		if ( Depth <= 0 )
+		{
+			return false;
+		}
+		const int depth = --Depth;
+		if ( depth + 1 == DroppedDepth )
+		{
+			DroppedDepth = 0;
+			return false;
+		}
+		if ( depth >= Profiler::MAX_DEPTH || ( RecordedMask & ( 1u << depth ) ) == 0 )
+		{
+			return false;
+		}
+		RecordedMask &= ~( 1u << depth );
+		RecordedOpen--;
+		return true;
+	}
+
+	// Scopes that are still open, all of them or only the recorded ones.
+	int		GetDepth() const { return Depth; }
+	int		GetRecordedOpen() const { return RecordedOpen; }
+
+private:
+	int		Depth;			// including scopes that were left out
+	int		RecordedOpen;
+	UInt32	RecordedMask;	// bit per depth, set if that begin was recorded
+	int		DroppedDepth;	// one more than the depth of a dropped scope still open, or 0
+};
+
+// Declaring a variable with this class profiles a scope until it goes out of
+// scope. Use OVR_PROFILE_SCOPE so the marker is compiled out in release builds.
+class ProfileScope
+{
+public:
+	explicit ProfileScope( const char * name ) { Profiler::Begin( name ); }
+	~ProfileScope() { Profiler::End(); }
+};
+
+// Profiles a scope and traces it as a span with the same name, so one marker
+// serves both. Use OVR_PROFILE_TRACE_SCOPE.
+class ProfileTraceScope
+{
+public:
+	ProfileTraceScope( const TraceCategory category, const char * name ) :
+		Span( category, name ) { Profiler::Begin( name ); }
+	~ProfileTraceScope() { Profiler::End(); }
+
+private:
+	const TraceScope	Span;
+};
+
+}	// namespace OVR
+
+#endif	// OVR_Profiler_h
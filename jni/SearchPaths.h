@@ -36,6 +36,9 @@ public:
 	bool			ToRelativePath( char const * fullPath, char * outPath, const int outMaxLen ) const;
 	bool			ToRelativePath( char const * fullPath, String & outPath ) const;
 
+	// Searched after the storage locations. The path must end in a slash.
+	void			AddPath( const char * path ) { Paths.PushBack( path ); }
+
 	int				NumPaths() const { return Paths.GetSizeI(); }
 	char const *	GetPath( int const i ) const { return Paths[i]; }
 
@@ -0,0 +1,307 @@
+/************************************************************************************
+
+Filename    :   SelfTest.cpp
+Content     :   Runs the checks and benchmarks that are built into the library.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "SelfTest.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "Kernel/OVR_Allocator.h"
+#include "Kernel/OVR_Atomic.h"
+
+#include "Log.h"
+#include "VrApi/ImageServer.h"
+#include "VrApi/FramePacing.h"
+#include "VrApi/WarpLayers.h"
+#include "ModelRender.h"
+#include "ModelView.h"
+#include "ModelFile.h"
+#include "ModelAnimation.h"
+#include "MeshOptimizer.h"
+#include "GlStreamingBuffer.h"
+#include "GlProgram.h"
+#include "OVR_Stereo.h"
+#include "DynamicResolution.h"
+#include "ThumbnailLoader.h"
+#include "VRMenu/FolderBrowser.h"
+#include "OVR_SensorRecorder.h"
+#include "OVR_PoseHistory.h"
+#include "Kernel/OVR_Lockless.h"
+#include "Kernel/OVR_Math.h"
+
+namespace OVR
+{
+
+// Short runs of the lockless stress tests, which are meant to run for
+// minutes when they are investigated on their own.
+static bool TestLocklessUpdater()
+{
+	return TestLockless( 100000 );
+}
+
+static bool TestPoseHistoryReads()
+{
+	return TestPoseHistory( 100000 );
+}
+
+// The recorder needs somewhere to write its logs.
+static bool TestSensorReplay()
+{
+	const char * directory = GetSelfTestDirectory();
+	if ( directory[0] == '\0' )
+	{
+		LOG( "TestSensorReplay: skipped, needs the self test directory" );
+		return true;
+	}
+	return SensorReplay::Test( directory );
+}
+
+struct SelfTest
+{
+	const char *	Name;
+	bool			(*Run)();
+};
+
+static const SelfTest SelfTests[] =
+{
+	{ "ImageServer loopback",			ImageServer::TestLoopback },
+	{ "Stereo draw surface lists",		TestStereoDrawSurfaceLists },
+	{ "Surface level of detail",		TestSurfaceLodSelection },
+	{ "Stereo surface cache",			OvrSceneView::TestStereoSurfaceCache },
+	{ "Steady frame allocations",		OvrSceneView::TestSteadyFrameAllocations },
+	{ "Animation clip loading",			TestAnimationClipLoading },
+	{ "Joint animation",				TestJointAnimation },
+	{ "Streaming buffer",				GlStreamingBuffer::Test },
+	{ "Program cache",					TestProgramCache },
+	{ "Lens distortion batches",		TestLensConfigs },
+	{ "Frame pacing",					TestFramePacing },
+	{ "Warp layer programs",			TestWarpLayerPrograms },
+	{ "Dynamic resolution",				TestDynamicResolution },
+	{ "Thumbnail loader",				ThumbnailLoader::Test },
+	{ "Sensor record and replay",		TestSensorReplay },
+	{ "Lockless updater",				TestLocklessUpdater },
+	{ "Pose history reads",				TestPoseHistoryReads },
+	{ "Matrix4f float versions",		TestMatrix4f },
+	{ "Mesh optimizer",					TestMeshOptimizer },
+	{ "Mesh simplification",			TestSimplifyMesh },
+};
+
+// A skeleton the size of a typical character.
+static void BenchmarkCharacterAnimation()
+{
+	BenchmarkJointAnimation( 64, 1000 );
+}
+
+// 20000 triangles, about the most a single surface can index.
+static void BenchmarkMeshOptimizerGrid()
+{
+	BenchmarkMeshOptimizer( 100, 20 );
+}
+
+struct SelfBenchmark
+{
+	const char *	Name;
+	void			(*Run)();
+};
+
+static const SelfBenchmark SelfBenchmarks[] =
+{
+	{ "ImageServer encodings",			ImageServer::BenchmarkEncodings },
+	{ "Draw surface lists",				BenchmarkDrawSurfaceLists },
+	{ "Joint animation",				BenchmarkCharacterAnimation },
+	{ "Lens distortion batches",		BenchmarkLensConfigs },
+	{ "Frame pacing scenarios",			SimulateFramePacingScenarios },
+	{ "Dynamic resolution phases",		SimulateDynamicResolution },
+	{ "Folder browser 10k items",		BenchmarkFolderBrowser },
+	{ "Matrix4f operations",			BenchmarkMatrix4f },
+	{ "Mesh optimizer",					BenchmarkMeshOptimizerGrid },
+};
+
+// Forwards everything to the allocator it was installed over, counting the
+// allocations of one thread while it is enabled.
+class CountingAllocator : public Allocator
+{
+public:
+					CountingAllocator() : Previous( NULL ), Thread( 0 ), Enabled( 0 ), Count( 0 ) {}
+
+	// Wraps the installed allocator, unless this already does.
+	void			Install();
+
+	// Counts the calling thread's allocations from zero, until disabled.
+	void			Enable();
+	void			Disable() { Enabled.Store_Release( 0 ); }
+	int				GetCount() const { return Count.Load_Acquire(); }
+
+	virtual void *	Alloc( UPInt size );
+	virtual void *	AllocDebug( UPInt size, const char * file, unsigned line );
+	virtual void *	Realloc( void * p, UPInt newSize );
+	virtual void	Free( void * p );
+	virtual void *	AllocAligned( UPInt size, UPInt align );
+	virtual void	FreeAligned( void * p );
+
+protected:
+	virtual void	onSystemShutdown();
+
+private:
+	void			CountAllocation();
+
+	Allocator *		Previous;
+	pthread_t		Thread;			// set before Enabled
+	AtomicInt<int>	Enabled;
+	AtomicInt<int>	Count;
+};
+
+static CountingAllocator	AllocationCounting;
+
+void CountingAllocator::Install()
+{
+	if ( Previous == NULL )
+	{
+		Previous = Allocator::swapInstance( this );
+	}
+}
+
+void CountingAllocator::Enable()
+{
+	OVR_ASSERT( Enabled == 0 );
+	Thread = pthread_self();
+	Count.Store_Release( 0 );
+	Enabled.Store_Release( 1 );
+}
+
+void CountingAllocator::onSystemShutdown()
+{
+	// System::Destroy uninstalls this, so the next counter installs it again.
+	Enabled.Store_Release( 0 );
+	Allocator * previous = Previous;
+	Previous = NULL;
+	forwardSystemShutdown( previous );
+}
+
+void CountingAllocator::CountAllocation()
+{
+	if ( Enabled.Load_Acquire() != 0 && pthread_equal( pthread_self(), Thread ) )
+	{
+		Count++;
+	}
+}
+
+void * CountingAllocator::Alloc( UPInt size )
+{
+	CountAllocation();
+	return Previous->Alloc( size );
+}
+
+void * CountingAllocator::AllocDebug( UPInt size, const char * file, unsigned line )
+{
+	CountAllocation();
+	return Previous->AllocDebug( size, file, line );
+}
+
+void * CountingAllocator::Realloc( void * p, UPInt newSize )
+{
+	CountAllocation();
+	return Previous->Realloc( p, newSize );
+}
+
+void CountingAllocator::Free( void * p )
+{
+	Previous->Free( p );
+}
+
+void * CountingAllocator::AllocAligned( UPInt size, UPInt align )
+{
+	CountAllocation();
+	return Previous->AllocAligned( size, align );
+}
+
+void CountingAllocator::FreeAligned( void * p )
+{
+	Previous->FreeAligned( p );
+}
+
+AllocationCounter::AllocationCounter()
+{
+	AllocationCounting.Install();
+	AllocationCounting.Enable();
+}
+
+AllocationCounter::~AllocationCounter()
+{
+	AllocationCounting.Disable();
+}
+
+int AllocationCounter::GetCount() const
+{
+	return AllocationCounting.GetCount();
+}
+
+static App *	SelfTestApp;
+static char		SelfTestDirectory[256];
+
+App * GetSelfTestApp()
+{
+	return SelfTestApp;
+}
+
+void SetSelfTestDirectory( const char * path )
+{
+	if ( path == NULL || strlen( path ) >= sizeof( SelfTestDirectory ) )
+	{
+		SelfTestDirectory[0] = '\0';
+		return;
+	}
+	OVR_ASSERT( path[0] == '\0' || path[strlen( path ) - 1] == '/' );
+	strcpy( SelfTestDirectory, path );
+	if ( SelfTestDirectory[0] != '\0' )
+	{
+		mkdir( SelfTestDirectory, S_IRWXU );
+	}
+}
+
+const char * GetSelfTestDirectory()
+{
+	return SelfTestDirectory;
+}
+
+int RunSelfTests( App * app, const bool benchmarks )
+{
+	SelfTestApp = app;
+
+	const int numTests = sizeof( SelfTests ) / sizeof( SelfTests[0] );
+	int failed = 0;
+	for ( int i = 0; i < numTests; i++ )
+	{
+		LOG( "SelfTest: %s", SelfTests[i].Name );
+		const bool passed = SelfTests[i].Run();
+		LOG( "SelfTest: %s %s", SelfTests[i].Name, passed ? "passed" : "FAILED" );
+		if ( !passed )
+		{
+			failed++;
+		}
+	}
+	LOG( "SelfTest: %i of %i failed", failed, numTests );
+
+	if ( benchmarks )
+	{
+		const int numBenchmarks = sizeof( SelfBenchmarks ) / sizeof( SelfBenchmarks[0] );
+		for ( int i = 0; i < numBenchmarks; i++ )
+		{
+			LOG( "SelfTest: benchmark %s", SelfBenchmarks[i].Name );
+			SelfBenchmarks[i].Run();
+		}
+	}
+
+	SelfTestApp = NULL;
+	return failed;
+}
+
+}	// namespace OVR
@@ -0,0 +1,59 @@
+/************************************************************************************
+
+Filename    :   SelfTest.h
+Content     :   Runs the checks and benchmarks that are built into the library.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#ifndef OVR_SelfTest_h
+#define OVR_SelfTest_h
+
+namespace OVR
+{
+
+class App;
+
+// Runs every self test, logging each one as passed or FAILED, and returns
+// the number that failed. None of them need a particular app or scene, and
+// most don't need GL, so they can also be run on a host build, with a NULL
+// app.
+//
+// If benchmarks is set, the benchmarks are run and logged afterwards.
+//
+// Set the dev_selfTests local preference to 1 to run the tests when VR
+// mode is first entered, or to 2 to also run the benchmarks.
+int		RunSelfTests( App * app, const bool benchmarks );
+
+// The app passed to RunSelfTests, for the few tests that need its menus or
+// fonts. NULL on a host build, in which case those tests are skipped.
+App *	GetSelfTestApp();
+
+// A writable directory for tests that need files, which is created if it
+// doesn't exist. The path must end in a slash. Tests that need files are
+// skipped while it is empty, which it is until it is set.
+void			SetSelfTestDirectory( const char * path );
+const char *	GetSelfTestDirectory();
+
+// Counts the allocations the constructing thread makes through the OVR
+// allocator, which is what every Array uses, while it is in scope. Other
+// threads keep allocating as usual and aren't counted. Only one can exist
+// at a time.
+//
+// The counting is done by a wrapper around the OVR allocator that is
+// installed the first time and then left in place, so other threads never
+// see the allocator change under them.
+class AllocationCounter
+{
+public:
+					AllocationCounter();
+					~AllocationCounter();
+
+	int				GetCount() const;
+};
+
+}	// namespace OVR
+
+#endif	// OVR_SelfTest_h
@@ -66,122 +66,122 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 namespace OVR
 {
 
-void * SwipeDir::ThumbnailThread( void * v )
+unsigned char * SwipeDir::LoadThumbnailData( const char * thumbFile, int & width, int & height )
 {
-	int result = pthread_setname_np( pthread_self(), "SwipeDir" );
-	if ( result != 0 )
-	{
-		LOG( "SwipeDir: pthread_setname_np failed %s", strerror( result ) );
-	}
-
-	SwipeDir * swd = (SwipeDir *)v;
 	SearchPaths sp;
+	const String fullPath = sp.GetFullPath( thumbFile );
 
-	for ( ; ; )
+	unsigned char * data = stbi_load( fullPath.ToCStr(), &width, &height, NULL, 4 );
+	if ( !data )
 	{
-		swd->BackgroundCommands.SleepUntilMessage();
-		const char * msg = swd->BackgroundCommands.GetNextMessage();
-		LOG( "BackgroundCommands: %s", msg );
-		if ( MessageQueue::MatchesHead( "load ", msg ) )
-		{
-			int panelId;
-			Array<SwipePanel>	* panels;
-			sscanf( msg, "load %p %i", &panels, &panelId );
-			const char * fileName = strstr( msg, ":" ) + 1;
-
-			const String fullPath = sp.GetFullPath( fileName );
-
-			unsigned char * data;
-			int		width;
-			int		height;
-			data = stbi_load( fullPath.ToCStr(), &width, &height, NULL, 4 );
-			if ( !data )
-			{
-				LOG( "Couldn't load %s", fileName );
-			}
-			else
-			{
-				swd->TextureCommands.PostPrintf( "thumb %p %i %p %i %i",
-					&( *panels ), panelId, data, width, height );
-			}
-			free( (void *)msg );
-		}
-		else if ( MessageQueue::MatchesHead( "create ", msg ) )
-		{
-			const String fullPath = sp.GetFullPath( msg + strlen( "create " ) );
-
-			int	width = 0;
-			int height = 0;
-			unsigned char * data = swd->CreateThumbnail( fullPath.ToCStr( ), width, height );
-
-			// Should we write out a trivial thumbnail if the create failed?
-			if ( data )
-			{
-				// write it out
-				const String	tn = swd->ThumbName( fullPath );
+		LOG( "Couldn't load %s", thumbFile );
+	}
+	return data;
+}
 
-			//String bmpName( fileName );
-			//bmpName += ".bmp";
-			//LOG( "Write bmp %s", bmpName.ToCStr() );
-			//stbi_write_bmp( bmpName.ToCStr(), outW, outH, 4, (unsigned char *)out.Buffer );
+void SwipeDir::CreateThumbnailFile( const char * sourceFile )
+{
+	SearchPaths sp;
+	const String fullPath = sp.GetFullPath( sourceFile );
 
-				WriteJpeg( tn.ToCStr(), data, width, height );
-				free( data );
-			}
+	int	width = 0;
+	int height = 0;
+	unsigned char * data = CreateThumbnail( fullPath.ToCStr( ), width, height );
 
-		}
-		else
+	// Should we write out a trivial thumbnail if the create failed?
+	if ( data )
+	{
+		// Written to a temporary file and renamed into place, the same as
+		// OvrFolderBrowser, so a reader never sees a partial thumbnail.
+		const String	tn = ThumbName( fullPath );
+		const String	temp = tn + ".tmp";
+		WriteJpeg( temp.ToCStr(), data, width, height );
+		free( data );
+		if ( rename( temp.ToCStr(), tn.ToCStr() ) != 0 )
 		{
-			LOG( "SwipeDir::ThumbnailThread received unhandled message: %s", msg );
-			OVR_ASSERT( false );
-			free( (void *)msg );
+			LOG( "CreateThumbnailFile: failed to rename %s", temp.ToCStr() );
+			remove( temp.ToCStr() );
 		}
 	}
-
-	return NULL;
 }
 
-
-
 // Change the size and texture of an existing panel now that the thumbnail
 // image has been loaded by the background thread.
-void LoadThumbnailToTexture( const char * thumbnailCommand )
+void SwipeDir::ApplyThumbnail( const ThumbnailResult & result )
 {
-	Array<SwipePanel> * panels;
-	SwipePanel * panel = NULL;
-	int panelId;
-	unsigned char * data;
-	int width;
-	int height;
-
-	sscanf( thumbnailCommand, "thumb %p %i %p %i %i", &panels, &panelId, &data, &width, &height );
-
-	// find panel using panelId
-	const UPInt numPanels = panels->GetSize( );
-	for ( UPInt index = 0; index < numPanels; ++index )
+	SwipeDirLevel * level = (SwipeDirLevel *)result.UserPointer;
+	const int panelIndex = result.UserId;
+
+	// A cancelled request or a failed load keeps its default texture
+	SwipeDirThumb & thumb = level->Thumbs[panelIndex];
+	if ( thumb.Request != result.Handle )
 	{
-		SwipePanel& currentPanel = panels->At( index );
-		if ( currentPanel.Id == panelId )
-		{
-			panel = &currentPanel;
-			break;
-		}
+		free( result.Data );
+		return;
+	}
+	thumb.Request = 0;
+	thumb.Finished = true;
+	if ( result.Data == NULL )
+	{
+		return;
 	}
 
-	assert( panel );
+	SwipePanel * panel = &level->Swipe->Panels[panelIndex];
 
-	const int max = Alg::Max( width, height );
-	panel->Size[0] *= (float)width / max;
-	panel->Size[1] *= (float)height / max;
+	const int max = Alg::Max( result.Width, result.Height );
+	panel->Size[0] *= (float)result.Width / max;
+	panel->Size[1] *= (float)result.Height / max;
 
 	panel->Texture = LoadRGBATextureFromMemory(
-			data, width, height, true /* srgb */ ).texture;
+			result.Data, result.Width, result.Height, true /* srgb */ ).texture;
 
 	BuildTextureMipmaps( panel->Texture );
 	MakeTextureTrilinear( panel->Texture );
 	MakeTextureClamped( panel->Texture );
 
-	free( data );
+	free( result.Data );
+}
+
+void SwipeDir::PrioritizeThumbnails( SwipeDirLevel * level, const bool isTop )
+{
+	// Levels that aren't being looked at load after everything in the top level
+	static const float BACKGROUND_LEVEL_PRIORITY = 1000.0f;
+
+	SwipeView * swipe = level->Swipe;
+	const int centerColumn = swipe->LayoutColumns() / 2 - (int)floorf( swipe->Offset / swipe->SlotSize.x + 0.5f );
+
+	// SwipeView draws the panels within 90 degrees of the view, keep loading
+	// that much again to either side
+	const int drawnColumns = (int)( ( M_PI / 2 ) / swipe->SlotSize.x ) + 1;
+	const int queuedColumns = isTop ? drawnColumns * 2 : -1;
+
+	ThumbnailLoader & loader = ThumbnailLoader::Get();
+	for ( int i = 0 ; i < level->Thumbs.GetSizeI() ; i++ )
+	{
+		SwipeDirThumb & thumb = level->Thumbs[i];
+		if ( thumb.Finished )
+		{
+			continue;
+		}
+		const int distance = abs( i / swipe->LayoutRows - centerColumn );
+		if ( distance > queuedColumns )
+		{
+			if ( thumb.Request != 0 )
+			{
+				loader.Cancel( thumb.Request );
+				thumb.Request = 0;
+			}
+			continue;
+		}
+		if ( thumb.Request == 0 )
+		{
+			thumb.Request = loader.Request( this, thumb.File, thumb.Source, level, i, (float)distance );
+		}
+		else
+		{
+			loader.Reprioritize( thumb.Request, (float)distance );
+		}
+	}
 }
 
 void SwipeDir::EnterDirectory( const SearchPaths & searchPaths, const char * dirName )
@@ -240,6 +240,7 @@ void SwipeDir::EnterDirectory( const SearchPaths & searchPaths, const char * dir
 	newLev->Swipe->SlotSize.x = PanelWidth + 0.1;
 	newLev->Swipe->SlotSize.y = PanelHeight + 0.05;
 
+	// Thumbnails are queued by PrioritizeThumbnails() once the view is laid out
 	// Find all the files - checks all search paths
 	StringHash< String > uniqueFileList = RelativeDirectoryFileList( searchPaths, dirName );
 	Array<String> fileList;
@@ -259,8 +260,6 @@ void SwipeDir::EnterDirectory( const SearchPaths & searchPaths, const char * dir
 		const String & s = fileList[i];
 
 		// Create the panel for it
-		const int panelIndex = newLev->Swipe->Panels.GetSize();
-
 		if ( MatchesExtension( s, "/" ))
 		{	// subdirectory
 			SwipePanel	panel;
@@ -280,11 +279,9 @@ void SwipeDir::EnterDirectory( const SearchPaths & searchPaths, const char * dir
 			newLev->Swipe->Panels.PushBack( panel );
 
 			// load folder thumbnail
-			const String thumbName = DirectoryThumbName(s);
-
-			char	cmd[1024];
-			sprintf( cmd, "load %p %i:%s", &newLev->Swipe->Panels, panel.Id, thumbName.ToCStr( ) );
-			BackgroundCommands.PostString(String(cmd));
+			SwipeDirThumb thumb;
+			thumb.File = DirectoryThumbName(s);
+			newLev->Thumbs.PushBack( thumb );
 
 			continue;
 		}
@@ -313,25 +310,21 @@ void SwipeDir::EnterDirectory( const SearchPaths & searchPaths, const char * dir
 
 		// If there is not a matching .jpg in the next several files
 		// (there might be other extensions, like .bmp present)
-		// make a create thumbnail command before making the
-		// load thumbnail command.
-		const String	thumbName = ThumbName( s );
+		// have the loader create the thumbnail before loading it.
+		SwipeDirThumb	thumb;
+		thumb.File = ThumbName( s );
 		for ( int check = 1 ; check < 5 ; check++ )
 		{
-			if ( i + check < fileList.GetSize() && fileList[i+check] == thumbName )
+			if ( i + check < fileList.GetSize() && fileList[i+check] == thumb.File )
 			{	// don't need to create
 				break;
 			}
 			if ( check == 4 )
 			{
-				String	cmd( "create " );
-				cmd += s;
-				BackgroundCommands.PostString( cmd );
+				thumb.Source = s;
 			}
 		}
-		char	cmd[1024];
-		sprintf( cmd, "load %p %i:%s", &newLev->Swipe->Panels, panel.Id, thumbName.ToCStr( ) );
-		BackgroundCommands.PostString( String( cmd ) );
+		newLev->Thumbs.PushBack( thumb );
 	}
 
 
@@ -359,7 +352,7 @@ SwipeDir::SwipeDir( const char *	rootDir,	// Should include a trailing slash
 		int				panelRows )
 : RelativeRootDir( rootDir ), ParentApp( app ), DefaultFileTexture( defaultFileTexture ),
   DefaultDirectoryTexture( defaultDirectoryTexture ), PanelWidth( panelWidth ),
-  PanelHeight( panelHeight ), PanelGap( panelGap ), PanelRows( panelRows ), TextureCommands( 10000 ), BackgroundCommands( 10000 )
+  PanelHeight( panelHeight ), PanelGap( panelGap ), PanelRows( panelRows ), ThumbLevel( NULL ), ThumbCenterColumn( 0 )
 {
 	// add trailing slash to rootDir if necessary
 	const int l = strlen( rootDir );
@@ -368,15 +361,6 @@ SwipeDir::SwipeDir( const char *	rootDir,	// Should include a trailing slash
 		RelativeRootDir = RelativeRootDir + "/";
 	}
 
-	// spawn the thumbnail loading thread with the command list
-	pthread_t loadingThread;
-	const int createErr = pthread_create( &loadingThread, NULL /* default attributes */,
-			&ThumbnailThread, this );
-	if ( createErr != 0 )
-	{
-		LOG( "pthread_create returned %i", createErr );
-	}
-
 	// We can't enter the root directory in the constructor, because the
 	// vtbl hasn't been set up to allow calling ShouldAddFile() yet.
 }
@@ -437,18 +421,13 @@ void	SwipeDir::BackDirectory()
 String SwipeDir::Frame( App * app, const VrFrame & vrFrame, const Matrix4f & view, SearchPaths const & searchPaths )
 {
 	// Check for thumbnail loads
-	while( 1 )
+	ThumbnailResults.Clear();
+	ThumbnailLoader::Get().GetCompleted( this, ThumbnailResults );
+	for ( int i = 0 ; i < ThumbnailResults.GetSizeI() ; i++ )
 	{
-		const char * cmd = TextureCommands.GetNextMessage();
-		if ( !cmd )
-		{
-			break;
-		}
-
-		LOG( "TextureCommands: %s", cmd );
-		LoadThumbnailToTexture( cmd );
-		free( (void *)cmd );
+		ApplyThumbnail( ThumbnailResults[i] );
 	}
+	ThumbnailResults.Clear();
 
 
 	// Process active swipe view
@@ -459,6 +438,27 @@ String SwipeDir::Frame( App * app, const VrFrame & vrFrame, const Matrix4f & vie
 
 	SwipeView * swipe = Path[Path.GetSize()-1]->Swipe;
 
+	// Re-prioritize outstanding thumbnail loads when the view scrolls a column
+	// or a different directory comes to the top
+	SwipeDirLevel * topLevel = Path[Path.GetSize()-1];
+	const int centerColumn = (int)floorf( swipe->Offset / swipe->SlotSize.x + 0.5f );
+	if ( topLevel != ThumbLevel || centerColumn != ThumbCenterColumn )
+	{
+		if ( topLevel != ThumbLevel )
+		{
+			for ( int i = 0 ; i < Directories.GetSizeI() ; i++ )
+			{
+				if ( Directories[i] != topLevel )
+				{
+					PrioritizeThumbnails( Directories[i], false );
+				}
+			}
+		}
+		PrioritizeThumbnails( topLevel, true );
+		ThumbLevel = topLevel;
+		ThumbCenterColumn = centerColumn;
+	}
+
 	const SwipeAction swipeAct = swipe->Frame( app->GetGazeCursor(), app->GetDefaultFont(),
             app->GetWorldFontSurface(), vrFrame, view,
             !app->IsGuiOpen() && !app->IsPassThroughCameraEnabled() );
@@ -533,6 +533,11 @@ bool	SwipeDir::IsActive()
 // Frees all the created panels and images (not the defaults)
 SwipeDir::~SwipeDir()
 {
+	ThumbnailLoader::Get().RemoveClient( this );
+	for ( int i = 0 ; i < ThumbnailResults.GetSizeI() ; i++ )
+	{
+		free( ThumbnailResults[i].Data );
+	}
 	// TODO!
 }
 
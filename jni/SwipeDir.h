@@ -17,6 +17,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "MessageQueue.h"
 #include "Kernel/OVR_Array.h"
 #include "App.h"
+#include "ThumbnailLoader.h"
 
 namespace OVR
 {
@@ -24,6 +25,18 @@ namespace OVR
 class SearchPaths;
 class SwipeDir;
 
+// The thumbnail of a panel, which is only queued with the ThumbnailLoader
+// while the panel is on or near the screen.
+struct SwipeDirThumb
+{
+	SwipeDirThumb() : Request( 0 ), Finished( false ) {};
+
+	thumbRequestHandle_t	Request;	// 0 if not queued
+	String					File;
+	String					Source;		// to create the thumbnail from, empty if it exists
+	bool					Finished;	// loaded or failed, never queued again
+};
+
 class SwipeDirLevel
 {
 public:
@@ -32,12 +45,15 @@ public:
 	SwipeDir *	Root;
 	String		FullPath;
 	SwipeView * Swipe;
+
+	// Parallel to Swipe->Panels
+	Array<SwipeDirThumb>	Thumbs;
 };
 
-class SwipeDir
+class SwipeDir : public ThumbnailLoaderClient
 {
 public:
-	// Starts a background thread to load thumbnails
+	// Thumbnails are loaded by the shared ThumbnailLoader
 	SwipeDir( const char *	relativeRootDir,	// Should include a trailing slash
 			App & 			app,		// For playing sounds, gaze cursor, font, and fontSurface
 			unsigned 		defaultFileTexture,
@@ -82,7 +98,7 @@ public:
 	// Names that match the thumbnail patter will have already been excluded.
 	virtual bool ShouldAddFile( const char * filename ) = 0;
 
-	// Called on a background thread
+	// Called on a ThumbnailLoader thread - possibly several at once
 	//
 	// Create the thumbnail image for the file, which will
 	// be saved out as a _thumb.jpg.
@@ -104,7 +120,17 @@ public:
 
 private:
 	void	EnterDirectory( SearchPaths const & searchPaths, const char * dirName );
-	static void * ThumbnailThread( void * v );
+
+	// ThumbnailLoaderClient
+	virtual unsigned char *	LoadThumbnailData( const char * thumbFile, int & width, int & height );
+	virtual void			CreateThumbnailFile( const char * sourceFile );
+
+	static void	ApplyThumbnail( const ThumbnailResult & result );
+
+	// Loads closest to the columns in view are serviced first. Loads for
+	// panels that scrolled well off the screen, or for levels that aren't
+	// on top, are cancelled until they come back.
+	void	PrioritizeThumbnails( SwipeDirLevel * level, const bool isTop );
 
 	String				RelativeRootDir;
 	App &		 		ParentApp;				// For playing sounds, gaze cursor, font, and fontSurface
@@ -115,11 +141,12 @@ private:
 	float				PanelGap;
 	int					PanelRows;
 
-	// Checked at Frame() time for commands from the thumbnail/create thread
-	MessageQueue		TextureCommands;
+	// Finished thumbnail loads collected at Frame() time
+	Array<ThumbnailResult>	ThumbnailResults;
 
-	// Create / load thumbnails by background thread
-	MessageQueue		BackgroundCommands;
+	// Where the thumbnail priorities were last computed from
+	SwipeDirLevel *		ThumbLevel;
+	int					ThumbCenterColumn;
 
 	// Path[0] is the root directory
 	// Path[Path.GetSize()-1] is the current directory
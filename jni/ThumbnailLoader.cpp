@@ -0,0 +1,788 @@
+/************************************************************************************
+
+Filename    :   ThumbnailLoader.cpp
+Content     :   Shared, prioritized background loading of thumbnail images.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "ThumbnailLoader.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>			// for usleep
+
+#include "Log.h"
+#include "Profiler.h"
+#include "VrApi/VrApi.h"
+
+namespace OVR
+{
+
+ThumbnailLoader & ThumbnailLoader::Get()
+{
+	// Never destroyed - the worker threads run for the life of the process,
+	// the same as the per-browser thumbnail threads this replaced.
+	static ThumbnailLoader * loader = NULL;
+	if ( loader == NULL )
+	{
+		loader = new ThumbnailLoader( DEFAULT_WORKER_THREADS, DEFAULT_CACHE_BYTES );
+	}
+	return *loader;
+}
+
+ThumbnailLoader::ThumbnailLoader( int const numWorkers, int const maxCacheBytes ) :
+	NextHandle( 1 ),
+	CacheBytes( 0 ),
+	MaxCacheBytes( maxCacheBytes ),
+	CacheUseCounter( 0 ),
+	Exiting( false )
+{
+	pthread_mutex_init( &Mutex, NULL );
+	pthread_cond_init( &Wake, NULL );
+	pthread_cond_init( &Idle, NULL );
+
+	for ( int i = 0; i < numWorkers; i++ )
+	{
+		pthread_t workerThread;
+		const int createErr = pthread_create( &workerThread, NULL /* default attributes */,
+				&WorkerThread, this );
+		if ( createErr != 0 )
+		{
+			LOG( "ThumbnailLoader: pthread_create returned %i", createErr );
+			continue;
+		}
+		Workers.PushBack( workerThread );
+	}
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+	// Workers finish what they are loading, pending requests are dropped
+	pthread_mutex_lock( &Mutex );
+	Exiting = true;
+	pthread_cond_broadcast( &Wake );
+	pthread_mutex_unlock( &Mutex );
+	for ( int i = 0; i < Workers.GetSizeI(); i++ )
+	{
+		pthread_join( Workers[i], NULL );
+	}
+
+	for ( int i = 0; i < Completed.GetSizeI(); i++ )
+	{
+		free( Completed[i].Result.Data );
+	}
+	for ( int i = 0; i < Cache.GetSizeI(); i++ )
+	{
+		free( Cache[i].Data );
+	}
+	pthread_mutex_destroy( &Mutex );
+	pthread_cond_destroy( &Wake );
+	pthread_cond_destroy( &Idle );
+}
+
+thumbRequestHandle_t ThumbnailLoader::Request( ThumbnailLoaderClient * client, const String & thumbFile,
+		const String & sourceFile, void * userPointer, int userId, float priority )
+{
+	OVR_ASSERT( client != NULL );
+
+	Request_t request;
+	request.Client = client;
+	request.ThumbFile = thumbFile;
+	request.SourceFile = sourceFile;
+	request.UserPointer = userPointer;
+	request.UserId = userId;
+	request.Priority = priority;
+	request.RequestTime = ovr_GetTimeInSeconds();
+
+	pthread_mutex_lock( &Mutex );
+
+	request.Handle = NextHandle++;
+	if ( NextHandle == 0 )
+	{
+		NextHandle = 1;
+	}
+	LoaderStats.NumRequested++;
+
+	// A cached thumbnail completes right away without waking a worker
+	int width = 0;
+	int height = 0;
+	unsigned char * data = CopyFromCache( client, thumbFile, width, height );
+	if ( data != NULL )
+	{
+		LoaderStats.NumCacheHits++;
+
+		Completed_t completed;
+		completed.Client = client;
+		completed.Result.Handle = request.Handle;
+		completed.Result.UserPointer = userPointer;
+		completed.Result.UserId = userId;
+		completed.Result.Data = data;
+		completed.Result.Width = width;
+		completed.Result.Height = height;
+		completed.RequestTime = request.RequestTime;
+		Completed.PushBack( completed );
+	}
+	else
+	{
+		Pending.PushBack( request );
+		pthread_cond_signal( &Wake );
+	}
+
+	pthread_mutex_unlock( &Mutex );
+
+	return request.Handle;
+}
+
+bool ThumbnailLoader::Cancel( thumbRequestHandle_t const handle )
+{
+	if ( handle == 0 )
+	{
+		return false;
+	}
+
+	pthread_mutex_lock( &Mutex );
+
+	bool found = false;
+	for ( int i = 0; i < Pending.GetSizeI() && !found; i++ )
+	{
+		if ( Pending[i].Handle == handle )
+		{
+			Pending.RemoveAtUnordered( i );
+			found = true;
+		}
+	}
+	for ( int i = 0; i < InFlight.GetSizeI() && !found; i++ )
+	{
+		if ( InFlight[i].Handle == handle )
+		{
+			// the worker drops the result when it finishes
+			InFlight[i].Cancelled = true;
+			found = true;
+		}
+	}
+	for ( int i = 0; i < Completed.GetSizeI() && !found; i++ )
+	{
+		if ( Completed[i].Result.Handle == handle )
+		{
+			free( Completed[i].Result.Data );
+			Completed.RemoveAt( i );
+			found = true;
+		}
+	}
+	if ( found )
+	{
+		LoaderStats.NumCancelled++;
+	}
+
+	pthread_mutex_unlock( &Mutex );
+
+	return found;
+}
+
+bool ThumbnailLoader::Reprioritize( thumbRequestHandle_t const handle, float const priority )
+{
+	if ( handle == 0 )
+	{
+		return false;
+	}
+
+	pthread_mutex_lock( &Mutex );
+
+	bool found = false;
+	for ( int i = 0; i < Pending.GetSizeI(); i++ )
+	{
+		if ( Pending[i].Handle == handle )
+		{
+			Pending[i].Priority = priority;
+			found = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock( &Mutex );
+
+	return found;
+}
+
+void ThumbnailLoader::GetCompleted( ThumbnailLoaderClient * client, Array< ThumbnailResult > & results )
+{
+	const double now = ovr_GetTimeInSeconds();
+
+	pthread_mutex_lock( &Mutex );
+
+	// keep the completion order
+	int numKept = 0;
+	for ( int i = 0; i < Completed.GetSizeI(); i++ )
+	{
+		if ( Completed[i].Client != client )
+		{
+			Completed[numKept++] = Completed[i];
+			continue;
+		}
+
+		const double latency = now - Completed[i].RequestTime;
+		LoaderStats.NumDelivered++;
+		LoaderStats.TotalLatencySeconds += latency;
+		if ( latency > LoaderStats.MaxLatencySeconds )
+		{
+			LoaderStats.MaxLatencySeconds = latency;
+		}
+
+		results.PushBack( Completed[i].Result );
+	}
+	Completed.Resize( numKept );
+
+	pthread_mutex_unlock( &Mutex );
+}
+
+void ThumbnailLoader::RemoveClient( ThumbnailLoaderClient * client )
+{
+	pthread_mutex_lock( &Mutex );
+
+	for ( int i = Pending.GetSizeI() - 1; i >= 0; i-- )
+	{
+		if ( Pending[i].Client == client )
+		{
+			Pending.RemoveAtUnordered( i );
+		}
+	}
+
+	// wait for anything already being loaded for the client
+	for ( ; ; )
+	{
+		bool busy = false;
+		for ( int i = 0; i < InFlight.GetSizeI(); i++ )
+		{
+			if ( InFlight[i].Client == client )
+			{
+				InFlight[i].Cancelled = true;
+				busy = true;
+			}
+		}
+		if ( !busy )
+		{
+			break;
+		}
+		pthread_cond_wait( &Idle, &Mutex );
+	}
+
+	for ( int i = Completed.GetSizeI() - 1; i >= 0; i-- )
+	{
+		if ( Completed[i].Client == client )
+		{
+			free( Completed[i].Result.Data );
+			Completed.RemoveAt( i );
+		}
+	}
+
+	for ( int i = Cache.GetSizeI() - 1; i >= 0; i-- )
+	{
+		if ( Cache[i].Client == client )
+		{
+			FreeCacheEntry( i );
+		}
+	}
+
+	pthread_mutex_unlock( &Mutex );
+}
+
+ThumbnailLoader::Stats ThumbnailLoader::GetStats() const
+{
+	pthread_mutex_lock( &Mutex );
+	const Stats stats = LoaderStats;
+	pthread_mutex_unlock( &Mutex );
+	return stats;
+}
+
+void ThumbnailLoader::LogStats() const
+{
+	const Stats stats = GetStats();
+	LOG( "ThumbnailLoader: %i requested, %i loaded, %i failed, %i cancelled, %i cache hits, %i delivered",
+			stats.NumRequested, stats.NumLoaded, stats.NumFailed, stats.NumCancelled,
+			stats.NumCacheHits, stats.NumDelivered );
+	if ( stats.NumDelivered > 0 )
+	{
+		LOG( "ThumbnailLoader: latency to delivery avg %.1f ms, max %.1f ms",
+				stats.TotalLatencySeconds * 1000.0 / stats.NumDelivered, stats.MaxLatencySeconds * 1000.0 );
+	}
+}
+
+void * ThumbnailLoader::WorkerThread( void * v )
+{
+	int result = pthread_setname_np( pthread_self(), "ThumbLoader" );
+	if ( result != 0 )
+	{
+		LOG( "ThumbnailLoader: pthread_setname_np failed %s", strerror( result ) );
+	}
+
+	Profiler::SetThreadName( "ThumbLoader" );
+
+	( (ThumbnailLoader *)v )->ServiceRequests();
+	return NULL;
+}
+
+void ThumbnailLoader::ServiceRequests()
+{
+	for ( ; ; )
+	{
+		pthread_mutex_lock( &Mutex );
+		while ( Pending.GetSizeI() == 0 && !Exiting )
+		{
+			pthread_cond_wait( &Wake, &Mutex );
+		}
+		if ( Exiting )
+		{
+			pthread_mutex_unlock( &Mutex );
+			return;
+		}
+
+		// Pick the most important request. There are rarely more than a few
+		// hundred pending, so a linear search keeps re-prioritizing trivial.
+		int best = 0;
+		for ( int i = 1; i < Pending.GetSizeI(); i++ )
+		{
+			if ( Pending[i].Priority < Pending[best].Priority )
+			{
+				best = i;
+			}
+		}
+		const Request_t request = Pending[best];
+		Pending.RemoveAtUnordered( best );
+		InFlight.PushBack( request );
+
+		// Only one worker at a time may create or load a given thumbnail file,
+		// otherwise two workers can truncate and write it at the same time.
+		// The one that waited usually finds the result in the cache.
+		while ( IsBusy( request.ThumbFile ) )
+		{
+			pthread_cond_wait( &Idle, &Mutex );
+		}
+
+		int width = 0;
+		int height = 0;
+		unsigned char * data = CopyFromCache( request.Client, request.ThumbFile, width, height );
+		const bool pushedBusy = ( data == NULL );
+		if ( pushedBusy )
+		{
+			BusyThumbFiles.PushBack( request.ThumbFile );
+		}
+		else
+		{
+			LoaderStats.NumCacheHits++;
+		}
+
+		pthread_mutex_unlock( &Mutex );
+
+		if ( data == NULL )
+		{
+			OVR_PROFILE_SCOPE( "LoadThumbnail" );
+
+			if ( !request.SourceFile.IsEmpty() )
+			{
+				request.Client->CreateThumbnailFile( request.SourceFile.ToCStr() );
+			}
+			data = request.Client->LoadThumbnailData( request.ThumbFile.ToCStr(), width, height );
+
+			if ( data != NULL )
+			{
+				// The cache keeps its own copy, since the client frees the result
+				const int numBytes = width * height * 4;
+				unsigned char * cacheData = (unsigned char *)malloc( numBytes );
+				memcpy( cacheData, data, numBytes );
+
+				pthread_mutex_lock( &Mutex );
+				LoaderStats.NumLoaded++;
+				AddToCache( request.Client, request.ThumbFile, cacheData, width, height );
+				pthread_mutex_unlock( &Mutex );
+			}
+			else
+			{
+				LOG( "ThumbnailLoader: couldn't load %s", request.ThumbFile.ToCStr() );
+			}
+		}
+
+		pthread_mutex_lock( &Mutex );
+
+		// Another worker may have pushed the same file after a cache hit here,
+		// so only an entry this worker pushed is removed.
+		for ( int i = 0; i < BusyThumbFiles.GetSizeI() && pushedBusy; i++ )
+		{
+			if ( BusyThumbFiles[i] == request.ThumbFile )
+			{
+				BusyThumbFiles.RemoveAtUnordered( i );
+				break;
+			}
+		}
+
+		for ( int i = 0; i < InFlight.GetSizeI(); i++ )
+		{
+			if ( InFlight[i].Handle != request.Handle )
+			{
+				continue;
+			}
+			if ( InFlight[i].Cancelled )
+			{
+				free( data );
+			}
+			else
+			{
+				if ( data == NULL )
+				{
+					LoaderStats.NumFailed++;
+				}
+				Completed_t completed;
+				completed.Client = request.Client;
+				completed.Result.Handle = request.Handle;
+				completed.Result.UserPointer = request.UserPointer;
+				completed.Result.UserId = request.UserId;
+				completed.Result.Data = data;
+				completed.Result.Width = width;
+				completed.Result.Height = height;
+				completed.RequestTime = request.RequestTime;
+				Completed.PushBack( completed );
+			}
+			InFlight.RemoveAtUnordered( i );
+			break;
+		}
+
+		pthread_cond_broadcast( &Idle );
+		pthread_mutex_unlock( &Mutex );
+	}
+}
+
+bool ThumbnailLoader::IsBusy( const String & thumbFile ) const
+{
+	for ( int i = 0; i < BusyThumbFiles.GetSizeI(); i++ )
+	{
+		if ( BusyThumbFiles[i] == thumbFile )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned char * ThumbnailLoader::CopyFromCache( ThumbnailLoaderClient * client, const String & thumbFile, int & width, int & height )
+{
+	for ( int i = 0; i < Cache.GetSizeI(); i++ )
+	{
+		CacheEntry_t & entry = Cache[i];
+		if ( entry.Client == client && entry.ThumbFile == thumbFile )
+		{
+			entry.LastUse = ++CacheUseCounter;
+			width = entry.Width;
+			height = entry.Height;
+			const int numBytes = width * height * 4;
+			unsigned char * data = (unsigned char *)malloc( numBytes );
+			memcpy( data, entry.Data, numBytes );
+			return data;
+		}
+	}
+	return NULL;
+}
+
+void ThumbnailLoader::AddToCache( ThumbnailLoaderClient * client, const String & thumbFile, unsigned char * data, int const width, int const height )
+{
+	const int numBytes = width * height * 4;
+	if ( numBytes > MaxCacheBytes )
+	{
+		free( data );
+		return;
+	}
+
+	// another worker may have loaded the same file
+	for ( int i = 0; i < Cache.GetSizeI(); i++ )
+	{
+		if ( Cache[i].Client == client && Cache[i].ThumbFile == thumbFile )
+		{
+			FreeCacheEntry( i );
+			break;
+		}
+	}
+
+	// evict least recently used entries until it fits
+	while ( CacheBytes + numBytes > MaxCacheBytes && Cache.GetSizeI() > 0 )
+	{
+		int oldest = 0;
+		for ( int i = 1; i < Cache.GetSizeI(); i++ )
+		{
+			if ( (SInt32)( Cache[i].LastUse - Cache[oldest].LastUse ) < 0 )
+			{
+				oldest = i;
+			}
+		}
+		FreeCacheEntry( oldest );
+	}
+
+	CacheEntry_t entry;
+	entry.Client = client;
+	entry.ThumbFile = thumbFile;
+	entry.Data = data;
+	entry.Width = width;
+	entry.Height = height;
+	entry.LastUse = ++CacheUseCounter;
+	Cache.PushBack( entry );
+	CacheBytes += numBytes;
+}
+
+void ThumbnailLoader::FreeCacheEntry( int const index )
+{
+	CacheEntry_t & entry = Cache[index];
+	CacheBytes -= entry.Width * entry.Height * 4;
+	free( entry.Data );
+	Cache.RemoveAtUnordered( index );
+}
+
+//==============================================================
+// Test
+
+// Makes up 4x4 thumbnails filled with the first letter of their name, and
+// records the order they are loaded in. Loads of files starting with "hold"
+// block between Hold() and Release(), so requests can queue up behind them.
+class ThumbnailTestClient : public ThumbnailLoaderClient
+{
+public:
+	ThumbnailTestClient() :
+		Holding( false ),
+		Held( false ),
+		NumCreated( 0 )
+	{
+		pthread_mutex_init( &Mutex, NULL );
+		pthread_cond_init( &Changed, NULL );
+	}
+
+	~ThumbnailTestClient()
+	{
+		pthread_mutex_destroy( &Mutex );
+		pthread_cond_destroy( &Changed );
+	}
+
+	virtual unsigned char * LoadThumbnailData( const char * thumbFile, int & width, int & height )
+	{
+		pthread_mutex_lock( &Mutex );
+		Loads.PushBack( String( thumbFile ) );
+		if ( strncmp( thumbFile, "hold", 4 ) == 0 )
+		{
+			Held = true;
+			pthread_cond_broadcast( &Changed );
+			while ( Holding )
+			{
+				pthread_cond_wait( &Changed, &Mutex );
+			}
+		}
+		pthread_mutex_unlock( &Mutex );
+
+		if ( strcmp( thumbFile, "missing" ) == 0 )
+		{
+			return NULL;
+		}
+		width = 4;
+		height = 4;
+		unsigned char * data = (unsigned char *)malloc( width * height * 4 );
+		memset( data, thumbFile[0], width * height * 4 );
+		return data;
+	}
+
+	virtual void CreateThumbnailFile( const char * sourceFile )
+	{
+		pthread_mutex_lock( &Mutex );
+		NumCreated++;
+		pthread_mutex_unlock( &Mutex );
+	}
+
+	void Hold()
+	{
+		pthread_mutex_lock( &Mutex );
+		Holding = true;
+		Held = false;
+		pthread_mutex_unlock( &Mutex );
+	}
+
+	// Returns false if no worker got to a held file within a second.
+	bool WaitUntilHeld()
+	{
+		for ( int i = 0; i < 1000; i++ )
+		{
+			pthread_mutex_lock( &Mutex );
+			const bool held = Held;
+			pthread_mutex_unlock( &Mutex );
+			if ( held )
+			{
+				return true;
+			}
+			usleep( 1000 );
+		}
+		return false;
+	}
+
+	void Release()
+	{
+		pthread_mutex_lock( &Mutex );
+		Holding = false;
+		pthread_cond_broadcast( &Changed );
+		pthread_mutex_unlock( &Mutex );
+	}
+
+	String GetLoads()
+	{
+		pthread_mutex_lock( &Mutex );
+		String loads;
+		for ( int i = 0; i < Loads.GetSizeI(); i++ )
+		{
+			loads += ( i > 0 ) ? " " : "";
+			loads += Loads[i];
+		}
+		pthread_mutex_unlock( &Mutex );
+		return loads;
+	}
+
+	int GetNumCreated()
+	{
+		pthread_mutex_lock( &Mutex );
+		const int numCreated = NumCreated;
+		pthread_mutex_unlock( &Mutex );
+		return numCreated;
+	}
+
+private:
+	pthread_mutex_t		Mutex;
+	pthread_cond_t		Changed;
+	bool				Holding;
+	bool				Held;
+	Array< String >		Loads;
+	int					NumCreated;
+};
+
+// Collects results until there are numResults of them, or a second has passed.
+static void CollectResults( ThumbnailLoader & loader, ThumbnailLoaderClient & client,
+		Array< ThumbnailResult > & results, const int numResults )
+{
+	for ( int i = 0; i < 1000 && results.GetSizeI() < numResults; i++ )
+	{
+		loader.GetCompleted( &client, results );
+		if ( results.GetSizeI() < numResults )
+		{
+			usleep( 1000 );
+		}
+	}
+}
+
+static void FreeResults( Array< ThumbnailResult > & results )
+{
+	for ( int i = 0; i < results.GetSizeI(); i++ )
+	{
+		free( results[i].Data );
+	}
+	results.Clear();
+}
+
+bool ThumbnailLoader::Test()
+{
+	// A single worker services the requests in priority order, so that is
+	// the order they are loaded in.
+	ThumbnailLoader * loader = new ThumbnailLoader( 1, 1024 * 1024 );
+	ThumbnailTestClient client;
+	Array< ThumbnailResult > results;
+	int numErrors = 0;
+
+	// Queue requests out of order behind a held load, then move one up and cancel another.
+	client.Hold();
+	loader->Request( &client, "hold", String(), NULL, 'h', 0.0f );
+	if ( !client.WaitUntilHeld() )
+	{
+		LOG( "ThumbnailLoader::Test: the worker never started loading" );
+		client.Release();
+		delete loader;
+		return false;
+	}
+	loader->Request( &client, "c", String(), NULL, 'c', 3.0f );
+	loader->Request( &client, "a", String(), NULL, 'a', 1.0f );
+	const thumbRequestHandle_t cancelled = loader->Request( &client, "d", String(), NULL, 'd', 4.0f );
+	const thumbRequestHandle_t moved = loader->Request( &client, "b", String( "b.source" ), NULL, 'b', 10.0f );
+	if ( !loader->Reprioritize( moved, 2.0f ) || !loader->Cancel( cancelled ) )
+	{
+		LOG( "ThumbnailLoader::Test: couldn't reprioritize or cancel a pending request" );
+		numErrors++;
+	}
+	client.Release();
+
+	CollectResults( *loader, client, results, 4 );
+	if ( client.GetLoads() != "hold a b c" )
+	{
+		LOG( "ThumbnailLoader::Test: loaded \"%s\" instead of \"hold a b c\"", client.GetLoads().ToCStr() );
+		numErrors++;
+	}
+	if ( results.GetSizeI() != 4 || client.GetNumCreated() != 1 )
+	{
+		LOG( "ThumbnailLoader::Test: %i results and %i creates instead of 4 and 1", results.GetSizeI(), client.GetNumCreated() );
+		numErrors++;
+	}
+	for ( int i = 0; i < results.GetSizeI(); i++ )
+	{
+		const ThumbnailResult & result = results[i];
+		if ( result.Data == NULL || result.Width != 4 || result.Height != 4 || result.Data[0] != result.UserId )
+		{
+			LOG( "ThumbnailLoader::Test: wrong result for request '%c'", result.UserId );
+			numErrors++;
+		}
+	}
+	if ( loader->Cancel( cancelled ) )
+	{
+		LOG( "ThumbnailLoader::Test: a cancelled request was cancelled again" );
+		numErrors++;
+	}
+	FreeResults( results );
+
+	// A cached thumbnail completes in Request() without a load.
+	loader->Request( &client, "a", String(), NULL, 'a', 0.0f );
+	loader->GetCompleted( &client, results );
+	if ( results.GetSizeI() != 1 || results[0].Data == NULL || results[0].Data[0] != 'a' ||
+			client.GetLoads() != "hold a b c" || loader->GetStats().NumCacheHits != 1 )
+	{
+		LOG( "ThumbnailLoader::Test: %i results and %i cache hits for a cached thumbnail",
+				results.GetSizeI(), loader->GetStats().NumCacheHits );
+		numErrors++;
+	}
+	FreeResults( results );
+
+	// Two pending requests for the same file load it once, the second one
+	// hits the cache in the worker, and neither leaves the file busy.
+	client.Hold();
+	loader->Request( &client, "hold2", String(), NULL, 'h', 0.0f );
+	client.WaitUntilHeld();
+	loader->Request( &client, "e", String(), NULL, 'e', 1.0f );
+	loader->Request( &client, "e", String(), NULL, 'e', 2.0f );
+	client.Release();
+	CollectResults( *loader, client, results, 3 );
+	pthread_mutex_lock( &loader->Mutex );
+	const int numBusy = loader->BusyThumbFiles.GetSizeI();
+	pthread_mutex_unlock( &loader->Mutex );
+	if ( results.GetSizeI() != 3 || client.GetLoads() != "hold a b c hold2 e" ||
+			loader->GetStats().NumCacheHits != 2 || numBusy != 0 )
+	{
+		LOG( "ThumbnailLoader::Test: loaded \"%s\" with %i cache hits and %i busy files for a repeated request",
+				client.GetLoads().ToCStr(), loader->GetStats().NumCacheHits, numBusy );
+		numErrors++;
+	}
+	FreeResults( results );
+
+	// A failed load still completes, without data.
+	loader->Request( &client, "missing", String(), NULL, 'm', 0.0f );
+	CollectResults( *loader, client, results, 1 );
+	if ( results.GetSizeI() != 1 || results[0].Data != NULL || loader->GetStats().NumFailed != 1 )
+	{
+		LOG( "ThumbnailLoader::Test: %i results and %i failures for a missing thumbnail",
+				results.GetSizeI(), loader->GetStats().NumFailed );
+		numErrors++;
+	}
+	FreeResults( results );
+
+	delete loader;
+
+	return numErrors == 0;
+}
+
+}	// namespace OVR
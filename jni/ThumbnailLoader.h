@@ -0,0 +1,211 @@
+/************************************************************************************
+
+Filename    :   ThumbnailLoader.h
+Content     :   Shared, prioritized background loading of thumbnail images.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+#ifndef OVR_ThumbnailLoader_h
+#define OVR_ThumbnailLoader_h
+
+#include <pthread.h>
+#include "Kernel/OVR_Types.h"
+#include "Kernel/OVR_String.h"
+#include "Kernel/OVR_Array.h"
+
+namespace OVR
+{
+
+// 0 is never a valid request
+typedef UInt32 thumbRequestHandle_t;
+
+//==============================================================
+// ThumbnailLoaderClient
+//
+// Implemented by anything that wants thumbnails loaded. The two virtuals are
+// called on loader threads, possibly concurrently with each other for
+// different requests, so they must not touch state owned by the main thread.
+class ThumbnailLoaderClient
+{
+public:
+	virtual ~ThumbnailLoaderClient() {}
+
+	// Returns a malloc()'d RGBA buffer, or NULL if the thumbnail couldn't be loaded.
+	virtual unsigned char *	LoadThumbnailData( const char * thumbFile, int & width, int & height ) = 0;
+
+	// Called before LoadThumbnailData() for requests that were made with a
+	// source file, so the thumbnail can be written out before it is loaded.
+	virtual void			CreateThumbnailFile( const char * sourceFile ) {}
+};
+
+//==============================================================
+// ThumbnailResult
+struct ThumbnailResult
+{
+	ThumbnailResult() :
+		Handle( 0 ),
+		UserPointer( NULL ),
+		UserId( 0 ),
+		Data( NULL ),
+		Width( 0 ),
+		Height( 0 )
+	{
+	}
+
+	thumbRequestHandle_t	Handle;
+	void *					UserPointer;	// passed through from the request
+	int						UserId;			// passed through from the request
+	unsigned char *			Data;			// RGBA, NULL if the load failed - the receiver must free() it
+	int						Width;
+	int						Height;
+};
+
+//==============================================================
+// ThumbnailLoader
+//
+// A pool of worker threads shared by every browser in the process. Pending
+// requests are serviced lowest priority value first, so clients should use
+// the distance of the item from what the user is looking at. Requests can be
+// cancelled or re-prioritized at any time until their result is collected.
+//
+// Recently decoded thumbnails are kept in a bounded cache so scrolling back
+// to an item doesn't go back to disk.
+class ThumbnailLoader
+{
+public:
+	struct Stats
+	{
+		Stats() :
+			NumRequested( 0 ),
+			NumLoaded( 0 ),
+			NumFailed( 0 ),
+			NumCancelled( 0 ),
+			NumCacheHits( 0 ),
+			NumDelivered( 0 ),
+			TotalLatencySeconds( 0.0 ),
+			MaxLatencySeconds( 0.0 )
+		{
+		}
+
+		int		NumRequested;
+		int		NumLoaded;				// decoded by a loader thread
+		int		NumFailed;
+		int		NumCancelled;
+		int		NumCacheHits;
+		int		NumDelivered;			// handed back to a client through GetCompleted()
+		double	TotalLatencySeconds;	// from Request() to GetCompleted() for delivered results
+		double	MaxLatencySeconds;
+	};
+
+	static const int	DEFAULT_WORKER_THREADS = 2;
+	static const int	DEFAULT_CACHE_BYTES = 16 * 1024 * 1024;
+
+	// The process-wide loader, started on first use.
+	static ThumbnailLoader &	Get();
+
+	// Queues a load of thumbFile. If sourceFile is not empty, the client is
+	// asked to create the thumbnail from it before the load.
+	thumbRequestHandle_t	Request( ThumbnailLoaderClient * client, const String & thumbFile,
+								const String & sourceFile, void * userPointer, int userId,
+								float priority );
+
+	// Returns false if the request was already completed and collected.
+	bool					Cancel( thumbRequestHandle_t const handle );
+
+	// Returns false if the request is no longer pending.
+	bool					Reprioritize( thumbRequestHandle_t const handle, float const priority );
+
+	// Moves every finished request for the client to results. Call from the main thread.
+	void					GetCompleted( ThumbnailLoaderClient * client, Array< ThumbnailResult > & results );
+
+	// Cancels everything for the client and blocks until none of its requests are
+	// being worked on. Must be called before a client is destroyed.
+	void					RemoveClient( ThumbnailLoaderClient * client );
+
+	Stats					GetStats() const;
+	void					LogStats() const;
+
+	// Checks the priority order, cancellation and both cache hit paths on a
+	// loader of its own, with a client that makes up its thumbnails.
+	static bool				Test();
+
+private:
+	struct Request_t
+	{
+		Request_t() :
+			Handle( 0 ),
+			Client( NULL ),
+			UserPointer( NULL ),
+			UserId( 0 ),
+			Priority( 0.0f ),
+			RequestTime( 0.0 ),
+			Cancelled( false )
+		{
+		}
+
+		thumbRequestHandle_t		Handle;
+		ThumbnailLoaderClient *		Client;
+		String						ThumbFile;
+		String						SourceFile;
+		void *						UserPointer;
+		int							UserId;
+		float						Priority;
+		double						RequestTime;
+		bool						Cancelled;		// only used for requests in flight
+	};
+
+	struct Completed_t
+	{
+		ThumbnailLoaderClient *		Client;
+		ThumbnailResult				Result;
+		double						RequestTime;
+	};
+
+	struct CacheEntry_t
+	{
+		ThumbnailLoaderClient *		Client;
+		String						ThumbFile;
+		unsigned char *				Data;
+		int							Width;
+		int							Height;
+		UInt32						LastUse;
+	};
+
+							ThumbnailLoader( int const numWorkers, int const maxCacheBytes );
+							~ThumbnailLoader();
+
+	static void *			WorkerThread( void * v );
+	void					ServiceRequests();
+
+	// These must be called with the mutex held.
+	bool					IsBusy( const String & thumbFile ) const;
+	unsigned char *			CopyFromCache( ThumbnailLoaderClient * client, const String & thumbFile, int & width, int & height );
+	void					AddToCache( ThumbnailLoaderClient * client, const String & thumbFile, unsigned char * data, int const width, int const height );
+	void					FreeCacheEntry( int const index );
+
+	mutable pthread_mutex_t	Mutex;
+	pthread_cond_t			Wake;		// signalled when a request is queued
+	pthread_cond_t			Idle;		// signalled when a request leaves flight
+
+	thumbRequestHandle_t	NextHandle;
+	Array< Request_t >		Pending;
+	Array< Request_t >		InFlight;
+	Array< Completed_t >	Completed;
+	Array< String >			BusyThumbFiles;	// being created or loaded by a worker
+
+	Array< CacheEntry_t >	Cache;
+	int						CacheBytes;
+	int						MaxCacheBytes;
+	UInt32					CacheUseCounter;
+
+	Stats					LoaderStats;
+
+	Array< pthread_t >		Workers;
+	bool					Exiting;	// set by the destructor
+};
+
+}	// namespace OVR
+
+#endif	// OVR_ThumbnailLoader_h
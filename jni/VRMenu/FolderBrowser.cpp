@@ -13,6 +13,8 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "FolderBrowser.h"
 
 #include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "../App.h"
 #include "VRMenuComponent.h"
 #include "VRMenuMgr.h"
@@ -27,6 +29,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "PackageFiles.h"
 #include "OVR_JSON.h"
 #include "AnimComponents.h"
+#include "../SelfTest.h"
 
 namespace OVR {
 
@@ -696,19 +699,24 @@ private:
 		}
 
 		// show or hide panels based on current position
-		const int numPanels = folder.Panels.GetSizeI();
 		// for rendering, we want to switch to occur between panels - hence nearbyint
 		const int curPanelIndex = nearbyintf( Position );
 		const int extraPanels = FolderBrowser.GetNumSwipePanels() / 2;	
-		for ( int i = 0; i < numPanels; ++i )
+
+		// recycle the panel slots around the current position
+		FolderBrowser.UpdatePanelWindow( FolderIndex, curPanelIndex );
+
+		const int numSlots = folder.Slots.GetSizeI();
+		for ( int slotIndex = 0; slotIndex < numSlots; ++slotIndex )
 	    {
-			const OvrFolderBrowser::Panel & panel = folder.Panels.At( i );
-			OVR_ASSERT( panel.Handle.IsValid() );
-			VRMenuObject * panelObject = menuMgr.ToObject( panel.Handle );
+			const OvrFolderBrowser::PanelSlot & slot = folder.Slots.At( slotIndex );
+			OVR_ASSERT( slot.Handle.IsValid() );
+			VRMenuObject * panelObject = menuMgr.ToObject( slot.Handle );
 			OVR_ASSERT( panelObject );
 
+			const int i = slot.PanelIndex;
 			VRMenuObjectFlags_t flags = panelObject->GetFlags();
-			if ( i >= curPanelIndex - extraPanels && i <= curPanelIndex + extraPanels )
+			if ( i >= 0 && i >= curPanelIndex - extraPanels && i <= curPanelIndex + extraPanels )
 			{
 				flags &= ~( VRMenuObjectFlags_t( VRMENUOBJECT_DONT_RENDER ) | VRMENUOBJECT_DONT_HIT_ALL );
 				panelObject->SetFadeDirection( Vector3f( 0.0f ) );
@@ -1396,9 +1404,10 @@ OvrFolderBrowser::OvrFolderBrowser(
 	, DefaultFileTexture( defaultFileTexture_)
 	, DefaultDirectoryTexture( defaultDirectoryTexture_ )
 	, NumSwipePanels( numSwipePanels )
+	, ThumbPrefetchPanels( numSwipePanels )
+	, DefaultPanelTexture( 0 )
 	, CurrentPanelData( NULL )
 	, TextureCommands( 10000 )
-	, BackgroundCommands( 10000 )
 	, MetaData( metaData )
 	, ThumbWidth( thumbWidth )
 	, ThumbHeight( thumbHeight )
@@ -1406,6 +1415,7 @@ OvrFolderBrowser::OvrFolderBrowser(
 	, FolderTitleSpacingScale( 0.5f )
 	, NoMedia( false )
 	, OnEnterMenuRootAdjust( MOVE_ROOT_NONE )
+	, ThumbActiveFolder( -1 )
 	, SwipeHeldDown( false )
 	, DebounceTime( 0.0f )
 	, ScrollHintShown( false )
@@ -1437,15 +1447,6 @@ OvrFolderBrowser::OvrFolderBrowser(
 		OVR_ASSERT( ThumbPanelBG && panelW == ThumbWidth && panelH == ThumbHeight );
 	}
 
-	// spawn the thumbnail loading thread with the command list
-	pthread_t loadingThread;
-	const int createErr = pthread_create( &loadingThread, NULL /* default attributes */,
-		&ThumbnailThread, this );
-	if ( createErr != 0 )
-	{
-		LOG( "pthread_create returned %i", createErr );
-	}
-
 	PanelWidth = panelWidth * VRMenuObject::DEFAULT_TEXEL_SCALE;
 	PanelHeight = panelHeight * VRMenuObject::DEFAULT_TEXEL_SCALE;
 	Radius = radius_;
@@ -1461,6 +1462,19 @@ OvrFolderBrowser::OvrFolderBrowser(
 
 OvrFolderBrowser::~OvrFolderBrowser()
 {
+	ThumbnailLoader::Get().RemoveClient( this );
+	for ( int i = 0; i < ThumbnailResults.GetSizeI(); ++i )
+	{
+		free( ThumbnailResults[ i ].Data );
+	}
+
+	for ( int i = 0; i < Folders.GetSizeI(); ++i )
+	{
+		FreeFolderThumbnails( Folders.At( i ) );
+	}
+	FreeTexture( DefaultPanelTexture );
+	DefaultPanelTexture = 0;
+
 	if ( ThumbPanelBG != NULL )
 	{
 		free( ThumbPanelBG );
@@ -1525,6 +1539,25 @@ void OvrFolderBrowser::Frame_Impl( App * app, VrFrame const & vrFrame, OvrVRMenu
 	}
 	
 	// Check for thumbnail loads
+	ApplyCompletedThumbnails();
+
+	// Thumbnails for the folder being looked at load first, so re-prioritize when it changes
+	if ( !Folders.IsEmpty() )
+	{
+		const int activeFolder = GetActiveFolderIndex();
+		if ( activeFolder != ThumbActiveFolder )
+		{
+			ThumbActiveFolder = activeFolder;
+			for ( int i = 0; i < Folders.GetSizeI(); ++i )
+			{
+				Folders[ i ].WindowCenter = -1;
+			}
+		}
+	}
+}
+
+void OvrFolderBrowser::ApplyCompletedThumbnails()
+{
 	while ( 1 )
 	{
 		const char * cmd = TextureCommands.GetNextMessage();
@@ -1537,6 +1570,19 @@ void OvrFolderBrowser::Frame_Impl( App * app, VrFrame const & vrFrame, OvrVRMenu
 		LoadThumbnailToTexture( cmd );
 		free( ( void * )cmd );
 	}
+
+	ThumbnailResults.Clear();
+	ThumbnailLoader::Get().GetCompleted( this, ThumbnailResults );
+	for ( int i = 0; i < ThumbnailResults.GetSizeI(); ++i )
+	{
+		const ThumbnailResult & result = ThumbnailResults[ i ];
+		// same encoding as the panel button ids
+		const int folderIndex = ( result.UserId >> 24 ) & 0x0000007F;
+		const int panelIndex = result.UserId & 0x00FFFFFF;
+		ApplyThumbnail( folderIndex, panelIndex, static_cast< const OvrMetaDatum * >( result.UserPointer ),
+			result.Handle, result.Data, result.Width, result.Height );
+	}
+	ThumbnailResults.Clear();
 }
 
 void OvrFolderBrowser::Open_Impl( App * app, OvrGazeCursor & gazeCursor )
@@ -1556,6 +1602,8 @@ void OvrFolderBrowser::Open_Impl( App * app, OvrGazeCursor & gazeCursor )
 
 void OvrFolderBrowser::BuildMenu()
 {
+	const double buildStart = ovr_GetTimeInSeconds();
+
 	// move the root up to eye height
 	VRMenuObject * root = MenuMgr.ToObject( GetRootHandle() );
 	if ( root != NULL )
@@ -1565,6 +1613,27 @@ void OvrFolderBrowser::BuildMenu()
 		root->SetLocalPosition( pos );
 	}
 
+	// Recycled panels show the bare panel texture until their thumbnail has loaded
+	if ( DefaultPanelTexture == 0 )
+	{
+		const char * panelSrc = ( ThumbWidth == ThumbHeight ) ? "res/raw/panel_square.tga" : "res/raw/panel.tga";
+		void * 	buffer;
+		int		bufferLength;
+		ovr_ReadFileFromApplicationPackage( panelSrc, bufferLength, buffer );
+		if ( buffer != NULL )
+		{
+			int width = 0;
+			int height = 0;
+			DefaultPanelTexture = LoadTextureFromBuffer( panelSrc, MemBuffer( buffer, bufferLength ),
+				TextureFlags_t( TEXTUREFLAG_NO_DEFAULT ), width, height );
+			free( buffer );
+		}
+		else
+		{
+			LOG( "OvrFolderBrowser::BuildMenu failed to load %s", panelSrc );
+		}
+	}
+
 	Array< OvrMetaData::Category > categories = MetaData.GetCategories();
 
 	// load folders and position
@@ -1583,6 +1652,9 @@ void OvrFolderBrowser::BuildMenu()
 		folderObject->SetLocalPosition( ( DOWN * PanelHeight * folderIndex ) + folderObject->GetLocalPosition() );
 	}
 
+	LOG( "OvrFolderBrowser::BuildMenu built %d folders with %d panels in %.3f seconds", 
+		Folders.GetSizeI(), mediaCount, ovr_GetTimeInSeconds() - buildStart );
+
 	if ( mediaCount == 0 )
 	{
 		String title;
@@ -1840,22 +1912,14 @@ void OvrFolderBrowser::LoadCategory( int folderIndex )
 
 	if ( !category.DatumIndicies.IsEmpty() )
 	{
-		// Grab panel parms 
-		LoadFolderPanels( category, folderIndex, folder, parms );
-		
-		// Add panels to swipehandle
-		AddItems( MenuMgr, Font, parms, folder.SwipeHandle, false );
-		DeletePointerArray( parms );
-		parms.Clear();
-
-		// Assign handles to panels
-		for ( int i = 0; i < folder.Panels.GetSizeI(); ++i )
-		{
-			Panel& panel = folder.Panels.At( i );
-			panel.Handle = swipeObject->GetChildHandleForIndex( i );
-		}
+		// Only the panel data is built here - menu objects and thumbnails are
+		// bound on demand as the panels scroll into view
+		LoadFolderPanels( category, folderIndex, folder );
 	}
 
+	// Create the recycled panel objects - these are needed even for empty folders as they may be rebuilt later
+	CreatePanelSlots( folderIndex, folder );
+
 	// Folder title
 	VRMenuId_t folderTitleRootId( ID_CENTER_ROOT.Get() + folderIndex + 1000000 );
 	VRMenuObjectParms titleRootParms(
@@ -1918,23 +1982,20 @@ void OvrFolderBrowser::RebuildFolder( const int folderIndex, const Array< OvrMet
 		VRMenuObject * swipeObject = MenuMgr.ToObject( folder.SwipeHandle );
 		OVR_ASSERT( swipeObject );
 
-		swipeObject->FreeChildren( MenuMgr );
+		// Unbind the slots before their thumbnails are freed
+		for ( int slotIndex = 0; slotIndex < folder.Slots.GetSizeI(); ++slotIndex )
+		{
+			BindPanelSlot( folderIndex, folder, folder.Slots.At( slotIndex ), -1 );
+		}
+		FreeFolderThumbnails( folder );
 		folder.Panels.Clear();
 
-		Array< VRMenuObjectParms const * > outParms;
 		for ( int panelIndex = 0; panelIndex < data.GetSizeI(); ++panelIndex )
 		{
 			OvrMetaDatum * panelData = data.At( panelIndex );
 			if ( panelData )
 			{
-				AddPanelToFolder( data.At( panelIndex ), folderIndex, folder, outParms );
-				AddItems( MenuMgr, Font, outParms, folder.SwipeHandle, false );
-				DeletePointerArray( outParms );
-				outParms.Clear();
-
-				// Assign handle to panel
-				Panel& panel = folder.Panels.At( panelIndex );
-				panel.Handle = swipeObject->GetChildHandleForIndex( panelIndex );
+				AddPanelToFolder( panelData, folderIndex, folder );
 			}
 		}
 		OvrFolderBrowserSwipeComponent * swipeComp = swipeObject->GetComponentById< OvrFolderBrowserSwipeComponent >();
@@ -1984,85 +2045,54 @@ void OvrFolderBrowser::UpdateFolderTitle( const int folderIndex )
 	folderTitleObject->SetFlags( flags );
 }
 
-void * OvrFolderBrowser::ThumbnailThread( void * v )
+unsigned char * OvrFolderBrowser::LoadThumbnailData( const char * thumbFile, int & width, int & height )
 {
-	int result = pthread_setname_np( pthread_self(), "FolderBrowser" );
-	if ( result != 0 )
-	{
-		LOG( "FolderBrowser: pthread_setname_np failed %s", strerror( result ) );
-	}
-
-	OvrFolderBrowser * folderBrowser = ( OvrFolderBrowser * )v;
+	return LoadThumbAndApplyAA( String( thumbFile ), width, height );
+}
 
-	const double start = ovr_GetTimeInSeconds();
+void OvrFolderBrowser::CreateThumbnailFile( const char * sourceFile )
+{
+	const String fullPath( sourceFile );
 
-	for ( ;; )
+	int pathLen = fullPath.GetLengthI();
+	if ( pathLen > 2 && OVR_stricmp( fullPath.ToCStr() + pathLen - 2, ".x" ) == 0 )
 	{
-		folderBrowser->BackgroundCommands.SleepUntilMessage();
-		const char * msg = folderBrowser->BackgroundCommands.GetNextMessage();
-		//LOG( "BackgroundCommands: %s", msg );
-		if ( MessageQueue::MatchesHead( "load ", msg ) )
-		{
-			Array<Folder> * folders;
-			int folderId;
-			int panelId;
-
-			sscanf( msg, "load %p %i %i", &folders, &folderId, &panelId );
-			const char * fileName = strstr( msg, ":" ) + 1;
+		LOG( "Thumbnails cannot be generated from encrypted images." );
+		return;
+	}
 
-			const String fullPath( fileName );
+	// The thumbnail is written to a temporary file and renamed into place, so
+	// a reader never sees a truncated or partially written thumbnail. The
+	// ThumbnailLoader never has two workers on the same thumbnail at once.
+	const String thumbNailDestination = ThumbName( fullPath );
+	const String tempDestination = thumbNailDestination + ".tmp";
 
-			int		width;
-			int		height;
-			unsigned char * data = folderBrowser->LoadThumbAndApplyAA( fullPath, width, height );
-			if ( data != NULL )
-			{
-				folderBrowser->TextureCommands.PostPrintf( "thumb %p %i %i %p %i %i",
-					&( *folders ), folderId, panelId, data, width, height );
-			}
+	// First check if we can write to destination
+	FILE * f = fopen( tempDestination.ToCStr(), "wb" );
+	if ( f != NULL )
+	{
+		fclose( f );
+		int	width = 0;
+		int height = 0;
+		unsigned char * data = CreateThumbnail( fullPath.ToCStr(), width, height );
 
-			free( ( void * )msg );
-		}
-		else if ( MessageQueue::MatchesHead( "create ", msg ) )
+		// Should we write out a trivial thumbnail if the create failed?
+		if ( data != NULL )
 		{
-			const String fullPath( msg + strlen( "create " ) );
-
-			int pathLen = fullPath.GetLengthI();
-			if ( pathLen > 2 && OVR_stricmp( fullPath.ToCStr() + pathLen - 2, ".x" ) == 0 )
-			{
-				LOG( "Thumbnails cannot be generated from encrypted images." );
-			}
-			else
+			// write it out
+			WriteJpeg( tempDestination.ToCStr(), data, width, height );
+			free( data );
+			if ( rename( tempDestination.ToCStr(), thumbNailDestination.ToCStr() ) != 0 )
 			{
-				// First check if we can write to destination
-				const String thumbNailDestination = folderBrowser->ThumbName( fullPath );
-				FILE * f = fopen( thumbNailDestination.ToCStr(), "wb" );
-				if ( f != NULL )
-				{
-					fclose( f );
-					int	width = 0;
-					int height = 0;
-					unsigned char * data = folderBrowser->CreateThumbnail( fullPath.ToCStr(), width, height );
-
-					// Should we write out a trivial thumbnail if the create failed?
-					if ( data != NULL )
-					{
-						// write it out
-						WriteJpeg( thumbNailDestination.ToCStr(), data, width, height );
-						free( data );
-					}
-				}
+				LOG( "CreateThumbnailFile: failed to rename %s", tempDestination.ToCStr() );
+				remove( tempDestination.ToCStr() );
 			}
 		}
 		else
 		{
-			LOG( "OvrFolderBrowser::ThumbnailThread received unhandled message: %s", msg );
-			OVR_ASSERT( false );
-			free( ( void * )msg );
+			remove( tempDestination.ToCStr() );
 		}
 	}
-
-	return NULL;
 }
 
 void OvrFolderBrowser::LoadThumbnailToTexture( const char * thumbnailCommand )
@@ -2071,76 +2101,88 @@ void OvrFolderBrowser::LoadThumbnailToTexture( const char * thumbnailCommand )
 	
 	int folderId;
 	int panelId;
+	OvrMetaDatum * datum;
 	unsigned char * data;
 	int width;
 	int height;
 
-	sscanf( thumbnailCommand, "thumb %p %i %i %p %i %i", &folders, &folderId, &panelId, &data, &width, &height );
-	OVR_ASSERT( folders );
-	
-	Array<Panel> * panels = &folders->At( folderId ).Panels;
+	sscanf( thumbnailCommand, "thumb %p %i %i %p %p %i %i", &folders, &folderId, &panelId, &datum, &data, &width, &height );
+	OVR_ASSERT( folders == &Folders );
 
-	Panel * panel = NULL;
+	// thumbnails from the package are loaded without a loader request
+	ApplyThumbnail( folderId, panelId, datum, 0, data, width, height );
+}
 
-	// find panel using panelId
-	const int numPanels = panels->GetSizeI();
-	for ( int index = 0; index < numPanels; ++index )
+void OvrFolderBrowser::ApplyThumbnail( const int folderIndex, const int panelIndex, const OvrMetaDatum * datum,
+	thumbRequestHandle_t const handle, unsigned char * data, const int width, const int height )
+{
+	// panel ids are their index in the folder, which RebuildFolder reuses for other items,
+	// so the item the thumbnail was requested for has to match as well
+	Panel * panel = NULL;
+	if ( folderIndex >= 0 && folderIndex < Folders.GetSizeI() )
 	{
-		Panel& currentPanel = panels->At( index );
-		if ( currentPanel.Id == panelId )
+		Array<Panel> & panels = Folders.At( folderIndex ).Panels;
+		if ( panelIndex >= 0 && panelIndex < panels.GetSizeI() && panels.At( panelIndex ).Data == datum )
 		{
-			panel = &currentPanel;
-			break;
+			panel = &panels.At( panelIndex );
 		}
 	}
 
-	if ( panel == NULL ) // Panel not found as it was moved. Delete data and bail
+	// Panel not found as it was moved or rebuilt, or it scrolled out of range or was already
+	// loaded while the thumbnail was in flight. Delete data and bail
+	if ( panel == NULL || !panel->ThumbRequested || panel->ThumbRequest != handle || panel->Texture != 0 )
 	{
 		free( data );
 		return;
 	}
+	panel->ThumbRequest = 0;
 
-	const int max = Alg::Max( width, height );
+	if ( data == NULL ) // the load failed - leave the default panel texture
+	{
+		return;
+	}
 
-	// Grab the Panel from VRMenu
-	VRMenuObject * panelObject = NULL;
-	panelObject = MenuMgr.ToObject( panel->Handle );
-	OVR_ASSERT( panelObject );
+	const int max = Alg::Max( width, height );
 
-	panel->Size[ 0 ] *= ( float )width / max;
-	panel->Size[ 1 ] *= ( float )height / max;
+	panel->Size[ 0 ] = PanelWidth * ( ( float )width / max );
+	panel->Size[ 1 ] = PanelHeight * ( ( float )height / max );
 
 	GLuint texId = LoadRGBATextureFromMemory(
 		data, width, height, true /* srgb */ ).texture;
 
 	OVR_ASSERT( texId );
 
-	panelObject->SetSurfaceTextureTakeOwnership( 0, 0, SURFACE_TEXTURE_DIFFUSE,
-		texId, panel->Size[ 0 ], panel->Size[ 1 ] );
-
 	BuildTextureMipmaps( texId );
 	MakeTextureTrilinear( texId );
 	MakeTextureClamped( texId );
 
 	free( data );
+
+	panel->Texture = texId;
+
+	// If the panel is currently in view, show the thumbnail right away
+	if ( VRMenuObject * panelObject = MenuMgr.ToObject( panel->Handle ) )
+	{
+		panelObject->SetSurfaceTexture( 0, 0, SURFACE_TEXTURE_DIFFUSE,
+			texId, panel->Size[ 0 ], panel->Size[ 1 ] );
+	}
 }
 
-void OvrFolderBrowser::LoadFolderPanels( const OvrMetaData::Category & category, const int folderIndex, Folder & folder,
-		Array< VRMenuObjectParms const * >& outParms )
+void OvrFolderBrowser::LoadFolderPanels( const OvrMetaData::Category & category, const int folderIndex, Folder & folder )
 {
 	// Build panels 
 	Array< const OvrMetaDatum * > categoryPanos;
 	MetaData.GetMetaData( category, categoryPanos );
 	const int numPanos = categoryPanos.GetSizeI();
 	LOG( "Building %d panels for %s", numPanos, category.CategoryName.ToCStr() );
-	int panelIndex = 0;
+	folder.Panels.Reserve( numPanos );
 	for ( int panoIndex = 0; panoIndex < numPanos; panoIndex++ )
 	{
-		AddPanelToFolder( const_cast< OvrMetaDatum * const >( categoryPanos.At( panoIndex ) ), folderIndex, folder, outParms );
+		AddPanelToFolder( const_cast< OvrMetaDatum * const >( categoryPanos.At( panoIndex ) ), folderIndex, folder );
 	}
 }
 
-void OvrFolderBrowser::AddPanelToFolder( OvrMetaDatum * const panoData, const int folderIndex, Folder & folder, Array< VRMenuObjectParms const * >& outParms )
+void OvrFolderBrowser::AddPanelToFolder( OvrMetaDatum * const panoData, const int folderIndex, Folder & folder )
 {
 	// Need data in panel to be non const as it will be modified externally
 	OVR_ASSERT( panoData );
@@ -2152,37 +2194,20 @@ void OvrFolderBrowser::AddPanelToFolder( OvrMetaDatum * const panoData, const in
 
 	Panel panel;
 	panel.Data = panoData;
-	const int panelIndex = folder.Panels.GetSizeI();
-	panel.Id = panelIndex;
+	panel.Id = folder.Panels.GetSizeI();
 	panel.Size.x = PanelWidth;
 	panel.Size.y = PanelHeight;
 
-	String panelTitle = panoData->Title;
-
-#if 0
-	const int numChars = panelTitle.GetSize();
-	if ( numChars > MAXIMUM_TITLE_SIZE )
-	{
-		for ( int c = MAXIMUM_TITLE_SIZE - 1; c < numChars; ++c )
-		{
-			if ( panelTitle[ c ] == ' ' )
-			{
-				panelTitle.Insert( "\n", c );
-				break;
-			}
-		}
-	}
-#endif
-
-	// Load a panel
-	Array< VRMenuComponent* > panelComps;
-	VRMenuId_t id( ID_CENTER_ROOT.Get() + panelIndex + 10000000 );
+	folder.Panels.PushBack( panel );
 
-	int  folderIndexShifted = folderIndex << 24;
-	VRMenuId_t buttonId( folderIndexShifted | panel.Id );
+	// Force the slots to be rebound now the panel list has changed
+	folder.WindowCenter = -1;
+}
 
-	panelComps.PushBack( new OvrButton_OnUp( this, buttonId ) );
-	panelComps.PushBack( new OvrDefaultComponent( Vector3f( 0.0f, 0.0f, 0.05f ), 1.05f, 0.25f, 0.25f, Vector4f( 0.f ) ) );
+void OvrFolderBrowser::CreatePanelSlots( const int folderIndex, Folder & folder )
+{
+	VRMenuObject * swipeObject = MenuMgr.ToObject( folder.SwipeHandle );
+	OVR_ASSERT( swipeObject );
 
 	static const char * panelSrc = NULL;
 	static const char * panelHiSrc = NULL;
@@ -2215,24 +2240,190 @@ void OvrFolderBrowser::AddPanelToFolder( OvrMetaDatum * const panoData, const in
 	panelSurfParms.PushBack( additiveParms );
 #endif
 
-	float const factor = ( float )panelIndex / ( float )CircumferencePanelSlots;
+	const Posef textPose( Quatf(), Vector3f( 0.0f, -PanelHeight * PanelTextSpacingScale, 0.0f ) );
+	const VRMenuFontParms fontParms( true, true, false, false, true, 0.525f, 0.45f, 0.5f );
 
-	Quatf rot( DOWN, ( Mathf::TwoPi * factor ) );
+	// The visible panels plus one spare on either side so the next panel is bound before it scrolls into view
+	const int numSlots = ( NumSwipePanels / 2 ) * 2 + 3;
+
+	Array< VRMenuObjectParms const * > parms;
+	for ( int slotIndex = 0; slotIndex < numSlots; ++slotIndex )
+	{
+		VRMenuId_t id( ID_CENTER_ROOT.Get() + slotIndex + 10000000 );
+
+		// The button id is reassigned whenever the slot is bound to a panel
+		Array< VRMenuComponent* > panelComps;
+		panelComps.PushBack( new OvrButton_OnUp( this, VRMenuId_t() ) );
+		panelComps.PushBack( new OvrDefaultComponent( Vector3f( 0.0f, 0.0f, 0.05f ), 1.05f, 0.25f, 0.25f, Vector4f( 0.f ) ) );
 
+		VRMenuObjectParms * p = new VRMenuObjectParms( VRMENU_BUTTON, panelComps,
+			panelSurfParms, "", Posef(), Vector3f( 1.0f ), textPose, Vector3f( 1.0f ), fontParms, id,
+			VRMenuObjectFlags_t( VRMENUOBJECT_DONT_RENDER ) | VRMENUOBJECT_DONT_HIT_ALL, 
+			VRMenuObjectInitFlags_t( VRMENUOBJECT_INIT_FORCE_POSITION ) );
+		parms.PushBack( p );
+	}
+
+	AddItems( MenuMgr, Font, parms, folder.SwipeHandle, false );
+	DeletePointerArray( parms );
+	parms.Clear();
+
+	// Assign handles to slots
+	folder.Slots.Resize( numSlots );
+	for ( int slotIndex = 0; slotIndex < numSlots; ++slotIndex )
+	{
+		PanelSlot & slot = folder.Slots.At( slotIndex );
+		slot.Handle = swipeObject->GetChildHandleForIndex( slotIndex );
+		slot.PanelIndex = -1;
+	}
+	folder.WindowCenter = -1;
+}
+
+void OvrFolderBrowser::BindPanelSlot( const int folderIndex, Folder & folder, PanelSlot & slot, const int panelIndex )
+{
+	VRMenuObject * panelObject = MenuMgr.ToObject( slot.Handle );
+	OVR_ASSERT( panelObject );
+
+	// Detach the previous panel
+	if ( slot.PanelIndex >= 0 && slot.PanelIndex < folder.Panels.GetSizeI() )
+	{
+		folder.Panels.At( slot.PanelIndex ).Handle = menuHandle_t();
+	}
+	slot.PanelIndex = panelIndex;
+
+	if ( panelIndex < 0 )
+	{
+		panelObject->SetSurfaceTexture( 0, 0, SURFACE_TEXTURE_DIFFUSE, DefaultPanelTexture, ThumbWidth, ThumbHeight );
+		panelObject->AddFlags( VRMenuObjectFlags_t( VRMENUOBJECT_DONT_RENDER ) | VRMENUOBJECT_DONT_HIT_ALL );
+		return;
+	}
+
+	Panel & panel = folder.Panels.At( panelIndex );
+	panel.Handle = slot.Handle;
+
+	float const factor = ( float )panelIndex / ( float )CircumferencePanelSlots;
+	Quatf rot( DOWN, ( Mathf::TwoPi * factor ) );
 	Vector3f dir( -FWD * rot );
-	Posef panelPose( rot, dir * Radius );
-	Vector3f panelScale( 1.0f );
+	panelObject->SetLocalPose( Posef( rot, dir * Radius ) );
 
-	const Posef textPose( Quatf(), Vector3f( 0.0f, -PanelHeight * PanelTextSpacingScale, 0.0f ) );
+	String panelTitle = panel.Data->Title;
 
-	const VRMenuFontParms fontParms( true, true, false, false, true, 0.525f, 0.45f, 0.5f );
-	VRMenuObjectParms * p = new VRMenuObjectParms( VRMENU_BUTTON, panelComps,
-		panelSurfParms, panelTitle, panelPose, panelScale, textPose, Vector3f( 1.0f ), fontParms, id,
-		VRMenuObjectFlags_t(), VRMenuObjectInitFlags_t( VRMENUOBJECT_INIT_FORCE_POSITION ) );
+#if 0
+	const int numChars = panelTitle.GetSize();
+	if ( numChars > MAXIMUM_TITLE_SIZE )
+	{
+		for ( int c = MAXIMUM_TITLE_SIZE - 1; c < numChars; ++c )
+		{
+			if ( panelTitle[ c ] == ' ' )
+			{
+				panelTitle.Insert( "\n", c );
+				break;
+			}
+		}
+	}
+#endif
 
-	outParms.PushBack( p );
+	panelObject->SetText( panelTitle.ToCStr() );
 
-	folder.Panels.PushBack( panel );
+	if ( OvrButton_OnUp * button = panelObject->GetComponentById< OvrButton_OnUp >() )
+	{
+		const int folderIndexShifted = folderIndex << 24;
+		button->SetID( VRMenuId_t( folderIndexShifted | panel.Id ) );
+	}
+
+	if ( panel.Texture != 0 )
+	{
+		panelObject->SetSurfaceTexture( 0, 0, SURFACE_TEXTURE_DIFFUSE, panel.Texture, panel.Size[ 0 ], panel.Size[ 1 ] );
+	}
+	else
+	{
+		panelObject->SetSurfaceTexture( 0, 0, SURFACE_TEXTURE_DIFFUSE, DefaultPanelTexture, ThumbWidth, ThumbHeight );
+	}
+}
+
+void OvrFolderBrowser::UpdatePanelWindow( const int folderIndex, const int centerPanelIndex )
+{
+	Folder & folder = Folders.At( folderIndex );
+	if ( folder.WindowCenter == centerPanelIndex || folder.Slots.IsEmpty() )
+	{
+		return;
+	}
+	folder.WindowCenter = centerPanelIndex;
+
+	const int numPanels = folder.Panels.GetSizeI();
+	const int numSlots = folder.Slots.GetSizeI();
+
+	// Panel i is always shown by slot i % numSlots, so as the window slides only the
+	// slot falling off one edge is rebound to the panel entering on the other.
+	const int firstPanel = centerPanelIndex - numSlots / 2;
+	for ( int panelIndex = firstPanel; panelIndex < firstPanel + numSlots; ++panelIndex )
+	{
+		const int slotIndex = ( ( panelIndex % numSlots ) + numSlots ) % numSlots;
+		PanelSlot & slot = folder.Slots.At( slotIndex );
+		const int boundIndex = ( panelIndex >= 0 && panelIndex < numPanels ) ? panelIndex : -1;
+		if ( slot.PanelIndex != boundIndex )
+		{
+			BindPanelSlot( folderIndex, folder, slot, boundIndex );
+		}
+	}
+
+	// Evict thumbnails outside of the prefetch window, with an extra margin so
+	// swiping back and forth across the edge doesn't reload the same thumbnails.
+	const int residentRadius = numSlots / 2 + ThumbPrefetchPanels;
+	const int evictRadius = residentRadius + ThumbPrefetchPanels;
+	for ( int i = folder.ResidentThumbs.GetSizeI() - 1; i >= 0; --i )
+	{
+		const int panelIndex = folder.ResidentThumbs.At( i );
+		if ( abs( panelIndex - centerPanelIndex ) > evictRadius )
+		{
+			FreeThumbnail( folder.Panels.At( panelIndex ) );
+			folder.ResidentThumbs.RemoveAtUnordered( i );
+		}
+	}
+
+	// Loads still in flight are now a different distance from the center
+	ThumbnailLoader & loader = ThumbnailLoader::Get();
+	for ( int i = 0; i < folder.ResidentThumbs.GetSizeI(); ++i )
+	{
+		const int panelIndex = folder.ResidentThumbs.At( i );
+		const Panel & panel = folder.Panels.At( panelIndex );
+		if ( panel.ThumbRequest != 0 )
+		{
+			loader.Reprioritize( panel.ThumbRequest, ThumbnailPriority( folderIndex, panelIndex, centerPanelIndex ) );
+		}
+	}
+
+	// Request thumbnails for the visible panels first, then work outwards
+	for ( int offset = 0; offset <= residentRadius; ++offset )
+	{
+		for ( int side = 0; side < ( offset == 0 ? 1 : 2 ); ++side )
+		{
+			const int panelIndex = side == 0 ? centerPanelIndex + offset : centerPanelIndex - offset;
+			if ( panelIndex < 0 || panelIndex >= numPanels )
+			{
+				continue;
+			}
+			Panel & panel = folder.Panels.At( panelIndex );
+			if ( !panel.ThumbRequested )
+			{
+				RequestThumbnail( folderIndex, panel, ThumbnailPriority( folderIndex, panelIndex, centerPanelIndex ) );
+				folder.ResidentThumbs.PushBack( panelIndex );
+			}
+		}
+	}
+}
+
+float OvrFolderBrowser::ThumbnailPriority( const int folderIndex, const int panelIndex, const int centerPanelIndex ) const
+{
+	// Panels in other folders load after every resident panel in the active folder
+	static const float FOLDER_PRIORITY_SCALE = 1000.0f;
+	const int folderDistance = ThumbActiveFolder >= 0 ? abs( folderIndex - ThumbActiveFolder ) : 0;
+	return ( float )abs( panelIndex - centerPanelIndex ) + FOLDER_PRIORITY_SCALE * folderDistance;
+}
+
+void OvrFolderBrowser::RequestThumbnail( const int folderIndex, Panel & panel, const float priority )
+{
+	OVR_ASSERT( !panel.ThumbRequested );
+	panel.ThumbRequested = true;
 
 	// Create or load thumbnail
 	const String	thumbName = ThumbName( panel.Data->Url );
@@ -2271,24 +2462,23 @@ void OvrFolderBrowser::AddPanelToFolder( OvrMetaDatum * const panoData, const in
 
 		if ( data != NULL )
 		{
-			// The data will be consumed in the next Frame where we have finished building panel vrmenu objects
+			// The data will be consumed in the next Frame
 			// So yes - we are dogfooding ;)
-			TextureCommands.PostPrintf( "thumb %p %i %i %p %i %i",
-				&Folders, folderIndex, panel.Id, data, width, height );
+			TextureCommands.PostPrintf( "thumb %p %i %i %p %p %i %i",
+				&Folders, folderIndex, panel.Id, panel.Data, data, width, height );
 		}
 		return;
 	}
 
 	finalThumb = thumbName;
+	String createFrom;
 	if ( !FileExists( thumbName ) )
 	{
 		const String altThumbName = AlternateThumbName( panel.Data->Url );
 		if ( !FileExists( altThumbName ) )
 		{
-			String	cmd( "create " );
-			cmd += panel.Data->Url;
+			createFrom = panel.Data->Url;
 			LOG( "Start creating thumb '%s'", panel.Data->Url.ToCStr() );
-			BackgroundCommands.PostString( cmd );
 		}
 		else
 		{
@@ -2296,13 +2486,70 @@ void OvrFolderBrowser::AddPanelToFolder( OvrMetaDatum * const panoData, const in
 		}
 	}
 	LOG( "Start loading thumb '%s'", thumbName.ToCStr() );
-	char	cmd[ 1024 ];
-	sprintf( cmd, "load %p %i %i:%s", &Folders, folderIndex, panel.Id, finalThumb.ToCStr() );
-	//LOG( "Thumb cmd: %s", cmd );
-	BackgroundCommands.PostString( String( cmd ) );
+	const int folderIndexShifted = folderIndex << 24;
+	panel.ThumbRequest = ThumbnailLoader::Get().Request( this, finalThumb, createFrom, 
+		panel.Data, folderIndexShifted | panel.Id, priority );
 #endif
 }
 
+void OvrFolderBrowser::FreeThumbnail( Panel & panel )
+{
+	if ( panel.ThumbRequest != 0 )
+	{
+		ThumbnailLoader::Get().Cancel( panel.ThumbRequest );
+		panel.ThumbRequest = 0;
+	}
+	FreeTexture( panel.Texture );
+	panel.Texture = 0;
+	panel.ThumbRequested = false;
+	panel.Size.x = PanelWidth;
+	panel.Size.y = PanelHeight;
+}
+
+void OvrFolderBrowser::FreeFolderThumbnails( Folder & folder )
+{
+	for ( int i = 0; i < folder.ResidentThumbs.GetSizeI(); ++i )
+	{
+		FreeThumbnail( folder.Panels.At( folder.ResidentThumbs.At( i ) ) );
+	}
+	folder.ResidentThumbs.Clear();
+	folder.WindowCenter = -1;
+}
+
+UPInt OvrFolderBrowser::GetResidentThumbnailBytes() const
+{
+	// LoadThumbAndApplyAA only accepts thumbnails of the panel size, and the mips add a third
+	UPInt numTextures = 0;
+	for ( int i = 0; i < Folders.GetSizeI(); ++i )
+	{
+		const Folder & folder = Folders.At( i );
+		for ( int j = 0; j < folder.ResidentThumbs.GetSizeI(); ++j )
+		{
+			if ( folder.Panels.At( folder.ResidentThumbs.At( j ) ).Texture != 0 )
+			{
+				numTextures++;
+			}
+		}
+	}
+	return numTextures * ThumbWidth * ThumbHeight * 4 * 4 / 3;
+}
+
+bool OvrFolderBrowser::HasPendingThumbnails() const
+{
+	for ( int i = 0; i < Folders.GetSizeI(); ++i )
+	{
+		const Folder & folder = Folders.At( i );
+		for ( int j = 0; j < folder.ResidentThumbs.GetSizeI(); ++j )
+		{
+			if ( folder.Panels.At( folder.ResidentThumbs.At( j ) ).ThumbRequest != 0 )
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 unsigned char * OvrFolderBrowser::LoadThumbAndApplyAA( const String & fileName, int & width, int & height )
 {
 	unsigned char * data = NULL;	
@@ -2503,4 +2750,131 @@ int OvrFolderBrowser::GetActiveFolderIndex() const
 	return rootComp->GetCurrentIndex( rootObject );
 }
 
+//==============================================================
+// BenchmarkFolderBrowser
+
+// Makes up its thumbnails, so only the browser itself is measured.
+class OvrBenchmarkFolderBrowser : public OvrFolderBrowser
+{
+public:
+	OvrBenchmarkFolderBrowser( App * app, SearchPaths & paths, OvrMetaData & metaData ) :
+		OvrFolderBrowser( app, app->GetVRMenuMgr(), app->GetDefaultFont(), paths, metaData, 0, 0 )
+	{
+	}
+
+	virtual unsigned char * CreateThumbnail( const char * filename, int & width, int & height )
+	{
+		return NULL;
+	}
+
+	virtual	unsigned char * LoadThumbnail( const char * filename, int & width, int & height )
+	{
+		width = GetThumbWidth();
+		height = GetThumbHeight();
+		unsigned char * data = ( unsigned char * )malloc( width * height * 4 );
+		memset( data, 0x80, width * height * 4 );
+		return data;
+	}
+
+	// The items are their own thumbnails, so none are created
+	virtual String ThumbName( const String & s )
+	{
+		return s;
+	}
+
+	virtual void OnMediaNotFound( String & title, String & imageFile, String & message )
+	{
+	}
+};
+
+void BenchmarkFolderBrowser()
+{
+	App * app = GetSelfTestApp();
+	const char * directory = GetSelfTestDirectory();
+	if ( app == NULL || directory[0] == '\0' )
+	{
+		LOG( "BenchmarkFolderBrowser: skipped, needs the app and the self test directory" );
+		return;
+	}
+
+	// The items only have to exist
+	static const int NUM_ITEMS = 10000;
+	char path[1024];
+	OVR_sprintf( path, sizeof( path ), "%sbrowser/", directory );
+	mkdir( path, S_IRWXU );
+	for ( int i = 0; i < NUM_ITEMS; ++i )
+	{
+		OVR_sprintf( path, sizeof( path ), "%sbrowser/%05i.jpg", directory, i );
+		if ( FILE * f = fopen( path, "w" ) )
+		{
+			fclose( f );
+		}
+	}
+
+	SearchPaths paths;
+	paths.AddPath( directory );
+	OvrMetaDataFileExtensions extensions;
+	extensions.GoodExtensions.PushBack( ".jpg" );
+
+	const double metaDataStart = ovr_GetTimeInSeconds();
+	OvrMetaData metaData;
+	metaData.InitFromDirectory( "browser/", paths, extensions );
+	const double metaDataSeconds = ovr_GetTimeInSeconds() - metaDataStart;
+
+	OvrVRMenuMgr & menuMgr = app->GetVRMenuMgr();
+	OvrBenchmarkFolderBrowser * browser = new OvrBenchmarkFolderBrowser( app, paths, metaData );
+	const double buildStart = ovr_GetTimeInSeconds();
+	browser->Init( menuMgr, app->GetDefaultFont(), 0.0f, VRMenuFlags_t() );
+	browser->BuildMenu();
+	const double buildSeconds = ovr_GetTimeInSeconds() - buildStart;
+
+	int numPanels = 0;
+	for ( int i = 0; i < browser->Folders.GetSizeI(); ++i )
+	{
+		numPanels += browser->Folders.At( i ).Panels.GetSizeI();
+	}
+
+	browser->UpdatePanelWindow( 0, 0 );
+	for ( int wait = 0; wait < 500 && browser->HasPendingThumbnails(); ++wait )
+	{
+		usleep( 10000 );
+		browser->ApplyCompletedThumbnails();
+	}
+	const UPInt startBytes = browser->GetResidentThumbnailBytes();
+
+	// Scroll through the whole first folder, one panel per update
+	UPInt maxBytes = startBytes;
+	const int numFolderPanels = browser->Folders.IsEmpty() ? 0 : browser->Folders.At( 0 ).Panels.GetSizeI();
+	const double scrollStart = ovr_GetTimeInSeconds();
+	for ( int i = 0; i < numFolderPanels; ++i )
+	{
+		browser->UpdatePanelWindow( 0, i );
+		browser->ApplyCompletedThumbnails();
+		maxBytes = Alg::Max( maxBytes, browser->GetResidentThumbnailBytes() );
+	}
+	const double scrollSeconds = ovr_GetTimeInSeconds() - scrollStart;
+	for ( int wait = 0; wait < 500 && browser->HasPendingThumbnails(); ++wait )
+	{
+		usleep( 10000 );
+		browser->ApplyCompletedThumbnails();
+	}
+	const UPInt endBytes = browser->GetResidentThumbnailBytes();
+
+	LOG( "BenchmarkFolderBrowser: %i items, metadata %.3f s, BuildMenu %.3f s for %i panels, %.1f us per scroll step",
+		NUM_ITEMS, metaDataSeconds, buildSeconds, numPanels, numFolderPanels > 0 ? scrollSeconds * 1e6 / numFolderPanels : 0.0 );
+	LOG( "BenchmarkFolderBrowser: resident thumbnails %i KB at the start, %i KB at most while scrolling, %i KB at the end",
+		( int )( startBytes / 1024 ), ( int )( maxBytes / 1024 ), ( int )( endBytes / 1024 ) );
+
+	browser->Shutdown( menuMgr );
+	delete browser;
+
+	for ( int i = 0; i < NUM_ITEMS; ++i )
+	{
+		OVR_sprintf( path, sizeof( path ), "%sbrowser/%05i.jpg", directory, i );
+		remove( path );
+	}
+	OVR_sprintf( path, sizeof( path ), "%sbrowser/", directory );
+	rmdir( path );
+}
+
 } // namespace OVR
@@ -15,6 +15,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 
 #include "VRMenu.h"
 #include "MessageQueue.h"
+#include "ThumbnailLoader.h"
 #include "Kernel/OVR_StringHash.h"
 
 namespace OVR {
@@ -111,7 +112,7 @@ private:
 
 //==============================================================
 // OvrFolderBrowser
-class OvrFolderBrowser : public VRMenu
+class OvrFolderBrowser : public VRMenu, public ThumbnailLoaderClient
 {
 public:
 	struct Panel
@@ -119,24 +120,43 @@ public:
 		Panel() 
 		: Data( NULL )
 		, Id( -1 )
+		, Texture( 0 )
+		, ThumbRequested( false )
+		, ThumbRequest( 0 )
 		{}
 
 		OvrMetaDatum *		 	Data;				// Datum in OvrMetaData - payload
-		menuHandle_t			Handle;				// Handle to the panel
-		int						Id;					// Unique id for thumbnail loading
+		menuHandle_t			Handle;				// Handle of the panel slot currently showing this panel - invalid if not in view
+		int						Id;					// Index in the folder, used for button and thumbnail ids
 		Vector2f				Size;				// Thumbnail texture size
+		GLuint					Texture;			// Thumbnail texture, 0 if not resident - owned by the folder browser
+		bool					ThumbRequested;		// True once a load has been queued for the thumbnail
+		thumbRequestHandle_t	ThumbRequest;		// Outstanding ThumbnailLoader request, 0 if none
+	};
+
+	// Panels are virtualized - only a small pool of menu objects is created per folder
+	// and rebound to whichever panels are inside the visible scroll window.
+	struct PanelSlot
+	{
+		PanelSlot() : PanelIndex( -1 ) {}
+
+		menuHandle_t			Handle;				// Handle to the recycled panel menu object
+		int						PanelIndex;			// Index of the panel currently bound to the slot, -1 if none
 	};
 
 	struct Folder
 	{
-		Folder( const String & name ) : Name( name ), MaxRotation( 0.0f ) {}
+		Folder( const String & name ) : Name( name ), MaxRotation( 0.0f ), WindowCenter( -1 ) {}
 		const String	Name;						// Store for rebuild of title
 		menuHandle_t	Handle;						// Handle to main root - parent to both Title and Panels
 		menuHandle_t	TitleRootHandle;			// Handle to the folder title root
 		menuHandle_t	TitleHandle;				// Handle to the folder title
 		menuHandle_t	SwipeHandle;				// Handle to root for panels
 		float			MaxRotation;				// Used by SwipeComponent 
+		int				WindowCenter;				// Panel index the slots were last bound around, -1 if never bound
 		Array<Panel>	Panels;
+		Array<PanelSlot>	Slots;
+		Array<int>		ResidentThumbs;				// Indices of panels holding a thumbnail texture
 	};
 
 	static char const *	MENU_NAME;
@@ -191,6 +211,15 @@ public:
 	bool				HasNoMedia() const						{ return NoMedia; }
 	bool				GazingAtMenu() const;
 
+	// Rebinds the folder's panel slots and thumbnail residency around the panel at centerPanelIndex.
+	// Called by the swipe component whenever the centered panel changes.
+	void				UpdatePanelWindow( const int folderIndex, const int centerPanelIndex );
+	// Number of panels either side of the visible window whose thumbnails are kept resident
+	void				SetThumbPrefetchPanels( const int numPanels )	{ ThumbPrefetchPanels = numPanels; }
+	int					GetThumbPrefetchPanels() const			{ return ThumbPrefetchPanels; }
+	// Texture memory held by the loaded thumbnails of every folder, including mips
+	UPInt				GetResidentThumbnailBytes() const;
+
 protected:
 	OvrFolderBrowser( App * app,
 				OvrVRMenuMgr & menuMgr,
@@ -211,12 +240,12 @@ protected:
 	//================================================================================
 	// Subclass interface
 
-	// Called on a background thread
+	// Called on a ThumbnailLoader thread - possibly several at once
 	// The returned memory buffer will be free()'d after writing the thumbnail.
 	// Return NULL if the thumbnail couldn't be created.
 	virtual unsigned char * CreateThumbnail( const char * filename, int & width, int & height ) = 0;
 
-	// Called on a background thread to load thumbnail
+	// Called on a ThumbnailLoader thread - possibly several at once - to load thumbnail
 	virtual	unsigned char * LoadThumbnail( const char * filename, int & width, int & height ) = 0;
 
 	// Adds thumbnail extension to a file to find/create its thumbnail
@@ -247,17 +276,29 @@ protected:
 
 private:
 
-	static void *		ThumbnailThread( void * v );
+	// ThumbnailLoaderClient
+	virtual unsigned char *	LoadThumbnailData( const char * thumbFile, int & width, int & height );
+	virtual void		CreateThumbnailFile( const char * sourceFile );
+
 	void				LoadThumbnailToTexture( const char * thumbnailCommand );
+	void				ApplyCompletedThumbnails();
+	void				ApplyThumbnail( const int folderIndex, const int panelIndex, const OvrMetaDatum * datum,
+							thumbRequestHandle_t const handle, unsigned char * data, const int width, const int height );
+	float				ThumbnailPriority( const int folderIndex, const int panelIndex, const int centerPanelIndex ) const;
 	virtual void		OnItemEvent_Impl( App * app, VRMenuId_t const itemId, VRMenuEvent const & event );
     virtual void        Frame_Impl( App * app, VrFrame const & vrFrame, OvrVRMenuMgr & menuMgr, BitmapFont const & font,
                                         BitmapFontSurface & fontSurface, gazeCursorUserId_t const gazeUserId );
 	virtual void		Open_Impl( App * app, OvrGazeCursor & gazeCursor );
 
 	void				LoadCategory( const int folderIndex );
-	void				LoadFolderPanels( const OvrMetaData::Category & category, const int folderIndex, Folder & folder,
-							 Array< VRMenuObjectParms const * > & outParms );
-	void				AddPanelToFolder( OvrMetaDatum * const panoData, const int folderIndex, Folder & folder, Array< VRMenuObjectParms const * >& outParms );
+	void				LoadFolderPanels( const OvrMetaData::Category & category, const int folderIndex, Folder & folder );
+	void				AddPanelToFolder( OvrMetaDatum * const panoData, const int folderIndex, Folder & folder );
+	void				CreatePanelSlots( const int folderIndex, Folder & folder );
+	void				BindPanelSlot( const int folderIndex, Folder & folder, PanelSlot & slot, const int panelIndex );
+	void				RequestThumbnail( const int folderIndex, Panel & panel, const float priority );
+	void				FreeThumbnail( Panel & panel );
+	void				FreeFolderThumbnails( Folder & folder );
+	bool				HasPendingThumbnails() const;	// true while a resident panel waits for the loader
 	void				DisplaceFolder( int index, const Vector3f & direction, float distance, bool startOffSelf = false );
 	void				UpdateFolderTitle( const int folderIndex );
 	void				SetScrollHintVisible( const bool visible );
@@ -285,6 +326,8 @@ private:
 
 	int					CircumferencePanelSlots;
 	unsigned			NumSwipePanels;
+	int					ThumbPrefetchPanels;
+	GLuint				DefaultPanelTexture;		// Shown on recycled panels until their thumbnail arrives
 	float				Radius;
 	float				VisiblePanelsArcAngle;
 	bool				SwipeHeldDown;
@@ -298,17 +341,26 @@ private:
 	bool				ScrollHintShown;
 
 	RootDirection		OnEnterMenuRootAdjust;
+	int					ThumbActiveFolder;			// Active folder the thumbnail priorities were computed for
 	
-	// Checked at Frame() time for commands from the thumbnail/create thread
+	// Checked at Frame() time for thumbnails loaded from the application package
 	MessageQueue		TextureCommands;
 
-	// Create / load thumbnails by background thread
-	MessageQueue		BackgroundCommands;
+	// Thumbnails loaded by the shared loader threads
+	Array< ThumbnailResult >	ThumbnailResults;
 
 	// Keep a reference to Panel texture used for AA alpha when creating thumbnails
 	static unsigned char *		ThumbPanelBG;
+
+	// Collects the thumbnails without running frames
+	friend void					BenchmarkFolderBrowser();
 };
 
+// Builds a browser over 10000 generated items and logs the build time and the
+// thumbnail memory that stays resident while scrolling through all of them.
+// Needs the app and the self test directory, see SelfTest.h.
+void BenchmarkFolderBrowser();
+
 } // namespace OVR
 
 #endif // OVR_GlobalMenu_h
@@ -17,6 +17,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "../GlProgram.h"
 #include "../GlTexture.h"
 #include "../GlGeometry.h"
+#include "../Profiler.h"
 #include "../VrCommon.h"
 #include "../App.h"
 #include "../GazeCursor.h"
@@ -300,6 +301,7 @@ void OvrGuiSysLocal::Frame( App * app, const VrFrame & vrFrame, OvrVRMenuMgr & m
         BitmapFontSurface & fontSurface )
 {
 	//LOG( "OvrGuiSysLocal::Frame" );
+	OVR_PROFILE_SCOPE( "GuiSysFrame" );
 
 	// go backwards through the list so we can use unordered remove when a menu finishes closing
 	for ( int i = ActiveMenus.GetSizeI() - 1; i >= 0; --i )
@@ -16,6 +16,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "../GlProgram.h"
 #include "../GlTexture.h"
 #include "../GlGeometry.h"
+#include "../Profiler.h"
 #include "ModelView.h"
 #include "DebugLines.h"
 #include "BitmapFont.h"
@@ -324,27 +325,27 @@ void VRMenuMgrLocal::Init()
 	}
 
 	// diffuse only
-	if ( GUIProgramDiffuseOnly.vertexShader == 0 || GUIProgramDiffuseOnly.fragmentShader == 0 )
+	if ( GUIProgramDiffuseOnly.program == 0 )
 	{
 		GUIProgramDiffuseOnly = BuildProgram( GUIDiffuseOnlyVertexShaderSrc, GUIDiffuseOnlyFragmentShaderSrc );
 	}
 	// diffuse + additive
-	if ( GUIProgramDiffusePlusAdditive.vertexShader == 0 || GUIProgramDiffusePlusAdditive.fragmentShader == 0 )
+	if ( GUIProgramDiffusePlusAdditive.program == 0 )
 	{
 		GUIProgramDiffusePlusAdditive = BuildProgram( GUITwoTextureColorModulatedShaderSrc, GUIDiffusePlusAdditiveFragmentShaderSrc );
 	}
 	// diffuse + diffuse
-	if ( GUIProgramDiffuseComposite.vertexShader == 0 || GUIProgramDiffuseComposite.fragmentShader == 0 )
+	if ( GUIProgramDiffuseComposite.program == 0 )
 	{
 		GUIProgramDiffuseComposite = BuildProgram( GUITwoTextureColorModulatedShaderSrc, GUIDiffuseCompositeFragmentShaderSrc );
 	}
 	// diffuse color ramped
-	if ( GUIProgramDiffuseColorRamp.vertexShader == 0 || GUIProgramDiffuseColorRamp.fragmentShader == 0 )
+	if ( GUIProgramDiffuseColorRamp.program == 0 )
 	{
 		GUIProgramDiffuseColorRamp = BuildProgram( GUIDiffuseOnlyVertexShaderSrc, GUIColorRampFragmentSrc );
 	}
 	// diffuse, color ramp, and a specific target for the color ramp
-	if ( GUIProgramDiffuseColorRampTarget.vertexShader == 0 || GUIProgramDiffuseColorRampTarget.fragmentShader == 0 )
+	if ( GUIProgramDiffuseColorRampTarget.program == 0 )
 	{
 		GUIProgramDiffuseColorRampTarget = BuildProgram( GUIDiffuseColorRampTargetVertexShaderSrc, GUIColorRampTargetFragmentSrc );
 	}
@@ -742,6 +743,7 @@ void VRMenuMgrLocal::SubmitForRendering( OvrDebugLines & debugLines, BitmapFont
         VRMenuRenderFlags_t const & flags )
 {
 	//LOG( "VRMenuMgrLocal::SubmitForRendering" );
+	OVR_PROFILE_SCOPE( "VRMenuSubmit" );
 	if ( NumSubmitted >= MAX_SUBMITTED )
 	{
 		LOG( "Too many menu objects submitted!" );
@@ -788,6 +790,8 @@ void VRMenuMgrLocal::Finish( Matrix4f const & viewMatrix )
 // VRMenuMgrLocal::RenderSubmitted
 void VRMenuMgrLocal::RenderSubmitted( Matrix4f const & worldMVP )
 {
+	OVR_PROFILE_SCOPE( "VRMenuRender" );
+
 	if ( NumSubmitted == 0 )
 	{
 		return;
@@ -89,26 +89,36 @@ static void	WarpTexCoord2( const hmdInfoInternal_t & hmdInfo, const float in[2],
 	}
 }
 
-static void WarpTexCoordChroma( const hmdInfoInternal_t & hmdInfo, const float in[2],
-			float red[2], float green[2], float blue[2] ) {
-	float theta[2];
-	for ( int i = 0; i < 2; i++ ) {
-		const float unit = in[i];
-		const float ndc = 2.0f * ( unit - 0.5f );
-		const float pixels = ndc * hmdInfo.heightPixels * 0.5f;
-		const float meters = pixels * hmdInfo.widthMeters / hmdInfo.widthPixels;
-		const float tanAngle = meters / hmdInfo.lens.MetersPerTanAngleAtCenter;
-		theta[i] = tanAngle;
-	}
-
-	const float rsq = theta[0] * theta[0] + theta[1] * theta[1];
+static float UnitToTanAngle( const hmdInfoInternal_t & hmdInfo, const float unit ) {
+	const float ndc = 2.0f * ( unit - 0.5f );
+	const float pixels = ndc * hmdInfo.heightPixels * 0.5f;
+	const float meters = pixels * hmdInfo.widthMeters / hmdInfo.widthPixels;
+	const float tanAngle = meters / hmdInfo.lens.MetersPerTanAngleAtCenter;
+	return tanAngle;
+}
 
-	const Vector3f chromaScale = hmdInfo.lens.DistortionFnScaleRadiusSquaredChroma (rsq);
+// Like WarpTexCoord2, but for a whole row of points at once and with separate
+// red, green and blue coordinates. The lens distortion is evaluated with one
+// batched call for the row instead of once per point.
+static void WarpTexCoordChromaRow( const hmdInfoInternal_t & hmdInfo, const float * inX, const float inY,
+			const int count, float * rsq, Vector3f * chromaScale, float * out, const int outStride ) {
+	const float thetaY = UnitToTanAngle( hmdInfo, inY );
+	for ( int x = 0; x < count; x++ ) {
+		const float thetaX = UnitToTanAngle( hmdInfo, inX[x] );
+		rsq[x] = thetaX * thetaX + thetaY * thetaY;
+	}
 
-	for ( int i = 0; i < 2; i++ ) {
-		red[i] = chromaScale[0] * theta[i];
-		green[i] = chromaScale[1] * theta[i];
-		blue[i] = chromaScale[2] * theta[i];
+	hmdInfo.lens.DistortionFnScaleRadiusSquaredChromaBatch( rsq, chromaScale, count );
+
+	for ( int x = 0; x < count; x++ ) {
+		const float thetaX = UnitToTanAngle( hmdInfo, inX[x] );
+		float * v = out + x * outStride;
+		v[0] = chromaScale[x][0] * thetaX;	// red
+		v[1] = chromaScale[x][0] * thetaY;
+		v[2] = chromaScale[x][1] * thetaX;	// green
+		v[3] = chromaScale[x][1] * thetaY;
+		v[4] = chromaScale[x][2] * thetaX;	// blue
+		v[5] = chromaScale[x][2] * thetaY;
 	}
 }
 
@@ -128,21 +138,27 @@ MemBuffer BuildDistortionBuffer( const hmdInfoInternal_t & hmdInfo,
 	const float	horizontalShiftMeters =  ( hmdInfo.lensSeparation / 2 ) - ( hmdInfo.widthMeters / 4 );
 	const float	horizontalShiftView = 2 * aspect * horizontalShiftMeters / hmdInfo.widthMeters;
 
+	// scratch for a row of vertices
+	Array< float >		inX( eyeBlocksWide + 1 );
+	Array< float >		rsq( eyeBlocksWide + 1 );
+	Array< Vector3f >	chromaScale( eyeBlocksWide + 1 );
+
 	for ( int eye = 0; eye < 2; eye++ )
 	{
+		for ( int x = 0; x <= eyeBlocksWide; x++ )
+		{
+			const float	xf = (float)x / (float)eyeBlocksWide;
+			inX[x] = ( eye ? -horizontalShiftView : horizontalShiftView ) +
+					xf *aspect + (1.0f-aspect) * 0.5f;
+		}
 		for ( int y = 0; y <= eyeBlocksHigh; y++ )
 		{
 			const float	yf = (float)y / (float)eyeBlocksHigh;
-			for ( int x = 0; x <= eyeBlocksWide; x++ )
-			{
-				int	vertNum = y * ( eyeBlocksWide+1 ) * 2 +
-						eye * (eyeBlocksWide+1) + x;
-				const float	xf = (float)x / (float)eyeBlocksWide;
-				float * v = &((float *)buf.Buffer)[3+vertNum*6];
-				const float inTex[2] = { ( eye ? -horizontalShiftView : horizontalShiftView ) +
-						xf *aspect + (1.0f-aspect) * 0.5f, yf };
-				WarpTexCoordChroma( hmdInfo, inTex, &v[0], &v[2], &v[4] );
-			}
+			const int	vertNum = y * ( eyeBlocksWide+1 ) * 2 +
+					eye * (eyeBlocksWide+1);
+			float * v = &((float *)buf.Buffer)[3+vertNum*6];
+			WarpTexCoordChromaRow( hmdInfo, &inX[0], yf, eyeBlocksWide + 1,
+					&rsq[0], &chromaScale[0], v, 6 );
 		}
 	}
 	return buf;
@@ -0,0 +1,603 @@
+/************************************************************************************
+
+Filename    :   FramePacing.cpp
+Content     :   TimeWarp scheduling decisions and a headless simulator for them.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "FramePacing.h"
+
+#include <string.h>
+
+#include "Log.h"
+
+namespace OVR
+{
+
+void CalculateSliceTimes( const VsyncState & vsyncState, const double vsyncBase,
+		const int numSlices, double * sliceTimes )
+{
+	static const double startBias = 0.0; // 8.0/1920.0/60.0;	// about 8 pixels into a 1920 screen at 60 hz
+	static const double activeFraction = 112.0 / 135;			// the remainder are blanking lines
+	for ( int i = 0; i <= numSlices; i++ )
+	{
+		const double framePoint = vsyncBase + activeFraction * (float)i / numSlices;
+		sliceTimes[i] = FramePointTimeInSeconds( vsyncState, framePoint ) + startBias;
+	}
+}
+
+//==============================================================
+// SliceScheduler
+//==============================================================
+
+const float SliceScheduler::MIN_CUSHION_SECONDS = 0.002f;
+const float SliceScheduler::MAX_CUSHION_SECONDS = 0.014f;
+
+// Used until a slice has been measured, and when GPU timer queries aren't available.
+static const float DEFAULT_SLICE_GPU_SECONDS = 0.001f;
+
+// The peaks of the wakeup and issue times halve in a couple of seconds at 60 Hz.
+static const float PEAK_DECAY_PER_FRAME = 0.995f;
+
+// Every miss at least doubles the safety margin, up to this.
+static const float MIN_BACKOFF_SECONDS = 0.0005f;
+static const float MAX_BACKOFF_SECONDS = 0.004f;
+
+// After this many frames without a miss the safety margin decays again.
+static const int SAFETY_HOLD_FRAMES = 120;
+static const float SAFETY_DECAY_PER_FRAME = 0.98f;
+
+SliceScheduler::SliceScheduler() :
+	FramesSinceMiss( 0 ),
+	MissedThisFrame( false )
+{
+	for ( int i = 0; i < MAX_SLICES; i++ )
+	{
+		Stats.GpuSeconds[i] = DEFAULT_SLICE_GPU_SECONDS;
+		Stats.CushionSeconds[i] = MAX_CUSHION_SECONDS;
+	}
+	PublishedStats.SetState( Stats );
+}
+
+float SliceScheduler::GetCushion( const int slice, const float maxCushionSeconds ) const
+{
+	const float maxCushion = Alg::Clamp( maxCushionSeconds, MIN_CUSHION_SECONDS, MAX_CUSHION_SECONDS );
+	if ( Stats.NumFrames == 0 )
+	{	// nothing measured yet
+		return maxCushion;
+	}
+	return Alg::Clamp( Stats.CushionSeconds[slice], MIN_CUSHION_SECONDS, maxCushion );
+}
+
+void SliceScheduler::UpdateSlice( const int slice, const double sleepTargetTime, const float secondsToSleep,
+		const double wakeTime, const double issuedTime, const double scanoutTime, const float gpuSeconds )
+{
+	OVR_ASSERT( slice >= 0 && slice < MAX_SLICES );
+
+	// Only an actual sleep says something about the scheduler; waking up
+	// after the target because the previous slice ran long is a miss below.
+	if ( secondsToSleep > 0.0f )
+	{
+		const float lateSeconds = Alg::Max( (float)( wakeTime - sleepTargetTime ), 0.0f );
+		Stats.WakeJitterSeconds = Alg::Max( Stats.WakeJitterSeconds, lateSeconds );
+	}
+	const float issueSeconds = Alg::Max( (float)( issuedTime - wakeTime ), 0.0f );
+	Stats.IssueSeconds[slice] = Alg::Max( Stats.IssueSeconds[slice], issueSeconds );
+	if ( gpuSeconds > 0.0f )
+	{
+		Stats.GpuSeconds[slice] = gpuSeconds;
+	}
+
+	// Without a GPU timestamp, completion is estimated from the issue time.
+	Stats.MarginSeconds[slice] = (float)( scanoutTime - ( issuedTime + Stats.GpuSeconds[slice] ) );
+	if ( Stats.MarginSeconds[slice] < 0.0f )
+	{
+		Stats.NumMisses++;
+		if ( !MissedThisFrame )
+		{	// back off once per frame, not once per slice of a bad frame
+			MissedThisFrame = true;
+			Stats.NumBackoffs++;
+			Stats.SafetySeconds = Alg::Min( Alg::Max( Stats.SafetySeconds * 2.0f, MIN_BACKOFF_SECONDS ), MAX_BACKOFF_SECONDS );
+		}
+	}
+}
+
+void SliceScheduler::EndFrame()
+{
+	Stats.NumFrames++;
+	if ( MissedThisFrame )
+	{
+		FramesSinceMiss = 0;
+		MissedThisFrame = false;
+	}
+	else if ( ++FramesSinceMiss > SAFETY_HOLD_FRAMES )
+	{
+		Stats.SafetySeconds *= SAFETY_DECAY_PER_FRAME;
+		if ( Stats.SafetySeconds < 0.0001f )
+		{
+			Stats.SafetySeconds = 0.0f;
+		}
+	}
+
+	for ( int i = 0; i < MAX_SLICES; i++ )
+	{
+		Stats.CushionSeconds[i] = Stats.WakeJitterSeconds + Stats.IssueSeconds[i] + Stats.GpuSeconds[i] + Stats.SafetySeconds;
+		Stats.IssueSeconds[i] *= PEAK_DECAY_PER_FRAME;
+	}
+	Stats.WakeJitterSeconds *= PEAK_DECAY_PER_FRAME;
+
+	PublishedStats.SetState( Stats );
+}
+
+void LogSliceScheduleStats( const SliceScheduleStats & stats )
+{
+	float minCushion = stats.CushionSeconds[0];
+	float maxCushion = stats.CushionSeconds[0];
+	float maxGpu = stats.GpuSeconds[0];
+	for ( int i = 1; i < SliceScheduleStats::MAX_SLICES; i++ )
+	{
+		minCushion = Alg::Min( minCushion, stats.CushionSeconds[i] );
+		maxCushion = Alg::Max( maxCushion, stats.CushionSeconds[i] );
+		maxGpu = Alg::Max( maxGpu, stats.GpuSeconds[i] );
+	}
+	LOG( "Slice schedule: %i frames, %i misses, %i backoffs, cushion %4.2f - %4.2f ms, "
+			"wakeup jitter %4.2f ms, GPU %4.2f ms, safety %4.2f ms",
+			stats.NumFrames, stats.NumMisses, stats.NumBackoffs, minCushion * 1000.0f, maxCushion * 1000.0f,
+			stats.WakeJitterSeconds * 1000.0f, maxGpu * 1000.0f, stats.SafetySeconds * 1000.0f );
+}
+
+//==============================================================
+// Simulation
+//==============================================================
+
+// Same as TimeWarpLocal.
+static const int SIM_WARP_SOURCES = 4;
+static const int SIM_SLICES_PER_SCREEN = 8;
+
+// A perfectly regular display, with a clock that only moves when the warp
+// thread sleeps or works. Sleeps wake up a little late, by a pseudo random
+// amount that only depends on the seed.
+class SimulatedVsyncClock : public VsyncClock
+{
+public:
+	SimulatedVsyncClock( const double periodSeconds, const float wakeupSeconds,
+			const float wakeupJitterSeconds, const unsigned seed ) :
+		Now( 1.0 ),
+		WakeupSeconds( wakeupSeconds ),
+		WakeupJitterSeconds( wakeupJitterSeconds ),
+		Random( seed )
+	{
+		State.vsyncCount = 0;
+		State.vsyncPeriodNano = periodSeconds * 1000000000.0;
+		State.vsyncBaseNano = Now * 1000000000.0;
+	}
+
+	virtual VsyncState	GetVsyncState() const { return State; }
+	virtual double		GetTimeInSeconds() const { return Now; }
+
+	virtual float		SleepUntilTimePoint( const double targetSeconds, const bool busyWait )
+	{
+		const float sleepSeconds = targetSeconds - Now;
+		if ( sleepSeconds > 0 )
+		{
+			Now = targetSeconds;
+			if ( !busyWait )
+			{
+				Now += WakeupSeconds + WakeupJitterSeconds * NextRandom();
+			}
+		}
+		return sleepSeconds;
+	}
+
+	void				Advance( const double seconds ) { Now += seconds; }
+
+private:
+	float				NextRandom()
+	{
+		Random = Random * 1664525u + 1013904223u;
+		return ( Random >> 8 ) * ( 1.0f / 16777216.0f );
+	}
+
+	VsyncState			State;
+	double				Now;
+	float				WakeupSeconds;
+	float				WakeupJitterSeconds;
+	unsigned			Random;
+};
+
+struct SimWarpSource
+{
+	long long	MinimumVsync;
+	long long	FirstDisplayedVsync[2];
+	double		GpuDoneTime;
+};
+
+// Stands in for polling the fence of the buffer set.
+struct SimFenceStatus
+{
+	double		Now;
+
+	WarpSourceStatus operator()( const SimWarpSource & source ) const
+	{
+		return ( source.GpuDoneTime <= Now ) ? WARP_SOURCE_READY : WARP_SOURCE_PENDING;
+	}
+};
+
+struct SimFrame
+{
+	SimFrame() : StartTime( 0.0 ), SubmitTime( 0.0 ), NumVsyncsDisplayed( 0 ), Latency( 0.0f ), WarpLatency( 0.0f ) {}
+
+	double		StartTime;			// WarpSwap() returned for the previous frame and the pose was sampled
+	double		SubmitTime;			// WarpSwap() called
+	int			NumVsyncsDisplayed;
+	float		Latency;
+	float		WarpLatency;
+};
+
+// The application thread and the GPU as the warp thread sees them, for
+// WarpFrame(). The application thread is either working on frames[NextFrame]
+// or blocked in WarpSwap() after submitting it.
+struct SimWarper
+{
+	SimWarper( const FramePacingParms & parms, SimulatedVsyncClock & clock, Array< SimFrame > & frames ) :
+		Parms( parms ),
+		Clock( clock ),
+		Frames( frames ),
+		NextFrame( 0 ),
+		Waiting( false ),
+		EyeBufferCount( 0 ),
+		LastSwapVsyncCount( 0 ),
+		GpuFreeTime( 0.0 ),
+		ThisEyeBufferNum( 0 ),
+		LastDisplayed( 0 ),
+		Missed( false )
+	{
+		memset( Sources, 0, sizeof( Sources ) );
+	}
+
+	bool	Latch( const WarpPointTiming & timing );
+	float	Warp( const int point, const WarpPointTiming & timing );
+
+	const FramePacingParms &	Parms;
+	SimulatedVsyncClock &		Clock;
+	Array< SimFrame > &			Frames;
+	SimWarpSource				Sources[SIM_WARP_SOURCES];
+
+	// The application thread.
+	int			NextFrame;
+	bool		Waiting;
+	long long	EyeBufferCount;			// buffer number N is Frames[N-1]
+	long long	LastSwapVsyncCount;
+	double		GpuFreeTime;
+
+	// The warp thread.
+	long long	ThisEyeBufferNum;
+	long long	LastDisplayed;
+	bool		Missed;					// on the current vsync
+};
+
+bool SimWarper::Latch( const WarpPointTiming & timing )
+{
+	const double latchTime = timing.WakeTime;
+	const int numFrames = Frames.GetSizeI();
+	const int numLoads = Parms.Loads.GetSizeI();
+
+	// A WarpSwap() call since the last latch is now visible.
+	if ( !Waiting && NextFrame < numFrames && Frames[NextFrame].SubmitTime <= latchTime )
+	{
+		const FrameLoad & load = Parms.Loads[NextFrame % numLoads];
+		SimWarpSource & ws = Sources[( EyeBufferCount + 1 ) % SIM_WARP_SOURCES];
+		ws.MinimumVsync = WarpSourceMinimumVsync( LastSwapVsyncCount, Parms.MinimumVsyncs );
+		ws.FirstDisplayedVsync[0] = 0;
+		ws.FirstDisplayedVsync[1] = 0;
+		GpuFreeTime = Alg::Max( GpuFreeTime, Frames[NextFrame].SubmitTime ) + load.GpuSeconds;
+		ws.GpuDoneTime = GpuFreeTime;
+		EyeBufferCount++;
+		Waiting = true;
+	}
+
+	SimFenceStatus fenceStatus;
+	fenceStatus.Now = latchTime;
+	int back = 0;
+	const bool found = SelectWarpSource( Sources, SIM_WARP_SOURCES, EyeBufferCount, timing.VsyncBase, 0,
+			fenceStatus, ThisEyeBufferNum, back );
+
+	// Release WarpSwap() if it was blocked before the latch.
+	SwapState state;
+	state.VsyncCount = (long long)timing.VsyncBase;
+	state.EyeBufferCount = ThisEyeBufferNum;
+	if ( Waiting && Frames[NextFrame].SubmitTime < latchTime &&
+			ReleaseWarpSwap( state, EyeBufferCount - 1, Parms.MinimumVsyncs, LastSwapVsyncCount ) )
+	{
+		// WarpSwap() always suspends for at least a millisecond.
+		const double returnTime = Alg::Max( latchTime, Frames[NextFrame].SubmitTime + 0.001 );
+		Waiting = false;
+		if ( ++NextFrame < numFrames )
+		{
+			Frames[NextFrame].StartTime = returnTime;
+			Frames[NextFrame].SubmitTime = returnTime + Parms.Loads[NextFrame % numLoads].CpuSeconds;
+		}
+	}
+
+	Missed = false;
+	if ( !found )
+	{
+		// The screen keeps showing the previous frame.
+		if ( LastDisplayed > 0 )
+		{
+			Frames[LastDisplayed - 1].NumVsyncsDisplayed++;
+		}
+		return false;
+	}
+	return true;
+}
+
+float SimWarper::Warp( const int point, const WarpPointTiming & timing )
+{
+	if ( point == 0 )
+	{
+		// Sliced warps go straight to the front buffer, whole eye warps are
+		// shown after the next swap.
+		const double photonTime = Parms.SlicedWarp ? timing.SliceTimes[0] : Clock.FramePointTimeInSeconds( timing.VsyncBase + 1.0 );
+		SimFrame & frame = Frames[ThisEyeBufferNum - 1];
+		if ( frame.NumVsyncsDisplayed == 0 )
+		{
+			frame.Latency = photonTime - frame.StartTime;
+			frame.WarpLatency = photonTime - timing.WakeTime;
+		}
+		frame.NumVsyncsDisplayed++;
+		LastDisplayed = ThisEyeBufferNum;
+	}
+
+	Clock.Advance( Parms.WarpSeconds );
+	if ( Parms.SlicedWarp )
+	{
+		Missed |= ( Clock.GetTimeInSeconds() > timing.SliceTimes[point] );
+	}
+	else if ( point == 1 )
+	{
+		Missed = ( Clock.GetTimeInSeconds() > Clock.FramePointTimeInSeconds( timing.VsyncBase + 1.0 ) );
+	}
+
+	// The simulated warp blocks until it is done, so there is no GPU time to add.
+	return 0.0f;
+}
+
+void SimulateFramePacing( const FramePacingParms & parms, FramePacingStats & stats )
+{
+	stats = FramePacingStats();
+
+	const int numFrames = parms.NumFrames;
+	const int numLoads = parms.Loads.GetSizeI();
+	if ( numFrames <= 0 || numLoads == 0 )
+	{
+		return;
+	}
+
+	SimulatedVsyncClock clock( parms.VsyncPeriodSeconds, parms.WakeupSeconds, parms.WakeupJitterSeconds, parms.Seed );
+
+	Array< SimFrame > frames;
+	frames.Resize( numFrames );
+	frames[0].StartTime = clock.GetTimeInSeconds();
+	frames[0].SubmitTime = frames[0].StartTime + parms.Loads[0].CpuSeconds;
+
+	WarpFrameSchedule schedule;
+	schedule.Sliced = parms.SlicedWarp;
+	schedule.NumSlices = SIM_SLICES_PER_SCREEN;
+	schedule.PreScheduleSeconds = parms.PreScheduleSeconds;
+	schedule.AdaptiveSliceSchedule = parms.AdaptiveSliceSchedule;
+	schedule.DeltaVsync[0] = parms.DeltaVsync[0];
+	schedule.DeltaVsync[1] = parms.DeltaVsync[1];
+
+	SimWarper warper( parms, clock, frames );
+	SliceScheduler sliceScheduler;
+	int			numVsyncs = 0;
+	const int	maxVsyncs = numFrames * ( parms.MinimumVsyncs + 8 ) + 16;
+
+	for ( double vsync = 0; numVsyncs < maxVsyncs; vsync++ )
+	{
+		vsync = NextWarpVsync( vsync, ceil( clock.GetFractionalVsync() ) );
+		numVsyncs++;
+
+		if ( !WarpFrame( clock, sliceScheduler, schedule, vsync, warper ) )
+		{
+			continue;
+		}
+		stats.NumWarpMisses += warper.Missed;
+
+		if ( warper.ThisEyeBufferNum == numFrames )
+		{
+			break;
+		}
+	}
+
+	const long long lastDisplayed = warper.LastDisplayed;
+	const long long eyeBufferCount = warper.EyeBufferCount;
+
+	// The last frame displayed stays up, so it isn't counted for judder.
+	Array< float > latencies;
+	double latencySum = 0.0;
+	double warpLatencySum = 0.0;
+	stats.NumVsyncs = numVsyncs;
+	stats.NumFramesSubmitted = (int)eyeBufferCount;
+	for ( int i = 0; i < numFrames; i++ )
+	{
+		const SimFrame & frame = frames[i];
+		if ( frame.NumVsyncsDisplayed == 0 )
+		{
+			stats.NumFramesDropped += ( i < lastDisplayed - 1 );
+			continue;
+		}
+		stats.NumFramesDisplayed++;
+		latencies.PushBack( frame.Latency );
+		latencySum += frame.Latency;
+		warpLatencySum += frame.WarpLatency;
+		stats.MaxLatency = Alg::Max( stats.MaxLatency, frame.Latency );
+		stats.MaxWarpLatency = Alg::Max( stats.MaxWarpLatency, frame.WarpLatency );
+		if ( i < lastDisplayed - 1 )
+		{
+			stats.NumJudderFrames += ( frame.NumVsyncsDisplayed != parms.MinimumVsyncs );
+			stats.NumRepeatedVsyncs += Alg::Max( frame.NumVsyncsDisplayed - parms.MinimumVsyncs, 0 );
+		}
+	}
+	if ( latencies.GetSizeI() > 0 )
+	{
+		Alg::QuickSort( latencies );
+		stats.MeanLatency = (float)( latencySum / latencies.GetSizeI() );
+		stats.MeanWarpLatency = (float)( warpLatencySum / latencies.GetSizeI() );
+		stats.P99Latency = latencies[(int)( ( latencies.GetSizeI() - 1 ) * 0.99f )];
+	}
+	stats.SliceSchedule = sliceScheduler.GetStats();
+}
+
+void LogFramePacingStats( const char * name, const FramePacingStats & stats )
+{
+	LOG( "%s: %i vsyncs, %i frames, %i displayed, %i dropped, %i judder, %i repeated vsyncs, %i warp misses, "
+			"latency %4.1f ms mean %4.1f p99 %4.1f max, warp latency %4.1f ms mean %4.1f max",
+			name, stats.NumVsyncs, stats.NumFramesSubmitted, stats.NumFramesDisplayed, stats.NumFramesDropped,
+			stats.NumJudderFrames, stats.NumRepeatedVsyncs, stats.NumWarpMisses,
+			stats.MeanLatency * 1000.0f, stats.P99Latency * 1000.0f, stats.MaxLatency * 1000.0f,
+			stats.MeanWarpLatency * 1000.0f, stats.MaxWarpLatency * 1000.0f );
+}
+
+void SimulateFramePacingScenarios()
+{
+	for ( int sliced = 0; sliced < 2; sliced++ )
+	{
+		FramePacingParms parms;
+		parms.SlicedWarp = ( sliced != 0 );
+		FramePacingStats stats;
+
+		parms.Loads.Clear();
+		parms.Loads.PushBack( FrameLoad( 0.008f, 0.010f ) );
+		SimulateFramePacing( parms, stats );
+		LogFramePacingStats( sliced ? "sliced, steady" : "steady", stats );
+
+		// A long frame every quarter second.
+		parms.Loads.Clear();
+		for ( int i = 0; i < 15; i++ )
+		{
+			parms.Loads.PushBack( FrameLoad( i == 0 ? 0.030f : 0.008f, 0.010f ) );
+		}
+		SimulateFramePacing( parms, stats );
+		LogFramePacingStats( sliced ? "sliced, CPU spikes" : "CPU spikes", stats );
+
+		// GPU bound just over the frame rate.
+		parms.Loads.Clear();
+		parms.Loads.PushBack( FrameLoad( 0.006f, 0.0175f ) );
+		SimulateFramePacing( parms, stats );
+		LogFramePacingStats( sliced ? "sliced, GPU bound" : "GPU bound", stats );
+
+		// The same at half rate.
+		parms.MinimumVsyncs = 2;
+		SimulateFramePacing( parms, stats );
+		LogFramePacingStats( sliced ? "sliced, GPU bound, MinimumVsyncs 2" : "GPU bound, MinimumVsyncs 2", stats );
+		parms.MinimumVsyncs = 1;
+
+		// A badly behaved scheduler.
+		parms.Loads.Clear();
+		parms.Loads.PushBack( FrameLoad( 0.008f, 0.010f ) );
+		parms.WakeupJitterSeconds = 0.004f;
+		SimulateFramePacing( parms, stats );
+		LogFramePacingStats( sliced ? "sliced, 4 ms wakeup jitter" : "4 ms wakeup jitter", stats );
+	}
+
+	// The sliced warp with the cushion chosen by SliceScheduler.
+	FramePacingParms parms;
+	parms.SlicedWarp = true;
+	parms.AdaptiveSliceSchedule = true;
+	parms.Loads.PushBack( FrameLoad( 0.008f, 0.010f ) );
+	FramePacingStats stats;
+	SimulateFramePacing( parms, stats );
+	LogFramePacingStats( "sliced, adaptive, steady", stats );
+	LogSliceScheduleStats( stats.SliceSchedule );
+
+	parms.WakeupJitterSeconds = 0.004f;
+	SimulateFramePacing( parms, stats );
+	LogFramePacingStats( "sliced, adaptive, 4 ms wakeup jitter", stats );
+	LogSliceScheduleStats( stats.SliceSchedule );
+}
+
+static void CheckFramePacing( const char * name, const char * check, const bool passed,
+		const FramePacingStats & stats, int & numErrors )
+{
+	if ( !passed )
+	{
+		LOG( "TestFramePacing: %s failed %s", name, check );
+		LogFramePacingStats( name, stats );
+		numErrors++;
+	}
+}
+
+bool TestFramePacing()
+{
+	int numErrors = 0;
+	for ( int sliced = 0; sliced < 2; sliced++ )
+	{
+		FramePacingParms parms;
+		parms.SlicedWarp = ( sliced != 0 );
+		FramePacingStats stats;
+
+		// A load that comfortably fits a vsync shows every frame for exactly one.
+		parms.Loads.PushBack( FrameLoad( 0.008f, 0.010f ) );
+		SimulateFramePacing( parms, stats );
+		const char * name = sliced ? "sliced, steady" : "steady";
+		CheckFramePacing( name, "all displayed", stats.NumFramesDisplayed == parms.NumFrames, stats, numErrors );
+		CheckFramePacing( name, "no judder", stats.NumFramesDropped == 0 && stats.NumJudderFrames == 0, stats, numErrors );
+		CheckFramePacing( name, "latency under four vsyncs", stats.MaxLatency < 4.0f * parms.VsyncPeriodSeconds, stats, numErrors );
+
+		// The same parameters give the same results.
+		FramePacingStats again;
+		SimulateFramePacing( parms, again );
+		CheckFramePacing( name, "deterministic", again.NumVsyncs == stats.NumVsyncs &&
+				again.MeanLatency == stats.MeanLatency && again.NumWarpMisses == stats.NumWarpMisses, again, numErrors );
+
+		// A long frame every quarter second judders once for each.
+		parms.Loads.Clear();
+		for ( int i = 0; i < 15; i++ )
+		{
+			parms.Loads.PushBack( FrameLoad( i == 0 ? 0.030f : 0.008f, 0.010f ) );
+		}
+		SimulateFramePacing( parms, stats );
+		name = sliced ? "sliced, CPU spikes" : "CPU spikes";
+		CheckFramePacing( name, "judder only at the spikes", stats.NumJudderFrames > 0 &&
+				stats.NumJudderFrames <= parms.NumFrames / 15, stats, numErrors );
+		CheckFramePacing( name, "no drops", stats.NumFramesDropped == 0, stats, numErrors );
+
+		// GPU bound just over the frame rate repeats vsyncs...
+		parms.Loads.Clear();
+		parms.Loads.PushBack( FrameLoad( 0.006f, 0.0175f ) );
+		SimulateFramePacing( parms, stats );
+		name = sliced ? "sliced, GPU bound" : "GPU bound";
+		CheckFramePacing( name, "repeated vsyncs", stats.NumRepeatedVsyncs > 0, stats, numErrors );
+
+		// ...but is steady at half rate.
+		parms.MinimumVsyncs = 2;
+		SimulateFramePacing( parms, stats );
+		name = sliced ? "sliced, GPU bound, MinimumVsyncs 2" : "GPU bound, MinimumVsyncs 2";
+		CheckFramePacing( name, "no judder", stats.NumFramesDropped == 0 && stats.NumJudderFrames == 0, stats, numErrors );
+		CheckFramePacing( name, "two vsyncs per frame", stats.NumVsyncs >= 2 * parms.NumFrames, stats, numErrors );
+	}
+
+	// The adaptive slice schedule cuts the warp latency of a fixed cushion
+	// without tearing more than the odd slice.
+	FramePacingParms parms;
+	parms.SlicedWarp = true;
+	parms.Loads.PushBack( FrameLoad( 0.008f, 0.010f ) );
+	FramePacingStats fixed;
+	SimulateFramePacing( parms, fixed );
+	parms.AdaptiveSliceSchedule = true;
+	FramePacingStats adaptive;
+	SimulateFramePacing( parms, adaptive );
+	CheckFramePacing( "sliced, adaptive, steady", "lower warp latency",
+			adaptive.MeanWarpLatency < fixed.MeanWarpLatency * 0.5f, adaptive, numErrors );
+	CheckFramePacing( "sliced, adaptive, steady", "few misses",
+			adaptive.NumWarpMisses <= 2 && adaptive.SliceSchedule.NumMisses < parms.NumFrames / 20, adaptive, numErrors );
+
+	return numErrors == 0;
+}
+
+}	// namespace OVR
@@ -0,0 +1,429 @@
+/************************************************************************************
+
+Filename    :   FramePacing.h
+Content     :   TimeWarp scheduling decisions and a headless simulator for them.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+#ifndef OVR_FramePacing_h
+#define OVR_FramePacing_h
+
+#include <math.h>
+
+#include "Kernel/OVR_Types.h"
+#include "Kernel/OVR_Array.h"
+#include "Kernel/OVR_Alg.h"
+#include "Vsync.h"
+
+namespace OVR
+{
+
+//==============================================================
+// The scheduling decisions made by TimeWarpLocal, kept free of
+// GL, EGL and the system clock so SimulateFramePacing() runs
+// exactly the same code.
+//==============================================================
+
+// The first vsync a buffer set submitted by WarpSwap() may be displayed at.
+// Never pick up a source from the vsync it was submitted in, to avoid
+// problems with very fast frames.
+inline long long WarpSourceMinimumVsync( const long long lastSwapVsyncCount, const int minimumVsyncs )
+{
+	return lastSwapVsyncCount + 2 * minimumVsyncs;
+}
+
+// The swap vsync count WarpSwap() keeps after the warp thread latched at
+// latchedVsyncCount. If MinimumVsyncs was increased dynamically, one or more
+// vsyncs are skipped just as the change happens.
+inline long long NextSwapVsyncCount( const long long latchedVsyncCount, const long long lastSwapVsyncCount, const int minimumVsyncs )
+{
+	return Alg::Max( latchedVsyncCount, lastSwapVsyncCount + minimumVsyncs );
+}
+
+// This is communicated from the TimeWarp thread to the VrThread at
+// vsync time.
+struct SwapState
+{
+	SwapState() : VsyncCount(0),EyeBufferCount(0) {}
+	long long		VsyncCount;
+	long long		EyeBufferCount;
+};
+
+// Called by WarpSwap() with each state the warp thread latches while it is
+// blocked. Once the warp thread has looked at the buffer set submitted before
+// this one, lastBufferCount, or a newer one, WarpSwap() can return, keeping
+// the vsync count for the next WarpSourceMinimumVsync().
+inline bool ReleaseWarpSwap( const SwapState & state, const long long lastBufferCount,
+		const int minimumVsyncs, long long & lastSwapVsyncCount )
+{
+	if ( state.EyeBufferCount < lastBufferCount )
+	{
+		return false;
+	}
+	lastSwapVsyncCount = NextSwapVsyncCount( state.VsyncCount, lastSwapVsyncCount, minimumVsyncs );
+	return true;
+}
+
+// The next vsync for the warp thread loop, which follows the display unless
+// it has drifted more than two vsyncs away from it.
+inline double NextWarpVsync( const double vsync, const double currentVsync )
+{
+	return ( fabs( currentVsync - vsync ) > 2.0 ) ? currentVsync : vsync;
+}
+
+// The times the raster reaches each of numSlices slices of the active lines
+// of vsyncBase, plus the end of the active lines in sliceTimes[numSlices].
+void CalculateSliceTimes( const VsyncState & vsyncState, const double vsyncBase,
+		const int numSlices, double * sliceTimes );
+
+enum WarpSourceStatus
+{
+	WARP_SOURCE_READY,			// rendering completed
+	WARP_SOURCE_PENDING,		// still rendering, try an older one
+	WARP_SOURCE_INVALID			// stop looking
+};
+
+// Walks back from the most recently submitted buffer set to the newest one that
+// may be displayed at vsyncBase and has finished rendering, as reported by
+// sourceStatus( source ), and marks when it is first displayed for the eye.
+// Returns false if there is nothing to display. Either way thisEyeBufferNum is
+// the last buffer number looked at, which is what the warp thread reports back
+// to WarpSwap(), and back is how far it is behind the latest.
+//
+// The sources only need MinimumVsync and FirstDisplayedVsync[2] members.
+template< typename _source_, typename _statusFunc_ >
+bool SelectWarpSource( _source_ * sources, const int maxSources, const long long latestEyeBufferNum,
+		const double vsyncBase, const int eye, _statusFunc_ & sourceStatus,
+		long long & thisEyeBufferNum, int & back )
+{
+	thisEyeBufferNum = 0;
+	for ( back = 0; back < maxSources - 1; back++ )
+	{
+		thisEyeBufferNum = latestEyeBufferNum - back;
+		if ( thisEyeBufferNum <= 0 )
+		{	// just starting, and we don't have any eye buffers to use
+			return false;
+		}
+		_source_ & testSource = sources[thisEyeBufferNum % maxSources];
+		if ( testSource.MinimumVsync > vsyncBase )
+		{	// a full frame got completed in less time than a single eye; don't use it to avoid stuttering
+			continue;
+		}
+		const WarpSourceStatus status = sourceStatus( testSource );
+		if ( status == WARP_SOURCE_PENDING )
+		{
+			continue;
+		}
+		if ( status == WARP_SOURCE_INVALID )
+		{
+			return false;
+		}
+
+		// This buffer set is good to use
+		if ( testSource.FirstDisplayedVsync[eye] == 0 )
+		{
+			testSource.FirstDisplayedVsync[eye] = (long long)vsyncBase;
+		}
+		return true;
+	}
+	return false;
+}
+
+//==============================================================
+// SliceScheduler
+//
+// A sliced warp sleeps until shortly before the raster reaches
+// each slice. The cushion has to cover the oversleep of the
+// warp thread, the CPU time to issue the slice and the GPU time
+// to draw it, or the slice tears, but every millisecond of it
+// is also a millisecond of latency. Instead of a fixed
+// PreScheduleSeconds, this tracks all three per slice and picks
+// the smallest cushion that covered them recently, plus a safety
+// margin that doubles on every miss and slowly decays after.
+//==============================================================
+
+struct SliceScheduleStats
+{
+	static const int MAX_SLICES = 8;
+
+	SliceScheduleStats() :
+		NumFrames( 0 ),
+		NumMisses( 0 ),
+		NumBackoffs( 0 ),
+		WakeJitterSeconds( 0.0f ),
+		SafetySeconds( 0.0f )
+	{
+		for ( int i = 0; i < MAX_SLICES; i++ )
+		{
+			CushionSeconds[i] = 0.0f;
+			IssueSeconds[i] = 0.0f;
+			GpuSeconds[i] = 0.0f;
+			MarginSeconds[i] = 0.0f;
+		}
+	}
+
+	int		NumFrames;
+	int		NumMisses;					// slices that were estimated to finish after their scanout started
+	int		NumBackoffs;				// frames with at least one miss
+	float	WakeJitterSeconds;			// recent peak oversleep of the warp thread
+	float	SafetySeconds;				// added to every slice after misses
+	float	CushionSeconds[MAX_SLICES];	// the current choice
+	float	IssueSeconds[MAX_SLICES];	// recent peak CPU time to issue the slice
+	float	GpuSeconds[MAX_SLICES];		// measured GPU time, or the default guess
+	float	MarginSeconds[MAX_SLICES];	// estimated time between completion and scanout on the last frame
+};
+
+class SliceScheduler
+{
+public:
+	static const int MAX_SLICES = SliceScheduleStats::MAX_SLICES;
+
+	// The range PreScheduleSeconds is clamped to.
+	static const float MIN_CUSHION_SECONDS;
+	static const float MAX_CUSHION_SECONDS;
+
+					SliceScheduler();
+
+	// Seconds before the scanout of the slice to start warping it, never more
+	// than maxCushionSeconds, which is normally the application's
+	// PreScheduleSeconds.
+	float			GetCushion( const int slice, const float maxCushionSeconds ) const;
+
+	// Called after each slice has been issued, whether or not the cushion was
+	// used, with what SleepUntilTimePoint() returned. The GPU time is the
+	// measured time to draw the slice, or 0 if it isn't known.
+	void			UpdateSlice( const int slice, const double sleepTargetTime, const float secondsToSleep,
+							const double wakeTime, const double issuedTime, const double scanoutTime,
+							const float gpuSeconds );
+
+	// Called after the last slice of every frame. Publishes the stats.
+	void			EndFrame();
+
+	// Can be called from any thread.
+	SliceScheduleStats	GetStats() const { return PublishedStats.GetState(); }
+
+private:
+	SliceScheduleStats	Stats;
+	int					FramesSinceMiss;
+	bool				MissedThisFrame;
+	LocklessUpdater< SliceScheduleStats >	PublishedStats;
+};
+
+void	LogSliceScheduleStats( const SliceScheduleStats & stats );
+
+//==============================================================
+// WarpFrame
+//
+// The warp thread's work for one vsync, shared by TimeWarpLocal
+// and SimulateFramePacing(), which supply what is done at each
+// step.
+//==============================================================
+
+// How the warp of one vsync is split up and when each part is issued.
+struct WarpFrameSchedule
+{
+	WarpFrameSchedule() :
+		Sliced( false ),
+		NumSlices( SliceScheduleStats::MAX_SLICES ),
+		PreScheduleSeconds( 0.014f ),
+		AdaptiveSliceSchedule( false )
+	{
+		DeltaVsync[0] = 0.0f;
+		DeltaVsync[1] = 0.5f;
+	}
+
+	bool	Sliced;					// SWAP_OPTION_USE_SLICED_WARP
+	int		NumSlices;				// across the whole screen
+	float	PreScheduleSeconds;		// TimeWarpParms::PreScheduleSeconds, for sliced warps
+	bool	AdaptiveSliceSchedule;	// SWAP_OPTION_ADAPTIVE_SLICE_SCHEDULE
+	float	DeltaVsync[2];			// swap program eye sleep points, for whole eye warps
+};
+
+// When an eye or slice was due, and when the warp thread got to it.
+struct WarpPointTiming
+{
+	double			VsyncBase;
+	double			SleepTargetTime;
+	float			SecondsToSleep;		// as returned by SleepUntilTimePoint()
+	double			WakeTime;
+	const double *	SliceTimes;			// NumSlices + 1 raster times for sliced warps, otherwise NULL
+};
+
+// Sleeps until each eye or slice of vsyncBase is due and has the warper issue
+// it. When the first one is due the warper latches a buffer set. If there is
+// nothing to draw, this sleeps until the same point of the next vsync and
+// returns false. The cushions of sliced warps come from sliceScheduler when
+// the schedule is adaptive, and it is updated either way.
+//
+// The warper needs these members:
+//	bool	Latch( const WarpPointTiming & timing );			// false if there is nothing to draw
+//	float	Warp( const int point, const WarpPointTiming & timing );	// eye or slice, returns its GPU seconds, 0 if not known
+template< typename _warper_ >
+bool WarpFrame( VsyncClock & clock, SliceScheduler & sliceScheduler, const WarpFrameSchedule & schedule,
+		const double vsyncBase, _warper_ & warper )
+{
+	// Fetch vsync timing information once, so we don't have to worry
+	// about it changing slightly inside a given frame.
+	double sliceTimes[SliceScheduleStats::MAX_SLICES + 1];
+	if ( schedule.Sliced )
+	{
+		OVR_ASSERT( schedule.NumSlices <= SliceScheduleStats::MAX_SLICES );
+		const VsyncState vsyncState = clock.GetVsyncState();
+		if ( vsyncState.vsyncBaseNano == 0 )
+		{
+			return false;
+		}
+		// Because there are blanking lines at the bottom, there will always be a longer
+		// sleep for the first slice than the remainder.
+		CalculateSliceTimes( vsyncState, vsyncBase, schedule.NumSlices, sliceTimes );
+	}
+
+	const int numPoints = schedule.Sliced ? schedule.NumSlices : 2;
+	for ( int point = 0; point < numPoints; point++ )
+	{
+		// Sleep until we are in the correct part of the screen for this eye
+		// or slice. If we are running single threaded, the first eye will
+		// probably already be past the sleep point, so only the second eye
+		// will be at a dependable time.
+		WarpPointTiming timing;
+		timing.VsyncBase = vsyncBase;
+		if ( schedule.Sliced )
+		{
+			timing.SleepTargetTime = sliceTimes[point] - ( schedule.AdaptiveSliceSchedule ?
+					sliceScheduler.GetCushion( point, schedule.PreScheduleSeconds ) : schedule.PreScheduleSeconds );
+			timing.SliceTimes = sliceTimes;
+		}
+		else
+		{
+			timing.SleepTargetTime = clock.FramePointTimeInSeconds( vsyncBase + schedule.DeltaVsync[point] );
+			timing.SliceTimes = NULL;
+		}
+		timing.SecondsToSleep = clock.SleepUntilTimePoint( timing.SleepTargetTime, false );
+		timing.WakeTime = clock.GetTimeInSeconds();
+
+		// Check for availability of updated eye renderings now that we are
+		// about to render.
+		if ( point == 0 && !warper.Latch( timing ) )
+		{
+			// We don't have anything valid to draw, so just sleep until
+			// the next time point and check again.
+			clock.SleepUntilTimePoint( clock.FramePointTimeInSeconds( schedule.Sliced ?
+					vsyncBase + 1.0 : vsyncBase + schedule.DeltaVsync[0] + 1.0 ), false );
+			return false;
+		}
+
+		const float gpuSeconds = warper.Warp( point, timing );
+
+		if ( schedule.Sliced )
+		{
+			sliceScheduler.UpdateSlice( point, timing.SleepTargetTime, timing.SecondsToSleep, timing.WakeTime,
+					clock.GetTimeInSeconds(), sliceTimes[point], gpuSeconds );
+		}
+	}
+
+	if ( schedule.Sliced )
+	{
+		sliceScheduler.EndFrame();
+	}
+	return true;
+}
+
+//==============================================================
+// Simulation
+//==============================================================
+
+// The CPU and GPU time of one application frame.
+struct FrameLoad
+{
+	FrameLoad() : CpuSeconds( 0.0f ), GpuSeconds( 0.0f ) {}
+	FrameLoad( const float cpu, const float gpu ) : CpuSeconds( cpu ), GpuSeconds( gpu ) {}
+
+	float	CpuSeconds;		// from the return of WarpSwap() to the next call
+	float	GpuSeconds;		// eye rendering, queued when WarpSwap() is called
+};
+
+struct FramePacingParms
+{
+	FramePacingParms() :
+		NumFrames( 600 ),
+		VsyncPeriodSeconds( 1.0 / 60.0 ),
+		MinimumVsyncs( 1 ),
+		SlicedWarp( false ),
+		PreScheduleSeconds( 0.014f ),
+		WarpSeconds( 0.0015f ),
+		WakeupSeconds( 0.0001f ),
+		WakeupJitterSeconds( 0.0005f ),
+		AdaptiveSliceSchedule( false ),
+		Seed( 1 )
+	{
+		DeltaVsync[0] = 0.0f;
+		DeltaVsync[1] = 0.5f;
+	}
+
+	int					NumFrames;				// application frames to submit
+	Array< FrameLoad >	Loads;					// used in turn for the frames
+	double				VsyncPeriodSeconds;
+	int					MinimumVsyncs;			// TimeWarpParms::MinimumVsyncs
+	bool				SlicedWarp;				// SWAP_OPTION_USE_SLICED_WARP
+	float				PreScheduleSeconds;		// TimeWarpParms::PreScheduleSeconds, for sliced warps
+	float				DeltaVsync[2];			// swap program eye sleep points, for whole eye warps
+	float				WarpSeconds;			// time to warp an eye, or a slice when sliced
+	float				WakeupSeconds;			// minimum oversleep of the warp thread
+	float				WakeupJitterSeconds;	// additional random oversleep
+	bool				AdaptiveSliceSchedule;	// SWAP_OPTION_ADAPTIVE_SLICE_SCHEDULE
+	unsigned			Seed;					// for the oversleep
+};
+
+struct FramePacingStats
+{
+	FramePacingStats() :
+		NumVsyncs( 0 ),
+		NumFramesSubmitted( 0 ),
+		NumFramesDisplayed( 0 ),
+		NumFramesDropped( 0 ),
+		NumJudderFrames( 0 ),
+		NumRepeatedVsyncs( 0 ),
+		NumWarpMisses( 0 ),
+		MeanLatency( 0.0f ),
+		P99Latency( 0.0f ),
+		MaxLatency( 0.0f ),
+		MeanWarpLatency( 0.0f ),
+		MaxWarpLatency( 0.0f ) {}
+
+	int		NumVsyncs;
+	int		NumFramesSubmitted;
+	int		NumFramesDisplayed;
+	int		NumFramesDropped;		// replaced by a newer frame before they were displayed
+	int		NumJudderFrames;		// displayed for more or fewer vsyncs than MinimumVsyncs
+	int		NumRepeatedVsyncs;		// vsyncs beyond MinimumVsyncs that showed the same frame again
+	int		NumWarpMisses;			// vsyncs where a warp finished after its part of the screen was scanned
+	float	MeanLatency;			// from the start of an application frame to its first photons
+	float	P99Latency;
+	float	MaxLatency;
+	float	MeanWarpLatency;		// from the warp thread latching a frame to its first photons
+	float	MaxWarpLatency;
+	SliceScheduleStats	SliceSchedule;	// at the end, for sliced warps
+};
+
+// Simulates the application thread, the asynchronous warp thread and the GPU
+// against a perfectly regular display, using the same scheduling decisions as
+// TimeWarpLocal. Everything runs on simulated time, so the results only depend
+// on the parameters.
+void	SimulateFramePacing( const FramePacingParms & parms, FramePacingStats & stats );
+
+void	LogFramePacingStats( const char * name, const FramePacingStats & stats );
+
+// Simulates a few typical loads, both with whole eye and with sliced warps,
+// and LOGs the results.
+void	SimulateFramePacingScenarios();
+
+// Checks the simulated results of a few loads with known outcomes, like a
+// steady load never juddering and a GPU bound one settling on every other
+// vsync at MinimumVsyncs 2. Doesn't need GL.
+bool	TestFramePacing();
+
+}	// namespace OVR
+
+#endif	// OVR_FramePacing_h
@@ -24,11 +24,13 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include <pthread.h>
 #include <sched.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <poll.h>
 
 
 #include "OVR_CAPI.h"		// for TimeInSeconds()
 #include "Log.h"
+#include "3rdParty/turbojpeg.h"
 
 namespace OVR {
 
@@ -40,21 +42,59 @@ static const int IMAGE_SERVER_PORT = 52602;		// both TCP and UDP
 // Send this in a broadcast UDP packet to IMAGE_SERVER_PORT and listen for response.
 static const char * IMAGE_SERVER_REQUEST = "Image Server?";
 
-
-ImageServer::ImageServer() : ShutdownSocket( 0 ),
-		CurrentResolution( 0 ), SequenceCaptured( 0 ),
-		ResampleRenderBuffer( 0 ), FrameBufferObject( 0 ), PixelBufferObject( 0 ),
-		PboMappedAddress( 0 ),
-		serverThread( 0 ), CountdownToSend( 0 )
+static const char * ImageEncodingNames[IMAGE_ENCODING_MAX] =
+{
+	"raw",
+	"rle",
+	"jpeg"
+};
+
+// Log streaming throughput this often
+static const double STATS_LOG_SECONDS = 10.0;
+
+ImageServer::ImageServer( const bool discoverable ) : ShutdownSocket( 0 ),
+		Discoverable( discoverable ), AcceptPort( 0 ),
+		CurrentResolution( 0 ), SequenceCaptured( 0 ), CaptureCount( 0 ), SkippedCaptures( 0 ),
+		NextStreamCapture( 0.0 ),
+		ResampleRenderBuffer( 0 ), FrameBufferObject( 0 ),
+		serverThread( 0 ), encoderThread( 0 ),
+		EncoderShutdown( false ), WantedEncodings( 0 ),
+		ReadyFrame( NULL ), SpareFrame( NULL ),
+		StatFramesEncoded( 0 ), StatFramesSkipped( 0 ), StatFramesUnsent( 0 ),
+		StatEncodeSeconds( 0.0 ), StatStartTime( 0.0 )
 {
 	LOG( "-------------------- Startup() --------------------" );
 
-    pthread_mutex_init( &ResponseMutex, NULL /* default attributes */ );
-    pthread_cond_init( &ResponseCondition, NULL /* default attributes */ );
+	for ( int i = 0 ; i < NUM_PBOS ; i++ )
+	{
+		memset( &Pbos[i], 0, sizeof( Pbos[i] ) );
+		Pbos[i].State = PBO_FREE;
+	}
+	for ( int i = 0 ; i < IMAGE_ENCODING_MAX ; i++ )
+	{
+		StatBytesEncoded[i] = 0.0;
+	}
+
+	// The encoder wakes the server thread when a frame is ready to send
+	WakeSockets[0] = WakeSockets[1] = 0;
+	if ( socketpair( AF_LOCAL, SOCK_SEQPACKET, 0, WakeSockets ) == -1 )
+	{
+		FAIL( "socketpair: %s", strerror( errno ) );
+	}
 
     pthread_mutex_init( &StartStopMutex, NULL /* default attributes */ );
     pthread_cond_init( &StartStopCondition, NULL /* default attributes */ );
 
+    pthread_mutex_init( &EncodeMutex, NULL /* default attributes */ );
+    pthread_cond_init( &EncodeCondition, NULL /* default attributes */ );
+    pthread_mutex_init( &FrameMutex, NULL /* default attributes */ );
+
+    const int encoderErr = pthread_create( &encoderThread, NULL /* default attributes */, &EncoderThreadStarter, this );
+    if ( encoderErr != 0 )
+    {
+    	FAIL( "pthread_create returned %i", encoderErr );
+    }
+
     // spawn the warp thread amd wait for acknowledgment
 	pthread_mutex_lock( &StartStopMutex );
     const int createErr = pthread_create( &serverThread, NULL /* default attributes */, &ThreadStarter, this );
@@ -81,17 +121,23 @@ void ImageServer::FreeBuffers()
 		glDeleteFramebuffers( 1, &FrameBufferObject );
 		FrameBufferObject = 0;
 	}
-	if ( PixelBufferObject )
+	for ( int i = 0 ; i < NUM_PBOS ; i++ )
 	{
-		if ( PboMappedAddress )
+		PboSlot & slot = Pbos[i];
+		if ( slot.Buffer )
 		{
-			glBindBuffer( GL_PIXEL_PACK_BUFFER, PixelBufferObject );
-			glUnmapBuffer_( GL_PIXEL_PACK_BUFFER );
-			glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
-			PboMappedAddress = NULL;
+			if ( slot.MappedAddress )
+			{
+				glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
+				glUnmapBuffer_( GL_PIXEL_PACK_BUFFER );
+				glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+				slot.MappedAddress = NULL;
+			}
+			glDeleteBuffers( 1, &slot.Buffer );
+			slot.Buffer = 0;
 		}
-		glDeleteBuffers( 1, &PixelBufferObject );
-		PixelBufferObject = 0;
+		slot.State = PBO_FREE;
+		slot.CountdownToMap = 0;
 	}
 }
 
@@ -111,15 +157,6 @@ ImageServer::~ImageServer()
 		char	data;
 		write( ShutdownSocket, &data, 1 );
 
-		// also fire the condition, in case it was waiting
-		// on TimeWarp to signal completion
-		ImageServerResponse	badResponse;
-		badResponse.Data = NULL;
-		badResponse.Resolution = -1;
-		badResponse.Sequence = -1;
-		Response.SetState( badResponse );
-		pthread_cond_signal( &ResponseCondition );
-
 		LOG( "Waiting on StartStopCondition." );
 
 		pthread_cond_wait( &StartStopCondition, &StartStopMutex );
@@ -128,6 +165,17 @@ ImageServer::~ImageServer()
 		LOG( "Thread stop acknowledged." );
 	}
 
+	if ( encoderThread )
+	{
+		pthread_mutex_lock( &EncodeMutex );
+		EncoderShutdown = true;
+		pthread_cond_signal( &EncodeCondition );
+		pthread_mutex_unlock( &EncodeMutex );
+
+		pthread_join( encoderThread, NULL );
+		LOG( "Encoder thread joined." );
+	}
+
 	// free GL tools
 	if ( UnitSquare.vertexArrayObject )
 	{
@@ -138,6 +186,21 @@ ImageServer::~ImageServer()
 		DeleteProgram( ResampleProg );
 	}
 	FreeBuffers();
+
+	delete ReadyFrame;
+	delete SpareFrame;
+
+	for ( int i = 0 ; i < 2 ; i++ )
+	{
+		if ( WakeSockets[i] > 0 )
+		{
+			close( WakeSockets[i] );
+		}
+	}
+
+	pthread_mutex_destroy( &FrameMutex );
+	pthread_cond_destroy( &EncodeCondition );
+	pthread_mutex_destroy( &EncodeMutex );
 	LOG( "-------------------- Shutdown completed --------------------" );
 }
 
@@ -155,6 +218,19 @@ void *ImageServer::ThreadStarter( void * parm )
 	return NULL;
 }
 
+void *ImageServer::EncoderThreadStarter( void * parm )
+{
+	int result = pthread_setname_np( pthread_self(), "ImageEncoder" );
+	if ( result != 0 )
+	{
+		LOG( "ImageServer: pthread_setname_np failed %s", strerror( result ) );
+	}
+
+	ImageServer & is = *(ImageServer *)parm;
+	is.EncoderThread();
+	return NULL;
+}
+
 //#if OVR_BYTE_ORDER == OVR_BIG_ENDIAN
 //uint16_t _htons( uint16_t hostshort ) { return hostshort; }
 //uint16_t _ntohs( uint16_t netshort ) { return netshort; }
@@ -192,7 +268,503 @@ int BindToPort( const int sock, const int port )
 	}
 }
 
-//static short	testData[256*256];
+int ImageServer::EncodeRle565( const UInt16 * src, const int count, UInt16 * dst )
+{
+	// A token with the high bit set is followed by one pixel that is repeated
+	// ( token & 0x7FFF ) times, otherwise the token is followed by that many
+	// literal pixels.
+	static const int MAX_TOKEN_COUNT = 0x7FFF;
+
+	int out = 0;
+	int i = 0;
+	while ( i < count )
+	{
+		int run = 1;
+		while ( i + run < count && run < MAX_TOKEN_COUNT && src[i + run] == src[i] )
+		{
+			run++;
+		}
+		if ( run >= 3 )
+		{
+			dst[out++] = (UInt16)( 0x8000 | run );
+			dst[out++] = src[i];
+			i += run;
+			continue;
+		}
+
+		// literals until the next run of three
+		const int literalStart = i;
+		int literals = 0;
+		while ( i < count && literals < MAX_TOKEN_COUNT )
+		{
+			if ( i + 2 < count && src[i] == src[i + 1] && src[i] == src[i + 2] )
+			{
+				break;
+			}
+			i++;
+			literals++;
+		}
+		dst[out++] = (UInt16)literals;
+		memcpy( &dst[out], &src[literalStart], literals * sizeof( UInt16 ) );
+		out += literals;
+	}
+	return out;
+}
+
+bool ImageServer::DecodeRle565( const UInt16 * src, const int srcCount, UInt16 * dst, const int dstCount )
+{
+	int in = 0;
+	int out = 0;
+	while ( in < srcCount )
+	{
+		const UInt16 token = src[in++];
+		const int count = token & 0x7FFF;
+		if ( out + count > dstCount )
+		{
+			return false;
+		}
+		if ( token & 0x8000 )
+		{
+			if ( in >= srcCount )
+			{
+				return false;
+			}
+			const UInt16 pixel = src[in++];
+			for ( int i = 0 ; i < count ; i++ )
+			{
+				dst[out++] = pixel;
+			}
+		}
+		else
+		{
+			if ( in + count > srcCount )
+			{
+				return false;
+			}
+			memcpy( &dst[out], &src[in], count * sizeof( UInt16 ) );
+			in += count;
+			out += count;
+		}
+	}
+	return out == dstCount;
+}
+
+static ImageServerFrameHeader FrameHeader( const int sequence, const int resolution,
+		const int encoding, const int payloadBytes )
+{
+	ImageServerFrameHeader header;
+	header.Magic = htonl( IMAGE_SERVER_FRAME_MAGIC );
+	header.Sequence = htonl( sequence );
+	header.Resolution = htonl( resolution );
+	header.Encoding = htonl( encoding );
+	header.PayloadBytes = htonl( payloadBytes );
+	return header;
+}
+
+bool ImageServer::SendStreamFrame( const int socket, const int sequence, const int resolution,
+		const int encoding, const Array< unsigned char > & payload )
+{
+	const ImageServerFrameHeader header = FrameHeader( sequence, resolution, encoding, payload.GetSizeI() );
+
+	// A client that went away must not raise SIGPIPE
+	if ( send( socket, &header, sizeof( header ), MSG_NOSIGNAL ) != sizeof( header ) )
+	{
+		return false;
+	}
+	int written = 0;
+	while ( written < payload.GetSizeI() )
+	{
+		const int w = send( socket, payload.GetDataPtr() + written, payload.GetSizeI() - written, MSG_NOSIGNAL );
+		if ( w <= 0 )
+		{
+			LOG( "Only wrote %i of %i bytes to socket %i", written, payload.GetSizeI(), socket );
+			return false;
+		}
+		written += w;
+	}
+	return true;
+}
+
+// Called on the encoder thread while it owns the mapped PBO.
+void ImageServer::Encode( const PboSlot & slot, EncodedFrame & frame, void * tjHandle )
+{
+	const int numPixels = slot.Resolution * slot.Resolution;
+	const UInt16 * pixels = (const UInt16 *)slot.MappedAddress;
+
+	for ( int i = 0 ; i < IMAGE_ENCODING_MAX ; i++ )
+	{
+		frame.Payload[i].Clear();
+	}
+
+	if ( frame.EncodingMask & ( 1 << IMAGE_ENCODING_RAW_565 ) )
+	{
+		Array< unsigned char > & raw = frame.Payload[IMAGE_ENCODING_RAW_565];
+		raw.Resize( numPixels * 2 );
+		memcpy( raw.GetDataPtr(), pixels, numPixels * 2 );
+	}
+
+	if ( frame.EncodingMask & ( 1 << IMAGE_ENCODING_RLE_565 ) )
+	{
+		Array< unsigned char > & rle = frame.Payload[IMAGE_ENCODING_RLE_565];
+		rle.Resize( ( numPixels + numPixels / 0x7FFF + 1 ) * 2 );
+		const int count = EncodeRle565( pixels, numPixels, (UInt16 *)rle.GetDataPtr() );
+		rle.Resize( count * 2 );
+	}
+
+	if ( frame.EncodingMask & ( 1 << IMAGE_ENCODING_JPEG ) )
+	{
+		if ( !EncodeJpeg565( pixels, slot.Resolution, tjHandle, frame.Payload[IMAGE_ENCODING_JPEG] ) )
+		{
+			frame.EncodingMask &= ~( 1 << IMAGE_ENCODING_JPEG );
+		}
+	}
+}
+
+bool ImageServer::EncodeJpeg565( const UInt16 * pixels, const int resolution, void * tjHandle, Array< unsigned char > & jpeg )
+{
+	jpeg.Clear();
+	if ( tjHandle == NULL )
+	{
+		return false;
+	}
+
+	// TurboJPEG doesn't take 565, so expand to RGBX first
+	const int numPixels = resolution * resolution;
+	Array< unsigned char > rgbx;
+	rgbx.Resize( numPixels * 4 );
+	unsigned char * dst = rgbx.GetDataPtr();
+	for ( int i = 0 ; i < numPixels ; i++ )
+	{
+		const UInt16 p = pixels[i];
+		const int r = ( p >> 11 ) & 31;
+		const int g = ( p >> 5 ) & 63;
+		const int b = p & 31;
+		dst[i*4+0] = (unsigned char)( ( r << 3 ) | ( r >> 2 ) );
+		dst[i*4+1] = (unsigned char)( ( g << 2 ) | ( g >> 4 ) );
+		dst[i*4+2] = (unsigned char)( ( b << 3 ) | ( b >> 2 ) );
+		dst[i*4+3] = 255;
+	}
+
+	jpeg.Resize( tjBufSize( resolution, resolution, TJSAMP_420 ) );
+	unsigned char * jpegBuf = jpeg.GetDataPtr();
+	unsigned long jpegSize = jpeg.GetSize();
+	const int r = tjCompress2( (tjhandle)tjHandle, rgbx.GetDataPtr(),
+			resolution, resolution * 4, resolution, TJPF_RGBX, &jpegBuf,
+			&jpegSize, TJSAMP_420, 80 /* jpegQual */, TJFLAG_BOTTOMUP | TJFLAG_NOREALLOC | TJFLAG_FASTDCT );
+	if ( r != 0 )
+	{
+		LOG( "tjCompress2 returned %s", tjGetErrorStr() );
+		jpeg.Clear();
+		return false;
+	}
+	jpeg.Resize( jpegSize );
+	return true;
+}
+
+void ImageServer::EncoderThread()
+{
+	tjhandle tj = tjInitCompress();
+	StatStartTime = ovr_GetTimeInSeconds();
+
+	for ( ; ; )
+	{
+		pthread_mutex_lock( &EncodeMutex );
+		while ( EncodeQueue.GetSizeI() == 0 && !EncoderShutdown )
+		{
+			pthread_cond_wait( &EncodeCondition, &EncodeMutex );
+		}
+		if ( EncoderShutdown )
+		{
+			pthread_mutex_unlock( &EncodeMutex );
+			break;
+		}
+		const int slotIndex = EncodeQueue[0];
+		EncodeQueue.RemoveAt( 0 );
+		const int wantedEncodings = WantedEncodings;
+		pthread_mutex_unlock( &EncodeMutex );
+
+		PboSlot & slot = Pbos[slotIndex];
+
+		pthread_mutex_lock( &FrameMutex );
+		EncodedFrame * frame = SpareFrame;
+		SpareFrame = NULL;
+		pthread_mutex_unlock( &FrameMutex );
+		if ( frame == NULL )
+		{
+			frame = new EncodedFrame;
+		}
+
+		frame->Sequence = slot.CaptureSequence;
+		frame->RequestSequence = slot.RequestSequence;
+		frame->Resolution = slot.Resolution;
+		frame->EncodingMask = wantedEncodings;
+
+		const double encodeStart = ovr_GetTimeInSeconds();
+		Encode( slot, *frame, tj );
+		const double encodeEnd = ovr_GetTimeInSeconds();
+
+		StatFramesSkipped += slot.SkippedCaptures;
+
+		// hand the PBO back to TimeWarp for unmapping
+		pthread_mutex_lock( &EncodeMutex );
+		slot.State = PBO_RELEASED;
+		pthread_mutex_unlock( &EncodeMutex );
+
+		StatFramesEncoded++;
+		StatEncodeSeconds += encodeEnd - encodeStart;
+		for ( int i = 0 ; i < IMAGE_ENCODING_MAX ; i++ )
+		{
+			StatBytesEncoded[i] += frame->Payload[i].GetSize();
+		}
+
+		PostEncodedFrame( frame );
+
+		if ( encodeEnd - StatStartTime > STATS_LOG_SECONDS )
+		{
+			const double seconds = encodeEnd - StatStartTime;
+			LOG( "ImageServer: %.1f fps encoded, %.2f ms per encode, %i skipped (no free PBO), %i unsent",
+					StatFramesEncoded / seconds, StatEncodeSeconds * 1000.0 / Alg::Max( StatFramesEncoded, 1 ),
+					StatFramesSkipped, StatFramesUnsent );
+			for ( int i = 0 ; i < IMAGE_ENCODING_MAX ; i++ )
+			{
+				if ( StatBytesEncoded[i] > 0.0 )
+				{
+					LOG( "ImageServer: %s %.1f KB/s, %.1f KB per frame", ImageEncodingNames[i],
+							StatBytesEncoded[i] / ( 1024.0 * seconds ),
+							StatBytesEncoded[i] / ( 1024.0 * Alg::Max( StatFramesEncoded, 1 ) ) );
+				}
+				StatBytesEncoded[i] = 0.0;
+			}
+			StatFramesEncoded = 0;
+			StatFramesSkipped = 0;
+			StatFramesUnsent = 0;
+			StatEncodeSeconds = 0.0;
+			StatStartTime = encodeEnd;
+		}
+	}
+
+	tjDestroy( tj );
+}
+
+void ImageServer::PostEncodedFrame( EncodedFrame * frame )
+{
+	// If the server thread hasn't picked up the previous frame yet, the
+	// clients are behind and it is dropped in favor of this one.
+	pthread_mutex_lock( &FrameMutex );
+	if ( ReadyFrame != NULL )
+	{
+		StatFramesUnsent++;
+		if ( SpareFrame == NULL )
+		{
+			SpareFrame = ReadyFrame;
+		}
+		else
+		{
+			delete ReadyFrame;
+		}
+	}
+	ReadyFrame = frame;
+	pthread_mutex_unlock( &FrameMutex );
+
+	char	data = 0;
+	write( WakeSockets[1], &data, 1 );
+}
+
+void ImageServer::QueueToClient( Client & client, const void * data, const int bytes )
+{
+	const int start = client.Outgoing.GetSizeI();
+	client.Outgoing.Resize( start + bytes );
+	memcpy( client.Outgoing.GetDataPtr() + start, data, bytes );
+}
+
+void ImageServer::QueueStreamFrame( Client & client, const EncodedFrame & frame )
+{
+	const Array< unsigned char > & payload = frame.Payload[client.Encoding];
+	const ImageServerFrameHeader header = FrameHeader( frame.Sequence, frame.Resolution,
+			client.Encoding, payload.GetSizeI() );
+	QueueToClient( client, &header, sizeof( header ) );
+	QueueToClient( client, payload.GetDataPtr(), payload.GetSizeI() );
+}
+
+bool ImageServer::FlushClient( Client & client )
+{
+	while ( client.OutgoingSent < client.Outgoing.GetSizeI() )
+	{
+		// A client that went away must not raise SIGPIPE
+		const int w = send( client.Socket, client.Outgoing.GetDataPtr() + client.OutgoingSent,
+				client.Outgoing.GetSizeI() - client.OutgoingSent, MSG_NOSIGNAL );
+		if ( w < 0 )
+		{
+			if ( errno == EINTR )
+			{
+				continue;
+			}
+			if ( errno == EAGAIN || errno == EWOULDBLOCK )
+			{
+				return true;	// the rest goes when poll says the socket is writable
+			}
+			LOG( "Only wrote %i of %i bytes to client %i: %s", client.OutgoingSent,
+					client.Outgoing.GetSizeI(), client.Socket, strerror( errno ) );
+			return false;
+		}
+		client.OutgoingSent += w;
+	}
+	client.Outgoing.Resize( 0 );
+	client.OutgoingSent = 0;
+	return true;
+}
+
+void ImageServer::CloseClient( const int index )
+{
+	const Client & client = Clients[index];
+	LOG( "Closing client %i, %i frames sent, %i dropped while it was behind",
+			client.Socket, client.FramesSent, client.FramesDropped );
+	close( client.Socket );
+	Clients.RemoveAt( index );
+}
+
+void ImageServer::HandleClientCommand( Client & client, const char * command )
+{
+	if ( strncmp( command, "stream", 6 ) == 0 )
+	{
+		int resolution = 0;
+		float fps = 0.0f;
+		char encodingName[32] = {};
+		if ( sscanf( command, "stream %i %f %31s", &resolution, &fps, encodingName ) < 2 )
+		{
+			LOG( "Bad stream request: %s", command );
+			client.Resolution = -1;
+			return;
+		}
+		int encoding = IMAGE_ENCODING_RAW_565;
+		for ( int i = 0 ; i < IMAGE_ENCODING_MAX ; i++ )
+		{
+			if ( strcmp( encodingName, ImageEncodingNames[i] ) == 0 )
+			{
+				encoding = i;
+			}
+		}
+		client.Resolution = resolution;
+		client.Streaming = true;
+		client.Encoding = encoding;
+		client.StreamInterval = 1.0 / Alg::Clamp( fps, 1.0f, 60.0f );
+		client.NextSendTime = 0.0;
+		LOG( "Client %i streaming %i res at %.1f fps as %s", client.Socket, resolution,
+				1.0 / client.StreamInterval, ImageEncodingNames[encoding] );
+		return;
+	}
+
+	if ( strncmp( command, "stop", 4 ) == 0 )
+	{
+		client.Streaming = false;
+		return;
+	}
+
+	// a bare resolution is a request for a single raw frame
+	client.Resolution = atoi( command );
+	const ImageServerRequest prev = Request.GetState();
+	client.RequestSequence = prev.Sequence + 1;
+}
+
+// Sets the capture request TimeWarp sees from what the clients are waiting for.
+void ImageServer::UpdateCaptureRequest()
+{
+	const ImageServerRequest prev = Request.GetState();
+
+	ImageServerRequest	isr;
+	isr.Sequence = prev.Sequence;
+	isr.Resolution = 0;
+	isr.StreamInterval = 0.0;
+
+	int wantedEncodings = 0;
+	for ( int i = 0 ; i < Clients.GetSizeI() ; i++ )
+	{
+		const Client & client = Clients[i];
+		if ( client.Streaming )
+		{
+			wantedEncodings |= 1 << client.Encoding;
+			if ( isr.StreamInterval == 0.0 || client.StreamInterval < isr.StreamInterval )
+			{
+				isr.StreamInterval = client.StreamInterval;
+			}
+			isr.Resolution = Alg::Max( isr.Resolution, client.Resolution );
+		}
+	}
+	// single frame requests get their own resolution, ahead of the streams
+	for ( int i = 0 ; i < Clients.GetSizeI() ; i++ )
+	{
+		const Client & client = Clients[i];
+		if ( client.RequestSequence > 0 )
+		{
+			wantedEncodings |= 1 << IMAGE_ENCODING_RAW_565;
+			isr.Resolution = client.Resolution;
+			isr.Sequence = Alg::Max( isr.Sequence, client.RequestSequence );
+		}
+	}
+
+	pthread_mutex_lock( &EncodeMutex );
+	WantedEncodings = wantedEncodings;
+	pthread_mutex_unlock( &EncodeMutex );
+
+	if ( isr.Resolution == 0 )
+	{
+		// nobody is waiting, keep the last resolution so nothing is reallocated
+		isr.Resolution = prev.Resolution;
+	}
+	if ( isr.Sequence != prev.Sequence || isr.Resolution != prev.Resolution ||
+			isr.StreamInterval != prev.StreamInterval )
+	{
+		// TimeWarp will notice this on the next frame and start a capture.
+		Request.SetState( isr );
+	}
+}
+
+void ImageServer::SendFrame( const EncodedFrame & frame )
+{
+	const double now = ovr_GetTimeInSeconds();
+
+	for ( int i = Clients.GetSizeI() - 1 ; i >= 0 ; i-- )
+	{
+		Client & client = Clients[i];
+
+		// Allow a little jitter so a client asking for the capture rate gets every frame
+		const bool streamDue = client.Streaming && now >= client.NextSendTime - client.StreamInterval * 0.25
+				&& ( frame.EncodingMask & ( 1 << client.Encoding ) );
+
+		// A client that is still taking the previous frame skips this one, so a
+		// slow client loses frames instead of holding up the others. A single
+		// frame request waits for a later frame.
+		if ( client.OutgoingSent < client.Outgoing.GetSizeI() )
+		{
+			if ( streamDue )
+			{
+				client.FramesDropped++;
+			}
+			continue;
+		}
+
+		if ( client.RequestSequence > 0 && frame.RequestSequence >= client.RequestSequence
+				&& frame.Resolution == client.Resolution
+				&& ( frame.EncodingMask & ( 1 << IMAGE_ENCODING_RAW_565 ) ) )
+		{
+			const Array< unsigned char > & raw = frame.Payload[IMAGE_ENCODING_RAW_565];
+			QueueToClient( client, raw.GetDataPtr(), raw.GetSizeI() );
+			client.RequestSequence = 0;
+		}
+
+		if ( streamDue )
+		{
+			QueueStreamFrame( client, frame );
+			client.FramesSent++;
+			client.NextSendTime = Alg::Max( client.NextSendTime + client.StreamInterval, now );
+		}
+
+		if ( !FlushClient( client ) )
+		{
+			CloseClient( i );
+		}
+	}
+}
 
 void ImageServer::ServerThread()
 {
@@ -202,9 +774,6 @@ void ImageServer::ServerThread()
 	// Listen for a new client attachment.
 	int					TcpAcceptSocket = 0;
 
-	// Listen for image resolution requests and send back raw data.
-	int					TcpClientSocket = 0;
-
 	// Send / receive a shutdown request
 	int		shutdownSockets[2] = {};
 	const int spr = socketpair( AF_LOCAL, SOCK_SEQPACKET, 0, shutdownSockets );
@@ -218,10 +787,16 @@ void ImageServer::ServerThread()
 	// signal that we have started and created our shutdown socket
 	pthread_cond_signal( &StartStopCondition );
 
-	// block on the set of UDP port, TCP port, and command port
-	struct pollfd pollfds[4];
-	pollfds[0].fd = shutdownSockets[0];
-	pollfds[0].events = POLLIN;
+	// block on the set of command port, frame ready port, UDP port,
+	// TCP port, and all the clients
+	static const int POLL_SHUTDOWN = 0;
+	static const int POLL_WAKE = 1;
+	static const int POLL_ACCEPT = 2;
+	static const int POLL_UDP = 3;
+	static const int POLL_CLIENTS = 4;
+	struct pollfd pollfds[POLL_CLIENTS + MAX_CLIENTS];
+	pollfds[POLL_SHUTDOWN].fd = shutdownSockets[0];
+	pollfds[POLL_SHUTDOWN].events = POLLIN;
 
 	// Open a TCP socket for accepting new clients.  Because the image server
 	// gets stopped and started with each enter / leave VR, the port may
@@ -248,16 +823,23 @@ void ImageServer::ServerThread()
 		}
 	}
 
-	if ( -1 == listen( TcpAcceptSocket, 1 ) )
+	if ( -1 == listen( TcpAcceptSocket, MAX_CLIENTS ) )
 	{
 		FAIL( "listen: %s", strerror( errno ) );
 	}
 
+	pthread_mutex_lock( &StartStopMutex );
+	AcceptPort = acceptSocketPort;
+	pthread_mutex_unlock( &StartStopMutex );
+
 	// UDP sockets should always close immediately, but if another
 	// app is in the process of crashing, it may still hold the port
 	// open, so try once a second to open it.
-	UdpSocket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
-	for ( ; ; )
+	if ( Discoverable )
+	{
+		UdpSocket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	}
+	for ( ; Discoverable ; )
 	{
 		LOG( "Trying to bind UdpSocket");
 		int r = BindToPort( UdpSocket, IMAGE_SERVER_PORT );
@@ -278,46 +860,85 @@ void ImageServer::ServerThread()
 
     while( 1 )
     {
+		pollfds[POLL_WAKE].fd = WakeSockets[0];
+		pollfds[POLL_WAKE].events = POLLIN;
+		pollfds[POLL_ACCEPT].fd = ( Clients.GetSizeI() < MAX_CLIENTS ) ? TcpAcceptSocket : -1;
+		pollfds[POLL_ACCEPT].events = POLLIN;
+		pollfds[POLL_UDP].fd = ( UdpSocket > 0 ) ? UdpSocket : -1;
+		pollfds[POLL_UDP].events = POLLIN;
+		const int numClients = Clients.GetSizeI();
+		for ( int i = 0 ; i < numClients ; i++ )
+		{
+			const Client & client = Clients[i];
+			pollfds[POLL_CLIENTS + i].fd = client.Socket;
+			pollfds[POLL_CLIENTS + i].events = ( client.OutgoingSent < client.Outgoing.GetSizeI() ) ? POLLIN | POLLOUT : POLLIN;
+		}
+		for ( int i = 0 ; i < POLL_CLIENTS + numClients ; i++ )
+		{
+			pollfds[i].revents = 0;
+		}
+    	poll( pollfds, POLL_CLIENTS + numClients, 1000);
 
-    	if ( TcpClientSocket > 0 )
-    	{
-        	// If we are already connected to a client, we are only listening on that
-        	// port plus our shutdown request
-    		pollfds[1].fd = TcpClientSocket;
-    		pollfds[1].events = POLLIN;
-    		pollfds[2].fd = -1;
-    		pollfds[3].fd = -1;
-    	}
-    	else
-    	{
-    		pollfds[1].fd = -1;
-    		pollfds[2].fd = TcpAcceptSocket;
-    		pollfds[2].events = POLLIN;
-    		pollfds[3].fd = UdpSocket;
-    		pollfds[3].events = POLLIN;
-    	}
-
-    	pollfds[0].revents = 0;
-    	pollfds[1].revents = 0;
-    	pollfds[2].revents = 0;
-    	pollfds[3].revents = 0;
-    	poll( pollfds, 4, 1000);
-
-		if ( pollfds[0].revents & POLLIN )	// Shutdown request
+		if ( pollfds[POLL_SHUTDOWN].revents & POLLIN )	// Shutdown request
 		{
 			LOG( "ShutdownRequest received" );
 			break;
 		}
 
-		if (  pollfds[2].revents & POLLIN )	// TcpAcceptSocket
+		if ( pollfds[POLL_WAKE].revents & POLLIN )	// a frame has been encoded
 		{
-			TcpClientSocket = accept(TcpAcceptSocket, NULL, NULL );
+			char	data[16];
+			read( WakeSockets[0], data, sizeof( data ) );
+
+			pthread_mutex_lock( &FrameMutex );
+			EncodedFrame * frame = ReadyFrame;
+			ReadyFrame = NULL;
+			pthread_mutex_unlock( &FrameMutex );
+
+			if ( frame != NULL )
+			{
+				SendFrame( *frame );
+
+				pthread_mutex_lock( &FrameMutex );
+				if ( SpareFrame == NULL )
+				{
+					SpareFrame = frame;
+					frame = NULL;
+				}
+				pthread_mutex_unlock( &FrameMutex );
+				delete frame;
+
+				UpdateCaptureRequest();
+			}
+			// Clients may have been closed, so the poll results are stale
+			continue;
+		}
 
-			LOG( "Accepted a TCP connection: %i", TcpClientSocket );
+		if (  pollfds[POLL_ACCEPT].revents & POLLIN )	// TcpAcceptSocket
+		{
+			Client client;
+			client.Socket = accept( TcpAcceptSocket, NULL, NULL );
+			client.Resolution = 0;
+			client.RequestSequence = 0;
+			client.Streaming = false;
+			client.Encoding = IMAGE_ENCODING_RAW_565;
+			client.StreamInterval = 0.0;
+			client.NextSendTime = 0.0;
+			client.OutgoingSent = 0;
+			client.FramesSent = 0;
+			client.FramesDropped = 0;
+
+			LOG( "Accepted a TCP connection: %i", client.Socket );
+			if ( client.Socket >= 0 )
+			{
+				// A stalled client must not hold up the others
+				fcntl( client.Socket, F_SETFL, fcntl( client.Socket, F_GETFL ) | O_NONBLOCK );
+				Clients.PushBack( client );
+			}
 			continue;
 		}
 
-		if (  pollfds[3].revents & POLLIN )	// UdpSocket
+		if (  pollfds[POLL_UDP].revents & POLLIN )	// UdpSocket
 		{
 			sockaddr_in		from;
 			int				fromAddrSize = sizeof( from );
@@ -353,65 +974,46 @@ void ImageServer::ServerThread()
 			continue;
 		}
 
-		if ( pollfds[1].revents & POLLIN )
+		for ( int i = numClients - 1 ; i >= 0 ; i-- )
 		{
-			char	data[128];
-			const int r = read( TcpClientSocket, data, sizeof( data ) - 1 );
-			if ( r <= 0 )
+			const short revents = pollfds[POLL_CLIENTS + i].revents;
+			Client & client = Clients[i];
+			if ( ( revents & POLLOUT ) && !FlushClient( client ) )
 			{
-				LOG( "Client read %i", r );
-				close( TcpClientSocket );
-				TcpClientSocket = 0;
+				CloseClient( i );
 				continue;
 			}
-			data[r] = 0;
-			ImageServerRequest	isr;
-
-			isr.Resolution = atoi( data );
-			if ( isr.Resolution < 64 || isr.Resolution > 2048 )
+			if ( !( revents & ( POLLIN | POLLHUP | POLLERR ) ) )
 			{
-				LOG( "Rejecting resolution request: %s", data );
-				close( TcpClientSocket );
-				TcpClientSocket = 0;
 				continue;
 			}
 
-			const ImageServerRequest prev = Request.GetState();
-			isr.Sequence = prev.Sequence + 1;
-
-			// TimeWarp will notice this on the next frame and start a capture.
-			Request.SetState( isr );
-
-			// Block until we hear from TimeWarp
-			pthread_mutex_lock( &ResponseMutex );
-			pthread_cond_wait( &ResponseCondition, &ResponseMutex );
-			pthread_mutex_unlock( &ResponseMutex );
-			// Send the image data to the client.
-			const ImageServerResponse resp = Response.GetState();
-			if ( resp.Sequence == -1 )
+			char	data[128];
+			const int r = read( client.Socket, data, sizeof( data ) - 1 );
+			if ( r < 0 && ( errno == EAGAIN || errno == EINTR ) )
 			{
-				LOG( "Exiting due to resp.sequence == -1" );
-				break;
+				continue;
 			}
-			if ( resp.Resolution != isr.Resolution )
+			if ( r <= 0 )
 			{
-				// Not what they were expecting, so close the socket
-				LOG( "Response resolution %i != %i", resp.Resolution, isr.Resolution );
-				close( TcpClientSocket );
-				TcpClientSocket = 0;
+				LOG( "Client read %i", r );
+				CloseClient( i );
 				continue;
 			}
+			data[r] = 0;
 
-			const int bytes = resp.Resolution * resp.Resolution * 2;
-			const int w = write( TcpClientSocket, resp.Data, bytes );
-			if ( w != bytes )
+			HandleClientCommand( client, data );
+			if ( client.Streaming || client.RequestSequence > 0 )
 			{
-				LOG( "Only write %i of %i bytes", w, bytes );
-				close( TcpClientSocket );
-				TcpClientSocket = 0;
+				if ( client.Resolution < 64 || client.Resolution > 2048 )
+				{
+					LOG( "Rejecting resolution request: %s", data );
+					CloseClient( i );
+					continue;
+				}
 			}
-
 		}
+		UpdateCaptureRequest();
     }
 
 cleanup:
@@ -426,10 +1028,9 @@ cleanup:
 	    LOG( "Closing TcpAcceptSocket" );
 		close( TcpAcceptSocket );
 	}
-	if ( TcpClientSocket > 0 )
+	while ( Clients.GetSizeI() > 0 )
 	{
-	    LOG( "Closing TcpClientSocket" );
-		close( TcpClientSocket );
+		CloseClient( Clients.GetSizeI() - 1 );
 	}
 	for ( int i = 0 ; i < 2 ; i++ )
 	{
@@ -445,15 +1046,90 @@ cleanup:
 	pthread_cond_signal( &StartStopCondition );
 }
 
+// Called by TimeWarp.
+void	ImageServer::ReclaimPbos()
+{
+	for ( int i = 0 ; i < NUM_PBOS ; i++ )
+	{
+		PboSlot & slot = Pbos[i];
+		pthread_mutex_lock( &EncodeMutex );
+		const bool released = ( slot.State == PBO_RELEASED );
+		pthread_mutex_unlock( &EncodeMutex );
+		if ( !released )
+		{
+			continue;
+		}
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
+		glUnmapBuffer_( GL_PIXEL_PACK_BUFFER );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+		slot.MappedAddress = NULL;
+
+		pthread_mutex_lock( &EncodeMutex );
+		slot.State = PBO_FREE;
+		pthread_mutex_unlock( &EncodeMutex );
+	}
+}
+
 // Called by TimeWarp before adding the KHR sync object.
 void	ImageServer::EnterWarpSwap( int eyeTexture )
 {
-	ImageServerRequest	request = Request.GetState();
-	if ( request.Sequence <= SequenceCaptured )
+	ReclaimPbos();
+
+	const ImageServerRequest	request = Request.GetState();
+	const double now = ovr_GetTimeInSeconds();
+	const bool singleFrame = request.Sequence > SequenceCaptured;
+	const bool streamFrame = request.StreamInterval > 0.0 && now >= NextStreamCapture;
+	if ( !singleFrame && !streamFrame )
+	{
+		return;
+	}
+
+	// Only the warp thread moves a PBO out of PBO_FREE, so the states
+	// can be read without the lock here.
+	int freeSlot = -1;
+	bool allFree = true;
+	for ( int i = 0 ; i < NUM_PBOS ; i++ )
+	{
+		if ( Pbos[i].State == PBO_FREE )
+		{
+			if ( freeSlot == -1 )
+			{
+				freeSlot = i;
+			}
+		}
+		else
+		{
+			allFree = false;
+		}
+	}
+
+	// If resolution has changed, delete and reallocate the buffers once
+	// nothing is still reading into or encoding from them.
+	if ( request.Resolution != CurrentResolution )
 	{
+		if ( !allFree )
+		{
+			return;
+		}
+		CurrentResolution = request.Resolution;
+		FreeBuffers();
+	}
+
+	// Never wait on the encoder - skip this capture and try again next frame.
+	if ( freeSlot == -1 )
+	{
+		SkippedCaptures++;
 		return;
 	}
-	SequenceCaptured = request.Sequence;
+
+	if ( singleFrame )
+	{
+		SequenceCaptured = request.Sequence;
+	}
+	if ( streamFrame )
+	{
+		NextStreamCapture = Alg::Max( NextStreamCapture + request.StreamInterval, now );
+	}
 
 	// create GL objects if necessary
 	if ( !ResampleProg.program )
@@ -483,15 +1159,6 @@ void	ImageServer::EnterWarpSwap( int eyeTexture )
 		UnitSquare = BuildTesselatedQuad( 1, 1 );
 	}
 
-	// If resolution has changed, delete and reallocate the buffers
-	// These might still be in use, do we trust the driver or try to
-	// deal with it ourselves?
-	if ( request.Resolution != CurrentResolution )
-	{
-		CurrentResolution = request.Resolution;
-		FreeBuffers();
-	}
-
 	// Allocate any resources we need
 	if ( !ResampleRenderBuffer )
 	{
@@ -515,11 +1182,12 @@ void	ImageServer::EnterWarpSwap( int eyeTexture )
 		}
 	}
 
-	if ( !PixelBufferObject )
+	PboSlot & slot = Pbos[freeSlot];
+	if ( !slot.Buffer )
 	{
-		LOG( "Alloc PixelBufferObject" );
-		glGenBuffers( 1, &PixelBufferObject );
-		glBindBuffer( GL_PIXEL_PACK_BUFFER, PixelBufferObject );
+		LOG( "Alloc PixelBufferObject %i", freeSlot );
+		glGenBuffers( 1, &slot.Buffer );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
 		glBufferData( GL_PIXEL_PACK_BUFFER, CurrentResolution*CurrentResolution*2, NULL,
                 GL_DYNAMIC_READ );
 		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
@@ -537,73 +1205,551 @@ void	ImageServer::EnterWarpSwap( int eyeTexture )
 	UnitSquare.Draw();
 	glUseProgram( 0 );
 
-	// unmap the previous PBO mapping
-	if ( PboMappedAddress )
-	{
-		glBindBuffer( GL_PIXEL_PACK_BUFFER, PixelBufferObject );
-		glUnmapBuffer_( GL_PIXEL_PACK_BUFFER );
-		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
-		PboMappedAddress = NULL;
-	}
-
-	// Issue an async read into our PBO
-#if 1
-
-	glBindBuffer( GL_PIXEL_PACK_BUFFER, PixelBufferObject );
+	// Issue an async read into the PBO
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
 	glReadPixels( 0, 0, CurrentResolution, CurrentResolution, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 0 );
 	// back to normal memory read operations
 	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
 
-#else
-	GL_CheckErrors( "before read" );
-
-	static short	pixels[256*256];
-	glReadPixels( 0, 0, CurrentResolution, CurrentResolution, GL_RGB,
-			GL_UNSIGNED_SHORT_5_6_5, (GLvoid *)pixels );
-	ImageServerResponse	response;
-	response.Data = (void *)pixels;
-	response.Resolution = CurrentResolution;
-	response.Sequence = request.Sequence;
-	Response.SetState( response );
-#endif
 	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
 
 	GL_CheckErrors( "after read" );
 
-	CountdownToSend = 2;
+	slot.State = PBO_READING;
+	slot.CountdownToMap = 2;
+	slot.RequestSequence = request.Sequence;
+	slot.Resolution = CurrentResolution;
+	slot.SkippedCaptures = SkippedCaptures;
+	SkippedCaptures = 0;
 }
 
 // Called by TimeWarp after syncing to the previous frame's
 // sync object.
 void	ImageServer::LeaveWarpSwap()
 {
-	// we are only guaranteed the readback has completed on the second following frame
-	if ( CountdownToSend == 0 || --CountdownToSend != 0 )
+	for ( int i = 0 ; i < NUM_PBOS ; i++ )
 	{
-		return;
+		PboSlot & slot = Pbos[i];
+
+		// we are only guaranteed the readback has completed on the second following frame
+		if ( slot.State != PBO_READING || --slot.CountdownToMap != 0 )
+		{
+			continue;
+		}
+
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.Buffer );
+
+		slot.MappedAddress = glMapBufferRange_( GL_PIXEL_PACK_BUFFER, 0,
+				slot.Resolution*slot.Resolution*2, GL_MAP_READ_BIT );
+		if ( !slot.MappedAddress )
+		{
+			FAIL( "Couldn't map PBO" );
+		}
+
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+		// The encoder copies or compresses the mapped data on its own thread
+		slot.CaptureSequence = ++CaptureCount;
+		pthread_mutex_lock( &EncodeMutex );
+		slot.State = PBO_ENCODING;
+		EncodeQueue.PushBack( i );
+		pthread_cond_signal( &EncodeCondition );
+		pthread_mutex_unlock( &EncodeMutex );
 	}
+}
 
-	ImageServerRequest	request = Request.GetState();
+//=======================================================================================
+// ImageServerClient
+//=======================================================================================
 
-	glBindBuffer( GL_PIXEL_PACK_BUFFER, PixelBufferObject );
+ImageServerClient::ImageServerClient() :
+	Socket( -1 ),
+	TjHandle( NULL )
+{
+}
 
-	PboMappedAddress = glMapBufferRange_( GL_PIXEL_PACK_BUFFER, 0,
-			CurrentResolution*CurrentResolution*2, GL_MAP_READ_BIT );
-	if ( !PboMappedAddress )
+ImageServerClient::~ImageServerClient()
+{
+	Close();
+	if ( TjHandle != NULL )
 	{
-		FAIL( "Couldn't map PBO" );
+		tjDestroy( (tjhandle)TjHandle );
 	}
+}
 
-	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+bool ImageServerClient::Connect( const char * address, const int port )
+{
+	Close();
 
-	ImageServerResponse	response;
-	response.Data = (void *)PboMappedAddress;
-	response.Resolution = CurrentResolution;
-	response.Sequence = request.Sequence;
-	Response.SetState( response );
+	sockaddr_in server;
+	memset( &server, 0, sizeof( server ) );
+	server.sin_family = AF_INET;
+	server.sin_port = htons( port );
+	if ( inet_pton( AF_INET, address, &server.sin_addr ) != 1 )
+	{
+		LOG( "ImageServerClient: bad address %s", address );
+		return false;
+	}
 
-	pthread_cond_signal( &ResponseCondition );
+	const int sock = socket( AF_INET, SOCK_STREAM, 0 );
+	if ( sock == -1 )
+	{
+		LOG( "socket: %s", strerror( errno ) );
+		return false;
+	}
+	if ( connect( sock, (sockaddr *)&server, sizeof( server ) ) == -1 )
+	{
+		LOG( "connect: %s", strerror( errno ) );
+		close( sock );
+		return false;
+	}
+	Socket = sock;
+	return true;
 }
 
-}	// namespace OVR
+void ImageServerClient::Attach( const int socket )
+{
+	Close();
+	Socket = socket;
+}
+
+void ImageServerClient::Close()
+{
+	if ( Socket != -1 )
+	{
+		close( Socket );
+		Socket = -1;
+	}
+}
+
+bool ImageServerClient::SendCommand( const char * command )
+{
+	const int length = strlen( command );
+	return Socket != -1 && write( Socket, command, length ) == length;
+}
+
+bool ImageServerClient::StartStream( const int resolution, const float fps, const eImageServerEncoding encoding )
+{
+	char command[128];
+	snprintf( command, sizeof( command ), "stream %i %f %s", resolution, fps, ImageEncodingNames[encoding] );
+	return SendCommand( command );
+}
+
+bool ImageServerClient::StopStream()
+{
+	return SendCommand( "stop" );
+}
+
+void ImageServerClient::SetReadTimeout( const double seconds )
+{
+	struct timeval timeout;
+	timeout.tv_sec = (int)seconds;
+	timeout.tv_usec = (int)( ( seconds - timeout.tv_sec ) * 1e6 );
+	setsockopt( Socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+}
+
+bool ImageServerClient::ReadBytes( void * data, const int bytes )
+{
+	int got = 0;
+	while ( got < bytes )
+	{
+		const int r = read( Socket, (char *)data + got, bytes - got );
+		if ( r <= 0 )
+		{
+			return false;
+		}
+		got += r;
+	}
+	return true;
+}
+
+bool ImageServerClient::ReadFrame( ImageServerFrameHeader & header, Array< UInt16 > & pixels )
+{
+	if ( Socket == -1 || !ReadBytes( &header, sizeof( header ) ) )
+	{
+		return false;
+	}
+	header.Magic = ntohl( header.Magic );
+	header.Sequence = ntohl( header.Sequence );
+	header.Resolution = ntohl( header.Resolution );
+	header.Encoding = ntohl( header.Encoding );
+	header.PayloadBytes = ntohl( header.PayloadBytes );
+
+	// Nothing valid is bigger than an uncompressed RGBX frame.
+	static const UInt32 MAX_RESOLUTION = 4096;
+	if ( header.Magic != IMAGE_SERVER_FRAME_MAGIC || header.Resolution == 0 || header.Resolution > MAX_RESOLUTION
+			|| header.Encoding >= IMAGE_ENCODING_MAX || header.PayloadBytes > header.Resolution * header.Resolution * 4 )
+	{
+		LOG( "ImageServerClient: bad frame header" );
+		return false;
+	}
+
+	Payload.Resize( header.PayloadBytes );
+	if ( !ReadBytes( Payload.GetDataPtr(), Payload.GetSizeI() ) )
+	{
+		return false;
+	}
+
+	const int resolution = header.Resolution;
+	const int numPixels = resolution * resolution;
+	pixels.Resize( numPixels );
+
+	switch ( header.Encoding )
+	{
+		case IMAGE_ENCODING_RAW_565:
+		{
+			if ( Payload.GetSizeI() != numPixels * 2 )
+			{
+				LOG( "ImageServerClient: raw frame is %i bytes", Payload.GetSizeI() );
+				return false;
+			}
+			memcpy( pixels.GetDataPtr(), Payload.GetDataPtr(), numPixels * 2 );
+			return true;
+		}
+		case IMAGE_ENCODING_RLE_565:
+		{
+			if ( !ImageServer::DecodeRle565( (const UInt16 *)Payload.GetDataPtr(), Payload.GetSizeI() / 2,
+					pixels.GetDataPtr(), numPixels ) )
+			{
+				LOG( "ImageServerClient: malformed rle frame" );
+				return false;
+			}
+			return true;
+		}
+		case IMAGE_ENCODING_JPEG:
+		{
+			if ( TjHandle == NULL )
+			{
+				TjHandle = tjInitDecompress();
+			}
+			Rgbx.Resize( numPixels * 4 );
+			if ( TjHandle == NULL || tjDecompress2( (tjhandle)TjHandle, Payload.GetDataPtr(), Payload.GetSize(),
+					Rgbx.GetDataPtr(), resolution, resolution * 4, resolution, TJPF_RGBX, TJFLAG_BOTTOMUP ) != 0 )
+			{
+				LOG( "ImageServerClient: tjDecompress2 failed: %s", tjGetErrorStr() );
+				return false;
+			}
+			const unsigned char * src = Rgbx.GetDataPtr();
+			for ( int i = 0 ; i < numPixels ; i++ )
+			{
+				pixels[i] = (UInt16)( ( ( src[i*4+0] >> 3 ) << 11 ) | ( ( src[i*4+1] >> 2 ) << 5 ) | ( src[i*4+2] >> 3 ) );
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+//=======================================================================================
+// Loopback test and encoding benchmark
+//=======================================================================================
+
+// Flat areas, sharp edged bars like menus and text, a smooth gradient,
+// and a band of noise, bottom row first.
+static void SyntheticFrame( const int resolution, const int frame, Array< UInt16 > & pixels )
+{
+	pixels.Resize( resolution * resolution );
+	UInt32 random = 12345 + frame;
+	for ( int y = 0 ; y < resolution ; y++ )
+	{
+		for ( int x = 0 ; x < resolution ; x++ )
+		{
+			UInt16 p;
+			if ( y < resolution / 4 )
+			{
+				p = 0x2104;
+			}
+			else if ( y < resolution / 2 )
+			{
+				p = ( ( ( x + frame ) / 16 ) & 1 ) ? 0xFFFF : 0x001F;
+			}
+			else if ( y < resolution * 7 / 8 )
+			{
+				p = (UInt16)( ( ( x * 31 / resolution ) << 11 ) | ( ( y * 63 / resolution ) << 5 ) | ( frame & 31 ) );
+			}
+			else
+			{
+				random = random * 1664525 + 1013904223;
+				p = (UInt16)( random >> 16 );
+			}
+			pixels[y * resolution + x] = p;
+		}
+	}
+}
+
+// Average absolute difference of the 8 bit expansions of two 565 images.
+static double AverageError565( const Array< UInt16 > & a, const Array< UInt16 > & b )
+{
+	double total = 0.0;
+	for ( int i = 0 ; i < a.GetSizeI() ; i++ )
+	{
+		const int dr = abs( ( ( a[i] >> 11 ) & 31 ) - ( ( b[i] >> 11 ) & 31 ) ) * 8;
+		const int dg = abs( ( ( a[i] >> 5 ) & 63 ) - ( ( b[i] >> 5 ) & 63 ) ) * 4;
+		const int db = abs( ( a[i] & 31 ) - ( b[i] & 31 ) ) * 8;
+		total += dr + dg + db;
+	}
+	return total / ( 3.0 * Alg::Max( a.GetSizeI(), 1 ) );
+}
 
+struct LoopbackFrames
+{
+	int						Socket;
+	int						Resolution;
+	int						NumFrames;
+};
+
+static void * LoopbackSender( void * parm )
+{
+	const LoopbackFrames & frames = *(const LoopbackFrames *)parm;
+	tjhandle tj = tjInitCompress();
+	Array< UInt16 > pixels;
+	Array< unsigned char > payload[IMAGE_ENCODING_MAX];
+	bool sent = true;
+	for ( int frame = 0 ; frame < frames.NumFrames && sent ; frame++ )
+	{
+		SyntheticFrame( frames.Resolution, frame, pixels );
+
+		// The same frame in every encoding, in encoding order.
+		const int numPixels = frames.Resolution * frames.Resolution;
+		payload[IMAGE_ENCODING_RAW_565].Resize( numPixels * 2 );
+		memcpy( payload[IMAGE_ENCODING_RAW_565].GetDataPtr(), pixels.GetDataPtr(), numPixels * 2 );
+		payload[IMAGE_ENCODING_RLE_565].Resize( ( numPixels + numPixels / 0x7FFF + 1 ) * 2 );
+		const int count = ImageServer::EncodeRle565( pixels.GetDataPtr(), numPixels,
+				(UInt16 *)payload[IMAGE_ENCODING_RLE_565].GetDataPtr() );
+		payload[IMAGE_ENCODING_RLE_565].Resize( count * 2 );
+		ImageServer::EncodeJpeg565( pixels.GetDataPtr(), frames.Resolution, tj, payload[IMAGE_ENCODING_JPEG] );
+
+		for ( int e = 0 ; e < IMAGE_ENCODING_MAX && sent ; e++ )
+		{
+			sent = ImageServer::SendStreamFrame( frames.Socket, frame, frames.Resolution, e, payload[e] );
+		}
+	}
+	tjDestroy( tj );
+	return NULL;
+}
+
+bool ImageServer::TestLoopback()
+{
+	int sockets[2] = {};
+	if ( socketpair( AF_LOCAL, SOCK_STREAM, 0, sockets ) == -1 )
+	{
+		LOG( "ImageServer::TestLoopback: socketpair: %s", strerror( errno ) );
+		return false;
+	}
+
+	LoopbackFrames frames;
+	frames.Socket = sockets[0];
+	frames.Resolution = 256;
+	frames.NumFrames = 4;
+
+	// The sender needs its own thread, since a frame is bigger than the socket buffer.
+	pthread_t sender;
+	if ( pthread_create( &sender, NULL, &LoopbackSender, &frames ) != 0 )
+	{
+		close( sockets[0] );
+		close( sockets[1] );
+		return false;
+	}
+
+	ImageServerClient client;
+	client.Attach( sockets[1] );
+
+	bool ok = true;
+	Array< UInt16 > expected;
+	Array< UInt16 > pixels;
+	for ( int frame = 0 ; frame < frames.NumFrames && ok ; frame++ )
+	{
+		SyntheticFrame( frames.Resolution, frame, expected );
+		for ( int e = 0 ; e < IMAGE_ENCODING_MAX && ok ; e++ )
+		{
+			ImageServerFrameHeader header;
+			if ( !client.ReadFrame( header, pixels ) )
+			{
+				LOG( "ImageServer::TestLoopback: frame %i %s wasn't received", frame, ImageEncodingNames[e] );
+				ok = false;
+				break;
+			}
+			if ( header.Sequence != (UInt32)frame || header.Encoding != (UInt32)e
+					|| header.Resolution != (UInt32)frames.Resolution )
+			{
+				LOG( "ImageServer::TestLoopback: got frame %i %i, expected %i %i", header.Sequence, header.Encoding, frame, e );
+				ok = false;
+				break;
+			}
+			// JPEG is lossy, and the noise band doesn't compress well.
+			const double error = AverageError565( expected, pixels );
+			const double maxError = ( e == IMAGE_ENCODING_JPEG ) ? 16.0 : 0.0;
+			if ( error > maxError )
+			{
+				LOG( "ImageServer::TestLoopback: frame %i %s average error %.2f", frame, ImageEncodingNames[e], error );
+				ok = false;
+			}
+		}
+	}
+
+	// Closing our end makes the sender fail out if we stopped early.
+	client.Close();
+	pthread_join( sender, NULL );
+	close( sockets[0] );
+
+	if ( ok )
+	{
+		ok = TestServerClients();
+	}
+
+	LOG( "ImageServer::TestLoopback: %s", ok ? "passed" : "FAILED" );
+	return ok;
+}
+
+// Runs the server thread with a client that keeps up and one that never
+// reads until the end. The first must get every frame, the second must
+// get whole frames in order with the ones it was too slow for dropped.
+bool ImageServer::TestServerClients()
+{
+	static const int RESOLUTION = 512;
+	static const int NUM_FRAMES = 60;
+
+	ImageServer * server = new ImageServer( false );
+	int port = 0;
+	for ( int i = 0 ; i < 100 && port == 0 ; i++ )
+	{
+		pthread_mutex_lock( &server->StartStopMutex );
+		port = server->AcceptPort;
+		pthread_mutex_unlock( &server->StartStopMutex );
+		usleep( 10 * 1000 );
+	}
+
+	ImageServerClient fast;
+	ImageServerClient slow;
+	bool ok = port != 0
+			&& fast.Connect( "127.0.0.1", port ) && fast.StartStream( RESOLUTION, 60.0f, IMAGE_ENCODING_RAW_565 )
+			&& slow.Connect( "127.0.0.1", port ) && slow.StartStream( RESOLUTION, 60.0f, IMAGE_ENCODING_RAW_565 );
+	if ( !ok )
+	{
+		LOG( "ImageServer::TestServerClients: couldn't connect to port %i", port );
+	}
+	fast.SetReadTimeout( 1.0 );
+	slow.SetReadTimeout( 1.0 );
+
+	// Give the server thread time to see both stream requests.
+	usleep( 100 * 1000 );
+
+	Array< UInt16 > expected;
+	Array< UInt16 > pixels;
+	ImageServerFrameHeader header;
+	for ( int i = 0 ; i < NUM_FRAMES && ok ; i++ )
+	{
+		SyntheticFrame( RESOLUTION, i, expected );
+
+		EncodedFrame * frame = new EncodedFrame;
+		frame->Sequence = i;
+		frame->RequestSequence = 0;
+		frame->Resolution = RESOLUTION;
+		frame->EncodingMask = 1 << IMAGE_ENCODING_RAW_565;
+		frame->Payload[IMAGE_ENCODING_RAW_565].Resize( expected.GetSizeI() * 2 );
+		memcpy( frame->Payload[IMAGE_ENCODING_RAW_565].GetDataPtr(), expected.GetDataPtr(), expected.GetSizeI() * 2 );
+		server->PostEncodedFrame( frame );
+
+		if ( !fast.ReadFrame( header, pixels ) || header.Sequence != (UInt32)i
+				|| AverageError565( expected, pixels ) != 0.0 )
+		{
+			LOG( "ImageServer::TestServerClients: fast client didn't get frame %i intact", i );
+			ok = false;
+		}
+		// Stay under the requested rate, so no frame is skipped for being early.
+		usleep( 20 * 1000 );
+	}
+
+	int slowFrames = 0;
+	int lastSequence = -1;
+	while ( ok && slow.ReadFrame( header, pixels ) )
+	{
+		SyntheticFrame( RESOLUTION, header.Sequence, expected );
+		if ( (int)header.Sequence <= lastSequence || AverageError565( expected, pixels ) != 0.0 )
+		{
+			LOG( "ImageServer::TestServerClients: slow client got frame %i after %i, or damaged",
+					header.Sequence, lastSequence );
+			ok = false;
+		}
+		lastSequence = header.Sequence;
+		slowFrames++;
+	}
+	LOG( "ImageServer::TestServerClients: slow client got %i of %i frames", slowFrames, NUM_FRAMES );
+	if ( slowFrames == 0 || slowFrames >= NUM_FRAMES )
+	{
+		ok = false;
+	}
+
+	fast.Close();
+	slow.Close();
+	delete server;
+	return ok;
+}
+
+void ImageServer::BenchmarkEncodings()
+{
+	static const int NUM_ITERATIONS = 20;
+	static const int Resolutions[] = { 256, 512 };
+
+	tjhandle tj = tjInitCompress();
+	tjhandle tjd = tjInitDecompress();
+
+	for ( int r = 0 ; r < (int)( sizeof( Resolutions ) / sizeof( Resolutions[0] ) ) ; r++ )
+	{
+		const int resolution = Resolutions[r];
+		const int numPixels = resolution * resolution;
+
+		Array< UInt16 > pixels;
+		SyntheticFrame( resolution, 0, pixels );
+		Array< UInt16 > decoded;
+		decoded.Resize( numPixels );
+		Array< unsigned char > rgbx;
+		rgbx.Resize( numPixels * 4 );
+
+		Array< unsigned char > rle;
+		rle.Resize( ( numPixels + numPixels / 0x7FFF + 1 ) * 2 );
+		int rleCount = 0;
+		const double rleStart = ovr_GetTimeInSeconds();
+		for ( int i = 0 ; i < NUM_ITERATIONS ; i++ )
+		{
+			rleCount = EncodeRle565( pixels.GetDataPtr(), numPixels, (UInt16 *)rle.GetDataPtr() );
+		}
+		const double rleEncode = ovr_GetTimeInSeconds();
+		bool rleOk = true;
+		for ( int i = 0 ; i < NUM_ITERATIONS ; i++ )
+		{
+			rleOk &= DecodeRle565( (const UInt16 *)rle.GetDataPtr(), rleCount, decoded.GetDataPtr(), numPixels );
+		}
+		const double rleDecode = ovr_GetTimeInSeconds();
+		rleOk &= ( memcmp( decoded.GetDataPtr(), pixels.GetDataPtr(), numPixels * 2 ) == 0 );
+
+		Array< unsigned char > jpeg;
+		const double jpegStart = ovr_GetTimeInSeconds();
+		for ( int i = 0 ; i < NUM_ITERATIONS ; i++ )
+		{
+			EncodeJpeg565( pixels.GetDataPtr(), resolution, tj, jpeg );
+		}
+		const double jpegEncode = ovr_GetTimeInSeconds();
+		for ( int i = 0 ; i < NUM_ITERATIONS && jpeg.GetSizeI() > 0 ; i++ )
+		{
+			tjDecompress2( tjd, jpeg.GetDataPtr(), jpeg.GetSize(), rgbx.GetDataPtr(),
+					resolution, resolution * 4, resolution, TJPF_RGBX, TJFLAG_BOTTOMUP );
+		}
+		const double jpegDecode = ovr_GetTimeInSeconds();
+
+		const double rawBytes = numPixels * 2.0;
+		LOG( "ImageServer encodings at %i: raw %.0f KB", resolution, rawBytes / 1024.0 );
+		LOG( "  rle:  %.0f KB (%.1f:1), encode %.2f ms, decode %.2f ms%s", rleCount * 2 / 1024.0,
+				rawBytes / Alg::Max( rleCount * 2, 1 ),
+				( rleEncode - rleStart ) * 1000.0 / NUM_ITERATIONS, ( rleDecode - rleEncode ) * 1000.0 / NUM_ITERATIONS,
+				rleOk ? "" : ", ROUND TRIP FAILED" );
+		LOG( "  jpeg: %.0f KB (%.1f:1), encode %.2f ms, decode %.2f ms", jpeg.GetSize() / 1024.0,
+				rawBytes / Alg::Max( jpeg.GetSizeI(), 1 ),
+				( jpegEncode - jpegStart ) * 1000.0 / NUM_ITERATIONS, ( jpegDecode - jpegEncode ) * 1000.0 / NUM_ITERATIONS );
+	}
+
+	tjDestroy( tj );
+	tjDestroy( tjd );
+}
+
+}	// namespace OVR
@@ -15,6 +15,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #define OVR_ImageServer_h
 
 #include "Kernel/OVR_Lockless.h"
+#include "Kernel/OVR_Array.h"
 #include "GlUtils.h"
 #include "GlGeometry.h"
 #include "GlProgram.h"
@@ -22,30 +23,50 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 namespace OVR
 {
 
-class ImageServerRequest
+// A client that sends a bare resolution ("256") gets a single raw RGB565 frame
+// back, as before.
+//
+// A client that sends "stream <resolution> <fps> <raw|rle|jpeg>" gets every
+// captured frame at up to fps, each preceded by an ImageServerFrameHeader,
+// until it sends "stop" or disconnects.  Several clients can be streaming at
+// once; they all get the same captured frames, at whatever resolution was
+// captured, so the header must be checked.
+enum eImageServerEncoding
 {
-public:
-	ImageServerRequest() : Sequence( 0 ), Resolution( 0 ) {}
+	IMAGE_ENCODING_RAW_565,		// Resolution * Resolution RGB565 pixels, bottom row first
+	IMAGE_ENCODING_RLE_565,		// raw 565 run length encoded, see ImageServer::DecodeRle565()
+	IMAGE_ENCODING_JPEG,		// top row first
+	IMAGE_ENCODING_MAX
+};
 
-	int				Sequence;		// incremented each time
-	int				Resolution;
+static const UInt32 IMAGE_SERVER_FRAME_MAGIC = 0x4F564953;	// 'OVIS'
+
+// All fields are in network byte order.
+struct ImageServerFrameHeader
+{
+	UInt32	Magic;
+	UInt32	Sequence;			// incremented for each captured frame
+	UInt32	Resolution;
+	UInt32	Encoding;			// eImageServerEncoding
+	UInt32	PayloadBytes;		// following this header
 };
 
-class ImageServerResponse
+class ImageServerRequest
 {
 public:
-	ImageServerResponse() : Sequence( 0 ), Resolution( 0 ), Data( NULL ) {}
+	ImageServerRequest() : Sequence( 0 ), Resolution( 0 ), StreamInterval( 0.0 ) {}
 
-	int				Sequence;		// incremented each time
+	int				Sequence;		// incremented for each single frame request
 	int				Resolution;
-	const void *	Data;
+	double			StreamInterval;	// seconds between streamed captures, 0 = not streaming
 };
 
-
 class ImageServer
 {
 public:
-	ImageServer();
+	// A server that isn't discoverable doesn't answer on the UDP port, so
+	// a test can run one next to the real one.
+	ImageServer( const bool discoverable = true );
 	~ImageServer();
 
 	// Called by TimeWarp before adding the KHR sync object.
@@ -55,47 +76,204 @@ public:
 	// sync object.
 	void				LeaveWarpSwap();
 
+	// Returns the number of UInt16 written to dst, which must have room
+	// for count + count / 0x7FFF + 1 values.
+	static int			EncodeRle565( const UInt16 * src, const int count, UInt16 * dst );
+
+	// Returns false if src is malformed or doesn't decode to exactly dstCount pixels.
+	static bool			DecodeRle565( const UInt16 * src, const int srcCount, UInt16 * dst, const int dstCount );
+
+	// Returns false if the compression failed, tjHandle is from tjInitCompress().
+	static bool			EncodeJpeg565( const UInt16 * pixels, const int resolution, void * tjHandle,
+								Array< unsigned char > & jpeg );
+
+	// Writes an ImageServerFrameHeader and the payload to a connected socket.
+	static bool			SendStreamFrame( const int socket, const int sequence, const int resolution,
+								const int encoding, const Array< unsigned char > & payload );
+
+	// Encodes synthetic frames in every encoding, streams them over a local
+	// socket pair and checks that an ImageServerClient decodes them back.
+	// Then runs a server thread with two streaming clients, one of which
+	// stops reading, and checks that the other still gets every frame and
+	// the stalled one only has frames dropped. Doesn't need GL.
+	static bool			TestLoopback();
+
+	// Logs encode and decode rates and sizes of the encodings for synthetic frames.
+	static void			BenchmarkEncodings();
+
 private:
+	static const int	NUM_PBOS = 2;
+	static const int	MAX_CLIENTS = 8;
+
+	enum ePboState
+	{
+		PBO_FREE,			// available for the next capture
+		PBO_READING,		// glReadPixels issued, waiting for it to complete
+		PBO_ENCODING,		// mapped and owned by the encoder thread
+		PBO_RELEASED		// encoder is done, TimeWarp needs to unmap it
+	};
+
+	struct PboSlot
+	{
+		GLuint			Buffer;
+		void *			MappedAddress;
+		ePboState		State;
+		int				CountdownToMap;
+		int				CaptureSequence;
+		int				RequestSequence;
+		int				Resolution;
+		int				SkippedCaptures;	// captures skipped for lack of a free PBO before this one
+	};
+
+	// An encoded capture on its way from the encoder thread to the server thread.
+	struct EncodedFrame
+	{
+		int						Sequence;
+		int						RequestSequence;
+		int						Resolution;
+		int						EncodingMask;
+		Array< unsigned char >	Payload[IMAGE_ENCODING_MAX];
+	};
+
+	// Client sockets are non-blocking. A frame is queued in Outgoing and
+	// sent as the socket drains; frames that arrive while a client is still
+	// taking the previous one are dropped for that client.
+	struct Client
+	{
+		int				Socket;
+		int				Resolution;
+		int				RequestSequence;	// > 0 while waiting for a single frame
+		bool			Streaming;
+		int				Encoding;
+		double			StreamInterval;
+		double			NextSendTime;
+		Array< unsigned char, ArrayConstPolicy< 0, 4, true > >	Outgoing;	// never shrinks, so steady streaming doesn't allocate
+		int				OutgoingSent;
+		int				FramesSent;
+		int				FramesDropped;
+	};
 
 	static void *		ThreadStarter( void * parm );
 	void 				ServerThread();
+	static void *		EncoderThreadStarter( void * parm );
+	void				EncoderThread();
 	void				FreeBuffers();
 
+	// Unmaps the PBOs the encoder has finished with so they can be reused.
+	void				ReclaimPbos();
+
+	void				Encode( const PboSlot & slot, EncodedFrame & frame, void * tjHandle );
+
+	// Hands an encoded frame to the server thread, replacing one it hasn't picked up.
+	void				PostEncodedFrame( EncodedFrame * frame );
+
+	static bool			TestServerClients();
+
+	// Server thread
+	void				HandleClientCommand( Client & client, const char * command );
+	void				SendFrame( const EncodedFrame & frame );
+	void				UpdateCaptureRequest();
+	void				QueueToClient( Client & client, const void * data, const int bytes );
+	void				QueueStreamFrame( Client & client, const EncodedFrame & frame );
+	// Sends as much of Outgoing as the socket takes, returns false if the client is gone.
+	bool				FlushClient( Client & client );
+	void				CloseClient( const int index );
+
 	// When an image request arrives on the network socket,
 	// it will be placed in request so TimeWarp can notice it.
 	LocklessUpdater<ImageServerRequest>		Request;
 
-	// After TimeWarp has completed a resampling and asynchronous
-	// readback of an eye buffer, the results will be placed here.
-	// The data only remains valid until the next request is set.
-	LocklessUpdater<ImageServerResponse>	Response;
-
 	// Write anything on this to shutdown the server thread
 	int					ShutdownSocket;
 
+	const bool			Discoverable;
+
+	// The TCP port clients connect to, 0 until it is bound. Guarded by StartStopMutex.
+	int					AcceptPort;
+
+	// The encoder writes to WakeSockets[1] when ReadyFrame is set
+	int					WakeSockets[2];
+
 	// The eye texture is drawn to the ResampleRenderBuffer through
-	// the FrameBufferObject, then copied to the PixelBufferObject
+	// the FrameBufferObject, then copied to one of the Pbos.  Readback
+	// alternates between them so a capture never waits on the encoder.
 	int					CurrentResolution;
 	int					SequenceCaptured;
+	int					CaptureCount;
+	int					SkippedCaptures;
+	double				NextStreamCapture;
 	GlGeometry			UnitSquare;
 	GlProgram			ResampleProg;
 	GLuint				ResampleRenderBuffer;
 	GLuint				FrameBufferObject;
-	GLuint				PixelBufferObject;
-	void *				PboMappedAddress;
+	PboSlot				Pbos[NUM_PBOS];
 
     pthread_t			serverThread;		// posix pthread
-
-	pthread_mutex_t		ResponseMutex;
-	pthread_cond_t		ResponseCondition;
+    pthread_t			encoderThread;
 
 	pthread_mutex_t		StartStopMutex;
 	pthread_cond_t		StartStopCondition;
 
-	int					CountdownToSend;
+	// Guards Pbos[].State, EncodeQueue, EncoderShutdown and WantedEncodings
+	pthread_mutex_t		EncodeMutex;
+	pthread_cond_t		EncodeCondition;
+	Array< int >		EncodeQueue;		// indices of PBO_ENCODING Pbos
+	bool				EncoderShutdown;
+	int					WantedEncodings;	// bit mask of eImageServerEncoding
+
+	// Guards ReadyFrame and SpareFrame
+	pthread_mutex_t		FrameMutex;
+	EncodedFrame *		ReadyFrame;			// latest frame not yet sent
+	EncodedFrame *		SpareFrame;			// recycled so steady streaming doesn't allocate
+
+	// Server thread only
+	Array< Client >		Clients;
+
+	// Encoder thread only, logged periodically
+	int					StatFramesEncoded;
+	int					StatFramesSkipped;
+	int					StatFramesUnsent;
+	double				StatEncodeSeconds;
+	double				StatBytesEncoded[IMAGE_ENCODING_MAX];
+	double				StatStartTime;
+};
+
+// Receives the frames an ImageServer streams and decodes them, for viewers
+// and tools, and for testing the server without a device.
+class ImageServerClient
+{
+public:
+	ImageServerClient();
+	~ImageServerClient();
+
+	// Connects to the TCP port an image server replied with on the UDP port.
+	bool				Connect( const char * address, const int port );
+
+	// Uses an already connected socket, which is closed with the client.
+	void				Attach( const int socket );
+	void				Close();
+
+	bool				StartStream( const int resolution, const float fps, const eImageServerEncoding encoding );
+	bool				StopStream();
+
+	// Makes ReadFrame give up if the server sends nothing for this long.
+	void				SetReadTimeout( const double seconds );
+
+	// Blocks until the next streamed frame has arrived and decodes it to
+	// Resolution * Resolution RGB565 pixels, bottom row first. Returns
+	// false if the connection closed or the frame couldn't be decoded.
+	bool				ReadFrame( ImageServerFrameHeader & header, Array< UInt16 > & pixels );
+
+private:
+	bool				ReadBytes( void * data, const int bytes );
+	bool				SendCommand( const char * command );
+
+	int					Socket;
+	void *				TjHandle;		// created on the first JPEG frame
+	Array< unsigned char >	Payload;
+	Array< unsigned char >	Rgbx;
 };
 
 }
 
 #endif	// OVR_ImageServer_h
-
@@ -46,6 +46,14 @@ extern "C" {
 
 #define LOCAL_PREF_DEV_GPU_TIMINGS		"dev_gpuTimings"			// "0" or "1"
 
+// Start tracing frame timing as soon as VR mode is entered, instead of on the
+// first press of the debug key. The debug key still does the export.
+#define LOCAL_PREF_DEV_TRACE			"dev_trace"					// "0" or "1"
+
+// Run the built in self tests when VR mode is first entered, and with "2"
+// the benchmarks as well. The results are logged, see SelfTest.h.
+#define LOCAL_PREF_DEV_SELF_TESTS		"dev_selfTests"				// "0", "1" or "2"
+
 // Called on each resume, synchronously fetches the data.
 void	ovr_UpdateLocalPreferences();
 
@@ -47,9 +47,12 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include <sys/time.h>
 #include <sys/resource.h>
 
+#include "Kernel/OVR_Trace.h"
 #include "JniUtils.h"
 #include "TimeWarpLocal.h"
 #include "Vsync.h"
+#include "FramePacing.h"
+#include "WarpLayers.h"
 #include "VrCommon.h"
 #include "MemBuffer.h"
 #include "Distortion.h"
@@ -134,6 +137,25 @@ ovrMatrix4f TanAngleMatrixFromUnitSquare( const ovrMatrix4f & modelView )
 	return m;
 }
 
+// Convert the modelView matrix of a cylinder, cube or equirect layer into
+// the rotation from view space to the space of the layer.
+//
+// The rotation part of the modelView takes layer directions to view space,
+// so its transpose takes the tan angle vectors back.
+ovrMatrix4f TanAngleMatrixForLayer( const ovrMatrix4f & modelView )
+{
+	const OVR::Matrix4f mv( modelView );
+	OVR::Matrix4f m;
+	for ( int i = 0; i < 3; i++ )
+	{
+		const OVR::Vector3f axis = OVR::Vector3f( mv.M[0][i], mv.M[1][i], mv.M[2][i] ).Normalized();
+		m.M[i][0] = axis.x;
+		m.M[i][1] = axis.y;
+		m.M[i][2] = axis.z;
+	}
+	return m;
+}
+
 ovrMatrix4f	CalculateExternalVelocity( const ovrMatrix4f & viewMatrix, const float yawRadiansPerSecond )
 {
 	if ( yawRadiansPerSecond == 0.0f )
@@ -534,6 +556,8 @@ void TimeWarpLocal::WarpThread()
 {
 	WarpThreadInit();
 
+	Trace::SetThreadName( "TimeWarp" );
+
 	// Signal the main thread to wake up and return.
 	pthread_mutex_lock( &swapMutex );
 	pthread_cond_signal( &swapIsLatched );
@@ -546,8 +570,8 @@ void TimeWarpLocal::WarpThread()
 	// Loop until we get a shutdown request
 	for ( double vsync = 0; ; vsync++ )
 	{
-		const double current = ceil( GetFractionalVsync() );
-		if ( abs( current - vsync ) > 2.0 )
+		const double current = NextWarpVsync( vsync, ceil( Clock->GetFractionalVsync() ) );
+		if ( current != vsync )
 		{
 			LOG( "Changing vsync from %f to %f", vsync, current );
 			vsync = current;
@@ -686,7 +710,10 @@ TimeWarpLocal::TimeWarpLocal( const TimeWarpInitParms initParms ) :
 	warpPrograms(),
 	blackTexture( 0 ),
 	loadingTexture( 0 ),
+	timingGraphStream( NULL ),
 	HasEXT_sRGB_write_control( false ),
+	MaxVaryingVectors( 8 ),
+	LastClampedLayerKey( 0 ),
 	NetImageServer( NULL ),
 	StartupTid( 0 ),
 	Jni( NULL ),
@@ -700,10 +727,12 @@ TimeWarpLocal::TimeWarpLocal( const TimeWarpInitParms initParms ) :
 	contextPriority( 0 ),
 	eyeLog(),
 	lastEyeLog( 0 ),
-	LogEyeWarpGpuTime(),
+	LogEyeWarpGpuTime( "EyeWarpGpuTime" ),
+	WarpGpuProfile( "Warp GPU" ),
 	warpThread( 0 ),
 	warpThreadTid( 0 ),
-	LastSwapVsyncCount( 0 )
+	LastSwapVsyncCount( 0 ),
+	Clock( &GetSystemVsyncClock() )
 {
 	// Code which auto-disable chromatic aberration expects
 	// the warpProgram list to be symmetric.
@@ -795,6 +824,9 @@ TimeWarpLocal::TimeWarpLocal( const TimeWarpInitParms initParms ) :
 	HasEXT_sRGB_write_control = ExtensionStringPresent( "GL_EXT_sRGB_write_control",
 			(const char *)glGetString( GL_EXTENSIONS ) );
 
+	// The generated layer programs need more varyings as layers are added.
+	glGetIntegerv( GL_MAX_VARYING_VECTORS, &MaxVaryingVectors );
+
 	// Start up the network image server if requested
 	if ( InitParms.EnableImageServer )
 	{
@@ -1026,7 +1058,55 @@ void TimeWarpLocal::SetWarpState( const warpSource_t & currentWarpSource ) const
 	GL_CheckErrors( "SetWarpState" );
 }
 
-void TimeWarpLocal::BindWarpProgram( const warpSource_t & currentWarpSource, const Matrix4f timeWarps[2][2], const int eye, const double vsyncBase ) const
+// The time warp for a layer, from the pose it was placed for to the predicted one.
+static Matrix4f LayerTimeWarp( const TimeWarpLayer & layer, const int eye, const Quatf & predicted, const Matrix4f & velocity )
+{
+	const TimeWarpImage & image = layer.Images[eye];
+	if ( layer.Flags & WARP_LAYER_FLAG_HEAD_LOCKED )
+	{
+		return Matrix4f( image.TexCoordsFromTanAngles );
+	}
+	return Matrix4f( image.TexCoordsFromTanAngles ) * CalculateTimeWarpMatrix2( image.Pose.Pose.Orientation, predicted ) * velocity;
+}
+
+// More combinations than this probably means an application is animating
+// its layer setup, so the oldest program is thrown away.
+static const int MAX_LAYER_WARP_PROGRAMS = 16;
+
+const LayerWarpProg & TimeWarpLocal::LayerProgramForKey( const int key )
+{
+	for ( int i = 0; i < layerWarpPrograms.GetSizeI(); i++ )
+	{
+		if ( layerWarpPrograms[i].Key == key )
+		{
+			return layerWarpPrograms[i];
+		}
+	}
+
+	if ( layerWarpPrograms.GetSizeI() >= MAX_LAYER_WARP_PROGRAMS )
+	{
+		DeleteProgram( layerWarpPrograms[0].Prog );
+		layerWarpPrograms.RemoveAt( 0 );
+	}
+
+	const double start = ovr_GetTimeInSeconds();
+	StringBuffer vertexSrc;
+	StringBuffer fragmentSrc;
+	GenerateWarpLayerProgram( key, vertexSrc, fragmentSrc );
+
+	LayerWarpProg lwp;
+	lwp.Key = key;
+	lwp.Prog = BuildProgram( vertexSrc.ToCStr(), fragmentSrc.ToCStr() );
+	lwp.LayerTexm = glGetUniformLocation( lwp.Prog.program, "LayerTexm" );
+	lwp.LayerScaleBias = glGetUniformLocation( lwp.Prog.program, "LayerScaleBias" );
+	layerWarpPrograms.PushBack( lwp );
+
+	LOG( "Built layer warp program 0x%x in %3.1f ms", key, ( ovr_GetTimeInSeconds() - start ) * 1000.0 );
+	return layerWarpPrograms.Back();
+}
+
+void TimeWarpLocal::BindWarpProgram( const warpSource_t & currentWarpSource, const Matrix4f timeWarps[2][2],
+		const Matrix4f layerWarps[TimeWarpParms::MAX_WARP_LAYERS][2], const int eye, const double vsyncBase )
 {
 	// TODO: bake this into the buffer objects
 	const Matrix4f landscapeOrientationMatrix(
@@ -1035,6 +1115,46 @@ void TimeWarpLocal::BindWarpProgram( const warpSource_t & currentWarpSource, con
 	            0.0f, 0.0f, 0.0f, 0.0f,
 	            0.0f, 0.0f, 0.0f, 1.0f );
 
+	// Layers replace the selected warp program with a generated one.
+	const TimeWarpLayer * layers[TimeWarpParms::MAX_WARP_LAYERS];
+	const int activeLayers = GetActiveWarpLayers( currentWarpSource.WarpParms, eye, layers );
+	const bool chromatic = ( currentWarpSource.WarpParms.WarpProgram >= WP_CHROMATIC ) &&
+			!currentWarpSource.disableChromaticCorrection;
+	const int fullKey = ( activeLayers > 0 ) ? WarpLayerProgramKey( layers, activeLayers, chromatic ) : 0;
+	const int key = ClampWarpLayerProgramKey( fullKey, MaxVaryingVectors );
+	if ( key != fullKey && fullKey != LastClampedLayerKey )
+	{
+		LOG( "Layer warp program 0x%x needs %i varyings, only %i available, using 0x%x",
+				fullKey, WarpLayerProgramVaryings( fullKey ), MaxVaryingVectors, key );
+		LastClampedLayerKey = fullKey;
+	}
+	if ( key != 0 )
+	{
+		const int numLayers = WarpLayerProgramNumLayers( key );
+		const LayerWarpProg & layerProg = LayerProgramForKey( key );
+		const GlProgram & prog = layerProg.Prog;
+		glUseProgram( prog.program );
+
+		glUniformMatrix4fv( prog.uMvp, 1, GL_FALSE, landscapeOrientationMatrix.Transposed().M[0] );
+		glUniformMatrix4fv( prog.uTexm, 1, GL_FALSE, timeWarps[0][0].Transposed().M[0] );
+		glUniformMatrix4fv( prog.uTexm2, 1, GL_FALSE, timeWarps[0][1].Transposed().M[0] );
+
+		Matrix4f layerTexms[TimeWarpParms::MAX_WARP_LAYERS * 2];
+		float layerScaleBias[TimeWarpParms::MAX_WARP_LAYERS][4];
+		for ( int i = 0; i < numLayers; i++ )
+		{
+			layerTexms[i * 2 + 0] = layerWarps[i][0].Transposed();
+			layerTexms[i * 2 + 1] = layerWarps[i][1].Transposed();
+			WarpLayerScaleBias( *layers[i], layerScaleBias[i] );
+		}
+		glUniformMatrix4fv( layerProg.LayerTexm, numLayers * 2, GL_FALSE, layerTexms[0].M[0] );
+		if ( layerProg.LayerScaleBias >= 0 )
+		{
+			glUniform4fv( layerProg.LayerScaleBias, numLayers, layerScaleBias[0] );
+		}
+		return;
+	}
+
 	// Select the warp program.
 	const WarpProg & warpProg = ProgramForParms( currentWarpSource.WarpParms, currentWarpSource.disableChromaticCorrection );
 	const GlProgram & prog = warpProg.Prog;
@@ -1058,7 +1178,7 @@ void TimeWarpLocal::BindWarpProgram( const warpSource_t & currentWarpSource, con
 	}
 	if ( warpProg.RotateScale > 0 )
 	{
-		const float angle = FramePointTimeInSeconds( vsyncBase ) * M_PI * LOADING_ICON_ROTATION;
+		const float angle = Clock->FramePointTimeInSeconds( vsyncBase ) * M_PI * LOADING_ICON_ROTATION;
 		const Vector4f RotateScale( sinf( angle ), cosf( angle ), LOADING_ICON_SCALE, 1.0f );
 		glUniform4fv( warpProg.RotateScale, 1, &RotateScale[0] );
 	}
@@ -1080,6 +1200,32 @@ static void BindEyeTextures( const warpSource_t & currentWarpSource, const Scree
 		}
 	}
 
+	// Layer i goes in Texture<i+1>, and the overlay image isn't used.
+	const TimeWarpLayer * layers[TimeWarpParms::MAX_WARP_LAYERS];
+	const int numLayers = GetActiveWarpLayers( currentWarpSource.WarpParms, eye, layers );
+	if ( numLayers > 0 )
+	{
+		for ( int i = 0; i < numLayers; i++ )
+		{
+			const GLenum target = ( layers[i]->Type == WARP_LAYER_CUBE ) ? GL_TEXTURE_CUBE_MAP :
+					( ( layers[i]->Flags & WARP_LAYER_FLAG_EXTERNAL_TEXTURE ) ? GL_TEXTURE_EXTERNAL_OES : GL_TEXTURE_2D );
+			glActiveTexture( GL_TEXTURE1 + i );
+			glBindTexture( target, layers[i]->Images[eye].TexId );
+			if ( HasEXT_sRGB_texture_decode )
+			{
+				if ( currentWarpSource.WarpParms.SwapOptions & SWAP_INHIBIT_SRGB_FRAMEBUFFER )
+				{
+					glTexParameteri( target, GL_TEXTURE_SRGB_DECODE_EXT, GL_SKIP_DECODE_EXT );
+				}
+				else
+				{
+					glTexParameteri( target, GL_TEXTURE_SRGB_DECODE_EXT, GL_DECODE_EXT );
+				}
+			}
+		}
+		return;
+	}
+
 	if ( currentWarpSource.WarpParms.WarpProgram == WP_MASKED_PLANE || currentWarpSource.WarpParms.WarpProgram == WP_CHROMATIC_MASKED_PLANE )
 	{
 		glActiveTexture( GL_TEXTURE1 );
@@ -1167,19 +1313,57 @@ static void BindEyeTextures( const warpSource_t & currentWarpSource, const Scree
 	}
 }
 
+// Polls the GPU fence of a buffer set for SelectWarpSource() without blocking.
+struct WarpSourceFenceStatus
+{
+	WarpSourceFenceStatus( const EGLDisplay display_, const int eye_, const bool skipBadPose_ ) :
+		display( display_ ),
+		eye( eye_ ),
+		skipBadPose( skipBadPose_ ) {}
+
+	WarpSourceStatus operator()( const warpSource_t & source ) const
+	{
+		if ( source.GpuSync == 0 )
+		{
+			LOG( "Eye buffer had 0 sync" );
+			return WARP_SOURCE_INVALID;
+		}
+
+		if ( Quatf( source.WarpParms.Images[eye][0].Pose.Pose.Orientation ).LengthSq() < 1e-18f )
+		{
+			LOG( "Bad Pose.Orientation!" );
+			return skipBadPose ? WARP_SOURCE_PENDING : WARP_SOURCE_INVALID;
+		}
+
+		const EGLint wait = eglClientWaitSyncKHR_( display, source.GpuSync,
+				EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 0 );
+		if ( wait == EGL_TIMEOUT_EXPIRED_KHR )
+		{
+			return WARP_SOURCE_PENDING;
+		}
+		if ( wait == EGL_FALSE )
+		{
+			LOG( "eglClientWaitSyncKHR returned EGL_FALSE" );
+		}
+		return WARP_SOURCE_READY;
+	}
+
+	EGLDisplay	display;
+	int			eye;
+	bool		skipBadPose;	// look at older buffer sets instead of giving up
+};
+
 static void UnbindEyeTextures()
 {
 	glActiveTexture( GL_TEXTURE0 );
 	glBindTexture( GL_TEXTURE_2D, 0 );
 
-	glActiveTexture( GL_TEXTURE1 );
-	glBindTexture( GL_TEXTURE_2D, 0 );
-	glBindTexture( GL_TEXTURE_EXTERNAL_OES, 0 );
-	glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
-
-	for ( int i = 1; i < 3; i++ )
+	// Layers and overlays can leave any target bound on Texture1 and up.
+	for ( int i = 0; i < TimeWarpParms::MAX_WARP_LAYERS; i++ )
 	{
 		glActiveTexture( GL_TEXTURE1 + i );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+		glBindTexture( GL_TEXTURE_EXTERNAL_OES, 0 );
 		glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
 	}
 }
@@ -1192,6 +1376,9 @@ static void UnbindEyeTextures()
  *
  * Wait for sync point, read sensor, Warp both eyes and returns the next vsyncBase
  *
+ * The sleeps and the latch are scheduled by WarpFrame() in FramePacing.h,
+ * which calls back LatchWarpSource() and WarpEye() or WarpSlice().
+ *
  * Calls GetFractionalVsync() multiple times, but this only calls kernel time functions, not java
  * Calls SleepUntilTimePoint() for each eye.
  * May write to the log
@@ -1204,7 +1391,7 @@ static void UnbindEyeTextures()
  *
  */
 void TimeWarpLocal::WarpToScreen(
-		const double 			vsyncBase_,
+		const double 			vsyncBase,
 		const swapProgram_t &	swap )
 {
 	static double lastReportTime = 0;
@@ -1212,523 +1399,391 @@ void TimeWarpLocal::WarpToScreen(
 	if ( timeNow > lastReportTime )
 	{
 		LOG( "Warp GPU time: %3.1f ms", LogEyeWarpGpuTime.GetTotalTime() );
+		if ( WarpSources[EyeBufferCount.GetState()%MAX_WARP_SOURCES].WarpParms.SwapOptions & SWAP_OPTION_USE_SLICED_WARP )
+		{
+			LogSliceScheduleStats( SliceSchedule.GetStats() );
+		}
 		lastReportTime = timeNow;
 	}
 
+	// Collect the GPU times of earlier warps that are complete.
+	WarpGpuProfile.EndFrame();
+
 	const warpSource_t & latestWarpSource = WarpSources[EyeBufferCount.GetState()%MAX_WARP_SOURCES];
 
-	// switch to sliced rendering
-	if ( latestWarpSource.WarpParms.SwapOptions & SWAP_OPTION_USE_SLICED_WARP )
+	WarpFrameSchedule schedule;
+	schedule.Sliced = ( latestWarpSource.WarpParms.SwapOptions & SWAP_OPTION_USE_SLICED_WARP ) != 0;
+	schedule.NumSlices = NUM_SLICES_PER_SCREEN;
+	// This must be long enough to cover CPU scheduling delays, GPU in-flight commands,
+	// and the actual drawing of a slice.
+	schedule.PreScheduleSeconds = latestWarpSource.WarpParms.PreScheduleSeconds;
+	schedule.AdaptiveSliceSchedule = ( latestWarpSource.WarpParms.SwapOptions & SWAP_OPTION_ADAPTIVE_SLICE_SCHEDULE ) != 0;
+	schedule.DeltaVsync[0] = swap.deltaVsync[0];
+	schedule.DeltaVsync[1] = swap.deltaVsync[1];
+
+	if ( !schedule.Sliced )
 	{
-		WarpToScreenSliced( vsyncBase_ );
-		return;
+		// Build new line verts if timing graph is enabled
+		UpdateTimingGraphVerts( latestWarpSource.WarpParms.DebugGraphMode, latestWarpSource.WarpParms.DebugGraphValue );
 	}
 
-	const double vsyncBase = vsyncBase_;
+	// The mesh covers the full screen, but we only draw part of it at a time
+	ScreenWarper warper( *this, swap, schedule.Sliced );
+	InitParms.Screen->GetScreenResolution( warper.ScreenWidth, warper.ScreenHeight );
+	glViewport( 0, 0, warper.ScreenWidth, warper.ScreenHeight );
+	glScissor( 0, 0, warper.ScreenWidth, warper.ScreenHeight );
 
-	// Build new line verts if timing graph is enabled
-	UpdateTimingGraphVerts( latestWarpSource.WarpParms.DebugGraphMode, latestWarpSource.WarpParms.DebugGraphValue );
+	WarpFrame( *Clock, SliceSchedule, schedule, vsyncBase, warper );
 
-	// This will only be updated in SCREENEYE_LEFT
-	warpSource_t currentWarpSource = {};
+	if ( InitParms.Screen->windowSurface == EGL_NO_SURFACE )
+	{
+		return;
+	}
 
-	// The mesh covers the full screen, but we only draw part of it at a time
-	int screenWidth, screenHeight;
-	InitParms.Screen->GetScreenResolution( screenWidth, screenHeight );
-	glViewport( 0, 0, screenWidth, screenHeight );
-	glScissor( 0, 0, screenWidth, screenHeight );
+	UnbindEyeTextures();
 
-	// Warp each eye to the display surface
-	for ( ScreenEye eye = SCREENEYE_LEFT; eye <= SCREENEYE_RIGHT; eye = (ScreenEye)((int)eye+1) )
-	{
-		//LOG( "Eye %i: now=%f  sleepTo=%f", eye, GetFractionalVsync(), vsyncBase + swap.deltaVsync[eye] );
+	glUseProgram( 0 );
 
-		// Sleep until we are in the correct half of the screen for
-		// rendering this eye.  If we are running single threaded,
-		// the first eye will probably already be past the sleep point,
-		// so only the second eye will be at a dependable time.
-		const double sleepTargetVsync = vsyncBase + swap.deltaVsync[eye];
-		const double sleepTargetTime = FramePointTimeInSeconds( sleepTargetVsync );
-		const float secondsToSleep = SleepUntilTimePoint( sleepTargetTime, false );
-		const double preFinish = TimeInSeconds();
+	glBindVertexArrayOES_( 0 );
 
-		//LOG( "Vsync %f:%i sleep %f", vsyncBase, eye, secondsToSleep );
+	if ( schedule.Sliced )
+	{
+		GL_Finish();
+	}
+	else if ( !InitParms.Screen->IsFrontBuffer() )
+	{
+		InitParms.Screen->SwapBuffers();
+	}
+}
 
-		// Check for availability of updated eye renderings
-		// now that we are about to render.
-		long long thisEyeBufferNum = 0;
-		int	back;
+TimeWarpLocal::ScreenWarper::ScreenWarper( TimeWarpLocal & tw, const swapProgram_t & swap, const bool sliced ) :
+	Tw( tw ),
+	Swap( swap ),
+	Sliced( sliced ),
+	ScreenWidth( 0 ),
+	ScreenHeight( 0 ),
+	CurrentWarpSource(),
+	ThisEyeBufferNum( 0 ),
+	Back( 0 )
+{
+}
 
-		if ( eye == SCREENEYE_LEFT )
+bool TimeWarpLocal::LatchWarpSource( ScreenWarper & warper, const WarpPointTiming & timing )
+{
+	const ScreenEye eye = SCREENEYE_LEFT;
+
+	// Sliced warps look at older buffer sets instead of giving up on a bad pose.
+	WarpSourceFenceStatus fenceStatus( eglDisplay, eye, warper.Sliced );
+	if ( SelectWarpSource( WarpSources, MAX_WARP_SOURCES, EyeBufferCount.GetState(), timing.VsyncBase, eye,
+			fenceStatus, warper.ThisEyeBufferNum, warper.Back ) )
+	{
+		warper.CurrentWarpSource = WarpSources[warper.ThisEyeBufferNum % MAX_WARP_SOURCES];
+	}
+	TraceInstant( TRACE_WARP, "Latch", warper.ThisEyeBufferNum, warper.Back );
+
+	// Save this sensor state for the next application rendering frame, and
+	// release the VR thread if it is blocking on a frame being completed.
+	// It is important that this always be done, even if we wind up
+	// not rendering anything because there are no current eye buffers.
+	{
+		SwapState	state;
+		state.VsyncCount = (long long)timing.VsyncBase;
+		state.EyeBufferCount = warper.ThisEyeBufferNum;
+		SwapVsync.SetState( state );
+		// Wake the VR thread up if it is blocked on us.
+		// If the other thread happened to be scheduled out right
+		// after locking the mutex, but before waiting on the condition,
+		// we would rather it sleep for another frame than potentially
+		// miss a raster point here in the time warp thread, so use
+		// a trylock() instead of a lock().
+		if ( !pthread_mutex_trylock( &swapMutex ) )
 		{
-			const long long latestEyeBufferNum = EyeBufferCount.GetState();
-			for ( back = 0; back < MAX_WARP_SOURCES - 1; back++ )
-			{
-				thisEyeBufferNum = latestEyeBufferNum - back;
-				if ( thisEyeBufferNum <= 0 )
-				{	// just starting, and we don't have any eye buffers to use
-					break;
-				}
-				warpSource_t & testWarpSource = WarpSources[thisEyeBufferNum % MAX_WARP_SOURCES];
-				if ( testWarpSource.MinimumVsync > vsyncBase )
-				{	// a full frame got completed in less time than a single eye; don't use it to avoid stuttering
-					continue;
-				}
-				if ( testWarpSource.GpuSync == 0 )
-				{
-					LOG( "thisEyeBufferNum %lli had 0 sync", thisEyeBufferNum );
-					break;
-				}
+			pthread_cond_signal( &swapIsLatched );
+			pthread_mutex_unlock( &swapMutex );
+		}
+	}
 
-				if ( Quatf( testWarpSource.WarpParms.Images[eye][0].Pose.Pose.Orientation ).LengthSq() < 1e-18f )
-				{
-					LOG( "Bad Pose.Orientation in bufferNum %lli!", thisEyeBufferNum );
-					break;
-				}
+	if ( InitParms.Screen->windowSurface == EGL_NO_SURFACE )
+	{
+		static int logCount = 0;
+		if ( ( logCount++ & 31 ) == 0 )
+		{
+			LOG( "WarpToScreen: no valid window surface" );
+		}
+		return false;
+	}
 
-				const EGLint wait = eglClientWaitSyncKHR_( eglDisplay, testWarpSource.GpuSync,
-						EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 0 );
-				if ( wait == EGL_TIMEOUT_EXPIRED_KHR )
-				{
-					continue;
-				}
-				if ( wait == EGL_FALSE )
-				{
-					LOG( "eglClientWaitSyncKHR returned EGL_FALSE" );
-				}
+	if ( warper.CurrentWarpSource.WarpParms.Images[eye][0].TexId == 0 )
+	{
+		LOG( "No valid eyeTexture %i", eye );
+		return false;
+	}
+	return true;
+}
 
-				// This buffer set is good to use
-				if ( testWarpSource.FirstDisplayedVsync[eye] == 0 )
-				{
-					testWarpSource.FirstDisplayedVsync[eye] = (long long)vsyncBase;
-				}
-				currentWarpSource = testWarpSource;
-				break;
-			}
+void TimeWarpLocal::WarpEye( ScreenWarper & warper, const ScreenEye eye, const WarpPointTiming & timing )
+{
+	const warpSource_t & currentWarpSource = warper.CurrentWarpSource;
+	const swapProgram_t & swap = warper.Swap;
+	const double vsyncBase = timing.VsyncBase;
+	const double preFinish = timing.WakeTime;
 
-			// Save this sensor state for the next application rendering frame.
-			// It is important that this always be done, even if we wind up
-			// not rendering anything because there are no current eye buffers.
-			{
-				SwapState	state;
-				state.VsyncCount = (long long)vsyncBase;
-				state.EyeBufferCount = thisEyeBufferNum;
-				SwapVsync.SetState( state );
-				// Wake the VR thread up if it is blocked on us.
-				// If the other thread happened to be scheduled out right
-				// after locking the mutex, but before waiting on the condition,
-				// we would rather it sleep for another frame than potentially
-				// miss a raster point here in the time warp thread, so use
-				// a trylock() instead of a lock().
-				if ( !pthread_mutex_trylock( &swapMutex ) )
-				{
-					pthread_cond_signal( &swapIsLatched );
-					pthread_mutex_unlock( &swapMutex );
-				}
-			}
+	const TraceScope traceEye( TRACE_WARP, "WarpEye", eye );
 
-			if ( InitParms.Screen->windowSurface == EGL_NO_SURFACE )
-			{
-				static int logCount = 0;
-				if ( ( logCount++ & 31 ) == 0 )
-				{
-					LOG( "WarpToScreen: no valid window surface" );
-				}
-				return;
-			}
+	//LOG( "Vsync %f:%i sleep %f", vsyncBase, eye, timing.SecondsToSleep );
 
-			if ( currentWarpSource.WarpParms.Images[eye][0].TexId == 0 )
-			{
-				// We don't have anything valid to draw, so just sleep until
-				// the next time point and check again.
-				LOG( "No valid eyeTexture %i", eye );
-				SleepUntilTimePoint( FramePointTimeInSeconds( sleepTargetVsync + 1.0f ), false );
-				break;
-			}
-		}
+	// Build up the external velocity transform
+	Matrix4f velocity;
+	const int velocitySteps = OVR::Alg::Min( 3, (int)((long long)vsyncBase - currentWarpSource.MinimumVsync) );
+	for ( int i = 0; i < velocitySteps; i++ )
+	{
+		velocity = velocity * currentWarpSource.WarpParms.ExternalVelocity;
+	}
 
-		// Build up the external velocity transform
-		Matrix4f velocity;
-		const int velocitySteps = OVR::Alg::Min( 3, (int)((long long)vsyncBase - currentWarpSource.MinimumVsync) );
-		for ( int i = 0; i < velocitySteps; i++ )
+	// If we have a second image layer, we will need to calculate
+	// a second set of time warps and use a different program.
+	const bool dualLayer = ( currentWarpSource.WarpParms.Images[eye][1].TexId > 0 );
+
+	// Calculate predicted poses for the start and end of this eye's
+	// raster scanout, so we can warp the best image we have to it.
+	//
+	// These prediction points will always be in the future, because we
+	// need time to do the drawing before the scanout starts.
+	//
+	// In a portrait scanned display, it is beneficial to have the time warp calculated
+	// independently for each eye, giving them the same latency profile.
+	Matrix4f timeWarps[2][2];
+
+	// Every layer has its own pose.
+	const TimeWarpLayer * layers[TimeWarpParms::MAX_WARP_LAYERS];
+	const int numLayers = GetActiveWarpLayers( currentWarpSource.WarpParms, eye, layers );
+	Matrix4f layerWarps[TimeWarpParms::MAX_WARP_LAYERS][2];
+
+	for ( int scan = 0; scan < 2; scan++ )
+	{
+		const double vsyncPoint = vsyncBase + swap.predictionPoints[eye][scan];
+		const double timePoint = Clock->FramePointTimeInSeconds( vsyncPoint );
+		const ovrSensorState sensor = ovrHmd_GetSensorState( InitParms.Hmd, timePoint, false);
+		const Matrix4f warp = CalculateTimeWarpMatrix2(
+									currentWarpSource.WarpParms.Images[eye][0].Pose.Pose.Orientation,
+									sensor.Predicted.Pose.Orientation ) * velocity;
+		timeWarps[0][scan] = Matrix4f( currentWarpSource.WarpParms.Images[eye][0].TexCoordsFromTanAngles ) * warp;
+		if ( dualLayer )
 		{
-			velocity = velocity * currentWarpSource.WarpParms.ExternalVelocity;
+			timeWarps[1][scan] = Matrix4f( currentWarpSource.WarpParms.Images[eye][1].TexCoordsFromTanAngles ) * warp;
 		}
-
-		// If we have a second image layer, we will need to calculate
-		// a second set of time warps and use a different program.
-		const bool dualLayer = ( currentWarpSource.WarpParms.Images[eye][1].TexId > 0 );
-
-		// Calculate predicted poses for the start and end of this eye's
-		// raster scanout, so we can warp the best image we have to it.
-		//
-		// These prediction points will always be in the future, because we
-		// need time to do the drawing before the scanout starts.
-		//
-		// In a portrait scanned display, it is beneficial to have the time warp calculated
-		// independently for each eye, giving them the same latency profile.
-		Matrix4f timeWarps[2][2];
-
-		for ( int scan = 0; scan < 2; scan++ )
+		for ( int i = 0; i < numLayers; i++ )
 		{
-			const double vsyncPoint = vsyncBase + swap.predictionPoints[eye][scan];
-			const double timePoint = FramePointTimeInSeconds( vsyncPoint );
-			const ovrSensorState sensor = ovrHmd_GetSensorState( InitParms.Hmd, timePoint, false);
-			const Matrix4f warp = CalculateTimeWarpMatrix2(
-										currentWarpSource.WarpParms.Images[eye][0].Pose.Pose.Orientation,
-										sensor.Predicted.Pose.Orientation ) * velocity;
-			timeWarps[0][scan] = Matrix4f( currentWarpSource.WarpParms.Images[eye][0].TexCoordsFromTanAngles ) * warp;
-			if ( dualLayer )
-			{
-				timeWarps[1][scan] = Matrix4f( currentWarpSource.WarpParms.Images[eye][1].TexCoordsFromTanAngles ) * warp;
-			}
+			layerWarps[i][scan] = LayerTimeWarp( *layers[i], eye, sensor.Predicted.Pose.Orientation, velocity );
 		}
+	}
 
-		//---------------------------------------------------------
-		// Warp a latched buffer to the screen
-		//---------------------------------------------------------
+	//---------------------------------------------------------
+	// Warp a latched buffer to the screen
+	//---------------------------------------------------------
 
-		LogEyeWarpGpuTime.Begin( eye );
-		LogEyeWarpGpuTime.PrintTime( eye, "GPU time for eye time warp" );
+	LogEyeWarpGpuTime.Begin( eye );
+	LogEyeWarpGpuTime.PrintTime( eye, "GPU time for eye time warp" );
+	WarpGpuProfile.Begin( "Warp" );
 
-		SetWarpState( currentWarpSource );
+	SetWarpState( currentWarpSource );
 
-		BindWarpProgram( currentWarpSource, timeWarps, eye, vsyncBase );
+	BindWarpProgram( currentWarpSource, timeWarps, layerWarps, eye, vsyncBase );
 
-		BindEyeTextures( currentWarpSource, eye, loadingTexture );
+	BindEyeTextures( currentWarpSource, eye, loadingTexture );
 
-		InitParms.Screen->BeginDirectRendering( eye * screenWidth/2, 0, screenWidth/2, screenHeight );
+	InitParms.Screen->BeginDirectRendering( eye * warper.ScreenWidth/2, 0, warper.ScreenWidth/2, warper.ScreenHeight );
 
-		// Draw the warp triangles.
-		glBindVertexArrayOES_( warpMesh.vertexArrayObject );
-		const int indexCount = warpMesh.indexCount / 2;
-		const int indexOffset = eye * indexCount;
-		glDrawElements( GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void *)(indexOffset * 2 ) );
+	// Draw the warp triangles.
+	glBindVertexArrayOES_( warpMesh.vertexArrayObject );
+	const int indexCount = warpMesh.indexCount / 2;
+	const int indexOffset = eye * indexCount;
+	glDrawElements( GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void *)(indexOffset * 2 ) );
 
 #if 1
-		// Draw the screen vignette, calibration grid, and debug graphs.
-		// The grid will be based on the orientation that the warpSource
-		// was rendered at, so you can see the amount of interpolated time warp applied
-		// to it as a delta from the red grid to the greed or blue grid that was drawn directly
-		// into the texture.
-		DrawFrameworkGraphicsToWindow( eye, currentWarpSource.WarpParms.SwapOptions,
-				currentWarpSource.WarpParms.DebugGraphMode != DEBUG_PERF_OFF );
+	// Draw the screen vignette, calibration grid, and debug graphs.
+	// The grid will be based on the orientation that the warpSource
+	// was rendered at, so you can see the amount of interpolated time warp applied
+	// to it as a delta from the red grid to the greed or blue grid that was drawn directly
+	// into the texture.
+	DrawFrameworkGraphicsToWindow( eye, currentWarpSource.WarpParms.SwapOptions,
+			currentWarpSource.WarpParms.DebugGraphMode != DEBUG_PERF_OFF );
 #endif
 
-		InitParms.Screen->EndDirectRendering();
-
-		LogEyeWarpGpuTime.End( eye );
-
-		const double justBeforeFinish = TimeInSeconds();
-		if ( InitParms.Screen->IsFrontBuffer() )
-		{
-			GL_Finish();
-		}
-
-		const double postFinish = TimeInSeconds();
-
-		const float latency = postFinish - justBeforeFinish;
-		if ( latency > 0.008f )
-		{
-			LOG( "Frame %i Eye %i latency %5.3f", (int)vsyncBase, eye, latency );
-		}
-
-		if ( 0 )
-		{
-			LOG( "eye %i sleep %5.3f fin %5.3f buf %lli (%i back):%i %i",
-					eye, secondsToSleep,
-					postFinish - preFinish,
-					thisEyeBufferNum, back,
-					currentWarpSource.WarpParms.Images[0][0].TexId,
-					currentWarpSource.WarpParms.Images[1][0].TexId );
-		}
-
-		// Update debug graph data
-		if ( currentWarpSource.WarpParms.DebugGraphMode != DEBUG_PERF_FROZEN )
-		{
-			const int logIndex = (int)lastEyeLog & (EYE_LOG_COUNT-1);
-			eyeLog_t & thisLog = eyeLog[logIndex];
-			thisLog.skipped = false;
-			thisLog.bufferNum = thisEyeBufferNum;
-			thisLog.issueFinish = preFinish - sleepTargetTime;
-			thisLog.completeFinish = postFinish - sleepTargetTime;
-			lastEyeLog++;
-		}
-
-	}	// for eye
+	InitParms.Screen->EndDirectRendering();
 
-	UnbindEyeTextures();
+	WarpGpuProfile.End();
+	LogEyeWarpGpuTime.End( eye );
 
-	glUseProgram( 0 );
+	const double justBeforeFinish = Clock->GetTimeInSeconds();
+	if ( InitParms.Screen->IsFrontBuffer() )
+	{
+		GL_Finish();
+	}
 
-	glBindVertexArrayOES_( 0 );
+	const double postFinish = Clock->GetTimeInSeconds();
 
-	if ( !InitParms.Screen->IsFrontBuffer() )
+	const float latency = postFinish - justBeforeFinish;
+	if ( latency > 0.008f )
 	{
-		InitParms.Screen->SwapBuffers();
+		LOG( "Frame %i Eye %i latency %5.3f", (int)vsyncBase, eye, latency );
 	}
-}
 
-void TimeWarpLocal::WarpToScreenSliced( const double vsyncBase )
-{
-	// Fetch vsync timing information once, so we don't have to worry
-	// about it changing slightly inside a given frame.
-	const VsyncState vsyncState = UpdatedVsyncState.GetState();
-	if ( vsyncState.vsyncBaseNano == 0 )
+	if ( 0 )
 	{
-		return;
+		LOG( "eye %i sleep %5.3f fin %5.3f buf %lli (%i back):%i %i",
+				eye, timing.SecondsToSleep,
+				postFinish - preFinish,
+				warper.ThisEyeBufferNum, warper.Back,
+				currentWarpSource.WarpParms.Images[0][0].TexId,
+				currentWarpSource.WarpParms.Images[1][0].TexId );
 	}
 
-	// all necessary time points can now be calculated
-
-	// Because there are blanking lines at the bottom, there will always be a longer
-	// sleep for the first slice than the remainder.
-	double	sliceTimes[NUM_SLICES_PER_SCREEN+1];
-
-	static const double startBias = 0.0; // 8.0/1920.0/60.0;	// about 8 pixels into a 1920 screen at 60 hz
-	static const double activeFraction = 112.0 / 135;			// the remainder are blanking lines
-	for ( int i = 0; i <= NUM_SLICES_PER_SCREEN; i++ )
+	// Update debug graph data
+	if ( currentWarpSource.WarpParms.DebugGraphMode != DEBUG_PERF_FROZEN )
 	{
-		const double framePoint = vsyncBase + activeFraction * (float)i / NUM_SLICES_PER_SCREEN;
-		sliceTimes[i] = ( vsyncState.vsyncBaseNano +
-				( framePoint - vsyncState.vsyncCount ) * vsyncState.vsyncPeriodNano )
-				* 0.000000001 + startBias;
+		const int logIndex = (int)lastEyeLog & (EYE_LOG_COUNT-1);
+		eyeLog_t & thisLog = eyeLog[logIndex];
+		thisLog.skipped = false;
+		thisLog.bufferNum = warper.ThisEyeBufferNum;
+		thisLog.issueFinish = preFinish - timing.SleepTargetTime;
+		thisLog.completeFinish = postFinish - timing.SleepTargetTime;
+		lastEyeLog++;
 	}
+}
 
-	int screenWide, screenTall;
-	InitParms.Screen->GetScreenResolution( screenWide, screenTall );
-	glViewport( 0, 0, screenWide, screenTall );
-	glScissor( 0, 0, screenWide, screenTall );
+float TimeWarpLocal::WarpSlice( ScreenWarper & warper, const int screenSlice, const WarpPointTiming & timing )
+{
+	const ScreenEye	eye = (ScreenEye)( screenSlice / NUM_SLICES_PER_EYE );
+	const warpSource_t & currentWarpSource = warper.CurrentWarpSource;
+	const double vsyncBase = timing.VsyncBase;
+	const double * sliceTimes = timing.SliceTimes;
+	const double preFinish = timing.WakeTime;
 
-	// This must be long enough to cover CPU scheduling delays, GPU in-flight commands,
-	// and the actual drawing of this slice.
-	const warpSource_t & latestWarpSource = WarpSources[EyeBufferCount.GetState()%MAX_WARP_SOURCES];
-	const double	schedulingCushion = latestWarpSource.WarpParms.PreScheduleSeconds;
+	const TraceScope traceSlice( TRACE_WARP, "WarpSlice", screenSlice );
 
-	//LOG( "now %fv(%i) %f cush %f", GetFractionalVsync(), (int)vsyncBase, ovr_GetTimeInSeconds(), schedulingCushion );
+	//LOG( "slice %i targ %f slept %f", screenSlice, timing.SleepTargetTime, timing.SecondsToSleep );
 
-	// Warp each slice to the display surface
-	warpSource_t currentWarpSource = {};
-	int	back = 0;	// frame back from most recent
-	long long thisEyeBufferNum = 0;
-	for ( int screenSlice = 0; screenSlice < NUM_SLICES_PER_SCREEN; screenSlice++ )
+	// Build up the external velocity transform
+	Matrix4f velocity;
+	const int velocitySteps = OVR::Alg::Min( 3, (int)((long long)vsyncBase - currentWarpSource.MinimumVsync) );
+	for ( int i = 0; i < velocitySteps; i++ )
 	{
-		const ScreenEye	eye = (ScreenEye)( screenSlice / NUM_SLICES_PER_EYE );
-
-		// Sleep until we are in the correct part of the screen for
-		// rendering this slice.
-		const double sleepTargetTime = sliceTimes[ screenSlice ] - schedulingCushion;
-		const float secondsToSleep = SleepUntilTimePoint( sleepTargetTime, false );
-		const double preFinish = TimeInSeconds();
+		velocity = velocity * currentWarpSource.WarpParms.ExternalVelocity;
+	}
 
-		//LOG( "slice %i targ %f slept %f", screenSlice, sleepTargetTime, secondsToSleep );
+	// If we have a second image layer, we will need to calculate
+	// a second set of time warps and use a different program.
+	const bool dualLayer = ( currentWarpSource.WarpParms.Images[eye][1].TexId > 0 );
 
-		// Check for availability of updated eye renderings on the first eye
-		if ( screenSlice == 0 )
+	// Calculate predicted poses for the start and end of this eye's
+	// raster scanout, so we can warp the best image we have to it.
+	//
+	// These prediction points will always be in the future, because we
+	// need time to do the drawing before the scanout starts.
+	//
+	// In a portrait scanned display, it is beneficial to have the time warp calculated
+	// independently for each eye, giving them the same latency profile.
+	Matrix4f timeWarps[2][2];
+
+	// Every layer has its own pose.
+	const TimeWarpLayer * layers[TimeWarpParms::MAX_WARP_LAYERS];
+	const int numLayers = GetActiveWarpLayers( currentWarpSource.WarpParms, eye, layers );
+	Matrix4f layerWarps[TimeWarpParms::MAX_WARP_LAYERS][2];
+
+	for ( int scan = 0; scan < 2; scan++ )
+	{
+		// We always make a new prediciton for the end of the slice,
+		// but we only make a new one for the start of the slice when a
+		// new eye has just started, otherwise we could get a visible
+		// seam at the slice boundary when the prediction changed.
+		static Matrix4f	warp;
+		static Quatf	predicted;
+		if ( scan == 1 || screenSlice == 0 || screenSlice == NUM_SLICES_PER_EYE )
 		{
-			const long long latestEyeBufferNum = EyeBufferCount.GetState();
-			for ( back = 0; back < MAX_WARP_SOURCES - 1; back++ )
-			{
-				thisEyeBufferNum = latestEyeBufferNum - back;
-				if ( thisEyeBufferNum <= 0 )
-				{	// just starting, and we don't have any eye buffers to use
-					break;
-				}
-				warpSource_t & testWarpSource = WarpSources[thisEyeBufferNum % MAX_WARP_SOURCES];
-				if ( testWarpSource.MinimumVsync > vsyncBase )
-				{	// a full frame got completed in less time than a single eye; don't use it to avoid stuttering
-					continue;
-				}
-				if ( testWarpSource.GpuSync == 0 )
-				{
-					LOG( "thisEyeBufferNum %lli had 0 sync", thisEyeBufferNum );
-					break;
-				}
-
-				if ( Quatf( testWarpSource.WarpParms.Images[eye][0].Pose.Pose.Orientation ).LengthSq() < 1e-18f )
-				{
-					LOG( "Bad Predicted.Pose.Orientation!" );
-					continue;
-				}
-
-				const EGLint wait = eglClientWaitSyncKHR_( eglDisplay, testWarpSource.GpuSync,
-						EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 0 );
-				if ( wait == EGL_TIMEOUT_EXPIRED_KHR )
-				{
-					continue;
-				}
-				if ( wait == EGL_FALSE )
-				{
-					LOG( "eglClientWaitSyncKHR returned EGL_FALSE" );
-				}
-
-				// This buffer set is good to use
-				if ( testWarpSource.FirstDisplayedVsync[eye] == 0 )
-				{
-					testWarpSource.FirstDisplayedVsync[eye] = (long long)vsyncBase;
-				}
-				currentWarpSource = testWarpSource;
-				break;
-			}
-
-			// Release the VR thread if it is blocking on a frame being completed.
-			// It is important that this always be done, even if we wind up
-			// not rendering anything because there are no current eye buffers.
-			if ( screenSlice == 0 )
-			{
-				SwapState	state;
-				state.VsyncCount = (long long)vsyncBase;
-				state.EyeBufferCount = thisEyeBufferNum;
-				SwapVsync.SetState( state );
-
-				// Wake the VR thread up if it is blocked on us.
-				// If the other thread happened to be scheduled out right
-				// after locking the mutex, but before waiting on the condition,
-				// we would rather it sleep for another frame than potentially
-				// miss a raster point here in the time warp thread, so use
-				// a trylock() instead of a lock().
-				if ( !pthread_mutex_trylock( &swapMutex ) )
-				{
-					pthread_cond_signal( &swapIsLatched );
-					pthread_mutex_unlock( &swapMutex );
-				}
-			}
-
-			if ( InitParms.Screen->windowSurface == EGL_NO_SURFACE )
-			{
-				static int logCount = 0;
-				if ( ( logCount++ & 31 ) == 0 )
-				{
-					LOG( "WarpToScreen: no valid window surface" );
-				}
-				return;
-			}
-
-			if ( currentWarpSource.WarpParms.Images[eye][0].TexId == 0 )
-			{
-				// We don't have anything valid to draw, so just sleep until
-				// the next time point and check again.
-				LOG( "No valid eyeTexture" );
-				SleepUntilTimePoint( FramePointTimeInSeconds( vsyncBase + 1.0f ), false );
-				break;
-			}
+			// SliceTimes should be the actual time the pixels hit the screen,
+			// but we may want a slight adjustment on the prediction time.
+			const double timePoint = sliceTimes[screenSlice + scan];
+			const ovrSensorState sensor = ovrHmd_GetSensorState( InitParms.Hmd, timePoint, false );
+			predicted = sensor.Predicted.Pose.Orientation;
+			warp = CalculateTimeWarpMatrix2(
+						currentWarpSource.WarpParms.Images[eye][0].Pose.Pose.Orientation,
+						predicted ) * velocity;
 		}
-
-		// Build up the external velocity transform
-		Matrix4f velocity;
-		const int velocitySteps = OVR::Alg::Min( 3, (int)((long long)vsyncBase - currentWarpSource.MinimumVsync) );
-		for ( int i = 0; i < velocitySteps; i++ )
+		timeWarps[0][scan] = Matrix4f( currentWarpSource.WarpParms.Images[eye][0].TexCoordsFromTanAngles ) * warp;
+		if ( dualLayer )
 		{
-			velocity = velocity * currentWarpSource.WarpParms.ExternalVelocity;
+			timeWarps[1][scan] = Matrix4f( currentWarpSource.WarpParms.Images[eye][1].TexCoordsFromTanAngles ) * warp;
 		}
-
-		// If we have a second image layer, we will need to calculate
-		// a second set of time warps and use a different program.
-		const bool dualLayer = ( currentWarpSource.WarpParms.Images[eye][1].TexId > 0 );
-
-		// Calculate predicted poses for the start and end of this eye's
-		// raster scanout, so we can warp the best image we have to it.
-		//
-		// These prediction points will always be in the future, because we
-		// need time to do the drawing before the scanout starts.
-		//
-		// In a portrait scanned display, it is beneficial to have the time warp calculated
-		// independently for each eye, giving them the same latency profile.
-		Matrix4f timeWarps[2][2];
-
-		for ( int scan = 0; scan < 2; scan++ )
+		for ( int i = 0; i < numLayers; i++ )
 		{
-			// We always make a new prediciton for the end of the slice,
-			// but we only make a new one for the start of the slice when a
-			// new eye has just started, otherwise we could get a visible
-			// seam at the slice boundary when the prediction changed.
-			static Matrix4f	warp;
-			if ( scan == 1 || screenSlice == 0 || screenSlice == NUM_SLICES_PER_EYE )
-			{
-				// SliceTimes should be the actual time the pixels hit the screen,
-				// but we may want a slight adjustment on the prediction time.
-				const double timePoint = sliceTimes[screenSlice + scan];
-				const ovrSensorState sensor = ovrHmd_GetSensorState( InitParms.Hmd, timePoint, false );
-				warp = CalculateTimeWarpMatrix2(
-							currentWarpSource.WarpParms.Images[eye][0].Pose.Pose.Orientation,
-							sensor.Predicted.Pose.Orientation ) * velocity;
-			}
-			timeWarps[0][scan] = Matrix4f( currentWarpSource.WarpParms.Images[eye][0].TexCoordsFromTanAngles ) * warp;
-			if ( dualLayer )
-			{
-				timeWarps[1][scan] = Matrix4f( currentWarpSource.WarpParms.Images[eye][1].TexCoordsFromTanAngles ) * warp;
-			}
+			layerWarps[i][scan] = LayerTimeWarp( *layers[i], eye, predicted, velocity );
 		}
+	}
 
-		//---------------------------------------------------------
-		// Warp a latched buffer to the screen
-		//---------------------------------------------------------
+	//---------------------------------------------------------
+	// Warp a latched buffer to the screen
+	//---------------------------------------------------------
 
-		LogEyeWarpGpuTime.Begin( screenSlice );
-		LogEyeWarpGpuTime.PrintTime( screenSlice, "GPU time for eye time warp" );
+	LogEyeWarpGpuTime.Begin( screenSlice );
+	LogEyeWarpGpuTime.PrintTime( screenSlice, "GPU time for eye time warp" );
+	WarpGpuProfile.Begin( "WarpSlice" );
 
-		SetWarpState( currentWarpSource );
+	SetWarpState( currentWarpSource );
 
-		BindWarpProgram( currentWarpSource, timeWarps, eye, vsyncBase );
+	BindWarpProgram( currentWarpSource, timeWarps, layerWarps, eye, vsyncBase );
 
-		if ( screenSlice == 0 || screenSlice == NUM_SLICES_PER_EYE )
-		{
-			BindEyeTextures( currentWarpSource, eye, loadingTexture );
-		}
+	if ( screenSlice == 0 || screenSlice == NUM_SLICES_PER_EYE )
+	{
+		BindEyeTextures( currentWarpSource, eye, loadingTexture );
+	}
 
-		const int sliceSize = screenWide / NUM_SLICES_PER_SCREEN;
+	const int sliceSize = warper.ScreenWidth / NUM_SLICES_PER_SCREEN;
 
-		InitParms.Screen->BeginDirectRendering( sliceSize*screenSlice, 0, sliceSize, screenTall );
+	InitParms.Screen->BeginDirectRendering( sliceSize*screenSlice, 0, sliceSize, warper.ScreenHeight );
 
-		// Draw the warp triangles.
-		const GlGeometry & mesh = fileMesh.indexCount ? fileMesh : sliceMesh;
-		glBindVertexArrayOES_( mesh.vertexArrayObject );
-		const int indexCount = mesh.indexCount / NUM_SLICES_PER_SCREEN;
-		const int indexOffset = screenSlice * indexCount;
-		glDrawElements( GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void *)(indexOffset * 2 ) );
+	// Draw the warp triangles.
+	const GlGeometry & mesh = fileMesh.indexCount ? fileMesh : sliceMesh;
+	glBindVertexArrayOES_( mesh.vertexArrayObject );
+	const int indexCount = mesh.indexCount / NUM_SLICES_PER_SCREEN;
+	const int indexOffset = screenSlice * indexCount;
+	glDrawElements( GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void *)(indexOffset * 2 ) );
 
-		if ( 0 )
-		{	// solid color flashing test to see if slices are rendering in the right place
-			const int cycleColor = (int)vsyncBase + screenSlice;
-			glClearColor( cycleColor & 1, ( cycleColor >> 1 ) & 1, ( cycleColor >> 2 ) & 1, 1 );
-			glClear( GL_COLOR_BUFFER_BIT );
-		}
+	if ( 0 )
+	{	// solid color flashing test to see if slices are rendering in the right place
+		const int cycleColor = (int)vsyncBase + screenSlice;
+		glClearColor( cycleColor & 1, ( cycleColor >> 1 ) & 1, ( cycleColor >> 2 ) & 1, 1 );
+		glClear( GL_COLOR_BUFFER_BIT );
+	}
 
 #if 1
-		// Draw the screen vignette, calibration grid, and debug graphs.
-		// The grid will be based on the orientation that the warpSource
-		// was rendered at, so you can see the amount of interpolated time warp applied
-		// to it as a delta from the red grid to the greed or blue grid that was drawn directly
-		// into the texture.
-		DrawFrameworkGraphicsToWindow( eye, currentWarpSource.WarpParms.SwapOptions,
-				currentWarpSource.WarpParms.DebugGraphMode != DEBUG_PERF_OFF );
+	// Draw the screen vignette, calibration grid, and debug graphs.
+	// The grid will be based on the orientation that the warpSource
+	// was rendered at, so you can see the amount of interpolated time warp applied
+	// to it as a delta from the red grid to the greed or blue grid that was drawn directly
+	// into the texture.
+	DrawFrameworkGraphicsToWindow( eye, currentWarpSource.WarpParms.SwapOptions,
+			currentWarpSource.WarpParms.DebugGraphMode != DEBUG_PERF_OFF );
 #endif
 
-		InitParms.Screen->EndDirectRendering();
-
-		LogEyeWarpGpuTime.End( screenSlice );
-
-		//GL_Finish();
-
-		const double postFinish = TimeInSeconds();
-
-		if ( 0 )
-		{
-			LOG( "slice %i sleep %7.4f fin %6.4f buf %lli (%i back)",
-					screenSlice, secondsToSleep,
-					postFinish - preFinish,
-					thisEyeBufferNum, back );
-		}
-
-	}	// for screenSlice
+	InitParms.Screen->EndDirectRendering();
 
-	UnbindEyeTextures();
+	WarpGpuProfile.End();
+	LogEyeWarpGpuTime.End( screenSlice );
 
-	glUseProgram( 0 );
+	//GL_Finish();
 
-	glBindVertexArrayOES_( 0 );
+	if ( 0 )
+	{
+		const double postFinish = Clock->GetTimeInSeconds();
+		LOG( "slice %i sleep %7.4f fin %6.4f buf %lli (%i back)",
+				screenSlice, timing.SecondsToSleep,
+				postFinish - preFinish,
+				warper.ThisEyeBufferNum, warper.Back );
+	}
 
-	GL_Finish();
+	// The GPU time is a recent average, and 0 without timer queries.
+	return LogEyeWarpGpuTime.GetTime( screenSlice ) * 0.001f;
 }
 
 /*
@@ -1760,6 +1815,8 @@ void TimeWarpLocal::WarpSwap( const TimeWarpParms & parms )
 		FAIL( "WarpSwap: no valid window surface" );
 	}
 
+	const TraceScope traceSwap( TRACE_FRAME, "WarpSwap" );
+
 	// Keep track of the last time WarpSwap() was called.
 	LastWarpSwapTimeInSeconds.SetState( ovr_GetTimeInSeconds() );
 
@@ -1780,7 +1837,7 @@ void TimeWarpLocal::WarpSwap( const TimeWarpParms & parms )
 	// multi-threaded.
 	const long long lastBufferCount = EyeBufferCount.GetState();
 	warpSource_t & ws = WarpSources[ ( lastBufferCount + 1 ) % MAX_WARP_SOURCES ];
-	ws.MinimumVsync = LastSwapVsyncCount + 2 * minimumVsyncs;	// don't use it if from same frame to avoid problems with very fast frames
+	ws.MinimumVsync = WarpSourceMinimumVsync( LastSwapVsyncCount, minimumVsyncs );	// don't use it if from same frame to avoid problems with very fast frames
 	ws.FirstDisplayedVsync[0] = 0;			// will be set when it becomes the currentSource
 	ws.FirstDisplayedVsync[1] = 0;			// will be set when it becomes the currentSource
 	ws.disableChromaticCorrection = ( ovr_GetPowerLevelStateThrottled() || ( EglGetGpuType() & OVR::GPU_TYPE_MALI ) != 0 );
@@ -1813,6 +1870,7 @@ void TimeWarpLocal::WarpSwap( const TimeWarpParms & parms )
 //	LOG( "submitting bufferNum %lli: %i %i", lastBufferCount+1,
 //			ws.WarpParms.Images[0][0].TexId, ws.WarpParms.Images[1][0].TexId );
 	EyeBufferCount.SetState( lastBufferCount + 1 );
+	TraceInstant( TRACE_FRAME, "Submit", lastBufferCount + 1 );
 
 	// If we are running synchronously instead of using a background
 	// thread, call WarpToScreen() directly.
@@ -1832,7 +1890,7 @@ void TimeWarpLocal::WarpSwap( const TimeWarpParms & parms )
 			swapProg = &spSyncSwappedBufferPortrait;
 		}
 
-		WarpToScreen( floor( GetFractionalVsync() ), *swapProg );
+		WarpToScreen( floor( Clock->GetFractionalVsync() ), *swapProg );
 
 		const SwapState state = SwapVsync.GetState();
 		LastSwapVsyncCount = state.VsyncCount;
@@ -1860,14 +1918,12 @@ void TimeWarpLocal::WarpSwap( const TimeWarpParms & parms )
 		pthread_mutex_unlock( &swapMutex );
 
 		const uint64_t endSuspendNanoSeconds = GetNanoSecondsUint64();
+		TraceComplete( TRACE_FRAME, "WaitForLatch", startSuspendNanoSeconds, endSuspendNanoSeconds - startSuspendNanoSeconds );
 
-		const SwapState state = SwapVsync.GetState();
-		if ( state.EyeBufferCount >= lastBufferCount )
+		// If MinimumVsyncs was increased dynamically, it is necessary
+		// to skip one or more vsyncs just as the change happens.
+		if ( ReleaseWarpSwap( SwapVsync.GetState(), lastBufferCount, minimumVsyncs, LastSwapVsyncCount ) )
 		{
-			// If MinimumVsyncs was increased dynamically, it is necessary
-			// to skip one or more vsyncs just as the change happens.
-			LastSwapVsyncCount = Alg::Max( state.VsyncCount, LastSwapVsyncCount + minimumVsyncs );
-
 			// If we are running the image server, let it start a transfer
 			// of the last completed image buffer.
 			if ( NetImageServer )
@@ -1956,22 +2012,14 @@ GlGeometry BuildTimingGraphGeometry( const int lineVertCount )
 	glGenVertexArraysOES_( 1, &geo.vertexArrayObject );
 	glBindVertexArrayOES_( geo.vertexArrayObject );
 
-	lineVert_t	* verts = new lineVert_t[lineVertCount];
-	const int byteCount = lineVertCount * sizeof( verts[0] );
-	memset( verts, 0, byteCount );
-	glGenBuffers( 1, &geo.vertexBuffer );
-	glBindBuffer( GL_ARRAY_BUFFER, geo.vertexBuffer );
-	glBufferData( GL_ARRAY_BUFFER, byteCount, (void *) verts, GL_DYNAMIC_DRAW );
+	// The verts are streamed each frame, and the attribute pointers set to
+	// wherever they land in UpdateTimingGraphVerts().
 	glEnableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_POSITION );
-	glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_POSITION, 2, GL_SHORT, false, sizeof( lineVert_t ), (void *)0 );
-
 	glEnableVertexAttribArray( VERTEX_ATTRIBUTE_LOCATION_COLOR );
-	glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_COLOR, 4, GL_UNSIGNED_BYTE, true, sizeof( lineVert_t ), (void *)4 );
-	delete[] verts;
 
 	// these will be drawn with DrawArrays, so no index buffer is needed
 
-	geo.indexCount = lineVertCount;
+	geo.indexCount = 0;
 
 	glBindVertexArrayOES_( 0 );
 
@@ -1990,6 +2038,8 @@ void TimeWarpLocal::UpdateTimingGraphVerts( const debugPerfMode_t debugPerfMode,
 		return;
 	}
 
+	timingGraphStream->BeginFrame();
+
 	// Draw graph markers every five milliseconds
 	lineVert_t	verts[EYE_LOG_COUNT*2+10];
 	int			numVerts = 0;
@@ -2076,18 +2126,19 @@ void TimeWarpLocal::UpdateTimingGraphVerts( const debugPerfMode_t debugPerfMode,
 	// of using client arrays to avoid messing with Unity's attribute arrays.
 
 	// NOTE: vertex array objects do NOT include the GL_ARRAY_BUFFER_BINDING state, and
-	// binding a VAO does not change GL_ARRAY_BUFFER, so we do need to track the buffer
-	// in the geometry if we want to update it, or do a GetVertexAttrib( VERTEX_ATTRIB_ARRAY_BUFFER_BINDING
-
-	// For reasons that I do not understand, if I don't bind the VAO, then all updates after the
-	// first one produce no additional changes.
+	// binding a VAO does not change GL_ARRAY_BUFFER, but the attribute pointers are
+	// captured by the VAO, so they are pointed at the streamed verts with it bound.
 	glBindVertexArrayOES_( timingGraph.vertexArrayObject );
-	glBindBuffer(GL_ARRAY_BUFFER, timingGraph.vertexBuffer);
-	glBufferSubData( GL_ARRAY_BUFFER, 0, numVerts * sizeof( verts[0] ), (void *) verts );
+	const int offset = timingGraphStream->Stream( verts, numVerts * sizeof( verts[0] ) );
+	if ( offset >= 0 )
+	{
+		glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_POSITION, 2, GL_SHORT, false, sizeof( lineVert_t ), (void *)( offset + 0 ) );
+		glVertexAttribPointer( VERTEX_ATTRIBUTE_LOCATION_COLOR, 4, GL_UNSIGNED_BYTE, true, sizeof( lineVert_t ), (void *)( offset + 4 ) );
+	}
 	glBindBuffer( GL_ARRAY_BUFFER, 0 );
 	glBindVertexArrayOES_( 0 );
 
-	timingGraph.indexCount = numVerts;
+	timingGraph.indexCount = ( offset >= 0 ) ? numVerts : 0;
 
 	GL_CheckErrors( "After UpdateTimingGraph" );
 }
@@ -2216,6 +2267,7 @@ void TimeWarpLocal::CreateFrameworkGraphics()
 	// Vertexes and indexes for debug graph, the verts will be updated
 	// dynamically each frame.
 	timingGraph = BuildTimingGraphGeometry( (256+10)*2 );
+	timingGraphStream = new GlStreamingBuffer( ( EYE_LOG_COUNT*2+10 ) * sizeof( lineVert_t ) );
 
 	// simple cross to draw to screen
 	calibrationLines2 = BuildCalibrationLines( 0, false );
@@ -2861,6 +2913,8 @@ void TimeWarpLocal::DestroyFrameworkGraphics()
 	sliceMesh.Free();
 	fileMesh.Free();
 	timingGraph.Free();
+	delete timingGraphStream;
+	timingGraphStream = NULL;
 
 	DeleteProgram( untexturedMvpProgram );
 	DeleteProgram( debugLineProgram );
@@ -2869,6 +2923,13 @@ void TimeWarpLocal::DestroyFrameworkGraphics()
 	{
 		DeleteProgram( warpPrograms[i].Prog );
 	}
+	for ( int i = 0; i < layerWarpPrograms.GetSizeI(); i++ )
+	{
+		DeleteProgram( layerWarpPrograms[i].Prog );
+	}
+	layerWarpPrograms.Clear();
+
+	WarpGpuProfile.Free();
 }
 
 // Assumes viewport and scissor is set for the eye already.
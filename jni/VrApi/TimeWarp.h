@@ -27,6 +27,7 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "DirectRender.h"
 #include "TimeWarpParms.h"
 #include "HmdInfo.h"
+#include "FramePacing.h"
 
 const int SCHED_FIFO_PRIORITY_NONE			= 0;
 const int SCHED_FIFO_PRIORITY_VRTHREAD		= 1;
@@ -134,6 +135,11 @@ public:
 	// Get the thread ID so we can set SCHED_FIFO
 	virtual int			GetWarpThreadTid() const = 0;
 	virtual pthread_t	GetWarpThread() const = 0;
+
+	// What the sliced warp measured and how far ahead of each slice it
+	// would start with SWAP_OPTION_ADAPTIVE_SLICE_SCHEDULE. Updated every
+	// sliced frame, whether or not the option is set.
+	virtual SliceScheduleStats	GetSliceScheduleStats() const = 0;
 };
 
 }		// namespace OVR
@@ -15,10 +15,13 @@ Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
 #include "TimeWarp.h"
 #include "GlProgram.h"
 #include "GlGeometry.h"
+#include "GlStreamingBuffer.h"
 #include "GlTexture.h"
 #include "BitmapFont.h"
 #include "VrApi.h"
 #include "ImageServer.h"
+#include "Vsync.h"
+#include "GpuProfiler.h"
 
 namespace OVR {
 
@@ -111,15 +114,6 @@ struct eyeLog_t
 	float		poseLatencySeconds;
 };
 
-// This is communicated from the TimeWarp thread to the VrThread at
-// vsync time.
-struct SwapState
-{
-	SwapState() : VsyncCount(0),EyeBufferCount(0) {}
-	long long		VsyncCount;
-	long long		EyeBufferCount;
-};
-
 struct WarpProg
 {
 	GlProgram	Prog;
@@ -129,6 +123,15 @@ struct WarpProg
 	GLint		RotateScale;
 };
 
+// Generated for a combination of layers, see WarpLayers.h.
+struct LayerWarpProg
+{
+	int			Key;
+	GlProgram	Prog;
+	GLint		LayerTexm;
+	GLint		LayerScaleBias;
+};
+
 class TimeWarpLocal : public TimeWarp
 {
 public:
@@ -144,6 +147,8 @@ public:
 	virtual int			GetWarpThreadTid() const { return warpThreadTid; };
 	virtual pthread_t	GetWarpThread() const { return warpThread; };
 
+	virtual SliceScheduleStats	GetSliceScheduleStats() const { return SliceSchedule.GetStats(); }
+
 private:
 	// POSIX thread launching shim, just calls WarpThread()
 	static void *	ThreadStarter( void * parm );
@@ -161,6 +166,7 @@ private:
 	GlProgram		untexturedMvpProgram;
 	GlProgram		debugLineProgram;
 	WarpProg		warpPrograms[ WP_PROGRAM_MAX ];
+	Array< LayerWarpProg >	layerWarpPrograms;	// built on first use
 	GlTexture		blackTexture;
 	GlTexture		loadingTexture;
 	GlGeometry		calibrationLines2;		// simple cross
@@ -168,12 +174,44 @@ private:
 	GlGeometry		fileMesh;
 	GlGeometry		sliceMesh;
 	GlGeometry		timingGraph;
+	GlStreamingBuffer *	timingGraphStream;	// the warp context can't use the application's buffer
 	static const int NUM_SLICES_PER_EYE = 4;
 	static const int NUM_SLICES_PER_SCREEN = NUM_SLICES_PER_EYE*2;
 
 	// Wait for sync points amd warp to screen.
 	void			WarpToScreen( const double vsyncBase, const swapProgram_t & swap);
-	void			WarpToScreenSliced( const double vsyncBase );
+
+	// The buffer set latched for the vsync being warped, and the callbacks
+	// WarpFrame() in FramePacing.h issues the eyes or slices through.
+	struct ScreenWarper
+	{
+						ScreenWarper( TimeWarpLocal & tw, const swapProgram_t & swap, const bool sliced );
+
+		bool			Latch( const WarpPointTiming & timing ) { return Tw.LatchWarpSource( *this, timing ); }
+		float			Warp( const int point, const WarpPointTiming & timing )
+		{
+			if ( Sliced )
+			{
+				return Tw.WarpSlice( *this, point, timing );
+			}
+			Tw.WarpEye( *this, (ScreenEye)point, timing );
+			return 0.0f;
+		}
+
+		TimeWarpLocal &			Tw;
+		const swapProgram_t &	Swap;
+		const bool				Sliced;
+		int						ScreenWidth;
+		int						ScreenHeight;
+		warpSource_t			CurrentWarpSource;
+		long long				ThisEyeBufferNum;
+		int						Back;	// frame back from most recent
+	};
+
+	bool			LatchWarpSource( ScreenWarper & warper, const WarpPointTiming & timing );
+	void			WarpEye( ScreenWarper & warper, const ScreenEye eye, const WarpPointTiming & timing );
+	// Returns the recent GPU time of the slice, or 0 if it isn't known.
+	float			WarpSlice( ScreenWarper & warper, const int screenSlice, const WarpPointTiming & timing );
 
 	// Build new verts for the timing graph, call once each frame
 	void			UpdateTimingGraphVerts( const debugPerfMode_t debugPerfMode, const debugPerfValue_t debugValue );
@@ -183,12 +221,16 @@ private:
 
 	const WarpProg & ProgramForParms( const TimeWarpParms & parms, const bool disableChromaticCorrection ) const;
 	void			SetWarpState( const warpSource_t & currentWarpSource ) const;
-	void			BindWarpProgram( const warpSource_t & currentWarpSource, const Matrix4f timeWarps[2][2], const int eye, const double vsyncBase  ) const;
+	const LayerWarpProg & LayerProgramForKey( const int key );
+	void			BindWarpProgram( const warpSource_t & currentWarpSource, const Matrix4f timeWarps[2][2],
+							const Matrix4f layerWarps[TimeWarpParms::MAX_WARP_LAYERS][2], const int eye, const double vsyncBase );
 
 	// Parameters from Startup()
 	TimeWarpInitParms InitParms;
 
 	bool			HasEXT_sRGB_write_control;	// extension
+	GLint			MaxVaryingVectors;			// limits the layers in a warp program
+	int				LastClampedLayerKey;		// to only log each clamped key once in a row
 
 	// NULL if not requested at startup
 	ImageServer	*	NetImageServer;
@@ -223,6 +265,9 @@ private:
 	// GPU time queries around eye warp rendering.
 	LogGpuTime<NUM_SLICES_PER_SCREEN>	LogEyeWarpGpuTime;
 
+	// Nested GPU time of each eye or slice warp, reported with the profiler.
+	GpuProfiler		WarpGpuProfile;
+
 	// The warp loop will exit when this is set true.
 	LocklessUpdater<bool>		ShutdownRequest;
 
@@ -250,6 +295,13 @@ private:
 
 	long long			LastSwapVsyncCount;			// SwapVsync at return from last WarpSwap()
 
+	// All scheduling reads the time and the vsync timing through this, see
+	// FramePacing.h for the simulated version.
+	VsyncClock *		Clock;
+
+	// Chooses the cushion for each slice of a sliced WarpToScreen().
+	SliceScheduler		SliceSchedule;
+
 	pthread_mutex_t		ShutdownMutex;
 	pthread_cond_t		ShutdownCondition;
 };
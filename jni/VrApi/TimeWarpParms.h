@@ -81,6 +81,10 @@ static const int SWAP_OPTION_DRAW_CALIBRATION_LINES = 8;
 // Enable / disable the sliced warp
 static const int SWAP_OPTION_USE_SLICED_WARP = 16;
 
+// With the sliced warp, start each slice as late as the measured wakeup,
+// issue and GPU times allow, instead of a fixed PreScheduleSeconds before it.
+static const int SWAP_OPTION_ADAPTIVE_SLICE_SCHEDULE = 32;
+
 //===========================================================================
 // Pure utility helper functions for building TimeWarpParms
 
@@ -98,6 +102,12 @@ ovrMatrix4f TanAngleMatrixFromUnitSquare( const ovrMatrix4f & modelViewMatrix );
 // to avoid questions of matrix handedness.
 ovrMatrix4f	TanAngleMatrixFromProjection( const ovrMatrix4f & projection );
 
+// Convert the modelView matrix of a cylinder, cube or equirect layer into
+// the rotation from view space to the space of the layer. The translation
+// and scale are ignored, because these layers are always centered on the
+// viewer.
+ovrMatrix4f	TanAngleMatrixForLayer( const ovrMatrix4f & modelView );
+
 // Utility function to calculate external velocity for smooth stick yaw
 // turning in TimeWarp.
 ovrMatrix4f	CalculateExternalVelocity( const ovrMatrix4f & viewMatrix,
@@ -144,6 +154,52 @@ struct TimeWarpImage
 	ovrPoseStatef	Pose;
 };
 
+// Layers are composited over the eye buffer by the warp at display resolution,
+// so text and video drawn into them stay sharp while the eye buffers can be
+// smaller. They have the same lifetime rules as overlay images.
+enum warpLayerType_t
+{
+	WARP_LAYER_DISABLED,
+	WARP_LAYER_QUAD,			// a flat rectangle, see TanAngleMatrixFromUnitSquare()
+	WARP_LAYER_CYLINDER,		// the inside of a vertical cylinder centered on the viewer
+	WARP_LAYER_CUBE,			// a cube map around the viewer
+	WARP_LAYER_EQUIRECT,		// an equirectangular panorama around the viewer
+	WARP_LAYER_TYPE_MAX
+};
+
+// The texture is a GL_TEXTURE_EXTERNAL_OES, like a video surface. Ignored for cube layers.
+static const int WARP_LAYER_FLAG_EXTERNAL_TEXTURE = 1;
+
+// The layer stays where it is in view instead of being time warped for head
+// motion since its Pose, like a HUD.
+static const int WARP_LAYER_FLAG_HEAD_LOCKED = 2;
+
+struct TimeWarpLayer
+{
+	TimeWarpLayer() :
+		Type( WARP_LAYER_DISABLED ),
+		Flags( 0 ),
+		CylinderArcRadians( 1.0f ),
+		CylinderHeightOverRadius( 1.0f ) {}
+
+	warpLayerType_t		Type;
+	int					Flags;
+
+	// Per eye. A layer is only composited for eyes with a TexId.
+	//
+	// For quads, TexCoordsFromTanAngles is the projection from
+	// TanAngleMatrixFromUnitSquare(). For the others it is the rotation
+	// from view space to the space of the layer, see TanAngleMatrixForLayer(),
+	// and the layer is looked up by direction only, with -Z at the center
+	// of the texture and +Y up.
+	TimeWarpImage		Images[2];
+
+	// The horizontal angle the texture is wrapped over, and its height divided
+	// by the radius of the cylinder.
+	float				CylinderArcRadians;
+	float				CylinderHeightOverRadius;
+};
+
 struct TimeWarpParms
 {
 	TimeWarpParms() :   SwapOptions( 0 ),
@@ -166,6 +222,16 @@ struct TimeWarpParms
 	TimeWarpImage 		Images[MAX_WARP_EYES][MAX_WARP_IMAGES];
 	int 				SwapOptions;
 
+	// Composited over the world image in order, each with its own alpha.
+	// When any layer is enabled the warp program is generated for the
+	// combination of layers, WarpProgram only selects whether chromatic
+	// aberration is corrected, and the overlay image is not used.
+	//
+	// The first time a combination is used its program is compiled on
+	// the warp thread, which may drop a frame.
+	static const int	MAX_WARP_LAYERS = 4;
+	TimeWarpLayer		Layers[MAX_WARP_LAYERS];
+
 	// Rotation from a joypad can be added on generated frames to reduce
 	// judder in FPS style experiences when the application framerate is
 	// lower than the vsync rate.
@@ -184,6 +250,8 @@ struct TimeWarpParms
 	// Time in seconds to start drawing before each slice.
 	// Clamped at 0.014 high and 0.002 low, but the very low
 	// values will usually result in screen tearing.
+	// With SWAP_OPTION_ADAPTIVE_SLICE_SCHEDULE this is the
+	// largest cushion the scheduler may pick.
 	float				PreScheduleSeconds;
 
 	// Which program to run with these images.
@@ -105,23 +105,11 @@ VsyncState GetVsyncState()
 
 double	GetFractionalVsync()
 {
-	const VsyncState state = GetVsyncState();
-
-	const	jlong	t = NanoTime();
-	if ( state.vsyncBaseNano == 0 )
-	{
-		return 0;
-	}
-	const	double vsync = (double)state.vsyncCount + (double)(t - state.vsyncBaseNano ) / state.vsyncPeriodNano;
-
-	return vsync;
+	return FractionalVsync( GetVsyncState(), TimeInSeconds() );
 }
 
 double	FramePointTimeInSeconds( const double framePoint ) {
-	const VsyncState state = GetVsyncState();
-	const double seconds = ( state.vsyncBaseNano + ( framePoint - state.vsyncCount ) * state.vsyncPeriodNano )
-			* 0.000000001;
-	return seconds;
+	return FramePointTimeInSeconds( GetVsyncState(), framePoint );
 }
 
 // scanout starts a few percent before the timing mark, and only occupies 112/135 of the total period
@@ -164,6 +152,20 @@ float 	SleepUntilTimePoint( const double targetSeconds, const bool busyWait )
 	return sleepSeconds;
 }
 
+class SystemVsyncClock : public VsyncClock
+{
+public:
+	virtual VsyncState	GetVsyncState() const { return OVR::GetVsyncState(); }
+	virtual double		GetTimeInSeconds() const { return TimeInSeconds(); }
+	virtual float		SleepUntilTimePoint( const double targetSeconds, const bool busyWait ) { return OVR::SleepUntilTimePoint( targetSeconds, busyWait ); }
+};
+
+VsyncClock & GetSystemVsyncClock()
+{
+	static SystemVsyncClock clock;
+	return clock;
+}
+
 
 }	// namespace OVR
 
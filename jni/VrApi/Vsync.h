@@ -39,6 +39,43 @@ public:
 // have to worry about being blocked by a sensor thread that got preempted.
 extern OVR::LocklessUpdater<VsyncState>	UpdatedVsyncState;
 
+// The vsync count and fraction at the given time for the given vsync timing,
+// or 0 if there is no timing yet.
+inline double	FractionalVsync( const VsyncState & state, const double seconds )
+{
+	if ( state.vsyncBaseNano == 0 )
+	{
+		return 0;
+	}
+	return (double)state.vsyncCount + ( seconds * 1000000000.0 - state.vsyncBaseNano ) / state.vsyncPeriodNano;
+}
+
+// The time in seconds of the given frame point for the given vsync timing.
+inline double	FramePointTimeInSeconds( const VsyncState & state, const double framePoint )
+{
+	return ( state.vsyncBaseNano + ( framePoint - state.vsyncCount ) * state.vsyncPeriodNano ) * 0.000000001;
+}
+
+// Everything the TimeWarp scheduling needs to know about time and the display,
+// so the same scheduling code can run against a simulated display.
+class VsyncClock
+{
+public:
+	virtual				~VsyncClock() {}
+
+	virtual VsyncState	GetVsyncState() const = 0;
+	virtual double		GetTimeInSeconds() const = 0;
+
+	// Same as the SleepUntilTimePoint() below.
+	virtual float		SleepUntilTimePoint( const double targetSeconds, const bool busyWait ) = 0;
+
+	double				GetFractionalVsync() const { return FractionalVsync( GetVsyncState(), GetTimeInSeconds() ); }
+	double				FramePointTimeInSeconds( const double framePoint ) const { return OVR::FramePointTimeInSeconds( GetVsyncState(), framePoint ); }
+};
+
+// The real display and the monotonic clock, using the functions below.
+VsyncClock &	GetSystemVsyncClock();
+
 // Estimates the current vsync count and fraction based on the most
 // current timing provided from java.  This does not interact with
 // the JVM at all.
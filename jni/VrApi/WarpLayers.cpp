@@ -0,0 +1,446 @@
+/************************************************************************************
+
+Filename    :   WarpLayers.cpp
+Content     :   Warp programs generated for combinations of TimeWarpParms::Layers.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+
+#include "WarpLayers.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Kernel/OVR_Alg.h"
+#include "Log.h"
+
+namespace OVR
+{
+
+// The key has the chromatic bit at the bottom, then four bits for each
+// layer: the type in the low three and the external texture flag above.
+static const int KEY_CHROMATIC = 1;
+static const int KEY_LAYER_SHIFT = 1;
+static const int KEY_LAYER_BITS = 4;
+static const int KEY_TYPE_MASK = 7;
+static const int KEY_EXTERNAL = 8;
+
+int GetActiveWarpLayers( const TimeWarpParms & parms, const int eye,
+		const TimeWarpLayer * layers[TimeWarpParms::MAX_WARP_LAYERS] )
+{
+	int numLayers = 0;
+	for ( int i = 0; i < TimeWarpParms::MAX_WARP_LAYERS; i++ )
+	{
+		const TimeWarpLayer & layer = parms.Layers[i];
+		if ( layer.Type <= WARP_LAYER_DISABLED || layer.Type >= WARP_LAYER_TYPE_MAX || layer.Images[eye].TexId == 0 )
+		{
+			continue;
+		}
+		layers[numLayers++] = &layer;
+	}
+	return numLayers;
+}
+
+int WarpLayerProgramKey( const TimeWarpLayer * const * layers, const int numLayers, const bool chromatic )
+{
+	int key = chromatic ? KEY_CHROMATIC : 0;
+	for ( int i = 0; i < numLayers; i++ )
+	{
+		int layerKey = layers[i]->Type;
+		if ( ( layers[i]->Flags & WARP_LAYER_FLAG_EXTERNAL_TEXTURE ) && layers[i]->Type != WARP_LAYER_CUBE )
+		{
+			layerKey |= KEY_EXTERNAL;
+		}
+		key |= layerKey << ( KEY_LAYER_SHIFT + i * KEY_LAYER_BITS );
+	}
+	return key;
+}
+
+int WarpLayerProgramNumLayers( const int key )
+{
+	int numLayers = 0;
+	while ( numLayers < TimeWarpParms::MAX_WARP_LAYERS &&
+			( ( key >> ( KEY_LAYER_SHIFT + numLayers * KEY_LAYER_BITS ) ) & ( ( 1 << KEY_LAYER_BITS ) - 1 ) ) != 0 )
+	{
+		numLayers++;
+	}
+	return numLayers;
+}
+
+int WarpLayerProgramVaryings( const int key )
+{
+	// The eye buffer coordinates, one for each layer, and the intensity.
+	const int eyeVaryings = ( key & KEY_CHROMATIC ) ? 3 : 1;
+	return eyeVaryings + WarpLayerProgramNumLayers( key ) + 1;
+}
+
+int ClampWarpLayerProgramKey( const int key, const int maxVaryingVectors )
+{
+	int clamped = key;
+	if ( WarpLayerProgramVaryings( clamped ) > maxVaryingVectors )
+	{
+		clamped &= ~KEY_CHROMATIC;
+	}
+	for ( int numLayers = WarpLayerProgramNumLayers( clamped ); numLayers > 0 &&
+			WarpLayerProgramVaryings( clamped ) > maxVaryingVectors; numLayers-- )
+	{
+		clamped &= ( 1 << ( KEY_LAYER_SHIFT + ( numLayers - 1 ) * KEY_LAYER_BITS ) ) - 1;
+	}
+	return WarpLayerProgramNumLayers( clamped ) > 0 ? clamped : 0;
+}
+
+void WarpLayerScaleBias( const TimeWarpLayer & layer, float scaleBias[4] )
+{
+	switch ( layer.Type )
+	{
+		case WARP_LAYER_CYLINDER:
+		{
+			// ( angle, height / radius ) to texture coordinates
+			const float arc = Alg::Max( layer.CylinderArcRadians, 0.001f );
+			const float height = Alg::Max( layer.CylinderHeightOverRadius, 0.001f );
+			scaleBias[0] = 1.0f / arc;
+			scaleBias[1] = 1.0f / height;
+			scaleBias[2] = 0.5f;
+			scaleBias[3] = 0.5f;
+			break;
+		}
+		case WARP_LAYER_EQUIRECT:
+		{
+			// ( longitude, latitude ) to texture coordinates
+			scaleBias[0] = (float)( 0.5 / M_PI );
+			scaleBias[1] = (float)( 1.0 / M_PI );
+			scaleBias[2] = 0.5f;
+			scaleBias[3] = 0.5f;
+			break;
+		}
+		default:
+		{
+			scaleBias[0] = 1.0f;
+			scaleBias[1] = 1.0f;
+			scaleBias[2] = 0.0f;
+			scaleBias[3] = 0.0f;
+			break;
+		}
+	}
+}
+
+void GenerateWarpLayerProgram( const int key, StringBuffer & vertexSrc, StringBuffer & fragmentSrc )
+{
+	const bool chromatic = ( key & KEY_CHROMATIC ) != 0;
+
+	int layerKeys[TimeWarpParms::MAX_WARP_LAYERS];
+	const int numLayers = WarpLayerProgramNumLayers( key );
+	bool external = false;
+	for ( int i = 0; i < numLayers; i++ )
+	{
+		layerKeys[i] = ( key >> ( KEY_LAYER_SHIFT + i * KEY_LAYER_BITS ) ) & ( ( 1 << KEY_LAYER_BITS ) - 1 );
+		external |= ( layerKeys[i] & KEY_EXTERNAL ) != 0;
+	}
+	const int numTexms = Alg::Max( numLayers, 1 ) * 2;
+
+	// The vertex program warps the eye buffer like WP_SIMPLE or WP_CHROMATIC,
+	// and passes on an unprojected vector for each layer. Like the masked plane
+	// programs, the projection must be done in the fragment program or the
+	// layers wiggle when viewed at even modest angles.
+	vertexSrc.Clear();
+	vertexSrc.AppendFormat(
+			"uniform mediump mat4 Mvpm;\n"
+			"uniform mediump mat4 Texm;\n"
+			"uniform mediump mat4 Texm2;\n"
+			"uniform mediump mat4 LayerTexm[%i];\n"
+			"attribute vec4 Position;\n"
+			"attribute vec2 TexCoord;\n"	// green
+			"attribute vec2 TexCoord1;\n"	// .x = interpolated warp frac, .y = intensity scale
+			, numTexms );
+	if ( chromatic )
+	{
+		vertexSrc +=
+			"attribute vec2 Normal;\n"		// red
+			"attribute vec2 Tangent;\n"		// blue
+			"varying  vec2 oTexCoord1r;\n"
+			"varying  vec2 oTexCoord1g;\n"
+			"varying  vec2 oTexCoord1b;\n";
+	}
+	else
+	{
+		vertexSrc += "varying  vec2 oTexCoord;\n";
+	}
+	for ( int i = 0; i < numLayers; i++ )
+	{
+		vertexSrc.AppendFormat( "varying  vec3 oLayer%i;\n", i );
+	}
+	vertexSrc +=
+			"varying  float	intensity;\n"
+			"void main()\n"
+			"{\n"
+			"   gl_Position = Mvpm * Position;\n"
+			"	vec3 proj;\n"
+			"	float projIZ;\n";
+	if ( chromatic )
+	{
+		vertexSrc +=
+			"   proj = mix( vec3( Texm * vec4(Normal,-1,1) ), vec3( Texm2 * vec4(Normal,-1,1) ), TexCoord1.x );\n"
+			"	projIZ = 1.0 / max( proj.z, 0.00001 );\n"
+			"	oTexCoord1r = vec2( proj.x * projIZ, proj.y * projIZ );\n"
+			"   proj = mix( vec3( Texm * vec4(TexCoord,-1,1) ), vec3( Texm2 * vec4(TexCoord,-1,1) ), TexCoord1.x );\n"
+			"	projIZ = 1.0 / max( proj.z, 0.00001 );\n"
+			"	oTexCoord1g = vec2( proj.x * projIZ, proj.y * projIZ );\n"
+			"   proj = mix( vec3( Texm * vec4(Tangent,-1,1) ), vec3( Texm2 * vec4(Tangent,-1,1) ), TexCoord1.x );\n"
+			"	projIZ = 1.0 / max( proj.z, 0.00001 );\n"
+			"	oTexCoord1b = vec2( proj.x * projIZ, proj.y * projIZ );\n";
+	}
+	else
+	{
+		vertexSrc +=
+			"   proj = mix( vec3( Texm * vec4(TexCoord,-1,1) ), vec3( Texm2 * vec4(TexCoord,-1,1) ), TexCoord1.x );\n"
+			"	projIZ = 1.0 / max( proj.z, 0.00001 );\n"
+			"	oTexCoord = vec2( proj.x * projIZ, proj.y * projIZ );\n";
+	}
+	for ( int i = 0; i < numLayers; i++ )
+	{
+		// Layers only use the green coordinates, so every layer takes a single
+		// varying, see WarpLayerProgramVaryings().
+		vertexSrc.AppendFormat(
+			"   oLayer%i = mix( vec3( LayerTexm[%i] * vec4(TexCoord,-1,1) ), vec3( LayerTexm[%i] * vec4(TexCoord,-1,1) ), TexCoord1.x );\n",
+			i, i * 2, i * 2 + 1 );
+	}
+	vertexSrc +=
+			"	intensity = TexCoord1.y;\n"
+			"}\n";
+
+	// The fragment program composites the layers over the eye buffer in order,
+	// each with its own alpha. Parts of quads and cylinders outside the texture
+	// are masked off, so they don't need a black border.
+	fragmentSrc.Clear();
+	if ( external )
+	{
+		fragmentSrc += "#extension GL_OES_EGL_image_external : require\n";
+	}
+	fragmentSrc += "uniform sampler2D Texture0;\n";
+	for ( int i = 0; i < numLayers; i++ )
+	{
+		const int type = layerKeys[i] & KEY_TYPE_MASK;
+		const char * sampler = ( type == WARP_LAYER_CUBE ) ? "samplerCube" :
+				( ( layerKeys[i] & KEY_EXTERNAL ) ? "samplerExternalOES" : "sampler2D" );
+		fragmentSrc.AppendFormat( "uniform %s Texture%i;\n", sampler, i + 1 );
+	}
+	fragmentSrc.AppendFormat( "uniform highp vec4 LayerScaleBias[%i];\n", Alg::Max( numLayers, 1 ) );
+	if ( chromatic )
+	{
+		fragmentSrc +=
+			"varying highp vec2 oTexCoord1r;\n"
+			"varying highp vec2 oTexCoord1g;\n"
+			"varying highp vec2 oTexCoord1b;\n";
+	}
+	else
+	{
+		fragmentSrc += "varying highp vec2 oTexCoord;\n";
+	}
+	for ( int i = 0; i < numLayers; i++ )
+	{
+		fragmentSrc.AppendFormat( "varying highp vec3 oLayer%i;\n", i );
+	}
+	fragmentSrc +=
+			"varying mediump float	intensity;\n"
+			"void main()\n"
+			"{\n";
+	if ( chromatic )
+	{
+		fragmentSrc +=
+			"	lowp vec4 color1r = texture2D(Texture0, oTexCoord1r);\n"
+			"	lowp vec4 color1g = texture2D(Texture0, oTexCoord1g);\n"
+			"	lowp vec4 color1b = texture2D(Texture0, oTexCoord1b);\n"
+			"	lowp vec4 color = vec4( color1r.x, color1g.y, color1b.z, 1.0 );\n";
+	}
+	else
+	{
+		fragmentSrc += "	lowp vec4 color = texture2D(Texture0, oTexCoord);\n";
+	}
+	for ( int i = 0; i < numLayers; i++ )
+	{
+		const int type = layerKeys[i] & KEY_TYPE_MASK;
+		fragmentSrc.AppendFormat(
+			"	{\n"
+			"		highp vec3 dir = oLayer%i;\n", i );
+		switch ( type )
+		{
+			case WARP_LAYER_QUAD:
+				fragmentSrc.AppendFormat(
+			"		highp vec2 uv = dir.xy / max( dir.z, 0.00001 );\n"
+			"		lowp vec4 layer = texture2D(Texture%i, uv);\n"
+			"		layer.w *= step( 0.0, dir.z ) * step( 0.0, uv.x ) * step( uv.x, 1.0 ) * step( 0.0, uv.y ) * step( uv.y, 1.0 );\n",
+					i + 1 );
+				break;
+			case WARP_LAYER_CYLINDER:
+				fragmentSrc.AppendFormat(
+			"		highp vec2 uv = vec2( atan( dir.x, -dir.z ), dir.y * inversesqrt( dir.x * dir.x + dir.z * dir.z ) ) *\n"
+			"				LayerScaleBias[%i].xy + LayerScaleBias[%i].zw;\n"
+			"		lowp vec4 layer = texture2D(Texture%i, uv);\n"
+			"		layer.w *= step( 0.0, uv.x ) * step( uv.x, 1.0 ) * step( 0.0, uv.y ) * step( uv.y, 1.0 );\n",
+					i, i, i + 1 );
+				break;
+			case WARP_LAYER_CUBE:
+				fragmentSrc.AppendFormat(
+			"		lowp vec4 layer = textureCube(Texture%i, dir);\n",
+					i + 1 );
+				break;
+			case WARP_LAYER_EQUIRECT:
+				fragmentSrc.AppendFormat(
+			"		highp vec2 uv = vec2( atan( dir.x, -dir.z ), asin( clamp( dir.y * inversesqrt( dot( dir, dir ) ), -1.0, 1.0 ) ) ) *\n"
+			"				LayerScaleBias[%i].xy + LayerScaleBias[%i].zw;\n"
+			"		lowp vec4 layer = texture2D(Texture%i, uv);\n",
+					i, i, i + 1 );
+				break;
+		}
+		fragmentSrc +=
+			"		color.xyz = mix( color.xyz, layer.xyz, layer.w );\n"
+			"	}\n";
+	}
+	fragmentSrc +=
+			"	gl_FragColor = intensity * color;\n"
+			"}\n";
+}
+
+// Collects the names of the varyings in declaration order.
+static int GetVaryingNames( const char * src, String names[16] )
+{
+	int numNames = 0;
+	for ( const char * line = strstr( src, "varying " ); line != NULL; line = strstr( line + 1, "varying " ) )
+	{
+		const char * end = strchr( line, ';' );
+		const char * name = end;
+		while ( name > line && name[-1] != ' ' && name[-1] != '\t' )
+		{
+			name--;
+		}
+		if ( numNames < 16 )
+		{
+			names[numNames] = String( name, end - name );
+		}
+		numNames++;
+	}
+	return numNames;
+}
+
+static int CheckWarpLayerProgram( const TimeWarpLayer * const * layers, const int numLayers, const bool chromatic )
+{
+	const int key = WarpLayerProgramKey( layers, numLayers, chromatic );
+	StringBuffer vertexSrc;
+	StringBuffer fragmentSrc;
+	GenerateWarpLayerProgram( key, vertexSrc, fragmentSrc );
+
+	int numErrors = 0;
+	if ( key == 0 || WarpLayerProgramNumLayers( key ) != numLayers )
+	{
+		LOG( "TestWarpLayerPrograms: key 0x%x doesn't have %i layers", key, numLayers );
+		numErrors++;
+	}
+
+	String vertexVaryings[16];
+	String fragmentVaryings[16];
+	const int numVertexVaryings = GetVaryingNames( vertexSrc.ToCStr(), vertexVaryings );
+	const int numFragmentVaryings = GetVaryingNames( fragmentSrc.ToCStr(), fragmentVaryings );
+	bool varyingsMatch = ( numVertexVaryings == numFragmentVaryings && numVertexVaryings == WarpLayerProgramVaryings( key ) );
+	for ( int i = 0; varyingsMatch && i < numVertexVaryings; i++ )
+	{
+		varyingsMatch = ( vertexVaryings[i] == fragmentVaryings[i] );
+	}
+	if ( !varyingsMatch )
+	{
+		LOG( "TestWarpLayerPrograms: key 0x%x has %i vertex and %i fragment varyings, expected %i",
+				key, numVertexVaryings, numFragmentVaryings, WarpLayerProgramVaryings( key ) );
+		numErrors++;
+	}
+
+	// The GLES 2 minimum, which every key must fit without clamping.
+	if ( WarpLayerProgramVaryings( key ) > 8 || ClampWarpLayerProgramKey( key, 8 ) != key )
+	{
+		LOG( "TestWarpLayerPrograms: key 0x%x needs %i varyings", key, WarpLayerProgramVaryings( key ) );
+		numErrors++;
+	}
+
+	char expected[128];
+	snprintf( expected, sizeof( expected ), "uniform mediump mat4 LayerTexm[%i];", numLayers * 2 );
+	if ( strstr( vertexSrc.ToCStr(), expected ) == NULL )
+	{
+		LOG( "TestWarpLayerPrograms: key 0x%x doesn't declare %s", key, expected );
+		numErrors++;
+	}
+
+	bool external = false;
+	for ( int i = 0; i < numLayers; i++ )
+	{
+		const bool layerExternal = ( layers[i]->Flags & WARP_LAYER_FLAG_EXTERNAL_TEXTURE ) && layers[i]->Type != WARP_LAYER_CUBE;
+		external |= layerExternal;
+		snprintf( expected, sizeof( expected ), "uniform %s Texture%i;", ( layers[i]->Type == WARP_LAYER_CUBE ) ? "samplerCube" :
+				( layerExternal ? "samplerExternalOES" : "sampler2D" ), i + 1 );
+		if ( strstr( fragmentSrc.ToCStr(), expected ) == NULL )
+		{
+			LOG( "TestWarpLayerPrograms: key 0x%x doesn't declare %s", key, expected );
+			numErrors++;
+		}
+	}
+	if ( external != ( strstr( fragmentSrc.ToCStr(), "GL_OES_EGL_image_external" ) != NULL ) )
+	{
+		LOG( "TestWarpLayerPrograms: key 0x%x %s the external image extension", key, external ? "lacks" : "enables" );
+		numErrors++;
+	}
+	return numErrors;
+}
+
+bool TestWarpLayerPrograms()
+{
+	// Every type, with and without an external texture.
+	static const int NUM_LAYER_CHOICES = ( WARP_LAYER_TYPE_MAX - 1 ) * 2;
+	TimeWarpLayer choices[NUM_LAYER_CHOICES];
+	for ( int i = 0; i < NUM_LAYER_CHOICES; i++ )
+	{
+		choices[i].Type = (warpLayerType_t)( WARP_LAYER_QUAD + i / 2 );
+		choices[i].Flags = ( i & 1 ) ? WARP_LAYER_FLAG_EXTERNAL_TEXTURE : 0;
+	}
+
+	// Every combination of one and two layers, and for more layers each
+	// choice at every position.
+	int numErrors = 0;
+	const TimeWarpLayer * layers[TimeWarpParms::MAX_WARP_LAYERS];
+	for ( int numLayers = 1; numLayers <= TimeWarpParms::MAX_WARP_LAYERS; numLayers++ )
+	{
+		int numCombinations = 1;
+		for ( int i = 0; i < numLayers; i++ )
+		{
+			numCombinations *= NUM_LAYER_CHOICES;
+		}
+		const bool exhaustive = ( numLayers <= 2 );
+		for ( int c = 0; c < ( exhaustive ? numCombinations : NUM_LAYER_CHOICES ); c++ )
+		{
+			for ( int i = 0, rest = c; i < numLayers; i++, rest /= NUM_LAYER_CHOICES )
+			{
+				layers[i] = &choices[exhaustive ? rest % NUM_LAYER_CHOICES : ( c + i ) % NUM_LAYER_CHOICES];
+			}
+			numErrors += CheckWarpLayerProgram( layers, numLayers, false );
+			numErrors += CheckWarpLayerProgram( layers, numLayers, true );
+		}
+	}
+
+	// With fewer varyings, chromatic correction goes first, then the top layers.
+	for ( int i = 0; i < TimeWarpParms::MAX_WARP_LAYERS; i++ )
+	{
+		layers[i] = &choices[i * 2];
+	}
+	const int key = WarpLayerProgramKey( layers, TimeWarpParms::MAX_WARP_LAYERS, true );
+	if ( ClampWarpLayerProgramKey( key, 7 ) != WarpLayerProgramKey( layers, TimeWarpParms::MAX_WARP_LAYERS, false ) ||
+			ClampWarpLayerProgramKey( key, 4 ) != WarpLayerProgramKey( layers, 2, false ) ||
+			ClampWarpLayerProgramKey( key, 2 ) != 0 )
+	{
+		LOG( "TestWarpLayerPrograms: key 0x%x clamped to 0x%x, 0x%x and 0x%x", key,
+				ClampWarpLayerProgramKey( key, 7 ), ClampWarpLayerProgramKey( key, 4 ), ClampWarpLayerProgramKey( key, 2 ) );
+		numErrors++;
+	}
+
+	return numErrors == 0;
+}
+
+}	// namespace OVR
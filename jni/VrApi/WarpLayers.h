@@ -0,0 +1,58 @@
+/************************************************************************************
+
+Filename    :   WarpLayers.h
+Content     :   Warp programs generated for combinations of TimeWarpParms::Layers.
+Created     :   October 19, 2026
+
+Copyright   :   Copyright 2014 Oculus VR, LLC. All Rights reserved.
+
+*************************************************************************************/
+#ifndef OVR_WarpLayers_h
+#define OVR_WarpLayers_h
+
+#include "OVR_CAPI.h"
+#include "Kernel/OVR_String.h"
+#include "TimeWarpParms.h"
+
+namespace OVR
+{
+
+// Collects the enabled layers for the eye, in compositing order. Returns the
+// number of layers, 0 if the eye buffer is warped without layers.
+int		GetActiveWarpLayers( const TimeWarpParms & parms, const int eye,
+						const TimeWarpLayer * layers[TimeWarpParms::MAX_WARP_LAYERS] );
+
+// Identifies the generated program for a combination of active layers.
+// Never 0 when there is at least one layer.
+int		WarpLayerProgramKey( const TimeWarpLayer * const * layers, const int numLayers, const bool chromatic );
+
+// The number of layers in a key.
+int		WarpLayerProgramNumLayers( const int key );
+
+// The varying vectors the generated program for a key declares, counting
+// each one as a whole vector instead of relying on the compiler to pack them.
+int		WarpLayerProgramVaryings( const int key );
+
+// Returns the key for the closest program that fits in maxVaryingVectors,
+// which is GL_MAX_VARYING_VECTORS. Chromatic aberration correction is given up
+// first, then the topmost layers, down to 0 if not even a single layer fits.
+int		ClampWarpLayerProgramKey( const int key, const int maxVaryingVectors );
+
+// Writes the sources of the warp program for a key. The program warps the eye
+// buffer in Texture0 like WP_SIMPLE or WP_CHROMATIC, then composites layer i
+// from Texture<i+1> over it. The layers are looked up with the tan angle
+// transforms in LayerTexm[2*i] and LayerTexm[2*i+1], for the start and end of
+// the scanout like Texm and Texm2, and LayerScaleBias[i].
+void	GenerateWarpLayerProgram( const int key, StringBuffer & vertexSrc, StringBuffer & fragmentSrc );
+
+// The LayerScaleBias the generated program needs for the layer.
+void	WarpLayerScaleBias( const TimeWarpLayer & layer, float scaleBias[4] );
+
+// Checks the keys and the generated sources for every combination of layer
+// types: matching varyings between the programs, a sampler of the right type
+// for each layer, and the clamping to the varying limit. Doesn't need GL.
+bool	TestWarpLayerPrograms();
+
+}	// namespace OVR
+
+#endif	// OVR_WarpLayers_h